@@ -504,6 +504,7 @@
         'gmock_unittest.cc',
         'guid_unittest.cc',
         'hash_unittest.cc',
+        'hash_x86_unittest.cc',
         'i18n/break_iterator_unittest.cc',
         'i18n/case_conversion_unittest.cc',
         'i18n/char_iterator_unittest.cc',
@@ -554,6 +555,7 @@
         'message_loop/message_pump_glib_unittest.cc',
         'message_loop/message_pump_io_ios_unittest.cc',
         'message_loop/message_pump_libevent_unittest.cc',
+        'message_loop/timer_wheel_unittest.cc',
         'metrics/bucket_ranges_unittest.cc',
         'metrics/field_trial_unittest.cc',
         'metrics/histogram_base_unittest.cc',
@@ -842,9 +844,16 @@
         '../testing/gtest.gyp:gtest',
       ],
       'sources': [
+        'json/json_perftest.cc',
+        'message_digest_perftest.cc',
         'message_loop/message_pump_perftest.cc',
+        'message_loop/timer_wheel_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'strings/utf_string_conversions_perftest.cc',
         'test/run_all_unittests.cc',
+        'threading/sequenced_worker_pool_perftest.cc',
         'threading/thread_perftest.cc',
+        'values_perftest.cc',
         '../testing/perf/perf_test.cc'
       ],
       'conditions': [
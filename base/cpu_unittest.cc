@@ -88,6 +88,16 @@ TEST(CPU, RunExtendedInstructions) {
     // Execute an SSE 4.2 instruction.
     __asm__ __volatile__("crc32 %%eax, %%eax\n" : : : "eax");
   }
+
+  if (cpu.has_avx2()) {
+    // Execute an AVX 2 instruction.
+    __asm__ __volatile__("vpunpcklqdq %%ymm0, %%ymm0, %%ymm0\n" : : : "xmm0");
+  }
+
+  if (cpu.has_sha()) {
+    // Execute a SHA instruction.
+    __asm__ __volatile__("sha1msg1 %%xmm0, %%xmm0\n" : : : "xmm0");
+  }
 #endif
 #endif
 }
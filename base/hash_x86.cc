@@ -0,0 +1,393 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/hash_x86.h"
+
+#if defined(BASE_HASH_X86_KERNELS)
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// The largest state of the hashes using the kernels, SHA-256's.
+const size_t kMaxStateWords = 8;
+
+// Writes the final block or two of the message |data| of |len| bytes,
+// starting with the |len| % kHashBlockSize bytes at the end that don't fill a
+// block, to |tail|. Returns the number of blocks written.
+size_t PadTail(const BlockHash& hash,
+               const uint8* data,
+               size_t len,
+               uint8 tail[2 * kHashBlockSize]) {
+  size_t remaining = len % kHashBlockSize;
+  size_t num_blocks = remaining + 9 > kHashBlockSize ? 2 : 1;
+  memcpy(tail, data + len - remaining, remaining);
+  tail[remaining] = 0x80;
+  memset(tail + remaining + 1, 0,
+         num_blocks * kHashBlockSize - remaining - 1 - 8);
+  uint64 bits = static_cast<uint64>(len) << 3;
+  uint8* length = tail + num_blocks * kHashBlockSize - 8;
+  for (int i = 0; i < 8; ++i) {
+    length[hash.big_endian ? 7 - i : i] = static_cast<uint8>(bits);
+    bits >>= 8;
+  }
+  return num_blocks;
+}
+
+// Writes the state word |word| of the digest to |out|.
+void StoreWord(const BlockHash& hash, uint32 word, uint8* out) {
+  for (int i = 0; i < 4; ++i) {
+    out[hash.big_endian ? 3 - i : i] = static_cast<uint8>(word);
+    word >>= 8;
+  }
+}
+
+}  // namespace
+
+void HashBytes(const BlockHash& hash,
+               const uint8* data,
+               size_t len,
+               uint8* digest) {
+  DCHECK_LE(hash.state_words, kMaxStateWords);
+  uint32 state[kMaxStateWords];
+  memcpy(state, hash.initial_state, hash.state_words * sizeof(uint32));
+
+  hash.process_blocks(state, data, len / kHashBlockSize);
+  uint8 tail[2 * kHashBlockSize];
+  hash.process_blocks(state, tail, PadTail(hash, data, len, tail));
+
+  for (size_t i = 0; i < hash.state_words; ++i)
+    StoreWord(hash, state[i], digest + i * 4);
+}
+
+void HashBytesMany(const BlockHash& hash,
+                   const uint8* const data[],
+                   const size_t lengths[],
+                   size_t count,
+                   uint8* digests) {
+  DCHECK_LE(hash.state_words, kMaxStateWords);
+  const size_t digest_size = hash.state_words * 4;
+  for (size_t first = 0; first < count; first += kHashLanes) {
+    // When there are fewer messages than lanes left, the last one is hashed
+    // in the remaining lanes as well.
+    size_t num_messages = std::min(kHashLanes, count - first);
+    uint32 state[kMaxStateWords * kHashLanes];
+    size_t num_full_blocks[kHashLanes];
+    size_t num_blocks[kHashLanes];
+    size_t max_blocks = 0;
+    uint8 tails[kHashLanes][2 * kHashBlockSize];
+    for (size_t lane = 0; lane < kHashLanes; ++lane) {
+      size_t message = first + std::min(lane, num_messages - 1);
+      for (size_t i = 0; i < hash.state_words; ++i)
+        state[i * kHashLanes + lane] = hash.initial_state[i];
+      num_full_blocks[lane] = lengths[message] / kHashBlockSize;
+      num_blocks[lane] = num_full_blocks[lane] +
+                         PadTail(hash, data[message], lengths[message],
+                                 tails[lane]);
+      max_blocks = std::max(max_blocks, num_blocks[lane]);
+    }
+
+    // Lanes whose message is shorter than the longest one keep hashing their
+    // last block; their digest has been taken by then.
+    for (size_t block = 0; block < max_blocks; ++block) {
+      const uint8* blocks[kHashLanes];
+      for (size_t lane = 0; lane < kHashLanes; ++lane) {
+        size_t index = std::min(block, num_blocks[lane] - 1);
+        size_t message = first + std::min(lane, num_messages - 1);
+        blocks[lane] =
+            index < num_full_blocks[lane]
+                ? data[message] + index * kHashBlockSize
+                : tails[lane] + (index - num_full_blocks[lane]) *
+                                    kHashBlockSize;
+      }
+      hash.process_lanes(state, blocks);
+      for (size_t lane = 0; lane < num_messages; ++lane) {
+        if (block != num_blocks[lane] - 1)
+          continue;
+        uint8* digest = digests + (first + lane) * digest_size;
+        for (size_t i = 0; i < hash.state_words; ++i)
+          StoreWord(hash, state[i * kHashLanes + lane], digest + i * 4);
+      }
+    }
+  }
+}
+
+// SHA-1 with the SHA extensions, four rounds at a time. The message schedule
+// is computed in msg[] alongside the rounds: group i of four rounds
+// finishes the words of group i + 1 with sha1msg2, continues those of group
+// i + 2 and starts those of group i + 3 with sha1msg1.
+#define SHA1_FOUR_ROUNDS(i)                                                   \
+  do {                                                                        \
+    if ((i) == 0)                                                             \
+      e[0] = _mm_add_epi32(e[0], msg[0]);                                     \
+    else                                                                      \
+      e[(i) % 2] = _mm_sha1nexte_epu32(e[(i) % 2], msg[(i) % 4]);             \
+    e[((i) + 1) % 2] = abcd;                                                  \
+    abcd = _mm_sha1rnds4_epu32(abcd, e[(i) % 2], (i) / 5);                    \
+    if ((i) >= 3 && (i) <= 18) {                                              \
+      msg[((i) + 1) % 4] =                                                    \
+          _mm_sha1msg2_epu32(msg[((i) + 1) % 4], msg[(i) % 4]);               \
+    }                                                                         \
+    if ((i) >= 2 && (i) <= 17)                                                \
+      msg[((i) + 2) % 4] = _mm_xor_si128(msg[((i) + 2) % 4], msg[(i) % 4]);   \
+    if ((i) >= 1 && (i) <= 16) {                                              \
+      msg[((i) + 3) % 4] =                                                    \
+          _mm_sha1msg1_epu32(msg[((i) + 3) % 4], msg[(i) % 4]);               \
+    }                                                                         \
+  } while (0)
+
+HASH_TARGET("sha,sse4.1")
+void SHA1ProcessBlocksSHA(uint32* state, const uint8* data,
+                          size_t num_blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1b);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+  for (size_t block = 0; block < num_blocks; ++block) {
+    const __m128i abcd_save = abcd;
+    const __m128i e_save = e0;
+    __m128i msg[4];
+    for (int i = 0; i < 4; ++i) {
+      msg[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i),
+          kByteSwap);
+    }
+    __m128i e[2] = {e0, e0};
+    SHA1_FOUR_ROUNDS(0);
+    SHA1_FOUR_ROUNDS(1);
+    SHA1_FOUR_ROUNDS(2);
+    SHA1_FOUR_ROUNDS(3);
+    SHA1_FOUR_ROUNDS(4);
+    SHA1_FOUR_ROUNDS(5);
+    SHA1_FOUR_ROUNDS(6);
+    SHA1_FOUR_ROUNDS(7);
+    SHA1_FOUR_ROUNDS(8);
+    SHA1_FOUR_ROUNDS(9);
+    SHA1_FOUR_ROUNDS(10);
+    SHA1_FOUR_ROUNDS(11);
+    SHA1_FOUR_ROUNDS(12);
+    SHA1_FOUR_ROUNDS(13);
+    SHA1_FOUR_ROUNDS(14);
+    SHA1_FOUR_ROUNDS(15);
+    SHA1_FOUR_ROUNDS(16);
+    SHA1_FOUR_ROUNDS(17);
+    SHA1_FOUR_ROUNDS(18);
+    SHA1_FOUR_ROUNDS(19);
+    e0 = _mm_sha1nexte_epu32(e[0], e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+    data += kHashBlockSize;
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                   _mm_shuffle_epi32(abcd, 0x1b));
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHA1_FOUR_ROUNDS
+
+namespace {
+
+inline HASH_TARGET("avx2") __m256i RotateLeft(__m256i x, int bits) {
+  return _mm256_or_si256(_mm256_slli_epi32(x, bits),
+                         _mm256_srli_epi32(x, 32 - bits));
+}
+
+inline HASH_TARGET("avx2") __m256i Add(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+inline HASH_TARGET("avx2") __m256i Xor(__m256i a, __m256i b) {
+  return _mm256_xor_si256(a, b);
+}
+
+inline HASH_TARGET("avx2") __m256i And(__m256i a, __m256i b) {
+  return _mm256_and_si256(a, b);
+}
+
+inline HASH_TARGET("avx2") __m256i Or(__m256i a, __m256i b) {
+  return _mm256_or_si256(a, b);
+}
+
+inline HASH_TARGET("avx2") __m256i LoadState(const uint32* state, int i) {
+  return _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(state + i * kHashLanes));
+}
+
+inline HASH_TARGET("avx2") void AddToState(uint32* state,
+                                           int i,
+                                           __m256i x) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + i * kHashLanes),
+                      Add(LoadState(state, i), x));
+}
+
+}  // namespace
+
+// One round of SHA-1 in every lane, with f() computed from b, c and d by
+// |f_bcd|. The names follow FIPS 180-4.
+#define SHA1_ROUND(t, f_bcd, k)                                               \
+  do {                                                                        \
+    if ((t) >= 16) {                                                          \
+      w[(t) & 15] = RotateLeft(Xor(Xor(w[((t) - 3) & 15], w[((t) - 8) & 15]), \
+                                   Xor(w[((t) - 14) & 15], w[(t) & 15])),     \
+                               1);                                            \
+    }                                                                         \
+    __m256i temp = Add(Add(RotateLeft(a, 5), f_bcd),                          \
+                       Add(Add(e, w[(t) & 15]), k));                          \
+    e = d;                                                                    \
+    d = c;                                                                    \
+    c = RotateLeft(b, 30);                                                    \
+    b = a;                                                                    \
+    a = temp;                                                                 \
+  } while (0)
+
+HASH_TARGET("avx2")
+void SHA1ProcessLanesAVX2(uint32* state,
+                          const uint8* const blocks[kHashLanes]) {
+  __m256i w[16];
+  LoadBlocksAVX2(blocks, true, w);
+  __m256i a = LoadState(state, 0);
+  __m256i b = LoadState(state, 1);
+  __m256i c = LoadState(state, 2);
+  __m256i d = LoadState(state, 3);
+  __m256i e = LoadState(state, 4);
+
+  const __m256i k0 = _mm256_set1_epi32(0x5a827999);
+  for (int t = 0; t < 20; ++t)
+    SHA1_ROUND(t, Xor(d, And(b, Xor(c, d))), k0);
+  const __m256i k1 = _mm256_set1_epi32(0x6ed9eba1);
+  for (int t = 20; t < 40; ++t)
+    SHA1_ROUND(t, Xor(Xor(b, c), d), k1);
+  const __m256i k2 = _mm256_set1_epi32(0x8f1bbcdc);
+  for (int t = 40; t < 60; ++t)
+    SHA1_ROUND(t, Or(And(b, c), And(d, Or(b, c))), k2);
+  const __m256i k3 = _mm256_set1_epi32(0xca62c1d6);
+  for (int t = 60; t < 80; ++t)
+    SHA1_ROUND(t, Xor(Xor(b, c), d), k3);
+
+  AddToState(state, 0, a);
+  AddToState(state, 1, b);
+  AddToState(state, 2, c);
+  AddToState(state, 3, d);
+  AddToState(state, 4, e);
+}
+
+#undef SHA1_ROUND
+
+// One step of MD5 in every lane, as in MD5STEP() in md5.cc.
+#define MD5_STEP(f, w, x, y, z, index, constant, s)                        \
+  do {                                                                     \
+    w = Add(w, Add(f(x, y, z),                                             \
+                   Add(m[index], _mm256_set1_epi32(                        \
+                                     static_cast<int>(constant)))));       \
+    w = Add(RotateLeft(w, s), x);                                          \
+  } while (0)
+
+#define MD5_F1(x, y, z) Xor(z, And(x, Xor(y, z)))
+#define MD5_F2(x, y, z) MD5_F1(z, x, y)
+#define MD5_F3(x, y, z) Xor(Xor(x, y), z)
+#define MD5_F4(x, y, z) Xor(y, Or(x, Xor(z, _mm256_set1_epi32(-1))))
+
+HASH_TARGET("avx2")
+void MD5ProcessLanesAVX2(uint32* state,
+                         const uint8* const blocks[kHashLanes]) {
+  __m256i m[16];
+  LoadBlocksAVX2(blocks, false, m);
+  __m256i a = LoadState(state, 0);
+  __m256i b = LoadState(state, 1);
+  __m256i c = LoadState(state, 2);
+  __m256i d = LoadState(state, 3);
+
+  MD5_STEP(MD5_F1, a, b, c, d, 0, 0xd76aa478, 7);
+  MD5_STEP(MD5_F1, d, a, b, c, 1, 0xe8c7b756, 12);
+  MD5_STEP(MD5_F1, c, d, a, b, 2, 0x242070db, 17);
+  MD5_STEP(MD5_F1, b, c, d, a, 3, 0xc1bdceee, 22);
+  MD5_STEP(MD5_F1, a, b, c, d, 4, 0xf57c0faf, 7);
+  MD5_STEP(MD5_F1, d, a, b, c, 5, 0x4787c62a, 12);
+  MD5_STEP(MD5_F1, c, d, a, b, 6, 0xa8304613, 17);
+  MD5_STEP(MD5_F1, b, c, d, a, 7, 0xfd469501, 22);
+  MD5_STEP(MD5_F1, a, b, c, d, 8, 0x698098d8, 7);
+  MD5_STEP(MD5_F1, d, a, b, c, 9, 0x8b44f7af, 12);
+  MD5_STEP(MD5_F1, c, d, a, b, 10, 0xffff5bb1, 17);
+  MD5_STEP(MD5_F1, b, c, d, a, 11, 0x895cd7be, 22);
+  MD5_STEP(MD5_F1, a, b, c, d, 12, 0x6b901122, 7);
+  MD5_STEP(MD5_F1, d, a, b, c, 13, 0xfd987193, 12);
+  MD5_STEP(MD5_F1, c, d, a, b, 14, 0xa679438e, 17);
+  MD5_STEP(MD5_F1, b, c, d, a, 15, 0x49b40821, 22);
+
+  MD5_STEP(MD5_F2, a, b, c, d, 1, 0xf61e2562, 5);
+  MD5_STEP(MD5_F2, d, a, b, c, 6, 0xc040b340, 9);
+  MD5_STEP(MD5_F2, c, d, a, b, 11, 0x265e5a51, 14);
+  MD5_STEP(MD5_F2, b, c, d, a, 0, 0xe9b6c7aa, 20);
+  MD5_STEP(MD5_F2, a, b, c, d, 5, 0xd62f105d, 5);
+  MD5_STEP(MD5_F2, d, a, b, c, 10, 0x02441453, 9);
+  MD5_STEP(MD5_F2, c, d, a, b, 15, 0xd8a1e681, 14);
+  MD5_STEP(MD5_F2, b, c, d, a, 4, 0xe7d3fbc8, 20);
+  MD5_STEP(MD5_F2, a, b, c, d, 9, 0x21e1cde6, 5);
+  MD5_STEP(MD5_F2, d, a, b, c, 14, 0xc33707d6, 9);
+  MD5_STEP(MD5_F2, c, d, a, b, 3, 0xf4d50d87, 14);
+  MD5_STEP(MD5_F2, b, c, d, a, 8, 0x455a14ed, 20);
+  MD5_STEP(MD5_F2, a, b, c, d, 13, 0xa9e3e905, 5);
+  MD5_STEP(MD5_F2, d, a, b, c, 2, 0xfcefa3f8, 9);
+  MD5_STEP(MD5_F2, c, d, a, b, 7, 0x676f02d9, 14);
+  MD5_STEP(MD5_F2, b, c, d, a, 12, 0x8d2a4c8a, 20);
+
+  MD5_STEP(MD5_F3, a, b, c, d, 5, 0xfffa3942, 4);
+  MD5_STEP(MD5_F3, d, a, b, c, 8, 0x8771f681, 11);
+  MD5_STEP(MD5_F3, c, d, a, b, 11, 0x6d9d6122, 16);
+  MD5_STEP(MD5_F3, b, c, d, a, 14, 0xfde5380c, 23);
+  MD5_STEP(MD5_F3, a, b, c, d, 1, 0xa4beea44, 4);
+  MD5_STEP(MD5_F3, d, a, b, c, 4, 0x4bdecfa9, 11);
+  MD5_STEP(MD5_F3, c, d, a, b, 7, 0xf6bb4b60, 16);
+  MD5_STEP(MD5_F3, b, c, d, a, 10, 0xbebfbc70, 23);
+  MD5_STEP(MD5_F3, a, b, c, d, 13, 0x289b7ec6, 4);
+  MD5_STEP(MD5_F3, d, a, b, c, 0, 0xeaa127fa, 11);
+  MD5_STEP(MD5_F3, c, d, a, b, 3, 0xd4ef3085, 16);
+  MD5_STEP(MD5_F3, b, c, d, a, 6, 0x04881d05, 23);
+  MD5_STEP(MD5_F3, a, b, c, d, 9, 0xd9d4d039, 4);
+  MD5_STEP(MD5_F3, d, a, b, c, 12, 0xe6db99e5, 11);
+  MD5_STEP(MD5_F3, c, d, a, b, 15, 0x1fa27cf8, 16);
+  MD5_STEP(MD5_F3, b, c, d, a, 2, 0xc4ac5665, 23);
+
+  MD5_STEP(MD5_F4, a, b, c, d, 0, 0xf4292244, 6);
+  MD5_STEP(MD5_F4, d, a, b, c, 7, 0x432aff97, 10);
+  MD5_STEP(MD5_F4, c, d, a, b, 14, 0xab9423a7, 15);
+  MD5_STEP(MD5_F4, b, c, d, a, 5, 0xfc93a039, 21);
+  MD5_STEP(MD5_F4, a, b, c, d, 12, 0x655b59c3, 6);
+  MD5_STEP(MD5_F4, d, a, b, c, 3, 0x8f0ccc92, 10);
+  MD5_STEP(MD5_F4, c, d, a, b, 10, 0xffeff47d, 15);
+  MD5_STEP(MD5_F4, b, c, d, a, 1, 0x85845dd1, 21);
+  MD5_STEP(MD5_F4, a, b, c, d, 8, 0x6fa87e4f, 6);
+  MD5_STEP(MD5_F4, d, a, b, c, 15, 0xfe2ce6e0, 10);
+  MD5_STEP(MD5_F4, c, d, a, b, 6, 0xa3014314, 15);
+  MD5_STEP(MD5_F4, b, c, d, a, 13, 0x4e0811a1, 21);
+  MD5_STEP(MD5_F4, a, b, c, d, 4, 0xf7537e82, 6);
+  MD5_STEP(MD5_F4, d, a, b, c, 11, 0xbd3af235, 10);
+  MD5_STEP(MD5_F4, c, d, a, b, 2, 0x2ad7d2bb, 15);
+  MD5_STEP(MD5_F4, b, c, d, a, 9, 0xeb86d391, 21);
+
+  AddToState(state, 0, a);
+  AddToState(state, 1, b);
+  AddToState(state, 2, c);
+  AddToState(state, 3, d);
+}
+
+#undef MD5_STEP
+#undef MD5_F1
+#undef MD5_F2
+#undef MD5_F3
+#undef MD5_F4
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // defined(BASE_HASH_X86_KERNELS)
@@ -0,0 +1,139 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Hash kernels for x86 processors with the SHA extensions or AVX2, and the
+// padding logic shared by the Merkle-Damgard hashes that use them. Only the
+// kernel functions themselves are compiled for those instruction sets, so
+// callers must check base::CPU before calling them.
+
+#ifndef BASE_HASH_X86_H_
+#define BASE_HASH_X86_H_
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "build/build_config.h"
+
+// The kernels rely on GCC and clang compiling single functions for other
+// instruction sets. NaCl's validator doesn't allow the SHA extensions.
+#if defined(ARCH_CPU_X86_FAMILY) && defined(COMPILER_GCC) && \
+    !defined(OS_NACL)
+#define BASE_HASH_X86_KERNELS 1
+#endif
+
+#if defined(BASE_HASH_X86_KERNELS)
+
+#include <immintrin.h>
+
+// Compiles a function so that it can use the instruction set extensions in
+// |isa|, e.g. "avx2".
+#define HASH_TARGET(isa) __attribute__((target(isa)))
+
+namespace base {
+namespace internal {
+
+// Number of messages that the multi-buffer kernels hash at once.
+const size_t kHashLanes = 8;
+
+// Size of the blocks that MD5, SHA-1 and SHA-256 process.
+const size_t kHashBlockSize = 64;
+
+// Describes a hash that pads messages with 0x80, zeros and the message length
+// in bits to a multiple of kHashBlockSize bytes, like MD5, SHA-1 and SHA-256.
+struct BlockHash {
+  // Number of 32-bit words in the state. The digest is the final state.
+  size_t state_words;
+  const uint32* initial_state;
+
+  // Whether the length and the words of the digest are big endian.
+  bool big_endian;
+
+  // Updates |state| with |num_blocks| consecutive blocks at |data|.
+  void (*process_blocks)(uint32* state, const uint8* data, size_t num_blocks);
+
+  // Updates the states of kHashLanes messages with one block of each.
+  // Word i of the state of message j is state[i * kHashLanes + j].
+  void (*process_lanes)(uint32* state, const uint8* const blocks[kHashLanes]);
+};
+
+// Hashes the |len| bytes at |data| with |hash.process_blocks| and writes the
+// digest, which is |hash.state_words| * 4 bytes long, to |digest|.
+BASE_EXPORT void HashBytes(const BlockHash& hash,
+                           const uint8* data,
+                           size_t len,
+                           uint8* digest);
+
+// Hashes |count| messages with |hash.process_lanes|, kHashLanes at a time,
+// and writes their digests one after the other to |digests|.
+BASE_EXPORT void HashBytesMany(const BlockHash& hash,
+                               const uint8* const data[],
+                               const size_t lengths[],
+                               size_t count,
+                               uint8* digests);
+
+// Transposes the 8x8 matrix of 32-bit words in |rows|, so that word i of
+// row j becomes word j of row i.
+inline HASH_TARGET("avx2") void TransposeAVX2(__m256i rows[8]) {
+  __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+  __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+  __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+  __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+  __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+  __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+  __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+  __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+  rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// Loads the 16 words of one block of each of kHashLanes messages, so that
+// words[i] holds word i of every block. Swaps the bytes of each word if
+// |big_endian|.
+inline HASH_TARGET("avx2") void LoadBlocksAVX2(
+    const uint8* const blocks[kHashLanes],
+    bool big_endian,
+    __m256i words[16]) {
+  const __m256i kByteSwap = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  for (size_t half = 0; half < 2; ++half) {
+    __m256i* rows = words + half * 8;
+    for (size_t lane = 0; lane < kHashLanes; ++lane) {
+      rows[lane] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(blocks[lane] + half * 32));
+      if (big_endian)
+        rows[lane] = _mm256_shuffle_epi8(rows[lane], kByteSwap);
+    }
+    TransposeAVX2(rows);
+  }
+}
+
+// SHA-1 compression with the SHA extensions. |state| is SHA-1's H0..H4.
+void SHA1ProcessBlocksSHA(uint32* state, const uint8* data, size_t num_blocks);
+
+// SHA-1 compression of kHashLanes messages at once with AVX2.
+void SHA1ProcessLanesAVX2(uint32* state, const uint8* const blocks[kHashLanes]);
+
+// MD5 compression of kHashLanes messages at once with AVX2.
+void MD5ProcessLanesAVX2(uint32* state, const uint8* const blocks[kHashLanes]);
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // defined(BASE_HASH_X86_KERNELS)
+
+#endif  // BASE_HASH_X86_H_
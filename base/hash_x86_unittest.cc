@@ -0,0 +1,164 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/hash_x86.h"
+
+#include <string>
+#include <vector>
+
+#include "base/cpu.h"
+#include "base/md5.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(BASE_HASH_X86_KERNELS)
+
+namespace base {
+namespace internal {
+
+namespace {
+
+const uint32 kSHA1InitialState[] = {
+  0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+const uint32 kMD5InitialState[] = {
+  0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+};
+
+// A message, which is |input| repeated |repeat| times, and its digest.
+struct KnownAnswer {
+  const char* input;
+  size_t repeat;
+  const char* digest;
+};
+
+// The examples of FIPS 180-2, and the empty message.
+const KnownAnswer kSHA1Answers[] = {
+  {"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+  {"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d"},
+  {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+   "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+  {"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+};
+
+// The test suite of RFC 1321.
+const KnownAnswer kMD5Answers[] = {
+  {"", 1, "d41d8cd98f00b204e9800998ecf8427e"},
+  {"a", 1, "0cc175b9c0f1b6a831c399e269772661"},
+  {"abc", 1, "900150983cd24fb0d6963f7d28e17f72"},
+  {"message digest", 1, "f96b697d7cb7938d525a2f31aaf161d0"},
+  {"abcdefghijklmnopqrstuvwxyz", 1, "c3fcd3d76192e4007dfb496cca67e13b"},
+  {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 1,
+   "d174ab98d277d9f5a5611c2c9f419d9f"},
+  {"1234567890", 8, "57edf4a22be3c955ac49da2e2107b67a"},
+};
+
+// Checks the digests of |answers| computed with |hash|, one at a time if
+// |many| is false, and otherwise all at once.
+void CheckKnownAnswers(const BlockHash& hash,
+                       const KnownAnswer* answers,
+                       size_t count,
+                       bool many) {
+  std::vector<std::string> inputs(count);
+  std::vector<const uint8*> data(count);
+  std::vector<size_t> lengths(count);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < answers[i].repeat; ++j)
+      inputs[i] += answers[i].input;
+    data[i] = reinterpret_cast<const uint8*>(inputs[i].data());
+    lengths[i] = inputs[i].length();
+  }
+
+  size_t digest_size = hash.state_words * 4;
+  std::vector<uint8> digests(count * digest_size);
+  if (many) {
+    HashBytesMany(hash, &data[0], &lengths[0], count, &digests[0]);
+  } else {
+    for (size_t i = 0; i < count; ++i)
+      HashBytes(hash, data[i], lengths[i], &digests[i * digest_size]);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(answers[i].digest,
+              StringToLowerASCII(
+                  HexEncode(&digests[i * digest_size], digest_size)))
+        << "answer " << i << (many ? " of many" : "");
+  }
+}
+
+class HashX86Test : public testing::Test {
+ public:
+  void SetUp() override {
+    // Inputs of every length up to a few blocks.
+    for (size_t i = 0; i < arraysize(inputs_); ++i) {
+      for (size_t j = 0; j < i; ++j)
+        inputs_[i].push_back(static_cast<char>(i * 31 + j));
+      data_[i] = reinterpret_cast<const uint8*>(inputs_[i].data());
+      lengths_[i] = inputs_[i].length();
+    }
+  }
+
+  // Returns the digests of all inputs, one at a time if |many| is false.
+  std::string Hash(const BlockHash& hash, bool many) {
+    size_t digest_size = hash.state_words * 4;
+    std::string digests(arraysize(inputs_) * digest_size, '\0');
+    uint8* out = reinterpret_cast<uint8*>(&digests[0]);
+    if (many) {
+      HashBytesMany(hash, data_, lengths_, arraysize(inputs_), out);
+    } else {
+      for (size_t i = 0; i < arraysize(inputs_); ++i)
+        HashBytes(hash, data_[i], lengths_[i], out + i * digest_size);
+    }
+    return digests;
+  }
+
+ protected:
+  CPU cpu_;
+  std::string inputs_[203];
+  const uint8* data_[203];
+  size_t lengths_[203];
+};
+
+}  // namespace
+
+TEST_F(HashX86Test, SHA1) {
+  BlockHash hash = {arraysize(kSHA1InitialState), kSHA1InitialState, true,
+                    SHA1ProcessBlocksSHA, SHA1ProcessLanesAVX2};
+  bool has_sha = cpu_.has_sha() && cpu_.has_sse41();
+  if (has_sha)
+    CheckKnownAnswers(hash, kSHA1Answers, arraysize(kSHA1Answers), false);
+  if (cpu_.has_avx2())
+    CheckKnownAnswers(hash, kSHA1Answers, arraysize(kSHA1Answers), true);
+
+  // SHA1HashString() uses the SHA extensions itself, so for the other
+  // lengths the two kernels are checked against each other.
+  if (has_sha && cpu_.has_avx2())
+    EXPECT_EQ(Hash(hash, false), Hash(hash, true));
+}
+
+TEST_F(HashX86Test, MD5) {
+  if (!cpu_.has_avx2())
+    return;
+  BlockHash hash = {arraysize(kMD5InitialState), kMD5InitialState, false,
+                    NULL, MD5ProcessLanesAVX2};
+  CheckKnownAnswers(hash, kMD5Answers, arraysize(kMD5Answers), true);
+
+  std::string digests = Hash(hash, true);
+  for (size_t i = 0; i < arraysize(inputs_); ++i) {
+    // MD5Update() is never accelerated.
+    MD5Context context;
+    MD5Init(&context);
+    MD5Update(&context, inputs_[i]);
+    MD5Digest digest;
+    MD5Final(&digest, &context);
+    EXPECT_EQ(std::string(reinterpret_cast<char*>(digest.a), 16),
+              digests.substr(i * 16, 16)) << "input " << i;
+  }
+}
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // defined(BASE_HASH_X86_KERNELS)
@@ -0,0 +1,57 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_JSON_JSON_EVENT_HANDLER_H_
+#define BASE_JSON_JSON_EVENT_HANDLER_H_
+
+#include "base/base_export.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+
+// Receives the contents of a JSON document from JSONReader::ReadWithHandler()
+// as a stream of events in document order, instead of as a Value tree. This
+// lets callers that only need a few fields out of a large document read them
+// without allocating anything for the rest.
+//
+// For example, the document {"a": [1, true]} produces:
+//   OnDictionaryBegin()
+//   OnDictionaryKey("a")
+//   OnListBegin()
+//   OnInteger(1)
+//   OnBoolean(true)
+//   OnListEnd()
+//   OnDictionaryEnd()
+//
+// Every method returns true to continue parsing or false to stop it, in which
+// case ReadWithHandler() fails with JSONReader::JSON_PARSE_ABORTED. Because
+// events are delivered while the input is being read, a handler may see the
+// events for a prefix of a document that later turns out to be malformed.
+//
+// The StringPiece arguments point either into the input or into a temporary
+// buffer (when the string contained escape sequences), and are only valid for
+// the duration of the call.
+class BASE_EXPORT JSONEventHandler {
+ public:
+  virtual bool OnNull() = 0;
+  virtual bool OnBoolean(bool value) = 0;
+  virtual bool OnInteger(int value) = 0;
+  virtual bool OnDouble(double value) = 0;
+  virtual bool OnString(const StringPiece& value) = 0;
+
+  virtual bool OnDictionaryBegin() = 0;
+  // Called before the value of each key/value pair.
+  virtual bool OnDictionaryKey(const StringPiece& key) = 0;
+  virtual bool OnDictionaryEnd() = 0;
+
+  virtual bool OnListBegin() = 0;
+  virtual bool OnListEnd() = 0;
+
+ protected:
+  virtual ~JSONEventHandler() {}
+};
+
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_EVENT_HANDLER_H_
@@ -5,6 +5,7 @@
 #include "base/json/json_parser.h"
 
 #include "base/float_util.h"
+#include "base/json/json_event_handler.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/string_number_conversions.h"
@@ -25,6 +26,31 @@ const int kStackMaxDepth = 100;
 
 const int32 kExtendedASCIIStart = 0x80;
 
+// Holds the members of a dictionary while it is parsed, so that they are
+// sorted once when it ends rather than inserted one at a time. Owns their
+// values until then, so that they are freed if the parse fails.
+class PendingDictionaryEntries {
+ public:
+  PendingDictionaryEntries() {}
+  ~PendingDictionaryEntries() {
+    for (size_t i = 0; i < entries_.size(); ++i)
+      delete entries_[i].second;
+  }
+
+  void Add(const std::string& key, Value* value) {
+    entries_.push_back(DictionaryValue::Entry(key, value));
+  }
+
+  void MoveTo(DictionaryValue* dict) {
+    dict->SetEntriesWithoutPathExpansion(&entries_);
+  }
+
+ private:
+  DictionaryValue::EntryVector entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(PendingDictionaryEntries);
+};
+
 // This and the class below are used to own the JSON input string for when
 // string tokens are stored as StringPiece instead of std::string. This
 // optimization avoids about 2/3rds of string memory copies. The constructor
@@ -186,6 +212,7 @@ class StackMarker {
 
 JSONParser::JSONParser(int options)
     : options_(options),
+      handler_(NULL),
       start_pos_(NULL),
       pos_(NULL),
       end_pos_(NULL),
@@ -206,31 +233,12 @@ Value* JSONParser::Parse(const StringPiece& input) {
   // If the children of a JSON root can be detached, then hidden roots cannot
   // be used, so do not bother copying the input because StringPiece will not
   // be used anywhere.
+  const char* start = input.data();
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     input_copy.reset(new std::string(input.as_string()));
-    start_pos_ = input_copy->data();
-  } else {
-    start_pos_ = input.data();
-  }
-  pos_ = start_pos_;
-  end_pos_ = start_pos_ + input.length();
-  index_ = 0;
-  line_number_ = 1;
-  index_last_line_ = 0;
-
-  error_code_ = JSONReader::JSON_NO_ERROR;
-  error_line_ = 0;
-  error_column_ = 0;
-
-  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
-  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // ParseNextToken function mis-treating a Unicode BOM as an invalid
-  // character and returning NULL.
-  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
-      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
-      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
-    NextNChars(3);
+    start = input_copy->data();
   }
+  BeginInput(start, input.length());
 
   // Parse the first and any nested tokens.
   scoped_ptr<Value> root(ParseNextToken());
@@ -238,12 +246,8 @@ Value* JSONParser::Parse(const StringPiece& input) {
     return NULL;
 
   // Make sure the input stream is at an end.
-  if (GetNextToken() != T_END_OF_INPUT) {
-    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
-      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
-      return NULL;
-    }
-  }
+  if (!ConsumeEndOfInput())
+    return NULL;
 
   // Dictionaries and lists can contain JSONStringValues, so wrap them in a
   // hidden root.
@@ -264,6 +268,18 @@ Value* JSONParser::Parse(const StringPiece& input) {
   return root.release();
 }
 
+bool JSONParser::ParseWithHandler(const StringPiece& input,
+                                  JSONEventHandler* handler) {
+  DCHECK(handler);
+  // Strings are only ever handed out for the duration of a handler call, so
+  // there is no need to keep a copy of the input around.
+  BeginInput(input.data(), input.length());
+  handler_ = handler;
+  bool success = EmitNextToken() && ConsumeEndOfInput();
+  handler_ = NULL;
+  return success;
+}
+
 JSONReader::JsonParseError JSONParser::error_code() const {
   return error_code_;
 }
@@ -336,6 +352,39 @@ const std::string& JSONParser::StringBuilder::AsString() {
 
 // JSONParser private //////////////////////////////////////////////////////////
 
+void JSONParser::BeginInput(const char* start, size_t length) {
+  start_pos_ = start;
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + length;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+
+  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
+  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
+  // ParseNextToken function mis-treating a Unicode BOM as an invalid
+  // character and returning NULL.
+  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
+      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+}
+
+bool JSONParser::ConsumeEndOfInput() {
+  if (GetNextToken() != T_END_OF_INPUT) {
+    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
 inline bool JSONParser::CanConsume(int length) {
   return pos_ + length <= end_pos_;
 }
@@ -490,6 +539,7 @@ Value* JSONParser::ConsumeDictionary() {
   }
 
   scoped_ptr<DictionaryValue> dict(new DictionaryValue);
+  PendingDictionaryEntries entries;
 
   NextChar();
   Token token = GetNextToken();
@@ -513,7 +563,7 @@ Value* JSONParser::ConsumeDictionary() {
       return NULL;
     }
 
-    // The next token is the value. Ownership transfers to |dict|.
+    // The next token is the value. Ownership transfers to |entries|.
     NextChar();
     Value* value = ParseNextToken();
     if (!value) {
@@ -521,7 +571,7 @@ Value* JSONParser::ConsumeDictionary() {
       return NULL;
     }
 
-    dict->SetWithoutPathExpansion(key.AsString(), value);
+    entries.Add(key.AsString(), value);
 
     NextChar();
     token = GetNextToken();
@@ -538,6 +588,7 @@ Value* JSONParser::ConsumeDictionary() {
     }
   }
 
+  entries.MoveTo(dict.get());
   return dict.release();
 }
 
@@ -804,6 +855,24 @@ void JSONParser::DecodeUTF8(const int32& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return NULL;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return new FundamentalValue(num_int);
+
+  double num_double;
+  if (base::StringToDouble(num_string.as_string(), &num_double) &&
+      IsFinite(num_double)) {
+    return new FundamentalValue(num_double);
+  }
+
+  return NULL;
+}
+
+bool JSONParser::ConsumeNumberRaw(StringPiece* out) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -813,7 +882,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return NULL;
+    return false;
   }
   end_index = index_;
 
@@ -821,12 +890,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -838,7 +907,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -858,25 +927,14 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
   }
 
   pos_ = exit_pos;
   index_ = exit_index;
 
-  StringPiece num_string(num_start, end_index - start_index);
-
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
-
-  double num_double;
-  if (base::StringToDouble(num_string.as_string(), &num_double) &&
-      IsFinite(num_double)) {
-    return new FundamentalValue(num_double);
-  }
-
-  return NULL;
+  *out = StringPiece(num_start, end_index - start_index);
+  return true;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -899,6 +957,22 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 }
 
 Value* JSONParser::ConsumeLiteral() {
+  Token literal;
+  if (!ConsumeLiteralRaw(&literal))
+    return NULL;
+
+  switch (literal) {
+    case T_BOOL_TRUE:
+      return new FundamentalValue(true);
+    case T_BOOL_FALSE:
+      return new FundamentalValue(false);
+    default:
+      DCHECK_EQ(T_NULL, literal);
+      return Value::CreateNullValue();
+  }
+}
+
+bool JSONParser::ConsumeLiteralRaw(Token* out) {
   switch (*pos_) {
     case 't': {
       const char kTrueLiteral[] = "true";
@@ -906,10 +980,11 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kTrueLen - 1) ||
           !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kTrueLen - 1);
-      return new FundamentalValue(true);
+      *out = T_BOOL_TRUE;
+      return true;
     }
     case 'f': {
       const char kFalseLiteral[] = "false";
@@ -917,10 +992,11 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kFalseLen - 1) ||
           !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kFalseLen - 1);
-      return new FundamentalValue(false);
+      *out = T_BOOL_FALSE;
+      return true;
     }
     case 'n': {
       const char kNullLiteral[] = "null";
@@ -928,17 +1004,204 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kNullLen - 1) ||
           !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kNullLen - 1);
-      return Value::CreateNullValue();
+      *out = T_NULL;
+      return true;
     }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
-      return NULL;
+      return false;
   }
 }
 
+// Event-based parsing /////////////////////////////////////////////////////////
+
+bool JSONParser::EmitNextToken() {
+  return EmitToken(GetNextToken());
+}
+
+bool JSONParser::EmitToken(Token token) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return EmitDictionary();
+    case T_ARRAY_BEGIN:
+      return EmitList();
+    case T_STRING:
+      return EmitString();
+    case T_NUMBER:
+      return EmitNumber();
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL:
+      return EmitLiteral();
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::EmitDictionary() {
+  if (*pos_ != '{') {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+    return false;
+  }
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!CheckHandlerResult(handler_->OnDictionaryBegin()))
+    return false;
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+
+    // First consume the key.
+    StringBuilder key;
+    if (!ConsumeStringRaw(&key))
+      return false;
+    if (!CheckHandlerResult(handler_->OnDictionaryKey(
+            key.CanBeStringPiece() ? key.AsStringPiece()
+                                   : StringPiece(key.AsString())))) {
+      return false;
+    }
+
+    // Read the separator.
+    NextChar();
+    token = GetNextToken();
+    if (token != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    // The next token is the value.
+    NextChar();
+    if (!EmitNextToken()) {
+      // ReportError from deeper level.
+      return false;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+
+  return CheckHandlerResult(handler_->OnDictionaryEnd());
+}
+
+bool JSONParser::EmitList() {
+  if (*pos_ != '[') {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+    return false;
+  }
+
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  if (!CheckHandlerResult(handler_->OnListBegin()))
+    return false;
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!EmitToken(token)) {
+      // ReportError from deeper level.
+      return false;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+
+  return CheckHandlerResult(handler_->OnListEnd());
+}
+
+bool JSONParser::EmitString() {
+  StringBuilder string;
+  if (!ConsumeStringRaw(&string))
+    return false;
+
+  return CheckHandlerResult(handler_->OnString(
+      string.CanBeStringPiece() ? string.AsStringPiece()
+                                : StringPiece(string.AsString())));
+}
+
+bool JSONParser::EmitNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return false;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return CheckHandlerResult(handler_->OnInteger(num_int));
+
+  // Numbers are short enough for the copy below to stay in the small string
+  // buffer.
+  double num_double;
+  if (base::StringToDouble(num_string.as_string(), &num_double) &&
+      IsFinite(num_double)) {
+    return CheckHandlerResult(handler_->OnDouble(num_double));
+  }
+
+  // Like ConsumeNumber(), fail without setting an error code.
+  return false;
+}
+
+bool JSONParser::EmitLiteral() {
+  Token literal;
+  if (!ConsumeLiteralRaw(&literal))
+    return false;
+
+  switch (literal) {
+    case T_BOOL_TRUE:
+      return CheckHandlerResult(handler_->OnBoolean(true));
+    case T_BOOL_FALSE:
+      return CheckHandlerResult(handler_->OnBoolean(false));
+    default:
+      DCHECK_EQ(T_NULL, literal);
+      return CheckHandlerResult(handler_->OnNull());
+  }
+}
+
+bool JSONParser::CheckHandlerResult(bool handler_result) {
+  if (!handler_result)
+    ReportError(JSONReader::JSON_PARSE_ABORTED, 1);
+  return handler_result;
+}
+
 // static
 bool JSONParser::StringsAreEqual(const char* one, const char* two, size_t len) {
   return strncmp(one, two, len) == 0;
@@ -18,6 +18,7 @@
 #endif
 
 namespace base {
+class JSONEventHandler;
 class Value;
 }
 
@@ -66,6 +67,12 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // result as a Value owned by the caller.
   Value* Parse(const StringPiece& input);
 
+  // Parses the input string according to the set options, reporting its
+  // contents to |handler| as they are read rather than building a Value. Only
+  // strings with escape sequences are copied; nothing is allocated per token
+  // otherwise. Returns false on error, including when |handler| stops parsing.
+  bool ParseWithHandler(const StringPiece& input, JSONEventHandler* handler);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
@@ -143,6 +150,14 @@ class BASE_EXPORT_PRIVATE JSONParser {
     std::string* string_;
   };
 
+  // Resets the parser state to the beginning of |length| bytes at |start|,
+  // skipping a UTF-8 Byte-Order-Mark if there is one.
+  void BeginInput(const char* start, size_t length);
+
+  // Called after the root value has been consumed; returns false and reports
+  // an error if anything other than whitespace and comments follows it.
+  bool ConsumeEndOfInput();
+
   // Quick check that the stream has capacity to consume |length| more bytes.
   bool CanConsume(int length);
 
@@ -202,6 +217,9 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+  // Helper for ConsumeNumber() that validates the number and stores its text
+  // in |out|. Returns false on error with error information set.
+  bool ConsumeNumberRaw(StringPiece* out);
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -209,6 +227,26 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Helper for ConsumeLiteral() that stores which literal was read as one of
+  // T_BOOL_TRUE, T_BOOL_FALSE or T_NULL in |out|. Returns false on error with
+  // error information set.
+  bool ConsumeLiteralRaw(Token* out);
+
+  // The event-based counterparts of ParseNextToken(), ParseToken() and the
+  // Consume functions above, used by ParseWithHandler(). They walk the input
+  // the same way, but report what they find to |handler_| instead of building
+  // Values, and return false on error.
+  bool EmitNextToken();
+  bool EmitToken(Token token);
+  bool EmitDictionary();
+  bool EmitList();
+  bool EmitString();
+  bool EmitNumber();
+  bool EmitLiteral();
+
+  // Passes through |handler_result|, reporting JSON_PARSE_ABORTED if it is
+  // false.
+  bool CheckHandlerResult(bool handler_result);
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
@@ -226,6 +264,9 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // base::JSONParserOptions that control parsing.
   int options_;
 
+  // The receiver of events during ParseWithHandler(). Weak, NULL otherwise.
+  JSONEventHandler* handler_;
+
   // Pointer to the start of the input data.
   const char* start_pos_;
 
@@ -0,0 +1,185 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/json/json_event_handler.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_value_converter.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kNumIterations = 10;
+
+// Builds a component-update style response with |num_apps| entries. Each entry
+// carries a lot of data that the structs below do not care about, which is
+// typical of the large payloads that are read for a handful of fields.
+std::string BuildCorpus(int num_apps) {
+  std::string json = "{\"server\": \"prod\", \"protocol\": \"3.0\", \"apps\": [";
+  for (int i = 0; i < num_apps; ++i) {
+    if (i)
+      json += ",";
+    StringAppendF(&json,
+        "{\"appid\": \"app%08d\", \"status\": \"ok\", "
+        "\"name\": \"Component \\\"%d\\\" \\u00e9\", "
+        "\"version\": \"%d.%d.%d.%d\", "
+        "\"urls\": [\"https://dl.example.com/a/%d\", "
+        "\"https://mirror.example.com/a/%d\", "
+        "\"http://fallback.example.com/a/%d\"], "
+        "\"manifest\": {\"arguments\": \"--no-sandbox --flag=%d\", "
+        "\"packages\": [{\"name\": \"pkg%d.crx\", \"size\": %d, "
+        "\"fp\": \"1.%064d\", \"hash_sha256\": \"%064d\", "
+        "\"delta\": false}]}, "
+        "\"events\": [",
+        i, i, i % 97, i % 13, i % 7, i, i, i, i, i, i, 1000 + i * 37, i, i);
+    for (int j = 0; j < 8; ++j) {
+      StringAppendF(&json,
+          "%s{\"type\": %d, \"result\": %d, \"time\": %d.%03d, "
+          "\"details\": {\"code\": %d, \"retry\": %s, \"tags\": "
+          "[\"a\", \"b\", \"c\"]}}",
+          j ? ", " : "", j, j % 2, 1400000000 + i, j, -j, j % 3 ? "true"
+                                                                 : "null");
+    }
+    json += "]}";
+  }
+  json += "]}";
+  return json;
+}
+
+struct Package {
+  std::string name;
+  int size;
+
+  Package() : size(0) {}
+
+  static void RegisterJSONConverter(JSONValueConverter<Package>* converter) {
+    converter->RegisterStringField("name", &Package::name);
+    converter->RegisterIntField("size", &Package::size);
+  }
+};
+
+struct App {
+  std::string appid;
+  std::string version;
+  ScopedVector<Package> packages;
+
+  static void RegisterJSONConverter(JSONValueConverter<App>* converter) {
+    converter->RegisterStringField("appid", &App::appid);
+    converter->RegisterStringField("version", &App::version);
+    converter->RegisterRepeatedMessage("manifest.packages", &App::packages);
+  }
+};
+
+struct Response {
+  ScopedVector<App> apps;
+
+  static void RegisterJSONConverter(JSONValueConverter<Response>* converter) {
+    converter->RegisterRepeatedMessage("apps", &Response::apps);
+  }
+};
+
+// Visits every event and does nothing with it, to measure the reader alone.
+class CountingHandler : public JSONEventHandler {
+ public:
+  CountingHandler() : count_(0) {}
+  ~CountingHandler() override {}
+
+  bool OnNull() override { return Count(); }
+  bool OnBoolean(bool value) override { return Count(); }
+  bool OnInteger(int value) override { return Count(); }
+  bool OnDouble(double value) override { return Count(); }
+  bool OnString(const StringPiece& value) override { return Count(); }
+  bool OnDictionaryBegin() override { return Count(); }
+  bool OnDictionaryKey(const StringPiece& key) override { return Count(); }
+  bool OnDictionaryEnd() override { return Count(); }
+  bool OnListBegin() override { return Count(); }
+  bool OnListEnd() override { return Count(); }
+
+  int count() const { return count_; }
+
+ private:
+  bool Count() {
+    ++count_;
+    return true;
+  }
+
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingHandler);
+};
+
+class JSONPerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    // About 5 MB.
+    corpus_ = BuildCorpus(5000);
+  }
+
+  void PrintTime(const std::string& trace, TimeDelta total) {
+    perf_test::PrintResult(
+        "json_read", StringPrintf("_%dKB", static_cast<int>(
+                                               corpus_.size() / 1024)),
+        trace, total.InMillisecondsF() / kNumIterations, "ms", true);
+  }
+
+ protected:
+  std::string corpus_;
+};
+
+TEST_F(JSONPerfTest, ReadToValue) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i) {
+    scoped_ptr<Value> value(JSONReader::Read(corpus_));
+    ASSERT_TRUE(value);
+  }
+  PrintTime("value_tree", TimeTicks::Now() - start);
+}
+
+TEST_F(JSONPerfTest, ReadWithHandler) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i) {
+    CountingHandler handler;
+    ASSERT_TRUE(JSONReader::ReadWithHandler(corpus_, JSON_PARSE_RFC, &handler,
+                                            NULL, NULL));
+  }
+  PrintTime("event_stream", TimeTicks::Now() - start);
+}
+
+TEST_F(JSONPerfTest, ConvertFromValue) {
+  JSONValueConverter<Response> converter;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i) {
+    scoped_ptr<Value> value(JSONReader::Read(corpus_));
+    Response response;
+    ASSERT_TRUE(converter.Convert(*value, &response));
+    ASSERT_EQ(5000u, response.apps.size());
+  }
+  PrintTime("convert_value_tree", TimeTicks::Now() - start);
+}
+
+TEST_F(JSONPerfTest, ConvertJSON) {
+  JSONValueConverter<Response> converter;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i) {
+    Response response;
+    ASSERT_TRUE(converter.ConvertJSON(corpus_, &response));
+    ASSERT_EQ(5000u, response.apps.size());
+    ASSERT_EQ(1u, response.apps.back()->packages.size());
+  }
+  PrintTime("convert_event_stream", TimeTicks::Now() - start);
+}
+
+}  // namespace
+
+}  // namespace base
@@ -29,6 +29,8 @@ const char JSONReader::kUnsupportedEncoding[] =
     "Unsupported encoding. JSON must be UTF-8.";
 const char JSONReader::kUnquotedDictionaryKey[] =
     "Dictionary keys must be quoted.";
+const char JSONReader::kParseAborted[] =
+    "Parsing stopped by the event handler.";
 
 JSONReader::JSONReader()
     : JSONReader(JSON_PARSE_RFC) {
@@ -72,6 +74,24 @@ Value* JSONReader::ReadAndReturnError(const StringPiece& json,
   return NULL;
 }
 
+// static
+bool JSONReader::ReadWithHandler(const StringPiece& json,
+                                 int options,
+                                 JSONEventHandler* handler,
+                                 int* error_code_out,
+                                 std::string* error_msg_out) {
+  internal::JSONParser parser(options);
+  if (parser.ParseWithHandler(json, handler))
+    return true;
+
+  if (error_code_out)
+    *error_code_out = parser.error_code();
+  if (error_msg_out)
+    *error_msg_out = parser.GetErrorMessage();
+
+  return false;
+}
+
 // static
 std::string JSONReader::ErrorCodeToString(JsonParseError error_code) {
   switch (error_code) {
@@ -93,6 +113,8 @@ std::string JSONReader::ErrorCodeToString(JsonParseError error_code) {
       return kUnsupportedEncoding;
     case JSON_UNQUOTED_DICTIONARY_KEY:
       return kUnquotedDictionaryKey;
+    case JSON_PARSE_ABORTED:
+      return kParseAborted;
     default:
       NOTREACHED();
       return std::string();
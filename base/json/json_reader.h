@@ -37,6 +37,7 @@
 
 namespace base {
 
+class JSONEventHandler;
 class Value;
 
 namespace internal {
@@ -71,6 +72,7 @@ class BASE_EXPORT JSONReader {
     JSON_UNEXPECTED_DATA_AFTER_ROOT,
     JSON_UNSUPPORTED_ENCODING,
     JSON_UNQUOTED_DICTIONARY_KEY,
+    JSON_PARSE_ABORTED,
     JSON_PARSE_ERROR_COUNT
   };
 
@@ -83,6 +85,7 @@ class BASE_EXPORT JSONReader {
   static const char kUnexpectedDataAfterRoot[];
   static const char kUnsupportedEncoding[];
   static const char kUnquotedDictionaryKey[];
+  static const char kParseAborted[];
 
   // Constructs a reader with the default options, JSON_PARSE_RFC.
   JSONReader();
@@ -110,6 +113,16 @@ class BASE_EXPORT JSONReader {
                                    int* error_code_out,
                                    std::string* error_msg_out);
 
+  // Reads and parses |json| like ReadAndReturnError(), but reports its
+  // contents to |handler| as they are read instead of building a Value. See
+  // json_event_handler.h. Returns true if the whole input was well-formed and
+  // |handler| never asked to stop.
+  static bool ReadWithHandler(const StringPiece& json,
+                              int options,  // JSONParserOptions
+                              JSONEventHandler* handler,
+                              int* error_code_out,
+                              std::string* error_msg_out);
+
   // Converts a JSON parse error code into a human readable message.
   // Returns an empty string if error_code is JSON_NO_ERROR.
   static std::string ErrorCodeToString(JsonParseError error_code);
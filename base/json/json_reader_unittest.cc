@@ -6,10 +6,12 @@
 
 #include "base/base_paths.h"
 #include "base/files/file_util.h"
+#include "base/json/json_event_handler.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
 #include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/values.h"
 #include "build/build_config.h"
@@ -17,6 +19,59 @@
 
 namespace base {
 
+namespace {
+
+// Records the events it receives as a string, and stops parsing after
+// |max_events| of them if that is not negative.
+class RecordingHandler : public JSONEventHandler {
+ public:
+  explicit RecordingHandler(int max_events)
+      : max_events_(max_events), num_events_(0) {}
+  ~RecordingHandler() override {}
+
+  bool OnNull() override { return Record("null"); }
+  bool OnBoolean(bool value) override {
+    return Record(value ? "true" : "false");
+  }
+  bool OnInteger(int value) override {
+    return Record(StringPrintf("int:%d", value));
+  }
+  bool OnDouble(double value) override {
+    return Record(StringPrintf("double:%g", value));
+  }
+  bool OnString(const StringPiece& value) override {
+    return Record("string:" + value.as_string());
+  }
+  bool OnDictionaryBegin() override { return Record("{"); }
+  bool OnDictionaryKey(const StringPiece& key) override {
+    return Record("key:" + key.as_string());
+  }
+  bool OnDictionaryEnd() override { return Record("}"); }
+  bool OnListBegin() override { return Record("["); }
+  bool OnListEnd() override { return Record("]"); }
+
+  const std::string& events() const { return events_; }
+
+ private:
+  bool Record(const std::string& event) {
+    if (max_events_ >= 0 && num_events_ == max_events_)
+      return false;
+    ++num_events_;
+    if (!events_.empty())
+      events_ += " ";
+    events_ += event;
+    return true;
+  }
+
+  const int max_events_;
+  int num_events_;
+  std::string events_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingHandler);
+};
+
+}  // namespace
+
 TEST(JSONReaderTest, Reading) {
   // some whitespace checking
   scoped_ptr<Value> root;
@@ -653,4 +708,81 @@ TEST(JSONReaderTest, IllegalTrailingNull) {
   EXPECT_EQ(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, reader.error_code());
 }
 
+TEST(JSONReaderTest, ReadWithHandler) {
+  const struct {
+    const char* json;
+    const char* events;
+  } kCases[] = {
+    {"null", "null"},
+    {" /* comment */ 42 ", "int:42"},
+    {"-1.5e3", "double:-1500"},
+    {"\"a\\tb\\u00e9\"", "string:a\tb\xc3\xa9"},
+    {"[]", "[ ]"},
+    {"{}", "{ }"},
+    {"{\"a\": [1, true, null], \"b\\n\": {\"c\": \"d\"}}",
+     "{ key:a [ int:1 true null ] key:b\n { key:c string:d } }"},
+    {"[[[false]], {}]", "[ [ [ false ] ] { } ]"},
+  };
+
+  for (size_t i = 0; i < arraysize(kCases); ++i) {
+    RecordingHandler handler(-1);
+    int error_code = 0;
+    std::string error_message;
+    EXPECT_TRUE(JSONReader::ReadWithHandler(kCases[i].json, JSON_PARSE_RFC,
+                                            &handler, &error_code,
+                                            &error_message))
+        << kCases[i].json << ": " << error_message;
+    EXPECT_EQ(kCases[i].events, handler.events());
+  }
+}
+
+TEST(JSONReaderTest, ReadWithHandlerErrors) {
+  // The same errors are reported as when building Values.
+  const char* const kInvalidJSON[] = {
+    "[1, 2",
+    "[1, 2,]",
+    "{\"a\": 1,}",
+    "{a: 1}",
+    "{\"a\" 1}",
+    "\"\\q\"",
+    "[1] [2]",
+    "01",
+    "tru",
+  };
+
+  for (size_t i = 0; i < arraysize(kInvalidJSON); ++i) {
+    JSONReader reader;
+    EXPECT_FALSE(reader.ReadToValue(kInvalidJSON[i]));
+
+    RecordingHandler handler(-1);
+    int error_code = 0;
+    std::string error_message;
+    EXPECT_FALSE(JSONReader::ReadWithHandler(kInvalidJSON[i], JSON_PARSE_RFC,
+                                             &handler, &error_code,
+                                             &error_message))
+        << kInvalidJSON[i];
+    EXPECT_EQ(reader.error_code(), error_code) << kInvalidJSON[i];
+    EXPECT_EQ(reader.GetErrorMessage(), error_message) << kInvalidJSON[i];
+  }
+
+  // Trailing commas are accepted with the option.
+  RecordingHandler handler(-1);
+  EXPECT_TRUE(JSONReader::ReadWithHandler(
+      "[1, {\"a\": 2,},]", JSON_ALLOW_TRAILING_COMMAS, &handler, NULL, NULL));
+  EXPECT_EQ("[ int:1 { key:a int:2 } ]", handler.events());
+}
+
+TEST(JSONReaderTest, ReadWithHandlerAborted) {
+  RecordingHandler handler(3);
+  int error_code = 0;
+  std::string error_message;
+  EXPECT_FALSE(JSONReader::ReadWithHandler("{\"a\": [1, 2]}", JSON_PARSE_RFC,
+                                           &handler, &error_code,
+                                           &error_message));
+  EXPECT_EQ("{ key:a [", handler.events());
+  EXPECT_EQ(JSONReader::JSON_PARSE_ABORTED, error_code);
+  EXPECT_EQ("Line: 1, column: 8, Parsing stopped by the event handler.",
+            error_message);
+}
+
 }  // namespace base
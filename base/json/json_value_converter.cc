@@ -32,6 +32,151 @@ bool BasicValueConverter<bool>::Convert(
   return value.GetAsBoolean(field);
 }
 
+ValueBuilderSink::ValueBuilderSink(base::Value* container)
+    : container_(container) {
+  DCHECK(!container_ || container_->IsType(Value::TYPE_LIST) ||
+         container_->IsType(Value::TYPE_DICTIONARY));
+}
+
+ValueBuilderSink::~ValueBuilderSink() {
+}
+
+bool ValueBuilderSink::OnKey(const StringPiece& key) {
+  key.CopyToString(&key_);
+  return true;
+}
+
+bool ValueBuilderSink::OnScalar(const base::Value& value) {
+  Add(value.DeepCopy());
+  return true;
+}
+
+bool ValueBuilderSink::OnContainer(bool is_list,
+                                   scoped_ptr<JSONContainerSink>* child) {
+  base::Value* value = is_list ? static_cast<base::Value*>(new ListValue)
+                               : new DictionaryValue;
+  Add(value);
+  child->reset(new ValueBuilderSink(value));
+  return true;
+}
+
+bool ValueBuilderSink::OnEnd() {
+  return true;
+}
+
+void ValueBuilderSink::Add(base::Value* value) {
+  ListValue* list = NULL;
+  DictionaryValue* dictionary = NULL;
+  if (container_->GetAsList(&list)) {
+    list->Append(value);
+  } else {
+    container_->GetAsDictionary(&dictionary);
+    dictionary->SetWithoutPathExpansion(key_, value);
+  }
+}
+
+ConvertingEventHandler::ConvertingEventHandler(
+    scoped_ptr<JSONContainerSink> root)
+    : root_(root.Pass()),
+      skip_depth_(0),
+      null_value_(Value::CreateNullValue()) {
+}
+
+ConvertingEventHandler::~ConvertingEventHandler() {
+}
+
+bool ConvertingEventHandler::OnNull() {
+  return OnScalar(*null_value_);
+}
+
+bool ConvertingEventHandler::OnBoolean(bool value) {
+  return OnScalar(FundamentalValue(value));
+}
+
+bool ConvertingEventHandler::OnInteger(int value) {
+  return OnScalar(FundamentalValue(value));
+}
+
+bool ConvertingEventHandler::OnDouble(double value) {
+  return OnScalar(FundamentalValue(value));
+}
+
+bool ConvertingEventHandler::OnString(const StringPiece& value) {
+  if (skip_depth_)
+    return true;
+  // The top-level value has to be a dictionary.
+  if (sinks_.empty())
+    return false;
+  return sinks_.back()->OnString(value);
+}
+
+bool ConvertingEventHandler::OnDictionaryBegin() {
+  return OnContainerBegin(false);
+}
+
+bool ConvertingEventHandler::OnDictionaryKey(const StringPiece& key) {
+  if (skip_depth_)
+    return true;
+  return sinks_.back()->OnKey(key);
+}
+
+bool ConvertingEventHandler::OnDictionaryEnd() {
+  return OnContainerEnd();
+}
+
+bool ConvertingEventHandler::OnListBegin() {
+  return OnContainerBegin(true);
+}
+
+bool ConvertingEventHandler::OnListEnd() {
+  return OnContainerEnd();
+}
+
+bool ConvertingEventHandler::OnScalar(const base::Value& value) {
+  if (skip_depth_)
+    return true;
+  // The top-level value has to be a dictionary.
+  if (sinks_.empty())
+    return false;
+  return sinks_.back()->OnScalar(value);
+}
+
+bool ConvertingEventHandler::OnContainerBegin(bool is_list) {
+  if (skip_depth_) {
+    ++skip_depth_;
+    return true;
+  }
+
+  if (sinks_.empty()) {
+    // The top-level value has to be a dictionary, and there is only one.
+    if (is_list || !root_)
+      return false;
+    sinks_.push_back(root_.release());
+    return true;
+  }
+
+  scoped_ptr<JSONContainerSink> child;
+  if (!sinks_.back()->OnContainer(is_list, &child))
+    return false;
+  if (child)
+    sinks_.push_back(child.release());
+  else
+    ++skip_depth_;
+  return true;
+}
+
+bool ConvertingEventHandler::OnContainerEnd() {
+  if (skip_depth_) {
+    --skip_depth_;
+    return true;
+  }
+
+  DCHECK(!sinks_.empty());
+  bool result = sinks_.back()->OnEnd();
+  sinks_.pop_back();
+  return result;
+}
+
 }  // namespace internal
 }  // namespace base
 
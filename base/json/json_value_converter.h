@@ -10,6 +10,8 @@
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
+#include "base/json/json_event_handler.h"
+#include "base/json/json_reader.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
@@ -83,6 +85,15 @@
 //           "your_enum", &Message::ye, &ConvertFunc);
 //     }
 //   };
+//
+// If the JSON is only needed to fill in the struct, ConvertJSON() can read it
+// directly instead of going through JSONReader first:
+//   converter.ConvertJSON(json_text, &message);
+// This never builds a Value tree for the whole input; unregistered fields are
+// skipped as they are read, and registered ones are converted as they are
+// found. Only RegisterCustomValueField() and RegisterRepeatedCustomValue()
+// fields whose JSON value is a dictionary or list still get a Value built for
+// that value.
 
 namespace base {
 
@@ -91,6 +102,103 @@ class JSONValueConverter;
 
 namespace internal {
 
+// Receives the contents of one dictionary or list when JSONValueConverter reads
+// JSON text directly. Scalars are handed over as Values on the stack so that
+// the ValueConverters below work unchanged.
+class JSONContainerSink {
+ public:
+  virtual ~JSONContainerSink() {}
+
+  // Called with the key of each dictionary entry, before its value.
+  virtual bool OnKey(const StringPiece& key) = 0;
+
+  // Called for each list element or dictionary value that is a scalar.
+  virtual bool OnScalar(const base::Value& value) = 0;
+
+  // Called instead of OnScalar() for strings, so that sinks that ignore a
+  // value do not pay for copying it into a StringValue.
+  virtual bool OnString(const StringPiece& value) {
+    return OnScalar(base::StringValue(value.as_string()));
+  }
+
+  // Called for each list element or dictionary value that is a dictionary or a
+  // list itself. Sets |*child| to the sink for its contents, or leaves it NULL
+  // to skip them.
+  virtual bool OnContainer(bool is_list,
+                           scoped_ptr<JSONContainerSink>* child) = 0;
+
+  // Called when the container is closed.
+  virtual bool OnEnd() = 0;
+};
+
+// Builds the Values for the contents of a container, for converters that only
+// work on whole Values.
+class BASE_EXPORT ValueBuilderSink : public JSONContainerSink {
+ public:
+  // |container| must be a ListValue or a DictionaryValue that outlives |this|.
+  explicit ValueBuilderSink(base::Value* container);
+  ~ValueBuilderSink() override;
+
+  bool OnKey(const StringPiece& key) override;
+  bool OnScalar(const base::Value& value) override;
+  bool OnContainer(bool is_list,
+                   scoped_ptr<JSONContainerSink>* child) override;
+  bool OnEnd() override;
+
+ private:
+  void Add(base::Value* value);
+
+  base::Value* container_;
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuilderSink);
+};
+
+// Routes the events from JSONReader::ReadWithHandler() to a stack of
+// JSONContainerSinks, starting with |root| for the top-level dictionary.
+class BASE_EXPORT ConvertingEventHandler : public JSONEventHandler {
+ public:
+  explicit ConvertingEventHandler(scoped_ptr<JSONContainerSink> root);
+  ~ConvertingEventHandler() override;
+
+  bool OnNull() override;
+  bool OnBoolean(bool value) override;
+  bool OnInteger(int value) override;
+  bool OnDouble(double value) override;
+  bool OnString(const StringPiece& value) override;
+  bool OnDictionaryBegin() override;
+  bool OnDictionaryKey(const StringPiece& key) override;
+  bool OnDictionaryEnd() override;
+  bool OnListBegin() override;
+  bool OnListEnd() override;
+
+ private:
+  bool OnScalar(const base::Value& value);
+  bool OnContainerBegin(bool is_list);
+  bool OnContainerEnd();
+
+  // Handed to |sinks_| when the top-level dictionary begins.
+  scoped_ptr<JSONContainerSink> root_;
+
+  // The sinks of the containers that are open, innermost last.
+  ScopedVector<JSONContainerSink> sinks_;
+
+  // Number of open containers, inside the innermost one in |sinks_|, that are
+  // being skipped.
+  int skip_depth_;
+
+  // Handed to OnScalar() for nulls, which cannot be created on the stack.
+  scoped_ptr<base::Value> null_value_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConvertingEventHandler);
+};
+
+template <typename StructType>
+class StructSink;
+
+template <typename FieldType>
+class ConvertingValueBuilderSink;
+
 template<typename StructType>
 class FieldConverterBase {
  public:
@@ -98,6 +206,12 @@ class FieldConverterBase {
   virtual ~FieldConverterBase() {}
   virtual bool ConvertField(const base::Value& value, StructType* obj)
       const = 0;
+  // Sets |*sink| to the sink that converts the field from a dictionary or list
+  // that is read from JSON text. Returns false if that cannot succeed.
+  virtual bool CreateContainerSink(bool is_list,
+                                   StructType* obj,
+                                   scoped_ptr<JSONContainerSink>* sink)
+      const = 0;
   const std::string& field_path() const { return field_path_; }
 
  private:
@@ -110,6 +224,43 @@ class ValueConverter {
  public:
   virtual ~ValueConverter() {}
   virtual bool Convert(const base::Value& value, FieldType* field) const = 0;
+
+  // Sets |*sink| to the sink that converts a dictionary or list read from JSON
+  // text into |field|. Returns false if that cannot succeed. By default the
+  // Value is built and passed to Convert() once it is complete.
+  virtual bool CreateContainerSink(bool is_list,
+                                   FieldType* field,
+                                   scoped_ptr<JSONContainerSink>* sink) const {
+    base::Value* root = is_list ? static_cast<base::Value*>(new ListValue)
+                                : new DictionaryValue;
+    sink->reset(new ConvertingValueBuilderSink<FieldType>(this, field, root));
+    return true;
+  }
+};
+
+// Builds a Value like ValueBuilderSink and converts it once it is complete.
+template <typename FieldType>
+class ConvertingValueBuilderSink : public ValueBuilderSink {
+ public:
+  // Takes ownership of |root|.
+  ConvertingValueBuilderSink(const ValueConverter<FieldType>* converter,
+                             FieldType* field,
+                             base::Value* root)
+      : ValueBuilderSink(root),
+        root_(root),
+        converter_(converter),
+        field_(field) {}
+
+  bool OnEnd() override {
+    return converter_->Convert(*root_, field_);
+  }
+
+ private:
+  scoped_ptr<base::Value> root_;
+  const ValueConverter<FieldType>* converter_;
+  FieldType* field_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConvertingValueBuilderSink);
 };
 
 template <typename StructType, typename FieldType>
@@ -128,6 +279,13 @@ class FieldConverter : public FieldConverterBase<StructType> {
     return value_converter_->Convert(value, &(dst->*field_pointer_));
   }
 
+  bool CreateContainerSink(bool is_list,
+                           StructType* dst,
+                           scoped_ptr<JSONContainerSink>* sink) const override {
+    return value_converter_->CreateContainerSink(
+        is_list, &(dst->*field_pointer_), sink);
+  }
+
  private:
   FieldType StructType::* field_pointer_;
   scoped_ptr<ValueConverter<FieldType> > value_converter_;
@@ -244,6 +402,15 @@ class NestedValueConverter : public ValueConverter<NestedType> {
     return converter_.Convert(value, field);
   }
 
+  bool CreateContainerSink(bool is_list,
+                           NestedType* field,
+                           scoped_ptr<JSONContainerSink>* sink) const override {
+    if (is_list)
+      return false;
+    sink->reset(new StructSink<NestedType>(&converter_, field, std::string()));
+    return true;
+  }
+
  private:
   JSONValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(NestedValueConverter);
@@ -279,7 +446,53 @@ class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> > {
     return true;
   }
 
+  bool CreateContainerSink(bool is_list,
+                           ScopedVector<Element>* field,
+                           scoped_ptr<JSONContainerSink>* sink) const override {
+    if (!is_list)
+      return false;
+    sink->reset(new RepeatedValueSink(&basic_converter_, field));
+    return true;
+  }
+
  private:
+  // Converts the elements of a list as they are read.
+  class RepeatedValueSink : public JSONContainerSink {
+   public:
+    RepeatedValueSink(const ValueConverter<Element>* converter,
+                      ScopedVector<Element>* field)
+        : converter_(converter), field_(field) {}
+
+    bool OnKey(const StringPiece& key) override {
+      NOTREACHED();
+      return false;
+    }
+
+    bool OnScalar(const base::Value& value) override {
+      scoped_ptr<Element> e(new Element);
+      if (!converter_->Convert(value, e.get())) {
+        DVLOG(1) << "failure at " << field_->size() << "-th element";
+        return false;
+      }
+      field_->push_back(e.release());
+      return true;
+    }
+
+    bool OnContainer(bool is_list,
+                     scoped_ptr<JSONContainerSink>* child) override {
+      DVLOG(1) << "failure at " << field_->size() << "-th element";
+      return false;
+    }
+
+    bool OnEnd() override { return true; }
+
+   private:
+    const ValueConverter<Element>* converter_;
+    ScopedVector<Element>* field_;
+
+    DISALLOW_COPY_AND_ASSIGN(RepeatedValueSink);
+  };
+
   BasicValueConverter<Element> basic_converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedValueConverter);
 };
@@ -313,7 +526,55 @@ class RepeatedMessageConverter
     return true;
   }
 
+  bool CreateContainerSink(bool is_list,
+                           ScopedVector<NestedType>* field,
+                           scoped_ptr<JSONContainerSink>* sink) const override {
+    if (!is_list)
+      return false;
+    sink->reset(new RepeatedMessageSink(&converter_, field));
+    return true;
+  }
+
  private:
+  // Converts the dictionaries in a list as they are read.
+  class RepeatedMessageSink : public JSONContainerSink {
+   public:
+    RepeatedMessageSink(const JSONValueConverter<NestedType>* converter,
+                        ScopedVector<NestedType>* field)
+        : converter_(converter), field_(field) {}
+
+    bool OnKey(const StringPiece& key) override {
+      NOTREACHED();
+      return false;
+    }
+
+    bool OnScalar(const base::Value& value) override {
+      DVLOG(1) << "failure at " << field_->size() << "-th element";
+      return false;
+    }
+
+    bool OnContainer(bool is_list,
+                     scoped_ptr<JSONContainerSink>* child) override {
+      if (is_list) {
+        DVLOG(1) << "failure at " << field_->size() << "-th element";
+        return false;
+      }
+      // Like Convert(), |field_| is modified even if the element later fails.
+      field_->push_back(new NestedType);
+      child->reset(new StructSink<NestedType>(converter_, field_->back(),
+                                              std::string()));
+      return true;
+    }
+
+    bool OnEnd() override { return true; }
+
+   private:
+    const JSONValueConverter<NestedType>* converter_;
+    ScopedVector<NestedType>* field_;
+
+    DISALLOW_COPY_AND_ASSIGN(RepeatedMessageSink);
+  };
+
   JSONValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedMessageConverter);
 };
@@ -355,6 +616,90 @@ class RepeatedCustomValueConverter
   DISALLOW_COPY_AND_ASSIGN(RepeatedCustomValueConverter);
 };
 
+// Converts the entries of a dictionary into the registered fields of a struct
+// as they are read. Entries of unregistered keys are skipped.
+template <typename StructType>
+class StructSink : public JSONContainerSink {
+ public:
+  // |path_prefix| is empty for the dictionary that maps to |obj| itself, or
+  // the dotted path of a nested dictionary followed by a '.', for fields
+  // registered with a path like "foo.bar".
+  StructSink(const JSONValueConverter<StructType>* converter,
+             StructType* obj,
+             const std::string& path_prefix)
+      : converter_(converter),
+        obj_(obj),
+        path_prefix_(path_prefix),
+        field_(NULL) {}
+
+  bool OnKey(const StringPiece& key) override {
+    field_ = NULL;
+    nested_path_prefix_.clear();
+    // Like DictionaryValue::Get(), which Convert() uses, only match paths
+    // component by component.
+    if (key.find('.') != StringPiece::npos)
+      return true;
+    const size_t path_length = path_prefix_.size() + key.size();
+    for (size_t i = 0; i < converter_->fields_.size(); ++i) {
+      const std::string& path = converter_->fields_[i]->field_path();
+      if (path.size() < path_length ||
+          path.compare(0, path_prefix_.size(), path_prefix_) != 0 ||
+          path.compare(path_prefix_.size(), key.size(), key.data(),
+                       key.size()) != 0) {
+        continue;
+      }
+      if (path.size() == path_length) {
+        field_ = converter_->fields_[i];
+        return true;
+      }
+      if (path[path_length] == '.')
+        nested_path_prefix_ = path.substr(0, path_length + 1);
+    }
+    return true;
+  }
+
+  bool OnScalar(const base::Value& value) override {
+    if (field_ && !field_->ConvertField(value, obj_)) {
+      DVLOG(1) << "failure at field " << field_->field_path();
+      return false;
+    }
+    return true;
+  }
+
+  bool OnString(const StringPiece& value) override {
+    return !field_ || JSONContainerSink::OnString(value);
+  }
+
+  bool OnContainer(bool is_list,
+                   scoped_ptr<JSONContainerSink>* child) override {
+    if (field_) {
+      if (!field_->CreateContainerSink(is_list, obj_, child)) {
+        DVLOG(1) << "failure at field " << field_->field_path();
+        return false;
+      }
+    } else if (!nested_path_prefix_.empty() && !is_list) {
+      child->reset(
+          new StructSink<StructType>(converter_, obj_, nested_path_prefix_));
+    }
+    return true;
+  }
+
+  bool OnEnd() override { return true; }
+
+ private:
+  const JSONValueConverter<StructType>* converter_;
+  StructType* obj_;
+  const std::string path_prefix_;
+
+  // The field that the value of the current entry maps to, if any.
+  const FieldConverterBase<StructType>* field_;
+
+  // If some field paths continue below the current entry, its full path
+  // followed by a '.'. Empty otherwise.
+  std::string nested_path_prefix_;
+
+  DISALLOW_COPY_AND_ASSIGN(StructSink);
+};
 
 }  // namespace internal
 
@@ -507,7 +852,23 @@ class JSONValueConverter {
     return true;
   }
 
+  // Like Convert(), but reads the JSON text |json| as it goes instead of a
+  // Value. Also returns false if |json| is not a well-formed JSON dictionary.
+  // Fields are converted in the order they appear in |json|; if a key occurs
+  // more than once, each occurrence is converted, whereas a Value would only
+  // keep the last one.
+  bool ConvertJSON(const StringPiece& json, StructType* output) const {
+    internal::ConvertingEventHandler handler(
+        scoped_ptr<internal::JSONContainerSink>(
+            new internal::StructSink<StructType>(this, output,
+                                                 std::string())));
+    return JSONReader::ReadWithHandler(json, JSON_PARSE_RFC, &handler, NULL,
+                                       NULL);
+  }
+
  private:
+  friend class internal::StructSink<StructType>;
+
   ScopedVector<internal::FieldConverterBase<StructType> > fields_;
 
   DISALLOW_COPY_AND_ASSIGN(JSONValueConverter);
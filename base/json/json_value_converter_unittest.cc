@@ -92,6 +92,21 @@ struct NestedMessage {
   }
 };
 
+// For fields registered with a dotted path.
+struct DottedPathMessage {
+  int inner_foo;
+  std::string deep_bar;
+
+  DottedPathMessage() : inner_foo(0) {}
+
+  static void RegisterJSONConverter(
+      base::JSONValueConverter<DottedPathMessage>* converter) {
+    converter->RegisterIntField("inner.foo", &DottedPathMessage::inner_foo);
+    converter->RegisterStringField("inner.deep.bar",
+                                   &DottedPathMessage::deep_bar);
+  }
+};
+
 }  // namespace
 
 TEST(JSONValueConverterTest, ParseSimpleMessage) {
@@ -253,4 +268,145 @@ TEST(JSONValueConverterTest, RepeatedValueErrorInTheMiddle) {
   // No check the values as mentioned above.
 }
 
+TEST(JSONValueConverterTest, ConvertJSONSimpleMessage) {
+  const char normal_data[] =
+      "{\n"
+      "  \"foo\": 1,\n"
+      "  \"unknown\": {\"foo\": [2, \"bar\", {}]},\n"
+      "  \"bar\": \"b\\u0061r\",\n"
+      "  \"baz\": true,\n"
+      "  \"bstruct\": {},\n"
+      "  \"string_values\": [{\"val\": \"value_1\"}, {\"val\": \"value_2\"}],"
+      "  \"simple_enum\": \"bar\","
+      "  \"ints\": [1, 2]"
+      "}\n";
+
+  SimpleMessage message;
+  base::JSONValueConverter<SimpleMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  EXPECT_EQ(1, message.foo);
+  EXPECT_EQ("bar", message.bar);
+  EXPECT_TRUE(message.baz);
+  EXPECT_TRUE(message.bstruct);
+  EXPECT_EQ(SimpleMessage::BAR, message.simple_enum);
+  ASSERT_EQ(2U, message.ints.size());
+  EXPECT_EQ(1, *(message.ints[0]));
+  EXPECT_EQ(2, *(message.ints[1]));
+  ASSERT_EQ(2U, message.string_values.size());
+  EXPECT_EQ("value_1", *message.string_values[0]);
+  EXPECT_EQ("value_2", *message.string_values[1]);
+}
+
+TEST(JSONValueConverterTest, ConvertJSONNestedMessage) {
+  const char normal_data[] =
+      "{\n"
+      "  \"foo\": 1.5,\n"
+      "  \"child\": {\n"
+      "    \"foo\": 1,\n"
+      "    \"bar\": \"bar\",\n"
+      "    \"baz\": true\n"
+      "  },\n"
+      "  \"children\": [{\n"
+      "    \"foo\": 2,\n"
+      "    \"bar\": \"foobar\",\n"
+      "    \"bstruct\": \"\",\n"
+      "    \"string_values\": [{\"val\": \"value_1\"}],"
+      "    \"baz\": true\n"
+      "  },\n"
+      "  {\n"
+      "    \"foo\": 3,\n"
+      "    \"bar\": \"barbaz\"\n"
+      "  }]\n"
+      "}\n";
+
+  NestedMessage message;
+  base::JSONValueConverter<NestedMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  EXPECT_EQ(1.5, message.foo);
+  EXPECT_EQ(1, message.child.foo);
+  EXPECT_EQ("bar", message.child.bar);
+  EXPECT_TRUE(message.child.baz);
+  EXPECT_FALSE(message.child.bstruct);
+
+  ASSERT_EQ(2U, message.children.size());
+  const SimpleMessage* first_child = message.children[0];
+  EXPECT_EQ(2, first_child->foo);
+  EXPECT_EQ("foobar", first_child->bar);
+  EXPECT_TRUE(first_child->baz);
+  EXPECT_TRUE(first_child->bstruct);
+  ASSERT_EQ(1U, first_child->string_values.size());
+  EXPECT_EQ("value_1", *first_child->string_values[0]);
+
+  const SimpleMessage* second_child = message.children[1];
+  EXPECT_EQ(3, second_child->foo);
+  EXPECT_EQ("barbaz", second_child->bar);
+  EXPECT_FALSE(second_child->baz);
+  EXPECT_FALSE(second_child->bstruct);
+}
+
+TEST(JSONValueConverterTest, ConvertJSONDottedPaths) {
+  const char normal_data[] =
+      "{\n"
+      "  \"inner\": {\n"
+      "    \"foo\": 7,\n"
+      "    \"deep\": {\"bar\": \"deep_bar\", \"baz\": 1},\n"
+      "    \"other\": [1, 2]\n"
+      "  },\n"
+      "  \"inner.foo\": \"not an int\"\n"
+      "}\n";
+
+  // Both paths agree on what "inner.foo" means.
+  scoped_ptr<Value> value(base::JSONReader::Read(normal_data));
+  DottedPathMessage value_message;
+  base::JSONValueConverter<DottedPathMessage> converter;
+  EXPECT_TRUE(converter.Convert(*value.get(), &value_message));
+  EXPECT_EQ(7, value_message.inner_foo);
+  EXPECT_EQ("deep_bar", value_message.deep_bar);
+
+  DottedPathMessage message;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+  EXPECT_EQ(7, message.inner_foo);
+  EXPECT_EQ("deep_bar", message.deep_bar);
+}
+
+TEST(JSONValueConverterTest, ConvertJSONFailures) {
+  base::JSONValueConverter<SimpleMessage> converter;
+  const char* const failures[] = {
+    // Not a dictionary at the top level.
+    "[{\"foo\": 1}]",
+    "1",
+    // Malformed JSON.
+    "{\"foo\": 1",
+    "{\"foo\": 1} 2",
+    // Type mismatches.
+    "{\"bar\": 2}",
+    "{\"bar\": [\"bar\"]}",
+    "{\"ints\": {\"a\": 1}}",
+    "{\"ints\": [1, false]}",
+    "{\"ints\": [1, [2]]}",
+    "{\"simple_enum\": \"baz\"}",
+    "{\"string_values\": [{\"val\": 1}]}",
+  };
+  for (size_t i = 0; i < arraysize(failures); ++i) {
+    SimpleMessage message;
+    EXPECT_FALSE(converter.ConvertJSON(failures[i], &message)) << failures[i];
+  }
+
+  base::JSONValueConverter<NestedMessage> nested_converter;
+  const char* const nested_failures[] = {
+    "{\"child\": [1]}",
+    "{\"child\": {\"foo\": \"1\"}}",
+    "{\"children\": [1]}",
+    "{\"children\": [[]]}",
+    "{\"children\": [{\"bar\": 1}]}",
+  };
+  for (size_t i = 0; i < arraysize(nested_failures); ++i) {
+    NestedMessage message;
+    EXPECT_FALSE(nested_converter.ConvertJSON(nested_failures[i], &message))
+        << nested_failures[i];
+  }
+}
+
 }  // namespace base
@@ -26,6 +26,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "base/cpu.h"
+#include "base/hash_x86.h"
+#include "base/lazy_instance.h"
+
 namespace {
 
 struct Context {
@@ -146,6 +150,31 @@ void MD5Transform(uint32_t buf[4], const uint32_t in[16]) {
   buf[3] += d;
 }
 
+#if defined(BASE_HASH_X86_KERNELS)
+const uint32_t kMD5InitialState[] = {
+  0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+};
+
+/*
+ * Hashes several messages at once with AVX2 when the CPU supports it.
+ */
+struct MD5Kernels {
+  MD5Kernels() : use_avx2(base::CPU().has_avx2()) {
+    hash.state_words = 4;
+    hash.initial_state = kMD5InitialState;
+    hash.big_endian = false;
+    hash.process_blocks = NULL;
+    hash.process_lanes = base::internal::MD5ProcessLanesAVX2;
+  }
+
+  bool use_avx2;
+  base::internal::BlockHash hash;
+};
+
+base::LazyInstance<MD5Kernels>::Leaky g_md5_kernels =
+    LAZY_INSTANCE_INITIALIZER;
+#endif  // defined(BASE_HASH_X86_KERNELS)
+
 }  // namespace
 
 namespace base {
@@ -293,6 +322,25 @@ void MD5Sum(const void* data, size_t length, MD5Digest* digest) {
   MD5Final(digest, &ctx);
 }
 
+void MD5SumMany(const void* const data[],
+                const size_t lengths[],
+                size_t count,
+                MD5Digest digests[]) {
+#if defined(BASE_HASH_X86_KERNELS)
+  const MD5Kernels& kernels = g_md5_kernels.Get();
+  if (kernels.use_avx2) {
+    COMPILE_ASSERT(sizeof(MD5Digest) == 16, md5_digest_must_be_packed);
+    internal::HashBytesMany(
+        kernels.hash, reinterpret_cast<const uint8_t* const*>(data), lengths,
+        count, reinterpret_cast<uint8_t*>(digests));
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < count; i++)
+    MD5Sum(data[i], lengths[i], &digests[i]);
+}
+
 std::string MD5String(const StringPiece& str) {
   MD5Digest digest;
   MD5Sum(str.data(), str.length(), &digest);
@@ -46,6 +46,15 @@ typedef char MD5Context[88];
 // The given 'digest' structure will be filled with the result data.
 BASE_EXPORT void MD5Sum(const void* data, size_t length, MD5Digest* digest);
 
+// Computes the MD5 sums of the |count| buffers |data[i]| of |lengths[i]|
+// bytes and fills in |digests[i]| with them. On some CPUs this is several
+// times faster than calling MD5Sum() for each buffer, especially when they are
+// short and of similar lengths.
+BASE_EXPORT void MD5SumMany(const void* const data[],
+                            const size_t lengths[],
+                            size_t count,
+                            MD5Digest digests[]);
+
 // Initializes the given MD5 context structure for subsequent calls to
 // MD5Update().
 BASE_EXPORT void MD5Init(MD5Context* context);
@@ -249,4 +249,30 @@ TEST(MD5, IntermediateFinal) {
   EXPECT_FALSE(!memcmp(&digest, &header_digest, sizeof(digest)));
 }
 
+TEST(MD5, MD5SumMany) {
+  // Inputs of every length up to a few blocks, in groups that don't fill the
+  // lanes of the multi-buffer kernels evenly.
+  const size_t kNumInputs = 203;
+  std::string inputs[kNumInputs];
+  const void* data[kNumInputs];
+  size_t lengths[kNumInputs];
+  for (size_t i = 0; i < kNumInputs; i++) {
+    for (size_t j = 0; j < i; j++)
+      inputs[i].push_back(static_cast<char>(i * 31 + j));
+    data[i] = inputs[i].data();
+    lengths[i] = inputs[i].length();
+  }
+
+  MD5Digest digests[kNumInputs];
+  for (size_t count = 0; count <= kNumInputs; count += 67) {
+    MD5SumMany(data, lengths, count, digests);
+    for (size_t i = 0; i < count; i++) {
+      MD5Digest digest;
+      MD5Sum(inputs[i].data(), inputs[i].length(), &digest);
+      EXPECT_EQ(MD5DigestToBase16(digest), MD5DigestToBase16(digests[i]))
+          << "input " << i;
+    }
+  }
+}
+
 }  // namespace base
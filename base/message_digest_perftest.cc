@@ -0,0 +1,100 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/md5.h"
+#include "base/sha1.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Total number of bytes hashed by each measurement.
+const size_t kBytesPerTest = 64 << 20;
+
+class MessageDigestPerfTest : public testing::Test {
+ public:
+  // Sets up enough inputs of |size| bytes to add up to kBytesPerTest.
+  void MakeInputs(size_t size) {
+    size_t count = kBytesPerTest / size;
+    std::string input(size, 'a');
+    for (size_t i = 0; i < size; ++i)
+      input[i] = static_cast<char>(i * 7);
+    inputs_.assign(count, input);
+    data_.resize(count);
+    lengths_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      data_[i] = reinterpret_cast<const unsigned char*>(inputs_[i].data());
+      lengths_[i] = size;
+    }
+  }
+
+  void PrintThroughput(const std::string& hash,
+                       size_t size,
+                       const std::string& trace,
+                       TimeDelta elapsed) {
+    perf_test::PrintResult(
+        hash, StringPrintf("_%d_bytes", static_cast<int>(size)), trace,
+        kBytesPerTest / elapsed.InSecondsF() / (1 << 20), "MB/s", true);
+  }
+
+  void RunSHA1(size_t size) {
+    MakeInputs(size);
+    std::vector<unsigned char> hashes(inputs_.size() * kSHA1Length);
+    TimeTicks start = TimeTicks::Now();
+    for (size_t i = 0; i < inputs_.size(); ++i)
+      SHA1HashBytes(data_[i], lengths_[i], &hashes[i * kSHA1Length]);
+    PrintThroughput("sha1", size, "one_at_a_time", TimeTicks::Now() - start);
+
+    start = TimeTicks::Now();
+    SHA1HashBytesMany(&data_[0], &lengths_[0], inputs_.size(), &hashes[0]);
+    PrintThroughput("sha1", size, "many", TimeTicks::Now() - start);
+  }
+
+  void RunMD5(size_t size) {
+    MakeInputs(size);
+    std::vector<MD5Digest> digests(inputs_.size());
+    TimeTicks start = TimeTicks::Now();
+    for (size_t i = 0; i < inputs_.size(); ++i)
+      MD5Sum(data_[i], lengths_[i], &digests[i]);
+    PrintThroughput("md5", size, "one_at_a_time", TimeTicks::Now() - start);
+
+    std::vector<const void*> data(data_.begin(), data_.end());
+    start = TimeTicks::Now();
+    MD5SumMany(&data[0], &lengths_[0], inputs_.size(), &digests[0]);
+    PrintThroughput("md5", size, "many", TimeTicks::Now() - start);
+  }
+
+ private:
+  std::vector<std::string> inputs_;
+  std::vector<const unsigned char*> data_;
+  std::vector<size_t> lengths_;
+};
+
+// Cache keys and URLs are typically this short.
+TEST_F(MessageDigestPerfTest, SHA1Short) {
+  RunSHA1(64);
+}
+
+TEST_F(MessageDigestPerfTest, SHA1Long) {
+  RunSHA1(64 << 10);
+}
+
+TEST_F(MessageDigestPerfTest, MD5Short) {
+  RunMD5(64);
+}
+
+TEST_F(MessageDigestPerfTest, MD5Long) {
+  RunMD5(64 << 10);
+}
+
+}  // namespace
+
+}  // namespace base
@@ -10,6 +10,7 @@
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram.h"
 #include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -39,12 +40,23 @@ bool AlwaysNotifyPump(MessageLoop::Type type) {
 
 }  // namespace
 
+IncomingTaskQueue::Node::Node(const PendingTask& pending_task)
+    : next(0),
+      task(pending_task) {
+}
+
 IncomingTaskQueue::IncomingTaskQueue(MessageLoop* message_loop)
     : high_res_task_count_(0),
+      queue_head_(0),
+      queue_tail_(new Node(PendingTask(FROM_HERE, Closure()))),
       message_loop_(message_loop),
+      accepting_tasks_(1),
+      active_posters_(0),
       next_sequence_num_(0),
-      message_loop_scheduled_(false),
+      message_loop_scheduled_(0),
       always_schedule_work_(AlwaysNotifyPump(message_loop_->type())) {
+  subtle::NoBarrier_Store(&queue_head_,
+                          reinterpret_cast<subtle::AtomicWord>(queue_tail_));
 }
 
 bool IncomingTaskQueue::AddToIncomingQueue(
@@ -57,7 +69,6 @@ bool IncomingTaskQueue::AddToIncomingQueue(
       << "Requesting super-long task delay period of " << delay.InSeconds()
       << " seconds from here: " << from_here.ToString();
 
-  AutoLock locked(incoming_queue_lock_);
   PendingTask pending_task(
       from_here, task, CalculateDelayedRuntime(delay), nestable);
 #if defined(OS_WIN)
@@ -67,7 +78,7 @@ bool IncomingTaskQueue::AddToIncomingQueue(
   // resolution on Windows is between 10 and 15ms.
   if (delay > TimeDelta() &&
       delay.InMilliseconds() < (2 * Time::kMinLowResolutionThresholdMs)) {
-    ++high_res_task_count_;
+    subtle::NoBarrier_AtomicIncrement(&high_res_task_count_, 1);
     pending_task.is_high_res = true;
   }
 #endif
@@ -75,43 +86,78 @@ bool IncomingTaskQueue::AddToIncomingQueue(
 }
 
 bool IncomingTaskQueue::HasHighResolutionTasks() {
-  AutoLock lock(incoming_queue_lock_);
-  return high_res_task_count_ > 0;
+  return subtle::NoBarrier_Load(&high_res_task_count_) > 0;
 }
 
 bool IncomingTaskQueue::IsIdleForTesting() {
-  AutoLock lock(incoming_queue_lock_);
-  return incoming_queue_.empty();
+  return subtle::Acquire_Load(&queue_head_) ==
+         reinterpret_cast<subtle::AtomicWord>(queue_tail_);
 }
 
 int IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  AutoLock lock(incoming_queue_lock_);
-  if (incoming_queue_.empty()) {
+  // Only take the tasks that had been posted when the reload started, so that
+  // a steady stream of posts from other threads cannot keep the loop in here.
+  Node* last = reinterpret_cast<Node*>(subtle::Acquire_Load(&queue_head_));
+  for (;;) {
+    while (queue_tail_ != last) {
+      Node* next = reinterpret_cast<Node*>(
+          subtle::Acquire_Load(&queue_tail_->next));
+      // A poster has swapped itself in as the head but not linked its node in
+      // yet. It will be picked up by a later reload.
+      if (!next)
+        break;
+      work_queue->push(next->task);
+      next->task.task.Reset();
+      delete queue_tail_;
+      queue_tail_ = next;
+    }
+    if (!work_queue->empty())
+      break;
+
     // If the loop attempts to reload but there are no tasks in the incoming
     // queue, that means it will go to sleep waiting for more work. If the
     // incoming queue becomes nonempty we need to schedule it again.
-    message_loop_scheduled_ = false;
-  } else {
-    incoming_queue_.Swap(work_queue);
+    subtle::NoBarrier_Store(&message_loop_scheduled_, 0);
+    subtle::MemoryBarrier();
+
+    // A task linked in after the drain above may have seen the flag still set
+    // and skipped ScheduleWork(). Either that poster sees the cleared flag, or
+    // we see its node here; in the latter case take the flag back and reload,
+    // unless a poster has already scheduled the loop again.
+    if (!HasLinkedNode() ||
+        subtle::NoBarrier_CompareAndSwap(&message_loop_scheduled_, 0, 1) != 0) {
+      break;
+    }
+    last = reinterpret_cast<Node*>(subtle::Acquire_Load(&queue_head_));
   }
   // Reset the count of high resolution tasks since our queue is now empty.
-  int high_res_tasks = high_res_task_count_;
-  high_res_task_count_ = 0;
-  return high_res_tasks;
+  return subtle::NoBarrier_AtomicExchange(&high_res_task_count_, 0);
 }
 
 void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
-  AutoLock lock(incoming_queue_lock_);
+  subtle::NoBarrier_Store(&accepting_tasks_, 0);
+  subtle::MemoryBarrier();
+  // Posts that got in before the store above may still be using
+  // |message_loop_|. They are short, so just wait for them to leave.
+  while (subtle::Acquire_Load(&active_posters_) != 0)
+    PlatformThread::YieldCurrentThread();
   message_loop_ = NULL;
 }
 
 IncomingTaskQueue::~IncomingTaskQueue() {
   // Verify that WillDestroyCurrentMessageLoop() has been called.
   DCHECK(!message_loop_);
+
+  // Nobody can post anymore, so every node is linked in by now.
+  while (queue_tail_) {
+    Node* next = reinterpret_cast<Node*>(
+        subtle::Acquire_Load(&queue_tail_->next));
+    delete queue_tail_;
+    queue_tail_ = next;
+  }
 }
 
 TimeTicks IncomingTaskQueue::CalculateDelayedRuntime(TimeDelta delay) {
@@ -128,10 +174,12 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  // This should only be called while the lock is taken.
-  incoming_queue_lock_.AssertAcquired();
-
-  if (!message_loop_) {
+  // Announce ourselves before looking at |accepting_tasks_|. This pairs with
+  // WillDestroyCurrentMessageLoop(): either it waits for us to leave, or we
+  // see that the loop is going away and never touch |message_loop_|.
+  subtle::Barrier_AtomicIncrement(&active_posters_, 1);
+  if (!subtle::Acquire_Load(&accepting_tasks_)) {
+    subtle::Barrier_AtomicIncrement(&active_posters_, -1);
     pending_task->task.Reset();
     return false;
   }
@@ -139,28 +187,52 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   // Initialize the sequence number. The sequence number is used for delayed
   // tasks (to faciliate FIFO sorting when two tasks have the same
   // delayed_run_time value) and for identifying the task in about:tracing.
-  pending_task->sequence_num = next_sequence_num_++;
+  pending_task->sequence_num =
+      subtle::NoBarrier_AtomicIncrement(&next_sequence_num_, 1) - 1;
 
   message_loop_->task_annotator()->DidQueueTask("MessageLoop::PostTask",
                                                 *pending_task);
 
-  bool was_empty = incoming_queue_.empty();
-  incoming_queue_.push(*pending_task);
+  Push(new Node(*pending_task));
   pending_task->task.Reset();
 
-  if (always_schedule_work_ || (!message_loop_scheduled_ && was_empty)) {
-    // Wake up the message loop.
+  if (always_schedule_work_ || TryMarkScheduled()) {
+    // Wake up the message loop. After we've scheduled the message loop, we do
+    // not need to do so again until we know it has processed all of the work
+    // in our queue and is waiting for more work again. The message loop will
+    // always attempt to reload from the incoming queue before waiting again so
+    // we clear the flag in ReloadWorkQueue().
     message_loop_->ScheduleWork();
-    // After we've scheduled the message loop, we do not need to do so again
-    // until we know it has processed all of the work in our queue and is
-    // waiting for more work again. The message loop will always attempt to
-    // reload from the incoming queue before waiting again so we clear this flag
-    // in ReloadWorkQueue().
-    message_loop_scheduled_ = true;
   }
 
+  subtle::Barrier_AtomicIncrement(&active_posters_, -1);
   return true;
 }
 
+void IncomingTaskQueue::Push(Node* node) {
+  // Make sure the node is fully constructed before other posters can link
+  // behind it.
+  subtle::MemoryBarrier();
+  Node* prev = reinterpret_cast<Node*>(subtle::NoBarrier_AtomicExchange(
+      &queue_head_, reinterpret_cast<subtle::AtomicWord>(node)));
+  // Until this store lands the loop sees the queue end at |prev|.
+  subtle::Release_Store(&prev->next,
+                        reinterpret_cast<subtle::AtomicWord>(node));
+}
+
+bool IncomingTaskQueue::HasLinkedNode() const {
+  return subtle::Acquire_Load(&queue_tail_->next) != 0;
+}
+
+bool IncomingTaskQueue::TryMarkScheduled() {
+  // Order the link made by Push() before the load of the flag; see the
+  // matching barrier in ReloadWorkQueue().
+  subtle::MemoryBarrier();
+  // Plain load first so that the common "already scheduled" case does not
+  // bounce the cache line between posters.
+  return subtle::NoBarrier_Load(&message_loop_scheduled_) == 0 &&
+         subtle::NoBarrier_CompareAndSwap(&message_loop_scheduled_, 0, 1) == 0;
+}
+
 }  // namespace internal
 }  // namespace base
@@ -5,10 +5,10 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/memory/ref_counted.h"
 #include "base/pending_task.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -21,6 +21,12 @@ namespace internal {
 // Implements a queue of tasks posted to the message loop running on the current
 // thread. This class takes care of synchronizing posting tasks from different
 // threads and together with MessageLoop ensures clean shutdown.
+//
+// Posting does not take a lock: tasks are appended to an intrusive
+// multi-producer single-consumer linked list with a single atomic exchange,
+// and the thread running the loop detaches them in batches from
+// ReloadWorkQueue(). The message loop is only woken up when the queue goes
+// from empty (as last observed by the loop) to non-empty.
 class BASE_EXPORT IncomingTaskQueue
     : public RefCountedThreadSafe<IncomingTaskQueue> {
  public:
@@ -42,10 +48,11 @@ class BASE_EXPORT IncomingTaskQueue
   // timer resolution. Currently only needed for Windows.
   bool HasHighResolutionTasks();
 
-  // Returns true if the message loop is "idle". Provided for testing.
+  // Returns true if the message loop is "idle". Provided for testing. Must be
+  // called from the thread that is running the loop.
   bool IsIdleForTesting();
 
-  // Loads tasks from the |incoming_queue_| into |*work_queue|. Must be called
+  // Loads tasks from the incoming queue into |*work_queue|. Must be called
   // from the thread that is running the loop. Returns the number of tasks that
   // require high resolution timers.
   int ReloadWorkQueue(TaskQueue* work_queue);
@@ -60,33 +67,67 @@ class BASE_EXPORT IncomingTaskQueue
   // Calculates the time at which a PendingTask should run.
   TimeTicks CalculateDelayedRuntime(TimeDelta delay);
 
-  // Adds a task to |incoming_queue_|. The caller retains ownership of
+  // Adds a task to the incoming queue. The caller retains ownership of
   // |pending_task|, but this function will reset the value of
   // |pending_task->task|. This is needed to ensure that the posting call stack
   // does not retain |pending_task->task| beyond this function call.
   bool PostPendingTask(PendingTask* pending_task);
 
+  // A link in the incoming queue. The node at |queue_tail_| is always a
+  // placeholder whose task has already been handed to the loop (or the
+  // initial stub); the tasks waiting to be loaded live in the nodes after it.
+  struct Node {
+    explicit Node(const PendingTask& pending_task);
+
+    // Points to the next Node, or is zero if this is the most recently
+    // appended one.
+    subtle::AtomicWord next;
+    PendingTask task;
+  };
+
+  // Appends |node| to the queue. Safe to call from any thread.
+  void Push(Node* node);
+
+  // Returns true if the queue holds a node that the loop can detach right now.
+  // Must be called from the thread that is running the loop.
+  bool HasLinkedNode() const;
+
+  // Tries to claim responsibility for waking up the loop. Returns true if the
+  // caller won and must call ScheduleWork() (or reload again if it is the
+  // loop itself).
+  bool TryMarkScheduled();
+
   // Number of tasks that require high resolution timing. This value is kept
   // so that ReloadWorkQueue() completes in constant time.
-  int high_res_task_count_;
+  subtle::Atomic32 high_res_task_count_;
 
-  // The lock that protects access to the members of this class.
-  base::Lock incoming_queue_lock_;
+  // The most recently appended node. Producers swap themselves in here.
+  subtle::AtomicWord queue_head_;
 
-  // An incoming queue of tasks that are acquired under a mutex for processing
-  // on this instance's thread. These tasks have not yet been been pushed to
-  // |message_loop_|.
-  TaskQueue incoming_queue_;
+  // The oldest node, which is always a placeholder. Only touched by the thread
+  // running the loop.
+  Node* queue_tail_;
 
-  // Points to the message loop that owns |this|.
+  // Points to the message loop that owns |this|. Only dereferenced by posting
+  // threads that are counted in |active_posters_| and have seen
+  // |accepting_tasks_| set.
   MessageLoop* message_loop_;
 
+  // Non-zero until WillDestroyCurrentMessageLoop() is called.
+  subtle::Atomic32 accepting_tasks_;
+
+  // Number of threads currently inside PostPendingTask(). Together with
+  // |accepting_tasks_| this lets WillDestroyCurrentMessageLoop() wait for
+  // in-flight posts before |message_loop_| goes away, without posts having to
+  // take a lock.
+  subtle::Atomic32 active_posters_;
+
   // The next sequence number to use for delayed tasks.
-  int next_sequence_num_;
+  subtle::Atomic32 next_sequence_num_;
 
-  // True if our message loop has already been scheduled and does not need to be
-  // scheduled again until an empty reload occurs.
-  bool message_loop_scheduled_;
+  // Non-zero if our message loop has already been scheduled and does not need
+  // to be scheduled again until an empty reload occurs.
+  subtle::Atomic32 message_loop_scheduled_;
 
   // True if we always need to call ScheduleWork when receiving a new task, even
   // if the incoming queue was not empty.
@@ -561,7 +561,7 @@ bool MessageLoop::DoWork() {
         AddToDelayedWorkQueue(pending_task);
         // If we changed the topmost task, then it is time to reschedule.
         if (delayed_work_queue_.top().task.Equals(pending_task.task))
-          pump_->ScheduleDelayedWork(pending_task.delayed_run_time);
+          pump_->ScheduleDelayedWork(delayed_work_queue_.NextRunTime());
       } else {
         if (DeferOrRunPendingTask(pending_task))
           return true;
@@ -586,7 +586,7 @@ bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
   // fall behind (and have a lot of ready-to-run delayed tasks), the more
   // efficient we'll be at handling the tasks.
 
-  TimeTicks next_run_time = delayed_work_queue_.top().delayed_run_time;
+  TimeTicks next_run_time = delayed_work_queue_.NextRunTime();
   if (next_run_time > recent_time_) {
     recent_time_ = TimeTicks::Now();  // Get a better view of Now();
     if (next_run_time > recent_time_) {
@@ -599,7 +599,7 @@ bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
   delayed_work_queue_.pop();
 
   if (!delayed_work_queue_.empty())
-    *next_delayed_work_time = delayed_work_queue_.top().delayed_run_time;
+    *next_delayed_work_time = delayed_work_queue_.NextRunTime();
 
   return DeferOrRunPendingTask(pending_task);
 }
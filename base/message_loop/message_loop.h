@@ -281,6 +281,18 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
     pump_->SetTimerSlack(timer_slack);
   }
 
+  // Keeps delayed tasks in a hierarchical timing wheel rather than a heap, so
+  // that posting one takes constant time. This suits loops that post many
+  // timeouts and cancel or restart most of them before they are due.
+  void UseTimerWheel() { delayed_work_queue_.UseTimerWheel(); }
+
+  // Lets delayed tasks run up to |slack| late, so that tasks due within the
+  // same interval of |slack| run after a single wake-up. Unlike the OS level
+  // slack of SetTimerSlack(), this also coalesces the loop's own work.
+  void SetDelayedTaskSlack(TimeDelta slack) {
+    delayed_work_queue_.set_slack(slack);
+  }
+
   // Returns true if this loop is |type|. This allows subclasses (especially
   // those in tests) to specialize how they are identified.
   virtual bool IsType(Type type) const;
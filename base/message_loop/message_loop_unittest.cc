@@ -703,6 +703,66 @@ TEST(MessageLoopTest, TaskObserver) {
   EXPECT_EQ(kNumPosts, observer.num_tasks_processed());
 }
 
+namespace {
+
+void RecordOrder(std::vector<int>* order, int id) {
+  order->push_back(id);
+}
+
+void RecordTimeTicks(TimeTicks* run_time) {
+  *run_time = TimeTicks::Now();
+}
+
+}  // namespace
+
+TEST(MessageLoopTest, TimerWheelRunsDelayedTasksInOrder) {
+  MessageLoop loop;
+  loop.UseTimerWheel();
+
+  // Delays in milliseconds, with ties that must run in post order.
+  const int kDelaysMs[] = {30, 10, 0, 20, 10, 100, 0, 1};
+  const int kExpectedOrder[] = {2, 6, 7, 1, 4, 3, 0, 5};
+  std::vector<int> order;
+  for (size_t i = 0; i < arraysize(kDelaysMs); ++i) {
+    loop.PostDelayedTask(FROM_HERE,
+                         Bind(&RecordOrder, &order, static_cast<int>(i)),
+                         TimeDelta::FromMilliseconds(kDelaysMs[i]));
+  }
+  loop.PostDelayedTask(FROM_HERE, MessageLoop::QuitWhenIdleClosure(),
+                       TimeDelta::FromMilliseconds(150));
+  loop.Run();
+
+  ASSERT_EQ(arraysize(kExpectedOrder), order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    EXPECT_EQ(kExpectedOrder[i], order[i]);
+}
+
+TEST(MessageLoopTest, DelayedTaskSlack) {
+  const TimeDelta kSlack = TimeDelta::FromMilliseconds(100);
+  MessageLoop loop;
+  loop.UseTimerWheel();
+  loop.SetDelayedTaskSlack(kSlack);
+
+  // Both tasks are due in the same interval of the slack, so they wait for
+  // its end and run together.
+  TimeTicks start = TimeTicks::Now();
+  TimeTicks run_time1, run_time2;
+  loop.PostDelayedTask(FROM_HERE, Bind(&RecordTimeTicks, &run_time1),
+                       TimeDelta::FromMilliseconds(1));
+  loop.PostDelayedTask(FROM_HERE, Bind(&RecordTimeTicks, &run_time2),
+                       TimeDelta::FromMilliseconds(2));
+  loop.PostDelayedTask(FROM_HERE, MessageLoop::QuitWhenIdleClosure(),
+                       TimeDelta::FromMilliseconds(3));
+  loop.Run();
+
+  int64 slack = kSlack.ToInternalValue();
+  int64 due = (start + TimeDelta::FromMilliseconds(1)).ToInternalValue();
+  TimeTicks interval_end =
+      TimeTicks::FromInternalValue((due + slack - 1) / slack * slack);
+  EXPECT_GE(run_time1, interval_end);
+  EXPECT_GE(run_time2, run_time1);
+}
+
 #if defined(OS_WIN)
 TEST(MessageLoopTest, Dispatcher) {
   // This test requires a UI loop
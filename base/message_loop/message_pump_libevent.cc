@@ -114,7 +114,8 @@ MessagePumpLibevent::MessagePumpLibevent()
       processed_io_events_(false),
       event_base_(event_base_new()),
       wakeup_pipe_in_(-1),
-      wakeup_pipe_out_(-1) {
+      wakeup_pipe_out_(-1),
+      wakeup_pending_(0) {
   if (!Init())
      NOTREACHED();
 }
@@ -288,6 +289,14 @@ void MessagePumpLibevent::Quit() {
 }
 
 void MessagePumpLibevent::ScheduleWork() {
+  // If a wakeup byte is already on its way, Run() is guaranteed to go around
+  // its loop (and call DoWork()) after it is consumed, so there is nothing
+  // more to do. The barrier publishes the caller's work before the flag is
+  // examined.
+  subtle::MemoryBarrier();
+  if (subtle::NoBarrier_AtomicExchange(&wakeup_pending_, 1))
+    return;
+
   // Tell libevent (in a threadsafe way) that it should break out of its loop.
   char buf = 0;
   int nwrite = HANDLE_EINTR(write(wakeup_pipe_in_, &buf, 1));
@@ -368,6 +377,10 @@ void MessagePumpLibevent::OnWakeup(int socket, short flags, void* context) {
   char buf;
   int nread = HANDLE_EINTR(read(socket, &buf, 1));
   DCHECK_EQ(nread, 1);
+  // Any ScheduleWork() from here on needs a new byte. The barrier keeps the
+  // loop's following reads of its work queues from moving above the reset.
+  subtle::NoBarrier_Store(&that->wakeup_pending_, 0);
+  subtle::MemoryBarrier();
   that->processed_io_events_ = true;
   // Tell libevent to break out of inner loop.
   event_base_loopbreak(that->event_base_);
@@ -5,6 +5,7 @@
 #ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_LIBEVENT_H_
 #define BASE_MESSAGE_LOOP_MESSAGE_PUMP_LIBEVENT_H_
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/memory/weak_ptr.h"
@@ -166,6 +167,9 @@ class BASE_EXPORT MessagePumpLibevent : public MessagePump {
   int wakeup_pipe_out_;
   // ... libevent wrapper for read end
   event* wakeup_event_;
+  // ... non-zero while a byte is in the pipe, so that concurrent
+  // ScheduleWork() calls do not each pay for a write()
+  subtle::Atomic32 wakeup_pending_;
 
   ObserverList<IOObserver> io_observers_;
   ThreadChecker watch_file_descriptor_caller_checker_;
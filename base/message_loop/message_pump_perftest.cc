@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/format_macros.h"
 #include "base/memory/scoped_vector.h"
@@ -289,5 +290,90 @@ TEST_F(PostTaskTest, OneHundredTasksPerReload) {
   Run(1000, 100);
 }
 
+// Measures how fast a loop drains tasks that are posted to it concurrently by
+// many threads, i.e. the cost of contention on the incoming queue and of
+// waking up the target pump.
+class ContendedPostTaskTest : public testing::Test {
+ public:
+  ContendedPostTaskTest() : remaining_tasks_(0), done_(false, false) {}
+
+  void Run(MessageLoop::Type target_type, int num_posting_threads) {
+    Thread target("target");
+    target.StartWithOptions(Thread::Options(target_type, 0u));
+
+    ScopedVector<Thread> posting_threads;
+    for (int i = 0; i < num_posting_threads; ++i) {
+      posting_threads.push_back(new Thread("posting thread"));
+      posting_threads[i]->Start();
+    }
+
+    const int tasks_per_thread = kNumTasks / num_posting_threads;
+    subtle::NoBarrier_Store(&remaining_tasks_,
+                            tasks_per_thread * num_posting_threads);
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < num_posting_threads; ++i) {
+      posting_threads[i]->message_loop()->PostTask(
+          FROM_HERE,
+          base::Bind(&ContendedPostTaskTest::PostTasks, base::Unretained(this),
+                     target.message_loop(), tasks_per_thread));
+    }
+    done_.Wait();
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    posting_threads.clear();
+    target.Stop();
+
+    std::string trace = StringPrintf(
+        "%d_threads_posting_to_%s_loop", num_posting_threads,
+        target_type == MessageLoop::TYPE_IO ? "io" : "default");
+    perf_test::PrintResult(
+        "task",
+        "_contended",
+        trace,
+        elapsed.InMicroseconds() /
+            static_cast<double>(tasks_per_thread * num_posting_threads),
+        "us/task",
+        true);
+  }
+
+ private:
+  void PostTasks(MessageLoop* target, int num_tasks) {
+    base::Closure task =
+        base::Bind(&ContendedPostTaskTest::Task, base::Unretained(this));
+    for (int i = 0; i < num_tasks; ++i)
+      target->PostTask(FROM_HERE, task);
+  }
+
+  void Task() {
+    if (subtle::Barrier_AtomicIncrement(&remaining_tasks_, -1) == 0)
+      done_.Signal();
+  }
+
+  subtle::Atomic32 remaining_tasks_;
+  WaitableEvent done_;
+
+  static const int kNumTasks = 320000;
+};
+
+TEST_F(ContendedPostTaskTest, ToIOFromOneThread) {
+  Run(MessageLoop::TYPE_IO, 1);
+}
+
+TEST_F(ContendedPostTaskTest, ToIOFromFourThreads) {
+  Run(MessageLoop::TYPE_IO, 4);
+}
+
+TEST_F(ContendedPostTaskTest, ToIOFromSixteenThreads) {
+  Run(MessageLoop::TYPE_IO, 16);
+}
+
+TEST_F(ContendedPostTaskTest, ToIOFromThirtyTwoThreads) {
+  Run(MessageLoop::TYPE_IO, 32);
+}
+
+TEST_F(ContendedPostTaskTest, ToDefaultFromSixteenThreads) {
+  Run(MessageLoop::TYPE_DEFAULT, 16);
+}
+
 }  // namespace
 }  // namespace base
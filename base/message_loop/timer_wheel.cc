@@ -0,0 +1,274 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+// Returns the index of the lowest set bit of |bits|, which must not be 0.
+int LowestSetBit(uint64 bits) {
+  DCHECK(bits);
+#if defined(COMPILER_GCC)
+  return __builtin_ctzll(bits);
+#else
+  int index = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    ++index;
+  }
+  return index;
+#endif
+}
+
+// Returns the slot of level 0 that |time| falls in.
+uint64 TickOf(TimeTicks time) {
+  int64 microseconds = time.ToInternalValue();
+  if (microseconds < 0)
+    return 0;
+  return static_cast<uint64>(microseconds) / Time::kMicrosecondsPerMillisecond;
+}
+
+// Returns true if |a| is due before |b|. PendingTask::operator< is inverted
+// for std::priority_queue.
+bool RunsBefore(const PendingTask& a, const PendingTask& b) {
+  return b < a;
+}
+
+}  // namespace
+
+struct TimerWheel::Node {
+  explicit Node(const PendingTask& task)
+      : task(task), prev(NULL), next(NULL), bucket(0) {}
+
+  PendingTask task;
+  Node* prev;
+  Node* next;
+  int bucket;
+};
+
+TimerWheel::TimerWheel()
+    : current_tick_(0),
+      size_(0),
+      free_list_(NULL) {
+  for (int i = 0; i < kBuckets; ++i)
+    buckets_[i].head = buckets_[i].tail = NULL;
+  for (int i = 0; i < kLevels; ++i)
+    occupied_[i] = 0;
+}
+
+TimerWheel::~TimerWheel() {
+  for (int i = 0; i < kBuckets; ++i) {
+    Node* node = buckets_[i].head;
+    while (node) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+  while (free_list_) {
+    Node* next = free_list_->next;
+    delete free_list_;
+    free_list_ = next;
+  }
+}
+
+TimerWheel::Handle TimerWheel::Add(const PendingTask& task) {
+  DCHECK(!task.delayed_run_time.is_null());
+  // An empty wheel can start over from any time, which keeps tasks out of the
+  // upper levels after the wheel has been idle.
+  uint64 tick = TickOf(task.delayed_run_time);
+  if (!size_)
+    current_tick_ = tick;
+  else if (tick < current_tick_)
+    Rewind(tick);
+
+  Node* node;
+  if (free_list_) {
+    node = free_list_;
+    free_list_ = node->next;
+    node->task = task;
+  } else {
+    node = new Node(task);
+  }
+  Place(node);
+  ++size_;
+  return node;
+}
+
+void TimerWheel::Cancel(Handle handle) {
+  DCHECK(size_);
+  Unlink(handle);
+  Recycle(handle);
+  --size_;
+}
+
+const PendingTask& TimerWheel::Earliest() {
+  DCHECK(size_);
+  if (!occupied_[0])
+    Cascade();
+  return buckets_[LowestSetBit(occupied_[0])].head->task;
+}
+
+void TimerWheel::RemoveEarliest() {
+  DCHECK(size_);
+  if (!occupied_[0])
+    Cascade();
+  Node* node = buckets_[LowestSetBit(occupied_[0])].head;
+  Unlink(node);
+  Recycle(node);
+  --size_;
+}
+
+void TimerWheel::Place(Node* node) {
+  uint64 tick = TickOf(node->task.delayed_run_time);
+  DCHECK_GE(tick, current_tick_);
+
+  // A task belongs to the lowest level whose current span includes it.
+  int level = 0;
+  while (level < kLevels &&
+         (tick >> (kSlotBits * (level + 1))) !=
+             (current_tick_ >> (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+
+  if (level == kLevels) {
+    node->bucket = kOverflow;
+  } else {
+    int slot = static_cast<int>(tick >> (kSlotBits * level)) & (kSlots - 1);
+    node->bucket = level * kSlots + slot;
+    occupied_[level] |= static_cast<uint64>(1) << slot;
+  }
+
+  Bucket* bucket = &buckets_[node->bucket];
+  Node* prev = bucket->tail;
+  if (node->bucket < kSlots) {
+    // Slots of level 0 are kept sorted. Tasks mostly arrive in order, so
+    // search from the back.
+    while (prev && RunsBefore(node->task, prev->task))
+      prev = prev->prev;
+  }
+
+  node->prev = prev;
+  node->next = prev ? prev->next : bucket->head;
+  if (node->next)
+    node->next->prev = node;
+  else
+    bucket->tail = node;
+  if (prev)
+    prev->next = node;
+  else
+    bucket->head = node;
+}
+
+void TimerWheel::Unlink(Node* node) {
+  Bucket* bucket = &buckets_[node->bucket];
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    bucket->head = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    bucket->tail = node->prev;
+
+  if (!bucket->head && node->bucket != kOverflow) {
+    occupied_[node->bucket / kSlots] &=
+        ~(static_cast<uint64>(1) << (node->bucket % kSlots));
+  }
+}
+
+void TimerWheel::Cascade() {
+  DCHECK(size_);
+  while (!occupied_[0]) {
+    int level = 1;
+    while (level < kLevels && !occupied_[level])
+      ++level;
+
+    Bucket* bucket;
+    if (level < kLevels) {
+      // Slots of the current level that are earlier than |current_tick_| are
+      // always empty, so the lowest occupied slot is the next one due.
+      int slot = LowestSetBit(occupied_[level]);
+      int shift = kSlotBits * level;
+      int span_shift = shift + kSlotBits;
+      current_tick_ = (current_tick_ >> span_shift << span_shift) |
+                      (static_cast<uint64>(slot) << shift);
+      occupied_[level] &= ~(static_cast<uint64>(1) << slot);
+      bucket = &buckets_[level * kSlots + slot];
+    } else {
+      // Only the overflow list has tasks. Skip ahead to the earliest.
+      bucket = &buckets_[kOverflow];
+      current_tick_ = std::numeric_limits<uint64>::max();
+      for (Node* node = bucket->head; node; node = node->next) {
+        current_tick_ =
+            std::min(current_tick_, TickOf(node->task.delayed_run_time));
+      }
+    }
+
+    Node* node = bucket->head;
+    bucket->head = bucket->tail = NULL;
+    while (node) {
+      Node* next = node->next;
+      Place(node);
+      node = next;
+    }
+  }
+}
+
+void TimerWheel::Rewind(uint64 tick) {
+  DCHECK_LT(tick, current_tick_);
+  // Find the level that |tick| would go to, like Place() does.
+  int level = 0;
+  while (level < kLevels &&
+         (tick >> (kSlotBits * (level + 1))) !=
+             (current_tick_ >> (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+
+  // The tasks of the levels below are all in the slot of |level| that holds
+  // |current_tick_|, which is empty. Move them there.
+  int target = kOverflow;
+  if (level < kLevels) {
+    int slot =
+        static_cast<int>(current_tick_ >> (kSlotBits * level)) & (kSlots - 1);
+    target = level * kSlots + slot;
+  }
+  Bucket* target_bucket = &buckets_[target];
+  for (int lower = 0; lower < level; ++lower) {
+    while (occupied_[lower]) {
+      int slot = LowestSetBit(occupied_[lower]);
+      occupied_[lower] &= ~(static_cast<uint64>(1) << slot);
+      Bucket* bucket = &buckets_[lower * kSlots + slot];
+      for (Node* node = bucket->head; node; node = node->next)
+        node->bucket = target;
+      if (target_bucket->tail)
+        target_bucket->tail->next = bucket->head;
+      else
+        target_bucket->head = bucket->head;
+      bucket->head->prev = target_bucket->tail;
+      target_bucket->tail = bucket->tail;
+      bucket->head = bucket->tail = NULL;
+    }
+  }
+  if (target != kOverflow && target_bucket->head)
+    occupied_[level] |= static_cast<uint64>(1) << (target % kSlots);
+
+  current_tick_ = tick;
+}
+
+void TimerWheel::Recycle(Node* node) {
+  // Release the closure now rather than when the node is reused.
+  node->task.task.Reset();
+  node->next = free_list_;
+  free_list_ = node;
+}
+
+}  // namespace base
@@ -0,0 +1,106 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_TIMER_WHEEL_H_
+#define BASE_MESSAGE_LOOP_TIMER_WHEEL_H_
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/pending_task.h"
+
+namespace base {
+
+// A hierarchical timing wheel of PendingTasks, ordered by |delayed_run_time|
+// and then by |sequence_num| like DelayedTaskQueue's heap. Adding and
+// cancelling a task take constant time, and tasks are only sorted once they
+// fall into the wheel's current 64 ms window, which makes the wheel much
+// cheaper than a heap for timeouts that are mostly cancelled or restarted
+// before they are due.
+//
+// The wheel has four levels of 64 slots. A slot of level 0 spans 1 ms and a
+// slot of level n spans 64 slots of level n - 1, so the levels cover about
+// 4.6 hours past the current time. Tasks due later than that wait in an
+// overflow list. Whenever level 0 runs empty, the next occupied slot of a
+// higher level is cascaded down. A task that is due before the wheel's
+// current time moves the wheel back, which only touches the tasks of the
+// levels below the one the task falls in. Nodes are recycled, so a wheel of
+// steady size does not allocate.
+//
+// This class is not thread-safe.
+class BASE_EXPORT TimerWheel {
+ public:
+  struct Node;
+
+  // Identifies a task in the wheel so that it can be cancelled.
+  typedef Node* Handle;
+
+  TimerWheel();
+  ~TimerWheel();
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // Adds |task|, which is due at |task.delayed_run_time|. The returned handle
+  // is valid until the task is removed.
+  Handle Add(const PendingTask& task);
+
+  // Removes the task identified by |handle| without running it.
+  void Cancel(Handle handle);
+
+  // Returns the task that is due first. The wheel must not be empty.
+  const PendingTask& Earliest();
+
+  // Removes the task returned by Earliest().
+  void RemoveEarliest();
+
+ private:
+  enum {
+    kSlotBits = 6,
+    kSlots = 1 << kSlotBits,
+    kLevels = 4,
+    // All the slots of all the levels, followed by the overflow list.
+    kBuckets = kLevels * kSlots + 1,
+    kOverflow = kBuckets - 1,
+  };
+
+  struct Bucket {
+    Node* head;
+    Node* tail;
+  };
+
+  // Puts |node| in the bucket that its run time falls in.
+  void Place(Node* node);
+
+  // Removes |node| from its bucket.
+  void Unlink(Node* node);
+
+  // Moves the tasks of the next occupied slot down the wheel until level 0
+  // has a task. The wheel must not be empty.
+  void Cascade();
+
+  // Moves the wheel's current time back to |tick|.
+  void Rewind(uint64 tick);
+
+  // Returns |node| to the free list.
+  void Recycle(Node* node);
+
+  Bucket buckets_[kBuckets];
+
+  // Bit i of occupied_[level] is set when that level's slot i has a task.
+  uint64 occupied_[kLevels];
+
+  // The wheel's current time in ticks of level 0. No task is due earlier.
+  uint64 current_tick_;
+
+  size_t size_;
+
+  // Nodes of removed tasks, linked through |next|.
+  Node* free_list_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_TIMER_WHEEL_H_
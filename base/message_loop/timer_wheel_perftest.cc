@@ -0,0 +1,124 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/message_loop/timer_wheel.h"
+#include "base/pending_task.h"
+#include "base/rand_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kNumTasks = 500000;
+
+void Nop() {
+}
+
+// Returns delays that look like network timeouts: mostly seconds, some
+// milliseconds.
+std::vector<TimeDelta> MakeDelays() {
+  std::vector<TimeDelta> delays(kNumTasks);
+  for (size_t i = 0; i < delays.size(); ++i) {
+    delays[i] = RandInt(0, 9) ? TimeDelta::FromMilliseconds(RandInt(0, 60000))
+                              : TimeDelta::FromMicroseconds(RandInt(0, 50000));
+  }
+  return delays;
+}
+
+// Keeps |outstanding| tasks in |queue|, running the earliest one whenever
+// another one is posted, and reports the time per task.
+void RunDelayedTaskQueue(DelayedTaskQueue* queue,
+                         const std::vector<TimeDelta>& delays,
+                         size_t outstanding,
+                         const std::string& trace) {
+  PendingTask task(FROM_HERE, Bind(&Nop), TimeTicks(), true);
+  TimeTicks now = TimeTicks::Now();
+  TimeTicks start = TimeTicks::Now();
+  for (size_t i = 0; i < delays.size(); ++i) {
+    task.delayed_run_time = now + delays[i];
+    task.sequence_num = static_cast<int>(i);
+    queue->push(task);
+    if (queue->size() > outstanding) {
+      now = std::max(now, queue->top().delayed_run_time);
+      queue->pop();
+    }
+  }
+  while (!queue->empty())
+    queue->pop();
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  perf_test::PrintResult(
+      "delayed_task_queue", StringPrintf("_%d", static_cast<int>(outstanding)),
+      trace, elapsed.InMicroseconds() * 1000.0 / delays.size(), "ns/task",
+      true);
+}
+
+}  // namespace
+
+TEST(TimerWheelPerfTest, PushAndPop) {
+  std::vector<TimeDelta> delays = MakeDelays();
+  const size_t kOutstanding[] = {100, 10000, 100000};
+  for (size_t i = 0; i < arraysize(kOutstanding); ++i) {
+    DelayedTaskQueue heap;
+    RunDelayedTaskQueue(&heap, delays, kOutstanding[i], "heap");
+    DelayedTaskQueue wheel;
+    wheel.UseTimerWheel();
+    RunDelayedTaskQueue(&wheel, delays, kOutstanding[i], "wheel");
+  }
+}
+
+// Restarts timeouts, which the heap can only do by leaving the old task
+// behind, like base::Timer does.
+TEST(TimerWheelPerfTest, Restart) {
+  std::vector<TimeDelta> delays = MakeDelays();
+  const size_t kTimeouts = 10000;
+  PendingTask task(FROM_HERE, Bind(&Nop), TimeTicks(), true);
+  TimeTicks now = TimeTicks::Now();
+
+  TimerWheel wheel;
+  std::vector<TimerWheel::Handle> handles(kTimeouts);
+  for (size_t i = 0; i < kTimeouts; ++i) {
+    task.delayed_run_time = now + delays[i];
+    handles[i] = wheel.Add(task);
+  }
+  TimeTicks start = TimeTicks::Now();
+  for (size_t i = 0; i < delays.size(); ++i) {
+    size_t timeout = i % kTimeouts;
+    wheel.Cancel(handles[timeout]);
+    task.delayed_run_time = now + delays[i];
+    task.sequence_num = static_cast<int>(i);
+    handles[timeout] = wheel.Add(task);
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  perf_test::PrintResult("restart_timeout", "", "wheel",
+                         elapsed.InMicroseconds() * 1000.0 / delays.size(),
+                         "ns/restart", true);
+
+  std::priority_queue<PendingTask> heap;
+  for (size_t i = 0; i < kTimeouts; ++i) {
+    task.delayed_run_time = now + delays[i];
+    heap.push(task);
+  }
+  start = TimeTicks::Now();
+  for (size_t i = 0; i < delays.size(); ++i) {
+    task.delayed_run_time = now + delays[i];
+    task.sequence_num = static_cast<int>(i);
+    heap.push(task);
+  }
+  elapsed = TimeTicks::Now() - start;
+  perf_test::PrintResult("restart_timeout", "", "heap",
+                         elapsed.InMicroseconds() * 1000.0 / delays.size(),
+                         "ns/restart", true);
+}
+
+}  // namespace base
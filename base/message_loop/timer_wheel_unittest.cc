@@ -0,0 +1,208 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/timer_wheel.h"
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/rand_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void Nop() {
+}
+
+PendingTask MakeTask(TimeTicks run_time, int sequence_num) {
+  PendingTask task(FROM_HERE, Bind(&Nop), run_time, true);
+  task.sequence_num = sequence_num;
+  return task;
+}
+
+// Removes all the tasks from |wheel| and checks that they come out in the
+// order of a DelayedTaskQueue heap holding the same tasks.
+void ExpectSameOrder(TimerWheel* wheel,
+                     std::priority_queue<PendingTask>* heap) {
+  ASSERT_EQ(heap->size(), wheel->size());
+  while (!heap->empty()) {
+    const PendingTask& task = wheel->Earliest();
+    EXPECT_EQ(heap->top().delayed_run_time, task.delayed_run_time);
+    EXPECT_EQ(heap->top().sequence_num, task.sequence_num);
+    wheel->RemoveEarliest();
+    heap->pop();
+  }
+  EXPECT_TRUE(wheel->empty());
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, Empty) {
+  TimerWheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, SameRunTimeInPostOrder) {
+  TimeTicks now = TimeTicks::Now();
+  TimerWheel wheel;
+  for (int i = 0; i < 10; ++i)
+    wheel.Add(MakeTask(now + TimeDelta::FromMilliseconds(5), i));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, wheel.Earliest().sequence_num);
+    wheel.RemoveEarliest();
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, AllLevels) {
+  TimeTicks now = TimeTicks::Now();
+  const int64 kDelaysMs[] = {
+    // Level 0 and its boundary.
+    0, 1, 2, 63, 64,
+    // Levels 1 to 3.
+    65, 4095, 4096, 4097, 262143, 262144, 300000, 16777215,
+    // Overflow.
+    16777216, 16777217, 100000000,
+  };
+  TimerWheel wheel;
+  std::priority_queue<PendingTask> heap;
+  int sequence_num = 0;
+  // Add the tasks backwards, so that the wheel has to sort them.
+  for (int i = arraysize(kDelaysMs) - 1; i >= 0; --i) {
+    PendingTask task = MakeTask(
+        now + TimeDelta::FromMilliseconds(kDelaysMs[i]), sequence_num++);
+    wheel.Add(task);
+    heap.push(task);
+  }
+  ExpectSameOrder(&wheel, &heap);
+}
+
+TEST(TimerWheelTest, RandomAddsAndRemoves) {
+  TimeTicks now = TimeTicks::Now();
+  TimerWheel wheel;
+  std::priority_queue<PendingTask> heap;
+  int sequence_num = 0;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 50; ++i) {
+      // Mostly short delays in microseconds, sometimes hours.
+      int64 delay = RandInt(0, 1)
+                        ? RandInt(0, 100000)
+                        : RandGenerator(static_cast<uint64>(1) << 36);
+      PendingTask task = MakeTask(
+          now + TimeDelta::FromMicroseconds(delay), sequence_num++);
+      wheel.Add(task);
+      heap.push(task);
+    }
+    for (int i = 0; i < 30; ++i) {
+      EXPECT_EQ(heap.top().delayed_run_time,
+                wheel.Earliest().delayed_run_time);
+      EXPECT_EQ(heap.top().sequence_num, wheel.Earliest().sequence_num);
+      // The loop only runs tasks once they are due.
+      now = std::max(now, heap.top().delayed_run_time);
+      wheel.RemoveEarliest();
+      heap.pop();
+    }
+  }
+  ExpectSameOrder(&wheel, &heap);
+}
+
+TEST(TimerWheelTest, LateTasks) {
+  TimeTicks now = TimeTicks::Now();
+  TimerWheel wheel;
+  std::priority_queue<PendingTask> heap;
+  PendingTask tasks[] = {
+    MakeTask(now + TimeDelta::FromSeconds(10), 0),
+    MakeTask(now + TimeDelta::FromSeconds(20), 1),
+  };
+  for (size_t i = 0; i < arraysize(tasks); ++i) {
+    wheel.Add(tasks[i]);
+    heap.push(tasks[i]);
+  }
+  // Moves the wheel to the first task.
+  EXPECT_EQ(0, wheel.Earliest().sequence_num);
+
+  // Tasks that are due before the wheel's current time must still come out
+  // first, and in order.
+  PendingTask late_tasks[] = {
+    MakeTask(now + TimeDelta::FromMilliseconds(2), 2),
+    MakeTask(now + TimeDelta::FromMilliseconds(1), 3),
+    MakeTask(now + TimeDelta::FromMilliseconds(2), 4),
+    MakeTask(now + TimeDelta::FromSeconds(15), 5),
+  };
+  for (size_t i = 0; i < arraysize(late_tasks); ++i) {
+    wheel.Add(late_tasks[i]);
+    heap.push(late_tasks[i]);
+  }
+  ExpectSameOrder(&wheel, &heap);
+}
+
+TEST(TimerWheelTest, Cancel) {
+  TimeTicks now = TimeTicks::Now();
+  TimerWheel wheel;
+  std::vector<TimerWheel::Handle> handles;
+  for (int i = 0; i < 100; ++i) {
+    handles.push_back(
+        wheel.Add(MakeTask(now + TimeDelta::FromMilliseconds(i * 100), i)));
+  }
+  // Cancel every task but multiples of 3, including the earliest.
+  for (int i = 0; i < 100; ++i) {
+    if (i % 3)
+      wheel.Cancel(handles[i]);
+  }
+  EXPECT_EQ(34u, wheel.size());
+  for (int i = 0; i < 100; i += 3) {
+    EXPECT_EQ(i, wheel.Earliest().sequence_num);
+    wheel.RemoveEarliest();
+  }
+  EXPECT_TRUE(wheel.empty());
+
+  // Cancelling the task at the front must expose the next one.
+  TimerWheel::Handle first =
+      wheel.Add(MakeTask(now + TimeDelta::FromMilliseconds(1), 100));
+  wheel.Add(MakeTask(now + TimeDelta::FromMilliseconds(2), 101));
+  EXPECT_EQ(100, wheel.Earliest().sequence_num);
+  wheel.Cancel(first);
+  EXPECT_EQ(101, wheel.Earliest().sequence_num);
+}
+
+TEST(TimerWheelTest, DelayedTaskQueueSwitchesToWheel) {
+  TimeTicks now = TimeTicks::Now();
+  DelayedTaskQueue queue;
+  for (int i = 0; i < 10; ++i)
+    queue.push(MakeTask(now + TimeDelta::FromMilliseconds(10 - i), i));
+  queue.UseTimerWheel();
+  queue.push(MakeTask(now + TimeDelta::FromMilliseconds(5), 10));
+  EXPECT_EQ(11u, queue.size());
+
+  int expected[] = {9, 8, 7, 6, 5, 10, 4, 3, 2, 1, 0};
+  for (size_t i = 0; i < arraysize(expected); ++i) {
+    EXPECT_EQ(expected[i], queue.top().sequence_num);
+    queue.pop();
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(TimerWheelTest, DelayedTaskQueueSlack) {
+  TimeTicks grid = TimeTicks::FromInternalValue(1000000000);
+  DelayedTaskQueue queue;
+  queue.set_slack(TimeDelta::FromMilliseconds(50));
+  queue.push(MakeTask(grid + TimeDelta::FromMilliseconds(1), 0));
+  EXPECT_EQ(grid + TimeDelta::FromMilliseconds(50), queue.NextRunTime());
+  queue.pop();
+
+  // Run times on the grid are not delayed.
+  queue.push(MakeTask(grid + TimeDelta::FromMilliseconds(100), 1));
+  EXPECT_EQ(grid + TimeDelta::FromMilliseconds(100), queue.NextRunTime());
+
+  queue.set_slack(TimeDelta());
+  queue.push(MakeTask(grid + TimeDelta::FromMilliseconds(30), 2));
+  EXPECT_EQ(grid + TimeDelta::FromMilliseconds(30), queue.NextRunTime());
+}
+
+}  // namespace base
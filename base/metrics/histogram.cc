@@ -16,6 +16,7 @@
 
 #include "base/compiler_specific.h"
 #include "base/debug/alias.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
@@ -23,6 +24,7 @@
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/lock.h"
+#include "base/threading/thread_local.h"
 #include "base/values.h"
 
 using std::string;
@@ -32,6 +34,17 @@ namespace base {
 
 namespace {
 
+// |home_shard_| value before any sample has been added.
+const subtle::Atomic32 kNoHomeShard = -1;
+
+// Shard indices are handed out to threads round-robin, the first time each
+// thread adds a sample to any histogram.
+subtle::Atomic32 g_last_thread_shard = 0;
+
+// The calling thread's shard index plus one, so that NULL means unassigned.
+LazyInstance<ThreadLocalPointer<void> >::Leaky g_thread_shard =
+    LAZY_INSTANCE_INITIALIZER;
+
 bool ReadHistogramArguments(PickleIterator* iter,
                             string* histogram_name,
                             int* flags,
@@ -264,7 +277,7 @@ void Histogram::Add(int value) {
     value = kSampleType_MAX - 1;
   if (value < 0)
     value = 0;
-  samples_->Accumulate(value, 1);
+  GetSamplesForCurrentThread()->Accumulate(value, 1);
 }
 
 scoped_ptr<HistogramSamples> Histogram::SnapshotSamples() const {
@@ -308,12 +321,17 @@ Histogram::Histogram(const string& name,
   : HistogramBase(name),
     bucket_ranges_(ranges),
     declared_min_(minimum),
-    declared_max_(maximum) {
+    declared_max_(maximum),
+    home_shard_(kNoHomeShard) {
   if (ranges)
     samples_.reset(new SampleVector(ranges));
+  for (size_t i = 0; i < kNumSampleShards; ++i)
+    shards_[i] = 0;
 }
 
 Histogram::~Histogram() {
+  for (size_t i = 0; i < kNumSampleShards; ++i)
+    delete reinterpret_cast<SampleVector*>(shards_[i]);
 }
 
 bool Histogram::PrintEmptyBucket(size_t index) const {
@@ -366,9 +384,55 @@ HistogramBase* Histogram::DeserializeInfoImpl(PickleIterator* iter) {
   return histogram;
 }
 
+// static
+subtle::Atomic32 Histogram::GetCurrentThreadShard() {
+  ThreadLocalPointer<void>* thread_shard = g_thread_shard.Pointer();
+  uintptr_t shard_plus_one = reinterpret_cast<uintptr_t>(thread_shard->Get());
+  if (!shard_plus_one) {
+    uint32 last_shard = static_cast<uint32>(
+        subtle::NoBarrier_AtomicIncrement(&g_last_thread_shard, 1));
+    shard_plus_one = last_shard % kNumSampleShards + 1;
+    thread_shard->Set(reinterpret_cast<void*>(shard_plus_one));
+  }
+  return static_cast<subtle::Atomic32>(shard_plus_one - 1);
+}
+
+SampleVector* Histogram::GetSamplesForCurrentThread() {
+  subtle::Atomic32 shard = GetCurrentThreadShard();
+  subtle::Atomic32 home_shard = subtle::NoBarrier_Load(&home_shard_);
+  if (home_shard == kNoHomeShard) {
+    home_shard =
+        subtle::NoBarrier_CompareAndSwap(&home_shard_, kNoHomeShard, shard);
+    if (home_shard == kNoHomeShard)
+      home_shard = shard;
+  }
+  if (shard == home_shard)
+    return samples_.get();
+
+  subtle::AtomicWord* slot = &shards_[shard];
+  SampleVector* samples =
+      reinterpret_cast<SampleVector*>(subtle::Acquire_Load(slot));
+  if (samples)
+    return samples;
+
+  // Several threads can share a shard, so they may race to create it.
+  scoped_ptr<SampleVector> new_samples(new SampleVector(bucket_ranges()));
+  subtle::AtomicWord existing = subtle::Release_CompareAndSwap(
+      slot, 0, reinterpret_cast<subtle::AtomicWord>(new_samples.get()));
+  if (existing)
+    return reinterpret_cast<SampleVector*>(existing);
+  return new_samples.release();
+}
+
 scoped_ptr<SampleVector> Histogram::SnapshotSampleVector() const {
   scoped_ptr<SampleVector> samples(new SampleVector(bucket_ranges()));
   samples->Add(*samples_);
+  for (size_t i = 0; i < kNumSampleShards; ++i) {
+    const SampleVector* shard =
+        reinterpret_cast<SampleVector*>(subtle::Acquire_Load(&shards_[i]));
+    if (shard)
+      samples->Add(*shard);
+  }
   return samples.Pass();
 }
 
@@ -200,6 +200,7 @@ class BASE_EXPORT Histogram : public HistogramBase {
 
  private:
   // Allow tests to corrupt our innards for testing purposes.
+  FRIEND_TEST_ALL_PREFIXES(HistogramTest, AddFromManyThreads);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, BoundsTest);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, BucketPlacementTest);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptBucketBounds);
@@ -213,6 +214,16 @@ class BASE_EXPORT Histogram : public HistogramBase {
       PickleIterator* iter);
   static HistogramBase* DeserializeInfoImpl(PickleIterator* iter);
 
+  // Number of shards that samples added from different threads are spread
+  // over. See |shards_|.
+  static const size_t kNumSampleShards = 8;
+
+  // Returns the shard index assigned to the calling thread.
+  static subtle::Atomic32 GetCurrentThreadShard();
+
+  // Returns the samples that Add() on the calling thread accumulates into.
+  SampleVector* GetSamplesForCurrentThread();
+
   // Implementation of SnapshotSamples function.
   scoped_ptr<SampleVector> SnapshotSampleVector() const;
 
@@ -254,6 +265,16 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // sample.
   scoped_ptr<SampleVector> samples_;
 
+  // Histograms that are added to from many threads would otherwise have all of
+  // them writing to the same counts, bouncing those cache lines between cores.
+  // Each thread is handed one of kNumSampleShards shard indices instead. The
+  // first shard to add a sample becomes |home_shard_| and accumulates directly
+  // into |samples_|, so a histogram only ever used on one thread costs nothing
+  // extra. Other shards lazily get a SampleVector of their own in |shards_|,
+  // which are only merged in when a snapshot is taken.
+  subtle::Atomic32 home_shard_;
+  subtle::AtomicWord shards_[kNumSampleShards];
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
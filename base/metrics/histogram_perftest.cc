@@ -0,0 +1,155 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kNumOperations = 4000000;
+
+// Adds |num_operations| samples to a histogram once |start| is signaled,
+// optionally looking the histogram up again before each one.
+class HistogramPerfThread : public DelegateSimpleThread::Delegate {
+ public:
+  HistogramPerfThread(const std::string& histogram_name,
+                      int num_operations,
+                      bool lookup,
+                      WaitableEvent* start)
+      : histogram_name_(histogram_name),
+        num_operations_(num_operations),
+        lookup_(lookup),
+        start_(start) {}
+  ~HistogramPerfThread() override {}
+
+  void Run() override {
+    start_->Wait();
+    HistogramBase* histogram = NULL;
+    for (int i = 0; i < num_operations_; ++i) {
+      // Looking the histogram up every time is what callers whose histogram
+      // name is only known at runtime end up doing.
+      if (lookup_ || !histogram) {
+        histogram = Histogram::FactoryGet(histogram_name_, 1, 10000, 50,
+                                          HistogramBase::kNoFlags);
+      }
+      histogram->Add(i % 10000);
+    }
+  }
+
+ private:
+  const std::string histogram_name_;
+  const int num_operations_;
+  const bool lookup_;
+  WaitableEvent* start_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramPerfThread);
+};
+
+class HistogramPerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    StatisticsRecorder::Initialize();
+    // Register a realistic number of other histograms alongside the ones
+    // being measured.
+    for (int i = 0; i < 1000; ++i) {
+      Histogram::FactoryGet(StringPrintf("PerfTest.Other%d", i), 1, 10000, 50,
+                            HistogramBase::kNoFlags);
+    }
+  }
+
+  // Has |num_threads| threads add |num_operations| samples in total to the
+  // histogram named |histogram_name|, and returns how long that took.
+  TimeDelta RunThreads(const std::string& histogram_name,
+                       int num_threads,
+                       int num_operations,
+                       bool lookup) {
+    WaitableEvent start(true, false);
+    ScopedVector<HistogramPerfThread> delegates;
+    ScopedVector<DelegateSimpleThread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      delegates.push_back(new HistogramPerfThread(
+          histogram_name, num_operations / num_threads, lookup, &start));
+      threads.push_back(
+          new DelegateSimpleThread(delegates.back(), "HistogramPerfThread"));
+      threads.back()->Start();
+    }
+
+    TimeTicks start_time = TimeTicks::Now();
+    start.Signal();
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i]->Join();
+    return TimeTicks::Now() - start_time;
+  }
+
+  // Has |num_threads| threads add kNumOperations samples in total to the same
+  // histogram, and reports the time per sample.
+  void RunContentionTest(int num_threads, bool lookup) {
+    const std::string histogram_name = StringPrintf(
+        "PerfTest.%s%d", lookup ? "Lookup" : "Add", num_threads);
+    TimeDelta elapsed =
+        RunThreads(histogram_name, num_threads, kNumOperations, lookup);
+
+    HistogramBase* histogram = StatisticsRecorder::FindHistogram(
+        histogram_name);
+    ASSERT_TRUE(histogram);
+    scoped_ptr<HistogramSamples> samples = histogram->SnapshotSamples();
+    // Concurrent adds to a shard shared by several threads can be lost, but
+    // not many of them.
+    EXPECT_LE(samples->TotalCount(), kNumOperations);
+    EXPECT_GT(samples->TotalCount(), kNumOperations / 2);
+
+    perf_test::PrintResult(
+        "histogram", StringPrintf("_%d_threads", num_threads),
+        lookup ? "factory_get_and_add" : "add",
+        elapsed.InMillisecondsF() * 1000000 / kNumOperations, "ns/sample",
+        true);
+  }
+};
+
+TEST_F(HistogramPerfTest, Add) {
+  RunContentionTest(1, false);
+  RunContentionTest(4, false);
+  RunContentionTest(16, false);
+}
+
+TEST_F(HistogramPerfTest, FactoryGetAndAdd) {
+  RunContentionTest(1, true);
+  RunContentionTest(4, true);
+  RunContentionTest(16, true);
+}
+
+// Snapshots have to merge the samples of every thread that added to the
+// histogram.
+TEST_F(HistogramPerfTest, Snapshot) {
+  RunThreads("PerfTest.Snapshot", 16, 16000, false);
+  HistogramBase* histogram =
+      StatisticsRecorder::FindHistogram("PerfTest.Snapshot");
+  ASSERT_TRUE(histogram);
+
+  const int kNumSnapshots = 10000;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumSnapshots; ++i)
+    histogram->SnapshotSamples();
+  perf_test::PrintResult(
+      "histogram", "", "snapshot",
+      (TimeTicks::Now() - start).InMillisecondsF() * 1000 / kNumSnapshots,
+      "us/snapshot", true);
+}
+
+}  // namespace
+
+}  // namespace base
@@ -15,6 +15,7 @@
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
+#include "base/threading/simple_thread.h"
 #include "base/time/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -301,6 +302,54 @@ TEST_F(HistogramTest, BucketPlacementTest) {
     EXPECT_EQ(i + 1, samples->GetCountAtIndex(i));
 }
 
+namespace {
+
+class AddSamplesDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  AddSamplesDelegate(HistogramBase* histogram, int value, int count)
+      : histogram_(histogram), value_(value), count_(count) {}
+
+  void Run() override {
+    for (int i = 0; i < count_; ++i)
+      histogram_->Add(value_);
+  }
+
+ private:
+  HistogramBase* const histogram_;
+  const int value_;
+  const int count_;
+};
+
+}  // namespace
+
+// Samples added on different threads go to different shards, which snapshots
+// must merge back together.
+TEST_F(HistogramTest, AddFromManyThreads) {
+  Histogram* histogram = static_cast<Histogram*>(
+      Histogram::FactoryGet("Histogram", 1, 64, 8, HistogramBase::kNoFlags));
+  histogram->Add(0);
+
+  // Use more threads than there are shards, one at a time so that no samples
+  // are lost to races.
+  const int kNumThreads = 2 * Histogram::kNumSampleShards + 1;
+  for (int i = 0; i < kNumThreads; ++i) {
+    AddSamplesDelegate delegate(histogram, 20, i + 1);
+    DelegateSimpleThread thread(&delegate, "AddSamples");
+    thread.Start();
+    thread.Join();
+  }
+
+  scoped_ptr<SampleVector> snapshot = histogram->SnapshotSampleVector();
+  const int kNumSamples = kNumThreads * (kNumThreads + 1) / 2;
+  EXPECT_EQ(1, snapshot->GetCountAtIndex(0));
+  EXPECT_EQ(kNumSamples, snapshot->GetCount(20));
+  EXPECT_EQ(kNumSamples + 1, snapshot->TotalCount());
+  EXPECT_EQ(kNumSamples + 1, snapshot->redundant_count());
+  EXPECT_EQ(20 * kNumSamples, snapshot->sum());
+  EXPECT_EQ(HistogramBase::NO_INCONSISTENCIES,
+            histogram->FindCorruption(*snapshot));
+}
+
 TEST_F(HistogramTest, CorruptSampleCounts) {
   Histogram* histogram = static_cast<Histogram*>(
       Histogram::FactoryGet("Histogram", 1, 64, 8, HistogramBase::kNoFlags));
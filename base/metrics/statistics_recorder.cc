@@ -5,7 +5,9 @@
 #include "base/metrics/statistics_recorder.h"
 
 #include "base/at_exit.h"
+#include "base/atomicops.h"
 #include "base/debug/leak_annotations.h"
+#include "base/hash.h"
 #include "base/json/string_escape.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -21,6 +23,75 @@ namespace {
 // Initialize histogram statistics gathering system.
 base::LazyInstance<base::StatisticsRecorder>::Leaky g_statistics_recorder_ =
     LAZY_INSTANCE_INITIALIZER;
+
+// An index from name to histogram that can be read without holding the
+// StatisticsRecorder lock, so that finding an already registered histogram
+// (which is what almost every call to a FactoryGet() method ends up doing)
+// doesn't contend with other threads. It is an insert-only, open addressing
+// hash table. Only one thread writes to it at a time, with the lock held, and
+// every slot is written at most once, so readers only need an acquire load
+// to see a fully constructed histogram.
+class HistogramLookupTable {
+ public:
+  // |capacity| must be a power of two.
+  explicit HistogramLookupTable(size_t capacity)
+      : mask_(capacity - 1),
+        size_(0),
+        slots_(new base::subtle::AtomicWord[capacity]) {
+    DCHECK_EQ(0u, capacity & mask_);
+    for (size_t i = 0; i < capacity; ++i)
+      slots_[i] = 0;
+  }
+
+  // Can be called on any thread.
+  base::HistogramBase* Find(const std::string& name) const {
+    for (size_t i = base::Hash(name) & mask_; ; i = (i + 1) & mask_) {
+      base::HistogramBase* histogram = reinterpret_cast<base::HistogramBase*>(
+          base::subtle::Acquire_Load(&slots_[i]));
+      if (!histogram || histogram->histogram_name() == name)
+        return histogram;
+    }
+  }
+
+  // The table is kept at most half full, so that probe sequences stay short.
+  bool IsFull() const { return 2 * (size_ + 1) > mask_ + 1; }
+
+  // Must be called with the StatisticsRecorder lock held. |histogram| must not
+  // be in the table yet.
+  void Insert(base::HistogramBase* histogram) {
+    DCHECK(!IsFull());
+    size_t i = base::Hash(histogram->histogram_name()) & mask_;
+    while (slots_[i])
+      i = (i + 1) & mask_;
+    base::subtle::Release_Store(
+        &slots_[i], reinterpret_cast<base::subtle::AtomicWord>(histogram));
+    ++size_;
+  }
+
+  // Returns a table twice as large, with the same contents.
+  HistogramLookupTable* CreateLarger() const {
+    HistogramLookupTable* larger = new HistogramLookupTable(2 * (mask_ + 1));
+    for (size_t i = 0; i <= mask_; ++i) {
+      if (slots_[i])
+        larger->Insert(reinterpret_cast<base::HistogramBase*>(slots_[i]));
+    }
+    return larger;
+  }
+
+ private:
+  const size_t mask_;
+  size_t size_;
+  scoped_ptr<base::subtle::AtomicWord[]> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramLookupTable);
+};
+
+const size_t kInitialLookupTableCapacity = 256;
+
+// The current HistogramLookupTable, or 0 while there is no StatisticsRecorder.
+// Replaced tables are leaked, since readers may still be using them.
+base::subtle::AtomicWord g_lookup_table = 0;
+
 }  // namespace
 
 namespace base {
@@ -65,6 +136,15 @@ HistogramBase* StatisticsRecorder::RegisterOrDeleteDuplicate(
       if (histograms_->end() == it) {
         (*histograms_)[name] = histogram;
         ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
+        HistogramLookupTable* table = reinterpret_cast<HistogramLookupTable*>(
+            subtle::NoBarrier_Load(&g_lookup_table));
+        if (table->IsFull()) {
+          ANNOTATE_LEAKING_OBJECT_PTR(table);
+          table = table->CreateLarger();
+          subtle::Release_Store(&g_lookup_table,
+                                reinterpret_cast<subtle::AtomicWord>(table));
+        }
+        table->Insert(histogram);
         histogram_to_return = histogram;
       } else if (histogram == it->second) {
         // The histogram was registered before.
@@ -234,16 +314,13 @@ void StatisticsRecorder::GetBucketRanges(
 
 // static
 HistogramBase* StatisticsRecorder::FindHistogram(const std::string& name) {
-  if (lock_ == NULL)
-    return NULL;
-  base::AutoLock auto_lock(*lock_);
-  if (histograms_ == NULL)
-    return NULL;
-
-  HistogramMap::iterator it = histograms_->find(name);
-  if (histograms_->end() == it)
+  // This doesn't take |lock_|; see HistogramLookupTable.
+  const HistogramLookupTable* table =
+      reinterpret_cast<const HistogramLookupTable*>(
+          subtle::Acquire_Load(&g_lookup_table));
+  if (table == NULL)
     return NULL;
-  return it->second;
+  return table->Find(name);
 }
 
 // private static
@@ -280,6 +357,8 @@ StatisticsRecorder::StatisticsRecorder() {
   base::AutoLock auto_lock(*lock_);
   histograms_ = new HistogramMap;
   ranges_ = new RangesMap;
+  subtle::Release_Store(&g_lookup_table, reinterpret_cast<subtle::AtomicWord>(
+      new HistogramLookupTable(kInitialLookupTableCapacity)));
 
   if (VLOG_IS_ON(1))
     AtExitManager::RegisterCallback(&DumpHistogramsToVlog, this);
@@ -308,6 +387,11 @@ StatisticsRecorder::~StatisticsRecorder() {
     ranges_deleter.reset(ranges_);
     histograms_ = NULL;
     ranges_ = NULL;
+    // Like |lock_|, the lookup table is leaked, as FindHistogram() may still
+    // be using it on another thread.
+    ANNOTATE_LEAKING_OBJECT_PTR(reinterpret_cast<HistogramLookupTable*>(
+        subtle::NoBarrier_Load(&g_lookup_table)));
+    subtle::NoBarrier_Store(&g_lookup_table, 0);
   }
   // We are going to leak the histograms and the ranges.
 }
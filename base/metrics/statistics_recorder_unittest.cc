@@ -8,6 +8,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
 #include "base/metrics/statistics_recorder.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/values.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -149,6 +150,26 @@ TEST_F(StatisticsRecorderTest, FindHistogram) {
   EXPECT_TRUE(StatisticsRecorder::FindHistogram("TestHistogram") == NULL);
 }
 
+TEST_F(StatisticsRecorderTest, FindManyHistograms) {
+  // Enough histograms for the lookup table to have to grow a few times.
+  const int kNumHistograms = 2000;
+  std::vector<HistogramBase*> histograms;
+  for (int i = 0; i < kNumHistograms; ++i) {
+    histograms.push_back(Histogram::FactoryGet(
+        "TestHistogram" + IntToString(i), 1, 1000, 10,
+        HistogramBase::kNoFlags));
+  }
+
+  for (int i = 0; i < kNumHistograms; ++i) {
+    EXPECT_EQ(histograms[i],
+              StatisticsRecorder::FindHistogram("TestHistogram" +
+                                                IntToString(i)));
+  }
+  EXPECT_TRUE(StatisticsRecorder::FindHistogram("TestHistogram") == NULL);
+  EXPECT_TRUE(StatisticsRecorder::FindHistogram(
+      "TestHistogram" + IntToString(kNumHistograms)) == NULL);
+}
+
 TEST_F(StatisticsRecorderTest, GetSnapshot) {
   Histogram::FactoryGet("TestHistogram1", 1, 1000, 10, Histogram::kNoFlags);
   Histogram::FactoryGet("TestHistogram2", 1, 1000, 10, Histogram::kNoFlags);
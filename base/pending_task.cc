@@ -4,6 +4,7 @@
 
 #include "base/pending_task.h"
 
+#include "base/message_loop/timer_wheel.h"
 #include "base/tracked_objects.h"
 
 namespace base {
@@ -53,4 +54,59 @@ void TaskQueue::Swap(TaskQueue* queue) {
   c.swap(queue->c);  // Calls std::deque::swap.
 }
 
+DelayedTaskQueue::DelayedTaskQueue() {
+}
+
+DelayedTaskQueue::~DelayedTaskQueue() {
+}
+
+void DelayedTaskQueue::UseTimerWheel() {
+  if (wheel_)
+    return;
+  wheel_.reset(new TimerWheel);
+  while (!heap_.empty()) {
+    wheel_->Add(heap_.top());
+    heap_.pop();
+  }
+}
+
+bool DelayedTaskQueue::empty() const {
+  return wheel_ ? wheel_->empty() : heap_.empty();
+}
+
+size_t DelayedTaskQueue::size() const {
+  return wheel_ ? wheel_->size() : heap_.size();
+}
+
+const PendingTask& DelayedTaskQueue::top() {
+  return wheel_ ? wheel_->Earliest() : heap_.top();
+}
+
+void DelayedTaskQueue::push(const PendingTask& pending_task) {
+  if (wheel_)
+    wheel_->Add(pending_task);
+  else
+    heap_.push(pending_task);
+}
+
+void DelayedTaskQueue::pop() {
+  if (wheel_)
+    wheel_->RemoveEarliest();
+  else
+    heap_.pop();
+}
+
+TimeTicks DelayedTaskQueue::NextRunTime() {
+  TimeTicks run_time = top().delayed_run_time;
+  if (slack_ <= TimeDelta())
+    return run_time;
+  // Round up on a grid shared by all the tasks, so that tasks due in the
+  // same interval get the same run time.
+  int64 slack = slack_.ToInternalValue();
+  int64 remainder = run_time.ToInternalValue() % slack;
+  if (remainder)
+    run_time += TimeDelta::FromInternalValue(slack - remainder);
+  return run_time;
+}
+
 }  // namespace base
@@ -10,11 +10,14 @@
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/location.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/time/time.h"
 #include "base/tracking_info.h"
 
 namespace base {
 
+class TimerWheel;
+
 // Contains data about a pending task. Stored in TaskQueue and DelayedTaskQueue
 // for use by classes that queue and execute tasks.
 struct BASE_EXPORT PendingTask : public TrackingInfo {
@@ -52,8 +55,44 @@ class BASE_EXPORT TaskQueue : public std::queue<PendingTask> {
   void Swap(TaskQueue* queue);
 };
 
-// PendingTasks are sorted by their |delayed_run_time| property.
-typedef std::priority_queue<base::PendingTask> DelayedTaskQueue;
+// PendingTasks sorted by their |delayed_run_time| property. The tasks are kept
+// in a binary heap unless UseTimerWheel() is called.
+class BASE_EXPORT DelayedTaskQueue {
+ public:
+  DelayedTaskQueue();
+  ~DelayedTaskQueue();
+
+  // Moves the tasks to a TimerWheel, which adds tasks in constant time rather
+  // than logarithmic time.
+  void UseTimerWheel();
+
+  // Lets tasks run up to |slack| late, so that tasks that are due within the
+  // same interval of |slack| run after a single wake-up. Zero by default.
+  void set_slack(TimeDelta slack) { slack_ = slack; }
+  TimeDelta slack() const { return slack_; }
+
+  bool empty() const;
+  size_t size() const;
+
+  // Returns the task that is due first. The queue must not be empty.
+  const PendingTask& top();
+
+  void push(const PendingTask& pending_task);
+
+  // Removes the task returned by top().
+  void pop();
+
+  // Returns when top() should run, which is its |delayed_run_time| rounded up
+  // to a multiple of the slack.
+  TimeTicks NextRunTime();
+
+ private:
+  std::priority_queue<PendingTask> heap_;
+  scoped_ptr<TimerWheel> wheel_;
+  TimeDelta slack_;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedTaskQueue);
+};
 
 }  // namespace base
 
@@ -18,10 +18,19 @@ const int Pickle::kPayloadUnit = 64;
 
 static const size_t kCapacityReadOnly = static_cast<size_t>(-1);
 
+// Blobs smaller than this are cheaper to copy than to keep a reference to.
+static const size_t kMinReferencedDataSize = 1024;
+
 PickleIterator::PickleIterator(const Pickle& pickle)
     : payload_(pickle.payload()),
       read_index_(0),
-      end_index_(pickle.payload_size()) {
+      end_index_(pickle.payload_size()),
+      pickle_(NULL),
+      segment_(0) {
+  if (pickle.has_referenced_data()) {
+    end_index_ = pickle.referenced_data_[0].inline_offset;
+    pickle_ = &pickle;
+  }
 }
 
 template <typename Type>
@@ -48,6 +57,8 @@ inline void PickleIterator::Advance(size_t size) {
 template<typename Type>
 inline const char* PickleIterator::GetReadPointerAndAdvance() {
   if (sizeof(Type) > end_index_ - read_index_) {
+    if (pickle_)
+      return GetReadPointerAndAdvanceSlow(sizeof(Type));
     read_index_ = end_index_;
     return NULL;
   }
@@ -59,6 +70,8 @@ inline const char* PickleIterator::GetReadPointerAndAdvance() {
 const char* PickleIterator::GetReadPointerAndAdvance(int num_bytes) {
   if (num_bytes < 0 ||
       end_index_ - read_index_ < static_cast<size_t>(num_bytes)) {
+    if (pickle_ && num_bytes >= 0)
+      return GetReadPointerAndAdvanceSlow(num_bytes);
     read_index_ = end_index_;
     return NULL;
   }
@@ -67,6 +80,42 @@ const char* PickleIterator::GetReadPointerAndAdvance(int num_bytes) {
   return current_read_ptr;
 }
 
+const char* PickleIterator::GetReadPointerAndAdvanceSlow(size_t num_bytes) {
+  // Values never straddle segments, so only move on once the current segment
+  // has been read to the end. Inline segments may be empty.
+  while (read_index_ == end_index_ && NextSegment()) {
+    if (num_bytes <= end_index_ - read_index_) {
+      const char* current_read_ptr = payload_ + read_index_;
+      Advance(num_bytes);
+      return current_read_ptr;
+    }
+  }
+  read_index_ = end_index_;
+  pickle_ = NULL;
+  return NULL;
+}
+
+bool PickleIterator::NextSegment() {
+  const std::vector<Pickle::ReferencedData>& references =
+      pickle_->referenced_data_;
+  if (segment_ == 2 * references.size())
+    return false;
+  ++segment_;
+  if (segment_ % 2) {
+    const base::RefCountedMemory* data = references[segment_ / 2].data.get();
+    payload_ = data->front_as<char>();
+    read_index_ = 0;
+    end_index_ = data->size();
+  } else {
+    size_t index = segment_ / 2;
+    payload_ = pickle_->payload();
+    read_index_ = references[index - 1].inline_offset;
+    end_index_ = index < references.size() ?
+        references[index].inline_offset : pickle_->inline_payload_size();
+  }
+  return true;
+}
+
 inline const char* PickleIterator::GetReadPointerAndAdvance(
     int num_elements,
     size_t size_element) {
@@ -213,7 +262,8 @@ Pickle::Pickle()
     : header_(NULL),
       header_size_(sizeof(Header)),
       capacity_after_header_(0),
-      write_offset_(0) {
+      write_offset_(0),
+      referenced_size_(0) {
   Resize(kPayloadUnit);
   header_->payload_size = 0;
 }
@@ -222,7 +272,8 @@ Pickle::Pickle(int header_size)
     : header_(NULL),
       header_size_(AlignInt(header_size, sizeof(uint32))),
       capacity_after_header_(0),
-      write_offset_(0) {
+      write_offset_(0),
+      referenced_size_(0) {
   DCHECK_GE(static_cast<size_t>(header_size), sizeof(Header));
   DCHECK_LE(header_size, kPayloadUnit);
   Resize(kPayloadUnit);
@@ -233,7 +284,8 @@ Pickle::Pickle(const char* data, int data_len)
     : header_(reinterpret_cast<Header*>(const_cast<char*>(data))),
       header_size_(0),
       capacity_after_header_(kCapacityReadOnly),
-      write_offset_(0) {
+      write_offset_(0),
+      referenced_size_(0) {
   if (data_len >= static_cast<int>(sizeof(Header)))
     header_size_ = data_len - header_->payload_size;
 
@@ -252,8 +304,10 @@ Pickle::Pickle(const Pickle& other)
     : header_(NULL),
       header_size_(other.header_size_),
       capacity_after_header_(0),
-      write_offset_(other.write_offset_) {
-  size_t payload_size = header_size_ + other.header_->payload_size;
+      write_offset_(other.write_offset_),
+      referenced_data_(other.referenced_data_),
+      referenced_size_(other.referenced_size_) {
+  size_t payload_size = header_size_ + other.inline_payload_size();
   Resize(payload_size);
   memcpy(header_, other.header_, payload_size);
 }
@@ -277,10 +331,12 @@ Pickle& Pickle::operator=(const Pickle& other) {
     header_ = NULL;
     header_size_ = other.header_size_;
   }
-  Resize(other.header_->payload_size);
+  Resize(other.inline_payload_size());
   memcpy(header_, other.header_,
-         other.header_size_ + other.header_->payload_size);
+         other.header_size_ + other.inline_payload_size());
   write_offset_ = other.write_offset_;
+  referenced_data_ = other.referenced_data_;
+  referenced_size_ = other.referenced_size_;
   return *this;
 }
 
@@ -308,6 +364,82 @@ bool Pickle::WriteBytes(const void* data, int length) {
   return true;
 }
 
+bool Pickle::WriteDataReference(
+    const scoped_refptr<base::RefCountedMemory>& data) {
+  size_t length = data->size();
+  if (length < kMinReferencedDataSize)
+    return WriteData(data->front_as<char>(), static_cast<int>(length));
+  if (length > static_cast<size_t>(kint32max) ||
+      !WriteInt(static_cast<int>(length))) {
+    return false;
+  }
+
+  size_t data_len = AlignInt(length, sizeof(uint32));
+  DCHECK_LE(payload_size(), kuint32max - data_len);
+  ReferencedData reference = { write_offset_, data };
+  referenced_data_.push_back(reference);
+  referenced_size_ += data_len;
+  header_->payload_size = static_cast<uint32>(write_offset_ + referenced_size_);
+  return true;
+}
+
+void Pickle::GetSegments(std::vector<base::StringPiece>* segments) const {
+  static const char kPadding[sizeof(uint32)] = {0};
+  const char* start = reinterpret_cast<const char*>(header_);
+  size_t begin = 0;
+  for (size_t i = 0; i < referenced_data_.size(); ++i) {
+    const ReferencedData& reference = referenced_data_[i];
+    size_t end = header_size_ + reference.inline_offset;
+    if (end > begin)
+      segments->push_back(base::StringPiece(start + begin, end - begin));
+    begin = end;
+
+    size_t length = reference.data->size();
+    segments->push_back(
+        base::StringPiece(reference.data->front_as<char>(), length));
+    if (length % sizeof(uint32)) {
+      segments->push_back(base::StringPiece(
+          kPadding, AlignInt(length, sizeof(uint32)) - length));
+    }
+  }
+  size_t end = header_size_ + inline_payload_size();
+  if (end > begin)
+    segments->push_back(base::StringPiece(start + begin, end - begin));
+}
+
+void Pickle::Flatten() {
+  if (referenced_data_.empty())
+    return;
+
+  size_t inline_size = inline_payload_size();
+  size_t payload_size = header_->payload_size;
+  if (payload_size > capacity_after_header_)
+    Resize(payload_size);
+
+  // Work backwards so that each piece of the inline payload only moves once.
+  char* payload = mutable_payload();
+  size_t src_end = inline_size;
+  size_t dest_end = payload_size;
+  for (size_t i = referenced_data_.size(); i-- > 0;) {
+    const ReferencedData& reference = referenced_data_[i];
+    size_t piece = src_end - reference.inline_offset;
+    dest_end -= piece;
+    memmove(payload + dest_end, payload + reference.inline_offset, piece);
+    src_end = reference.inline_offset;
+
+    size_t length = reference.data->size();
+    size_t data_len = AlignInt(length, sizeof(uint32));
+    dest_end -= data_len;
+    memcpy(payload + dest_end, reference.data->front(), length);
+    memset(payload + dest_end + length, 0, data_len - length);
+  }
+  DCHECK_EQ(src_end, dest_end);
+
+  referenced_data_.clear();
+  referenced_size_ = 0;
+  write_offset_ = payload_size;
+}
+
 void Pickle::Reserve(size_t length) {
   size_t data_len = AlignInt(length, sizeof(uint32));
   DCHECK_GE(data_len, length);
@@ -364,7 +496,7 @@ inline void Pickle::WriteBytesCommon(const void* data, size_t length) {
 #ifdef ARCH_CPU_64_BITS
   DCHECK_LE(data_len, kuint32max);
 #endif
-  DCHECK_LE(write_offset_, kuint32max - data_len);
+  DCHECK_LE(write_offset_ + referenced_size_, kuint32max - data_len);
   size_t new_size = write_offset_ + data_len;
   if (new_size > capacity_after_header_) {
     Resize(std::max(capacity_after_header_ * 2, new_size));
@@ -373,6 +505,6 @@ inline void Pickle::WriteBytesCommon(const void* data, size_t length) {
   char* write = mutable_payload() + write_offset_;
   memcpy(write, data, length);
   memset(write + length, 0, data_len - length);
-  header_->payload_size = static_cast<uint32>(new_size);
+  header_->payload_size = static_cast<uint32>(new_size + referenced_size_);
   write_offset_ = new_size;
 }
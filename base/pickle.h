@@ -6,12 +6,15 @@
 #define BASE_PICKLE_H__
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string16.h"
 #include "base/strings/string_piece.h"
 
@@ -21,7 +24,12 @@ class Pickle;
 // while the PickleIterator object is in use.
 class BASE_EXPORT PickleIterator {
  public:
-  PickleIterator() : payload_(NULL), read_index_(0), end_index_(0) {}
+  PickleIterator()
+      : payload_(NULL),
+        read_index_(0),
+        end_index_(0),
+        pickle_(NULL),
+        segment_(0) {}
   explicit PickleIterator(const Pickle& pickle);
 
   // Methods for reading the payload of the Pickle. To read from the start of
@@ -98,9 +106,24 @@ class BASE_EXPORT PickleIterator {
   const char* GetReadPointerAndAdvance(int num_elements,
                                        size_t size_element);
 
-  const char* payload_;  // Start of our pickle's payload.
+  // Called when fewer than |num_bytes| are left in the current segment of a
+  // Pickle with referenced data. Moves on to the next segment if the current
+  // one has been read completely, and gets the read pointer from there.
+  const char* GetReadPointerAndAdvanceSlow(size_t num_bytes);
+
+  // Makes the segment after the current one current. Returns false if there
+  // is none.
+  bool NextSegment();
+
+  const char* payload_;  // Start of the current segment.
   size_t read_index_;  // Offset of the next readable byte in payload.
-  size_t end_index_;  // Payload size.
+  size_t end_index_;  // End of the current segment.
+
+  // Only set when reading a Pickle with referenced data, which is read one
+  // segment at a time: the even segments are pieces of the Pickle's own
+  // payload, and the odd ones are the referenced blobs in between.
+  const Pickle* pickle_;
+  size_t segment_;
 
   FRIEND_TEST_ALL_PREFIXES(PickleTest, GetReadPointerAndAdvance);
 };
@@ -154,8 +177,12 @@ class BASE_EXPORT Pickle {
   // Returns the size of the Pickle's data.
   size_t size() const { return header_size_ + header_->payload_size; }
 
-  // Returns the data for this Pickle.
-  const void* data() const { return header_; }
+  // Returns the data for this Pickle. Must not be used while the Pickle has
+  // referenced data; see GetSegments() and Flatten().
+  const void* data() const {
+    DCHECK(!has_referenced_data());
+    return header_;
+  }
 
   // Methods for adding to the payload of the Pickle.  These values are
   // appended to the end of the Pickle's payload.  When reading values from a
@@ -208,6 +235,25 @@ class BASE_EXPORT Pickle {
   // when reading and writing. It is normally used to serialize PoD types of a
   // known size. See also WriteData.
   bool WriteBytes(const void* data, int length);
+  // Like WriteData(), but large blobs are referenced rather than copied into
+  // the Pickle, and only gathered from |data| when the Pickle is written out
+  // with GetSegments(). The serialized form is identical to that of
+  // WriteData(), so the blob is read back with ReadData(). |data| must not be
+  // modified while the Pickle refers to it.
+  bool WriteDataReference(const scoped_refptr<base::RefCountedMemory>& data);
+
+  // Returns true if part of the payload is referenced by the Pickle instead of
+  // being held in its own buffer.
+  bool has_referenced_data() const { return !referenced_data_.empty(); }
+
+  // Appends the pieces that make up the serialized Pickle to |segments|, in
+  // order. Their concatenation is what data() returns once the Pickle has
+  // been flattened, and they can be handed to writev() or sendmsg() as is.
+  void GetSegments(std::vector<base::StringPiece>* segments) const;
+
+  // Copies all referenced data into the Pickle's own buffer and drops the
+  // references, after which data() may be used again.
+  void Flatten();
 
   // Reserves space for upcoming writes when multiple writes will be made and
   // their sizes are computed in advance. It can be significantly faster to call
@@ -279,6 +325,19 @@ class BASE_EXPORT Pickle {
  private:
   friend class PickleIterator;
 
+  // A blob added by WriteDataReference(), followed by zero padding up to the
+  // next uint32 boundary in the serialized form.
+  struct ReferencedData {
+    // Offset into the Pickle's own payload that the blob comes before.
+    size_t inline_offset;
+    scoped_refptr<base::RefCountedMemory> data;
+  };
+
+  // Size of the part of the payload held in the Pickle's own buffer.
+  size_t inline_payload_size() const {
+    return payload_size() - referenced_size_;
+  }
+
   Header* header_;
   size_t header_size_;  // Supports extra data between header and payload.
   // Allocation size of payload (or -1 if allocation is const). Note: this
@@ -287,6 +346,11 @@ class BASE_EXPORT Pickle {
   // The offset at which we will write the next field. Note: this doesn't count
   // the header.
   size_t write_offset_;
+  // Data added by WriteDataReference(), ordered by offset.
+  std::vector<ReferencedData> referenced_data_;
+  // Total size of |referenced_data_| including padding, which is part of
+  // the payload size in the header.
+  size_t referenced_size_;
 
   // Just like WriteBytes, but with a compile-time size, for performance.
   template<size_t length> void BASE_EXPORT WriteBytesStatic(const void* data);
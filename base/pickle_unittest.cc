@@ -3,8 +3,10 @@
 // found in the LICENSE file.
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/strings/string16.h"
@@ -428,3 +430,159 @@ TEST(PickleTest, ReadBytes) {
   memcpy(&outdata, outdata_char, sizeof(outdata));
   EXPECT_EQ(data, outdata);
 }
+
+namespace {
+
+scoped_refptr<base::RefCountedString> MakeBlob(size_t size, char c) {
+  std::string data(size, c);
+  return base::RefCountedString::TakeString(&data);
+}
+
+// Writes the same values to |pickle| as WriteReferencedDataTestValues() does,
+// but copies the blobs.
+void WriteCopiedDataTestValues(Pickle* pickle,
+                               const std::string& blob1,
+                               const std::string& blob2) {
+  EXPECT_TRUE(pickle->WriteInt(testint));
+  EXPECT_TRUE(
+      pickle->WriteData(blob1.data(), static_cast<int>(blob1.size())));
+  EXPECT_TRUE(pickle->WriteString(teststring));
+  EXPECT_TRUE(
+      pickle->WriteData(blob2.data(), static_cast<int>(blob2.size())));
+  EXPECT_TRUE(
+      pickle->WriteData(blob1.data(), static_cast<int>(blob1.size())));
+  EXPECT_TRUE(pickle->WriteInt64(testint64));
+}
+
+void WriteReferencedDataTestValues(
+    Pickle* pickle,
+    const scoped_refptr<base::RefCountedString>& blob1,
+    const scoped_refptr<base::RefCountedString>& blob2) {
+  EXPECT_TRUE(pickle->WriteInt(testint));
+  EXPECT_TRUE(pickle->WriteDataReference(blob1));
+  EXPECT_TRUE(pickle->WriteString(teststring));
+  // Two blobs in a row.
+  EXPECT_TRUE(pickle->WriteDataReference(blob2));
+  EXPECT_TRUE(pickle->WriteDataReference(blob1));
+  EXPECT_TRUE(pickle->WriteInt64(testint64));
+}
+
+void VerifyReferencedDataTestValues(
+    const Pickle& pickle,
+    const scoped_refptr<base::RefCountedString>& blob1,
+    const scoped_refptr<base::RefCountedString>& blob2) {
+  PickleIterator iter(pickle);
+  int outint;
+  EXPECT_TRUE(iter.ReadInt(&outint));
+  EXPECT_EQ(testint, outint);
+
+  const char* outdata;
+  int outdatalen;
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(blob1->data(), std::string(outdata, outdatalen));
+
+  std::string outstring;
+  EXPECT_TRUE(iter.ReadString(&outstring));
+  EXPECT_EQ(teststring, outstring);
+
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(blob2->data(), std::string(outdata, outdatalen));
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(blob1->data(), std::string(outdata, outdatalen));
+
+  int64 outint64;
+  EXPECT_TRUE(iter.ReadInt64(&outint64));
+  EXPECT_EQ(testint64, outint64);
+
+  EXPECT_FALSE(iter.ReadInt(&outint));
+}
+
+std::string ConcatenateSegments(const Pickle& pickle) {
+  std::vector<base::StringPiece> segments;
+  pickle.GetSegments(&segments);
+  std::string result;
+  for (size_t i = 0; i < segments.size(); ++i)
+    segments[i].AppendToString(&result);
+  return result;
+}
+
+}  // namespace
+
+// Tests that referenced data reads back and serializes as if it was copied.
+TEST(PickleTest, ReferencedData) {
+  scoped_refptr<base::RefCountedString> blob1 = MakeBlob(5001, 'a');
+  scoped_refptr<base::RefCountedString> blob2 = MakeBlob(4096, 'b');
+
+  Pickle copied;
+  WriteCopiedDataTestValues(&copied, blob1->data(), blob2->data());
+  Pickle pickle;
+  WriteReferencedDataTestValues(&pickle, blob1, blob2);
+  EXPECT_TRUE(pickle.has_referenced_data());
+  EXPECT_EQ(copied.size(), pickle.size());
+  EXPECT_EQ(copied.payload_size(), pickle.payload_size());
+
+  VerifyReferencedDataTestValues(pickle, blob1, blob2);
+  const std::string expected(static_cast<const char*>(copied.data()),
+                             copied.size());
+  EXPECT_EQ(expected, ConcatenateSegments(pickle));
+
+  // The blobs are read from where they are.
+  PickleIterator iter(pickle);
+  int outint;
+  const char* outdata;
+  int outdatalen;
+  EXPECT_TRUE(iter.ReadInt(&outint));
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(blob1->front_as<char>(), outdata);
+
+  // Copies keep referring to the blobs.
+  Pickle copy(pickle);
+  EXPECT_TRUE(copy.has_referenced_data());
+  VerifyReferencedDataTestValues(copy, blob1, blob2);
+  EXPECT_EQ(expected, ConcatenateSegments(copy));
+
+  pickle.Flatten();
+  EXPECT_FALSE(pickle.has_referenced_data());
+  EXPECT_EQ(expected, std::string(static_cast<const char*>(pickle.data()),
+                                  pickle.size()));
+  VerifyReferencedDataTestValues(pickle, blob1, blob2);
+
+  // Writing continues after the flattened data.
+  EXPECT_TRUE(pickle.WriteInt(testint));
+  EXPECT_TRUE(copied.WriteInt(testint));
+  EXPECT_EQ(std::string(static_cast<const char*>(copied.data()),
+                        copied.size()),
+            std::string(static_cast<const char*>(pickle.data()),
+                        pickle.size()));
+}
+
+TEST(PickleTest, SmallReferencedDataIsCopied) {
+  std::string data(teststring);
+  scoped_refptr<base::RefCountedString> blob =
+      base::RefCountedString::TakeString(&data);
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteDataReference(blob));
+  EXPECT_FALSE(pickle.has_referenced_data());
+
+  PickleIterator iter(pickle);
+  const char* outdata;
+  int outdatalen;
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(teststring, std::string(outdata, outdatalen));
+}
+
+// Values can't be read across the end of a referenced blob.
+TEST(PickleTest, ReadPastReferencedData) {
+  scoped_refptr<base::RefCountedString> blob = MakeBlob(4094, 'a');
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteDataReference(blob));
+  EXPECT_TRUE(pickle.WriteInt(testint));
+
+  PickleIterator iter(pickle);
+  int outint;
+  const char* outdata;
+  EXPECT_TRUE(iter.ReadInt(&outint));
+  EXPECT_EQ(4094, outint);
+  EXPECT_FALSE(iter.ReadBytes(&outdata, 4100));
+  EXPECT_FALSE(iter.ReadInt(&outint));
+}
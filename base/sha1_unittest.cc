@@ -106,3 +106,30 @@ TEST(SHA1Test, Test3Bytes) {
   for (size_t i = 0; i < base::kSHA1Length; i++)
     EXPECT_EQ(expected[i], output[i]);
 }
+
+TEST(SHA1Test, ManyBytes) {
+  // Inputs of every length up to a few blocks, in groups that don't fill the
+  // lanes of the multi-buffer kernels evenly.
+  const size_t kNumInputs = 203;
+  std::string inputs[kNumInputs];
+  const unsigned char* data[kNumInputs];
+  size_t lengths[kNumInputs];
+  for (size_t i = 0; i < kNumInputs; i++) {
+    for (size_t j = 0; j < i; j++)
+      inputs[i].push_back(static_cast<char>(i * 31 + j));
+    data[i] = reinterpret_cast<const unsigned char*>(inputs[i].data());
+    lengths[i] = inputs[i].length();
+  }
+
+  unsigned char hashes[kNumInputs * base::kSHA1Length];
+  for (size_t count = 0; count <= kNumInputs; count += 67) {
+    base::SHA1HashBytesMany(data, lengths, count, hashes);
+    for (size_t i = 0; i < count; i++) {
+      EXPECT_EQ(base::SHA1HashString(inputs[i]),
+                std::string(reinterpret_cast<char*>(hashes) +
+                                i * base::kSHA1Length,
+                            base::kSHA1Length))
+          << "input " << i;
+    }
+  }
+}
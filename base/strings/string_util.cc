@@ -389,15 +389,15 @@ inline bool DoIsStringASCII(const Char* characters, size_t length) {
 }
 
 bool IsStringASCII(const StringPiece& str) {
-  return DoIsStringASCII(str.data(), str.length());
+  return CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 bool IsStringASCII(const StringPiece16& str) {
-  return DoIsStringASCII(str.data(), str.length());
+  return CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 bool IsStringASCII(const string16& str) {
-  return DoIsStringASCII(str.data(), str.length());
+  return CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 #if defined(WCHAR_T_IS_UTF32)
@@ -407,17 +407,7 @@ bool IsStringASCII(const std::wstring& str) {
 #endif
 
 bool IsStringUTF8(const StringPiece& str) {
-  const char *src = str.data();
-  int32 src_len = static_cast<int32>(str.length());
-  int32 char_index = 0;
-
-  while (char_index < src_len) {
-    int32 code_point;
-    CBU8_NEXT(src, char_index, src_len, code_point);
-    if (!IsValidCharacter(code_point))
-      return false;
-  }
-  return true;
+  return IsUTF8OfValidCharacters(str.data(), str.length());
 }
 
 }  // namespace base
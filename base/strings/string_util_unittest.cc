@@ -386,6 +386,35 @@ TEST(StringUtilTest, IsStringUTF8) {
   EXPECT_FALSE(IsStringUTF8("embedded\xc0\x80U+0000"));
 }
 
+// Checks that sequences are handled the same wherever they fall in relation
+// to the blocks that are checked at once.
+TEST(StringUtilTest, IsStringUTF8AtBlockBoundaries) {
+  const struct {
+    const char* sequence;
+    bool is_utf8;
+  } kCases[] = {
+    {"\xc2\x81", true},
+    {"\xe1\x80\xbf", true},
+    {"\xf1\x80\xa0\xbf", true},
+    {"\xf4\x8f\xbf\xbd", true},
+    {"\xed\xa0\x80", false},      // Surrogate
+    {"\xc0\x80", false},          // Overlong
+    {"\xf4\x90\x80\x80", false},  // Above U+10FFFF
+    {"\xef\xbf\xbe", false},      // U+FFFE, a non-character
+    {"\xef\xb7\x90", false},      // U+FDD0, a non-character
+    {"\xe1\x80", false},          // Truncated
+    {"\x80", false},
+  };
+  for (size_t i = 0; i < arraysize(kCases); ++i) {
+    for (size_t before = 0; before < 40; ++before) {
+      std::string str = std::string(before, 'a') + kCases[i].sequence;
+      EXPECT_EQ(kCases[i].is_utf8, IsStringUTF8(str)) << i << " " << before;
+      str += std::string(before, 'b');
+      EXPECT_EQ(kCases[i].is_utf8, IsStringUTF8(str)) << i << " " << before;
+    }
+  }
+}
+
 TEST(StringUtilTest, IsStringASCII) {
   static char char_ascii[] =
       "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF";
@@ -4,10 +4,611 @@
 
 #include "base/strings/utf_string_conversion_utils.h"
 
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
 #include "base/third_party/icu/icu_utf.h"
+#include "build/build_config.h"
+
+// The x86 kernels are each compiled for the instruction set they use, and
+// the bulk conversion functions pick the best ones base::CPU reports the
+// first time they run. GCC and clang need to be told about the instruction
+// set of each function; Visual C++ lets any function use any of them.
+#if defined(ARCH_CPU_X86_FAMILY)
+#if defined(COMPILER_GCC)
+#define UTF_CONVERSION_X86_KERNELS 1
+#define UTF_TARGET(isa) __attribute__((target(isa)))
+#elif defined(COMPILER_MSVC)
+#define UTF_CONVERSION_X86_KERNELS 1
+#define UTF_TARGET(isa)
+#endif
+#endif
+
+#if defined(UTF_CONVERSION_X86_KERNELS)
+#include <immintrin.h>
+#endif
 
 namespace base {
 
+namespace {
+
+// The scalar kernels skip ASCII a machine word at a time.
+typedef uintptr_t MachineWord;
+const MachineWord kNonASCIIMask8 =
+    static_cast<MachineWord>(0x8080808080808080ULL);
+const MachineWord kNonASCIIMask16 =
+    static_cast<MachineWord>(0xFF80FF80FF80FF80ULL);
+
+// Decodes the multi-byte UTF-8 sequence at the start of |src| if it is one
+// that ReadUnicodeCharacter() accepts, that is, the shortest form of a code
+// point that is not a surrogate. Returns its length, or 0 otherwise.
+inline size_t ReadMultiByteSequence(const uint8* src,
+                                    size_t src_len,
+                                    uint32* code_point) {
+  uint8 lead = src[0];
+  if (lead < 0xC2) {
+    return 0;
+  } else if (lead < 0xE0) {
+    if (src_len < 2 || (src[1] & 0xC0) != 0x80)
+      return 0;
+    *code_point = ((lead & 0x1F) << 6) | (src[1] & 0x3F);
+    return 2;
+  } else if (lead < 0xF0) {
+    // E0 80..9F would be overlong, ED A0..BF a surrogate.
+    if (src_len < 3 || src[1] < (lead == 0xE0 ? 0xA0 : 0x80) ||
+        src[1] > (lead == 0xED ? 0x9F : 0xBF) || (src[2] & 0xC0) != 0x80) {
+      return 0;
+    }
+    *code_point = ((lead & 0x0F) << 12) | ((src[1] & 0x3F) << 6) |
+                  (src[2] & 0x3F);
+    return 3;
+  } else if (lead < 0xF5) {
+    // F0 80..8F would be overlong, F4 90..BF above U+10FFFF.
+    if (src_len < 4 || src[1] < (lead == 0xF0 ? 0x90 : 0x80) ||
+        src[1] > (lead == 0xF4 ? 0x8F : 0xBF) || (src[2] & 0xC0) != 0x80 ||
+        (src[3] & 0xC0) != 0x80) {
+      return 0;
+    }
+    *code_point = ((lead & 0x07) << 18) | ((src[1] & 0x3F) << 12) |
+                  ((src[2] & 0x3F) << 6) | (src[3] & 0x3F);
+    return 4;
+  }
+  return 0;
+}
+
+// Scalar kernels --------------------------------------------------------------
+
+template<typename CHAR>
+size_t CountASCIIScalar(const CHAR* src,
+                        size_t src_len,
+                        MachineWord non_ascii_mask) {
+  size_t i = 0;
+  const size_t kCharsPerWord = sizeof(MachineWord) / sizeof(CHAR);
+  for (; src_len - i >= kCharsPerWord; i += kCharsPerWord) {
+    MachineWord word;
+    memcpy(&word, src + i, sizeof(word));
+    if (word & non_ascii_mask)
+      break;
+  }
+  while (i < src_len && static_cast<uint32>(src[i]) < 0x80)
+    ++i;
+  return i;
+}
+
+size_t CountASCII8Scalar(const uint8* src, size_t src_len) {
+  return CountASCIIScalar(src, src_len, kNonASCIIMask8);
+}
+
+size_t CountASCII16Scalar(const char16* src, size_t src_len) {
+  return CountASCIIScalar(src, src_len, kNonASCIIMask16);
+}
+
+size_t UTF16LengthScalar(const uint8* src, size_t src_len) {
+  // One for each byte that is not a continuation byte, and one more for each
+  // four byte sequence.
+  size_t length = 0;
+  for (size_t i = 0; i < src_len; ++i)
+    length += (src[i] & 0xC0) != 0x80 ? 1 + (src[i] >= 0xF0) : 0;
+  return length;
+}
+
+size_t UTF8LengthScalar(const char16* src, size_t src_len) {
+  size_t length = 0;
+  for (size_t i = 0; i < src_len; ++i) {
+    char16 c = src[i];
+    length += c < 0x80 ? 1 : (c < 0x800 || CBU16_IS_SURROGATE(c) ? 2 : 3);
+  }
+  return length;
+}
+
+size_t WidenASCIIScalar(const uint8* src, size_t src_len, char16* out) {
+  size_t ascii = CountASCII8Scalar(src, src_len);
+  for (size_t i = 0; i < ascii; ++i)
+    out[i] = src[i];
+  return ascii;
+}
+
+size_t NarrowASCIIScalar(const char16* src, size_t src_len, char* out) {
+  size_t ascii = CountASCII16Scalar(src, src_len);
+  for (size_t i = 0; i < ascii; ++i)
+    out[i] = static_cast<char>(src[i]);
+  return ascii;
+}
+
+#if defined(UTF_CONVERSION_X86_KERNELS)
+
+// SSE2 kernels ----------------------------------------------------------------
+
+// Number of bytes an SSE2 kernel handles at a time.
+const size_t kSSEBlockSize = sizeof(__m128i);
+
+inline UTF_TARGET("sse2") __m128i LoadSSE(const void* src) {
+  return _mm_loadu_si128(static_cast<const __m128i*>(src));
+}
+
+// Returns a mask with two bits set for each non-ASCII char16 in |block|.
+inline UTF_TARGET("sse2") int NonASCIIChar16sSSE2(__m128i block) {
+  __m128i ascii = _mm_cmpeq_epi16(
+      _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xFF80))),
+      _mm_setzero_si128());
+  return _mm_movemask_epi8(ascii) ^ 0xFFFF;
+}
+
+inline UTF_TARGET("sse2") size_t CountASCII8SSE2(const uint8* src,
+                                                 size_t src_len) {
+  size_t i = 0;
+  for (; src_len - i >= kSSEBlockSize; i += kSSEBlockSize) {
+    int non_ascii = _mm_movemask_epi8(LoadSSE(src + i));
+    if (non_ascii) {
+      for (; !(non_ascii & 1); non_ascii >>= 1)
+        ++i;
+      return i;
+    }
+  }
+  while (i < src_len && src[i] < 0x80)
+    ++i;
+  return i;
+}
+
+inline UTF_TARGET("sse2") size_t CountASCII16SSE2(const char16* src,
+                                                  size_t src_len) {
+  const size_t kChar16sPerBlock = kSSEBlockSize / sizeof(char16);
+  size_t i = 0;
+  for (; src_len - i >= kChar16sPerBlock; i += kChar16sPerBlock) {
+    int non_ascii = NonASCIIChar16sSSE2(LoadSSE(src + i));
+    if (non_ascii) {
+      for (; !(non_ascii & 3); non_ascii >>= 2)
+        ++i;
+      return i;
+    }
+  }
+  while (i < src_len && src[i] < 0x80)
+    ++i;
+  return i;
+}
+
+inline UTF_TARGET("sse2") size_t UTF16LengthSSE2(const uint8* src,
+                                                 size_t src_len) {
+  // SSE2 only compares signed bytes. Continuation bytes are the only ones at
+  // or below 0xBF as signed bytes. Once the bytes are flipped by 0x80, the
+  // leads of four byte sequences are the only ones above 0x6F, since ASCII
+  // becomes negative.
+  const __m128i kLastContinuationByte = _mm_set1_epi8(static_cast<char>(0xBF));
+  const __m128i kSignBit = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i kLastThreeByteLead = _mm_set1_epi8(0xEF ^ 0x80);
+  size_t length = 0;
+  size_t i = 0;
+  while (src_len - i >= kSSEBlockSize) {
+    // Each block adds at most 2 to each of the byte sized counters.
+    size_t num_blocks = std::min<size_t>((src_len - i) / kSSEBlockSize, 127);
+    __m128i counts = _mm_setzero_si128();
+    for (size_t end = i + num_blocks * kSSEBlockSize; i < end;
+         i += kSSEBlockSize) {
+      __m128i block = LoadSSE(src + i);
+      counts = _mm_sub_epi8(counts,
+                            _mm_cmpgt_epi8(block, kLastContinuationByte));
+      counts = _mm_sub_epi8(
+          counts, _mm_cmpgt_epi8(_mm_xor_si128(block, kSignBit),
+                                 kLastThreeByteLead));
+    }
+    __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+    length += _mm_cvtsi128_si32(sums) +
+              _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+  }
+  return length + UTF16LengthScalar(src + i, src_len - i);
+}
+
+inline UTF_TARGET("sse2") size_t UTF8LengthSSE2(const char16* src,
+                                                size_t src_len) {
+  // Every char16 takes three bytes, less one if it is below 0x800 or a
+  // surrogate and another one if it is below 0x80.
+  const size_t kChar16sPerBlock = kSSEBlockSize / sizeof(char16);
+  const __m128i kLastOneByte = _mm_set1_epi16(0x7F);
+  const __m128i kLastTwoBytes = _mm_set1_epi16(0x7FF);
+  const __m128i kSurrogateMask = _mm_set1_epi16(static_cast<short>(0xF800));
+  const __m128i kSurrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+  size_t length = 0;
+  size_t i = 0;
+  while (src_len - i >= kChar16sPerBlock) {
+    // Each block adds at most 2 to each of the 16-bit counters.
+    size_t num_blocks = std::min<size_t>((src_len - i) / kChar16sPerBlock,
+                                         16000);
+    __m128i counts = _mm_setzero_si128();
+    for (size_t end = i + num_blocks * kChar16sPerBlock; i < end;
+         i += kChar16sPerBlock) {
+      __m128i block = LoadSSE(src + i);
+      __m128i one_byte = _mm_cmpeq_epi16(_mm_subs_epu16(block, kLastOneByte),
+                                         _mm_setzero_si128());
+      __m128i two_bytes = _mm_or_si128(
+          _mm_cmpeq_epi16(_mm_subs_epu16(block, kLastTwoBytes),
+                          _mm_setzero_si128()),
+          _mm_cmpeq_epi16(_mm_and_si128(block, kSurrogateMask), kSurrogate));
+      counts = _mm_sub_epi16(counts, _mm_add_epi16(one_byte, two_bytes));
+    }
+    __m128i sums = _mm_madd_epi16(counts, _mm_set1_epi16(1));
+    sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 4));
+    length += 3 * num_blocks * kChar16sPerBlock - _mm_cvtsi128_si32(sums);
+  }
+  return length + UTF8LengthScalar(src + i, src_len - i);
+}
+
+inline UTF_TARGET("sse2") size_t WidenASCIISSE2(const uint8* src,
+                                                size_t src_len,
+                                                char16* out) {
+  size_t i = 0;
+  for (; src_len - i >= kSSEBlockSize; i += kSSEBlockSize) {
+    __m128i block = LoadSSE(src + i);
+    int non_ascii = _mm_movemask_epi8(block);
+    if (non_ascii) {
+      for (; !(non_ascii & 1); non_ascii >>= 1, ++i)
+        out[i] = src[i];
+      return i;
+    }
+    __m128i* dest = reinterpret_cast<__m128i*>(out + i);
+    _mm_storeu_si128(dest, _mm_unpacklo_epi8(block, _mm_setzero_si128()));
+    _mm_storeu_si128(dest + 1, _mm_unpackhi_epi8(block, _mm_setzero_si128()));
+  }
+  for (; i < src_len && src[i] < 0x80; ++i)
+    out[i] = src[i];
+  return i;
+}
+
+inline UTF_TARGET("sse2") size_t NarrowASCIISSE2(const char16* src,
+                                                 size_t src_len,
+                                                 char* out) {
+  const size_t kChar16sPerBlock = kSSEBlockSize / sizeof(char16);
+  size_t i = 0;
+  for (; src_len - i >= kChar16sPerBlock; i += kChar16sPerBlock) {
+    __m128i block = LoadSSE(src + i);
+    int non_ascii = NonASCIIChar16sSSE2(block);
+    if (non_ascii) {
+      for (; !(non_ascii & 3); non_ascii >>= 2, ++i)
+        out[i] = static_cast<char>(src[i]);
+      return i;
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(block, block));
+  }
+  for (; i < src_len && src[i] < 0x80; ++i)
+    out[i] = static_cast<char>(src[i]);
+  return i;
+}
+
+// SSSE3 kernels ---------------------------------------------------------------
+
+// Byte shuffles that gather the UTF-8 of eight char16s below 0x800 from the
+// lead byte in the low half of each char16 and the continuation byte in the
+// high half. Entry m is for the blocks in which bit k of m is set if char16 k
+// takes two bytes.
+struct TwoByteShuffles {
+  TwoByteShuffles() {
+    for (int mask = 0; mask < 256; ++mask) {
+      int length = 0;
+      for (int k = 0; k < 8; ++k) {
+        shuffles[mask][length++] = static_cast<uint8>(2 * k);
+        if (mask & (1 << k))
+          shuffles[mask][length++] = static_cast<uint8>(2 * k + 1);
+      }
+      lengths[mask] = static_cast<uint8>(length);
+      // 0x80 clears the bytes past the end.
+      for (; length < 16; ++length)
+        shuffles[mask][length] = 0x80;
+    }
+  }
+
+  uint8 shuffles[256][16];
+  uint8 lengths[256];
+};
+
+LazyInstance<TwoByteShuffles>::Leaky g_two_byte_shuffles =
+    LAZY_INSTANCE_INITIALIZER;
+
+UTF_TARGET("ssse3") size_t NarrowBelow800SSSE3(const char16* src,
+                                               size_t src_len,
+                                               char* out,
+                                               size_t out_len,
+                                               size_t* written) {
+  const TwoByteShuffles& table = g_two_byte_shuffles.Get();
+  const size_t kChar16sPerBlock = kSSEBlockSize / sizeof(char16);
+  const __m128i kLastOneByte = _mm_set1_epi16(0x7F);
+  const __m128i kLastTwoBytes = _mm_set1_epi16(0x7FF);
+  const __m128i kLowSixBits = _mm_set1_epi16(0x3F);
+  const __m128i kMarkers = _mm_set1_epi16(static_cast<short>(0x80C0));
+  size_t i = 0;
+  size_t o = 0;
+  // Each block stores 16 bytes, of which only its UTF-8 is kept.
+  while (src_len - i >= kChar16sPerBlock && out_len - o >= kSSEBlockSize) {
+    __m128i block = LoadSSE(src + i);
+    __m128i below_800 = _mm_cmpeq_epi16(_mm_subs_epu16(block, kLastTwoBytes),
+                                        _mm_setzero_si128());
+    if (_mm_movemask_epi8(below_800) != 0xFFFF)
+      break;
+    __m128i one_byte = _mm_cmpeq_epi16(_mm_subs_epu16(block, kLastOneByte),
+                                       _mm_setzero_si128());
+    int mask =
+        ~_mm_movemask_epi8(_mm_packs_epi16(one_byte, _mm_setzero_si128())) &
+        0xFF;
+    // The ASCII kernels are faster on blocks of ASCII.
+    if (!mask)
+      break;
+    __m128i two_bytes = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi16(block, 6),
+                     _mm_slli_epi16(_mm_and_si128(block, kLowSixBits), 8)),
+        kMarkers);
+    __m128i utf8 = _mm_or_si128(_mm_and_si128(one_byte, block),
+                                _mm_andnot_si128(one_byte, two_bytes));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o),
+                     _mm_shuffle_epi8(utf8, LoadSSE(table.shuffles[mask])));
+    i += kChar16sPerBlock;
+    o += table.lengths[mask];
+  }
+  *written = o;
+  return i;
+}
+
+// AVX2 kernels ----------------------------------------------------------------
+
+// Number of bytes an AVX2 kernel handles at a time. They finish with the SSE2
+// kernels.
+const size_t kAVXBlockSize = sizeof(__m256i);
+
+inline UTF_TARGET("avx2") __m256i LoadAVX(const void* src) {
+  return _mm256_loadu_si256(static_cast<const __m256i*>(src));
+}
+
+// Returns a mask with two bits set for each non-ASCII char16 in |block|.
+inline UTF_TARGET("avx2") uint32 NonASCIIChar16sAVX2(__m256i block) {
+  __m256i ascii = _mm256_cmpeq_epi16(
+      _mm256_and_si256(block, _mm256_set1_epi16(static_cast<short>(0xFF80))),
+      _mm256_setzero_si256());
+  return ~static_cast<uint32>(_mm256_movemask_epi8(ascii));
+}
+
+UTF_TARGET("avx2") size_t CountASCII8AVX2(const uint8* src, size_t src_len) {
+  size_t i = 0;
+  for (; src_len - i >= kAVXBlockSize; i += kAVXBlockSize) {
+    uint32 non_ascii = _mm256_movemask_epi8(LoadAVX(src + i));
+    if (non_ascii) {
+      for (; !(non_ascii & 1); non_ascii >>= 1)
+        ++i;
+      return i;
+    }
+  }
+  return i + CountASCII8SSE2(src + i, src_len - i);
+}
+
+UTF_TARGET("avx2") size_t CountASCII16AVX2(const char16* src,
+                                           size_t src_len) {
+  const size_t kChar16sPerBlock = kAVXBlockSize / sizeof(char16);
+  size_t i = 0;
+  for (; src_len - i >= kChar16sPerBlock; i += kChar16sPerBlock) {
+    uint32 non_ascii = NonASCIIChar16sAVX2(LoadAVX(src + i));
+    if (non_ascii) {
+      for (; !(non_ascii & 3); non_ascii >>= 2)
+        ++i;
+      return i;
+    }
+  }
+  return i + CountASCII16SSE2(src + i, src_len - i);
+}
+
+UTF_TARGET("avx2") size_t UTF16LengthAVX2(const uint8* src, size_t src_len) {
+  // See UTF16LengthSSE2().
+  const __m256i kLastContinuationByte =
+      _mm256_set1_epi8(static_cast<char>(0xBF));
+  const __m256i kSignBit = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i kLastThreeByteLead = _mm256_set1_epi8(0xEF ^ 0x80);
+  size_t length = 0;
+  size_t i = 0;
+  while (src_len - i >= kAVXBlockSize) {
+    // Each block adds at most 2 to each of the byte sized counters.
+    size_t num_blocks = std::min<size_t>((src_len - i) / kAVXBlockSize, 127);
+    __m256i counts = _mm256_setzero_si256();
+    for (size_t end = i + num_blocks * kAVXBlockSize; i < end;
+         i += kAVXBlockSize) {
+      __m256i block = LoadAVX(src + i);
+      counts = _mm256_sub_epi8(
+          counts, _mm256_cmpgt_epi8(block, kLastContinuationByte));
+      counts = _mm256_sub_epi8(
+          counts, _mm256_cmpgt_epi8(_mm256_xor_si256(block, kSignBit),
+                                    kLastThreeByteLead));
+    }
+    __m256i sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                _mm256_extracti128_si256(sums, 1));
+    length += _mm_cvtsi128_si32(sum) +
+              _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+  }
+  return length + UTF16LengthSSE2(src + i, src_len - i);
+}
+
+UTF_TARGET("avx2") size_t UTF8LengthAVX2(const char16* src, size_t src_len) {
+  // See UTF8LengthSSE2().
+  const size_t kChar16sPerBlock = kAVXBlockSize / sizeof(char16);
+  const __m256i kLastOneByte = _mm256_set1_epi16(0x7F);
+  const __m256i kLastTwoBytes = _mm256_set1_epi16(0x7FF);
+  const __m256i kSurrogateMask =
+      _mm256_set1_epi16(static_cast<short>(0xF800));
+  const __m256i kSurrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+  size_t length = 0;
+  size_t i = 0;
+  while (src_len - i >= kChar16sPerBlock) {
+    // Each block adds at most 2 to each of the 16-bit counters.
+    size_t num_blocks = std::min<size_t>((src_len - i) / kChar16sPerBlock,
+                                         16000);
+    __m256i counts = _mm256_setzero_si256();
+    for (size_t end = i + num_blocks * kChar16sPerBlock; i < end;
+         i += kChar16sPerBlock) {
+      __m256i block = LoadAVX(src + i);
+      __m256i one_byte = _mm256_cmpeq_epi16(
+          _mm256_subs_epu16(block, kLastOneByte), _mm256_setzero_si256());
+      __m256i two_bytes = _mm256_or_si256(
+          _mm256_cmpeq_epi16(_mm256_subs_epu16(block, kLastTwoBytes),
+                             _mm256_setzero_si256()),
+          _mm256_cmpeq_epi16(_mm256_and_si256(block, kSurrogateMask),
+                             kSurrogate));
+      counts =
+          _mm256_sub_epi16(counts, _mm256_add_epi16(one_byte, two_bytes));
+    }
+    __m256i sums = _mm256_madd_epi16(counts, _mm256_set1_epi16(1));
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums),
+                                _mm256_extracti128_si256(sums, 1));
+    sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+    sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+    length += 3 * num_blocks * kChar16sPerBlock - _mm_cvtsi128_si32(sum);
+  }
+  return length + UTF8LengthSSE2(src + i, src_len - i);
+}
+
+UTF_TARGET("avx2") size_t WidenASCIIAVX2(const uint8* src,
+                                         size_t src_len,
+                                         char16* out) {
+  size_t i = 0;
+  for (; src_len - i >= kAVXBlockSize; i += kAVXBlockSize) {
+    __m256i block = LoadAVX(src + i);
+    uint32 non_ascii = _mm256_movemask_epi8(block);
+    if (non_ascii) {
+      for (; !(non_ascii & 1); non_ascii >>= 1, ++i)
+        out[i] = src[i];
+      return i;
+    }
+    __m256i* dest = reinterpret_cast<__m256i*>(out + i);
+    _mm256_storeu_si256(dest,
+                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(block)));
+    _mm256_storeu_si256(
+        dest + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(block, 1)));
+  }
+  return i + WidenASCIISSE2(src + i, src_len - i, out + i);
+}
+
+UTF_TARGET("avx2") size_t NarrowASCIIAVX2(const char16* src,
+                                          size_t src_len,
+                                          char* out) {
+  const size_t kChar16sPerBlock = kAVXBlockSize / sizeof(char16);
+  size_t i = 0;
+  for (; src_len - i >= kChar16sPerBlock; i += kChar16sPerBlock) {
+    __m256i block = LoadAVX(src + i);
+    uint32 non_ascii = NonASCIIChar16sAVX2(block);
+    if (non_ascii) {
+      for (; !(non_ascii & 3); non_ascii >>= 2, ++i)
+        out[i] = static_cast<char>(src[i]);
+      return i;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(_mm256_castsi256_si128(block),
+                                      _mm256_extracti128_si256(block, 1)));
+  }
+  return i + NarrowASCIISSE2(src + i, src_len - i, out + i);
+}
+
+#endif  // defined(UTF_CONVERSION_X86_KERNELS)
+
+// Kernel selection ------------------------------------------------------------
+
+internal::UTFKernelSet BestUTFKernelSet() {
+#if defined(UTF_CONVERSION_X86_KERNELS)
+  CPU cpu;
+  if (cpu.has_avx2())
+    return internal::UTF_KERNELS_AVX2;
+  if (cpu.has_ssse3())
+    return internal::UTF_KERNELS_SSSE3;
+  if (cpu.has_sse2())
+    return internal::UTF_KERNELS_SSE2;
+#endif
+  return internal::UTF_KERNELS_SCALAR;
+}
+
+// The kernels that the bulk conversion functions use, picked once.
+struct UTFKernels {
+  UTFKernels() { Use(BestUTFKernelSet()); }
+
+  // Switches to the kernels of |kernel_set|. Returns false if this CPU can't
+  // run them.
+  bool Use(internal::UTFKernelSet kernel_set) {
+    if (kernel_set > BestUTFKernelSet())
+      return false;
+    count_ascii8 = CountASCII8Scalar;
+    count_ascii16 = CountASCII16Scalar;
+    utf16_length = UTF16LengthScalar;
+    utf8_length = UTF8LengthScalar;
+    widen_ascii = WidenASCIIScalar;
+    narrow_ascii = NarrowASCIIScalar;
+    narrow_below_800 = NULL;
+#if defined(UTF_CONVERSION_X86_KERNELS)
+    if (kernel_set >= internal::UTF_KERNELS_SSE2) {
+      count_ascii8 = CountASCII8SSE2;
+      count_ascii16 = CountASCII16SSE2;
+      utf16_length = UTF16LengthSSE2;
+      utf8_length = UTF8LengthSSE2;
+      widen_ascii = WidenASCIISSE2;
+      narrow_ascii = NarrowASCIISSE2;
+    }
+    if (kernel_set >= internal::UTF_KERNELS_SSSE3)
+      narrow_below_800 = NarrowBelow800SSSE3;
+    if (kernel_set >= internal::UTF_KERNELS_AVX2) {
+      count_ascii8 = CountASCII8AVX2;
+      count_ascii16 = CountASCII16AVX2;
+      utf16_length = UTF16LengthAVX2;
+      utf8_length = UTF8LengthAVX2;
+      widen_ascii = WidenASCIIAVX2;
+      narrow_ascii = NarrowASCIIAVX2;
+    }
+#endif
+    return true;
+  }
+
+  // Return the number of ASCII characters at the start of |src|.
+  size_t (*count_ascii8)(const uint8* src, size_t src_len);
+  size_t (*count_ascii16)(const char16* src, size_t src_len);
+
+  // See UTF16LengthOfUTF8() and UTF8LengthOfUTF16().
+  size_t (*utf16_length)(const uint8* src, size_t src_len);
+  size_t (*utf8_length)(const char16* src, size_t src_len);
+
+  // Convert the ASCII characters at the start of |src| to |out|, and return
+  // their number.
+  size_t (*widen_ascii)(const uint8* src, size_t src_len, char16* out);
+  size_t (*narrow_ascii)(const char16* src, size_t src_len, char* out);
+
+  // Converts the blocks at the start of |src| that are made up of char16s
+  // below 0x800 to UTF-8 at |out|, as long as |out_len| leaves room to store
+  // a whole block. Sets |*written| to the number of bytes written, and returns
+  // the number of char16s converted. NULL without SSSE3.
+  size_t (*narrow_below_800)(const char16* src,
+                             size_t src_len,
+                             char* out,
+                             size_t out_len,
+                             size_t* written);
+};
+
+LazyInstance<UTFKernels>::Leaky g_utf_kernels = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
 // ReadUnicodeCharacter --------------------------------------------------------
 
 bool ReadUnicodeCharacter(const char* src,
@@ -102,6 +703,141 @@ size_t WriteUnicodeCharacter(uint32 code_point, string16* output) {
   return CBU16_MAX_LENGTH;
 }
 
+// Bulk conversion -------------------------------------------------------------
+
+size_t CountLeadingASCII(const char* src, size_t src_len) {
+  return g_utf_kernels.Get().count_ascii8(reinterpret_cast<const uint8*>(src),
+                                          src_len);
+}
+
+size_t CountLeadingASCII(const char16* src, size_t src_len) {
+  return g_utf_kernels.Get().count_ascii16(src, src_len);
+}
+
+size_t UTF16LengthOfUTF8(const char* src, size_t src_len) {
+  return g_utf_kernels.Get().utf16_length(reinterpret_cast<const uint8*>(src),
+                                          src_len);
+}
+
+size_t UTF8LengthOfUTF16(const char16* src, size_t src_len) {
+  return g_utf_kernels.Get().utf8_length(src, src_len);
+}
+
+bool IsUTF8OfValidCharacters(const char* src, size_t src_len) {
+  const UTFKernels& kernels = g_utf_kernels.Get();
+  const uint8* in = reinterpret_cast<const uint8*>(src);
+  size_t i = 0;
+  while (i < src_len) {
+    if (in[i] < 0x80) {
+      i += kernels.count_ascii8(in + i, src_len - i);
+      continue;
+    }
+    uint32 code_point;
+    size_t length = ReadMultiByteSequence(in + i, src_len - i, &code_point);
+    if (!length || !IsValidCharacter(code_point))
+      return false;
+    i += length;
+  }
+  return true;
+}
+
+size_t ConvertValidPrefix(const char* src, size_t src_len, string16* output) {
+  const UTFKernels& kernels = g_utf_kernels.Get();
+  const uint8* in = reinterpret_cast<const uint8*>(src);
+  // Sizing the output exactly up front is cheaper than growing it.
+  output->clear();
+  output->resize(kernels.utf16_length(in, src_len));
+  char16* out = output->empty() ? NULL : &(*output)[0];
+  size_t i = 0;
+  size_t o = 0;
+  while (i < src_len) {
+    if (in[i] < 0x80) {
+      size_t ascii = kernels.widen_ascii(in + i, src_len - i, out + o);
+      i += ascii;
+      o += ascii;
+      continue;
+    }
+    uint32 code_point;
+    size_t length = ReadMultiByteSequence(in + i, src_len - i, &code_point);
+    if (!length)
+      break;
+    i += length;
+    if (code_point < 0x10000) {
+      out[o++] = static_cast<char16>(code_point);
+    } else {
+      out[o++] = CBU16_LEAD(code_point);
+      out[o++] = CBU16_TRAIL(code_point);
+    }
+  }
+  output->resize(o);
+  return i;
+}
+
+size_t ConvertValidPrefix(const char16* src,
+                          size_t src_len,
+                          std::string* output) {
+  const UTFKernels& kernels = g_utf_kernels.Get();
+  // Sizing the output exactly up front is cheaper than growing it.
+  const size_t out_len = kernels.utf8_length(src, src_len);
+  output->clear();
+  output->resize(out_len);
+  char* out = output->empty() ? NULL : &(*output)[0];
+  size_t i = 0;
+  size_t o = 0;
+  while (i < src_len) {
+    uint32 c = src[i];
+    if (c < 0x80) {
+      size_t ascii = kernels.narrow_ascii(src + i, src_len - i, out + o);
+      i += ascii;
+      o += ascii;
+    } else if (c < 0x800) {
+      if (kernels.narrow_below_800) {
+        size_t written;
+        size_t converted = kernels.narrow_below_800(
+            src + i, src_len - i, out + o, out_len - o, &written);
+        if (converted) {
+          i += converted;
+          o += written;
+          continue;
+        }
+      }
+      out[o++] = static_cast<char>(0xC0 | (c >> 6));
+      out[o++] = static_cast<char>(0x80 | (c & 0x3F));
+      ++i;
+    } else if (!CBU16_IS_SURROGATE(c)) {
+      out[o++] = static_cast<char>(0xE0 | (c >> 12));
+      out[o++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      out[o++] = static_cast<char>(0x80 | (c & 0x3F));
+      ++i;
+    } else {
+      if (!CBU16_IS_SURROGATE_LEAD(c) || src_len - i < 2 ||
+          !CBU16_IS_TRAIL(src[i + 1])) {
+        break;
+      }
+      uint32 code_point = CBU16_GET_SUPPLEMENTARY(c, src[i + 1]);
+      out[o++] = static_cast<char>(0xF0 | (code_point >> 18));
+      out[o++] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+      out[o++] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      out[o++] = static_cast<char>(0x80 | (code_point & 0x3F));
+      i += 2;
+    }
+  }
+  output->resize(o);
+  return i;
+}
+
+namespace internal {
+
+bool SetUTFKernelSetForTesting(UTFKernelSet kernel_set) {
+  return g_utf_kernels.Pointer()->Use(kernel_set);
+}
+
+void ResetUTFKernelSetForTesting() {
+  g_utf_kernels.Pointer()->Use(BestUTFKernelSet());
+}
+
+}  // namespace internal
+
 // Generalized Unicode converter -----------------------------------------------
 
 template<typename CHAR>
@@ -92,6 +92,56 @@ void PrepareForUTF8Output(const CHAR* src, size_t src_len, std::string* output);
 template<typename STRING>
 void PrepareForUTF16Or32Output(const char* src, size_t src_len, STRING* output);
 
+// Bulk conversion -------------------------------------------------------------
+
+// These work on whole strings a block at a time, with the SSE2, SSSE3 or AVX2
+// kernels that base::CPU finds best on x86, and stop at the first sequence
+// that ReadUnicodeCharacter() would reject so that callers can finish with the
+// functions above.
+
+// Returns the number of ASCII characters at the start of |src|.
+BASE_EXPORT size_t CountLeadingASCII(const char* src, size_t src_len);
+BASE_EXPORT size_t CountLeadingASCII(const char16* src, size_t src_len);
+
+// Return the length of the conversion of |src| if it is valid: the number of
+// UTF-16 units for UTF-8, and the number of bytes for UTF-16.
+BASE_EXPORT size_t UTF16LengthOfUTF8(const char* src, size_t src_len);
+BASE_EXPORT size_t UTF8LengthOfUTF16(const char16* src, size_t src_len);
+
+// Returns true if |src| is UTF-8 made up of characters for which
+// IsValidCharacter() is true.
+BASE_EXPORT bool IsUTF8OfValidCharacters(const char* src, size_t src_len);
+
+// Replaces the contents of |output| with the conversion of the longest prefix
+// of |src| that ReadUnicodeCharacter() can read without error, and returns the
+// length of that prefix.
+BASE_EXPORT size_t ConvertValidPrefix(const char* src,
+                                      size_t src_len,
+                                      string16* output);
+BASE_EXPORT size_t ConvertValidPrefix(const char16* src,
+                                      size_t src_len,
+                                      std::string* output);
+
+namespace internal {
+
+// The instruction sets the bulk conversion functions can be limited to.
+enum UTFKernelSet {
+  UTF_KERNELS_SCALAR,
+  UTF_KERNELS_SSE2,
+  UTF_KERNELS_SSSE3,
+  UTF_KERNELS_AVX2,
+};
+
+// Makes the bulk conversion functions use the kernels of |kernel_set|, so
+// that tests can cover each of them. Returns false, and changes nothing, if
+// this CPU or build can't run them.
+BASE_EXPORT bool SetUTFKernelSetForTesting(UTFKernelSet kernel_set);
+
+// Goes back to the best kernels for this CPU.
+BASE_EXPORT void ResetUTFKernelSetForTesting();
+
+}  // namespace internal
+
 }  // namespace base
 
 #endif  // BASE_STRINGS_UTF_STRING_CONVERSION_UTILS_H_
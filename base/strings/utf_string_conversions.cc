@@ -38,10 +38,42 @@ bool ConvertUnicode(const SRC_CHAR* src,
   return success;
 }
 
+// Converts |src| a block at a time for as long as it is valid, and hands the
+// rest over to ConvertUnicode().
+template<typename SRC_CHAR, typename DEST_STRING>
+bool ConvertUnicodeInBulk(const SRC_CHAR* src,
+                          size_t src_len,
+                          DEST_STRING* output) {
+  size_t converted = ConvertValidPrefix(src, src_len, output);
+  return converted == src_len ||
+         ConvertUnicode(src + converted, src_len - converted, output);
+}
+
 }  // namespace
 
 // UTF-8 <-> Wide --------------------------------------------------------------
 
+#if defined(WCHAR_T_IS_UTF16)
+
+// When wide == UTF-16, the UTF-16 versions below do the work.
+bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
+  return UTF16ToUTF8(src, src_len, output);
+}
+
+std::string WideToUTF8(const std::wstring& wide) {
+  return UTF16ToUTF8(wide);
+}
+
+bool UTF8ToWide(const char* src, size_t src_len, std::wstring* output) {
+  return UTF8ToUTF16(src, src_len, output);
+}
+
+std::wstring UTF8ToWide(const StringPiece& utf8) {
+  return UTF8ToUTF16(utf8);
+}
+
+#elif defined(WCHAR_T_IS_UTF32)
+
 bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
   if (IsStringASCII(std::wstring(src, src_len))) {
     output->assign(src, src + src_len);
@@ -84,6 +116,8 @@ std::wstring UTF8ToWide(const StringPiece& utf8) {
   return ret;
 }
 
+#endif  // defined(WCHAR_T_IS_UTF32)
+
 // UTF-16 <-> Wide -------------------------------------------------------------
 
 #if defined(WCHAR_T_IS_UTF16)
@@ -141,74 +175,30 @@ std::wstring UTF16ToWide(const string16& utf16) {
 
 // UTF16 <-> UTF8 --------------------------------------------------------------
 
-#if defined(WCHAR_T_IS_UTF32)
-
 bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
-  if (IsStringASCII(StringPiece(src, src_len))) {
-    output->assign(src, src + src_len);
-    return true;
-  } else {
-    PrepareForUTF16Or32Output(src, src_len, output);
-    return ConvertUnicode(src, src_len, output);
-  }
+  return ConvertUnicodeInBulk(src, src_len, output);
 }
 
 string16 UTF8ToUTF16(const StringPiece& utf8) {
-  if (IsStringASCII(utf8)) {
-    return string16(utf8.begin(), utf8.end());
-  }
-
   string16 ret;
-  PrepareForUTF16Or32Output(utf8.data(), utf8.length(), &ret);
   // Ignore the success flag of this call, it will do the best it can for
   // invalid input, which is what we want here.
-  ConvertUnicode(utf8.data(), utf8.length(), &ret);
+  ConvertUnicodeInBulk(utf8.data(), utf8.length(), &ret);
   return ret;
 }
 
 bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
-  if (IsStringASCII(StringPiece16(src, src_len))) {
-    output->assign(src, src + src_len);
-    return true;
-  } else {
-    PrepareForUTF8Output(src, src_len, output);
-    return ConvertUnicode(src, src_len, output);
-  }
+  return ConvertUnicodeInBulk(src, src_len, output);
 }
 
 std::string UTF16ToUTF8(const string16& utf16) {
-  if (IsStringASCII(utf16)) {
-    return std::string(utf16.begin(), utf16.end());
-  }
-
   std::string ret;
   // Ignore the success flag of this call, it will do the best it can for
   // invalid input, which is what we want here.
-  UTF16ToUTF8(utf16.data(), utf16.length(), &ret);
+  ConvertUnicodeInBulk(utf16.data(), utf16.length(), &ret);
   return ret;
 }
 
-#elif defined(WCHAR_T_IS_UTF16)
-// Easy case since we can use the "wide" versions we already wrote above.
-
-bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
-  return UTF8ToWide(src, src_len, output);
-}
-
-string16 UTF8ToUTF16(const StringPiece& utf8) {
-  return UTF8ToWide(utf8);
-}
-
-bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
-  return WideToUTF8(src, src_len, output);
-}
-
-std::string UTF16ToUTF8(const string16& utf16) {
-  return WideToUTF8(utf16);
-}
-
-#endif
-
 string16 ASCIIToUTF16(const StringPiece& ascii) {
   DCHECK(IsStringASCII(ascii)) << ascii;
   return string16(ascii.begin(), ascii.end());
@@ -0,0 +1,132 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/strings/string16.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversion_utils.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const size_t kCorpusSize = 1 << 20;
+const int kNumIterations = 50;
+
+struct KernelSet {
+  internal::UTFKernelSet kernel_set;
+  const char* name;
+};
+
+const KernelSet kKernelSets[] = {
+  {internal::UTF_KERNELS_SCALAR, "scalar"},
+  {internal::UTF_KERNELS_SSE2, "sse2"},
+  {internal::UTF_KERNELS_SSSE3, "ssse3"},
+  {internal::UTF_KERNELS_AVX2, "avx2"},
+};
+
+// Repeats |pieces| until the result is about kCorpusSize bytes long.
+std::string BuildCorpus(const char* const pieces[], size_t num_pieces) {
+  std::string corpus;
+  for (size_t i = 0; corpus.size() < kCorpusSize; ++i)
+    corpus += pieces[i % num_pieces];
+  return corpus;
+}
+
+// URLs and JSON, with the odd non-ASCII character.
+std::string BuildASCIICorpus() {
+  const char* const kPieces[] = {
+    "https://www.example.com/search?q=chromium&source=hp&ei=2Yc8VbKsN8",
+    "{\"id\": 1234, \"name\": \"Example\", \"enabled\": true, \"tags\": []}",
+    "<a href=\"/intl/en/about.html\">About</a> | <b>Caf\xc3\xa9</b>\n",
+  };
+  return BuildCorpus(kPieces, arraysize(kPieces));
+}
+
+// Chinese and Japanese text, all three byte sequences.
+std::string BuildCJKCorpus() {
+  const char* const kPieces[] = {
+    "\xe7\xbd\x91\xe9\xa1\xb5\xe5\x9b\xbe\xe7\x89\x87\xe8\xb5\x84\xe8\xae\xaf",
+    "\xe3\x81\x93\xe3\x82\x93\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf\xe4\xb8\x96",
+  };
+  return BuildCorpus(kPieces, arraysize(kPieces));
+}
+
+// European text with accents, Cyrillic and emoji mixed in.
+std::string BuildMixedCorpus() {
+  const char* const kPieces[] = {
+    "Les na\xc3\xafves \xc3\xa9l\xc3\xa8ves ont d\xc3\xa9j\xc3\xa0 mang\xc3\xa9 ",
+    "\xd0\x9f\xd0\xbe\xd0\xb8\xd1\x81\xd0\xba \xd1\x81\xd1\x82\xd1\x80\xd0\xb0"
+    "\xd0\xbd\xd0\xb8\xd1\x86 ",
+    "the quick brown fox \xf0\x9f\x98\x80 jumps over the lazy dog. ",
+  };
+  return BuildCorpus(kPieces, arraysize(kPieces));
+}
+
+void PrintThroughput(const std::string& corpus_name,
+                     const std::string& trace,
+                     size_t bytes,
+                     TimeDelta elapsed) {
+  perf_test::PrintResult(
+      "utf_conversion", "_" + corpus_name, trace,
+      bytes * kNumIterations / elapsed.InSecondsF() / (1 << 20), "MB/s",
+      true);
+}
+
+void RunKernelSet(const std::string& corpus_name,
+                  const std::string& kernel_set_name,
+                  const std::string& utf8) {
+  string16 utf16;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i)
+    EXPECT_TRUE(UTF8ToUTF16(utf8.data(), utf8.size(), &utf16));
+  PrintThroughput(corpus_name, "utf8_to_utf16_" + kernel_set_name,
+                  utf8.size(), TimeTicks::Now() - start);
+
+  std::string round_trip;
+  start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i)
+    EXPECT_TRUE(UTF16ToUTF8(utf16.data(), utf16.size(), &round_trip));
+  PrintThroughput(corpus_name, "utf16_to_utf8_" + kernel_set_name,
+                  utf8.size(), TimeTicks::Now() - start);
+  EXPECT_EQ(utf8, round_trip);
+
+  start = TimeTicks::Now();
+  for (int i = 0; i < kNumIterations; ++i)
+    EXPECT_TRUE(IsStringUTF8(utf8));
+  PrintThroughput(corpus_name, "is_string_utf8_" + kernel_set_name,
+                  utf8.size(), TimeTicks::Now() - start);
+}
+
+// Times the conversions with each set of kernels the CPU can run.
+void RunConversionTests(const std::string& corpus_name,
+                        const std::string& utf8) {
+  for (size_t i = 0; i < arraysize(kKernelSets); ++i) {
+    if (internal::SetUTFKernelSetForTesting(kKernelSets[i].kernel_set))
+      RunKernelSet(corpus_name, kKernelSets[i].name, utf8);
+  }
+  internal::ResetUTFKernelSetForTesting();
+}
+
+TEST(UTFStringConversionsPerfTest, ASCII) {
+  RunConversionTests("ascii", BuildASCIICorpus());
+}
+
+TEST(UTFStringConversionsPerfTest, CJK) {
+  RunConversionTests("cjk", BuildCJKCorpus());
+}
+
+TEST(UTFStringConversionsPerfTest, Mixed) {
+  RunConversionTests("mixed", BuildMixedCorpus());
+}
+
+}  // namespace
+
+}  // namespace base
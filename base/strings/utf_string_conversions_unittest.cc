@@ -6,6 +6,7 @@
 #include "base/logging.h"
 #include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversion_utils.h"
 #include "base/strings/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -208,4 +209,184 @@ TEST(UTFStringConversionsTest, ConvertMultiString) {
   EXPECT_EQ(expected, converted);
 }
 
+// Converts |src| one character at a time, which is what the block at a time
+// conversions have to match.
+template<typename SRC_STRING, typename DEST_STRING>
+bool ConvertOneAtATime(const SRC_STRING& src, DEST_STRING* output) {
+  bool success = true;
+  int32 src_len = static_cast<int32>(src.length());
+  for (int32 i = 0; i < src_len; i++) {
+    uint32 code_point;
+    if (!ReadUnicodeCharacter(src.data(), src_len, &i, &code_point)) {
+      code_point = 0xFFFD;
+      success = false;
+    }
+    WriteUnicodeCharacter(code_point, output);
+  }
+  return success;
+}
+
+// Runs the bulk conversions with each set of kernels, skipping the ones the
+// CPU can't run.
+class UTFKernelSetTest : public testing::TestWithParam<internal::UTFKernelSet> {
+ protected:
+  void SetUp() override {
+    supported_ = internal::SetUTFKernelSetForTesting(GetParam());
+  }
+
+  void TearDown() override {
+    internal::ResetUTFKernelSetForTesting();
+  }
+
+  bool supported_;
+};
+
+INSTANTIATE_TEST_CASE_P(KernelSets,
+                        UTFKernelSetTest,
+                        testing::Values(internal::UTF_KERNELS_SCALAR,
+                                        internal::UTF_KERNELS_SSE2,
+                                        internal::UTF_KERNELS_SSSE3,
+                                        internal::UTF_KERNELS_AVX2));
+
+// Puts each sequence at every position around the ends of the blocks that
+// are converted at once.
+TEST_P(UTFKernelSetTest, ConvertUTF8ToUTF16AtBlockBoundaries) {
+  if (!supported_)
+    return;
+
+  const char* const kSequences[] = {
+    "Ã©",          // U+00E9
+    "ç½",      // U+7F51
+    "ï¿¿",      // U+FFFF, a non-character
+    "ð",  // U+1F600
+    "ô¿¿",  // U+10FFFF
+    "",              // Continuation byte
+    "À",          // Overlong
+    "à¿",      // Overlong
+    "ð¿¿",  // Overlong
+    "í ",      // Surrogate
+    "ô",  // Above U+10FFFF
+    "ç½",          // Truncated
+    "ø",
+    "ÿ",
+  };
+  for (size_t i = 0; i < arraysize(kSequences); ++i) {
+    for (size_t before = 0; before < 40; ++before) {
+      for (size_t after = 0; after < 20; after += 3) {
+        std::string utf8 = std::string(before, 'a') + kSequences[i] +
+                           std::string(after, 'b') + kSequences[i];
+        string16 expected;
+        bool expected_success = ConvertOneAtATime(utf8, &expected);
+
+        string16 converted;
+        EXPECT_EQ(expected_success,
+                  UTF8ToUTF16(utf8.data(), utf8.length(), &converted));
+        EXPECT_EQ(expected, converted) << i << " " << before << " " << after;
+        EXPECT_EQ(expected, UTF8ToUTF16(utf8));
+      }
+    }
+  }
+}
+
+TEST_P(UTFKernelSetTest, ConvertUTF16ToUTF8AtBlockBoundaries) {
+  if (!supported_)
+    return;
+  const char16 kSequences[][3] = {
+    {0xe9, 0},
+    {0x7ff, 0},
+    {0x800, 0},
+    {0x7f51, 0},
+    {0xffff, 0},
+    {0xd83d, 0xde00, 0},  // U+1F600
+    {0xdbff, 0xdfff, 0},  // U+10FFFF
+    {0xd83d, 0},          // Unpaired lead surrogate
+    {0xde00, 0},          // Unpaired trail surrogate
+    {0xde00, 0xd83d, 0},  // Reversed pair
+  };
+  for (size_t i = 0; i < arraysize(kSequences); ++i) {
+    for (size_t before = 0; before < 24; ++before) {
+      for (size_t after = 0; after < 12; after += 3) {
+        string16 utf16 = string16(before, 'a') + kSequences[i] +
+                         string16(after, 'b') + kSequences[i];
+        std::string expected;
+        bool expected_success = ConvertOneAtATime(utf16, &expected);
+
+        std::string converted;
+        EXPECT_EQ(expected_success,
+                  UTF16ToUTF8(utf16.data(), utf16.length(), &converted));
+        EXPECT_EQ(expected, converted) << i << " " << before << " " << after;
+        EXPECT_EQ(expected, UTF16ToUTF8(utf16));
+      }
+    }
+  }
+}
+
+TEST_P(UTFKernelSetTest, ConvertedLengths) {
+  if (!supported_)
+    return;
+  const char* const kCharacters[] = {
+    "a",
+    "\xc3\xa9",          // U+00E9
+    "\xe7\xbd\x91",      // U+7F51
+    "\xf0\x9f\x98\x80",  // U+1F600
+  };
+  // Long enough to go past the limit of the counters for the longest run.
+  const size_t kRepeats[] = {0, 1, 15, 16, 17, 33, 1000, 3000};
+  for (size_t i = 0; i < arraysize(kCharacters); ++i) {
+    for (size_t j = 0; j < arraysize(kRepeats); ++j) {
+      std::string utf8;
+      for (size_t k = 0; k < kRepeats[j]; ++k)
+        utf8 += kCharacters[i];
+      string16 utf16 = UTF8ToUTF16(utf8);
+      EXPECT_EQ(utf16.length(), UTF16LengthOfUTF8(utf8.data(), utf8.length()))
+          << i << " " << kRepeats[j];
+      EXPECT_EQ(utf8.length(), UTF8LengthOfUTF16(utf16.data(), utf16.length()))
+          << i << " " << kRepeats[j];
+    }
+  }
+}
+
+// Long runs that mix ASCII with two byte characters, which the SSSE3 kernel
+// converts a block at a time, with the odd longer character thrown in.
+TEST_P(UTFKernelSetTest, ConvertMixedRuns) {
+  if (!supported_)
+    return;
+  const char16 kCharacters[] = {
+    'a', 'z', 0x7f, 0x80, 0xe9, 0x3a0, 0x7ff, 0x800, 0x7f51, 0xd83d, 0xde00,
+  };
+  uint32 seed = 1;
+  for (size_t length = 0; length < 100; ++length) {
+    for (size_t variant = 0; variant < 20; ++variant) {
+      string16 utf16;
+      for (size_t i = 0; i < length; ++i) {
+        seed = seed * 1103515245 + 12345;
+        // Mostly characters below U+0800, so the runs are long.
+        size_t choice = (seed >> 16) % 64;
+        if (choice >= arraysize(kCharacters))
+          choice %= 7;
+        utf16.push_back(kCharacters[choice]);
+      }
+      std::string expected8;
+      bool expected_success = ConvertOneAtATime(utf16, &expected8);
+      std::string utf8;
+      EXPECT_EQ(expected_success,
+                UTF16ToUTF8(utf16.data(), utf16.length(), &utf8));
+      EXPECT_EQ(expected8, utf8) << length << " " << variant;
+      if (expected_success) {
+        EXPECT_EQ(expected8.length(),
+                  UTF8LengthOfUTF16(utf16.data(), utf16.length()));
+      }
+
+      string16 expected16;
+      EXPECT_TRUE(ConvertOneAtATime(expected8, &expected16));
+      EXPECT_EQ(expected16, UTF8ToUTF16(expected8)) << length << " " << variant;
+      EXPECT_EQ(expected16.length(),
+                UTF16LengthOfUTF8(expected8.data(), expected8.length()));
+      EXPECT_TRUE(IsStringUTF8(expected8));
+      EXPECT_EQ(IsStringASCII(expected8),
+                expected8.length() == expected16.length());
+    }
+  }
+}
+
 }  // namespace base
@@ -4,6 +4,7 @@
 
 #include "base/threading/sequenced_worker_pool.h"
 
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -11,12 +12,15 @@
 #include <vector>
 
 #include "base/atomic_sequence_num.h"
+#include "base/atomicops.h"
 #include "base/callback.h"
 #include "base/compiler_specific.h"
+#include "base/containers/hash_tables.h"
 #include "base/critical_closure.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop/message_loop_proxy.h"
 #include "base/stl_util.h"
 #include "base/strings/stringprintf.h"
@@ -44,6 +48,14 @@ namespace base {
 
 namespace {
 
+// In WORK_STEALING mode, the number of lock-protected shards the per-sequence
+// task queues are spread over.
+const size_t kNumSequenceShards = 16;
+
+// In WORK_STEALING mode, the number of tasks a busy worker runs between two
+// checks for delayed tasks that have become due. Idle workers always check.
+const int kDelayedTaskPollInterval = 32;
+
 struct SequencedTask : public TrackingInfo  {
   SequencedTask()
       : sequence_token_id(0),
@@ -239,6 +251,12 @@ class SequencedWorkerPool::Worker : public SimpleThread {
   // SimpleThread implementation. This actually runs the background thread.
   void Run() override;
 
+  int thread_number() const { return thread_number_; }
+
+  // Unlike |worker_pool_|, this stays set after the thread loop has released
+  // its reference, which may be the last one.
+  const SequencedWorkerPool* owning_pool() const { return owning_pool_; }
+
   // Indicates that a task is about to be run. The parameters provide
   // additional metainformation about the task being run.
   void set_running_task_info(SequenceToken token,
@@ -266,6 +284,8 @@ class SequencedWorkerPool::Worker : public SimpleThread {
 
  private:
   scoped_refptr<SequencedWorkerPool> worker_pool_;
+  const SequencedWorkerPool* const owning_pool_;
+  const int thread_number_;
   // The sequence token of the task being processed. Only valid when
   // is_processing_task_ is true.
   SequenceToken task_sequence_token_;
@@ -286,7 +306,8 @@ class SequencedWorkerPool::Inner {
   // by it).
   Inner(SequencedWorkerPool* worker_pool, size_t max_threads,
         const std::string& thread_name_prefix,
-        TestingObserver* observer);
+        TestingObserver* observer,
+        SchedulingMode scheduling_mode);
 
   ~Inner();
 
@@ -336,6 +357,37 @@ class SequencedWorkerPool::Inner {
     CLEANUP_DONE,
   };
 
+  // An entry in a worker's deque in WORK_STEALING mode. Unsequenced tasks are
+  // carried inline. For sequenced tasks only the token is queued, and the task
+  // itself is taken from the head of the sequence's queue when the entry is
+  // run. At most one entry per sequence exists at any time, which is what
+  // keeps tasks of one sequence from running concurrently or out of order.
+  struct StealableWork {
+    StealableWork() : sequence_token_id(0) {}
+
+    int sequence_token_id;
+    SequencedTask task;
+  };
+
+  // A worker's deque. The owning worker takes work from the front, thieves
+  // take it from the back.
+  struct WorkQueue {
+    Lock lock;
+    std::deque<StealableWork> work;
+  };
+
+  // A sequence has an entry in |sequences| exactly while a StealableWork for
+  // it is queued or running. Tasks posted meanwhile are appended to the entry
+  // and picked up when the running one finishes.
+  struct SequenceShard {
+    typedef hash_map<int, std::deque<SequencedTask> > SequenceMap;
+
+    Lock lock;
+    SequenceMap sequences;
+  };
+
+  typedef std::set<SequencedTask, SequencedTaskLessThan> PendingTaskSet;
+
   // Called from within the lock, this converts the given token name into a
   // token ID, creating a new one if necessary.
   int LockedGetNamedTokenID(const std::string& name);
@@ -402,6 +454,80 @@ class SequencedWorkerPool::Inner {
   // called inside the lock.
   bool CanShutdown() const;
 
+  // Called from within the lock during shutdown, this returns whether a task
+  // with the given |shutdown_behavior| may still be posted from the current
+  // thread, and consumes one of the allowed post-shutdown blocking tasks if
+  // so.
+  bool LockedCanPostTaskDuringShutdown(WorkerShutdown shutdown_behavior);
+
+  // WORK_STEALING counterparts of PostTask, ThreadLoop and CleanupForTesting.
+  // See the definitions for how they coordinate without |lock_|.
+  bool WorkStealingPostTask(const std::string* optional_token_name,
+                            SequencedTask* sequenced,
+                            TimeDelta delay);
+  void WorkStealingThreadLoop(Worker* this_worker);
+  void WorkStealingCleanupForTesting();
+
+  // Returns the worker of this pool running on the current thread, or NULL.
+  // Only meaningful in WORK_STEALING mode.
+  Worker* CurrentWorker() const;
+
+  // Returns the index of the deque that a task posted from the current
+  // thread should go to.
+  size_t QueueIndexForPost();
+
+  // Makes a non-delayed |task| runnable, preferring the deque at
+  // |queue_index|.
+  void EnqueueImmediateTask(const SequencedTask& task, size_t queue_index);
+
+  // Pushes |work| onto the deque at |queue_index| and wakes up an idle
+  // worker, or starts a new one if none is idle.
+  void PushWork(const StealableWork& work, size_t queue_index);
+
+  // Takes work from the deque at |queue_index| or, failing that, steals it
+  // from another worker's deque. Returns false if all deques are empty.
+  bool TakeWork(size_t queue_index, StealableWork* work);
+
+  // Returns true if any deque holds work.
+  bool AnyWorkQueued();
+
+  // Runs (or, during shutdown, discards) the task described by |work| and
+  // reschedules its sequence if more tasks are waiting in it.
+  void RunStealableWork(Worker* this_worker,
+                        size_t queue_index,
+                        StealableWork* work);
+
+  // Moves all delayed tasks whose time has come to the deques. Returns true if
+  // any were moved. Otherwise, if |wait_time| is non-NULL, it is set to the
+  // time until the next delayed task is due, or to zero if there is none.
+  bool ScheduleDueDelayedTasks(size_t queue_index, TimeDelta* wait_time);
+
+  // Deletes all delayed tasks. Must be called outside all locks.
+  void DeleteDelayedTasks();
+
+  // Blocks the calling worker until work is pushed, shutdown makes it
+  // exit, |wait_time| elapses (if nonzero) or a delayed task is posted
+  // after |delayed_generation| was read.
+  void WaitForWork(TimeDelta wait_time, subtle::Atomic32 delayed_generation);
+
+  // Returns true once a worker should leave the thread loop.
+  bool WorkStealingShouldExit() const;
+
+  // Starts an additional worker unless the pool is already at |max_threads_|.
+  // Must be called outside the lock.
+  void StartAdditionalThreadIfPossible();
+
+  // Wakes all idle workers in WORK_STEALING mode.
+  void SignalAllIdleWorkers();
+
+  // Called by workers after finishing a task once shutdown has started.
+  void NotifyShutdownProgress();
+
+  SequenceShard& ShardForSequence(int sequence_token_id) {
+    return sequence_shards_[static_cast<size_t>(sequence_token_id) %
+                            kNumSequenceShards];
+  }
+
   SequencedWorkerPool* const worker_pool_;
 
   // The last sequence number used. Managed by GetSequenceToken, since this
@@ -453,7 +579,6 @@ class SequencedWorkerPool::Inner {
   // or blocked on a previous task in their sequence. We have to iterate over
   // the tasks by time-to-run order, so we use the set instead of the
   // traditional priority_queue.
-  typedef std::set<SequencedTask, SequencedTaskLessThan> PendingTaskSet;
   PendingTaskSet pending_tasks_;
 
   // The next sequence number for a new sequenced task.
@@ -484,6 +609,64 @@ class SequencedWorkerPool::Inner {
 
   TestingObserver* const testing_observer_;
 
+  const SchedulingMode scheduling_mode_;
+
+  // WORK_STEALING state ------------------------------------------------------
+  //
+  // In WORK_STEALING mode, |pending_tasks_|, |current_sequences_|,
+  // |waiting_thread_count_|, |trace_id_| and the two blocking_shutdown
+  // counters above are unused. The members below replace them, and are either
+  // atomics or guarded by their own locks rather than by |lock_|. When more
+  // than one lock is held, they are acquired in the order |lock_|,
+  // |idle_lock_|, then a WorkQueue or SequenceShard lock.
+
+  // The worker running on the current thread, if any. Shared by all pools.
+  static base::LazyInstance<ThreadLocalPointer<Worker> >::Leaky
+      g_lazy_tls_worker_;
+
+  // One deque per potential worker, indexed by thread number - 1.
+  ScopedVector<WorkQueue> work_queues_;
+
+  SequenceShard sequence_shards_[kNumSequenceShards];
+
+  // Delayed tasks in time-to-run order, guarded by |delayed_lock_|.
+  // |has_delayed_tasks_| lets workers skip the lock when there are none, and
+  // |delayed_generation_| is bumped on every delayed post so that an idle
+  // worker never sleeps past a newly posted task.
+  Lock delayed_lock_;
+  PendingTaskSet delayed_tasks_;
+  subtle::Atomic32 has_delayed_tasks_;
+  subtle::Atomic32 delayed_generation_;
+
+  // Idle workers wait on |has_work_idle_cv_|. |idle_thread_count_| is only
+  // modified with |idle_lock_| held, but is read without it so that posts
+  // skip the lock while every worker is busy.
+  Lock idle_lock_;
+  ConditionVariable has_work_idle_cv_;
+  subtle::Atomic32 idle_thread_count_;
+
+  // Number of workers that have entered the thread loop.
+  subtle::Atomic32 thread_count_;
+
+  // Round-robin cursor used to spread posts from non-worker threads.
+  subtle::Atomic32 next_queue_;
+
+  // Number of non-delayed tasks posted but not yet finished (or discarded).
+  // FlushForTesting waits for it to reach zero.
+  subtle::Atomic32 active_task_count_;
+  subtle::Atomic32 flush_waiter_count_;
+
+  // Atomic versions of |shutdown_called_|, |blocking_shutdown_thread_count_|
+  // and |blocking_shutdown_pending_task_count_|. A post increments the pending
+  // count before it checks |ws_shutdown_called_|, and Shutdown() sets the
+  // flag before it checks the counts, so one of them always sees the other.
+  subtle::Atomic32 ws_shutdown_called_;
+  subtle::Atomic32 ws_blocking_shutdown_thread_count_;
+  subtle::Atomic32 ws_blocking_shutdown_pending_task_count_;
+
+  subtle::Atomic32 ws_trace_id_;
+  AtomicSequenceNumber ws_sequence_task_number_;
+
   DISALLOW_COPY_AND_ASSIGN(Inner);
 };
 
@@ -495,6 +678,8 @@ SequencedWorkerPool::Worker::Worker(
     const std::string& prefix)
     : SimpleThread(prefix + StringPrintf("Worker%d", thread_number)),
       worker_pool_(worker_pool),
+      owning_pool_(worker_pool.get()),
+      thread_number_(thread_number),
       task_shutdown_behavior_(BLOCK_SHUTDOWN),
       is_processing_task_(false) {
   Start();
@@ -528,7 +713,8 @@ SequencedWorkerPool::Inner::Inner(
     SequencedWorkerPool* worker_pool,
     size_t max_threads,
     const std::string& thread_name_prefix,
-    TestingObserver* observer)
+    TestingObserver* observer,
+    SchedulingMode scheduling_mode)
     : worker_pool_(worker_pool),
       lock_(),
       has_work_cv_(&lock_),
@@ -546,7 +732,25 @@ SequencedWorkerPool::Inner::Inner(
       cleanup_state_(CLEANUP_DONE),
       cleanup_idlers_(0),
       cleanup_cv_(&lock_),
-      testing_observer_(observer) {}
+      testing_observer_(observer),
+      scheduling_mode_(scheduling_mode),
+      has_delayed_tasks_(0),
+      delayed_generation_(0),
+      has_work_idle_cv_(&idle_lock_),
+      idle_thread_count_(0),
+      thread_count_(0),
+      next_queue_(0),
+      active_task_count_(0),
+      flush_waiter_count_(0),
+      ws_shutdown_called_(0),
+      ws_blocking_shutdown_thread_count_(0),
+      ws_blocking_shutdown_pending_task_count_(0),
+      ws_trace_id_(0) {
+  if (scheduling_mode_ == WORK_STEALING) {
+    for (size_t i = 0; i < max_threads_; ++i)
+      work_queues_.push_back(new WorkQueue);
+  }
+}
 
 SequencedWorkerPool::Inner::~Inner() {
   // You must call Shutdown() before destroying the pool.
@@ -592,29 +796,14 @@ bool SequencedWorkerPool::Inner::PostTask(
       base::MakeCriticalClosure(task) : task;
   sequenced.time_to_run = TimeTicks::Now() + delay;
 
+  if (scheduling_mode_ == WORK_STEALING)
+    return WorkStealingPostTask(optional_token_name, &sequenced, delay);
+
   int create_thread_id = 0;
   {
     AutoLock lock(lock_);
-    if (shutdown_called_) {
-      // Don't allow a new task to be posted if it doesn't block shutdown.
-      if (shutdown_behavior != BLOCK_SHUTDOWN)
-        return false;
-
-      // If the current thread is running a task, and that task doesn't block
-      // shutdown, then it shouldn't be allowed to post any more tasks.
-      ThreadMap::const_iterator found =
-          threads_.find(PlatformThread::CurrentId());
-      if (found != threads_.end() && found->second->is_processing_task() &&
-          found->second->task_shutdown_behavior() != BLOCK_SHUTDOWN) {
-        return false;
-      }
-
-      if (max_blocking_tasks_after_shutdown_ <= 0) {
-        DLOG(WARNING) << "BLOCK_SHUTDOWN task disallowed";
-        return false;
-      }
-      max_blocking_tasks_after_shutdown_ -= 1;
-    }
+    if (shutdown_called_ && !LockedCanPostTaskDuringShutdown(shutdown_behavior))
+      return false;
 
     // The trace_id is used for identifying the task in about:tracing.
     sequenced.trace_id = trace_id_++;
@@ -647,12 +836,21 @@ bool SequencedWorkerPool::Inner::PostTask(
 }
 
 bool SequencedWorkerPool::Inner::RunsTasksOnCurrentThread() const {
+  if (scheduling_mode_ == WORK_STEALING)
+    return CurrentWorker() != NULL;
+
   AutoLock lock(lock_);
   return ContainsKey(threads_, PlatformThread::CurrentId());
 }
 
 bool SequencedWorkerPool::Inner::IsRunningSequenceOnCurrentThread(
     SequenceToken sequence_token) const {
+  if (scheduling_mode_ == WORK_STEALING) {
+    Worker* worker = CurrentWorker();
+    return worker && worker->is_processing_task() &&
+           sequence_token.Equals(worker->task_sequence_token());
+  }
+
   AutoLock lock(lock_);
   ThreadMap::const_iterator found = threads_.find(PlatformThread::CurrentId());
   if (found == threads_.end())
@@ -663,6 +861,11 @@ bool SequencedWorkerPool::Inner::IsRunningSequenceOnCurrentThread(
 
 // See https://code.google.com/p/chromium/issues/detail?id=168415
 void SequencedWorkerPool::Inner::CleanupForTesting() {
+  if (scheduling_mode_ == WORK_STEALING) {
+    WorkStealingCleanupForTesting();
+    return;
+  }
+
   DCHECK(!RunsTasksOnCurrentThread());
   base::ThreadRestrictions::ScopedAllowWait allow_wait;
   AutoLock lock(lock_);
@@ -694,9 +897,17 @@ void SequencedWorkerPool::Inner::Shutdown(
     shutdown_called_ = true;
     max_blocking_tasks_after_shutdown_ = max_new_blocking_tasks_after_shutdown;
 
-    // Tickle the threads. This will wake up a waiting one so it will know that
-    // it can exit, which in turn will wake up any other waiting ones.
-    SignalHasWork();
+    if (scheduling_mode_ == WORK_STEALING) {
+      subtle::Release_Store(&ws_shutdown_called_, 1);
+      // Make the flag visible before CanShutdown() reads the counters. See
+      // WorkStealingPostTask for the other half of this handshake.
+      subtle::MemoryBarrier();
+      SignalAllIdleWorkers();
+    } else {
+      // Tickle the threads. This will wake up a waiting one so it will know
+      // that it can exit, which in turn will wake up any other waiting ones.
+      SignalHasWork();
+    }
 
     // There are no pending or running tasks blocking shutdown, we're done.
     if (CanShutdown())
@@ -726,11 +937,18 @@ void SequencedWorkerPool::Inner::Shutdown(
 }
 
 bool SequencedWorkerPool::Inner::IsShutdownInProgress() {
+    if (scheduling_mode_ == WORK_STEALING)
+      return subtle::Acquire_Load(&ws_shutdown_called_) != 0;
     AutoLock lock(lock_);
     return shutdown_called_;
 }
 
 void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
+  if (scheduling_mode_ == WORK_STEALING) {
+    WorkStealingThreadLoop(this_worker);
+    return;
+  }
+
   {
     AutoLock lock(lock_);
     DCHECK(thread_being_created_);
@@ -1126,7 +1344,12 @@ void SequencedWorkerPool::Inner::FinishStartingAdditionalThread(
 }
 
 void SequencedWorkerPool::Inner::SignalHasWork() {
-  has_work_cv_.Signal();
+  if (scheduling_mode_ == WORK_STEALING) {
+    AutoLock lock(idle_lock_);
+    has_work_idle_cv_.Signal();
+  } else {
+    has_work_cv_.Signal();
+  }
   if (testing_observer_) {
     testing_observer_->OnHasWork();
   }
@@ -1134,15 +1357,510 @@ void SequencedWorkerPool::Inner::SignalHasWork() {
 
 bool SequencedWorkerPool::Inner::CanShutdown() const {
   lock_.AssertAcquired();
+  if (scheduling_mode_ == WORK_STEALING) {
+    return !thread_being_created_ &&
+           subtle::Acquire_Load(&ws_blocking_shutdown_thread_count_) == 0 &&
+           subtle::Acquire_Load(&ws_blocking_shutdown_pending_task_count_) == 0;
+  }
   // See PrepareToStartAdditionalThreadIfHelpful for how thread creation works.
   return !thread_being_created_ &&
          blocking_shutdown_thread_count_ == 0 &&
          blocking_shutdown_pending_task_count_ == 0;
 }
 
+bool SequencedWorkerPool::Inner::LockedCanPostTaskDuringShutdown(
+    WorkerShutdown shutdown_behavior) {
+  lock_.AssertAcquired();
+  DCHECK(shutdown_called_);
+
+  // Don't allow a new task to be posted if it doesn't block shutdown.
+  if (shutdown_behavior != BLOCK_SHUTDOWN)
+    return false;
+
+  // If the current thread is running a task, and that task doesn't block
+  // shutdown, then it shouldn't be allowed to post any more tasks.
+  ThreadMap::const_iterator found = threads_.find(PlatformThread::CurrentId());
+  if (found != threads_.end() && found->second->is_processing_task() &&
+      found->second->task_shutdown_behavior() != BLOCK_SHUTDOWN) {
+    return false;
+  }
+
+  if (max_blocking_tasks_after_shutdown_ <= 0) {
+    DLOG(WARNING) << "BLOCK_SHUTDOWN task disallowed";
+    return false;
+  }
+  max_blocking_tasks_after_shutdown_ -= 1;
+  return true;
+}
+
+// Work-stealing mode ---------------------------------------------------------
+
+bool SequencedWorkerPool::Inner::WorkStealingPostTask(
+    const std::string* optional_token_name,
+    SequencedTask* sequenced,
+    TimeDelta delay) {
+  const bool blocks_shutdown =
+      sequenced->shutdown_behavior == BLOCK_SHUTDOWN;
+
+  // Account for the task before looking at the shutdown flag. Shutdown() sets
+  // the flag before it looks at this counter, so either the post takes the
+  // locked path below or Shutdown() waits for the task.
+  if (blocks_shutdown) {
+    subtle::Barrier_AtomicIncrement(
+        &ws_blocking_shutdown_pending_task_count_, 1);
+  }
+
+  if (optional_token_name || subtle::Acquire_Load(&ws_shutdown_called_)) {
+    AutoLock lock(lock_);
+    if (shutdown_called_ &&
+        !LockedCanPostTaskDuringShutdown(sequenced->shutdown_behavior)) {
+      if (blocks_shutdown) {
+        subtle::Barrier_AtomicIncrement(
+            &ws_blocking_shutdown_pending_task_count_, -1);
+        if (CanShutdown())
+          can_shutdown_cv_.Signal();
+      }
+      return false;
+    }
+    if (optional_token_name) {
+      sequenced->sequence_token_id =
+          LockedGetNamedTokenID(*optional_token_name);
+    }
+  }
+
+  sequenced->trace_id = subtle::NoBarrier_AtomicIncrement(&ws_trace_id_, 1);
+  sequenced->sequence_task_number = ws_sequence_task_number_.GetNext();
+  TRACE_EVENT_FLOW_BEGIN0(TRACE_DISABLED_BY_DEFAULT("toplevel.flow"),
+      "SequencedWorkerPool::PostTask",
+      TRACE_ID_MANGLE(GetTaskTraceID(*sequenced, static_cast<void*>(this))));
+
+  if (delay > TimeDelta()) {
+    {
+      AutoLock lock(delayed_lock_);
+      delayed_tasks_.insert(*sequenced);
+      subtle::Release_Store(&has_delayed_tasks_, 1);
+      subtle::NoBarrier_AtomicIncrement(&delayed_generation_, 1);
+    }
+    // Delayed tasks never block shutdown, and the workers may already have
+    // deleted the others and exited if shutdown started since the check
+    // above.
+    if (subtle::Acquire_Load(&ws_shutdown_called_)) {
+      DeleteDelayedTasks();
+      return true;
+    }
+    // An idle worker may be sleeping until a later delayed task, or forever.
+    // Wake one so that it recomputes its timeout.
+    SignalHasWork();
+    if (subtle::Acquire_Load(&thread_count_) == 0)
+      StartAdditionalThreadIfPossible();
+    return true;
+  }
+
+  EnqueueImmediateTask(*sequenced, QueueIndexForPost());
+  return true;
+}
+
+void SequencedWorkerPool::Inner::WorkStealingThreadLoop(Worker* this_worker) {
+  {
+    AutoLock lock(lock_);
+    DCHECK(thread_being_created_);
+    thread_being_created_ = false;
+    std::pair<ThreadMap::iterator, bool> result =
+        threads_.insert(
+            std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
+    DCHECK(result.second);
+    subtle::Barrier_AtomicIncrement(&thread_count_, 1);
+  }
+  g_lazy_tls_worker_.Get().Set(this_worker);
+
+  // Threads are numbered sequentially from 1 as they are created, so the
+  // thread number doubles as the index of the worker's own deque.
+  const size_t queue_index = this_worker->thread_number() - 1;
+  DCHECK_LT(queue_index, work_queues_.size());
+
+  int tasks_until_delayed_poll = kDelayedTaskPollInterval;
+  while (true) {
+#if defined(OS_MACOSX)
+    base::mac::ScopedNSAutoreleasePool autorelease_pool;
+#endif
+
+    // Don't let a steady stream of immediate tasks starve delayed ones.
+    if (--tasks_until_delayed_poll <= 0) {
+      tasks_until_delayed_poll = kDelayedTaskPollInterval;
+      ScheduleDueDelayedTasks(queue_index, NULL);
+    }
+
+    StealableWork work;
+    if (TakeWork(queue_index, &work)) {
+      // Posts only start one thread at a time, so a burst of posts may find
+      // fewer workers than there is work. Catch up from here, as
+      // WillRunWorkerTask does in GLOBAL_QUEUE mode.
+      if (subtle::Acquire_Load(&idle_thread_count_) == 0 &&
+          subtle::Acquire_Load(&active_task_count_) >
+              subtle::Acquire_Load(&thread_count_)) {
+        StartAdditionalThreadIfPossible();
+      }
+      RunStealableWork(this_worker, queue_index, &work);
+      continue;
+    }
+
+    // Read the generation before looking at the delayed tasks so that a task
+    // posted after the look is noticed by WaitForWork().
+    const subtle::Atomic32 delayed_generation =
+        subtle::Acquire_Load(&delayed_generation_);
+    TimeDelta wait_time;
+    if (ScheduleDueDelayedTasks(queue_index, &wait_time))
+      continue;
+
+    // Same exit rule as in GLOBAL_QUEUE mode: once shutdown has started and
+    // nothing blocks it any more, the remaining workers may go.
+    if (WorkStealingShouldExit())
+      break;
+
+    WaitForWork(wait_time, delayed_generation);
+  }
+
+  // |g_lazy_tls_worker_| is deliberately left set: Worker::Run() may drop the
+  // last reference to the pool after this returns, and OnDestruct() relies on
+  // RunsTasksOnCurrentThread() to avoid joining this thread from itself.
+
+  // Other idle workers may be able to exit as well.
+  SignalAllIdleWorkers();
+
+  // Possibly unblock shutdown.
+  can_shutdown_cv_.Signal();
+}
+
+void SequencedWorkerPool::Inner::WorkStealingCleanupForTesting() {
+  DCHECK(!RunsTasksOnCurrentThread());
+  base::ThreadRestrictions::ScopedAllowWait allow_wait;
+  if (IsShutdownInProgress())
+    return;
+
+  // Delayed tasks are deleted rather than run, as in GLOBAL_QUEUE mode.
+  DeleteDelayedTasks();
+
+  AutoLock lock(lock_);
+  subtle::Barrier_AtomicIncrement(&flush_waiter_count_, 1);
+  while (subtle::Acquire_Load(&active_task_count_) != 0)
+    cleanup_cv_.Wait();
+  subtle::Barrier_AtomicIncrement(&flush_waiter_count_, -1);
+}
+
+SequencedWorkerPool::Worker* SequencedWorkerPool::Inner::CurrentWorker() const {
+  Worker* worker = g_lazy_tls_worker_.Get().Get();
+  return worker && worker->owning_pool() == worker_pool_ ? worker : NULL;
+}
+
+size_t SequencedWorkerPool::Inner::QueueIndexForPost() {
+  // Tasks posted from a worker go to its own deque, where they are likely to
+  // be picked up by the same thread.
+  Worker* worker = CurrentWorker();
+  if (worker)
+    return worker->thread_number() - 1;
+
+  // Spread other posts over the workers started so far. Idle workers steal
+  // from busy ones, so this doesn't need to be exact.
+  const subtle::Atomic32 thread_count = subtle::Acquire_Load(&thread_count_);
+  if (thread_count <= 0)
+    return 0;
+  const uint32 cursor = static_cast<uint32>(
+      subtle::NoBarrier_AtomicIncrement(&next_queue_, 1));
+  return cursor % static_cast<uint32>(thread_count);
+}
+
+void SequencedWorkerPool::Inner::EnqueueImmediateTask(
+    const SequencedTask& task,
+    size_t queue_index) {
+  subtle::Barrier_AtomicIncrement(&active_task_count_, 1);
+
+  StealableWork work;
+  if (task.sequence_token_id) {
+    SequenceShard& shard = ShardForSequence(task.sequence_token_id);
+    AutoLock lock(shard.lock);
+    SequenceShard::SequenceMap::iterator found =
+        shard.sequences.find(task.sequence_token_id);
+    if (found != shard.sequences.end()) {
+      // The sequence is already scheduled. Its worker will get to this task.
+      found->second.push_back(task);
+      return;
+    }
+    shard.sequences[task.sequence_token_id].push_back(task);
+    work.sequence_token_id = task.sequence_token_id;
+  } else {
+    work.task = task;
+  }
+  PushWork(work, queue_index);
+}
+
+void SequencedWorkerPool::Inner::PushWork(const StealableWork& work,
+                                          size_t queue_index) {
+  DCHECK_LT(queue_index, work_queues_.size());
+  WorkQueue* queue = work_queues_[queue_index];
+  {
+    AutoLock lock(queue->lock);
+    queue->work.push_back(work);
+  }
+
+  // Pairs with the increment of |idle_thread_count_| in WaitForWork(): either
+  // we see the idle worker here, or it sees our work when it re-checks the
+  // deques.
+  subtle::MemoryBarrier();
+  if (subtle::Acquire_Load(&idle_thread_count_) > 0)
+    SignalHasWork();
+  else
+    StartAdditionalThreadIfPossible();
+}
+
+bool SequencedWorkerPool::Inner::TakeWork(size_t queue_index,
+                                          StealableWork* work) {
+  {
+    WorkQueue* own_queue = work_queues_[queue_index];
+    AutoLock lock(own_queue->lock);
+    if (!own_queue->work.empty()) {
+      *work = own_queue->work.front();
+      own_queue->work.pop_front();
+      return true;
+    }
+  }
+
+  // Steal from the back of the other deques, starting with our neighbour so
+  // that thieves don't all converge on the same victim.
+  const size_t num_queues = work_queues_.size();
+  for (size_t i = 1; i < num_queues; ++i) {
+    WorkQueue* victim = work_queues_[(queue_index + i) % num_queues];
+    AutoLock lock(victim->lock);
+    if (!victim->work.empty()) {
+      *work = victim->work.back();
+      victim->work.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SequencedWorkerPool::Inner::AnyWorkQueued() {
+  for (size_t i = 0; i < work_queues_.size(); ++i) {
+    AutoLock lock(work_queues_[i]->lock);
+    if (!work_queues_[i]->work.empty())
+      return true;
+  }
+  return false;
+}
+
+void SequencedWorkerPool::Inner::RunStealableWork(Worker* this_worker,
+                                                  size_t queue_index,
+                                                  StealableWork* work) {
+  const int sequence_token_id = work->sequence_token_id;
+  if (sequence_token_id) {
+    SequenceShard& shard = ShardForSequence(sequence_token_id);
+    AutoLock lock(shard.lock);
+    SequenceShard::SequenceMap::iterator found =
+        shard.sequences.find(sequence_token_id);
+    DCHECK(found != shard.sequences.end());
+    DCHECK(!found->second.empty());
+    work->task = found->second.front();
+    found->second.pop_front();
+  }
+  SequencedTask& task = work->task;
+  const WorkerShutdown shutdown_behavior = task.shutdown_behavior;
+
+  // Count the thread as blocking shutdown before checking the shutdown flag,
+  // so that a SKIP_ON_SHUTDOWN task is either skipped or waited for.
+  if (shutdown_behavior != CONTINUE_ON_SHUTDOWN) {
+    subtle::Barrier_AtomicIncrement(&ws_blocking_shutdown_thread_count_, 1);
+  }
+  if (shutdown_behavior == BLOCK_SHUTDOWN) {
+    subtle::Barrier_AtomicIncrement(
+        &ws_blocking_shutdown_pending_task_count_, -1);
+  }
+
+  // Once shutdown has started, runnable tasks that don't block it are deleted
+  // instead of run, as in GetWork(). Since only the head of a sequence is
+  // ever taken, this never deletes a task ahead of a running one.
+  if (shutdown_behavior == BLOCK_SHUTDOWN ||
+      !subtle::Acquire_Load(&ws_shutdown_called_)) {
+    TRACE_EVENT_FLOW_END0(TRACE_DISABLED_BY_DEFAULT("toplevel.flow"),
+        "SequencedWorkerPool::PostTask",
+        TRACE_ID_MANGLE(GetTaskTraceID(task, static_cast<void*>(this))));
+    TRACE_EVENT2("toplevel", "SequencedWorkerPool::ThreadLoop",
+                 "src_file", task.posted_from.file_name(),
+                 "src_func", task.posted_from.function_name());
+
+    this_worker->set_running_task_info(
+        SequenceToken(task.sequence_token_id), shutdown_behavior);
+
+    tracked_objects::ThreadData::PrepareForStartOfRun(task.birth_tally);
+    tracked_objects::TaskStopwatch stopwatch;
+    stopwatch.Start();
+    task.task.Run();
+    stopwatch.Stop();
+
+    tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(
+        task, stopwatch);
+
+    // Destroy the task before resetting the running task info so that
+    // sequence-checking from within the task's destructor still works.
+    task.task = Closure();
+
+    this_worker->reset_running_task_info();
+  } else {
+    task.task = Closure();
+  }
+
+  if (shutdown_behavior != CONTINUE_ON_SHUTDOWN) {
+    subtle::Barrier_AtomicIncrement(&ws_blocking_shutdown_thread_count_, -1);
+  }
+
+  // Hand the sequence's next task out, or mark the sequence idle. The
+  // sequence goes to the back of our own deque so that other work queued here
+  // gets a turn, and other workers may steal it.
+  if (sequence_token_id) {
+    bool more_in_sequence = false;
+    {
+      SequenceShard& shard = ShardForSequence(sequence_token_id);
+      AutoLock lock(shard.lock);
+      SequenceShard::SequenceMap::iterator found =
+          shard.sequences.find(sequence_token_id);
+      DCHECK(found != shard.sequences.end());
+      if (found->second.empty())
+        shard.sequences.erase(found);
+      else
+        more_in_sequence = true;
+    }
+    if (more_in_sequence) {
+      StealableWork next;
+      next.sequence_token_id = sequence_token_id;
+      PushWork(next, queue_index);
+    }
+  }
+
+  if (subtle::Barrier_AtomicIncrement(&active_task_count_, -1) == 0 &&
+      subtle::Acquire_Load(&flush_waiter_count_) > 0) {
+    AutoLock lock(lock_);
+    cleanup_cv_.Broadcast();
+  }
+
+  if (subtle::Acquire_Load(&ws_shutdown_called_))
+    NotifyShutdownProgress();
+}
+
+bool SequencedWorkerPool::Inner::ScheduleDueDelayedTasks(size_t queue_index,
+                                                         TimeDelta* wait_time) {
+  if (wait_time)
+    *wait_time = TimeDelta();
+  if (!subtle::Acquire_Load(&has_delayed_tasks_))
+    return false;
+
+  // Once shutdown has started, delayed tasks are deleted rather than run, as
+  // GetWork() does in GLOBAL_QUEUE mode. They may hold references to the pool.
+  if (subtle::Acquire_Load(&ws_shutdown_called_)) {
+    DeleteDelayedTasks();
+    return false;
+  }
+
+  std::vector<SequencedTask> due_tasks;
+  {
+    AutoLock lock(delayed_lock_);
+    const TimeTicks current_time = TimeTicks::Now();
+    while (!delayed_tasks_.empty() &&
+           delayed_tasks_.begin()->time_to_run <= current_time) {
+      due_tasks.push_back(*delayed_tasks_.begin());
+      delayed_tasks_.erase(delayed_tasks_.begin());
+    }
+    if (delayed_tasks_.empty())
+      subtle::Release_Store(&has_delayed_tasks_, 0);
+    else if (wait_time)
+      *wait_time = delayed_tasks_.begin()->time_to_run - current_time;
+  }
+
+  // Due tasks are queued in time-to-run order, so tasks of one sequence keep
+  // the order they had in |delayed_tasks_|.
+  for (size_t i = 0; i < due_tasks.size(); ++i)
+    EnqueueImmediateTask(due_tasks[i], queue_index);
+  return !due_tasks.empty();
+}
+
+void SequencedWorkerPool::Inner::DeleteDelayedTasks() {
+  // The tasks are destroyed outside |delayed_lock_| since their destructors
+  // may post tasks.
+  PendingTaskSet delete_these_outside_lock;
+  {
+    AutoLock lock(delayed_lock_);
+    delete_these_outside_lock.swap(delayed_tasks_);
+    subtle::Release_Store(&has_delayed_tasks_, 0);
+  }
+}
+
+void SequencedWorkerPool::Inner::WaitForWork(
+    TimeDelta wait_time,
+    subtle::Atomic32 delayed_generation) {
+  AutoLock lock(idle_lock_);
+  subtle::Barrier_AtomicIncrement(&idle_thread_count_, 1);
+
+  // Re-check everything now that we're advertised as idle. Anything that
+  // becomes true after this point signals |has_work_idle_cv_| with
+  // |idle_lock_| held, so the wakeup can't be lost.
+  if (!AnyWorkQueued() && !WorkStealingShouldExit() &&
+      subtle::Acquire_Load(&delayed_generation_) == delayed_generation) {
+    if (wait_time == TimeDelta())
+      has_work_idle_cv_.Wait();
+    else
+      has_work_idle_cv_.TimedWait(wait_time);
+  }
+
+  subtle::Barrier_AtomicIncrement(&idle_thread_count_, -1);
+}
+
+bool SequencedWorkerPool::Inner::WorkStealingShouldExit() const {
+  return subtle::Acquire_Load(&ws_shutdown_called_) &&
+         subtle::Acquire_Load(&ws_blocking_shutdown_pending_task_count_) == 0;
+}
+
+void SequencedWorkerPool::Inner::StartAdditionalThreadIfPossible() {
+  // Cheap check first so that a fully started pool never takes |lock_|.
+  if (subtle::Acquire_Load(&thread_count_) >=
+      static_cast<subtle::Atomic32>(max_threads_)) {
+    return;
+  }
+
+  int thread_number = 0;
+  {
+    AutoLock lock(lock_);
+    // See PrepareToStartAdditionalThreadIfHelpful for how thread creation
+    // works.
+    if (!shutdown_called_ &&
+        !thread_being_created_ &&
+        threads_.size() < max_threads_) {
+      thread_being_created_ = true;
+      thread_number = static_cast<int>(threads_.size() + 1);
+    }
+  }
+  if (thread_number)
+    FinishStartingAdditionalThread(thread_number);
+}
+
+void SequencedWorkerPool::Inner::SignalAllIdleWorkers() {
+  DCHECK_EQ(WORK_STEALING, scheduling_mode_);
+  AutoLock lock(idle_lock_);
+  has_work_idle_cv_.Broadcast();
+}
+
+void SequencedWorkerPool::Inner::NotifyShutdownProgress() {
+  // Idle workers may be allowed to exit now.
+  SignalAllIdleWorkers();
+
+  AutoLock lock(lock_);
+  if (CanShutdown())
+    can_shutdown_cv_.Signal();
+}
+
 base::StaticAtomicSequenceNumber
 SequencedWorkerPool::Inner::g_last_sequence_number_;
 
+base::LazyInstance<ThreadLocalPointer<SequencedWorkerPool::Worker> >::Leaky
+    SequencedWorkerPool::Inner::g_lazy_tls_worker_ = LAZY_INSTANCE_INITIALIZER;
+
 // SequencedWorkerPool --------------------------------------------------------
 
 // static
@@ -1162,7 +1880,8 @@ SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix)
     : constructor_message_loop_(MessageLoopProxy::current()),
-      inner_(new Inner(this, max_threads, thread_name_prefix, NULL)) {
+      inner_(new Inner(this, max_threads, thread_name_prefix, NULL,
+                       GLOBAL_QUEUE)) {
 }
 
 SequencedWorkerPool::SequencedWorkerPool(
@@ -1170,7 +1889,27 @@ SequencedWorkerPool::SequencedWorkerPool(
     const std::string& thread_name_prefix,
     TestingObserver* observer)
     : constructor_message_loop_(MessageLoopProxy::current()),
-      inner_(new Inner(this, max_threads, thread_name_prefix, observer)) {
+      inner_(new Inner(this, max_threads, thread_name_prefix, observer,
+                       GLOBAL_QUEUE)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(this, max_threads, thread_name_prefix, NULL,
+                       scheduling_mode)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    TestingObserver* observer,
+    SchedulingMode scheduling_mode)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(this, max_threads, thread_name_prefix, observer,
+                       scheduling_mode)) {
 }
 
 SequencedWorkerPool::~SequencedWorkerPool() {}
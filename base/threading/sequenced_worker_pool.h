@@ -118,6 +118,22 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
     BLOCK_SHUTDOWN,
   };
 
+  // Defines how posted tasks are handed out to the worker threads.
+  enum SchedulingMode {
+    // All pending tasks are kept in a single time-ordered set that is guarded
+    // by one pool-wide lock. Every post and every task pickup takes the lock.
+    GLOBAL_QUEUE,
+
+    // Each worker thread owns a deque of runnable work and idle workers steal
+    // from the deques of busy ones. Tasks sharing a sequence token wait in a
+    // per-sequence queue from which at most one task at a time is handed to a
+    // worker, so the ordering guarantees described above still hold. The
+    // pool-wide lock is only taken to start threads, to resolve named tokens
+    // and around shutdown, which makes this mode a better fit for pools with
+    // many threads and many posting threads.
+    WORK_STEALING,
+  };
+
   // Opaque identifier that defines sequencing of tasks posted to the worker
   // pool.
   class SequenceToken {
@@ -171,6 +187,19 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
                       const std::string& thread_name_prefix,
                       TestingObserver* observer);
 
+  // Like the two-argument constructor, which uses GLOBAL_QUEUE, but with an
+  // explicit |scheduling_mode|.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode scheduling_mode);
+
+  // Like above, but with |observer| for testing.  Does not take
+  // ownership of |observer|.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      TestingObserver* observer,
+                      SchedulingMode scheduling_mode);
+
   // Returns a unique token that can be used to sequence tasks posted to
   // PostSequencedWorkerTask(). Valid tokens are always nonzero.
   SequenceToken GetSequenceToken();
@@ -0,0 +1,152 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_switches.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/sys_info.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kNumTasks = 100000;
+
+// Tasks are posted from this many threads at once so that contention on the
+// posting side is measured as well.
+const size_t kNumPostingThreads = 4;
+
+// Measures how many empty tasks per millisecond a SequencedWorkerPool runs
+// for a given scheduling mode, worker count and number of sequences.
+class SequencedWorkerPoolPerfTest : public testing::Test {
+ public:
+  SequencedWorkerPoolPerfTest()
+      : remaining_tasks_(0),
+        done_(false, false) {
+    // Disable the task profiler as it adds significant cost!
+    CommandLine::Init(0, NULL);
+    CommandLine::ForCurrentProcess()->AppendSwitchASCII(
+        switches::kProfilerTiming,
+        switches::kProfilerTimingDisabledValue);
+  }
+
+  // |num_sequences| of zero posts unsequenced tasks.
+  void RunThroughputTest(SequencedWorkerPool::SchedulingMode scheduling_mode,
+                         size_t num_threads,
+                         size_t num_sequences) {
+    SequencedWorkerPoolOwner pool_owner(num_threads, "PerfTest",
+                                        scheduling_mode);
+    const scoped_refptr<SequencedWorkerPool>& pool = pool_owner.pool();
+
+    std::vector<SequencedWorkerPool::SequenceToken> tokens;
+    for (size_t i = 0; i < num_sequences; ++i)
+      tokens.push_back(pool->GetSequenceToken());
+
+    ScopedVector<Thread> posting_threads;
+    for (size_t i = 0; i < kNumPostingThreads; ++i) {
+      posting_threads.push_back(new Thread("Poster"));
+      posting_threads.back()->Start();
+    }
+
+    subtle::NoBarrier_Store(&remaining_tasks_, kNumTasks);
+    const int tasks_per_thread = kNumTasks / kNumPostingThreads;
+    TimeTicks start = TimeTicks::Now();
+    for (size_t i = 0; i < kNumPostingThreads; ++i) {
+      posting_threads[i]->message_loop_proxy()->PostTask(
+          FROM_HERE,
+          Bind(&SequencedWorkerPoolPerfTest::PostTasks, Unretained(this),
+               pool, tokens, i * tasks_per_thread, tasks_per_thread));
+    }
+    done_.Wait();
+    TimeDelta elapsed = TimeTicks::Now() - start;
+
+    posting_threads.clear();
+    pool->Shutdown();
+
+    const char* mode_name =
+        scheduling_mode == SequencedWorkerPool::WORK_STEALING ?
+        "WorkStealing" : "GlobalQueue";
+    std::string trace = StringPrintf(
+        "%s_%d_Threads_%d_Sequences", mode_name,
+        static_cast<int>(num_threads), static_cast<int>(num_sequences));
+    perf_test::PrintResult(
+        "task_throughput", "", trace,
+        kNumTasks / elapsed.InMillisecondsF(), "tasks/ms", true);
+  }
+
+  // Runs each test for both scheduling modes and for worker counts doubling
+  // from one up to the number of cores.
+  void RunForAllModesAndThreadCounts(size_t num_sequences) {
+    const size_t num_cores =
+        static_cast<size_t>(SysInfo::NumberOfProcessors());
+    for (size_t num_threads = 1; ; num_threads *= 2) {
+      num_threads = std::min(num_threads, num_cores);
+      RunThroughputTest(SequencedWorkerPool::GLOBAL_QUEUE, num_threads,
+                        num_sequences);
+      RunThroughputTest(SequencedWorkerPool::WORK_STEALING, num_threads,
+                        num_sequences);
+      if (num_threads == num_cores)
+        break;
+    }
+  }
+
+ private:
+  void PostTasks(const scoped_refptr<SequencedWorkerPool>& pool,
+                 const std::vector<SequencedWorkerPool::SequenceToken>& tokens,
+                 int first_task,
+                 int num_tasks) {
+    Closure task =
+        Bind(&SequencedWorkerPoolPerfTest::Task, Unretained(this));
+    for (int i = first_task; i < first_task + num_tasks; ++i) {
+      if (tokens.empty())
+        pool->PostWorkerTask(FROM_HERE, task);
+      else
+        pool->PostSequencedWorkerTask(tokens[i % tokens.size()], FROM_HERE,
+                                      task);
+    }
+  }
+
+  void Task() {
+    if (subtle::Barrier_AtomicIncrement(&remaining_tasks_, -1) == 0)
+      done_.Signal();
+  }
+
+  MessageLoop message_loop_;
+  subtle::Atomic32 remaining_tasks_;
+  WaitableEvent done_;
+};
+
+TEST_F(SequencedWorkerPoolPerfTest, Unsequenced) {
+  RunForAllModesAndThreadCounts(0);
+}
+
+TEST_F(SequencedWorkerPoolPerfTest, OneSequence) {
+  RunForAllModesAndThreadCounts(1);
+}
+
+TEST_F(SequencedWorkerPoolPerfTest, SixteenSequences) {
+  RunForAllModesAndThreadCounts(16);
+}
+
+TEST_F(SequencedWorkerPoolPerfTest, ManySequences) {
+  RunForAllModesAndThreadCounts(1024);
+}
+
+}  // namespace
+
+}  // namespace base
@@ -53,6 +53,7 @@ struct Thread::StartupData {
 Thread::Options::Options()
     : message_loop_type(MessageLoop::TYPE_DEFAULT),
       timer_slack(TIMER_SLACK_NONE),
+      use_timer_wheel(false),
       stack_size(0) {
 }
 
@@ -60,6 +61,7 @@ Thread::Options::Options(MessageLoop::Type type,
                          size_t size)
     : message_loop_type(type),
       timer_slack(TIMER_SLACK_NONE),
+      use_timer_wheel(false),
       stack_size(size) {
 }
 
@@ -216,6 +218,10 @@ void Thread::ThreadMain() {
     ANNOTATE_THREAD_NAME(name_.c_str());  // Tell the name to race detector.
     message_loop->set_thread_name(name_);
     message_loop->SetTimerSlack(startup_data_->options.timer_slack);
+    if (startup_data_->options.use_timer_wheel)
+      message_loop->UseTimerWheel();
+    message_loop->SetDelayedTaskSlack(
+        startup_data_->options.delayed_task_slack);
     message_loop_ = message_loop.get();
 
 #if defined(OS_WIN)
@@ -48,6 +48,14 @@ class BASE_EXPORT Thread : PlatformThread::Delegate {
     // Specify timer slack for thread message loop.
     TimerSlack timer_slack;
 
+    // Keep the delayed tasks of the thread message loop in a timing wheel. See
+    // MessageLoop::UseTimerWheel().
+    bool use_timer_wheel;
+
+    // Let delayed tasks of the thread message loop run this much late to
+    // coalesce wake-ups. See MessageLoop::SetDelayedTaskSlack().
+    TimeDelta delayed_task_slack;
+
     // Used to create the MessagePump for the MessageLoop. The callback is Run()
     // on the thread. If message_pump_factory.is_null(), then a MessagePump
     // appropriate for |message_loop_type| is created. Setting this forces the
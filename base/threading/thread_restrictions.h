@@ -49,6 +49,7 @@ class Bus;
 }
 namespace disk_cache {
 class BackendImpl;
+class BackendImplV3;
 class InFlightIO;
 }
 namespace mojo {
@@ -202,6 +203,7 @@ class BASE_EXPORT ThreadRestrictions {
   friend class content::TextInputClientMac;       // http://crbug.com/121917
   friend class dbus::Bus;                         // http://crbug.com/125222
   friend class disk_cache::BackendImpl;           // http://crbug.com/74623
+  friend class disk_cache::BackendImplV3;         // http://crbug.com/74623
   friend class disk_cache::InFlightIO;            // http://crbug.com/74623
   friend class net::internal::AddressTrackerLinux;  // http://crbug.com/125097
   friend class ::BrowserProcessImpl;              // http://crbug.com/125207
@@ -19,6 +19,8 @@ namespace base {
 // edge cases:
 // - deleted by the task runner.
 // - abandoned (orphaned) by Timer.
+// The task is handed back to Timer when it runs, so that Timer can post it
+// again instead of allocating a new one.
 class BaseTimerTaskInternal {
  public:
   explicit BaseTimerTaskInternal(Timer* timer)
@@ -33,20 +35,24 @@ class BaseTimerTaskInternal {
       timer_->StopAndAbandon();
   }
 
-  void Run() {
+  static void Run(scoped_ptr<BaseTimerTaskInternal> task) {
     // timer_ is NULL if we were abandoned.
-    if (!timer_)
+    if (!task->timer_)
       return;
 
-    // *this will be deleted by the task runner, so Timer needs to
-    // forget us:
-    timer_->scheduled_task_ = NULL;
+    // Timer takes |task| back, so it needs to forget about the pending one:
+    task->timer_->scheduled_task_ = NULL;
 
-    // Although Timer should not call back into *this, let's clear
-    // the timer_ member first to be pedantic.
-    Timer* timer = timer_;
-    timer_ = NULL;
-    timer->RunScheduledTask();
+    // Clear the timer_ member so that deleting |task| is a no-op unless Timer
+    // posts it again.
+    Timer* timer = task->timer_;
+    task->timer_ = NULL;
+    timer->RunScheduledTask(task.Pass());
+  }
+
+  // Points the task at |timer|, which is about to post it.
+  void set_timer(Timer* timer) {
+    timer_ = timer;
   }
 
   // The task remains in the MessageLoop queue, but nothing will happen when it
@@ -148,17 +154,24 @@ void Timer::SetTaskInfo(const tracked_objects::Location& posted_from,
 }
 
 void Timer::PostNewScheduledTask(TimeDelta delay) {
+  PostScheduledTask(
+      scoped_ptr<BaseTimerTaskInternal>(new BaseTimerTaskInternal(this)),
+      delay);
+}
+
+void Timer::PostScheduledTask(scoped_ptr<BaseTimerTaskInternal> task,
+                              TimeDelta delay) {
   DCHECK(scheduled_task_ == NULL);
   is_running_ = true;
-  scheduled_task_ = new BaseTimerTaskInternal(this);
+  task->set_timer(this);
+  scheduled_task_ = task.get();
+  base::Closure closure =
+      base::Bind(&BaseTimerTaskInternal::Run, base::Passed(&task));
   if (delay > TimeDelta::FromMicroseconds(0)) {
-    GetTaskRunner()->PostDelayedTask(posted_from_,
-        base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)),
-        delay);
+    GetTaskRunner()->PostDelayedTask(posted_from_, closure, delay);
     scheduled_run_time_ = desired_run_time_ = TimeTicks::Now() + delay;
   } else {
-    GetTaskRunner()->PostTask(posted_from_,
-        base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)));
+    GetTaskRunner()->PostTask(posted_from_, closure);
     scheduled_run_time_ = desired_run_time_ = TimeTicks();
   }
   // Remember the thread ID that posts the first task -- this will be verified
@@ -182,7 +195,7 @@ void Timer::AbandonScheduledTask() {
   }
 }
 
-void Timer::RunScheduledTask() {
+void Timer::RunScheduledTask(scoped_ptr<BaseTimerTaskInternal> task) {
   // Task may have been disabled.
   if (!is_running_)
     return;
@@ -195,22 +208,23 @@ void Timer::RunScheduledTask() {
     // Task runner may have called us late anyway, so only post a continuation
     // task if the desired_run_time_ is in the future.
     if (desired_run_time_ > now) {
-      // Post a new task to span the remaining time.
-      PostNewScheduledTask(desired_run_time_ - now);
+      // Post the task again to span the remaining time.
+      PostScheduledTask(task.Pass(), desired_run_time_ - now);
       return;
     }
   }
 
   // Make a local copy of the task to run. The Stop method will reset the
   // user_task_ member if retain_user_task_ is false.
-  base::Closure task = user_task_;
+  base::Closure user_task = user_task_;
 
   if (is_repeating_)
-    PostNewScheduledTask(delay_);
+    PostScheduledTask(task.Pass(), delay_);
   else
     Stop();
+  task.reset();
 
-  task.Run();
+  user_task.Run();
 
   // No more member accesses here: *this could be deleted at this point.
 }
@@ -55,6 +55,7 @@
 #include "base/bind_helpers.h"
 #include "base/callback.h"
 #include "base/location.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -134,6 +135,10 @@ class BASE_EXPORT Timer {
   // and desired_run_time_ are reset to Now() + delay.
   void PostNewScheduledTask(TimeDelta delay);
 
+  // Like PostNewScheduledTask, but reuses |task|, which has just run.
+  void PostScheduledTask(scoped_ptr<BaseTimerTaskInternal> task,
+                         TimeDelta delay);
+
   // Returns the task runner on which the task should be scheduled. If the
   // corresponding task_runner_ field is null, the task runner for the current
   // thread is returned.
@@ -143,8 +148,9 @@ class BASE_EXPORT Timer {
   // this object.
   void AbandonScheduledTask();
 
-  // Called by BaseTimerTaskInternal when the MessageLoop runs it.
-  void RunScheduledTask();
+  // Called by BaseTimerTaskInternal when the MessageLoop runs |task|. Posts
+  // |task| again if the timer needs to wait longer or repeats.
+  void RunScheduledTask(scoped_ptr<BaseTimerTaskInternal> task);
 
   // Stop running task (if any) and abandon scheduled task (if any).
   void StopAndAbandon() {
@@ -0,0 +1,684 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_binary.h"
+
+#include <string.h>
+
+#include "base/files/file_path.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread_restrictions.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_impl.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+const char kMagic[] = { 'C', 'r', 'B', 'T' };
+const unsigned char kVersion = 1;
+const size_t kHeaderSize = sizeof(kMagic) + 1;
+
+enum RecordType {
+  kProcessRecord = 1,
+  kStringRecord = 2,
+  kEventRecord = 3,
+};
+
+// How often the writer thread writes out the chunks returned to it.
+const int kWriteIntervalMs = 50;
+
+// The writer thread writes to the file whenever it has encoded this much.
+const size_t kWriteBufferSize = 1024 * 1024;
+
+// ConvertBinaryTraceFileToJSON() reads the binary trace this much at a time.
+const int kReadBlockSize = 64 * 1024;
+
+void AppendVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendSigned(int64 value, std::string* out) {
+  AppendVarint((static_cast<uint64>(value) << 1) ^
+                   static_cast<uint64>(value >> 63),
+               out);
+}
+
+void AppendInlineString(const StringPiece& str, std::string* out) {
+  AppendVarint(static_cast<uint64>(str.size()) << 1 | 1, out);
+  str.AppendToString(out);
+}
+
+void AppendRecord(unsigned char type,
+                  const std::string& payload,
+                  std::string* out) {
+  out->push_back(static_cast<char>(type));
+  AppendVarint(payload.size(), out);
+  out->append(payload);
+}
+
+// Reads the fields of a record one at a time. All methods return false if the
+// data ends before the field does.
+class FieldReader {
+ public:
+  explicit FieldReader(const StringPiece& data)
+      : pos_(data.data()), end_(data.data() + data.size()) {}
+
+  bool ReadByte(unsigned char* value) {
+    if (pos_ == end_)
+      return false;
+    *value = static_cast<unsigned char>(*pos_++);
+    return true;
+  }
+
+  bool ReadVarint(uint64* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      unsigned char byte;
+      if (!ReadByte(&byte))
+        return false;
+      *value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadSigned(int64* value) {
+    uint64 zigzag;
+    if (!ReadVarint(&zigzag))
+      return false;
+    *value = static_cast<int64>(zigzag >> 1) ^ -static_cast<int64>(zigzag & 1);
+    return true;
+  }
+
+  bool ReadBytes(uint64 size, StringPiece* value) {
+    if (size > static_cast<uint64>(end_ - pos_))
+      return false;
+    value->set(pos_, static_cast<size_t>(size));
+    pos_ += size;
+    return true;
+  }
+
+  // Reads a string field, looking interned strings up in |strings|.
+  bool ReadString(const std::vector<std::string>& strings,
+                  StringPiece* value) {
+    uint64 field;
+    if (!ReadVarint(&field))
+      return false;
+    if (field & 1)
+      return ReadBytes(field >> 1, value);
+    if ((field >> 1) >= strings.size())
+      return false;
+    *value = strings[static_cast<size_t>(field >> 1)];
+    return true;
+  }
+
+  StringPiece remaining() const {
+    return StringPiece(pos_, end_ - pos_);
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BinaryTraceEncoder
+//
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryTraceEncoder::BinaryTraceEncoder() : last_timestamp_(0) {
+}
+
+BinaryTraceEncoder::~BinaryTraceEncoder() {
+}
+
+void BinaryTraceEncoder::AppendHeader(int process_id, std::string* out) {
+  out->append(kMagic, sizeof(kMagic));
+  out->push_back(static_cast<char>(kVersion));
+
+  payload_.clear();
+  AppendSigned(process_id, &payload_);
+  AppendRecord(kProcessRecord, payload_, out);
+}
+
+void BinaryTraceEncoder::AppendEvent(const TraceEvent& event,
+                                     std::string* out) {
+  payload_.clear();
+
+  char phase = event.phase();
+  if (phase == TRACE_EVENT_PHASE_COMPLETE &&
+      event.duration().ToInternalValue() == -1) {
+    phase = TRACE_EVENT_PHASE_BEGIN;
+  }
+  payload_.push_back(phase);
+  payload_.push_back(static_cast<char>(event.flags()));
+  AppendSigned(event.thread_id(), &payload_);
+  int64 timestamp = event.timestamp().ToInternalValue();
+  AppendSigned(timestamp - last_timestamp_, &payload_);
+  last_timestamp_ = timestamp;
+  AppendSigned(event.thread_timestamp().ToInternalValue(), &payload_);
+
+  bool copy = !!(event.flags() & TRACE_EVENT_FLAG_COPY);
+  AppendString(TraceLog::GetCategoryGroupName(event.category_group_enabled()),
+               false, out);
+  AppendString(event.name(), copy, out);
+
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    AppendSigned(event.duration().ToInternalValue(), &payload_);
+    AppendSigned(event.thread_duration().ToInternalValue(), &payload_);
+  }
+  if (event.flags() & TRACE_EVENT_FLAG_HAS_ID)
+    AppendVarint(event.id(), &payload_);
+
+  int num_args = 0;
+  while (num_args < kTraceMaxNumArgs && event.arg_name(num_args))
+    ++num_args;
+  payload_.push_back(static_cast<char>(num_args));
+  for (int i = 0; i < num_args; ++i) {
+    AppendString(event.arg_name(i), copy, out);
+    unsigned char type = event.arg_type(i);
+    payload_.push_back(static_cast<char>(type));
+
+    TraceEvent::TraceValue value = event.arg_value(i);
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL:
+        payload_.push_back(value.as_bool ? 1 : 0);
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+        AppendVarint(value.as_uint, &payload_);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        AppendSigned(value.as_int, &payload_);
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE: {
+        uint64 bits;
+        memcpy(&bits, &value.as_double, sizeof(bits));
+        for (size_t byte = 0; byte < sizeof(bits); ++byte)
+          payload_.push_back(static_cast<char>(bits >> (byte * 8)));
+        break;
+      }
+      case TRACE_VALUE_TYPE_POINTER:
+        AppendVarint(reinterpret_cast<uintptr_t>(value.as_pointer), &payload_);
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+        // Like the JSON format, write NULL strings as "NULL".
+        AppendString(value.as_string ? value.as_string : "NULL", false, out);
+        break;
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        AppendString(value.as_string ? value.as_string : "NULL", true, out);
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE: {
+        std::string converted;
+        event.convertable_value(i)->AppendAsTraceFormat(&converted);
+        AppendInlineString(converted, &payload_);
+        break;
+      }
+      default:
+        NOTREACHED() << "Don't know how to encode this value";
+        AppendVarint(0, &payload_);
+        break;
+    }
+  }
+
+  AppendRecord(kEventRecord, payload_, out);
+}
+
+void BinaryTraceEncoder::AppendString(const char* str,
+                                      bool copied,
+                                      std::string* out) {
+  if (copied) {
+    AppendInlineString(str, &payload_);
+    return;
+  }
+
+  hash_map<const char*, uint32>::iterator it = string_ids_.find(str);
+  if (it == string_ids_.end()) {
+    uint32 id = static_cast<uint32>(string_ids_.size());
+    it = string_ids_.insert(std::make_pair(str, id)).first;
+    std::string record;
+    AppendVarint(id, &record);
+    record.append(str);
+    AppendRecord(kStringRecord, record, out);
+  }
+  AppendVarint(static_cast<uint64>(it->second) << 1, &payload_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BinaryTraceDecoder
+//
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryTraceDecoder::BinaryTraceDecoder()
+    : read_header_(false),
+      process_id_(0),
+      last_timestamp_(0) {
+}
+
+BinaryTraceDecoder::~BinaryTraceDecoder() {
+}
+
+bool BinaryTraceDecoder::Decode(const StringPiece& data,
+                                size_t* bytes_read,
+                                std::string* json) {
+  *bytes_read = 0;
+  StringPiece remaining = data;
+  if (!read_header_) {
+    if (remaining.size() < kHeaderSize)
+      return true;
+    if (memcmp(remaining.data(), kMagic, sizeof(kMagic)) ||
+        static_cast<unsigned char>(remaining[sizeof(kMagic)]) != kVersion) {
+      return false;
+    }
+    remaining.remove_prefix(kHeaderSize);
+    read_header_ = true;
+  }
+
+  while (!remaining.empty()) {
+    FieldReader reader(remaining);
+    unsigned char type;
+    uint64 size;
+    StringPiece payload;
+    if (!reader.ReadByte(&type) || !reader.ReadVarint(&size) ||
+        !reader.ReadBytes(size, &payload)) {
+      // The rest of the record hasn't been read yet.
+      break;
+    }
+    if (!DecodeRecord(type, payload, json))
+      return false;
+    remaining = reader.remaining();
+  }
+  *bytes_read = data.size() - remaining.size();
+  return true;
+}
+
+bool BinaryTraceDecoder::DecodeRecord(unsigned char type,
+                                      const StringPiece& payload,
+                                      std::string* json) {
+  FieldReader reader(payload);
+  switch (type) {
+    case kProcessRecord: {
+      int64 process_id;
+      if (!reader.ReadSigned(&process_id))
+        return false;
+      process_id_ = static_cast<int>(process_id);
+      return true;
+    }
+    case kStringRecord: {
+      uint64 id;
+      if (!reader.ReadVarint(&id) || id != strings_.size())
+        return false;
+      strings_.push_back(reader.remaining().as_string());
+      return true;
+    }
+    case kEventRecord:
+      return DecodeEvent(payload, json);
+    default:
+      // Added by a later version of the format.
+      return true;
+  }
+}
+
+bool BinaryTraceDecoder::DecodeEvent(const StringPiece& payload,
+                                     std::string* json) {
+  FieldReader reader(payload);
+  unsigned char phase;
+  unsigned char flags;
+  int64 thread_id;
+  int64 timestamp_delta;
+  int64 thread_timestamp;
+  StringPiece category;
+  StringPiece name;
+  if (!reader.ReadByte(&phase) || !reader.ReadByte(&flags) ||
+      !reader.ReadSigned(&thread_id) || !reader.ReadSigned(&timestamp_delta) ||
+      !reader.ReadSigned(&thread_timestamp) ||
+      !reader.ReadString(strings_, &category) ||
+      !reader.ReadString(strings_, &name)) {
+    return false;
+  }
+
+  int64 duration = -1;
+  int64 thread_duration = -1;
+  if (phase == TRACE_EVENT_PHASE_COMPLETE &&
+      (!reader.ReadSigned(&duration) || !reader.ReadSigned(&thread_duration))) {
+    return false;
+  }
+  uint64 id = 0;
+  if ((flags & TRACE_EVENT_FLAG_HAS_ID) && !reader.ReadVarint(&id))
+    return false;
+  unsigned char num_args;
+  if (!reader.ReadByte(&num_args) || num_args > kTraceMaxNumArgs)
+    return false;
+
+  last_timestamp_ += timestamp_delta;
+  if (!json->empty())
+    json->append(",\n");
+  StringAppendF(json,
+      "{\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64 ",\"ph\":\"%c\",\"cat\":\"",
+      process_id_, static_cast<int>(thread_id), last_timestamp_, phase);
+  category.AppendToString(json);
+  json->append("\",\"name\":\"");
+  name.AppendToString(json);
+  json->append("\",\"args\":{");
+
+  for (int i = 0; i < num_args; ++i) {
+    StringPiece arg_name;
+    unsigned char type;
+    if (!reader.ReadString(strings_, &arg_name) || !reader.ReadByte(&type))
+      return false;
+    if (i > 0)
+      json->append(",");
+    json->append("\"");
+    arg_name.AppendToString(json);
+    json->append("\":");
+
+    TraceEvent::TraceValue value;
+    StringPiece str;
+    std::string terminated_str;
+    uint64 bits;
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL: {
+        unsigned char byte;
+        if (!reader.ReadByte(&byte))
+          return false;
+        value.as_bool = byte != 0;
+        break;
+      }
+      case TRACE_VALUE_TYPE_UINT:
+        if (!reader.ReadVarint(&bits))
+          return false;
+        value.as_uint = bits;
+        break;
+      case TRACE_VALUE_TYPE_INT: {
+        int64 as_int;
+        if (!reader.ReadSigned(&as_int))
+          return false;
+        value.as_int = as_int;
+        break;
+      }
+      case TRACE_VALUE_TYPE_DOUBLE:
+        if (!reader.ReadBytes(sizeof(bits), &str))
+          return false;
+        bits = 0;
+        for (size_t byte = 0; byte < sizeof(bits); ++byte)
+          bits |= static_cast<uint64>(static_cast<unsigned char>(str[byte]))
+                  << (byte * 8);
+        memcpy(&value.as_double, &bits, sizeof(bits));
+        break;
+      case TRACE_VALUE_TYPE_POINTER:
+        if (!reader.ReadVarint(&bits))
+          return false;
+        value.as_pointer =
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(bits));
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        if (!reader.ReadString(strings_, &str))
+          return false;
+        terminated_str = str.as_string();
+        value.as_string = terminated_str.c_str();
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE:
+        if (!reader.ReadString(strings_, &str))
+          return false;
+        str.AppendToString(json);
+        continue;
+      default:
+        return false;
+    }
+    TraceEvent::AppendValueAsJSON(type, value, json);
+  }
+  json->append("}");
+
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    if (duration != -1)
+      StringAppendF(json, ",\"dur\":%" PRId64, duration);
+    if (thread_timestamp && thread_duration != -1)
+      StringAppendF(json, ",\"tdur\":%" PRId64, thread_duration);
+  }
+  if (thread_timestamp)
+    StringAppendF(json, ",\"tts\":%" PRId64, thread_timestamp);
+  if (flags & TRACE_EVENT_FLAG_HAS_ID)
+    StringAppendF(json, ",\"id\":\"0x%" PRIx64 "\"", id);
+
+  if (phase == TRACE_EVENT_PHASE_INSTANT) {
+    char scope = '?';
+    switch (flags & TRACE_EVENT_FLAG_SCOPE_MASK) {
+      case TRACE_EVENT_SCOPE_GLOBAL:
+        scope = TRACE_EVENT_SCOPE_NAME_GLOBAL;
+        break;
+
+      case TRACE_EVENT_SCOPE_PROCESS:
+        scope = TRACE_EVENT_SCOPE_NAME_PROCESS;
+        break;
+
+      case TRACE_EVENT_SCOPE_THREAD:
+        scope = TRACE_EVENT_SCOPE_NAME_THREAD;
+        break;
+    }
+    StringAppendF(json, ",\"s\":\"%c\"", scope);
+  }
+
+  json->append("}");
+  return true;
+}
+
+bool ConvertBinaryTraceToJSON(const StringPiece& binary_trace,
+                              std::string* json) {
+  BinaryTraceDecoder decoder;
+  std::string events;
+  size_t bytes_read;
+  if (!decoder.Decode(binary_trace, &bytes_read, &events) ||
+      bytes_read != binary_trace.size()) {
+    return false;
+  }
+
+  TraceResultBuffer::SimpleOutput output;
+  TraceResultBuffer result_buffer;
+  result_buffer.SetOutputCallback(output.GetCallback());
+  result_buffer.Start();
+  if (!events.empty())
+    result_buffer.AddFragment(events);
+  result_buffer.Finish();
+  json->swap(output.json_output);
+  return true;
+}
+
+bool ConvertBinaryTraceFileToJSON(const FilePath& binary_path,
+                                  const FilePath& json_path) {
+  File binary_file(binary_path, File::FLAG_OPEN | File::FLAG_READ);
+  if (!binary_file.IsValid())
+    return false;
+  File json_file(json_path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+  if (!json_file.IsValid())
+    return false;
+
+  BinaryTraceDecoder decoder;
+  std::string binary;
+  std::string events;
+  bool has_events = false;
+  bool write_failed = false;
+  if (json_file.WriteAtCurrentPos("[", 1) != 1)
+    return false;
+  for (;;) {
+    size_t old_size = binary.size();
+    binary.resize(old_size + kReadBlockSize);
+    int bytes = binary_file.ReadAtCurrentPos(&binary[old_size], kReadBlockSize);
+    if (bytes < 0)
+      return false;
+    binary.resize(old_size + bytes);
+    if (!bytes)
+      break;
+
+    size_t bytes_read;
+    events.clear();
+    if (!decoder.Decode(binary, &bytes_read, &events))
+      return false;
+    binary.erase(0, bytes_read);
+    if (events.empty())
+      continue;
+    if (has_events)
+      events.insert(0, ",");
+    has_events = true;
+    int size = static_cast<int>(events.size());
+    write_failed |= json_file.WriteAtCurrentPos(events.data(), size) != size;
+  }
+  // Anything left over is a truncated record.
+  return binary.empty() && !write_failed &&
+         json_file.WriteAtCurrentPos("]", 1) == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BinaryTraceStream
+//
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryTraceStream::BinaryTraceStream(File file, int process_id)
+    : file_(file.Pass()),
+      process_id_(process_id),
+      thread_started_(false),
+      finish_event_(false, false),
+      pending_chunks_(0),
+      next_chunk_seq_(0),
+      finished_(0),
+      num_events_(0),
+      write_failed_(false) {
+}
+
+BinaryTraceStream::~BinaryTraceStream() {
+  DCHECK(!thread_started_);
+  // Delete the chunks that were returned after the writer thread had
+  // finished.
+  PendingChunk* pending = TakePendingChunks();
+  while (pending) {
+    PendingChunk* next = pending->next;
+    delete pending->chunk;
+    delete pending;
+    pending = next;
+  }
+}
+
+bool BinaryTraceStream::Start() {
+  DCHECK(!thread_started_);
+  thread_started_ = PlatformThread::Create(0, this, &thread_handle_);
+  return thread_started_;
+}
+
+scoped_ptr<TraceBufferChunk> BinaryTraceStream::GetChunk(size_t* index) {
+  *index = 0;
+  // Zero chunk_seq is not allowed.
+  uint32 seq;
+  do {
+    seq = static_cast<uint32>(
+        subtle::NoBarrier_AtomicIncrement(&next_chunk_seq_, 1));
+  } while (!seq);
+  return make_scoped_ptr(new TraceBufferChunk(seq));
+}
+
+void BinaryTraceStream::ReturnChunk(scoped_ptr<TraceBufferChunk> chunk) {
+  subtle::NoBarrier_AtomicIncrement(
+      &num_events_, static_cast<subtle::AtomicWord>(chunk->size()));
+  if (subtle::Acquire_Load(&finished_))
+    return;
+
+  PendingChunk* pending = new PendingChunk;
+  pending->chunk = chunk.release();
+  subtle::AtomicWord head;
+  do {
+    head = subtle::NoBarrier_Load(&pending_chunks_);
+    pending->next = reinterpret_cast<PendingChunk*>(head);
+  } while (subtle::Release_CompareAndSwap(
+               &pending_chunks_, head,
+               reinterpret_cast<subtle::AtomicWord>(pending)) != head);
+}
+
+void BinaryTraceStream::Finish() {
+  if (subtle::NoBarrier_AtomicExchange(&finished_, 1))
+    return;
+  if (!thread_started_)
+    return;
+
+  // Waits for the final write.
+  ThreadRestrictions::ScopedAllowIO allow_io;
+  finish_event_.Signal();
+  PlatformThread::Join(thread_handle_);
+  thread_started_ = false;
+}
+
+size_t BinaryTraceStream::num_events() const {
+  return static_cast<size_t>(subtle::NoBarrier_Load(&num_events_));
+}
+
+void BinaryTraceStream::ThreadMain() {
+  PlatformThread::SetName("TraceStreamWriter");
+  encoder_.AppendHeader(process_id_, &output_);
+  while (!finish_event_.TimedWait(
+      TimeDelta::FromMilliseconds(kWriteIntervalMs))) {
+    WritePendingChunks();
+  }
+  // Finish() stops new chunks from being queued before waking this thread,
+  // so this writes out everything returned before it was called.
+  WritePendingChunks();
+  file_.Close();
+}
+
+BinaryTraceStream::PendingChunk* BinaryTraceStream::TakePendingChunks() {
+  PendingChunk* pending = reinterpret_cast<PendingChunk*>(
+      subtle::NoBarrier_AtomicExchange(&pending_chunks_, 0));
+  subtle::MemoryBarrier();
+
+  // The list is newest first.
+  PendingChunk* in_order = NULL;
+  while (pending) {
+    PendingChunk* next = pending->next;
+    pending->next = in_order;
+    in_order = pending;
+    pending = next;
+  }
+  return in_order;
+}
+
+void BinaryTraceStream::WritePendingChunks() {
+  PendingChunk* pending = TakePendingChunks();
+  while (pending) {
+    TraceBufferChunk* chunk = pending->chunk;
+    for (size_t i = 0; i < chunk->size() && !write_failed_; ++i)
+      encoder_.AppendEvent(*chunk->GetEventAt(i), &output_);
+    if (output_.size() >= kWriteBufferSize)
+      WriteOutput();
+
+    PendingChunk* next = pending->next;
+    delete chunk;
+    delete pending;
+    pending = next;
+  }
+  WriteOutput();
+}
+
+void BinaryTraceStream::WriteOutput() {
+  if (!output_.empty() && !write_failed_) {
+    int size = static_cast<int>(output_.size());
+    if (file_.WriteAtCurrentPos(output_.data(), size) != size) {
+      LOG(ERROR) << "Failed to write the binary trace; dropping the rest.";
+      write_failed_ = true;
+    }
+  }
+  output_.clear();
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,193 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact binary trace format that TraceLog can stream to a file while
+// tracing, and the means to convert it to the JSON trace format.
+//
+// A binary trace starts with the magic bytes "CrBT" and a version byte,
+// followed by records. Each record is a type byte, the size of its payload as
+// a varint and the payload, so that readers can skip records they don't know.
+// Integers are LEB128 varints, and signed integers are zigzag encoded first.
+//
+//   kProcessRecord: process id (signed).
+//   kStringRecord:  string id, then the bytes of the string up to the end of
+//                   the payload. Ids are assigned in order, starting at 0.
+//   kEventRecord:   phase byte, flags byte, thread id (signed), timestamp
+//                   minus the timestamp of the previous event (signed), thread
+//                   timestamp (signed, 0 if none), category group, name,
+//                   duration and thread duration (both signed, COMPLETE events
+//                   only), id (only with TRACE_EVENT_FLAG_HAS_ID), the number
+//                   of arguments as a byte, and for each argument its name, its
+//                   TRACE_VALUE_TYPE_* byte and its value.
+//
+// Strings in events are either (id << 1), referring to a kStringRecord, or
+// (size << 1 | 1) followed by the bytes. Strings that the trace macros require
+// to outlive the trace, like category groups and names not copied with
+// TRACE_EVENT_FLAG_COPY, are written once as kStringRecords. Copied strings are
+// written inline. Argument values are a byte for booleans, varints for
+// integers and pointers, the 8 bytes of the IEEE 754 representation in little
+// endian order for doubles, and strings otherwise. Convertable arguments are
+// written as the string they append to the JSON format.
+
+#ifndef BASE_TRACE_EVENT_TRACE_EVENT_BINARY_H_
+#define BASE_TRACE_EVENT_TRACE_EVENT_BINARY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/containers/hash_tables.h"
+#include "base/files/file.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+
+class FilePath;
+
+namespace trace_event {
+
+class TraceBufferChunk;
+class TraceEvent;
+
+// Encodes trace events in the binary trace format.
+class BASE_EXPORT BinaryTraceEncoder {
+ public:
+  BinaryTraceEncoder();
+  ~BinaryTraceEncoder();
+
+  // Appends the magic bytes and the process record that start a binary trace.
+  void AppendHeader(int process_id, std::string* out);
+
+  // Appends |event| to |out|, preceded by records for the strings it is the
+  // first to use. A COMPLETE event that has not ended yet is written as a
+  // BEGIN event, because it can't be updated once it has been written.
+  void AppendEvent(const TraceEvent& event, std::string* out);
+
+ private:
+  void AppendString(const char* str, bool copied, std::string* out);
+
+  hash_map<const char*, uint32> string_ids_;
+  int64 last_timestamp_;
+  std::string payload_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceEncoder);
+};
+
+// Converts a binary trace to the JSON trace format, one buffer at a time.
+class BASE_EXPORT BinaryTraceDecoder {
+ public:
+  BinaryTraceDecoder();
+  ~BinaryTraceDecoder();
+
+  // Decodes the complete records at the start of |data| and appends the
+  // events in them to |json|, separated by commas like the fragments that
+  // TraceLog::Flush() hands out. Sets |*bytes_read| to the number of bytes
+  // decoded; an incomplete record at the end is left for the next call.
+  // Returns false if |data| isn't a valid continuation of a binary trace.
+  bool Decode(const StringPiece& data, size_t* bytes_read, std::string* json);
+
+ private:
+  bool DecodeRecord(unsigned char type,
+                    const StringPiece& payload,
+                    std::string* json);
+  bool DecodeEvent(const StringPiece& payload, std::string* json);
+
+  bool read_header_;
+  int process_id_;
+  int64 last_timestamp_;
+  std::vector<std::string> strings_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceDecoder);
+};
+
+// Converts the binary trace |binary_trace| to a JSON array of events, as
+// TraceResultBuffer would produce from a flush. Returns false if the trace is
+// not valid.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(const StringPiece& binary_trace,
+                                          std::string* json);
+
+// Like ConvertBinaryTraceToJSON(), but reads the trace from |binary_path| and
+// writes the JSON to |json_path| a piece at a time, so that traces too large
+// to hold in memory can be converted.
+BASE_EXPORT bool ConvertBinaryTraceFileToJSON(const FilePath& binary_path,
+                                              const FilePath& json_path);
+
+// Writes the events of the chunks handed to it to a file in the binary trace
+// format on a background thread. GetChunk() and ReturnChunk() may be called
+// from any thread and never take a lock, so that threads filling chunks don't
+// contend with each other or with the writer.
+class BASE_EXPORT BinaryTraceStream
+    : public RefCountedThreadSafe<BinaryTraceStream>,
+      public PlatformThread::Delegate {
+ public:
+  BinaryTraceStream(File file, int process_id);
+
+  // Starts the writer thread. Returns false if it could not be created.
+  bool Start();
+
+  // Returns a new chunk to add events to. |*index| is always 0, since
+  // returned chunks can't be looked up again.
+  scoped_ptr<TraceBufferChunk> GetChunk(size_t* index);
+
+  // Queues |chunk| for the writer thread. Chunks returned after Finish() are
+  // discarded.
+  void ReturnChunk(scoped_ptr<TraceBufferChunk> chunk);
+
+  // Writes out the chunks returned so far, closes the file and stops the
+  // writer thread.
+  void Finish();
+
+  // The number of events in the chunks returned so far.
+  size_t num_events() const;
+
+  // PlatformThread::Delegate implementation.
+  void ThreadMain() override;
+
+ private:
+  friend class RefCountedThreadSafe<BinaryTraceStream>;
+
+  // A returned chunk waiting for the writer thread.
+  struct PendingChunk {
+    TraceBufferChunk* chunk;
+    PendingChunk* next;
+  };
+
+  ~BinaryTraceStream() override;
+
+  // Takes all chunks returned so far, in the order they were returned.
+  PendingChunk* TakePendingChunks();
+  void WritePendingChunks();
+  void WriteOutput();
+
+  File file_;
+  const int process_id_;
+  PlatformThreadHandle thread_handle_;
+  bool thread_started_;
+  WaitableEvent finish_event_;
+
+  // The most recently returned PendingChunk. Returning a chunk pushes onto
+  // this list and the writer thread takes the whole list at once, so that
+  // neither side ever has to wait for the other.
+  subtle::AtomicWord /* PendingChunk* */ pending_chunks_;
+  subtle::Atomic32 next_chunk_seq_;
+  subtle::Atomic32 finished_;
+  subtle::AtomicWord num_events_;
+
+  // Only used on the writer thread.
+  BinaryTraceEncoder encoder_;
+  std::string output_;
+  bool write_failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceStream);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_EVENT_BINARY_H_
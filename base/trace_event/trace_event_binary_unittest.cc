@@ -0,0 +1,416 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_binary.h"
+
+#include <limits>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_impl.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+class ConvertableString : public ConvertableToTraceFormat {
+ public:
+  explicit ConvertableString(const std::string& json) : json_(json) {}
+
+  void AppendAsTraceFormat(std::string* out) const override { *out += json_; }
+
+ private:
+  ~ConvertableString() override {}
+
+  std::string json_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConvertableString);
+};
+
+class TraceEventBinaryTest : public testing::Test {
+ public:
+  void SetUp() override {
+    TraceLog::DeleteForTesting();
+    category_ = TraceLog::GetCategoryGroupEnabled("binary");
+  }
+
+  void TearDown() override {
+    TraceLog::DeleteForTesting();
+  }
+
+  // Encodes |events| and checks that converting them back gives the same JSON
+  // as TraceEvent::AppendAsJSON().
+  void ExpectSameJSON(const ScopedVector<TraceEvent>& events) {
+    BinaryTraceEncoder encoder;
+    std::string binary;
+    encoder.AppendHeader(TraceLog::GetInstance()->process_id(), &binary);
+    std::string expected_events;
+    for (size_t i = 0; i < events.size(); ++i) {
+      encoder.AppendEvent(*events[i], &binary);
+      if (i)
+        expected_events += ",\n";
+      events[i]->AppendAsJSON(&expected_events);
+    }
+
+    std::string json;
+    ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+    EXPECT_EQ("[" + expected_events + "]", json);
+  }
+
+  // Sends a trace to |path| while running |task| on a thread with a message
+  // loop, and returns the events in the trace converted to JSON.
+  scoped_ptr<ListValue> StreamTrace(const FilePath& path, const Closure& task) {
+    File file(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+    EXPECT_TRUE(file.IsValid());
+    TraceLog::GetInstance()->SetStreamingOutputFile(file.Pass());
+    TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
+                                        TraceLog::RECORDING_MODE,
+                                        TraceOptions());
+
+    Thread thread("StreamingThread");
+    thread.Start();
+    thread.message_loop()->PostTask(FROM_HERE, task);
+    thread.message_loop()->PostTask(
+        FROM_HERE,
+        Bind(&TraceEventBinaryTest::EndTraceAndFlush, Unretained(this)));
+    flush_complete_.Wait();
+    thread.Stop();
+
+    FilePath json_path = path.AddExtension(FILE_PATH_LITERAL("json"));
+    EXPECT_TRUE(ConvertBinaryTraceFileToJSON(path, json_path));
+    std::string json;
+    EXPECT_TRUE(ReadFileToString(json_path, &json));
+    scoped_ptr<Value> value(JSONReader::Read(json));
+    if (!value || !value->IsType(Value::TYPE_LIST))
+      return scoped_ptr<ListValue>();
+    return make_scoped_ptr(static_cast<ListValue*>(value.release()));
+  }
+
+ protected:
+  TraceEventBinaryTest() : category_(NULL), flush_complete_(false, false) {}
+
+  void EndTraceAndFlush() {
+    TraceLog::GetInstance()->SetDisabled();
+    TraceLog::GetInstance()->Flush(
+        Bind(&TraceEventBinaryTest::OnTraceDataCollected, Unretained(this)));
+  }
+
+  void OnTraceDataCollected(const scoped_refptr<RefCountedString>& events_str,
+                            bool has_more_events) {
+    // Streamed events only end up in the file.
+    EXPECT_TRUE(events_str->data().empty());
+    if (!has_more_events)
+      flush_complete_.Signal();
+  }
+
+  const unsigned char* category_;
+
+ private:
+  ShadowingAtExitManager at_exit_manager_;
+  WaitableEvent flush_complete_;
+};
+
+TraceEvent* NewEvent(char phase,
+                     const unsigned char* category,
+                     const char* name,
+                     int num_args,
+                     const char** arg_names,
+                     const unsigned char* arg_types,
+                     const unsigned long long* arg_values,
+                     unsigned char flags) {
+  TraceEvent* event = new TraceEvent;
+  event->Initialize(7, TimeTicks::FromInternalValue(123456789),
+                    TimeTicks::FromInternalValue(5000), phase, category, name,
+                    0x1234, num_args, arg_names, arg_types, arg_values, NULL,
+                    flags);
+  return event;
+}
+
+TEST_F(TraceEventBinaryTest, MatchesJSONFormat) {
+  ScopedVector<TraceEvent> events;
+  events.push_back(NewEvent(TRACE_EVENT_PHASE_BEGIN, category_, "no_args", 0,
+                            NULL, NULL, NULL, TRACE_EVENT_FLAG_NONE));
+
+  const char* arg_names[] = { "a", "b" };
+  unsigned char arg_types[2];
+  unsigned long long arg_values[2];
+  trace_event_internal::SetTraceValue(true, &arg_types[0], &arg_values[0]);
+  trace_event_internal::SetTraceValue(-42, &arg_types[1], &arg_values[1]);
+  events.push_back(NewEvent(TRACE_EVENT_PHASE_INSTANT, category_, "bool_int", 2,
+                            arg_names, arg_types, arg_values,
+                            TRACE_EVENT_SCOPE_PROCESS));
+
+  trace_event_internal::SetTraceValue(1.5, &arg_types[0], &arg_values[0]);
+  trace_event_internal::SetTraceValue(1ull << 63, &arg_types[1],
+                                      &arg_values[1]);
+  events.push_back(NewEvent(TRACE_EVENT_PHASE_ASYNC_BEGIN, category_,
+                            "double_uint", 2, arg_names, arg_types, arg_values,
+                            TRACE_EVENT_FLAG_HAS_ID));
+
+  trace_event_internal::SetTraceValue(static_cast<void*>(&events), &arg_types[0],
+                                      &arg_values[0]);
+  trace_event_internal::SetTraceValue("static \"string\"", &arg_types[1],
+                                      &arg_values[1]);
+  events.push_back(NewEvent(TRACE_EVENT_PHASE_END, category_,
+                            "pointer_string", 2, arg_names, arg_types,
+                            arg_values, TRACE_EVENT_FLAG_NONE));
+
+  // Copied names and values are written inline.
+  std::string name = "copied";
+  std::string arg_name = "copied_arg";
+  std::string arg_value = "copied value";
+  const char* copied_arg_names[] = { arg_name.c_str() };
+  trace_event_internal::SetTraceValue(arg_value, &arg_types[0],
+                                      &arg_values[0]);
+  events.push_back(NewEvent(TRACE_EVENT_PHASE_INSTANT, category_,
+                            name.c_str(), 1, copied_arg_names, arg_types,
+                            arg_values, TRACE_EVENT_FLAG_COPY));
+  name = "changed";
+  arg_name = "changed_arg";
+  arg_value = "changed value";
+
+  TraceEvent* complete = NewEvent(TRACE_EVENT_PHASE_COMPLETE, category_,
+                                  "complete", 0, NULL, NULL, NULL,
+                                  TRACE_EVENT_FLAG_NONE);
+  complete->UpdateDuration(TimeTicks::FromInternalValue(123460000),
+                           TimeTicks::FromInternalValue(6000));
+  events.push_back(complete);
+
+  scoped_refptr<ConvertableToTraceFormat> convertable =
+      new ConvertableString("{\"nested\":[1,2]}");
+  const char* convertable_name = "data";
+  unsigned char convertable_type = TRACE_VALUE_TYPE_CONVERTABLE;
+  TraceEvent* with_convertable = new TraceEvent;
+  with_convertable->Initialize(
+      8, TimeTicks::FromInternalValue(100), TimeTicks(),
+      TRACE_EVENT_PHASE_INSTANT, category_, "convertable", 0, 1,
+      &convertable_name, &convertable_type, NULL, &convertable,
+      TRACE_EVENT_FLAG_NONE);
+  events.push_back(with_convertable);
+
+  ExpectSameJSON(events);
+}
+
+TEST_F(TraceEventBinaryTest, UnfinishedCompleteEventIsBegin) {
+  scoped_ptr<TraceEvent> event(NewEvent(TRACE_EVENT_PHASE_COMPLETE, category_,
+                                        "unfinished", 0, NULL, NULL, NULL,
+                                        TRACE_EVENT_FLAG_NONE));
+  BinaryTraceEncoder encoder;
+  std::string binary;
+  encoder.AppendHeader(1, &binary);
+  encoder.AppendEvent(*event, &binary);
+
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  scoped_ptr<Value> value(JSONReader::Read(json));
+  ListValue* list;
+  ASSERT_TRUE(value && value->GetAsList(&list));
+  DictionaryValue* dict;
+  ASSERT_TRUE(list->GetDictionary(0, &dict));
+  std::string phase;
+  EXPECT_TRUE(dict->GetString("ph", &phase));
+  EXPECT_EQ("B", phase);
+  EXPECT_FALSE(dict->HasKey("dur"));
+}
+
+TEST_F(TraceEventBinaryTest, DecodeInPieces) {
+  BinaryTraceEncoder encoder;
+  std::string binary;
+  encoder.AppendHeader(1, &binary);
+  ScopedVector<TraceEvent> events;
+  for (int i = 0; i < 10; ++i) {
+    events.push_back(NewEvent(TRACE_EVENT_PHASE_INSTANT, category_,
+                              i % 2 ? "odd" : "even", 0, NULL, NULL, NULL,
+                              TRACE_EVENT_SCOPE_THREAD));
+    encoder.AppendEvent(*events.back(), &binary);
+  }
+
+  std::string expected;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &expected));
+
+  // Feed the decoder a byte at a time, as a reader of a growing file would.
+  BinaryTraceDecoder decoder;
+  std::string pending;
+  std::string json = "[";
+  for (size_t i = 0; i < binary.size(); ++i) {
+    pending.push_back(binary[i]);
+    std::string events_json;
+    size_t bytes_read;
+    ASSERT_TRUE(decoder.Decode(pending, &bytes_read, &events_json));
+    pending.erase(0, bytes_read);
+    if (!events_json.empty()) {
+      if (json.size() > 1)
+        json += ",\n";
+      json += events_json;
+    }
+  }
+  json += "]";
+  EXPECT_TRUE(pending.empty());
+  EXPECT_EQ(expected, json);
+}
+
+TEST_F(TraceEventBinaryTest, RejectsInvalidTraces) {
+  BinaryTraceEncoder encoder;
+  std::string binary;
+  encoder.AppendHeader(1, &binary);
+  scoped_ptr<TraceEvent> event(NewEvent(TRACE_EVENT_PHASE_BEGIN, category_,
+                                        "event", 0, NULL, NULL, NULL,
+                                        TRACE_EVENT_FLAG_NONE));
+  encoder.AppendEvent(*event, &binary);
+
+  std::string json;
+  EXPECT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(binary.substr(0, binary.size() - 1),
+                                        &json));
+  EXPECT_FALSE(ConvertBinaryTraceToJSON("{\"traceEvents\":[]}", &json));
+
+  // Unknown records are skipped.
+  std::string with_unknown_record = binary;
+  with_unknown_record.append("\x7f\x03xyz", 5);
+  std::string expected;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &expected));
+  EXPECT_TRUE(ConvertBinaryTraceToJSON(with_unknown_record, &json));
+  EXPECT_EQ(expected, json);
+}
+
+void TraceManyEvents(int num_events) {
+  TRACE_EVENT0("binary", "outer");
+  for (int i = 0; i < num_events; ++i)
+    TRACE_EVENT_INSTANT1("binary", "inner", TRACE_EVENT_SCOPE_THREAD, "i", i);
+}
+
+TEST_F(TraceEventBinaryTest, StreamToFile) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  // Enough events to fill many chunks.
+  const int kNumEvents = 1000;
+  scoped_ptr<ListValue> events =
+      StreamTrace(temp_dir.path().AppendASCII("trace"),
+                  Bind(&TraceManyEvents, kNumEvents));
+  ASSERT_TRUE(events);
+
+  int num_inner = 0;
+  int next_i = 0;
+  bool outer_began = false;
+  bool outer_ended = false;
+  bool thread_named = false;
+  for (size_t i = 0; i < events->GetSize(); ++i) {
+    DictionaryValue* event;
+    ASSERT_TRUE(events->GetDictionary(i, &event));
+    std::string name;
+    std::string phase;
+    ASSERT_TRUE(event->GetString("name", &name));
+    ASSERT_TRUE(event->GetString("ph", &phase));
+    if (name == "inner") {
+      int value;
+      EXPECT_TRUE(event->GetInteger("args.i", &value));
+      EXPECT_EQ(next_i++, value);
+      ++num_inner;
+    } else if (name == "outer") {
+      // "outer" was streamed before it ended, so it can't be a COMPLETE event.
+      if (phase == "B")
+        outer_began = true;
+      else if (phase == "E")
+        outer_ended = true;
+    } else if (name == "thread_name") {
+      std::string thread_name;
+      if (event->GetString("args.name", &thread_name) &&
+          thread_name == "StreamingThread") {
+        thread_named = true;
+      }
+    }
+  }
+  EXPECT_EQ(kNumEvents, num_inner);
+  EXPECT_TRUE(outer_began);
+  EXPECT_TRUE(outer_ended);
+  EXPECT_TRUE(thread_named);
+}
+
+TEST_F(TraceEventBinaryTest, StreamingOnlyAffectsNextTrace) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  scoped_ptr<ListValue> events = StreamTrace(
+      temp_dir.path().AppendASCII("trace"), Bind(&TraceManyEvents, 10));
+  ASSERT_TRUE(events);
+
+  // The trace after the streamed one is kept in memory again.
+  TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
+                                      TraceLog::RECORDING_MODE,
+                                      TraceOptions());
+  TRACE_EVENT_INSTANT0("binary", "in_memory", TRACE_EVENT_SCOPE_THREAD);
+  TraceLog::GetInstance()->SetDisabled();
+  EXPECT_GT(TraceLog::GetInstance()->GetStatus().event_count, 0u);
+  EXPECT_LT(TraceLog::GetInstance()->GetStatus().event_capacity,
+            std::numeric_limits<size_t>::max());
+}
+
+TEST_F(TraceEventBinaryTest, RingBufferTraceIsNotStreamed) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("trace");
+  File file(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+  TraceLog::GetInstance()->SetStreamingOutputFile(file.Pass());
+  TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
+                                      TraceLog::RECORDING_MODE,
+                                      TraceOptions(RECORD_CONTINUOUSLY));
+  TRACE_EVENT_INSTANT0("binary", "in_memory", TRACE_EVENT_SCOPE_THREAD);
+  TraceLog::GetInstance()->SetDisabled();
+  EXPECT_GT(TraceLog::GetInstance()->GetStatus().event_count, 0u);
+  EXPECT_LT(TraceLog::GetInstance()->GetStatus().event_capacity,
+            std::numeric_limits<size_t>::max());
+
+  int64 file_size;
+  ASSERT_TRUE(GetFileSize(path, &file_size));
+  EXPECT_EQ(0, file_size);
+}
+
+void ExpectNoEvents(bool* called,
+                    const scoped_refptr<RefCountedString>& events_str,
+                    bool has_more_events) {
+  EXPECT_TRUE(events_str->data().empty());
+  EXPECT_FALSE(has_more_events);
+  *called = true;
+}
+
+TEST_F(TraceEventBinaryTest, FlushButLeaveBufferIntactWhileStreaming) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("trace");
+  File file(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+  TraceLog::GetInstance()->SetStreamingOutputFile(file.Pass());
+  TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
+                                      TraceLog::RECORDING_MODE,
+                                      TraceOptions());
+  TRACE_EVENT_INSTANT0("binary", "before", TRACE_EVENT_SCOPE_THREAD);
+
+  // The events are in the file, so there is nothing to hand to the callback,
+  // and the trace keeps streaming afterwards.
+  bool called = false;
+  TraceLog::GetInstance()->FlushButLeaveBufferIntact(
+      Bind(&ExpectNoEvents, &called));
+  EXPECT_TRUE(called);
+  TRACE_EVENT_INSTANT0("binary", "after", TRACE_EVENT_SCOPE_THREAD);
+  TraceLog::GetInstance()->SetDisabled();
+  EXPECT_EQ(std::numeric_limits<size_t>::max(),
+            TraceLog::GetInstance()->GetStatus().event_capacity);
+}
+
+}  // namespace
+
+}  // namespace trace_event
+}  // namespace base
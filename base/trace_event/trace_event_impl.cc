@@ -5,6 +5,7 @@
 #include "base/trace_event/trace_event_impl.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "base/base_switches.h"
 #include "base/bind.h"
@@ -33,6 +34,7 @@
 #include "base/threading/worker_pool.h"
 #include "base/time/time.h"
 #include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_binary.h"
 #include "base/trace_event/trace_event_synthetic_delay.h"
 
 #if defined(OS_WIN)
@@ -368,6 +370,55 @@ class TraceBufferVector : public TraceBuffer {
   DISALLOW_COPY_AND_ASSIGN(TraceBufferVector);
 };
 
+// Hands every chunk to a BinaryTraceStream instead of keeping it. Threads with
+// a ThreadLocalEventBuffer use the stream directly, so only the thread shared
+// chunk goes through this buffer.
+class TraceBufferStreaming : public TraceBuffer {
+ public:
+  explicit TraceBufferStreaming(const scoped_refptr<BinaryTraceStream>& stream)
+      : stream_(stream) {}
+
+  ~TraceBufferStreaming() override { stream_->Finish(); }
+
+  scoped_ptr<TraceBufferChunk> GetChunk(size_t* index) override {
+    return stream_->GetChunk(index);
+  }
+
+  void ReturnChunk(size_t index, scoped_ptr<TraceBufferChunk> chunk) override {
+    stream_->ReturnChunk(chunk.Pass());
+  }
+
+  bool IsFull() const override { return false; }
+  size_t Size() const override { return stream_->num_events(); }
+  size_t Capacity() const override {
+    return std::numeric_limits<size_t>::max();
+  }
+
+  // Events can't be updated once they have been streamed.
+  TraceEvent* GetEventByHandle(TraceEventHandle handle) override {
+    return NULL;
+  }
+
+  // All events are in the file, so there is nothing to iterate over. This
+  // finishes the file first, so that it is complete by the time the flush
+  // callback runs.
+  const TraceBufferChunk* NextChunk() override {
+    stream_->Finish();
+    return NULL;
+  }
+
+  // Nothing is kept in memory, so the clone has no chunks. Unlike NextChunk()
+  // this leaves the stream open.
+  scoped_ptr<TraceBuffer> CloneForIteration() const override {
+    return scoped_ptr<TraceBuffer>(new TraceBufferVector(0));
+  }
+
+ private:
+  scoped_refptr<BinaryTraceStream> stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBufferStreaming);
+};
+
 template <typename T>
 void InitializeMetadataEvent(TraceEvent* trace_event,
                              int thread_id,
@@ -1068,6 +1119,11 @@ class TraceLog::ThreadLocalEventBuffer
   // Since TraceLog is a leaky singleton, trace_log_ will always be valid
   // as long as the thread exists.
   TraceLog* trace_log_;
+  // Set if the trace buffer streams to a file. Chunks are then exchanged with
+  // the stream directly instead of under |trace_log_->lock_|. Holding a
+  // reference keeps the stream alive for chunks handed over after the buffer
+  // has been flushed; the stream drops those.
+  scoped_refptr<BinaryTraceStream> binary_trace_stream_;
   scoped_ptr<TraceBufferChunk> chunk_;
   size_t chunk_index_;
   int event_count_;
@@ -1089,6 +1145,7 @@ TraceLog::ThreadLocalEventBuffer::ThreadLocalEventBuffer(TraceLog* trace_log)
 
   AutoLock lock(trace_log->lock_);
   trace_log->thread_message_loops_.insert(message_loop);
+  binary_trace_stream_ = trace_log->binary_trace_stream_;
 }
 
 TraceLog::ThreadLocalEventBuffer::~ThreadLocalEventBuffer() {
@@ -1119,14 +1176,22 @@ TraceEvent* TraceLog::ThreadLocalEventBuffer::AddTraceEvent(
   CheckThisIsCurrentBuffer();
 
   if (chunk_ && chunk_->IsFull()) {
-    AutoLock lock(trace_log_->lock_);
-    FlushWhileLocked();
-    chunk_.reset();
+    if (binary_trace_stream_.get()) {
+      binary_trace_stream_->ReturnChunk(chunk_.Pass());
+    } else {
+      AutoLock lock(trace_log_->lock_);
+      FlushWhileLocked();
+      chunk_.reset();
+    }
   }
   if (!chunk_) {
-    AutoLock lock(trace_log_->lock_);
-    chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
-    trace_log_->CheckIfBufferIsFullWhileLocked();
+    if (binary_trace_stream_.get()) {
+      chunk_ = binary_trace_stream_->GetChunk(&chunk_index_);
+    } else {
+      AutoLock lock(trace_log_->lock_);
+      chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
+      trace_log_->CheckIfBufferIsFullWhileLocked();
+    }
   }
   if (!chunk_)
     return NULL;
@@ -1175,7 +1240,9 @@ void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
     return;
 
   trace_log_->lock_.AssertAcquired();
-  if (trace_log_->CheckGeneration(generation_)) {
+  if (binary_trace_stream_.get()) {
+    binary_trace_stream_->ReturnChunk(chunk_.Pass());
+  } else if (trace_log_->CheckGeneration(generation_)) {
     // Return the chunk to the buffer only if the generation matches.
     trace_log_->logged_events_->ReturnChunk(chunk_index_, chunk_.Pass());
   }
@@ -1430,7 +1497,7 @@ void TraceLog::SetEnabled(const CategoryFilter& category_filter,
 
     mode_ = mode;
 
-    if (new_options != old_options) {
+    if (new_options != old_options || streaming_output_file_.IsValid()) {
       subtle::NoBarrier_Store(&trace_options_, new_options);
       UseNextTraceBuffer();
     }
@@ -1604,8 +1671,34 @@ bool TraceLog::BufferIsFull() const {
   return logged_events_->IsFull();
 }
 
+void TraceLog::SetStreamingOutputFile(File file) {
+  AutoLock lock(lock_);
+  DCHECK(!IsEnabled());
+  streaming_output_file_ = file.Pass();
+}
+
 TraceBuffer* TraceLog::CreateTraceBuffer() {
+  binary_trace_stream_ = NULL;
   InternalTraceOptions options = trace_options();
+  if (streaming_output_file_.IsValid() &&
+      ((options & (kInternalRecordContinuously | kInternalEchoToConsole)) ||
+       ((options & kInternalEnableSampling) && mode_ == MONITORING_MODE))) {
+    // These options keep the latest events in a ring buffer, which a stream
+    // can't do.
+    LOG(ERROR) << "Can't stream a trace that uses a ring buffer; keeping it "
+                  "in memory.";
+    streaming_output_file_.Close();
+  }
+  if (streaming_output_file_.IsValid()) {
+    scoped_refptr<BinaryTraceStream> stream(
+        new BinaryTraceStream(streaming_output_file_.Pass(), process_id_));
+    if (stream->Start()) {
+      binary_trace_stream_ = stream;
+      return new TraceBufferStreaming(stream);
+    }
+    LOG(ERROR) << "Failed to start streaming the trace; keeping it in memory.";
+  }
+
   if (options & kInternalRecordContinuously)
     return new TraceBufferRingBuffer(kTraceEventRingBufferChunks);
   else if ((options & kInternalEnableSampling) && mode_ == MONITORING_MODE)
@@ -2149,6 +2242,21 @@ void TraceLog::UpdateTraceEventDuration(
 #if defined(OS_ANDROID)
       trace_event->SendToATrace();
 #endif
+    } else if (handle.chunk_seq) {
+      lock.EnsureAcquired();
+      if (binary_trace_stream_.get()) {
+        // The event was streamed before it ended, which wrote it as a BEGIN
+        // event. End it with an END event.
+        TraceEvent* end_event =
+            AddEventToThreadSharedChunkWhileLocked(NULL, false);
+        if (end_event) {
+          end_event->Initialize(
+              static_cast<int>(PlatformThread::CurrentId()), now, thread_now,
+              TRACE_EVENT_PHASE_END, category_group_enabled, name,
+              trace_event_internal::kNoEventId, 0, NULL, NULL, NULL, NULL,
+              TRACE_EVENT_FLAG_COPY);
+        }
+      }
     }
 
     if (trace_options() & kInternalEchoToConsole) {
@@ -14,6 +14,7 @@
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/containers/hash_tables.h"
+#include "base/files/file.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_vector.h"
@@ -51,6 +52,8 @@ class MessageLoop;
 
 namespace trace_event {
 
+class BinaryTraceStream;
+
 // For any argument of type TRACE_VALUE_TYPE_CONVERTABLE the provided
 // class must implement this interface.
 class BASE_EXPORT ConvertableToTraceFormat
@@ -137,6 +140,14 @@ class BASE_EXPORT TraceEvent {
   unsigned long long id() const { return id_; }
   unsigned char flags() const { return flags_; }
 
+  // The arguments end at the first NULL name.
+  const char* arg_name(int index) const { return arg_names_[index]; }
+  unsigned char arg_type(int index) const { return arg_types_[index]; }
+  TraceValue arg_value(int index) const { return arg_values_[index]; }
+  ConvertableToTraceFormat* convertable_value(int index) const {
+    return convertable_values_[index].get();
+  }
+
   // Exposed for unittesting:
 
   const base::RefCountedString* parameter_copy_storage() const {
@@ -545,6 +556,17 @@ class BASE_EXPORT TraceLog {
   void Flush(const OutputCallback& cb, bool use_worker_thread = false);
   void FlushButLeaveBufferIntact(const OutputCallback& flush_output_callback);
 
+  // Streams the next trace to |file| in the binary format described in
+  // trace_event_binary.h instead of collecting it in the trace buffer, so the
+  // length of the trace is not limited by memory. Threads hand their full
+  // chunks to a background writer thread without taking |lock_|. Must be
+  // called while tracing is disabled and takes effect at the next SetEnabled().
+  // The next Flush() finishes the file and hands no events to its callback.
+  // Traces that keep their events in a ring buffer, such as those recording
+  // continuously, are not streamed and |file| is closed.
+  // ConvertBinaryTraceFileToJSON() converts the file to JSON.
+  void SetStreamingOutputFile(File file);
+
   // Called by TRACE_EVENT* macros, don't call this directly.
   // The name parameter is a category group for example:
   // TRACE_EVENT0("renderer,webkit", "WebViewImpl::HandleInputEvent")
@@ -693,6 +715,8 @@ class BASE_EXPORT TraceLog {
   }
 
   TraceBuffer* trace_buffer() const { return logged_events_.get(); }
+  // Creates a buffer that streams to |streaming_output_file_| if it is set,
+  // and one of the in-memory buffers otherwise.
   TraceBuffer* CreateTraceBuffer();
   TraceBuffer* CreateTraceBufferVectorOfSize(size_t max_chunks);
 
@@ -751,6 +775,10 @@ class BASE_EXPORT TraceLog {
   Mode mode_;
   int num_traces_recorded_;
   scoped_ptr<TraceBuffer> logged_events_;
+  // The file that the next trace buffer streams to.
+  File streaming_output_file_;
+  // Set while |logged_events_| streams to a file.
+  scoped_refptr<BinaryTraceStream> binary_trace_stream_;
   subtle::AtomicWord /* EventCallback */ event_callback_;
   bool dispatching_to_observer_list_;
   std::vector<EnabledStateObserver*> enabled_state_observer_list_;
@@ -20,6 +20,37 @@ namespace base {
 
 namespace {
 
+bool EntryKeyLess(const DictionaryValue::Entry& entry,
+                  const std::string& key) {
+  return entry.first < key;
+}
+
+bool EntryLess(const DictionaryValue::Entry& a,
+               const DictionaryValue::Entry& b) {
+  return a.first < b.first;
+}
+
+// Merges the entries before and after |middle|, which are each sorted by key,
+// and keeps only the last of the entries with the same key, deleting the
+// values of the others. The merge is stable, so the entries that are kept are
+// those after |middle|, and the later ones there.
+void MergeEntries(DictionaryValue::EntryVector* entries, size_t middle) {
+  std::inplace_merge(entries->begin(), entries->begin() + middle,
+                     entries->end(), &EntryLess);
+  size_t kept = 0;
+  for (size_t i = 0; i < entries->size(); ++i) {
+    if (i + 1 < entries->size() &&
+        (*entries)[i].first == (*entries)[i + 1].first) {
+      delete (*entries)[i].second;
+      continue;
+    }
+    if (kept != i)
+      (*entries)[kept].swap((*entries)[i]);
+    ++kept;
+  }
+  entries->resize(kept);
+}
+
 // Make a deep copy of |node|, but don't include empty lists or dictionaries
 // in the copy. It's possible for this function to return NULL and it
 // expects |node| to always be non-NULL.
@@ -366,13 +397,15 @@ bool DictionaryValue::GetAsDictionary(const DictionaryValue** out_value) const {
 
 bool DictionaryValue::HasKey(const std::string& key) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator current_entry = dictionary_.find(key);
-  DCHECK((current_entry == dictionary_.end()) || current_entry->second);
-  return current_entry != dictionary_.end();
+  EntryVector::const_iterator current_entry = LowerBound(key);
+  if (current_entry == dictionary_.end() || current_entry->first != key)
+    return false;
+  DCHECK(current_entry->second);
+  return true;
 }
 
 void DictionaryValue::Clear() {
-  ValueMap::iterator dict_iterator = dictionary_.begin();
+  EntryVector::iterator dict_iterator = dictionary_.begin();
   while (dict_iterator != dictionary_.end()) {
     delete dict_iterator->second;
     ++dict_iterator;
@@ -434,15 +467,23 @@ void DictionaryValue::SetString(const std::string& path,
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
                                               scoped_ptr<Value> in_value) {
   Value* bare_ptr = in_value.release();
-  // If there's an existing value here, we need to delete it, because
-  // we own all our children.
-  std::pair<ValueMap::iterator, bool> ins_res =
-      dictionary_.insert(std::make_pair(key, bare_ptr));
-  if (!ins_res.second) {
-    DCHECK_NE(ins_res.first->second, bare_ptr);  // This would be bogus
-    delete ins_res.first->second;
-    ins_res.first->second = bare_ptr;
+  // Keys often arrive in order (e.g. when reading serialized data back), in
+  // which case the new entry simply goes at the end.
+  if (dictionary_.empty() || dictionary_.back().first < key) {
+    dictionary_.push_back(std::make_pair(key, bare_ptr));
+    return;
+  }
+
+  EntryVector::iterator entry = LowerBound(key);
+  if (entry != dictionary_.end() && entry->first == key) {
+    // If there's an existing value here, we need to delete it, because
+    // we own all our children.
+    DCHECK_NE(entry->second, bare_ptr);  // This would be bogus
+    delete entry->second;
+    entry->second = bare_ptr;
+    return;
   }
+  dictionary_.insert(entry, std::make_pair(key, bare_ptr));
 }
 
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
@@ -450,6 +491,19 @@ void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
   SetWithoutPathExpansion(key, make_scoped_ptr(in_value));
 }
 
+void DictionaryValue::SetEntriesWithoutPathExpansion(EntryVector* entries) {
+  std::stable_sort(entries->begin(), entries->end(), &EntryLess);
+  const size_t old_size = dictionary_.size();
+  dictionary_.reserve(old_size + entries->size());
+  for (EntryVector::iterator it = entries->begin(); it != entries->end();
+       ++it) {
+    dictionary_.push_back(Entry(std::string(), it->second));
+    dictionary_.back().first.swap(it->first);
+  }
+  entries->clear();
+  MergeEntries(&dictionary_, old_size);
+}
+
 void DictionaryValue::SetBooleanWithoutPathExpansion(
     const std::string& path, bool in_value) {
   SetWithoutPathExpansion(path, new FundamentalValue(in_value));
@@ -623,8 +677,8 @@ bool DictionaryValue::GetList(const std::string& path, ListValue** out_value) {
 bool DictionaryValue::GetWithoutPathExpansion(const std::string& key,
                                               const Value** out_value) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator entry_iterator = dictionary_.find(key);
-  if (entry_iterator == dictionary_.end())
+  EntryVector::const_iterator entry_iterator = LowerBound(key);
+  if (entry_iterator == dictionary_.end() || entry_iterator->first != key)
     return false;
 
   const Value* entry = entry_iterator->second;
@@ -752,8 +806,8 @@ bool DictionaryValue::Remove(const std::string& path,
 bool DictionaryValue::RemoveWithoutPathExpansion(const std::string& key,
                                                  scoped_ptr<Value>* out_value) {
   DCHECK(IsStringUTF8(key));
-  ValueMap::iterator entry_iterator = dictionary_.find(key);
-  if (entry_iterator == dictionary_.end())
+  EntryVector::iterator entry_iterator = LowerBound(key);
+  if (entry_iterator == dictionary_.end() || entry_iterator->first != key)
     return false;
 
   Value* entry = entry_iterator->second;
@@ -813,17 +867,19 @@ void DictionaryValue::Swap(DictionaryValue* other) {
 
 DictionaryValue::Iterator::Iterator(const DictionaryValue& target)
     : target_(target),
-      it_(target.dictionary_.begin()) {}
+      index_(0) {}
 
 DictionaryValue::Iterator::~Iterator() {}
 
 DictionaryValue* DictionaryValue::DeepCopy() const {
   DictionaryValue* result = new DictionaryValue;
 
-  for (ValueMap::const_iterator current_entry(dictionary_.begin());
+  // The entries are already sorted, so they can be copied over as they are.
+  result->dictionary_.reserve(dictionary_.size());
+  for (EntryVector::const_iterator current_entry(dictionary_.begin());
        current_entry != dictionary_.end(); ++current_entry) {
-    result->SetWithoutPathExpansion(current_entry->first,
-                                    current_entry->second->DeepCopy());
+    result->dictionary_.push_back(std::make_pair(
+        current_entry->first, current_entry->second->DeepCopy()));
   }
 
   return result;
@@ -851,6 +907,18 @@ bool DictionaryValue::Equals(const Value* other) const {
   return true;
 }
 
+DictionaryValue::EntryVector::iterator DictionaryValue::LowerBound(
+    const std::string& key) {
+  return std::lower_bound(dictionary_.begin(), dictionary_.end(), key,
+                          &EntryKeyLess);
+}
+
+DictionaryValue::EntryVector::const_iterator DictionaryValue::LowerBound(
+    const std::string& key) const {
+  return std::lower_bound(dictionary_.begin(), dictionary_.end(), key,
+                          &EntryKeyLess);
+}
+
 ///////////////////// ListValue ////////////////////
 
 ListValue::ListValue() : Value(TYPE_LIST) {
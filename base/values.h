@@ -206,6 +206,10 @@ class BASE_EXPORT BinaryValue: public Value {
 // are |std::string|s and should be UTF-8 encoded.
 class BASE_EXPORT DictionaryValue : public Value {
  public:
+  // A key and the value at it, as passed to SetEntriesWithoutPathExpansion().
+  typedef std::pair<std::string, Value*> Entry;
+  typedef std::vector<Entry> EntryVector;
+
   DictionaryValue();
   ~DictionaryValue() override;
 
@@ -251,6 +255,12 @@ class BASE_EXPORT DictionaryValue : public Value {
   // Deprecated version of the above. TODO(estade): remove.
   void SetWithoutPathExpansion(const std::string& key, Value* in_value);
 
+  // Does what calling SetWithoutPathExpansion() on each of |entries| in turn
+  // would, taking ownership of their values, and clears |entries|. The keys
+  // are sorted once rather than inserted one at a time, so this is the way to
+  // build a large dictionary whose keys don't arrive in order.
+  void SetEntriesWithoutPathExpansion(EntryVector* entries);
+
   // Convenience forms of SetWithoutPathExpansion().
   void SetBooleanWithoutPathExpansion(const std::string& path, bool in_value);
   void SetIntegerWithoutPathExpansion(const std::string& path, int in_value);
@@ -355,15 +365,15 @@ class BASE_EXPORT DictionaryValue : public Value {
     explicit Iterator(const DictionaryValue& target);
     ~Iterator();
 
-    bool IsAtEnd() const { return it_ == target_.dictionary_.end(); }
-    void Advance() { ++it_; }
+    bool IsAtEnd() const { return index_ == target_.dictionary_.size(); }
+    void Advance() { ++index_; }
 
-    const std::string& key() const { return it_->first; }
-    const Value& value() const { return *it_->second; }
+    const std::string& key() const { return target_.dictionary_[index_].first; }
+    const Value& value() const { return *target_.dictionary_[index_].second; }
 
    private:
     const DictionaryValue& target_;
-    ValueMap::const_iterator it_;
+    size_t index_;
   };
 
   // Overridden from Value:
@@ -371,7 +381,16 @@ class BASE_EXPORT DictionaryValue : public Value {
   bool Equals(const Value* other) const override;
 
  private:
-  ValueMap dictionary_;
+  // The children are kept in a vector sorted by key rather than in a ValueMap:
+  // a dictionary then needs a single allocation for all of its entries instead
+  // of a tree node per key, and lookups binary search contiguous memory. Keys
+  // short enough for std::string's inline buffer need no allocation at all.
+
+  // Returns the first entry whose key is not less than |key|.
+  EntryVector::iterator LowerBound(const std::string& key);
+  EntryVector::const_iterator LowerBound(const std::string& key) const;
+
+  EntryVector dictionary_;
 
   DISALLOW_COPY_AND_ASSIGN(DictionaryValue);
 };
@@ -0,0 +1,175 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <malloc.h>
+#endif
+
+namespace base {
+
+namespace {
+
+const int kNumTrees = 20;
+const int kNumLookups = 1000000;
+
+// Returns the number of bytes currently handed out by the allocator, or -1 if
+// that can't be determined on this platform.
+int64 GetAllocatedBytes() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  return static_cast<int64>(static_cast<unsigned>(mallinfo().uordblks));
+#else
+  return -1;
+#endif
+}
+
+// Builds a preferences-style document: |num_entries| dictionaries keyed by a
+// mix of short and URL-like keys, each holding a handful of small values.
+std::string BuildCorpus(int num_entries) {
+  std::string json = "{";
+  for (int i = 0; i < num_entries; ++i) {
+    if (i)
+      json += ",";
+    StringAppendF(&json,
+        "\"%s%d\": {\"id\": %d, \"enabled\": %s, \"ratio\": %d.5, "
+        "\"name\": \"entry %d\", \"last_modified\": \"13071234567%06d\", "
+        "\"setting\": {\"value\": %d, \"source\": \"user\"}, "
+        "\"tags\": [\"a\", \"b\", %d]}",
+        i % 2 ? "https://www.example.com:443/path/" : "k", i, i,
+        i % 3 ? "true" : "false", i, i, i, i % 4, i);
+  }
+  json += "}";
+  return json;
+}
+
+class ValuesPerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    corpus_ = BuildCorpus(1000);
+  }
+
+  scoped_ptr<DictionaryValue> ParseCorpus() {
+    Value* value = JSONReader::Read(corpus_);
+    if (!value || !value->IsType(Value::TYPE_DICTIONARY)) {
+      delete value;
+      return scoped_ptr<DictionaryValue>();
+    }
+    return make_scoped_ptr(static_cast<DictionaryValue*>(value));
+  }
+
+ protected:
+  std::string corpus_;
+};
+
+TEST_F(ValuesPerfTest, MemoryPerTree) {
+  // Parse once up front so that one-time allocations made by the reader do
+  // not count towards the first tree.
+  ASSERT_TRUE(ParseCorpus());
+
+  ScopedVector<DictionaryValue> trees;
+  int64 before = GetAllocatedBytes();
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumTrees; ++i) {
+    trees.push_back(ParseCorpus().release());
+    ASSERT_TRUE(trees.back());
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  int64 after = GetAllocatedBytes();
+
+  perf_test::PrintResult("values", "", "build_tree",
+                         elapsed.InMillisecondsF() / kNumTrees, "ms", true);
+  if (before >= 0) {
+    perf_test::PrintResult("values", "", "memory_per_tree",
+                           static_cast<size_t>((after - before) / kNumTrees),
+                           "bytes", true);
+  }
+
+  start = TimeTicks::Now();
+  trees.clear();
+  perf_test::PrintResult(
+      "values", "", "destroy_tree",
+      (TimeTicks::Now() - start).InMillisecondsF() / kNumTrees, "ms", true);
+}
+
+TEST_F(ValuesPerfTest, DeepCopy) {
+  scoped_ptr<DictionaryValue> tree = ParseCorpus();
+  ASSERT_TRUE(tree);
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumTrees; ++i)
+    scoped_ptr<DictionaryValue> copy(tree->DeepCopy());
+  perf_test::PrintResult(
+      "values", "", "deep_copy",
+      (TimeTicks::Now() - start).InMillisecondsF() / kNumTrees, "ms", true);
+}
+
+// Looks up keys of a dictionary with |num_keys| entries in a fixed pseudo-
+// random order, so that the cost of the lookup itself dominates.
+void RunLookupTest(int num_keys) {
+  DictionaryValue dict;
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back(StringPrintf("key_%d", i));
+    dict.SetIntegerWithoutPathExpansion(keys.back(), i);
+  }
+
+  int found = 0;
+  size_t index = 0;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumLookups; ++i) {
+    index = (index * 1103515245 + 12345) % keys.size();
+    const Value* value;
+    if (dict.GetWithoutPathExpansion(keys[index], &value))
+      ++found;
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  EXPECT_EQ(kNumLookups, found);
+
+  perf_test::PrintResult(
+      "values", StringPrintf("_%d_keys", num_keys), "lookup",
+      elapsed.InMillisecondsF() * 1000000 / kNumLookups, "ns/lookup", true);
+}
+
+TEST_F(ValuesPerfTest, Lookup) {
+  RunLookupTest(8);
+  RunLookupTest(64);
+  RunLookupTest(1024);
+}
+
+TEST_F(ValuesPerfTest, PathLookup) {
+  scoped_ptr<DictionaryValue> tree = ParseCorpus();
+  ASSERT_TRUE(tree);
+  std::vector<std::string> paths;
+  for (int i = 0; i < 1000; i += 2)
+    paths.push_back(StringPrintf("k%d.setting.value", i));
+
+  int found = 0;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumLookups; ++i) {
+    int value;
+    if (tree->GetInteger(paths[i % paths.size()], &value))
+      ++found;
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  EXPECT_EQ(kNumLookups, found);
+
+  perf_test::PrintResult(
+      "values", "", "path_lookup",
+      elapsed.InMillisecondsF() * 1000000 / kNumLookups, "ns/lookup", true);
+}
+
+}  // namespace
+
+}  // namespace base
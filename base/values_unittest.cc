@@ -363,6 +363,44 @@ TEST(ValuesTest, DictionaryWithoutPathExpansionDeprecated) {
   EXPECT_EQ(Value::TYPE_NULL, value4->GetType());
 }
 
+TEST(ValuesTest, SetEntriesWithoutPathExpansion) {
+  DictionaryValue dict;
+  dict.SetIntegerWithoutPathExpansion("b", 1);
+  dict.SetIntegerWithoutPathExpansion("d", 2);
+
+  DictionaryValue::EntryVector entries;
+  entries.push_back(DictionaryValue::Entry("e", new FundamentalValue(3)));
+  entries.push_back(DictionaryValue::Entry("d", new FundamentalValue(4)));
+  entries.push_back(DictionaryValue::Entry("a.b", new FundamentalValue(5)));
+  entries.push_back(DictionaryValue::Entry("e", new FundamentalValue(6)));
+  entries.push_back(DictionaryValue::Entry("c", new FundamentalValue(7)));
+  entries.push_back(DictionaryValue::Entry("e", new FundamentalValue(8)));
+  dict.SetEntriesWithoutPathExpansion(&entries);
+  EXPECT_TRUE(entries.empty());
+
+  // The last value set for a key wins, as with SetWithoutPathExpansion().
+  EXPECT_EQ(5U, dict.size());
+  int value = 0;
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("b", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("d", &value));
+  EXPECT_EQ(4, value);
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("a.b", &value));
+  EXPECT_EQ(5, value);
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("c", &value));
+  EXPECT_EQ(7, value);
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("e", &value));
+  EXPECT_EQ(8, value);
+
+  std::string expected_keys[] = {"a.b", "b", "c", "d", "e"};
+  size_t i = 0;
+  for (DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance(), ++i) {
+    ASSERT_LT(i, arraysize(expected_keys));
+    EXPECT_EQ(expected_keys[i], it.key());
+  }
+  EXPECT_EQ(arraysize(expected_keys), i);
+}
+
 TEST(ValuesTest, DictionaryRemovePath) {
   DictionaryValue dict;
   dict.SetInteger("a.long.way.down", 1);
@@ -45,6 +45,7 @@ PolicyLoadStatus JsonErrorToPolicyLoadStatus(int status) {
     case base::JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT:
     case base::JSONReader::JSON_UNSUPPORTED_ENCODING:
     case base::JSONReader::JSON_UNQUOTED_DICTIONARY_KEY:
+    case base::JSONReader::JSON_PARSE_ABORTED:
       return POLICY_LOAD_STATUS_PARSE_ERROR;
     case base::JSONReader::JSON_NO_ERROR:
       NOTREACHED();
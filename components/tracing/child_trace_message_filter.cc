@@ -143,8 +143,7 @@ void ChildTraceMessageFilter::OnTraceDataCollected(
     return;
   }
   if (events_str_ptr->data().size()) {
-    sender_->Send(new TracingHostMsg_TraceDataCollected(
-        events_str_ptr->data()));
+    sender_->Send(new TracingHostMsg_TraceDataCollected(events_str_ptr));
   }
   if (!has_more_events) {
     std::vector<std::string> category_groups;
@@ -166,7 +165,7 @@ void ChildTraceMessageFilter::OnMonitoringTraceDataCollected(
     return;
   }
   sender_->Send(new TracingHostMsg_MonitoringTraceDataCollected(
-      events_str_ptr->data()));
+      events_str_ptr));
 
   if (!has_more_events)
     sender_->Send(new TracingHostMsg_CaptureMonitoringSnapshotAck());
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/sync_socket.h"
 #include "base/trace_event/memory_dump_request_args.h"
 #include "base/trace_event/trace_event_impl.h"
@@ -86,14 +87,15 @@ IPC_MESSAGE_CONTROL1(TracingHostMsg_EndTracingAck,
 // Reply from child processes acking TracingMsg_CaptureMonitoringSnapshot.
 IPC_MESSAGE_CONTROL0(TracingHostMsg_CaptureMonitoringSnapshotAck)
 
-// Child processes send back trace data in JSON chunks.
+// Child processes send back trace data in JSON chunks. The chunks are
+// referenced by the message rather than copied into it.
 IPC_MESSAGE_CONTROL1(TracingHostMsg_TraceDataCollected,
-                     std::string /*json trace data*/)
+                     scoped_refptr<base::RefCountedString> /*json trace data*/)
 
 // Child processes send back trace data of the current monitoring
 // in JSON chunks.
 IPC_MESSAGE_CONTROL1(TracingHostMsg_MonitoringTraceDataCollected,
-                     std::string /*json trace data*/)
+                     scoped_refptr<base::RefCountedString> /*json trace data*/)
 
 // Reply to TracingMsg_GetTraceLogStatus.
 IPC_MESSAGE_CONTROL1(
@@ -155,18 +155,14 @@ void TraceMessageFilter::OnCaptureMonitoringSnapshotAcked() {
   }
 }
 
-void TraceMessageFilter::OnTraceDataCollected(const std::string& data) {
-  scoped_refptr<base::RefCountedString> data_ptr(new base::RefCountedString());
-  data_ptr->data() = data;
-  TracingControllerImpl::GetInstance()->OnTraceDataCollected(data_ptr);
+void TraceMessageFilter::OnTraceDataCollected(
+    const scoped_refptr<base::RefCountedString>& data) {
+  TracingControllerImpl::GetInstance()->OnTraceDataCollected(data);
 }
 
 void TraceMessageFilter::OnMonitoringTraceDataCollected(
-    const std::string& data) {
-  scoped_refptr<base::RefCountedString> data_ptr(new base::RefCountedString());
-  data_ptr->data() = data;
-  TracingControllerImpl::GetInstance()->OnMonitoringTraceDataCollected(
-      data_ptr);
+    const scoped_refptr<base::RefCountedString>& data) {
+  TracingControllerImpl::GetInstance()->OnMonitoringTraceDataCollected(data);
 }
 
 void TraceMessageFilter::OnWatchEventMatched() {
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 
+#include "base/memory/ref_counted_memory.h"
 #include "base/trace_event/memory_dump_request_args.h"
 #include "base/trace_event/trace_event.h"
 #include "content/public/browser/browser_message_filter.h"
@@ -51,8 +52,10 @@ class TraceMessageFilter : public BrowserMessageFilter {
   void OnCaptureMonitoringSnapshotAcked();
   void OnWatchEventMatched();
   void OnTraceLogStatusReply(const base::trace_event::TraceLogStatus& status);
-  void OnTraceDataCollected(const std::string& data);
-  void OnMonitoringTraceDataCollected(const std::string& data);
+  void OnTraceDataCollected(
+      const scoped_refptr<base::RefCountedString>& data);
+  void OnMonitoringTraceDataCollected(
+      const scoped_refptr<base::RefCountedString>& data);
   void OnGlobalMemoryDumpRequest(
       const base::trace_event::MemoryDumpRequestArgs& args);
   void OnProcessMemoryDumpResponse(uint64 dump_guid, bool success);
@@ -225,6 +225,27 @@
     },
   ],
   'conditions': [
+    # Matches the GN build, which doesn't link the crypto tests on Windows yet.
+    ['OS != "win"', {
+      'targets': [
+        {
+          # GN: //crypto:crypto_perftests
+          'target_name': 'crypto_perftests',
+          'type': '<(gtest_target_type)',
+          'dependencies': [
+            'crypto',
+            '../base/base.gyp:base',
+            '../base/base.gyp:test_support_base',
+            '../testing/gtest.gyp:gtest',
+          ],
+          'sources': [
+            'sha2_perftest.cc',
+            '../base/test/run_all_unittests.cc',
+            '../testing/perf/perf_test.cc',
+          ],
+        },
+      ],
+    }],
     ['OS == "win" and target_arch=="ia32"', {
       'targets': [
         {
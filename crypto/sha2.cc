@@ -4,13 +4,65 @@
 
 #include "crypto/sha2.h"
 
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/stl_util.h"
 #include "crypto/secure_hash.h"
+#include "crypto/sha2_x86.h"
 
 namespace crypto {
 
+namespace {
+
+#if defined(BASE_HASH_X86_KERNELS)
+const uint32 kSHA256InitialState[] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Picks the kernels to hash with on this CPU, once.
+struct SHA256Kernels {
+  SHA256Kernels() : use_sha(false), use_avx2(false) {
+    base::CPU cpu;
+    use_sha = cpu.has_sha() && cpu.has_sse41();
+    use_avx2 = cpu.has_avx2();
+    hash.state_words = arraysize(kSHA256InitialState);
+    hash.initial_state = kSHA256InitialState;
+    hash.big_endian = true;
+    hash.process_blocks = internal::SHA256ProcessBlocksSHA;
+    hash.process_lanes = internal::SHA256ProcessLanesAVX2;
+  }
+
+  // Whether |hash.process_blocks| and |hash.process_lanes| can be used.
+  bool use_sha;
+  bool use_avx2;
+  base::internal::BlockHash hash;
+};
+
+base::LazyInstance<SHA256Kernels>::Leaky g_sha256_kernels =
+    LAZY_INSTANCE_INITIALIZER;
+#endif  // defined(BASE_HASH_X86_KERNELS)
+
+}  // namespace
+
 void SHA256HashString(const base::StringPiece& str, void* output, size_t len) {
+#if defined(BASE_HASH_X86_KERNELS)
+  const SHA256Kernels& kernels = g_sha256_kernels.Get();
+  if (kernels.use_sha) {
+    uint8 hash[kSHA256Length];
+    base::internal::HashBytes(kernels.hash,
+                              reinterpret_cast<const uint8*>(str.data()),
+                              str.length(), hash);
+    memcpy(output, hash, std::min(len, kSHA256Length));
+    return;
+  }
+#endif
+
   scoped_ptr<SecureHash> ctx(SecureHash::Create(SecureHash::SHA256));
   ctx->Update(str.data(), str.length());
   ctx->Finish(output, len);
@@ -22,4 +74,33 @@ std::string SHA256HashString(const base::StringPiece& str) {
   return output;
 }
 
+void SHA256HashStrings(const base::StringPiece inputs[],
+                       size_t count,
+                       void* output) {
+  uint8* hashes = static_cast<uint8*>(output);
+#if defined(BASE_HASH_X86_KERNELS)
+  // Hashing one string at a time with the SHA extensions is faster than
+  // hashing several at once with AVX2.
+  const SHA256Kernels& kernels = g_sha256_kernels.Get();
+  if (!kernels.use_sha && kernels.use_avx2) {
+    const size_t kLanes = base::internal::kHashLanes;
+    for (size_t first = 0; first < count; first += kLanes) {
+      size_t num_strings = std::min(kLanes, count - first);
+      const uint8* data[kLanes];
+      size_t lengths[kLanes];
+      for (size_t i = 0; i < num_strings; ++i) {
+        data[i] = reinterpret_cast<const uint8*>(inputs[first + i].data());
+        lengths[i] = inputs[first + i].length();
+      }
+      base::internal::HashBytesMany(kernels.hash, data, lengths, num_strings,
+                                    hashes + first * kSHA256Length);
+    }
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < count; ++i)
+    SHA256HashString(inputs[i], hashes + i * kSHA256Length, kSHA256Length);
+}
+
 }  // namespace crypto
@@ -28,6 +28,14 @@ CRYPTO_EXPORT void SHA256HashString(const base::StringPiece& str,
 // string.
 CRYPTO_EXPORT std::string SHA256HashString(const base::StringPiece& str);
 
+// Computes the SHA-256 hashes of the |count| strings in |inputs| and stores
+// them one after the other in |output|, which must be |count| * 32 bytes
+// long. This is faster than hashing the strings one at a time on some CPUs,
+// especially when they are short and of similar lengths.
+CRYPTO_EXPORT void SHA256HashStrings(const base::StringPiece inputs[],
+                                     size_t count,
+                                     void* output);
+
 }  // namespace crypto
 
 #endif  // CRYPTO_SHA2_H_
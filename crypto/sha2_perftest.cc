@@ -0,0 +1,58 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crypto/sha2.h"
+
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace {
+
+// Total number of bytes hashed by each measurement.
+const size_t kBytesPerTest = 64 << 20;
+
+// Hashes strings of |size| bytes one at a time and with SHA256HashStrings(),
+// and reports the throughput of both.
+void RunSHA256(size_t size) {
+  std::string input(size, 'a');
+  for (size_t i = 0; i < size; ++i)
+    input[i] = static_cast<char>(i * 7);
+  std::vector<base::StringPiece> inputs(kBytesPerTest / size, input);
+  std::string output(inputs.size() * crypto::kSHA256Length, '\0');
+  std::string size_name = base::StringPrintf("_%d_bytes",
+                                             static_cast<int>(size));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    crypto::SHA256HashString(inputs[i], &output[i * crypto::kSHA256Length],
+                             crypto::kSHA256Length);
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  perf_test::PrintResult("sha256", size_name, "one_at_a_time",
+                         kBytesPerTest / elapsed.InSecondsF() / (1 << 20),
+                         "MB/s", true);
+
+  start = base::TimeTicks::Now();
+  crypto::SHA256HashStrings(&inputs[0], inputs.size(), &output[0]);
+  elapsed = base::TimeTicks::Now() - start;
+  perf_test::PrintResult("sha256", size_name, "many",
+                         kBytesPerTest / elapsed.InSecondsF() / (1 << 20),
+                         "MB/s", true);
+}
+
+// Safe browsing hashes URL expressions this short.
+TEST(SHA256PerfTest, Short) {
+  RunSHA256(64);
+}
+
+TEST(SHA256PerfTest, Long) {
+  RunSHA256(64 << 10);
+}
+
+}  // namespace
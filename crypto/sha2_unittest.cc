@@ -4,9 +4,45 @@
 
 #include "crypto/sha2.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "base/basictypes.h"
+#include "base/cpu.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "crypto/secure_hash.h"
+#include "crypto/sha2_x86.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+namespace {
+
+// Returns the SHA-256 hash of |input| computed incrementally by SecureHash,
+// which doesn't use the same code as SHA256HashString().
+std::string SecureHashSHA256(const std::string& input) {
+  scoped_ptr<crypto::SecureHash> ctx(
+      crypto::SecureHash::Create(crypto::SecureHash::SHA256));
+  for (size_t i = 0; i < input.length(); i += 7)
+    ctx->Update(input.data() + i, std::min<size_t>(7, input.length() - i));
+  std::string output(crypto::kSHA256Length, '\0');
+  ctx->Finish(&output[0], output.length());
+  return output;
+}
+
+// Strings of every length up to a few blocks.
+std::vector<std::string> MakeInputs() {
+  std::vector<std::string> inputs(203);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    for (size_t j = 0; j < i; ++j)
+      inputs[i].push_back(static_cast<char>(i * 31 + j));
+  }
+  return inputs;
+}
+
+}  // namespace
+
 TEST(Sha256Test, Test1) {
   // Example B.1 from FIPS 180-2: one-block message.
   std::string input1 = "abc";
@@ -98,3 +134,86 @@ TEST(Sha256Test, Test3) {
   for (size_t i = 0; i < sizeof(output_truncated3); i++)
     EXPECT_EQ(expected3[i], static_cast<int>(output_truncated3[i]));
 }
+
+TEST(Sha256Test, AllLengths) {
+  std::vector<std::string> inputs = MakeInputs();
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    EXPECT_EQ(SecureHashSHA256(inputs[i]),
+              crypto::SHA256HashString(inputs[i])) << "input " << i;
+  }
+}
+
+TEST(Sha256Test, HashStrings) {
+  std::vector<std::string> inputs = MakeInputs();
+  std::vector<base::StringPiece> pieces(inputs.begin(), inputs.end());
+  std::string output(inputs.size() * crypto::kSHA256Length, '\0');
+  // Counts that don't fill the lanes of the multi-buffer kernels evenly.
+  for (size_t count = 0; count <= inputs.size(); count += 67) {
+    crypto::SHA256HashStrings(&pieces[0], count, &output[0]);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(SecureHashSHA256(inputs[i]),
+                output.substr(i * crypto::kSHA256Length,
+                              crypto::kSHA256Length)) << "input " << i;
+    }
+  }
+}
+
+#if defined(BASE_HASH_X86_KERNELS)
+// SHA256HashStrings() only uses AVX2 on CPUs without the SHA extensions.
+TEST(Sha256Test, AVX2) {
+  if (!base::CPU().has_avx2())
+    return;
+
+  const uint32 kInitialState[] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  base::internal::BlockHash hash = {
+      arraysize(kInitialState), kInitialState, true, NULL,
+      crypto::internal::SHA256ProcessLanesAVX2};
+
+  // The examples of FIPS 180-2 and the empty message, each |repeat| times
+  // |input|, come before the inputs that are checked against SecureHash.
+  const struct {
+    const char* input;
+    size_t repeat;
+    const char* digest;
+  } kKnownAnswers[] = {
+    {"", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1,
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"a", 1000000,
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+  };
+  std::vector<std::string> inputs(arraysize(kKnownAnswers));
+  for (size_t i = 0; i < arraysize(kKnownAnswers); ++i) {
+    for (size_t j = 0; j < kKnownAnswers[i].repeat; ++j)
+      inputs[i] += kKnownAnswers[i].input;
+  }
+  std::vector<std::string> other_inputs = MakeInputs();
+  inputs.insert(inputs.end(), other_inputs.begin(), other_inputs.end());
+
+  std::vector<const uint8*> data;
+  std::vector<size_t> lengths;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    data.push_back(reinterpret_cast<const uint8*>(inputs[i].data()));
+    lengths.push_back(inputs[i].length());
+  }
+  std::string output(inputs.size() * crypto::kSHA256Length, '\0');
+  base::internal::HashBytesMany(hash, &data[0], &lengths[0], inputs.size(),
+                                reinterpret_cast<uint8*>(&output[0]));
+  for (size_t i = 0; i < arraysize(kKnownAnswers); ++i) {
+    EXPECT_EQ(kKnownAnswers[i].digest,
+              base::StringToLowerASCII(base::HexEncode(
+                  output.data() + i * crypto::kSHA256Length,
+                  crypto::kSHA256Length))) << "answer " << i;
+  }
+  for (size_t i = arraysize(kKnownAnswers); i < inputs.size(); ++i) {
+    EXPECT_EQ(SecureHashSHA256(inputs[i]),
+              output.substr(i * crypto::kSHA256Length,
+                            crypto::kSHA256Length)) << "input " << i;
+  }
+}
+#endif  // defined(BASE_HASH_X86_KERNELS)
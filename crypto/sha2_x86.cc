@@ -0,0 +1,190 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crypto/sha2_x86.h"
+
+#if defined(BASE_HASH_X86_KERNELS)
+
+namespace crypto {
+namespace internal {
+
+using base::internal::kHashBlockSize;
+using base::internal::kHashLanes;
+
+namespace {
+
+// The round constants of FIPS 180-4, 4.2.2.
+const uint32 kRoundConstants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+}  // namespace
+
+// Four rounds of SHA-256 with the SHA extensions, two with each sha256rnds2.
+// The message schedule is computed in msg[] alongside the rounds: group i of
+// four rounds finishes the words of group i + 1 with sha256msg2 and starts
+// those of group i + 3 with sha256msg1.
+#define SHA256_FOUR_ROUNDS(i)                                                 \
+  do {                                                                        \
+    __m128i words = _mm_add_epi32(                                            \
+        msg[(i) % 4], _mm_loadu_si128(reinterpret_cast<const __m128i*>(       \
+                          kRoundConstants + (i) * 4)));                       \
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);                          \
+    if ((i) >= 3 && (i) <= 14) {                                              \
+      msg[((i) + 1) % 4] = _mm_add_epi32(                                     \
+          msg[((i) + 1) % 4],                                                 \
+          _mm_alignr_epi8(msg[(i) % 4], msg[((i) + 3) % 4], 4));              \
+      msg[((i) + 1) % 4] =                                                    \
+          _mm_sha256msg2_epu32(msg[((i) + 1) % 4], msg[(i) % 4]);             \
+    }                                                                         \
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0e)); \
+    if ((i) >= 1 && (i) <= 12) {                                              \
+      msg[((i) + 3) % 4] =                                                    \
+          _mm_sha256msg1_epu32(msg[((i) + 3) % 4], msg[(i) % 4]);             \
+    }                                                                         \
+  } while (0)
+
+HASH_TARGET("sha,sse4.1")
+void SHA256ProcessBlocksSHA(uint32* state,
+                            const uint8* data,
+                            size_t num_blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  // sha256rnds2 keeps the state as ABEF and CDGH.
+  __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+  __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+  __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+  __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+  __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+  __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+  for (size_t block = 0; block < num_blocks; ++block) {
+    const __m128i abef_save = abef;
+    const __m128i cdgh_save = cdgh;
+    __m128i msg[4];
+    for (int i = 0; i < 4; ++i) {
+      msg[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i),
+          kByteSwap);
+    }
+    SHA256_FOUR_ROUNDS(0);
+    SHA256_FOUR_ROUNDS(1);
+    SHA256_FOUR_ROUNDS(2);
+    SHA256_FOUR_ROUNDS(3);
+    SHA256_FOUR_ROUNDS(4);
+    SHA256_FOUR_ROUNDS(5);
+    SHA256_FOUR_ROUNDS(6);
+    SHA256_FOUR_ROUNDS(7);
+    SHA256_FOUR_ROUNDS(8);
+    SHA256_FOUR_ROUNDS(9);
+    SHA256_FOUR_ROUNDS(10);
+    SHA256_FOUR_ROUNDS(11);
+    SHA256_FOUR_ROUNDS(12);
+    SHA256_FOUR_ROUNDS(13);
+    SHA256_FOUR_ROUNDS(14);
+    SHA256_FOUR_ROUNDS(15);
+    abef = _mm_add_epi32(abef, abef_save);
+    cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    data += kHashBlockSize;
+  }
+
+  __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+  __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                   _mm_blend_epi16(feba, dchg, 0xf0));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4),
+                   _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#undef SHA256_FOUR_ROUNDS
+
+namespace {
+
+inline HASH_TARGET("avx2") __m256i RotateRight(__m256i x, int bits) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, bits),
+                         _mm256_slli_epi32(x, 32 - bits));
+}
+
+inline HASH_TARGET("avx2") __m256i Add(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+inline HASH_TARGET("avx2") __m256i Xor(__m256i a, __m256i b, __m256i c) {
+  return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+}
+
+}  // namespace
+
+HASH_TARGET("avx2")
+void SHA256ProcessLanesAVX2(uint32* state,
+                            const uint8* const blocks[kHashLanes]) {
+  __m256i w[16];
+  base::internal::LoadBlocksAVX2(blocks, true, w);
+  // The working variables a..h of FIPS 180-4, 6.2.2.
+  __m256i v[8];
+  for (int i = 0; i < 8; ++i) {
+    v[i] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(state + i * kHashLanes));
+  }
+
+  for (int t = 0; t < 64; ++t) {
+    if (t >= 16) {
+      __m256i w2 = w[(t - 2) & 15];
+      __m256i w15 = w[(t - 15) & 15];
+      __m256i sigma1 = Xor(RotateRight(w2, 17), RotateRight(w2, 19),
+                           _mm256_srli_epi32(w2, 10));
+      __m256i sigma0 = Xor(RotateRight(w15, 7), RotateRight(w15, 18),
+                           _mm256_srli_epi32(w15, 3));
+      w[t & 15] = Add(Add(sigma1, w[(t - 7) & 15]), Add(sigma0, w[t & 15]));
+    }
+    // v[] is rotated by renaming instead of moving: a is v[(0 - t) & 7].
+    __m256i& a = v[(0 - t) & 7];
+    __m256i& b = v[(1 - t) & 7];
+    __m256i& c = v[(2 - t) & 7];
+    __m256i& d = v[(3 - t) & 7];
+    __m256i& e = v[(4 - t) & 7];
+    __m256i& f = v[(5 - t) & 7];
+    __m256i& g = v[(6 - t) & 7];
+    __m256i& h = v[(7 - t) & 7];
+    __m256i ch = _mm256_xor_si256(
+        g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+    __m256i maj = _mm256_or_si256(
+        _mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    __m256i t1 = Add(Add(h, Xor(RotateRight(e, 6), RotateRight(e, 11),
+                                RotateRight(e, 25))),
+                     Add(Add(ch, w[t & 15]),
+                         _mm256_set1_epi32(kRoundConstants[t])));
+    __m256i t2 = Add(Xor(RotateRight(a, 2), RotateRight(a, 13),
+                         RotateRight(a, 22)),
+                     maj);
+    d = Add(d, t1);
+    // h becomes the new a.
+    h = Add(t1, t2);
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    __m256i* s = reinterpret_cast<__m256i*>(state + i * kHashLanes);
+    _mm256_storeu_si256(s, Add(_mm256_loadu_si256(s), v[i]));
+  }
+}
+
+}  // namespace internal
+}  // namespace crypto
+
+#endif  // defined(BASE_HASH_X86_KERNELS)
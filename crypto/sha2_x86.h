@@ -0,0 +1,32 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CRYPTO_SHA2_X86_H_
+#define CRYPTO_SHA2_X86_H_
+
+#include "base/hash_x86.h"
+
+#if defined(BASE_HASH_X86_KERNELS)
+
+namespace crypto {
+namespace internal {
+
+// SHA-256 compression with the SHA extensions. |state| is SHA-256's H0..H7.
+// Only call it if base::CPU has the SHA extensions and SSE4.1.
+void SHA256ProcessBlocksSHA(uint32* state,
+                            const uint8* data,
+                            size_t num_blocks);
+
+// SHA-256 compression of base::internal::kHashLanes messages at once with
+// AVX2. Only call it if base::CPU has AVX2.
+void SHA256ProcessLanesAVX2(
+    uint32* state,
+    const uint8* const blocks[base::internal::kHashLanes]);
+
+}  // namespace internal
+}  // namespace crypto
+
+#endif  // defined(BASE_HASH_X86_KERNELS)
+
+#endif  // CRYPTO_SHA2_X86_H_
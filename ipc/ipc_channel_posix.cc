@@ -6,15 +6,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <unistd.h>
-
-#if defined(OS_OPENBSD)
 #include <sys/uio.h>
-#endif
+#include <unistd.h>
 
 #if !defined(OS_NACL_NONSFI)
 #include <sys/un.h>
@@ -22,6 +20,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base/command_line.h"
 #include "base/files/file_path.h"
@@ -165,6 +164,25 @@ bool SocketWriteErrorIsRecoverable() {
 #endif  // OS_MACOSX
 }
 
+// Appends the pieces of |msg| that follow its first |offset| bytes to |iov|,
+// up to the limit of a single gather write.
+void GatherUnwrittenSegments(const Message& msg,
+                             size_t offset,
+                             std::vector<struct iovec>* iov) {
+  std::vector<base::StringPiece> segments;
+  msg.GetSegments(&segments);
+  for (size_t i = 0; i < segments.size() && iov->size() < IOV_MAX; ++i) {
+    if (offset >= segments[i].size()) {
+      offset -= segments[i].size();
+      continue;
+    }
+    struct iovec piece = {const_cast<char*>(segments[i].data() + offset),
+                          segments[i].size() - offset};
+    iov->push_back(piece);
+    offset = 0;
+  }
+}
+
 }  // namespace
 
 #if defined(OS_ANDROID)
@@ -424,13 +442,26 @@ bool ChannelPosix::ProcessOutgoingMessages() {
 
     size_t amt_to_write = msg->size() - message_send_bytes_written_;
     DCHECK_NE(0U, amt_to_write);
-    const char* out_bytes = reinterpret_cast<const char*>(msg->data()) +
-        message_send_bytes_written_;
 
     struct msghdr msgh = {0};
-    struct iovec iov = {const_cast<char*>(out_bytes), amt_to_write};
-    msgh.msg_iov = &iov;
-    msgh.msg_iovlen = 1;
+    struct iovec iov;
+    std::vector<struct iovec> gathered_iov;
+    if (msg->has_referenced_data()) {
+      // Large blobs the message refers to are written from where they are
+      // rather than being copied into the message first.
+      GatherUnwrittenSegments(*msg, message_send_bytes_written_,
+                              &gathered_iov);
+      msgh.msg_iov = &gathered_iov[0];
+      msgh.msg_iovlen = gathered_iov.size();
+    } else {
+      iov.iov_base = const_cast<char*>(
+          reinterpret_cast<const char*>(msg->data()) +
+          message_send_bytes_written_);
+      iov.iov_len = amt_to_write;
+      msgh.msg_iov = &iov;
+      msgh.msg_iovlen = 1;
+    }
+    struct iovec* data_iov = msgh.msg_iov;
     char buf[CMSG_SPACE(sizeof(int) *
                         MessageAttachmentSet::kMaxDescriptorsPerMessage)];
 
@@ -477,7 +508,7 @@ bool ChannelPosix::ProcessOutgoingMessages() {
         fd_written = fd_pipe_.get();
         bytes_written =
             HANDLE_EINTR(sendmsg(fd_pipe_.get(), &msgh, MSG_DONTWAIT));
-        msgh.msg_iov = &iov;
+        msgh.msg_iov = data_iov;
         msgh.msg_controllen = 0;
         if (bytes_written > 0) {
           CloseFileDescriptors(msg);
@@ -493,8 +524,8 @@ bool ChannelPosix::ProcessOutgoingMessages() {
         DCHECK_EQ(msg->attachment_set()->size(), 1U);
       }
       if (!msgh.msg_controllen) {
-        bytes_written =
-            HANDLE_EINTR(write(pipe_.get(), out_bytes, amt_to_write));
+        bytes_written = HANDLE_EINTR(
+            writev(pipe_.get(), msgh.msg_iov, msgh.msg_iovlen));
       } else
 #endif  // IPC_USES_READWRITE
       {
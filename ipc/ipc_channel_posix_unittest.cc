@@ -14,6 +14,7 @@
 #include "base/basictypes.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/path_service.h"
@@ -100,6 +101,37 @@ class IPCChannelPosixTestListener : public IPC::Listener {
   bool quit_only_on_message_;
 };
 
+// Expects messages carrying the blobs sent by SendReferencedData.
+class ReferencedDataListener : public IPC::Listener {
+ public:
+  ReferencedDataListener(const std::string& blob, int num_messages)
+      : blob_(blob), num_messages_(num_messages), num_received_(0) {}
+  ~ReferencedDataListener() override {}
+
+  bool OnMessageReceived(const IPC::Message& message) override {
+    PickleIterator iter(message);
+    int index;
+    const char* data;
+    int length;
+    EXPECT_TRUE(iter.ReadInt(&index));
+    EXPECT_EQ(num_received_, index);
+    EXPECT_TRUE(iter.ReadData(&data, &length));
+    EXPECT_TRUE(blob_ == std::string(data, length));
+    EXPECT_TRUE(iter.ReadInt(&index));
+    EXPECT_EQ(-num_received_, index);
+    if (++num_received_ == num_messages_)
+      base::MessageLoopForIO::current()->QuitNow();
+    return true;
+  }
+
+  int num_received() const { return num_received_; }
+
+ private:
+  const std::string blob_;
+  const int num_messages_;
+  int num_received_;
+};
+
 class IPCChannelPosixTest : public base::MultiProcessTest {
  public:
   static void SetUpSocket(IPC::ChannelHandle *handle,
@@ -234,6 +266,48 @@ TEST_F(IPCChannelPosixTest, BasicConnected) {
   ASSERT_FALSE(channel2->AcceptsConnections());
 }
 
+// Messages that refer to data they don't hold are written with gather writes,
+// which have to pick up where they left off when the socket fills up.
+TEST_F(IPCChannelPosixTest, SendReferencedData) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pipe_fds));
+  ASSERT_GE(fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK), 0);
+  ASSERT_GE(fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK), 0);
+  int send_buffer_size = 16 * 1024;
+  ASSERT_EQ(0, setsockopt(pipe_fds[0], SOL_SOCKET, SO_SNDBUF,
+                          &send_buffer_size, sizeof(send_buffer_size)));
+
+  std::string blob(1024 * 1024 + 3, 0);
+  for (size_t i = 0; i < blob.size(); ++i)
+    blob[i] = static_cast<char>(i % 251);
+  const int kNumMessages = 4;
+  IPCChannelPosixTestListener sender_listener(true);
+  ReferencedDataListener receiver_listener(blob, kNumMessages);
+  scoped_ptr<IPC::ChannelPosix> sender(new IPC::ChannelPosix(
+      IPC::ChannelHandle("sender", base::FileDescriptor(pipe_fds[0], false)),
+      IPC::Channel::MODE_SERVER, &sender_listener));
+  scoped_ptr<IPC::ChannelPosix> receiver(new IPC::ChannelPosix(
+      IPC::ChannelHandle("receiver", base::FileDescriptor(pipe_fds[1], false)),
+      IPC::Channel::MODE_CLIENT, &receiver_listener));
+  ASSERT_TRUE(sender->Connect());
+  ASSERT_TRUE(receiver->Connect());
+
+  std::string data(blob);
+  scoped_refptr<base::RefCountedString> referenced =
+      base::RefCountedString::TakeString(&data);
+  for (int i = 0; i < kNumMessages; ++i) {
+    IPC::Message* message = new IPC::Message(
+        0, kQuitMessage, IPC::Message::PRIORITY_NORMAL);
+    message->WriteInt(i);
+    message->WriteDataReference(referenced);
+    message->WriteInt(-i);
+    ASSERT_TRUE(message->has_referenced_data());
+    ASSERT_TRUE(sender->Send(message));
+  }
+  SpinRunLoop(TestTimeouts::action_max_timeout());
+  EXPECT_EQ(kNumMessages, receiver_listener.num_received());
+}
+
 // If a connection closes right before a Send() call, we may end up closing
 // the connection without notifying the listener, which can cause hangs in
 // sync_message_filter and others. Make sure the listener is notified.
@@ -88,6 +88,8 @@ bool ChannelWin::Send(Message* message) {
   Logging::GetInstance()->OnSendMessage(message, "");
 #endif
 
+  // Only ChannelPosix writes referenced data without copying it.
+  message->Flatten();
   message->TraceMessageBegin();
   output_queue_.push(message);
   // ensure waiting to write
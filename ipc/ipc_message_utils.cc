@@ -6,6 +6,7 @@
 
 #include "base/files/file_path.h"
 #include "base/json/json_writer.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/nullable_string16.h"
 #include "base/strings/string_number_conversions.h"
@@ -565,6 +566,30 @@ void ParamTraits<base::NullableString16>::Log(const param_type& p,
   l->append(")");
 }
 
+void ParamTraits<scoped_refptr<base::RefCountedString> >::Write(
+    Message* m, const param_type& p) {
+  if (!p.get()) {
+    m->WriteString(std::string());
+    return;
+  }
+  m->WriteDataReference(p);
+}
+
+bool ParamTraits<scoped_refptr<base::RefCountedString> >::Read(
+    const Message* m, PickleIterator* iter, param_type* r) {
+  std::string data;
+  if (!iter->ReadString(&data))
+    return false;
+  *r = base::RefCountedString::TakeString(&data);
+  return true;
+}
+
+void ParamTraits<scoped_refptr<base::RefCountedString> >::Log(
+    const param_type& p, std::string* l) {
+  if (p.get())
+    l->append(p->data());
+}
+
 void ParamTraits<base::File::Info>::Write(Message* m,
                                           const param_type& p) {
   WriteParam(m, p.size);
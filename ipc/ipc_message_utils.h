@@ -14,6 +14,7 @@
 #include "base/containers/small_map.h"
 #include "base/files/file.h"
 #include "base/format_macros.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/strings/string16.h"
@@ -52,6 +53,7 @@ class DictionaryValue;
 class FilePath;
 class ListValue;
 class NullableString16;
+class RefCountedString;
 class Time;
 class TimeDelta;
 class TimeTicks;
@@ -458,6 +460,17 @@ struct IPC_EXPORT ParamTraits<base::NullableString16> {
   static void Log(const param_type& p, std::string* l);
 };
 
+// The string is referenced by the message rather than copied into it when it
+// is large, so it must not be modified once written. It is read back as a new
+// string, and has the same serialized form as a std::string.
+template <>
+struct IPC_EXPORT ParamTraits<scoped_refptr<base::RefCountedString> > {
+  typedef scoped_refptr<base::RefCountedString> param_type;
+  static void Write(Message* m, const param_type& p);
+  static bool Read(const Message* m, PickleIterator* iter, param_type* r);
+  static void Log(const param_type& p, std::string* l);
+};
+
 template <>
 struct IPC_EXPORT ParamTraits<base::File::Info> {
   typedef base::File::Info param_type;
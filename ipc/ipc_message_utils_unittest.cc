@@ -5,6 +5,7 @@
 #include "ipc/ipc_message_utils.h"
 
 #include "base/files/file_path.h"
+#include "base/memory/ref_counted_memory.h"
 #include "ipc/ipc_message.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -70,5 +71,32 @@ TEST(IPCMessageUtilsTest, ParameterValidation) {
   ASSERT_FALSE(ParamTraits<base::FilePath>::Read(&message, &iter, &bad_path));
 }
 
+// Tests that a large RefCountedString is referenced rather than copied, and
+// reads back like a std::string.
+TEST(IPCMessageUtilsTest, RefCountedString) {
+  std::string data(64 * 1024, 'x');
+  scoped_refptr<base::RefCountedString> large =
+      base::RefCountedString::TakeString(&data);
+  scoped_refptr<base::RefCountedString> none;
+
+  IPC::Message message;
+  ParamTraits<scoped_refptr<base::RefCountedString> >::Write(&message, large);
+  ParamTraits<scoped_refptr<base::RefCountedString> >::Write(&message, none);
+  ParamTraits<int>::Write(&message, 42);
+  EXPECT_TRUE(message.has_referenced_data());
+
+  PickleIterator iter(message);
+  scoped_refptr<base::RefCountedString> large_read;
+  ASSERT_TRUE(ParamTraits<scoped_refptr<base::RefCountedString> >::Read(
+      &message, &iter, &large_read));
+  EXPECT_EQ(large->data(), large_read->data());
+  std::string none_read;
+  ASSERT_TRUE(ParamTraits<std::string>::Read(&message, &iter, &none_read));
+  EXPECT_TRUE(none_read.empty());
+  int int_read = 0;
+  ASSERT_TRUE(ParamTraits<int>::Read(&message, &iter, &int_read));
+  EXPECT_EQ(42, int_read);
+}
+
 }  // namespace
 }  // namespace IPC
@@ -42,6 +42,8 @@ void MessagePipeReader::CloseWithError(MojoResult error) {
 bool MessagePipeReader::Send(scoped_ptr<Message> message) {
   DCHECK(IsValid());
 
+  // Only ChannelPosix writes referenced data without copying it.
+  message->Flatten();
   message->TraceMessageBegin();
   std::vector<MojoHandle> handles;
   MojoResult result = MOJO_RESULT_OK;
@@ -4,14 +4,17 @@
 
 #include "base/basictypes.h"
 #include "base/files/file_util.h"
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/field_trial.h"
 #include "base/port.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/thread_task_runner_handle.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
 #include "base/threading/thread_restrictions.h"
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
@@ -338,6 +341,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyBasics) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendBasics();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheBasics) {
   SetCacheType(net::APP_CACHE);
   BackendBasics();
@@ -348,6 +357,11 @@ TEST_F(DiskCacheBackendTest, ShaderCacheBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3Basics) {
+  SetBlockfileV3Mode();
+  BackendBasics();
+}
+
 void DiskCacheBackendTest::BackendKeying() {
   InitCache();
   const char kName1[] = "the first key";
@@ -403,6 +417,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyKeying) {
   BackendKeying();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyKeying) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendKeying();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheKeying) {
   SetCacheType(net::APP_CACHE);
   BackendKeying();
@@ -413,6 +433,11 @@ TEST_F(DiskCacheBackendTest, ShaderCacheKeying) {
   BackendKeying();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3Keying) {
+  SetBlockfileV3Mode();
+  BackendKeying();
+}
+
 TEST_F(DiskCacheTest, CreateBackend) {
   net::TestCompletionCallback cb;
 
@@ -770,11 +795,22 @@ TEST_F(DiskCacheBackendTest, NewEvictionSetSize) {
   BackendSetSize();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3SetSize) {
+  SetBlockfileV3Mode();
+  BackendSetSize();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlySetSize) {
   SetMemoryOnlyMode();
   BackendSetSize();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlySetSize) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendSetSize();
+}
+
 void DiskCacheBackendTest::BackendLoad() {
   InitCache();
   int seed = static_cast<int>(Time::Now().ToInternalValue());
@@ -828,6 +864,13 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyLoad) {
   BackendLoad();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyLoad) {
+  SetMaxSize(0x100000);
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendLoad();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheLoad) {
   SetCacheType(net::APP_CACHE);
   // Work with a tiny index table (16 entries)
@@ -844,6 +887,12 @@ TEST_F(DiskCacheBackendTest, ShaderCacheLoad) {
   BackendLoad();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3Load) {
+  SetBlockfileV3Mode();
+  SetMaxSize(0x100000);
+  BackendLoad();
+}
+
 // Tests the chaining of an entry to the current head.
 void DiskCacheBackendTest::BackendChain() {
   SetMask(0x1);  // 2-entry table.
@@ -1288,6 +1337,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyEnumerations) {
   BackendEnumerations();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyEnumerations) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendEnumerations();
+}
+
 TEST_F(DiskCacheBackendTest, ShaderCacheEnumerations) {
   SetCacheType(net::SHADER_CACHE);
   BackendEnumerations();
@@ -1298,6 +1353,11 @@ TEST_F(DiskCacheBackendTest, AppCacheEnumerations) {
   BackendEnumerations();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3Enumerations) {
+  SetBlockfileV3Mode();
+  BackendEnumerations();
+}
+
 // Verifies enumerations while entries are open.
 void DiskCacheBackendTest::BackendEnumerations2() {
   InitCache();
@@ -1356,6 +1416,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyEnumerations2) {
   BackendEnumerations2();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyEnumerations2) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendEnumerations2();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheEnumerations2) {
   SetCacheType(net::APP_CACHE);
   BackendEnumerations2();
@@ -1366,6 +1432,11 @@ TEST_F(DiskCacheBackendTest, ShaderCacheEnumerations2) {
   BackendEnumerations2();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3Enumerations2) {
+  SetBlockfileV3Mode();
+  BackendEnumerations2();
+}
+
 // Verify that ReadData calls do not update the LRU cache
 // when using the SHADER_CACHE type.
 TEST_F(DiskCacheBackendTest, ShaderCacheEnumerationReadData) {
@@ -1553,11 +1624,22 @@ TEST_F(DiskCacheBackendTest, NewEvictionDoomRecent) {
   BackendDoomRecent();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3DoomRecent) {
+  SetBlockfileV3Mode();
+  BackendDoomRecent();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomRecent) {
   SetMemoryOnlyMode();
   BackendDoomRecent();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomRecent) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendDoomRecent();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesSinceSparse) {
   SetMemoryOnlyMode();
   base::Time start;
@@ -1566,6 +1648,15 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesSinceSparse) {
   EXPECT_EQ(1, cache_->GetEntryCount());
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomEntriesSinceSparse) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  base::Time start;
+  InitSparseCache(&start, NULL);
+  DoomEntriesSince(start);
+  EXPECT_EQ(1, cache_->GetEntryCount());
+}
+
 TEST_F(DiskCacheBackendTest, DoomEntriesSinceSparse) {
   base::Time start;
   InitSparseCache(&start, NULL);
@@ -1583,6 +1674,14 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomAllSparse) {
   EXPECT_EQ(0, cache_->GetEntryCount());
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomAllSparse) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitSparseCache(NULL, NULL);
+  EXPECT_EQ(net::OK, DoomAllEntries());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
 TEST_F(DiskCacheBackendTest, DoomAllSparse) {
   InitSparseCache(NULL, NULL);
   EXPECT_EQ(net::OK, DoomAllEntries());
@@ -1641,11 +1740,22 @@ TEST_F(DiskCacheBackendTest, NewEvictionDoomBetween) {
   BackendDoomBetween();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3DoomBetween) {
+  SetBlockfileV3Mode();
+  BackendDoomBetween();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomBetween) {
   SetMemoryOnlyMode();
   BackendDoomBetween();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomBetween) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendDoomBetween();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesBetweenSparse) {
   SetMemoryOnlyMode();
   base::Time start, end;
@@ -1659,6 +1769,20 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesBetweenSparse) {
   EXPECT_EQ(1, cache_->GetEntryCount());
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomEntriesBetweenSparse) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  base::Time start, end;
+  InitSparseCache(&start, &end);
+  DoomEntriesBetween(start, end);
+  EXPECT_EQ(3, cache_->GetEntryCount());
+
+  start = end;
+  end = base::Time::Now();
+  DoomEntriesBetween(start, end);
+  EXPECT_EQ(1, cache_->GetEntryCount());
+}
+
 TEST_F(DiskCacheBackendTest, DoomEntriesBetweenSparse) {
   base::Time start, end;
   InitSparseCache(&start, &end);
@@ -2894,11 +3018,392 @@ TEST_F(DiskCacheBackendTest, NewEvictionDoomAll) {
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, BlockfileV3DoomAll) {
+  SetBlockfileV3Mode();
+  BackendDoomAll();
+}
+
+// Tests that the entries of a cache that uses the previous version of the
+// blockfile format are imported by the version 3 backend.
+TEST_F(DiskCacheBackendTest, BlockfileV3UpgradeFromV2) {
+  InitCache();
+  const int kSize = 2000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  const int kNumEntries = 20;
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("the key %d", i);
+    ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer.get(), kSize, false));
+    EXPECT_EQ(i, WriteData(entry, 1, 0, buffer.get(), i, false));
+    entry->Close();
+  }
+  FlushQueueForTest();
+  cache_.reset();
+  cache_impl_ = NULL;
+
+  SetBlockfileV3Mode();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  EXPECT_TRUE(base::PathExists(cache_path_.AppendASCII("index_tb1")));
+  EXPECT_FALSE(base::PathExists(cache_path_.AppendASCII("old_v2")));
+
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("the key %d", i);
+    ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+    EXPECT_EQ(kSize, entry->GetDataSize(0));
+    EXPECT_EQ(i, entry->GetDataSize(1));
+    memset(buffer2->data(), 0, kSize);
+    EXPECT_EQ(kSize, ReadData(entry, 0, 0, buffer2.get(), kSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), buffer2->data(), kSize));
+    entry->Close();
+  }
+}
+
+// Tests that the index of the version 3 backend grows as needed, and that the
+// entries survive a restart.
+TEST_F(DiskCacheBackendTest, BlockfileV3GrowIndex) {
+  SetBlockfileV3Mode();
+  SetMaxSize(0x1000000);
+  InitCache();
+  int64 table_size;
+  ASSERT_TRUE(
+      base::GetFileSize(cache_path_.AppendASCII("index_tb2"), &table_size));
+
+  const int kNumEntries = 2500;
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("some key %d", i);
+    ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+    entry->Close();
+  }
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  FlushQueueForTest();
+
+  int64 new_table_size;
+  ASSERT_TRUE(
+      base::GetFileSize(cache_path_.AppendASCII("index_tb2"), &new_table_size));
+  EXPECT_LT(table_size, new_table_size);
+
+  cache_.reset();
+  cache_impl_v3_ = NULL;
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    std::string key = base::StringPrintf("some key %d", i);
+    ASSERT_EQ(net::OK, OpenEntry(key, &entry)) << key;
+    entry->Close();
+  }
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomAll) {
   SetMemoryOnlyMode();
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyDoomAll) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  BackendDoomAll();
+}
+
+// Entries that keep being used outlive a stream of entries that are only used
+// once, even though every one of those is more recent.
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyClockEviction) {
+  const int kEntrySize = 64 * 1024;
+  const int kMaxEntries = 64;
+  const int kNumHotEntries = 8;
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  SetMaxSize(kMaxEntries * kEntrySize);
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kEntrySize));
+  CacheTestFillBuffer(buffer->data(), kEntrySize, false);
+  disk_cache::Entry* entry;
+  // Until the cache is first full, the hands have not cleared any bits, and
+  // the entries that they find first are evicted whatever their use.
+  for (int i = 0; i < 2 * kMaxEntries; ++i) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("warm %d", i), &entry));
+    EXPECT_EQ(kEntrySize,
+              WriteData(entry, 0, 0, buffer.get(), kEntrySize, false));
+    entry->Close();
+  }
+
+  for (int i = 0; i < kNumHotEntries; ++i) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("hot %d", i), &entry));
+    EXPECT_EQ(kEntrySize,
+              WriteData(entry, 0, 0, buffer.get(), kEntrySize, false));
+    entry->Close();
+  }
+
+  for (int i = 0; i < 10 * kMaxEntries; ++i) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("cold %d", i), &entry));
+    EXPECT_EQ(kEntrySize,
+              WriteData(entry, 0, 0, buffer.get(), kEntrySize, false));
+    entry->Close();
+
+    for (int j = 0; j < kNumHotEntries; ++j) {
+      ASSERT_EQ(net::OK, OpenEntry(base::StringPrintf("hot %d", j), &entry));
+      EXPECT_EQ(1, ReadData(entry, 0, 0, buffer.get(), 1));
+      entry->Close();
+    }
+  }
+  EXPECT_GT(kMaxEntries, cache_->GetEntryCount());
+}
+
+namespace {
+
+// Creates, writes, reads back and dooms entries of its own on a thread, and
+// reads an entry that all the threads share.
+class ShardedMemoryCacheWorker : public base::DelegateSimpleThread::Delegate {
+ public:
+  ShardedMemoryCacheWorker(disk_cache::Backend* cache, int id)
+      : cache_(cache), id_(id), failures_(0) {}
+
+  int failures() const { return failures_; }
+
+  void Run() override {
+    const int kSize = 3000;
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+    scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize));
+    // The same data as that of the shared entry.
+    memset(buffer->data(), 'x', kSize);
+    const net::CompletionCallback callback;
+    for (int i = 0; i < 500; ++i) {
+      disk_cache::Entry* entry;
+      std::string key = base::StringPrintf("thread %d entry %d", id_, i);
+      if (cache_->CreateEntry(key, &entry, callback) != net::OK) {
+        ++failures_;
+        continue;
+      }
+      if (entry->WriteData(0, 0, buffer.get(), kSize, callback, false) !=
+              kSize ||
+          entry->ReadData(0, 0, read_buffer.get(), kSize, callback) != kSize ||
+          memcmp(buffer->data(), read_buffer->data(), kSize)) {
+        ++failures_;
+      }
+      if (i % 2)
+        entry->Doom();
+      entry->Close();
+
+      // The shared entry may have been evicted already.
+      if (cache_->OpenEntry("shared", &entry, callback) == net::OK) {
+        if (entry->ReadData(0, 0, read_buffer.get(), kSize, callback) !=
+                kSize ||
+            memcmp(buffer->data(), read_buffer->data(), kSize)) {
+          ++failures_;
+        }
+        entry->Close();
+      }
+    }
+  }
+
+ private:
+  disk_cache::Backend* cache_;
+  const int id_;
+  int failures_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedMemoryCacheWorker);
+};
+
+}  // namespace
+
+// Uses the sharded cache from several threads at once, while it evicts.
+TEST_F(DiskCacheBackendTest, ShardedMemoryOnlyThreads) {
+  const int kSize = 3000;
+  const int kNumThreads = 4;
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  SetMaxSize(100 * kSize);
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  memset(buffer->data(), 'x', kSize);
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("shared", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer.get(), kSize, false));
+  entry->Close();
+
+  ScopedVector<ShardedMemoryCacheWorker> workers;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    workers.push_back(new ShardedMemoryCacheWorker(cache_.get(), i));
+    threads.push_back(new base::DelegateSimpleThread(
+        workers[i], base::StringPrintf("ShardedMemoryCacheWorker%d", i)));
+  }
+  for (int i = 0; i < kNumThreads; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads[i]->Join();
+    EXPECT_EQ(0, workers[i]->failures());
+  }
+}
+
+// Tests that a snapshot of a memory cache brings back its entries, in order,
+// in another cache, without replacing the entries that are there already.
+TEST_F(DiskCacheBackendTest, MemoryOnlySnapshot) {
+  const int kSize = 1000;
+  SetMemoryOnlyMode();
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("first", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer1.get(), kSize, false));
+  EXPECT_EQ(kSize / 2, WriteData(entry, 1, 0, buffer1.get(), kSize / 2, false));
+  base::Time first_used = entry->GetLastUsed();
+  entry->Close();
+  AddDelay();
+  ASSERT_EQ(net::OK, CreateEntry("second", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 2, 0, buffer1.get(), kSize, false));
+  entry->Close();
+  ASSERT_EQ(net::OK, CreateEntry("sparse", &entry));
+  EXPECT_EQ(kSize, WriteSparseData(entry, 0, buffer1.get(), kSize));
+  entry->Close();
+  ASSERT_EQ(net::OK, CreateEntry("shared", &entry));
+  entry->Close();
+
+  base::FilePath path = cache_path_.AppendASCII("snapshot");
+  net::TestCompletionCallback cb;
+  mem_cache_->SaveSnapshot(path, 1024 * 1024,
+                           base::ThreadTaskRunnerHandle::Get(), cb.callback());
+  ASSERT_EQ(net::OK, cb.WaitForResult());
+
+  scoped_ptr<disk_cache::MemBackendImpl> cache(
+      new disk_cache::MemBackendImpl(NULL));
+  ASSERT_TRUE(cache->Init());
+  ASSERT_EQ(net::OK, cache->CreateEntry("shared", &entry, cb.callback()));
+  entry->Close();
+  ASSERT_EQ(net::OK, cache->CreateEntry("new", &entry, cb.callback()));
+  entry->Close();
+  cache->LoadSnapshot(path, 1024 * 1024, base::ThreadTaskRunnerHandle::Get(),
+                      cb.callback());
+  EXPECT_EQ(2, cb.WaitForResult());
+  EXPECT_EQ(4, cache->GetEntryCount());
+
+  // The entries of the snapshot rank below the ones that were in the cache.
+  const char* const kKeys[] = { "new", "shared", "second", "first" };
+  scoped_ptr<disk_cache::Backend::Iterator> iter = cache->CreateIterator();
+  for (size_t i = 0; i < arraysize(kKeys); i++) {
+    ASSERT_EQ(net::OK, iter->OpenNextEntry(&entry, cb.callback()));
+    EXPECT_EQ(kKeys[i], entry->GetKey());
+    entry->Close();
+  }
+  EXPECT_NE(net::OK, iter->OpenNextEntry(&entry, cb.callback()));
+
+  ASSERT_EQ(net::OK, cache->OpenEntry("first", &entry, cb.callback()));
+  EXPECT_EQ(kSize, entry->GetDataSize(0));
+  EXPECT_EQ(kSize / 2, entry->GetDataSize(1));
+  EXPECT_EQ(0, entry->GetDataSize(2));
+  EXPECT_TRUE(first_used == entry->GetLastUsed());
+  EXPECT_EQ(kSize, entry->ReadData(0, 0, buffer2.get(), kSize, cb.callback()));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+}
+
+// Tests that a snapshot only keeps the entries that were used most recently
+// when they do not all fit.
+TEST_F(DiskCacheBackendTest, MemoryOnlySnapshotSizeLimit) {
+  const int kSize = 1000;
+  const int kNumEntries = 10;
+  SetMemoryOnlyMode();
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(base::IntToString(i), &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+    entry->Close();
+  }
+
+  base::FilePath path = cache_path_.AppendASCII("snapshot");
+  net::TestCompletionCallback cb;
+  mem_cache_->SaveSnapshot(path, 3 * kSize + kSize / 2,
+                           base::ThreadTaskRunnerHandle::Get(), cb.callback());
+  ASSERT_EQ(net::OK, cb.WaitForResult());
+  int64 file_size;
+  ASSERT_TRUE(base::GetFileSize(path, &file_size));
+  EXPECT_GE(3 * kSize + kSize / 2, file_size);
+
+  // A smaller limit on the way back ignores the file.
+  scoped_ptr<disk_cache::MemBackendImpl> cache(
+      new disk_cache::MemBackendImpl(NULL));
+  ASSERT_TRUE(cache->Init());
+  cache->LoadSnapshot(path, kSize, base::ThreadTaskRunnerHandle::Get(),
+                      cb.callback());
+  EXPECT_EQ(net::ERR_FAILED, cb.WaitForResult());
+  EXPECT_EQ(0, cache->GetEntryCount());
+
+  cache->LoadSnapshot(path, 3 * kSize + kSize / 2,
+                      base::ThreadTaskRunnerHandle::Get(), cb.callback());
+  EXPECT_EQ(3, cb.WaitForResult());
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    int rv = cache->OpenEntry(base::IntToString(i), &entry, cb.callback());
+    if (i < kNumEntries - 3) {
+      EXPECT_NE(net::OK, rv);
+      continue;
+    }
+    ASSERT_EQ(net::OK, rv);
+    EXPECT_EQ(kSize, entry->GetDataSize(1));
+    entry->Close();
+  }
+}
+
+// Tests that a cache with snapshots enabled saves one when it goes away, and
+// that the next one starts with its entries.
+TEST_F(DiskCacheBackendTest, MemoryOnlyEnableSnapshots) {
+  const int kSize = 1000;
+  const int kMaxBytes = 1024 * 1024;
+  SetMemoryOnlyMode();
+  InitCache();
+
+  base::FilePath path = cache_path_.AppendASCII("snapshot");
+  mem_cache_->EnableSnapshots(path, kMaxBytes,
+                              base::ThreadTaskRunnerHandle::Get(),
+                              base::TimeDelta());
+  base::RunLoop().RunUntilIdle();
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("the first key", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer.get(), kSize, false));
+  entry->Close();
+
+  cache_.reset();
+  mem_cache_ = NULL;
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(base::PathExists(path));
+
+  scoped_ptr<disk_cache::MemBackendImpl> cache(
+      new disk_cache::MemBackendImpl(NULL));
+  ASSERT_TRUE(cache->Init());
+  cache->EnableSnapshots(path, kMaxBytes, base::ThreadTaskRunnerHandle::Get(),
+                         base::TimeDelta());
+  EXPECT_EQ(0, cache->GetEntryCount());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, cache->GetEntryCount());
+
+  net::TestCompletionCallback cb;
+  ASSERT_EQ(net::OK, cache->OpenEntry("the first key", &entry, cb.callback()));
+  EXPECT_EQ(kSize, entry->GetDataSize(0));
+  entry->Close();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheOnlyDoomAll) {
   SetCacheType(net::APP_CACHE);
   BackendDoomAll();
@@ -4,22 +4,29 @@
 
 #include "net/disk_cache/blockfile/backend_impl_v3.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/bits.h"
+#include "base/files/file.h"
+#include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/hash.h"
 #include "base/message_loop/message_loop.h"
-#include "base/metrics/field_trial.h"
 #include "base/metrics/histogram.h"
-#include "base/rand_util.h"
+#include "base/single_thread_task_runner.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/sys_info.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
+#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
+#include "net/disk_cache/blockfile/backend_worker_v3.h"
 #include "net/disk_cache/blockfile/disk_format_v3.h"
 #include "net/disk_cache/blockfile/entry_impl_v3.h"
 #include "net/disk_cache/blockfile/errors.h"
@@ -27,7 +34,9 @@
 #include "net/disk_cache/blockfile/file.h"
 #include "net/disk_cache/blockfile/histogram_macros_v3.h"
 #include "net/disk_cache/blockfile/index_table_v3.h"
+#include "net/disk_cache/blockfile/mapped_file.h"
 #include "net/disk_cache/blockfile/storage_block-inl.h"
+#include "net/disk_cache/blockfile/v2_cache_reader.h"
 #include "net/disk_cache/cache_util.h"
 
 // Provide a BackendImpl object to macros from histogram_macros.h.
@@ -39,12 +48,81 @@ using base::TimeTicks;
 
 namespace {
 
-#if defined(V3_NOT_JUST_YET_READY)
-const int kDefaultCacheSize = 80 * 1024 * 1024;
+const char kIndexName[] = "index";
+const char kMainTableName[] = "index_tb1";
+const char kExtraTableName[] = "index_tb2";
+const char kBackupName[] = "index_bk";
+
+// Folder that holds the files of a cache from the previous version while its
+// entries are imported.
+const char kOldCacheName[] = "old_v2";
 
 // Avoid trimming the cache for the first 5 minutes (10 timer ticks).
 const int kTrimDelay = 10;
-#endif  // defined(V3_NOT_JUST_YET_READY).
+
+// The index is created with a main table of kBaseTableLen cells, and half of
+// that for the extra table. A cell stores up to 22 bits of location, so the
+// whole table must stay under 4M cells.
+const int kInitialTableLen = disk_cache::kBaseTableLen +
+                             disk_cache::kBaseTableLen / 2;
+const int kMaxMainTableLen = 1 << 21;
+const int kMaxTableLen = kMaxMainTableLen * 2;
+
+// Small tables (see IndexCell) hold up to 64K cells.
+const int kMaxSmallTableBits = 16;
+
+// The header and bitmap are sized for the largest table, so the header never
+// moves while the cache is running.
+const size_t kIndexFileSize = sizeof(disk_cache::IndexHeaderV3) +
+                              kMaxTableLen / 8;
+
+// Returns the number of cells of the main table for a given table_len.
+int MainTableLen(int table_len) {
+  return 1 << base::bits::Log2Floor(table_len);
+}
+
+// Returns the size of the file that stores |num_cells| cells.
+size_t TableSize(int num_cells) {
+  return num_cells / disk_cache::kCellsPerBucket *
+         sizeof(disk_cache::IndexBucket);
+}
+
+// Maps the first |size| bytes of the file |name|. If |extend| is true, the
+// file is created or extended as needed, otherwise it must already be big
+// enough.
+scoped_refptr<disk_cache::MappedFile> MapFile(const base::FilePath& name,
+                                              size_t size, bool extend) {
+  if (extend) {
+    int flags = base::File::FLAG_OPEN_ALWAYS | base::File::FLAG_READ |
+                base::File::FLAG_WRITE;
+    base::File file(name, flags);
+    if (!file.IsValid())
+      return NULL;
+
+    if (file.GetLength() < static_cast<int64>(size) && !file.SetLength(size))
+      return NULL;
+  } else {
+    int64 file_size;
+    if (!base::GetFileSize(name, &file_size) ||
+        file_size < static_cast<int64>(size)) {
+      return NULL;
+    }
+  }
+
+  scoped_refptr<disk_cache::MappedFile> file(new disk_cache::MappedFile());
+  if (!file->Init(name, size))
+    return NULL;
+  return file;
+}
+
+int NoOperation() {
+  return net::OK;
+}
+
+int RunTask(const base::Closure& task) {
+  task.Run();
+  return net::OK;
+}
 
 }  // namespace
 
@@ -52,14 +130,34 @@ const int kTrimDelay = 10;
 
 namespace disk_cache {
 
+// The state of an enumeration of the cache. Entries are returned from the most
+// recently used to the least recently used, one group of cells (that share the
+// same timestamp) at a time.
+struct BackendImplV3::Enumeration {
+  Enumeration() : current(0) {
+    iterator.forward = false;
+    iterator.timestamp = kint32max;
+  }
+
+  IndexIterator iterator;
+  CellList cells;
+  size_t current;
+};
+
 BackendImplV3::BackendImplV3(
     const base::FilePath& path,
     const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
     net::NetLog* net_log)
-    : index_(NULL),
+    : index_(this),
       path_(path),
-      block_files_(),
+      block_files_(path),
       max_size_(0),
+      num_refs_(0),
+      max_refs_(0),
+      num_pending_io_(0),
+      entry_count_(0),
+      byte_count_(0),
+      buffer_bytes_(0),
       up_ticks_(0),
       cache_type_(net::DISK_CACHE),
       uma_report_(0),
@@ -71,19 +169,40 @@ BackendImplV3::BackendImplV3(
       lru_eviction_(true),
       first_timer_(true),
       user_load_(false),
+      grow_pending_(false),
       net_log_(net_log),
+      worker_(new Worker(cache_thread)),
+      done_(true, false),
       ptr_factory_(this) {
+  block_files_.SetV3Format();
 }
 
 BackendImplV3::~BackendImplV3() {
-  CleanupCache();
+  if (user_flags_ & BASIC_UNIT_TEST) {
+    worker_->WaitForPendingIO();
+  } else {
+    // This is most likely not needed at this time because we have already
+    // created the cache and the threads are going away, but it is better to
+    // be safe than sorry.
+    worker_->DropPendingIO();
+  }
+
+  if (worker_->BackgroundIsCurrentThread()) {
+    // Unit tests may use the same thread for everything.
+    CleanupCache();
+  } else {
+    worker_->PostTask(base::Bind(&BackendImplV3::CleanupCache,
+                                 base::Unretained(this)));
+    // http://crbug.com/74623
+    base::ThreadRestrictions::ScopedAllowWait allow_wait;
+    done_.Wait();
+  }
 }
 
 int BackendImplV3::Init(const CompletionCallback& callback) {
   DCHECK(!init_);
-  if (init_)
-    return net::ERR_FAILED;
-
+  worker_->PostOperation(
+      base::Bind(&BackendImplV3::SyncInit, base::Unretained(this)), callback);
   return net::ERR_IO_PENDING;
 }
 
@@ -115,44 +234,258 @@ void BackendImplV3::SetType(net::CacheType type) {
 
 bool BackendImplV3::CreateBlock(FileType block_type, int block_count,
                                 Addr* block_address) {
+  if (disabled_)
+    return false;
   return block_files_.CreateBlock(block_type, block_count, block_address);
 }
 
-#if defined(V3_NOT_JUST_YET_READY)
+void BackendImplV3::DeleteBlock(Addr block_address, bool deep) {
+  if (disabled_)
+    return;
+  block_files_.DeleteBlock(block_address, deep);
+}
+
+MappedFile* BackendImplV3::File(Addr address) {
+  if (disabled_)
+    return NULL;
+  return block_files_.GetFile(address);
+}
+
+base::FilePath BackendImplV3::GetFileName(Addr address) const {
+  if (!address.is_separate_file() || !address.is_initialized()) {
+    NOTREACHED();
+    return base::FilePath();
+  }
+
+  std::string tmp = base::StringPrintf("f_%06x", address.FileNumber());
+  return path_.AppendASCII(tmp);
+}
+
+bool BackendImplV3::CreateExternalFile(Addr* address) {
+  IndexHeaderV3* header = index_.header();
+  int file_number = header->last_file + 1;
+  Addr file_address(0);
+  bool success = false;
+  for (int i = 0; i < 0x0fffffff; i++, file_number++) {
+    if (!file_address.SetFileNumber(file_number)) {
+      file_number = 1;
+      continue;
+    }
+    base::FilePath name = GetFileName(file_address);
+    int flags = base::File::FLAG_READ | base::File::FLAG_WRITE |
+                base::File::FLAG_CREATE | base::File::FLAG_EXCLUSIVE_WRITE;
+    base::File file(name, flags);
+    if (!file.IsValid()) {
+      base::File::Error error = file.error_details();
+      if (error != base::File::FILE_ERROR_EXISTS) {
+        LOG(ERROR) << "Unable to create file: " << error;
+        return false;
+      }
+      continue;
+    }
+
+    success = true;
+    break;
+  }
+
+  DCHECK(success);
+  if (!success)
+    return false;
+
+  header->last_file = file_number;
+  address->set_value(file_address.value());
+  return true;
+}
+
+EntryImplV3* BackendImplV3::OpenEntryImpl(const std::string& key) {
+  if (disabled_)
+    return NULL;
+
+  TimeTicks start = TimeTicks::Now();
+  uint32 hash = base::Hash(key);
+  Trace("Open hash 0x%x", hash);
+
+  EntryImplV3* cache_entry = LookupEntry(key, hash);
+
+  int current_size = index_.header()->num_bytes / (1024 * 1024);
+  int64 total_hours = stats_.GetCounter(Stats::TIMER) / 120;
+  int64 no_use_hours = stats_.GetCounter(Stats::LAST_REPORT_TIMER) / 120;
+  int64 use_hours = total_hours - no_use_hours;
+
+  if (!cache_entry) {
+    CACHE_UMA(AGE_MS, "OpenTime.Miss", start);
+    CACHE_UMA(COUNTS_10000, "AllOpenBySize.Miss", current_size);
+    CACHE_UMA(HOURS, "AllOpenByTotalHours.Miss",
+              static_cast<base::HistogramBase::Sample>(total_hours));
+    CACHE_UMA(HOURS, "AllOpenByUseHours.Miss",
+              static_cast<base::HistogramBase::Sample>(use_hours));
+    stats_.OnEvent(Stats::OPEN_MISS);
+    return NULL;
+  }
+
+  eviction_.OnOpenEntry(cache_entry);
+  entry_count_++;
+
+  Trace("Open hash 0x%x end: 0x%x", hash,
+        cache_entry->entry()->address().value());
+  CACHE_UMA(AGE_MS, "OpenTime", start);
+  CACHE_UMA(COUNTS_10000, "AllOpenBySize.Hit", current_size);
+  CACHE_UMA(HOURS, "AllOpenByTotalHours.Hit",
+            static_cast<base::HistogramBase::Sample>(total_hours));
+  CACHE_UMA(HOURS, "AllOpenByUseHours.Hit",
+            static_cast<base::HistogramBase::Sample>(use_hours));
+  stats_.OnEvent(Stats::OPEN_HIT);
+  return cache_entry;
+}
+
+EntryImplV3* BackendImplV3::CreateEntryImpl(const std::string& key) {
+  if (disabled_ || key.empty())
+    return NULL;
+
+  TimeTicks start = TimeTicks::Now();
+  uint32 hash = base::Hash(key);
+  Trace("Create hash 0x%x", hash);
+
+  EntryImplV3* old_entry = LookupEntry(key, hash);
+  if (old_entry) {
+    old_entry->Release();
+    stats_.OnEvent(Stats::CREATE_MISS);
+    Trace("create entry miss ");
+    return NULL;
+  }
+
+  // The index may have been waiting for more room.
+  if (grow_pending_)
+    GrowIndexNow();
+
+  // The general flow is to allocate the entry record and create the cell that
+  // points to it (in the NEW state), followed by saving the record to disk.
+  // If there is a crash in this process, the cell will not be in the USED
+  // state so the entry will be discarded when found.
+  Addr entry_address;
+  if (!block_files_.CreateBlock(BLOCK_ENTRIES, 1, &entry_address)) {
+    LOG(ERROR) << "Create entry failed " << key.c_str();
+    stats_.OnEvent(Stats::CREATE_ERROR);
+    return NULL;
+  }
+
+  // A small table can only reference records from the first entries file.
+  bool valid_cell = false;
+  if (!(index_.header()->flags & SMALL_CACHE) ||
+      entry_address.FileNumber() == BLOCK_ENTRIES - 1) {
+    valid_cell = index_.CreateEntryCell(hash, entry_address).IsValid();
+    if (!valid_cell) {
+      // The index is full, so it has to grow right now.
+      GrowIndexNow();
+      valid_cell = index_.CreateEntryCell(hash, entry_address).IsValid();
+    }
+  }
+
+  if (!valid_cell) {
+    block_files_.DeleteBlock(entry_address, false);
+    LOG(ERROR) << "Create entry failed " << key.c_str();
+    stats_.OnEvent(Stats::CREATE_ERROR);
+    return NULL;
+  }
+
+  scoped_refptr<EntryImplV3> cache_entry(
+      new EntryImplV3(this, entry_address, false));
+  IncreaseNumRefs();
+
+  if (!cache_entry->CreateEntry(key, hash)) {
+    // The entry never made it to the index, so closing it has no effect there.
+    index_.SetSate(hash, entry_address, ENTRY_DELETED);
+    index_.SetSate(hash, entry_address, ENTRY_FREE);
+    cache_entry = NULL;
+    block_files_.DeleteBlock(entry_address, true);
+    LOG(ERROR) << "Create entry failed " << key.c_str();
+    stats_.OnEvent(Stats::CREATE_ERROR);
+    return NULL;
+  }
+
+  cache_entry->BeginLogging(net_log_, true);
+
+  // We are not failing the operation; let's add this to the map.
+  open_entries_[entry_address.value()] = cache_entry.get();
+
+  // Save the entry. A new entry is always modified, so the first write doesn't
+  // have to update the index.
+  cache_entry->set_modified();
+  cache_entry->entry()->Store();
+  IncreaseNumEntries();
+  entry_count_++;
+  index_.UpdateTime(hash, entry_address, Time::Now());
+
+  CACHE_UMA(AGE_MS, "CreateTime", start);
+  stats_.OnEvent(Stats::CREATE_HIT);
+  Trace("create entry hit ");
+  cache_entry->AddRef();
+  return cache_entry.get();
+}
+
+int BackendImplV3::SyncDoomEntry(const std::string& key) {
+  if (disabled_)
+    return net::ERR_FAILED;
+
+  EntryImplV3* entry = OpenEntryImpl(key);
+  if (!entry)
+    return net::ERR_FAILED;
+
+  entry->DoomImpl();
+  entry->Release();
+  return net::OK;
+}
+
 void BackendImplV3::UpdateRank(EntryImplV3* entry, bool modified) {
-  if (read_only_ || (!modified && cache_type() == net::SHADER_CACHE))
+  if (disabled_)
+    return;
+
+  // A read-only cache still has to track modifications to its entries, because
+  // they have to be discarded if we crash before the entry is closed.
+  if (!modified && (read_only_ || cache_type() == net::SHADER_CACHE))
     return;
   eviction_.UpdateRank(entry, modified);
 }
 
 void BackendImplV3::InternalDoomEntry(EntryImplV3* entry) {
   uint32 hash = entry->GetHash();
-  std::string key = entry->GetKey();
-  Addr entry_addr = entry->entry()->address();
-  bool error;
-  EntryImpl* parent_entry = MatchEntry(key, hash, true, entry_addr, &error);
-  CacheAddr child(entry->GetNextAddress());
-
+  Addr address = entry->entry()->address();
   Trace("Doom entry 0x%p", entry);
 
-  if (!entry->doomed()) {
-    // We may have doomed this entry from within MatchEntry.
-    eviction_.OnDoomEntry(entry);
-    entry->InternalDoom();
-    if (!new_eviction_) {
+  if (!disabled_) {
+    EntryCell cell = index_.FindEntryCell(hash, address);
+    if (cell.IsValid()) {
+      if (cell.GetState() == ENTRY_USED)
+        index_.SetSate(hash, address, ENTRY_OPEN);
+      index_.SetSate(hash, address, ENTRY_DELETED);
       DecreaseNumEntries();
     }
-    stats_.OnEvent(Stats::DOOM_ENTRY);
   }
 
-  if (parent_entry) {
-    parent_entry->SetNextAddress(Addr(child));
-    parent_entry->Release();
-  } else if (!error) {
-    data_->table[hash & mask_] = child;
-  }
+  entry->InternalDoom();
+  stats_.OnEvent(Stats::DOOM_ENTRY);
+}
+
+void BackendImplV3::OnEntryClosed(EntryImplV3* entry) {
+  if (disabled_)
+    return;
+
+  uint32 hash = entry->GetHash();
+  Addr address = entry->entry()->address();
+  EntryCell cell = index_.FindEntryCell(hash, address);
+  if (!cell.IsValid())
+    return;
+
+  EntryState state = cell.GetState();
+  if (state == ENTRY_NEW || state == ENTRY_OPEN || state == ENTRY_MODIFIED)
+    index_.SetSate(hash, address, ENTRY_USED);
+}
+
+void BackendImplV3::RemoveEntry(EntryImplV3* entry) {
+  if (disabled_)
+    return;
 
-  FlushIndex();
+  index_.SetSate(entry->GetHash(), entry->entry()->address(), ENTRY_FREE);
 }
 
 void BackendImplV3::OnEntryDestroyBegin(Addr address) {
@@ -163,15 +496,17 @@ void BackendImplV3::OnEntryDestroyBegin(Addr address) {
 
 void BackendImplV3::OnEntryDestroyEnd() {
   DecreaseNumRefs();
-  if (data_->header.num_bytes > max_size_ && !read_only_ &&
-      (up_ticks_ > kTrimDelay || user_flags_ & kNoRandom))
+  if (disabled_)
+    return;
+
+  if (index_.header()->num_bytes > max_size_ && !read_only_ &&
+      (up_ticks_ > kTrimDelay || user_flags_ & BASIC_UNIT_TEST)) {
     eviction_.TrimCache(false);
+  }
 }
 
 EntryImplV3* BackendImplV3::GetOpenEntry(Addr address) const {
-  DCHECK(rankings->HasData());
-  EntriesMap::const_iterator it =
-      open_entries_.find(rankings->Data()->contents);
+  EntriesMap::const_iterator it = open_entries_.find(address.value());
   if (it != open_entries_.end()) {
     // We have this entry in memory.
     return it->second;
@@ -181,7 +516,7 @@ EntryImplV3* BackendImplV3::GetOpenEntry(Addr address) const {
 }
 
 int BackendImplV3::MaxFileSize() const {
-  return max_size_ / 8;
+  return cache_type() == net::PNACL_CACHE ? max_size_ : max_size_ / 8;
 }
 
 void BackendImplV3::ModifyStorageSize(int32 old_size, int32 new_size) {
@@ -213,7 +548,6 @@ bool BackendImplV3::IsAllocAllowed(int current_size, int new_size) {
   CACHE_UMA(COUNTS_50000, "BufferBytes", buffer_bytes_ / 1024);
   return true;
 }
-#endif  // defined(V3_NOT_JUST_YET_READY).
 
 void BackendImplV3::BufferDeleted(int size) {
   DCHECK_GE(size, 0);
@@ -221,6 +555,14 @@ void BackendImplV3::BufferDeleted(int size) {
   DCHECK_GE(buffer_bytes_, 0);
 }
 
+void BackendImplV3::IncrementIoCount() {
+  num_pending_io_++;
+}
+
+void BackendImplV3::DecrementIoCount() {
+  num_pending_io_--;
+}
+
 bool BackendImplV3::IsLoaded() const {
   if (user_flags_ & NO_LOAD_PROTECTION)
     return false;
@@ -230,7 +572,7 @@ bool BackendImplV3::IsLoaded() const {
 
 std::string BackendImplV3::HistogramName(const char* name) const {
   static const char* const names[] = {
-    "Http", "", "Media", "AppCache", "Shader" };
+    "Http", "", "Media", "AppCache", "Shader", "Pnacl" };
   DCHECK_NE(cache_type_, net::MEMORY_CACHE);
   return base::StringPrintf("DiskCache3.%s_%s", name, names[cache_type_]);
 }
@@ -239,7 +581,6 @@ base::WeakPtr<BackendImplV3> BackendImplV3::GetWeakPtr() {
   return ptr_factory_.GetWeakPtr();
 }
 
-#if defined(V3_NOT_JUST_YET_READY)
 // We want to remove biases from some histograms so we only send data once per
 // week.
 bool BackendImplV3::ShouldReportAgain() {
@@ -282,7 +623,8 @@ void BackendImplV3::FirstEviction() {
   CACHE_UMA(COUNTS, "FirstEntrySize", avg_size);
 
   int large_entries_bytes = stats_.GetLargeEntriesSize();
-  int large_ratio = large_entries_bytes * 100 / header->num_bytes;
+  int large_ratio = header->num_bytes ?
+                    large_entries_bytes * 100 / header->num_bytes : 0;
   CACHE_UMA(PERCENTAGE, "FirstLargeEntriesRatio", large_ratio);
 
   if (!lru_eviction_) {
@@ -315,6 +657,9 @@ void BackendImplV3::OnWrite(int32 bytes) {
 }
 
 void BackendImplV3::OnTimerTick() {
+  if (disabled_)
+    return;
+
   stats_.OnEvent(Stats::TIMER);
   int64 time = stats_.GetCounter(Stats::TIMER);
   int64 current = stats_.GetCounter(Stats::OPEN_ENTRIES);
@@ -341,8 +686,6 @@ void BackendImplV3::OnTimerTick() {
   byte_count_ = 0;
   up_ticks_++;
 
-  if (!data_)
-    first_timer_ = false;
   if (first_timer_) {
     first_timer_ = false;
     if (ShouldReportAgain())
@@ -352,6 +695,9 @@ void BackendImplV3::OnTimerTick() {
   // Save stats to disk at 5 min intervals.
   if (time % 10 == 0)
     StoreStats();
+
+  // The index takes care of saving its backup only when it changes.
+  index_.OnBackupTimer();
 }
 
 void BackendImplV3::SetUnitTestMode() {
@@ -373,42 +719,19 @@ void BackendImplV3::SetFlags(uint32 flags) {
 }
 
 int BackendImplV3::FlushQueueForTest(const CompletionCallback& callback) {
-  background_queue_.FlushQueue(callback);
+  worker_->PostOperation(base::Bind(&NoOperation), callback);
   return net::ERR_IO_PENDING;
 }
 
-void BackendImplV3::TrimForTest(bool empty) {
-  eviction_.SetTestMode();
-  eviction_.TrimCache(empty);
+int BackendImplV3::RunTaskForTest(const base::Closure& task,
+                                  const CompletionCallback& callback) {
+  worker_->PostOperation(base::Bind(&RunTask, task), callback);
+  return net::ERR_IO_PENDING;
 }
 
-void BackendImplV3::TrimDeletedListForTest(bool empty) {
+void BackendImplV3::TrimForTest(bool empty) {
   eviction_.SetTestMode();
-  eviction_.TrimDeletedList(empty);
-}
-
-int BackendImplV3::SelfCheck() {
-  if (!init_) {
-    LOG(ERROR) << "Init failed";
-    return ERR_INIT_FAILED;
-  }
-
-  int num_entries = rankings_.SelfCheck();
-  if (num_entries < 0) {
-    LOG(ERROR) << "Invalid rankings list, error " << num_entries;
-#if !defined(NET_BUILD_STRESS_CACHE)
-    return num_entries;
-#endif
-  }
-
-  if (num_entries != data_->header.num_entries) {
-    LOG(ERROR) << "Number of entries mismatch";
-#if !defined(NET_BUILD_STRESS_CACHE)
-    return ERR_NUM_ENTRIES_MISMATCH;
-#endif
-  }
-
-  return CheckAllEntries();
+  eviction_.TrimCache(empty);
 }
 
 // ------------------------------------------------------------------------
@@ -418,189 +741,319 @@ net::CacheType BackendImplV3::GetCacheType() const {
 }
 
 int32 BackendImplV3::GetEntryCount() const {
-  if (disabled_)
+  // The header of the index doesn't move once the cache is initialized.
+  if (disabled_ || !index_.header())
     return 0;
-  DCHECK(init_);
   return index_.header()->num_entries;
 }
 
 int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
                              const CompletionCallback& callback) {
-  if (disabled_)
-    return NULL;
-
-  TimeTicks start = TimeTicks::Now();
-  uint32 hash = base::Hash(key);
-  Trace("Open hash 0x%x", hash);
-
-  bool error;
-  EntryImpl* cache_entry = MatchEntry(key, hash, false, Addr(), &error);
-  if (cache_entry && ENTRY_NORMAL != cache_entry->entry()->Data()->state) {
-    // The entry was already evicted.
-    cache_entry->Release();
-    cache_entry = NULL;
-  }
+  DCHECK(!callback.is_null());
+  worker_->PostEntryOperation(
+      base::Bind(&BackendImplV3::SyncOpenEntry, base::Unretained(this), key,
+                 entry),
+      entry, callback);
+  return net::ERR_IO_PENDING;
+}
 
-  int current_size = data_->header.num_bytes / (1024 * 1024);
-  int64 total_hours = stats_.GetCounter(Stats::TIMER) / 120;
-  int64 no_use_hours = stats_.GetCounter(Stats::LAST_REPORT_TIMER) / 120;
-  int64 use_hours = total_hours - no_use_hours;
+int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
+                               const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  worker_->PostEntryOperation(
+      base::Bind(&BackendImplV3::SyncCreateEntry, base::Unretained(this), key,
+                 entry),
+      entry, callback);
+  return net::ERR_IO_PENDING;
+}
 
-  if (!cache_entry) {
-    CACHE_UMA(AGE_MS, "OpenTime.Miss", 0, start);
-    CACHE_UMA(COUNTS_10000, "AllOpenBySize.Miss", 0, current_size);
-    CACHE_UMA(HOURS, "AllOpenByTotalHours.Miss", 0, total_hours);
-    CACHE_UMA(HOURS, "AllOpenByUseHours.Miss", 0, use_hours);
-    stats_.OnEvent(Stats::OPEN_MISS);
-    return NULL;
-  }
+int BackendImplV3::DoomEntry(const std::string& key,
+                             const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  worker_->PostOperation(
+      base::Bind(&BackendImplV3::SyncDoomEntry, base::Unretained(this), key),
+      callback);
+  return net::ERR_IO_PENDING;
+}
 
-  eviction_.OnOpenEntry(cache_entry);
-  entry_count_++;
+int BackendImplV3::DoomAllEntries(const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  worker_->PostOperation(
+      base::Bind(&BackendImplV3::SyncDoomAllEntries, base::Unretained(this)),
+      callback);
+  return net::ERR_IO_PENDING;
+}
 
-  Trace("Open hash 0x%x end: 0x%x", hash,
-        cache_entry->entry()->address().value());
-  CACHE_UMA(AGE_MS, "OpenTime", 0, start);
-  CACHE_UMA(COUNTS_10000, "AllOpenBySize.Hit", 0, current_size);
-  CACHE_UMA(HOURS, "AllOpenByTotalHours.Hit", 0, total_hours);
-  CACHE_UMA(HOURS, "AllOpenByUseHours.Hit", 0, use_hours);
-  stats_.OnEvent(Stats::OPEN_HIT);
-  SIMPLE_STATS_COUNTER("disk_cache.hit");
-  return cache_entry;
+int BackendImplV3::DoomEntriesBetween(base::Time initial_time,
+                                      base::Time end_time,
+                                      const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  worker_->PostOperation(
+      base::Bind(&BackendImplV3::SyncDoomEntriesBetween,
+                 base::Unretained(this), initial_time, end_time),
+      callback);
+  return net::ERR_IO_PENDING;
 }
 
-int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
-                               const CompletionCallback& callback) {
-  if (disabled_ || key.empty())
-    return NULL;
+int BackendImplV3::DoomEntriesSince(base::Time initial_time,
+                                    const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  worker_->PostOperation(
+      base::Bind(&BackendImplV3::SyncDoomEntriesSince, base::Unretained(this),
+                 initial_time),
+      callback);
+  return net::ERR_IO_PENDING;
+}
 
-  TimeTicks start = TimeTicks::Now();
-  Trace("Create hash 0x%x", hash);
+class BackendImplV3::IteratorImpl : public Backend::Iterator {
+ public:
+  IteratorImpl(BackendImplV3* backend, base::WeakPtr<Worker> worker)
+      : backend_(backend),
+        worker_(worker),
+        enumeration_(new Enumeration) {
+  }
 
-  scoped_refptr<EntryImpl> parent;
-  Addr entry_address(data_->table[hash & mask_]);
-  if (entry_address.is_initialized()) {
-    // We have an entry already. It could be the one we are looking for, or just
-    // a hash conflict.
-    bool error;
-    EntryImpl* old_entry = MatchEntry(key, hash, false, Addr(), &error);
-    if (old_entry)
-      return ResurrectEntry(old_entry);
-
-    EntryImpl* parent_entry = MatchEntry(key, hash, true, Addr(), &error);
-    DCHECK(!error);
-    if (parent_entry) {
-      parent.swap(&parent_entry);
-    } else if (data_->table[hash & mask_]) {
-      // We should have corrected the problem.
-      NOTREACHED();
-      return NULL;
+  ~IteratorImpl() override {
+    // The enumeration is only used on the cache thread.
+    if (worker_) {
+      worker_->PostTask(base::Bind(&base::DeletePointer<Enumeration>,
+                                   enumeration_.release()));
     }
   }
 
-  // The general flow is to allocate disk space and initialize the entry data,
-  // followed by saving that to disk, then linking the entry though the index
-  // and finally through the lists. If there is a crash in this process, we may
-  // end up with:
-  // a. Used, unreferenced empty blocks on disk (basically just garbage).
-  // b. Used, unreferenced but meaningful data on disk (more garbage).
-  // c. A fully formed entry, reachable only through the index.
-  // d. A fully formed entry, also reachable through the lists, but still dirty.
-  //
-  // Anything after (b) can be automatically cleaned up. We may consider saving
-  // the current operation (as we do while manipulating the lists) so that we
-  // can detect and cleanup (a) and (b).
-
-  int num_blocks = EntryImpl::NumBlocksForEntry(key.size());
-  if (!block_files_.CreateBlock(BLOCK_256, num_blocks, &entry_address)) {
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+  int OpenNextEntry(Entry** next_entry,
+                    const net::CompletionCallback& callback) override {
+    if (!worker_)
+      return net::ERR_FAILED;
+    worker_->PostEntryOperation(
+        base::Bind(&BackendImplV3::SyncOpenNextEntry,
+                   base::Unretained(backend_), enumeration_.get(), next_entry),
+        next_entry, callback);
+    return net::ERR_IO_PENDING;
   }
 
-  Addr node_address(0);
-  if (!block_files_.CreateBlock(RANKINGS, 1, &node_address)) {
-    block_files_.DeleteBlock(entry_address, false);
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+ private:
+  BackendImplV3* const backend_;  // Valid while |worker_| is alive.
+  const base::WeakPtr<Worker> worker_;
+  scoped_ptr<Enumeration> enumeration_;
+};
+
+scoped_ptr<Backend::Iterator> BackendImplV3::CreateIterator() {
+  return scoped_ptr<Backend::Iterator>(
+      new IteratorImpl(this, worker_->GetWeakPtr()));
+}
+
+void BackendImplV3::GetStats(StatsItems* stats) {
+  if (disabled_ || !index_.header())
+    return;
+
+  std::pair<std::string, std::string> item;
+
+  item.first = "Entries";
+  item.second = base::StringPrintf("%d", index_.header()->num_entries);
+  stats->push_back(item);
+
+  item.first = "Pending IO";
+  item.second = base::StringPrintf("%d", num_pending_io_);
+  stats->push_back(item);
+
+  item.first = "Max size";
+  item.second = base::StringPrintf("%d", max_size_);
+  stats->push_back(item);
+
+  item.first = "Current size";
+  item.second = base::StringPrintf("%d", index_.header()->num_bytes);
+  stats->push_back(item);
+
+  item.first = "Cache type";
+  item.second = "Blockfile Cache";
+  stats->push_back(item);
+
+  stats_.GetItems(stats);
+}
+
+void BackendImplV3::OnExternalCacheHit(const std::string& key) {
+  worker_->PostTask(base::Bind(&BackendImplV3::SyncOnExternalCacheHit,
+                               base::Unretained(this), key));
+}
+
+// ------------------------------------------------------------------------
+
+void BackendImplV3::GrowIndex() {
+  // The index may be in the middle of an update, so the work is deferred.
+  if (grow_pending_)
+    return;
+
+  grow_pending_ = true;
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&BackendImplV3::GrowIndexNow, GetWeakPtr()));
+}
+
+void BackendImplV3::SaveIndex(net::IOBuffer* buffer, int buffer_len) {
+  base::FilePath name = path_.AppendASCII(kBackupName);
+  if (base::WriteFile(name, buffer->data(), buffer_len) != buffer_len)
+    LOG(ERROR) << "Unable to save the index backup";
+}
+
+void BackendImplV3::DeleteCell(EntryCell cell) {
+  CellKey key(cell.hash(), cell.GetAddress().value());
+  if (!pending_cells_.insert(key).second)
+    return;
+
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&BackendImplV3::DeleteCellNow, GetWeakPtr(),
+                            cell.hash(), cell.GetAddress()));
+}
+
+void BackendImplV3::FixCell(EntryCell cell) {
+  CellKey key(cell.hash(), cell.GetAddress().value());
+  if (!pending_cells_.insert(key).second)
+    return;
+
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&BackendImplV3::FixCellNow, GetWeakPtr(),
+                            cell.hash(), cell.GetAddress()));
+}
+
+// ------------------------------------------------------------------------
+
+int BackendImplV3::SyncInit() {
+  DCHECK(!init_);
+  if (init_)
+    return net::ERR_FAILED;
+
+  if (!(user_flags_ & BASIC_UNIT_TEST)) {
+    // The unit test controls directly what to test.
+    lru_eviction_ = (cache_type_ != net::DISK_CACHE);
   }
 
-  scoped_refptr<EntryImpl> cache_entry(
-      new EntryImpl(this, entry_address, false));
-  IncreaseNumRefs();
+  // The files of a cache from the previous version are moved out of the way,
+  // and the entries are imported after creating the new files.
+  base::FilePath old_path = path_.AppendASCII(kOldCacheName);
+  if (!restarted_ && V2CacheReader::IsV2Cache(path_) && !MoveV2Cache(old_path))
+    return net::ERR_FAILED;
 
-  if (!cache_entry->CreateEntry(node_address, key, hash)) {
-    block_files_.DeleteBlock(entry_address, false);
-    block_files_.DeleteBlock(node_address, false);
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
+  bool create_files = false;
+  if (!InitBackingStore(&create_files)) {
+    ReportError(ERR_STORAGE_ERROR);
+    return net::ERR_FAILED;
   }
 
-  cache_entry->BeginLogging(net_log_, true);
+  num_refs_ = num_pending_io_ = max_refs_ = 0;
+  entry_count_ = byte_count_ = 0;
 
-  // We are not failing the operation; let's add this to the map.
-  open_entries_[entry_address.value()] = cache_entry.get();
+  if (!restarted_) {
+    buffer_bytes_ = 0;
+    trace_object_ = TraceObject::GetTraceObject();
+    // Create a recurrent timer of 30 secs.
+    int timer_delay = user_flags_ & UNIT_TEST_MODE ? 1000 : 30000;
+    timer_.reset(new base::RepeatingTimer<BackendImplV3>());
+    timer_->Start(FROM_HERE, TimeDelta::FromMilliseconds(timer_delay), this,
+                  &BackendImplV3::OnTimerTick);
+  }
 
-  // Save the entry.
-  cache_entry->entry()->Store();
-  cache_entry->rankings()->Store();
-  IncreaseNumEntries();
-  entry_count_++;
+  init_ = true;
+  Trace("Init");
 
-  // Link this entry through the index.
-  if (parent.get()) {
-    parent->SetNextAddress(entry_address);
-  } else {
-    data_->table[hash & mask_] = entry_address.value();
+  IndexHeaderV3* header = index_.header();
+  if (header->experiment != NO_EXPERIMENT &&
+      cache_type_ != net::DISK_CACHE) {
+    // No experiment for other caches.
+    return net::ERR_FAILED;
   }
 
-  // Link this entry through the lists.
-  eviction_.OnCreateEntry(cache_entry.get());
+  if (!restarted_ && (create_files || !header->num_entries))
+    ReportError(ERR_CACHE_CREATED);
 
-  CACHE_UMA(AGE_MS, "CreateTime", 0, start);
-  stats_.OnEvent(Stats::CREATE_HIT);
-  SIMPLE_STATS_COUNTER("disk_cache.miss");
-  Trace("create entry hit ");
-  FlushIndex();
-  cache_entry->AddRef();
-  return cache_entry.get();
-}
+  bool previous_crash = (header->crash != 0);
+  header->crash = 1;
 
-int BackendImplV3::DoomEntry(const std::string& key,
-                             const CompletionCallback& callback) {
-  if (disabled_)
+  if (!block_files_.Init(create_files))
     return net::ERR_FAILED;
 
-  EntryImpl* entry = OpenEntryImpl(key);
-  if (!entry)
+  // We want to minimize the changes to cache for an AppCache.
+  if (cache_type() == net::APP_CACHE) {
+    DCHECK(lru_eviction_);
+    read_only_ = true;
+  } else if (cache_type() == net::SHADER_CACHE) {
+    DCHECK(lru_eviction_);
+  }
+
+  eviction_.Init(this);
+
+  // stats_ may end up calling back to us so we better be enabled.
+  disabled_ = false;
+  if (!InitStats())
     return net::ERR_FAILED;
 
-  entry->DoomImpl();
-  entry->Release();
-  return net::OK;
+  if (previous_crash) {
+    ReportError(ERR_PREVIOUS_CRASH);
+  } else if (!restarted_) {
+    ReportError(ERR_NO_ERROR);
+  }
+
+  if (!restarted_ && base::DirectoryExists(old_path))
+    UpgradeFromV2(old_path);
+
+  return disabled_ ? net::ERR_FAILED : net::OK;
 }
 
-int BackendImplV3::DoomAllEntries(const CompletionCallback& callback) {
+void BackendImplV3::CleanupCache() {
+  Trace("Backend Cleanup");
+  eviction_.Stop();
+  timer_.reset();
+
+  if (init_) {
+    StoreStats();
+    if (index_.header())
+      index_.header()->crash = 0;
+
+    if (user_flags_ & BASIC_UNIT_TEST) {
+      // This is a net_unittest, verify that we are not 'leaking' entries.
+      File::WaitForPendingIO(&num_pending_io_);
+      DCHECK(!num_refs_);
+    } else {
+      File::DropPendingIO();
+    }
+
+    if (index_.header())
+      index_.OnBackupTimer();
+  }
+  block_files_.CloseFiles();
+  CloseBackingStore();
+  ptr_factory_.InvalidateWeakPtrs();
+  done_.Signal();
+}
+
+int BackendImplV3::SyncOpenEntry(const std::string& key, Entry** entry) {
+  DCHECK(entry);
+  *entry = OpenEntryImpl(key);
+  return (*entry) ? net::OK : net::ERR_FAILED;
+}
+
+int BackendImplV3::SyncCreateEntry(const std::string& key, Entry** entry) {
+  DCHECK(entry);
+  *entry = CreateEntryImpl(key);
+  return (*entry) ? net::OK : net::ERR_FAILED;
+}
+
+int BackendImplV3::SyncDoomAllEntries() {
+  if (disabled_)
+    return net::ERR_FAILED;
+
   // This is not really an error, but it is an interesting condition.
   ReportError(ERR_CACHE_DOOMED);
   stats_.OnEvent(Stats::DOOM_CACHE);
   if (!num_refs_) {
     RestartCache(false);
     return disabled_ ? net::ERR_FAILED : net::OK;
-  } else {
-    if (disabled_)
-      return net::ERR_FAILED;
-
-    eviction_.TrimCache(true);
-    return net::OK;
   }
+
+  eviction_.TrimCache(true);
+  return net::OK;
 }
 
-int BackendImplV3::DoomEntriesBetween(base::Time initial_time,
-                                      base::Time end_time,
-                                      const CompletionCallback& callback) {
+int BackendImplV3::SyncDoomEntriesBetween(Time initial_time, Time end_time) {
   DCHECK_NE(net::APP_CACHE, cache_type_);
   if (end_time.is_null())
     return SyncDoomEntriesSince(initial_time);
@@ -610,135 +1063,233 @@ int BackendImplV3::DoomEntriesBetween(base::Time initial_time,
   if (disabled_)
     return net::ERR_FAILED;
 
-  EntryImpl* node;
-  void* iter = NULL;
-  EntryImpl* next = OpenNextEntryImpl(&iter);
-  if (!next)
-    return net::OK;
-
-  while (next) {
-    node = next;
-    next = OpenNextEntryImpl(&iter);
-
-    if (node->GetLastUsed() >= initial_time &&
-        node->GetLastUsed() < end_time) {
-      node->DoomImpl();
-    } else if (node->GetLastUsed() < initial_time) {
-      if (next)
-        next->Release();
-      next = NULL;
-      SyncEndEnumeration(iter);
+  // Walk the index from the most recent group of cells, until the cells are
+  // older than |initial_time|.
+  int initial_timestamp = index_.CalculateTimestamp(initial_time);
+  Enumeration enumeration;
+  while (index_.GetNextCells(&enumeration.iterator) &&
+         enumeration.iterator.timestamp >= initial_timestamp) {
+    CellList cells = enumeration.iterator.cells;
+    for (size_t i = 0; i < cells.size(); i++) {
+      EntryImplV3* entry = GetEnumeratedEntry(cells[i]);
+      if (!entry)
+        continue;
+
+      if (entry->GetLastUsed() >= initial_time &&
+          entry->GetLastUsed() < end_time) {
+        entry->DoomImpl();
+      }
+      entry->Release();
     }
-
-    node->Release();
   }
 
   return net::OK;
 }
 
-int BackendImplV3::DoomEntriesSince(base::Time initial_time,
-                                    const CompletionCallback& callback) {
+int BackendImplV3::SyncDoomEntriesSince(Time initial_time) {
   DCHECK_NE(net::APP_CACHE, cache_type_);
   if (disabled_)
     return net::ERR_FAILED;
 
   stats_.OnEvent(Stats::DOOM_RECENT);
+  return SyncDoomEntriesBetween(initial_time, Time::Max());
+}
+
+int BackendImplV3::SyncOpenNextEntry(Enumeration* enumeration,
+                                     Entry** next_entry) {
+  *next_entry = NULL;
+  if (disabled_)
+    return net::ERR_FAILED;
+
   for (;;) {
-    void* iter = NULL;
-    EntryImpl* entry = OpenNextEntryImpl(&iter);
-    if (!entry)
-      return net::OK;
+    if (enumeration->current == enumeration->cells.size()) {
+      if (!index_.GetNextCells(&enumeration->iterator))
+        return net::ERR_FAILED;
 
-    if (initial_time > entry->GetLastUsed()) {
-      entry->Release();
-      SyncEndEnumeration(iter);
-      return net::OK;
+      enumeration->cells = enumeration->iterator.cells;
+      enumeration->current = 0;
+      SortCells(&enumeration->cells, false);
+      continue;
     }
 
-    entry->DoomImpl();
-    entry->Release();
-    SyncEndEnumeration(iter);  // Dooming the entry invalidates the iterator.
+    EntryImplV3* entry =
+        GetEnumeratedEntry(enumeration->cells[enumeration->current++]);
+    if (entry) {
+      *next_entry = entry;
+      return net::OK;
+    }
   }
 }
 
-class BackendImplV3::IteratorImpl : public Backend::Iterator {
- public:
-  explicit IteratorImpl(base::WeakPtr<InFlightBackendIO> background_queue)
-      : background_queue_(background_queue), data_(NULL) {
-  }
+void BackendImplV3::SyncOnExternalCacheHit(const std::string& key) {
+  if (disabled_)
+    return;
 
-  virtual int OpenNextEntry(Entry** next_entry,
-                            const net::CompletionCallback& callback) override {
-    if (!background_queue_)
-      return net::ERR_FAILED;
-    background_queue_->OpenNextEntry(&data_, next_entry, callback);
-    return net::ERR_IO_PENDING;
+  uint32 hash = base::Hash(key);
+  EntryImplV3* cache_entry = LookupEntry(key, hash);
+  if (cache_entry) {
+    UpdateRank(cache_entry, cache_type() == net::SHADER_CACHE);
+    cache_entry->Release();
   }
+}
 
- private:
-  const base::WeakPtr<InFlightBackendIO> background_queue_;
-  void* data_;
-};
+// ------------------------------------------------------------------------
 
-scoped_ptr<Backend::Iterator> BackendImplV3::CreateIterator() {
-  return scoped_ptr<Backend::Iterator>(new IteratorImpl(GetBackgroundQueue()));
+bool BackendImplV3::InitBackingStore(bool* file_created) {
+  if (!base::CreateDirectory(path_))
+    return false;
+
+  *file_created = !base::PathExists(path_.AppendASCII(kIndexName));
+  bool ret = *file_created ? CreateBackingStore() : LoadBackingStore();
+  if (!ret) {
+    CloseBackingStore();
+    return false;
+  }
+
+  AdjustMaxCacheSize();
+  return true;
 }
 
-void BackendImplV3::GetStats(StatsItems* stats) {
-  if (disabled_)
-    return;
+bool BackendImplV3::CreateBackingStore() {
+  index_file_ = MapFile(path_.AppendASCII(kIndexName), kIndexFileSize, true);
+  main_table_file_ = MapFile(path_.AppendASCII(kMainTableName),
+                             TableSize(kBaseTableLen), true);
+  extra_table_file_ = MapFile(path_.AppendASCII(kExtraTableName),
+                              TableSize(kInitialTableLen - kBaseTableLen),
+                              true);
+  if (!index_file_.get() || !main_table_file_.get() ||
+      !extra_table_file_.get()) {
+    LOG(ERROR) << "Unable to create the index files";
+    return false;
+  }
 
-  std::pair<std::string, std::string> item;
+  IndexTableInitData params;
+  params.index_bitmap = static_cast<IndexBitmap*>(index_file_->buffer());
+  params.main_table = static_cast<IndexBucket*>(main_table_file_->buffer());
+  params.extra_table = static_cast<IndexBucket*>(extra_table_file_->buffer());
+  memset(params.index_bitmap, 0, kIndexFileSize);
+  memset(params.main_table, 0, TableSize(kBaseTableLen));
+  memset(params.extra_table, 0, TableSize(kInitialTableLen - kBaseTableLen));
+
+  IndexHeaderV3* header = &params.index_bitmap->header;
+  header->magic = kIndexMagicV3;
+  header->version = kVersion3;
+  header->table_len = kInitialTableLen;
+  header->max_bucket = kBaseTableLen / kCellsPerBucket - 1;
+  header->flags = SMALL_CACHE;
+  if (!lru_eviction_)
+    header->flags |= CACHE_EVICTION_2;
+  header->create_time = Time::Now().ToInternalValue();
+  header->base_time = header->create_time;
+
+  int num_words = (header->table_len + 31) / 32;
+  params.backup_header.reset(new IndexHeaderV3);
+  memcpy(params.backup_header.get(), header, sizeof(*header));
+  params.backup_bitmap.reset(new uint32[num_words]);
+  memset(params.backup_bitmap.get(), 0, num_words * sizeof(uint32));
+
+  index_.Init(&params);
+  return true;
+}
 
-  item.first = "Entries";
-  item.second = base::StringPrintf("%d", data_->header.num_entries);
-  stats->push_back(item);
+bool BackendImplV3::LoadBackingStore() {
+  index_file_ = MapFile(path_.AppendASCII(kIndexName), kIndexFileSize, false);
+  if (!index_file_.get()) {
+    LOG(ERROR) << "Unable to map Index file";
+    return false;
+  }
 
-  item.first = "Pending IO";
-  item.second = base::StringPrintf("%d", num_pending_io_);
-  stats->push_back(item);
+  IndexBitmap* index_bitmap = static_cast<IndexBitmap*>(index_file_->buffer());
+  IndexHeaderV3* header = &index_bitmap->header;
+  if (kIndexMagicV3 != header->magic || kVersion3 != header->version) {
+    LOG(ERROR) << "Invalid file version or magic";
+    return false;
+  }
 
-  item.first = "Max size";
-  item.second = base::StringPrintf("%d", max_size_);
-  stats->push_back(item);
+  int table_len = header->table_len;
+  if (table_len < kInitialTableLen || table_len >= kMaxTableLen ||
+      table_len % kCellsPerBucket) {
+    LOG(ERROR) << "Invalid table size";
+    return false;
+  }
 
-  item.first = "Current size";
-  item.second = base::StringPrintf("%d", data_->header.num_bytes);
-  stats->push_back(item);
+  int main_table_len = MainTableLen(table_len);
+  bool small_table =
+      base::bits::Log2Floor(table_len) < kMaxSmallTableBits;
+  if (table_len == main_table_len ||
+      header->max_bucket < main_table_len / kCellsPerBucket - 1 ||
+      header->max_bucket >= table_len / kCellsPerBucket ||
+      small_table != ((header->flags & SMALL_CACHE) != 0)) {
+    LOG(ERROR) << "Corrupt Index file";
+    return false;
+  }
 
-  item.first = "Cache type";
-  item.second = "Blockfile Cache";
-  stats->push_back(item);
+  if (header->num_bytes < 0) {
+    LOG(ERROR) << "Invalid cache (current) size";
+    return false;
+  }
 
-  stats_.GetItems(stats);
-}
+  if (header->num_entries < 0) {
+    LOG(ERROR) << "Invalid number of entries";
+    return false;
+  }
 
-void BackendImplV3::OnExternalCacheHit(const std::string& key) {
-  if (disabled_)
-    return;
+  main_table_file_ = MapFile(path_.AppendASCII(kMainTableName),
+                             TableSize(main_table_len), false);
+  extra_table_file_ = MapFile(path_.AppendASCII(kExtraTableName),
+                              TableSize(table_len - main_table_len), false);
+  if (!main_table_file_.get() || !extra_table_file_.get()) {
+    LOG(ERROR) << "Unable to map the index tables";
+    return false;
+  }
 
-  uint32 hash = base::Hash(key);
-  bool error;
-  EntryImpl* cache_entry = MatchEntry(key, hash, false, Addr(), &error);
-  if (cache_entry) {
-    if (ENTRY_NORMAL == cache_entry->entry()->Data()->state) {
-      UpdateRank(cache_entry, cache_type() == net::SHADER_CACHE);
-    }
-    cache_entry->Release();
+  IndexTableInitData params;
+  params.index_bitmap = index_bitmap;
+  params.main_table = static_cast<IndexBucket*>(main_table_file_->buffer());
+  params.extra_table = static_cast<IndexBucket*>(extra_table_file_->buffer());
+
+  // Use the backup of the index, if it matches the current table. Otherwise,
+  // the current bitmap is as good as it gets.
+  int num_words = (table_len + 31) / 32;
+  size_t backup_size = sizeof(IndexHeaderV3) + num_words * sizeof(uint32);
+  params.backup_header.reset(new IndexHeaderV3);
+  params.backup_bitmap.reset(new uint32[num_words]);
+
+  std::string backup;
+  const IndexHeaderV3* backup_header =
+      reinterpret_cast<const IndexHeaderV3*>(backup.data());
+  if (base::ReadFileToString(path_.AppendASCII(kBackupName), &backup) &&
+      backup.size() >= backup_size &&
+      (backup_header = reinterpret_cast<const IndexHeaderV3*>(backup.data())) &&
+      backup_header->magic == kIndexMagicV3 &&
+      backup_header->version == kVersion3 &&
+      backup_header->table_len == table_len) {
+    memcpy(params.backup_header.get(), backup.data(), sizeof(IndexHeaderV3));
+    memcpy(params.backup_bitmap.get(), backup.data() + sizeof(IndexHeaderV3),
+           num_words * sizeof(uint32));
+  } else {
+    memcpy(params.backup_header.get(), header, sizeof(IndexHeaderV3));
+    memcpy(params.backup_bitmap.get(), index_bitmap->bitmap,
+           num_words * sizeof(uint32));
   }
+
+  index_.Init(&params);
+  return true;
 }
 
-// ------------------------------------------------------------------------
+void BackendImplV3::CloseBackingStore() {
+  index_.Shutdown();
+  index_file_ = NULL;
+  main_table_file_ = NULL;
+  extra_table_file_ = NULL;
+}
 
 // The maximum cache size will be either set explicitly by the caller, or
 // calculated by this code.
-void BackendImplV3::AdjustMaxCacheSize(int table_len) {
+void BackendImplV3::AdjustMaxCacheSize() {
   if (max_size_)
     return;
 
-  // If table_len is provided, the index file exists.
-  DCHECK(!table_len || data_->header.magic);
-
   // The user is not setting the size, let's figure it out.
   int64 available = base::SysInfo::AmountOfFreeDiskSpace(path_);
   if (available < 0) {
@@ -746,27 +1297,13 @@ void BackendImplV3::AdjustMaxCacheSize(int table_len) {
     return;
   }
 
-  if (table_len)
-    available += data_->header.num_bytes;
-
-  max_size_ = PreferedCacheSize(available);
-
-  // Let's not use more than the default size while we tune-up the performance
-  // of bigger caches. TODO(rvargas): remove this limit.
-  if (max_size_ > kDefaultCacheSize * 4)
-    max_size_ = kDefaultCacheSize * 4;
-
-  if (!table_len)
-    return;
-
-  // If we already have a table, adjust the size to it.
-  int current_max_size = MaxStorageSizeForTable(table_len);
-  if (max_size_ > current_max_size)
-    max_size_= current_max_size;
+  available += index_.header()->num_bytes;
+  max_size_ = PreferredCacheSize(available);
 }
 
 bool BackendImplV3::InitStats() {
-  Addr address(data_->header.stats);
+  IndexHeaderV3* header = index_.header();
+  Addr address(header->stats);
   int size = stats_.StorageSize();
 
   if (!address.is_initialized()) {
@@ -776,6 +1313,8 @@ bool BackendImplV3::InitStats() {
 
     if (!CreateBlock(file_type, num_blocks, &address))
       return false;
+
+    header->stats = address.value();
     return stats_.Init(NULL, 0, address);
   }
 
@@ -821,6 +1360,101 @@ void BackendImplV3::StoreStats() {
   file->Write(data.get(), size, offset);  // ignore result.
 }
 
+void BackendImplV3::GrowIndexNow() {
+  grow_pending_ = false;
+  if (disabled_ || !index_.header())
+    return;
+
+  // The extra table grows by kNumExtraBlocks cells at a time, until it would
+  // be as big as the main table. At that point the main table doubles its
+  // size, and the extra table starts again at half the size of the main table.
+  IndexHeaderV3* header = index_.header();
+  int main_table_len = MainTableLen(header->table_len);
+  int table_len = header->table_len + kNumExtraBlocks;
+  bool doubling = table_len >= main_table_len * 2;
+  if (doubling) {
+    main_table_len *= 2;
+    table_len = main_table_len + main_table_len / 2;
+    if (main_table_len > kMaxMainTableLen) {
+      Trace("The index cannot grow");
+      return;
+    }
+  }
+
+  // The files are only extended, so the current tables remain valid until the
+  // index switches to the new ones.
+  scoped_refptr<MappedFile> main_table_file = main_table_file_;
+  if (doubling) {
+    main_table_file = MapFile(path_.AppendASCII(kMainTableName),
+                              TableSize(main_table_len), true);
+  }
+  scoped_refptr<MappedFile> extra_table_file =
+      MapFile(path_.AppendASCII(kExtraTableName),
+              TableSize(table_len - main_table_len), true);
+  if (!main_table_file.get() || !extra_table_file.get()) {
+    LOG(ERROR) << "Unable to grow the index";
+    return;
+  }
+
+  Trace("Grow index to %d cells", table_len);
+  header->table_len = table_len;
+  IndexTableInitData params;
+  params.index_bitmap = static_cast<IndexBitmap*>(index_file_->buffer());
+  if (doubling)
+    params.main_table = static_cast<IndexBucket*>(main_table_file->buffer());
+  params.extra_table = static_cast<IndexBucket*>(extra_table_file->buffer());
+  index_.Init(&params);
+
+  main_table_file_.swap(main_table_file);
+  extra_table_file_.swap(extra_table_file);
+}
+
+bool BackendImplV3::MoveV2Cache(const base::FilePath& old_path) {
+  if (!base::CreateDirectory(old_path))
+    return false;
+
+  base::FileEnumerator iter(path_, false, base::FileEnumerator::FILES);
+  for (base::FilePath name = iter.Next(); !name.value().empty();
+       name = iter.Next()) {
+    if (!base::Move(name, old_path.Append(name.BaseName()))) {
+      LOG(ERROR) << "Unable to move the old cache";
+      return false;
+    }
+  }
+  return true;
+}
+
+void BackendImplV3::UpgradeFromV2(const base::FilePath& old_path) {
+  Trace("Upgrade from v2");
+  {
+    V2CacheReader reader(old_path, worker_->background_thread());
+    V2CacheReader::EntryData data;
+    bool success = reader.Init(cache_type_);
+    while (success && reader.ReadNextEntry(&data)) {
+      // An entry may already be here if a previous upgrade was interrupted.
+      EntryImplV3* entry = CreateEntryImpl(data.key);
+      if (!entry)
+        continue;
+
+      for (int i = 0; i < V2CacheReader::kNumStreams; i++) {
+        if (!data.stream_sizes[i])
+          continue;
+
+        // There is no callback, so the data is written synchronously.
+        entry->WriteDataImpl(i, 0, data.streams[i].get(),
+                             data.stream_sizes[i], CompletionCallback(),
+                             false);
+      }
+      entry->SetEntryFlags(data.flags);
+      entry->SetTimes(data.last_used, data.last_modified);
+      index_.UpdateTime(entry->GetHash(), entry->entry()->address(),
+                        data.last_used);
+      entry->Release();
+    }
+  }
+  DeleteCache(old_path, true);
+}
+
 void BackendImplV3::RestartCache(bool failure) {
   int64 errors = stats_.GetCounter(Stats::FATAL_ERROR);
   int64 full_dooms = stats_.GetCounter(Stats::DOOM_CACHE);
@@ -838,9 +1472,9 @@ void BackendImplV3::RestartCache(bool failure) {
 
   // Don't call Init() if directed by the unit test: we are simulating a failure
   // trying to re-enable the cache.
-  if (unit_test_)
+  if (user_flags_ & UNIT_TEST_MODE) {
     init_ = true;  // Let the destructor do proper cleanup.
-  else if (SyncInit() == net::OK) {
+  } else if (SyncInit() == net::OK) {
     stats_.SetCounter(Stats::FATAL_ERROR, errors);
     stats_.SetCounter(Stats::DOOM_CACHE, full_dooms);
     stats_.SetCounter(Stats::DOOM_RECENT, partial_dooms);
@@ -853,376 +1487,254 @@ void BackendImplV3::PrepareForRestart() {
     lru_eviction_ = true;
 
   disabled_ = true;
-  data_->header.crash = 0;
-  index_->Flush();
-  index_ = NULL;
-  data_ = NULL;
+  if (index_.header())
+    index_.header()->crash = 0;
   block_files_.CloseFiles();
-  rankings_.Reset();
+  CloseBackingStore();
+  pending_cells_.clear();
+  grow_pending_ = false;
   init_ = false;
   restarted_ = true;
-}
-
-void BackendImplV3::CleanupCache() {
-  Trace("Backend Cleanup");
-  eviction_.Stop();
-  timer_.reset();
-
-  if (init_) {
-    StoreStats();
-    if (data_)
-      data_->header.crash = 0;
-
-    if (user_flags_ & kNoRandom) {
-      // This is a net_unittest, verify that we are not 'leaking' entries.
-      File::WaitForPendingIO(&num_pending_io_);
-      DCHECK(!num_refs_);
-    } else {
-      File::DropPendingIO();
-    }
-  }
-  block_files_.CloseFiles();
-  FlushIndex();
-  index_ = NULL;
-  ptr_factory_.InvalidateWeakPtrs();
-  done_.Signal();
-}
-
-int BackendImplV3::NewEntry(Addr address, EntryImplV3** entry) {
-  EntriesMap::iterator it = open_entries_.find(address.value());
-  if (it != open_entries_.end()) {
-    // Easy job. This entry is already in memory.
-    EntryImpl* this_entry = it->second;
-    this_entry->AddRef();
-    *entry = this_entry;
-    return 0;
-  }
-
-  STRESS_DCHECK(block_files_.IsValid(address));
-
-  if (!address.SanityCheckForEntry()) {
-    LOG(WARNING) << "Wrong entry address.";
-    STRESS_NOTREACHED();
-    return ERR_INVALID_ADDRESS;
-  }
-
-  scoped_refptr<EntryImpl> cache_entry(
-      new EntryImpl(this, address, read_only_));
-  IncreaseNumRefs();
-  *entry = NULL;
-
-  TimeTicks start = TimeTicks::Now();
-  if (!cache_entry->entry()->Load())
-    return ERR_READ_FAILURE;
-
-  if (IsLoaded()) {
-    CACHE_UMA(AGE_MS, "LoadTime", 0, start);
-  }
-
-  if (!cache_entry->SanityCheck()) {
-    LOG(WARNING) << "Messed up entry found.";
-    STRESS_NOTREACHED();
-    return ERR_INVALID_ENTRY;
-  }
-
-  STRESS_DCHECK(block_files_.IsValid(
-                    Addr(cache_entry->entry()->Data()->rankings_node)));
-
-  if (!cache_entry->LoadNodeAddress())
-    return ERR_READ_FAILURE;
-
-  if (!rankings_.SanityCheck(cache_entry->rankings(), false)) {
-    STRESS_NOTREACHED();
-    cache_entry->SetDirtyFlag(0);
-    // Don't remove this from the list (it is not linked properly). Instead,
-    // break the link back to the entry because it is going away, and leave the
-    // rankings node to be deleted if we find it through a list.
-    rankings_.SetContents(cache_entry->rankings(), 0);
-  } else if (!rankings_.DataSanityCheck(cache_entry->rankings(), false)) {
-    STRESS_NOTREACHED();
-    cache_entry->SetDirtyFlag(0);
-    rankings_.SetContents(cache_entry->rankings(), address.value());
-  }
-
-  if (!cache_entry->DataSanityCheck()) {
-    LOG(WARNING) << "Messed up entry found.";
-    cache_entry->SetDirtyFlag(0);
-    cache_entry->FixForDelete();
-  }
-
-  // Prevent overwriting the dirty flag on the destructor.
-  cache_entry->SetDirtyFlag(GetCurrentEntryId());
-
-  if (cache_entry->dirty()) {
-    Trace("Dirty entry 0x%p 0x%x", reinterpret_cast<void*>(cache_entry.get()),
-          address.value());
-  }
-
-  open_entries_[address.value()] = cache_entry.get();
-
-  cache_entry->BeginLogging(net_log_, false);
-  cache_entry.swap(entry);
-  return 0;
-}
-
-void BackendImplV3::AddStorageSize(int32 bytes) {
-  data_->header.num_bytes += bytes;
-  DCHECK_GE(data_->header.num_bytes, 0);
-}
-
-void BackendImplV3::SubstractStorageSize(int32 bytes) {
-  data_->header.num_bytes -= bytes;
-  DCHECK_GE(data_->header.num_bytes, 0);
-}
-
-void BackendImplV3::IncreaseNumRefs() {
-  num_refs_++;
-  if (max_refs_ < num_refs_)
-    max_refs_ = num_refs_;
-}
-
-void BackendImplV3::DecreaseNumRefs() {
-  DCHECK(num_refs_);
-  num_refs_--;
-
-  if (!num_refs_ && disabled_)
-    base::MessageLoop::current()->PostTask(
-        FROM_HERE, base::Bind(&BackendImpl::RestartCache, GetWeakPtr(), true));
-}
-
-void BackendImplV3::IncreaseNumEntries() {
-  index_.header()->num_entries++;
-  DCHECK_GT(index_.header()->num_entries, 0);
-}
-
-void BackendImplV3::DecreaseNumEntries() {
-  index_.header()->num_entries--;
-  if (index_.header()->num_entries < 0) {
-    NOTREACHED();
-    index_.header()->num_entries = 0;
-  }
-}
-
-int BackendImplV3::SyncInit() {
-#if defined(NET_BUILD_STRESS_CACHE)
-  // Start evictions right away.
-  up_ticks_ = kTrimDelay * 2;
-#endif
-  DCHECK(!init_);
-  if (init_)
-    return net::ERR_FAILED;
-
-  bool create_files = false;
-  if (!InitBackingStore(&create_files)) {
-    ReportError(ERR_STORAGE_ERROR);
-    return net::ERR_FAILED;
-  }
+}
 
-  num_refs_ = num_pending_io_ = max_refs_ = 0;
-  entry_count_ = byte_count_ = 0;
+int BackendImplV3::NewEntry(Addr address, uint32 hash, EntryImplV3** entry) {
+  EntriesMap::iterator it = open_entries_.find(address.value());
+  if (it != open_entries_.end()) {
+    // Easy job. This entry is already in memory.
+    EntryImplV3* this_entry = it->second;
+    this_entry->AddRef();
+    *entry = this_entry;
+    return 0;
+  }
 
-  if (!restarted_) {
-    buffer_bytes_ = 0;
-    trace_object_ = TraceObject::GetTraceObject();
-    // Create a recurrent timer of 30 secs.
-    int timer_delay = unit_test_ ? 1000 : 30000;
-    timer_.reset(new base::RepeatingTimer<BackendImplV3>());
-    timer_->Start(FROM_HERE, TimeDelta::FromMilliseconds(timer_delay), this,
-                  &BackendImplV3::OnStatsTimer);
+  if (!address.SanityCheckForEntryV3()) {
+    LOG(WARNING) << "Wrong entry address.";
+    return ERR_INVALID_ADDRESS;
   }
 
-  init_ = true;
-  Trace("Init");
+  scoped_refptr<EntryImplV3> cache_entry(
+      new EntryImplV3(this, address, read_only_));
+  IncreaseNumRefs();
+  *entry = NULL;
 
-  if (data_->header.experiment != NO_EXPERIMENT &&
-      cache_type_ != net::DISK_CACHE) {
-    // No experiment for other caches.
-    return net::ERR_FAILED;
-  }
+  TimeTicks start = TimeTicks::Now();
+  if (!cache_entry->entry()->Load())
+    return ERR_READ_FAILURE;
 
-  if (!(user_flags_ & kNoRandom)) {
-    // The unit test controls directly what to test.
-    new_eviction_ = (cache_type_ == net::DISK_CACHE);
+  if (IsLoaded()) {
+    CACHE_UMA(AGE_MS, "LoadTime", start);
   }
 
-  if (!CheckIndex()) {
-    ReportError(ERR_INIT_FAILED);
-    return net::ERR_FAILED;
+  if (!cache_entry->SanityCheck() || cache_entry->GetHash() != hash) {
+    LOG(WARNING) << "Messed up entry found.";
+    return ERR_INVALID_ENTRY;
   }
 
-  if (!restarted_ && (create_files || !data_->header.num_entries))
-    ReportError(ERR_CACHE_CREATED);
+  open_entries_[address.value()] = cache_entry.get();
 
-  if (!(user_flags_ & kNoRandom) && cache_type_ == net::DISK_CACHE &&
-      !InitExperiment(&data_->header, create_files)) {
-    return net::ERR_FAILED;
-  }
+  cache_entry->BeginLogging(net_log_, false);
+  cache_entry.swap(entry);
+  return 0;
+}
 
-  // We don't care if the value overflows. The only thing we care about is that
-  // the id cannot be zero, because that value is used as "not dirty".
-  // Increasing the value once per second gives us many years before we start
-  // having collisions.
-  data_->header.this_id++;
-  if (!data_->header.this_id)
-    data_->header.this_id++;
+EntryImplV3* BackendImplV3::OpenCell(const EntryCell& cell) {
+  uint32 hash = cell.hash();
+  Addr address = cell.GetAddress();
+  EntryImplV3* entry = GetOpenEntry(address);
+  if (entry) {
+    entry->AddRef();
+    return entry;
+  }
 
-  bool previous_crash = (data_->header.crash != 0);
-  data_->header.crash = 1;
+  if (!CheckDirtyCell(cell))
+    return NULL;
 
-  if (!block_files_.Init(create_files))
-    return net::ERR_FAILED;
+  if (NewEntry(address, hash, &entry)) {
+    DiscardCell(hash, address);
+    return NULL;
+  }
 
-  // We want to minimize the changes to cache for an AppCache.
-  if (cache_type() == net::APP_CACHE) {
-    DCHECK(!new_eviction_);
-    read_only_ = true;
-  } else if (cache_type() == net::SHADER_CACHE) {
-    DCHECK(!new_eviction_);
+  index_.SetSate(hash, address, ENTRY_OPEN);
+  if (!entry->DataSanityCheck()) {
+    LOG(WARNING) << "Messed up entry found.";
+    entry->FixForDelete();
+    InternalDoomEntry(entry);
+    entry->Release();
+    return NULL;
   }
+  return entry;
+}
 
-  eviction_.Init(this);
+EntryImplV3* BackendImplV3::GetEnumeratedEntry(const CellInfo& cell_info) {
+  if (disabled_)
+    return NULL;
 
-  // stats_ and rankings_ may end up calling back to us so we better be enabled.
-  disabled_ = false;
-  if (!InitStats())
-    return net::ERR_FAILED;
+  EntryCell cell = index_.FindEntryCell(cell_info.hash, cell_info.address);
+  if (!cell.IsValid() || cell.GetState() == ENTRY_FIXING ||
+      cell.GetGroup() == ENTRY_EVICTED) {
+    return NULL;
+  }
+  return OpenCell(cell);
+}
 
-  disabled_ = !rankings_.Init(this, new_eviction_);
+EntryImplV3* BackendImplV3::LookupEntry(const std::string& key, uint32 hash) {
+  EntrySet entries = index_.LookupEntries(hash);
+  for (size_t i = 0; i < entries.cells.size(); i++) {
+    // Looking at a cell may change the state of the index, so the current
+    // state of this cell is needed.
+    const EntryCell& found = entries.cells[i];
+    EntryCell cell = index_.FindEntryCell(hash, found.GetAddress());
+    if (!cell.IsValid() || cell.GetState() == ENTRY_FIXING ||
+        cell.GetGroup() == ENTRY_EVICTED) {
+      continue;
+    }
 
-#if defined(STRESS_CACHE_EXTENDED_VALIDATION)
-  trace_object_->EnableTracing(false);
-  int sc = SelfCheck();
-  if (sc < 0 && sc != ERR_NUM_ENTRIES_MISMATCH)
-    NOTREACHED();
-  trace_object_->EnableTracing(true);
-#endif
+    EntryImplV3* entry = OpenCell(cell);
+    if (!entry)
+      continue;
 
-  if (previous_crash) {
-    ReportError(ERR_PREVIOUS_CRASH);
-  } else if (!restarted_) {
-    ReportError(ERR_NO_ERROR);
+    if (entry->IsSameEntry(key, hash))
+      return entry;
+
+    entry->Release();
   }
+  return NULL;
+}
 
-  FlushIndex();
+bool BackendImplV3::CheckDirtyCell(const EntryCell& cell) {
+  uint32 hash = cell.hash();
+  Addr address = cell.GetAddress();
+  switch (cell.GetState()) {
+    case ENTRY_USED:
+      return true;
+    case ENTRY_OPEN:
+      // The entry was not modified before the crash.
+      index_.SetSate(hash, address, ENTRY_USED);
+      return true;
+    case ENTRY_NEW:
+    case ENTRY_MODIFIED:
+      // The entry was being written when the cache went away, so it cannot be
+      // trusted.
+      Trace("Dirty entry 0x%x", address.value());
+      index_.SetSate(hash, address, ENTRY_DELETED);
+      DecreaseNumEntries();
+      DeleteStaleEntry(hash, address);
+      return false;
+    default:
+      return false;
+  }
+}
 
-  return disabled_ ? net::ERR_FAILED : net::OK;
+void BackendImplV3::DiscardCell(uint32 hash, Addr address) {
+  index_.SetSate(hash, address, ENTRY_OPEN);
+  index_.SetSate(hash, address, ENTRY_DELETED);
+  DecreaseNumEntries();
+  index_.SetSate(hash, address, ENTRY_FREE);
+  DeleteBlock(address, true);
 }
 
-EntryImpl* BackendImplV3::ResurrectEntry(EntryImpl* deleted_entry) {
-  if (ENTRY_NORMAL == deleted_entry->entry()->Data()->state) {
-    deleted_entry->Release();
-    stats_.OnEvent(Stats::CREATE_MISS);
-    Trace("create entry miss ");
-    return NULL;
+void BackendImplV3::DeleteStaleEntry(uint32 hash, Addr address) {
+  EntryImplV3* entry;
+  if (NewEntry(address, hash, &entry)) {
+    // There is no way to get to the data of this entry.
+    index_.SetSate(hash, address, ENTRY_FREE);
+    DeleteBlock(address, true);
+    return;
   }
 
-  // We are attempting to create an entry and found out that the entry was
-  // previously deleted.
+  if (!entry->DataSanityCheck())
+    entry->FixForDelete();
 
-  eviction_.OnCreateEntry(deleted_entry);
-  entry_count_++;
+  // Releasing a doomed entry deletes all its data and frees the cell.
+  entry->InternalDoom();
+  entry->Release();
+}
+
+void BackendImplV3::DeleteCellNow(uint32 hash, Addr address) {
+  pending_cells_.erase(CellKey(hash, address.value()));
+  if (disabled_ || GetOpenEntry(address))
+    return;
 
-  stats_.OnEvent(Stats::RESURRECT_HIT);
-  Trace("Resurrect entry hit ");
-  return deleted_entry;
+  DeleteStaleEntry(hash, address);
 }
 
-EntryImpl* BackendImplV3::CreateEntryImpl(const std::string& key) {
-  if (disabled_ || key.empty())
-    return NULL;
+void BackendImplV3::FixCellNow(uint32 hash, Addr address) {
+  pending_cells_.erase(CellKey(hash, address.value()));
+  if (disabled_)
+    return;
 
-  TimeTicks start = TimeTicks::Now();
-  Trace("Create hash 0x%x", hash);
+  EntryCell cell = index_.FindEntryCell(hash, address);
+  if (!cell.IsValid() || cell.GetState() != ENTRY_FIXING)
+    return;
 
-  scoped_refptr<EntryImpl> parent;
-  Addr entry_address(data_->table[hash & mask_]);
-  if (entry_address.is_initialized()) {
-    // We have an entry already. It could be the one we are looking for, or just
-    // a hash conflict.
-    bool error;
-    EntryImpl* old_entry = MatchEntry(key, hash, false, Addr(), &error);
-    if (old_entry)
-      return ResurrectEntry(old_entry);
-
-    EntryImpl* parent_entry = MatchEntry(key, hash, true, Addr(), &error);
-    DCHECK(!error);
-    if (parent_entry) {
-      parent.swap(&parent_entry);
-    } else if (data_->table[hash & mask_]) {
-      // We should have corrected the problem.
-      NOTREACHED();
-      return NULL;
+  // There is no way to know what happened to this entry, so it goes away. Note
+  // that the index doesn't count cells in the FIXING state as entries.
+  index_.SetSate(hash, address, ENTRY_DELETED);
+  DeleteStaleEntry(hash, address);
+}
+
+void BackendImplV3::SortCells(CellList* cells, bool oldest_first) {
+  // The index only knows about groups of cells, so the entries themselves are
+  // used to find out the order within the group.
+  std::vector<std::pair<int64, size_t> > times(cells->size());
+  for (size_t i = 0; i < cells->size(); i++) {
+    Addr address = (*cells)[i].address;
+    int64 last_used = 0;
+    EntryImplV3* entry = GetOpenEntry(address);
+    if (entry) {
+      last_used = entry->entry()->Data()->last_access_time;
+    } else {
+      CacheEntryBlockV3 block(File(address), address);
+      if (block.Load())
+        last_used = block.Data()->last_access_time;
     }
+    times[i] = std::make_pair(oldest_first ? last_used : -last_used, i);
   }
+  std::sort(times.begin(), times.end());
 
-  // The general flow is to allocate disk space and initialize the entry data,
-  // followed by saving that to disk, then linking the entry though the index
-  // and finally through the lists. If there is a crash in this process, we may
-  // end up with:
-  // a. Used, unreferenced empty blocks on disk (basically just garbage).
-  // b. Used, unreferenced but meaningful data on disk (more garbage).
-  // c. A fully formed entry, reachable only through the index.
-  // d. A fully formed entry, also reachable through the lists, but still dirty.
-  //
-  // Anything after (b) can be automatically cleaned up. We may consider saving
-  // the current operation (as we do while manipulating the lists) so that we
-  // can detect and cleanup (a) and (b).
-
-  int num_blocks = EntryImpl::NumBlocksForEntry(key.size());
-  if (!block_files_.CreateBlock(BLOCK_256, num_blocks, &entry_address)) {
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
-  }
+  CellList sorted(cells->size());
+  for (size_t i = 0; i < times.size(); i++)
+    sorted[i] = (*cells)[times[i].second];
+  cells->swap(sorted);
+}
 
-  Addr node_address(0);
-  if (!block_files_.CreateBlock(RANKINGS, 1, &node_address)) {
-    block_files_.DeleteBlock(entry_address, false);
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
-  }
+void BackendImplV3::AddStorageSize(int32 bytes) {
+  index_.header()->num_bytes += bytes;
+  DCHECK_GE(index_.header()->num_bytes, 0);
+}
 
-  scoped_refptr<EntryImpl> cache_entry(
-      new EntryImpl(this, entry_address, false));
-  IncreaseNumRefs();
+void BackendImplV3::SubstractStorageSize(int32 bytes) {
+  index_.header()->num_bytes -= bytes;
+  DCHECK_GE(index_.header()->num_bytes, 0);
+}
 
-  if (!cache_entry->CreateEntry(node_address, key, hash)) {
-    block_files_.DeleteBlock(entry_address, false);
-    block_files_.DeleteBlock(node_address, false);
-    LOG(ERROR) << "Create entry failed " << key.c_str();
-    stats_.OnEvent(Stats::CREATE_ERROR);
-    return NULL;
-  }
+void BackendImplV3::IncreaseNumRefs() {
+  num_refs_++;
+  if (max_refs_ < num_refs_)
+    max_refs_ = num_refs_;
+}
 
-  cache_entry->BeginLogging(net_log_, true);
+void BackendImplV3::DecreaseNumRefs() {
+  DCHECK(num_refs_);
+  num_refs_--;
 
-  // We are not failing the operation; let's add this to the map.
-  open_entries_[entry_address.value()] = cache_entry;
+  if (!num_refs_ && disabled_)
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE, base::Bind(&BackendImplV3::RestartCache, GetWeakPtr(),
+                              true));
+}
 
-  // Save the entry.
-  cache_entry->entry()->Store();
-  cache_entry->rankings()->Store();
-  IncreaseNumEntries();
-  entry_count_++;
+void BackendImplV3::IncreaseNumEntries() {
+  index_.header()->num_entries++;
+  DCHECK_GT(index_.header()->num_entries, 0);
+}
 
-  // Link this entry through the index.
-  if (parent.get()) {
-    parent->SetNextAddress(entry_address);
-  } else {
-    data_->table[hash & mask_] = entry_address.value();
+void BackendImplV3::DecreaseNumEntries() {
+  index_.header()->num_entries--;
+  if (index_.header()->num_entries < 0) {
+    NOTREACHED();
+    index_.header()->num_entries = 0;
   }
-
-  // Link this entry through the lists.
-  eviction_.OnCreateEntry(cache_entry);
-
-  CACHE_UMA(AGE_MS, "CreateTime", 0, start);
-  stats_.OnEvent(Stats::CREATE_HIT);
-  SIMPLE_STATS_COUNTER("disk_cache.miss");
-  Trace("create entry hit ");
-  FlushIndex();
-  cache_entry->AddRef();
-  return cache_entry.get();
 }
 
 void BackendImplV3::LogStats() {
@@ -1325,127 +1837,6 @@ void BackendImplV3::ReportError(int error) {
   CACHE_UMA(CACHE_ERROR, "Error", error * -1);
 }
 
-bool BackendImplV3::CheckIndex() {
-  DCHECK(data_);
-
-  size_t current_size = index_->GetLength();
-  if (current_size < sizeof(Index)) {
-    LOG(ERROR) << "Corrupt Index file";
-    return false;
-  }
-
-  if (new_eviction_) {
-    // We support versions 2.0 and 2.1, upgrading 2.0 to 2.1.
-    if (kIndexMagic != data_->header.magic ||
-        kCurrentVersion >> 16 != data_->header.version >> 16) {
-      LOG(ERROR) << "Invalid file version or magic";
-      return false;
-    }
-    if (kCurrentVersion == data_->header.version) {
-      // We need file version 2.1 for the new eviction algorithm.
-      UpgradeTo2_1();
-    }
-  } else {
-    if (kIndexMagic != data_->header.magic ||
-        kCurrentVersion != data_->header.version) {
-      LOG(ERROR) << "Invalid file version or magic";
-      return false;
-    }
-  }
-
-  if (!data_->header.table_len) {
-    LOG(ERROR) << "Invalid table size";
-    return false;
-  }
-
-  if (current_size < GetIndexSize(data_->header.table_len) ||
-      data_->header.table_len & (kBaseTableLen - 1)) {
-    LOG(ERROR) << "Corrupt Index file";
-    return false;
-  }
-
-  AdjustMaxCacheSize(data_->header.table_len);
-
-#if !defined(NET_BUILD_STRESS_CACHE)
-  if (data_->header.num_bytes < 0 ||
-      (max_size_ < kint32max - kDefaultCacheSize &&
-       data_->header.num_bytes > max_size_ + kDefaultCacheSize)) {
-    LOG(ERROR) << "Invalid cache (current) size";
-    return false;
-  }
-#endif
-
-  if (data_->header.num_entries < 0) {
-    LOG(ERROR) << "Invalid number of entries";
-    return false;
-  }
-
-  if (!mask_)
-    mask_ = data_->header.table_len - 1;
-
-  // Load the table into memory with a single read.
-  scoped_ptr<char[]> buf(new char[current_size]);
-  return index_->Read(buf.get(), current_size, 0);
-}
-
-int BackendImplV3::CheckAllEntries() {
-  int num_dirty = 0;
-  int num_entries = 0;
-  DCHECK(mask_ < kuint32max);
-  for (unsigned int i = 0; i <= mask_; i++) {
-    Addr address(data_->table[i]);
-    if (!address.is_initialized())
-      continue;
-    for (;;) {
-      EntryImpl* tmp;
-      int ret = NewEntry(address, &tmp);
-      if (ret) {
-        STRESS_NOTREACHED();
-        return ret;
-      }
-      scoped_refptr<EntryImpl> cache_entry;
-      cache_entry.swap(&tmp);
-
-      if (cache_entry->dirty())
-        num_dirty++;
-      else if (CheckEntry(cache_entry.get()))
-        num_entries++;
-      else
-        return ERR_INVALID_ENTRY;
-
-      DCHECK_EQ(i, cache_entry->entry()->Data()->hash & mask_);
-      address.set_value(cache_entry->GetNextAddress());
-      if (!address.is_initialized())
-        break;
-    }
-  }
-
-  Trace("CheckAllEntries End");
-  if (num_entries + num_dirty != data_->header.num_entries) {
-    LOG(ERROR) << "Number of entries " << num_entries << " " << num_dirty <<
-                  " " << data_->header.num_entries;
-    DCHECK_LT(num_entries, data_->header.num_entries);
-    return ERR_NUM_ENTRIES_MISMATCH;
-  }
-
-  return num_dirty;
-}
-
-bool BackendImplV3::CheckEntry(EntryImpl* cache_entry) {
-  bool ok = block_files_.IsValid(cache_entry->entry()->address());
-  ok = ok && block_files_.IsValid(cache_entry->rankings()->address());
-  EntryStore* data = cache_entry->entry()->Data();
-  for (size_t i = 0; i < arraysize(data->data_addr); i++) {
-    if (data->data_addr[i]) {
-      Addr address(data->data_addr[i]);
-      if (address.is_block_file())
-        ok = ok && block_files_.IsValid(address);
-    }
-  }
-
-  return ok && cache_entry->rankings()->VerifyHash();
-}
-
 int BackendImplV3::MaxBuffersSize() {
   static int64 total_memory = base::SysInfo::AmountOfPhysicalMemory();
   static bool done = false;
@@ -1464,72 +1855,4 @@ int BackendImplV3::MaxBuffersSize() {
   return static_cast<int>(total_memory);
 }
 
-#endif  // defined(V3_NOT_JUST_YET_READY).
-
-bool BackendImplV3::IsAllocAllowed(int current_size, int new_size) {
-  return false;
-}
-
-net::CacheType BackendImplV3::GetCacheType() const {
-  return cache_type_;
-}
-
-int32 BackendImplV3::GetEntryCount() const {
-  return 0;
-}
-
-int BackendImplV3::OpenEntry(const std::string& key, Entry** entry,
-                             const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int BackendImplV3::CreateEntry(const std::string& key, Entry** entry,
-                               const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int BackendImplV3::DoomEntry(const std::string& key,
-                             const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int BackendImplV3::DoomAllEntries(const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int BackendImplV3::DoomEntriesBetween(base::Time initial_time,
-                                      base::Time end_time,
-                                      const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int BackendImplV3::DoomEntriesSince(base::Time initial_time,
-                                    const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-
-class BackendImplV3::NotImplementedIterator : public Backend::Iterator {
- public:
-  int OpenNextEntry(disk_cache::Entry** next_entry,
-                    const net::CompletionCallback& callback) override {
-    return net::ERR_NOT_IMPLEMENTED;
-  }
-};
-
-scoped_ptr<Backend::Iterator> BackendImplV3::CreateIterator() {
-  return scoped_ptr<Iterator>(new NotImplementedIterator());
-}
-
-void BackendImplV3::GetStats(StatsItems* stats) {
-  NOTIMPLEMENTED();
-}
-
-void BackendImplV3::OnExternalCacheHit(const std::string& key) {
-  NOTIMPLEMENTED();
-}
-
-void BackendImplV3::CleanupCache() {
-}
-
 }  // namespace disk_cache
@@ -7,11 +7,16 @@
 #ifndef NET_DISK_CACHE_BLOCKFILE_BACKEND_IMPL_V3_H_
 #define NET_DISK_CACHE_BLOCKFILE_BACKEND_IMPL_V3_H_
 
+#include <set>
+#include <utility>
+
 #include "base/containers/hash_tables.h"
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/timer/timer.h"
-#include "net/disk_cache/blockfile/block_bitmaps_v3.h"
 #include "net/disk_cache/blockfile/block_files.h"
 #include "net/disk_cache/blockfile/eviction_v3.h"
 #include "net/disk_cache/blockfile/index_table_v3.h"
@@ -25,16 +30,25 @@ class SingleThreadTaskRunner;
 }  // namespace base
 
 namespace net {
+class IOBuffer;
 class NetLog;
 }  // namespace net
 
 namespace disk_cache {
 
 class EntryImplV3;
+class MappedFile;
 
 // This class implements the Backend interface. An object of this
 // class handles the operations of the cache for a particular profile.
-class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
+//
+// Every operation is performed on the cache thread, while the public interface
+// is used from the thread that creates this object. The index and the entry
+// records are only touched by the cache thread, so operations are serialized
+// there, but the user data is read and written with asynchronous file IO, so
+// the data for multiple operations can be in flight at the same time.
+class NET_EXPORT_PRIVATE BackendImplV3 : public Backend,
+                                         public IndexTableBackend {
  public:
   enum BackendFlags {
     MAX_SIZE = 1 << 1,            // A maximum size was provided.
@@ -47,6 +61,9 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
     NO_CLEAN_ON_EXIT = 1 << 8     // Avoid saving data at exit time.
   };
 
+  // Moves operations to the cache thread (see backend_worker_v3.h).
+  class Worker;
+
   BackendImplV3(const base::FilePath& path,
                 const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread,
                 net::NetLog* net_log);
@@ -65,12 +82,36 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   bool CreateBlock(FileType block_type, int block_count,
                    Addr* block_address);
 
+  // Deletes a given storage block. |deep| set to true can be used to zero-fill
+  // the related storage in addition of releasing the related block.
+  void DeleteBlock(Addr block_address, bool deep);
+
+  // Returns the block file that stores |address|.
+  MappedFile* File(Addr address);
+
+  // Returns the full name for an external storage file.
+  base::FilePath GetFileName(Addr address) const;
+
+  // Creates a new external storage file, returning its address.
+  bool CreateExternalFile(Addr* address);
+
+  // Synchronous implementation of the methods that open or create entries for
+  // the sparse code, returning an entry with an extra reference, or NULL.
+  EntryImplV3* OpenEntryImpl(const std::string& key);
+  EntryImplV3* CreateEntryImpl(const std::string& key);
+  int SyncDoomEntry(const std::string& key);
+
   // Updates the ranking information for an entry.
   void UpdateRank(EntryImplV3* entry, bool modified);
 
   // Permanently deletes an entry, but still keeps track of it.
   void InternalDoomEntry(EntryImplV3* entry);
 
+  // Notifications from an entry that is being closed, or whose data is being
+  // deleted from the cache.
+  void OnEntryClosed(EntryImplV3* entry);
+  void RemoveEntry(EntryImplV3* entry);
+
   // This method must be called when an entry is released for the last time, so
   // the entry should not be used anymore. |address| is the cache address of the
   // entry.
@@ -85,9 +126,6 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   // ref counter for the entry.
   EntryImplV3* GetOpenEntry(Addr address) const;
 
-  // Returns the id being used on this run of the cache.
-  int32 GetCurrentEntryId() const;
-
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
@@ -108,6 +146,10 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
     return buffer_bytes_;
   }
 
+  // Keeps track of the number of asynchronous IO operations in progress.
+  void IncrementIoCount();
+  void DecrementIoCount();
+
   // Returns true if this instance seems to be under heavy load.
   bool IsLoaded() const;
 
@@ -159,17 +201,14 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   // Sends a dummy operation through the operation queue, for unit tests.
   int FlushQueueForTest(const CompletionCallback& callback);
 
-  // Trims an entry (all if |empty| is true) from the list of deleted
-  // entries. This method should be called directly on the cache thread.
-  void TrimForTest(bool empty);
+  // Runs the provided task on the cache thread. The task will be automatically
+  // deleted after it runs.
+  int RunTaskForTest(const base::Closure& task,
+                     const CompletionCallback& callback);
 
-  // Trims an entry (all if |empty| is true) from the list of deleted
-  // entries. This method should be called directly on the cache thread.
-  void TrimDeletedListForTest(bool empty);
-
-  // Performs a simple self-check, and returns the number of dirty items
-  // or an error code (negative value).
-  int SelfCheck();
+  // Trims an entry (all if |empty| is true) from the cache. This method should
+  // be called directly on the cache thread.
+  void TrimForTest(bool empty);
 
   // Backend implementation.
   net::CacheType GetCacheType() const override;
@@ -192,27 +231,78 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   void GetStats(StatsItems* stats) override;
   void OnExternalCacheHit(const std::string& key) override;
 
+  // IndexTableBackend implementation.
+  void GrowIndex() override;
+  void SaveIndex(net::IOBuffer* buffer, int buffer_len) override;
+  void DeleteCell(EntryCell cell) override;
+  void FixCell(EntryCell cell) override;
+
  private:
   friend class EvictionV3;
   typedef base::hash_map<CacheAddr, EntryImplV3*> EntriesMap;
+  typedef std::pair<uint32, CacheAddr> CellKey;
   class IteratorImpl;
-  class NotImplementedIterator;
-  class Worker;
+  struct Enumeration;
+
+  // Performs the actual initialization and final cleanup on destruction.
+  int SyncInit();
+  void CleanupCache();
 
+  // Synchronous implementation of the asynchronous interface.
+  int SyncOpenEntry(const std::string& key, Entry** entry);
+  int SyncCreateEntry(const std::string& key, Entry** entry);
+  int SyncDoomAllEntries();
+  int SyncDoomEntriesBetween(base::Time initial_time, base::Time end_time);
+  int SyncDoomEntriesSince(base::Time initial_time);
+  int SyncOpenNextEntry(Enumeration* enumeration, Entry** next_entry);
+  void SyncOnExternalCacheHit(const std::string& key);
+
+  // Creates, maps or validates the files that back the index.
+  bool InitBackingStore(bool* file_created);
+  bool CreateBackingStore();
+  bool LoadBackingStore();
+  void CloseBackingStore();
   void AdjustMaxCacheSize();
-  bool InitStats(void* stats_data);
+  bool InitStats();
   void StoreStats();
 
+  // Extends the index files and reinitializes the index with the new tables.
+  void GrowIndexNow();
+
+  // Moves the files of a cache from the previous version out of the way, and
+  // imports its entries once this cache is running.
+  bool MoveV2Cache(const base::FilePath& old_path);
+  void UpgradeFromV2(const base::FilePath& old_path);
+
   // Deletes the cache and starts again.
   void RestartCache(bool failure);
   void PrepareForRestart();
 
-  // Performs final cleanup.
-  void CleanupCache();
+  // Creates a new entry object for the entry stored at |address|. Returns zero
+  // on success, or a disk_cache error on failure.
+  int NewEntry(Addr address, uint32 hash, EntryImplV3** entry);
+
+  // Returns the entry referenced by |cell| (with an extra reference), or NULL.
+  EntryImplV3* OpenCell(const EntryCell& cell);
+  EntryImplV3* GetEnumeratedEntry(const CellInfo& cell_info);
 
-  // Creates a new entry object. Returns zero on success, or a disk_cache error
-  // on failure.
-  int NewEntry(Addr address, EntryImplV3** entry);
+  // Returns the entry that matches |key| (with an extra reference), or NULL.
+  EntryImplV3* LookupEntry(const std::string& key, uint32 hash);
+
+  // Deals with a cell that was left in an intermediate state by a crash.
+  // Returns false if the cell should be ignored.
+  bool CheckDirtyCell(const EntryCell& cell);
+
+  // Removes a corrupt entry (in USED state) from the cache.
+  void DiscardCell(uint32 hash, Addr address);
+
+  // Deletes the data of an entry whose cell is already in the DELETED state.
+  void DeleteStaleEntry(uint32 hash, Addr address);
+  void DeleteCellNow(uint32 hash, Addr address);
+  void FixCellNow(uint32 hash, Addr address);
+
+  // Sorts |cells| by the last time each entry was used.
+  void SortCells(CellList* cells, bool oldest_first);
 
   // Handles the used storage count.
   void AddStorageSize(int32 bytes);
@@ -233,26 +323,22 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   // Reports an uncommon, recoverable error.
   void ReportError(int error);
 
-  // Performs basic checks on the index file. Returns false on failure.
-  bool CheckIndex();
-
-  // Part of the self test. Returns the number or dirty entries, or an error.
-  int CheckAllEntries();
-
-  // Part of the self test. Returns false if the entry is corrupt.
-  bool CheckEntry(EntryImplV3* cache_entry);
-
   // Returns the maximum total memory for the memory buffers.
   int MaxBuffersSize();
 
   IndexTable index_;
   base::FilePath path_;  // Path to the folder used as backing storage.
-  BlockBitmaps block_files_;
+  BlockFiles block_files_;  // Set of files used to store all data.
+  scoped_refptr<MappedFile> index_file_;  // Header and bitmap of the index.
+  scoped_refptr<MappedFile> main_table_file_;
+  scoped_refptr<MappedFile> extra_table_file_;
   int32 max_size_;  // Maximum data size for this instance.
   EvictionV3 eviction_;  // Handler of the eviction algorithm.
   EntriesMap open_entries_;
+  std::set<CellKey> pending_cells_;  // Cells scheduled to be deleted or fixed.
   int num_refs_;  // Number of referenced cache entries.
   int max_refs_;  // Max number of referenced cache entries.
+  int num_pending_io_;  // Number of pending IO operations.
   int entry_count_;  // Number of entries accessed lately.
   int byte_count_;  // Number of bytes read/written lately.
   int buffer_bytes_;  // Total size of the temporary entries' buffers.
@@ -267,12 +353,15 @@ class NET_EXPORT_PRIVATE BackendImplV3 : public Backend {
   bool lru_eviction_;  // What eviction algorithm should be used.
   bool first_timer_;  // True if the timer has not been called.
   bool user_load_;  // True if we see a high load coming from the caller.
+  bool grow_pending_;  // True if the index has to grow.
 
   net::NetLog* net_log_;
 
   Stats stats_;  // Usage statistics.
   scoped_ptr<base::RepeatingTimer<BackendImplV3> > timer_;  // Usage timer.
   scoped_refptr<TraceObject> trace_object_;  // Initializes internal tracing.
+  scoped_ptr<Worker> worker_;  // Sends operations to the cache thread.
+  base::WaitableEvent done_;  // Signals the end of background work.
   base::WeakPtrFactory<BackendImplV3> ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(BackendImplV3);
@@ -7,12 +7,12 @@
 #ifndef NET_DISK_CACHE_BLOCKFILE_BACKEND_WORKER_V3_H_
 #define NET_DISK_CACHE_BLOCKFILE_BACKEND_WORKER_V3_H_
 
-#include "base/containers/hash_tables.h"
-#include "base/files/file_path.h"
+#include "base/callback.h"
 #include "base/memory/ref_counted.h"
-#include "net/disk_cache/blockfile/addr.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl_v3.h"
-#include "net/disk_cache/blockfile/block_files.h"
+#include "net/disk_cache/blockfile/in_flight_io.h"
 
 namespace base {
 class SingleThreadTaskRunner;
@@ -20,33 +20,66 @@ class SingleThreadTaskRunner;
 
 namespace disk_cache {
 
-class BackendImplV3::Worker : public base::RefCountedThreadSafe<Worker> {
+class Entry;
+
+// The Worker moves the operations requested on the primary thread to the
+// dedicated cache thread, and delivers the results back to the primary thread.
+// All the work on the index and entry records is performed on the cache
+// thread, one operation at a time, while the user data of different entries
+// is read and written through asynchronous file IO, so multiple operations can
+// have their data in flight at the same time.
+//
+// The Worker must be created and used on the primary thread.
+class BackendImplV3::Worker : public InFlightIO {
  public:
-  Worker(const base::FilePath& path,
-         const scoped_refptr<base::SingleThreadTaskRunner>& main_thread);
+  // A task that completes synchronously, returning a net error code.
+  typedef base::Callback<int(void)> Task;
 
-  // Performs general initialization for this current instance of the cache.
-  int Init(const CompletionCallback& callback);
+  // A task that may complete asynchronously, in which case it returns
+  // net::ERR_IO_PENDING and invokes the provided callback later.
+  typedef base::Callback<int(const CompletionCallback&)> EntryTask;
 
- private:
-  friend class base::RefCountedThreadSafe<Worker>;
+  explicit Worker(
+      const scoped_refptr<base::SingleThreadTaskRunner>& background_thread);
+  ~Worker() override;
+
+  // Runs |task| on the cache thread, without waiting for any result.
+  void PostTask(const base::Closure& task);
+
+  // Runs |task| on the cache thread, and invokes |callback| on this thread
+  // with the result.
+  void PostOperation(const Task& task, const CompletionCallback& callback);
+
+  // Runs |task| on the cache thread. |task| returns an entry through |entry|
+  // when it succeeds, and that entry is bound to this object before invoking
+  // |callback|.
+  void PostEntryOperation(const Task& task, Entry** entry,
+                          const CompletionCallback& callback);
 
-  ~Worker();
-  void CleanupCache();
+  // Runs |task| on the cache thread, and invokes |callback| on this thread
+  // when the task completes (maybe asynchronously).
+  void PostEntryTask(const EntryTask& task, const CompletionCallback& callback);
 
-  // Returns the full name for an external storage file.
-  base::FilePath GetFileName(Addr address) const;
+  // Returns true if the current thread is the cache thread.
+  bool BackgroundIsCurrentThread() const;
 
-  // Creates a new backing file for the cache index.
-  bool CreateBackingStore(disk_cache::File* file);
-  bool InitBackingStore(bool* file_created);
+  base::SingleThreadTaskRunner* background_thread() {
+    return background_thread_.get();
+  }
+
+  base::WeakPtr<Worker> GetWeakPtr();
+
+ protected:
+  // InFlightIO implementation.
+  void OnOperationComplete(BackgroundIO* operation, bool cancel) override;
+
+ private:
+  class Operation;
 
-  // Performs basic checks on the index file. Returns false on failure.
-  bool CheckIndex();
+  void PostOperation(Operation* operation);
 
-  base::FilePath path_;  // Path to the folder used as backing storage.
-  BlockFiles block_files_;  // Set of files used to store all data.
-  bool init_;  // controls the initialization of the system.
+  scoped_refptr<base::SingleThreadTaskRunner> background_thread_;
+  base::WeakPtrFactory<Worker> ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(Worker);
 };
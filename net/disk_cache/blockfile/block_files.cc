@@ -262,7 +262,7 @@ BlockFileHeader* BlockHeader::Header() {
 // ------------------------------------------------------------------------
 
 BlockFiles::BlockFiles(const base::FilePath& path)
-    : init_(false), zero_buffer_(NULL), path_(path) {
+    : init_(false), v3_format_(false), zero_buffer_(NULL), path_(path) {
 }
 
 BlockFiles::~BlockFiles() {
@@ -271,6 +271,11 @@ BlockFiles::~BlockFiles() {
   CloseFiles();
 }
 
+void BlockFiles::SetV3Format() {
+  DCHECK(!init_);
+  v3_format_ = true;
+}
+
 bool BlockFiles::Init(bool create_files) {
   DCHECK(!init_);
   if (init_)
@@ -278,8 +283,8 @@ bool BlockFiles::Init(bool create_files) {
 
   thread_checker_.reset(new base::ThreadChecker);
 
-  block_files_.resize(kFirstAdditionalBlockFile);
-  for (int16 i = 0; i < kFirstAdditionalBlockFile; i++) {
+  block_files_.resize(NumBaseFiles());
+  for (int16 i = 0; i < NumBaseFiles(); i++) {
     if (create_files)
       if (!CreateBlockFile(i, static_cast<FileType>(i + 1), true))
         return false;
@@ -298,8 +303,7 @@ bool BlockFiles::Init(bool create_files) {
 
 MappedFile* BlockFiles::GetFile(Addr address) {
   DCHECK(thread_checker_->CalledOnValidThread());
-  DCHECK_GE(block_files_.size(),
-            static_cast<size_t>(kFirstAdditionalBlockFile));
+  DCHECK_GE(block_files_.size(), static_cast<size_t>(NumBaseFiles()));
   DCHECK(address.is_block_file() || !address.is_initialized());
   if (!address.is_initialized())
     return NULL;
@@ -319,9 +323,11 @@ bool BlockFiles::CreateBlock(FileType block_type, int block_count,
                              Addr* block_address) {
   DCHECK(thread_checker_->CalledOnValidThread());
   DCHECK_NE(block_type, EXTERNAL);
-  DCHECK_NE(block_type, BLOCK_FILES);
-  DCHECK_NE(block_type, BLOCK_ENTRIES);
-  DCHECK_NE(block_type, BLOCK_EVICTED);
+  if (!v3_format_) {
+    DCHECK_NE(block_type, BLOCK_FILES);
+    DCHECK_NE(block_type, BLOCK_ENTRIES);
+    DCHECK_NE(block_type, BLOCK_EVICTED);
+  }
   if (block_count < 1 || block_count > kMaxNumBlocks)
     return false;
 
@@ -339,6 +345,12 @@ bool BlockFiles::CreateBlock(FileType block_type, int block_count,
   if (!file_header.CreateMapBlock(block_count, &index))
     return false;
 
+  if (!index && (block_type == BLOCK_ENTRIES || block_type == BLOCK_EVICTED) &&
+      !file_header.CreateMapBlock(block_count, &index)) {
+    // index 0 for entries is a reserved value.
+    return false;
+  }
+
   Addr address(block_type, block_count, file_header.FileId(), index);
   block_address->set_value(address.value());
   Trace("CreateBlock 0x%x", address.value());
@@ -372,11 +384,7 @@ void BlockFiles::DeleteBlock(Addr address, bool deep) {
 
   if (!file_header.Header()->num_entries) {
     // This file is now empty. Let's try to delete it.
-    FileType type = Addr::RequiredFileType(file_header.Header()->entry_size);
-    if (Addr::BlockSizeForFileType(RANKINGS) ==
-        file_header.Header()->entry_size) {
-      type = RANKINGS;
-    }
+    FileType type = FileTypeForEntrySize(file_header.Header()->entry_size);
     RemoveEmptyFile(type);  // Ignore failures.
   }
 }
@@ -455,7 +463,7 @@ bool BlockFiles::CreateBlockFile(int index, FileType file_type, bool force) {
   BlockFileHeader header;
   memset(&header, 0, sizeof(header));
   header.magic = kBlockMagic;
-  header.version = kBlockVersion2;
+  header.version = v3_format_ ? kBlockCurrentVersion : kBlockVersion2;
   header.entry_size = Addr::BlockSizeForFileType(file_type);
   header.this_file = static_cast<int16>(index);
   DCHECK(index <= kint16max && index >= 0);
@@ -486,7 +494,8 @@ bool BlockFiles::OpenBlockFile(int index) {
 
   BlockHeader file_header(file.get());
   BlockFileHeader* header = file_header.Header();
-  if (kBlockMagic != header->magic || kBlockVersion2 != header->version) {
+  uint32 version = v3_format_ ? kBlockCurrentVersion : kBlockVersion2;
+  if (kBlockMagic != header->magic || version != header->version) {
     LOG(ERROR) << "Invalid file version or magic " << name.value();
     return false;
   }
@@ -576,12 +585,7 @@ MappedFile* BlockFiles::NextFile(MappedFile* file) {
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
   int16 new_file = header->next_file;
   if (!new_file) {
-    // RANKINGS is not reported as a type for small entries, but we may be
-    // extending the rankings block file.
-    FileType type = Addr::RequiredFileType(header->entry_size);
-    if (header->entry_size == Addr::BlockSizeForFileType(RANKINGS))
-      type = RANKINGS;
-
+    FileType type = FileTypeForEntrySize(header->entry_size);
     new_file = CreateNextBlockFile(type);
     if (!new_file)
       return NULL;
@@ -596,7 +600,7 @@ MappedFile* BlockFiles::NextFile(MappedFile* file) {
 }
 
 int16 BlockFiles::CreateNextBlockFile(FileType block_type) {
-  for (int16 i = kFirstAdditionalBlockFile; i <= kMaxBlockFile; i++) {
+  for (int16 i = NumBaseFiles(); i <= kMaxBlockFile; i++) {
     if (CreateBlockFile(i, block_type, false))
       return i;
   }
@@ -657,9 +661,11 @@ bool BlockFiles::FixBlockFileHeader(MappedFile* file) {
     return false;  // file_size > 2GB is also an error.
 
   const int kMinHeaderBlockSize = 36;
+  const int kMinHeaderBlockSizeV3 = 8;
   const int kMaxHeaderBlockSize = 4096;
   BlockFileHeader* header = file_header.Header();
-  if (header->entry_size < kMinHeaderBlockSize ||
+  int min_block_size = v3_format_ ? kMinHeaderBlockSizeV3 : kMinHeaderBlockSize;
+  if (header->entry_size < min_block_size ||
       header->entry_size > kMaxHeaderBlockSize || header->num_entries < 0)
     return false;
 
@@ -728,4 +734,23 @@ base::FilePath BlockFiles::Name(int index) {
   return path_.AppendASCII(tmp);
 }
 
+int BlockFiles::NumBaseFiles() const {
+  return v3_format_ ? static_cast<int>(kFirstAdditionalBlockFileV3) :
+                      kFirstAdditionalBlockFile;
+}
+
+// static
+FileType BlockFiles::FileTypeForEntrySize(int entry_size) {
+  // The types that store small records are not reported by RequiredFileType(),
+  // but we may be dealing with one of their files.
+  const FileType kRecordTypes[] = {
+    RANKINGS, BLOCK_FILES, BLOCK_ENTRIES, BLOCK_EVICTED
+  };
+  for (size_t i = 0; i < arraysize(kRecordTypes); i++) {
+    if (entry_size == Addr::BlockSizeForFileType(kRecordTypes[i]))
+      return kRecordTypes[i];
+  }
+  return Addr::RequiredFileType(entry_size);
+}
+
 }  // namespace disk_cache
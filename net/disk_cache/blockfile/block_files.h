@@ -93,6 +93,11 @@ class NET_EXPORT_PRIVATE BlockFiles {
   explicit BlockFiles(const base::FilePath& path);
   ~BlockFiles();
 
+  // Makes this object use the set of files of the v3 disk format, which adds
+  // the files for entry records (see disk_format_v3.h). Must be called before
+  // Init().
+  void SetV3Format();
+
   // Performs the object initialization. create_files indicates if the backing
   // files should be created or just open.
   bool Init(bool create_files);
@@ -150,7 +155,14 @@ class NET_EXPORT_PRIVATE BlockFiles {
   // Returns the filename for a given file index.
   base::FilePath Name(int index);
 
+  // Returns the number of files that are always present on this set.
+  int NumBaseFiles() const;
+
+  // Returns the type of block stored by a file with |entry_size| blocks.
+  static FileType FileTypeForEntrySize(int entry_size);
+
   bool init_;
+  bool v3_format_;
   char* zero_buffer_;  // Buffer to speed-up cleaning deleted entries.
   base::FilePath path_;  // Path to the backing folder.
   std::vector<MappedFile*> block_files_;  // The actual files.
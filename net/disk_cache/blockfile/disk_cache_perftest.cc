@@ -3,12 +3,16 @@
 // found in the LICENSE file.
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file_util.h"
 #include "base/hash.h"
+#include "base/run_loop.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
 #include "base/test/perf_time_logger.h"
 #include "base/test/test_file_util.h"
 #include "base/threading/thread.h"
@@ -21,7 +25,11 @@
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_compression.h"
+#include "net/disk_cache/simple/simple_io_ring.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
 #include "testing/platform_test.h"
 
 using base::Time;
@@ -138,6 +146,194 @@ bool TimeRead(int num_entries, disk_cache::Backend* cache,
   return (expected == helper.callbacks_called());
 }
 
+// Counts down |*outstanding| IO operations, and quits with |quit| once they
+// are all done.
+void ConcurrentIOComplete(int* outstanding,
+                          int expected_result,
+                          bool* failed,
+                          const base::Closure& quit,
+                          int result) {
+  if (result != expected_result)
+    *failed = true;
+  if (--*outstanding == 0)
+    quit.Run();
+}
+
+// Starts |buf_len| bytes of IO on stream 1 of each of |entries| at once, and
+// waits for all of it, |rounds| times.
+bool TimeConcurrentIO(const std::vector<disk_cache::Entry*>& entries,
+                      bool write,
+                      net::IOBuffer* buffer,
+                      int buf_len,
+                      int rounds,
+                      const std::string& message) {
+  bool failed = false;
+  base::PerfTimeLogger timer(message.c_str());
+  for (int round = 0; round < rounds && !failed; ++round) {
+    base::RunLoop run_loop;
+    int outstanding = 1;
+    net::CompletionCallback callback =
+        base::Bind(&ConcurrentIOComplete, &outstanding, buf_len, &failed,
+                   run_loop.QuitClosure());
+    for (size_t i = 0; i < entries.size(); ++i) {
+      int ret = write ? entries[i]->WriteData(1, 0, buffer, buf_len, callback,
+                                              false)
+                      : entries[i]->ReadData(1, 0, buffer, buf_len, callback);
+      if (net::ERR_IO_PENDING == ret)
+        outstanding++;
+      else if (buf_len != ret)
+        failed = true;
+    }
+    if (--outstanding)
+      run_loop.Run();
+  }
+  timer.Done();
+
+  return !failed;
+}
+
+// Keeps many simple cache entries open and reads and writes all of them at
+// once, through the worker pool or through an io_uring.
+bool TimeSimpleCacheConcurrentIO(const base::FilePath& path,
+                                 bool use_io_ring) {
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(base::MessageLoop::TYPE_IO, 0))) {
+    return false;
+  }
+  // The app cache does not complete writes optimistically, so that their IO
+  // is timed.
+  disk_cache::SimpleBackendImpl cache(path, 0, net::APP_CACHE,
+                                      cache_thread.task_runner(), NULL);
+  cache.set_use_io_ring(use_io_ring);
+  net::TestCompletionCallback cb;
+  if (net::OK != cb.GetResult(cache.Init(cb.callback())))
+    return false;
+
+  const int kNumEntries = 500;
+  std::vector<disk_cache::Entry*> entries;
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* cache_entry;
+    int rv = cache.CreateEntry(GenerateKey(true), &cache_entry, cb.callback());
+    if (net::OK != cb.GetResult(rv))
+      break;
+    entries.push_back(cache_entry);
+  }
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kMaxSize));
+  CacheTestFillBuffer(buffer->data(), kMaxSize, false);
+  const std::string engine = use_io_ring ? "io_uring" : "worker pool";
+  bool result =
+      static_cast<int>(entries.size()) == kNumEntries &&
+      TimeConcurrentIO(entries, true, buffer.get(), kMaxSize, 4,
+                       "Write simple cache entries concurrently (" + engine +
+                           ")") &&
+      TimeConcurrentIO(entries, false, buffer.get(), kMaxSize, 20,
+                       "Read simple cache entries concurrently (" + engine +
+                           ")");
+
+  for (size_t i = 0; i < entries.size(); ++i)
+    entries[i]->Close();
+  base::MessageLoop::current()->RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  return result;
+}
+
+// Writes entries with a body that compresses about as well as a text response
+// to a simple cache compressed with |codec|, then reads them back whole and a
+// piece at a time, and reports how much disk they take up.
+bool TimeSimpleCacheCompression(const base::FilePath& path,
+                                disk_cache::SimpleCompressionCodec codec) {
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(base::MessageLoop::TYPE_IO, 0))) {
+    return false;
+  }
+  const std::string codec_name =
+      codec == disk_cache::SIMPLE_COMPRESSION_NONE ? "none" : "deflate";
+  const int kNumEntries = 200;
+  const int kBodySize = 64 * 1024;
+  std::string body;
+  for (int i = 0; static_cast<int>(body.size()) < kBodySize; ++i) {
+    body += base::StringPrintf(
+        "<tr><td class=\"name\">row %d</td><td>%d</td></tr>\n", i,
+        (i * 7919) % 10000);
+  }
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kBodySize));
+  memcpy(buffer->data(), body.data(), kBodySize);
+
+  std::vector<std::string> keys;
+  net::TestCompletionCallback cb;
+  {
+    disk_cache::SimpleBackendImpl cache(path, 0, net::DISK_CACHE,
+                                        cache_thread.task_runner(), NULL);
+    cache.set_compression_codec(codec);
+    if (net::OK != cb.GetResult(cache.Init(cb.callback())))
+      return false;
+    base::PerfTimeLogger timer(
+        ("Write simple cache entries (" + codec_name + ")").c_str());
+    for (int i = 0; i < kNumEntries; ++i) {
+      keys.push_back(GenerateKey(true));
+      disk_cache::Entry* cache_entry;
+      int rv = cache.CreateEntry(keys.back(), &cache_entry, cb.callback());
+      if (net::OK != cb.GetResult(rv))
+        return false;
+      rv = cache_entry->WriteData(1, 0, buffer.get(), kBodySize, cb.callback(),
+                                  false);
+      cache_entry->Close();
+      if (kBodySize != cb.GetResult(rv))
+        return false;
+    }
+    base::MessageLoop::current()->RunUntilIdle();
+    disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+    timer.Done();
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+  cache_thread.Stop();
+  const int64 disk_size = base::ComputeDirectorySize(path);
+  perf_test::PrintResult("simple_cache_disk_usage", "", codec_name,
+                         static_cast<size_t>(disk_size), "bytes", true);
+  perf_test::PrintResult("simple_cache_disk_usage", "", "data",
+                         static_cast<size_t>(kNumEntries * kBodySize), "bytes",
+                         false);
+
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(base::MessageLoop::TYPE_IO, 0))) {
+    return false;
+  }
+  disk_cache::SimpleBackendImpl cache(path, 0, net::DISK_CACHE,
+                                      cache_thread.task_runner(), NULL);
+  cache.set_compression_codec(codec);
+  if (net::OK != cb.GetResult(cache.Init(cb.callback())))
+    return false;
+  bool result = true;
+  for (int piece_reads = 0; piece_reads < 2 && result; ++piece_reads) {
+    const int buf_len = piece_reads ? 2048 : kBodySize;
+    base::PerfTimeLogger timer(
+        base::StringPrintf("Read simple cache entries %s (%s)",
+                           piece_reads ? "in pieces" : "whole",
+                           codec_name.c_str()).c_str());
+    for (int i = 0; i < kNumEntries && result; ++i) {
+      disk_cache::Entry* cache_entry;
+      int rv = cache.OpenEntry(keys[i], &cache_entry, cb.callback());
+      if (net::OK != cb.GetResult(rv)) {
+        result = false;
+        break;
+      }
+      const int offset = piece_reads ? rand() % (kBodySize - buf_len) : 0;
+      rv = cache_entry->ReadData(1, offset, buffer.get(), buf_len,
+                                 cb.callback());
+      result = buf_len == cb.GetResult(rv) &&
+               !memcmp(body.data() + offset, buffer->data(), buf_len);
+      cache_entry->Close();
+    }
+    timer.Done();
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  return result;
+}
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
@@ -217,6 +413,25 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   base::MessageLoop::current()->RunUntilIdle();
 }
 
+TEST_F(DiskCacheTest, SimpleCacheConcurrentIOPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  EXPECT_TRUE(TimeSimpleCacheConcurrentIO(cache_path_, false));
+
+  if (!disk_cache::SimpleIORing::Get())
+    return;
+  ASSERT_TRUE(CleanupCacheDir());
+  EXPECT_TRUE(TimeSimpleCacheConcurrentIO(cache_path_, true));
+}
+
+TEST_F(DiskCacheTest, SimpleCacheCompressionPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  EXPECT_TRUE(TimeSimpleCacheCompression(cache_path_,
+                                         disk_cache::SIMPLE_COMPRESSION_NONE));
+  ASSERT_TRUE(CleanupCacheDir());
+  EXPECT_TRUE(TimeSimpleCacheCompression(
+      cache_path_, disk_cache::SIMPLE_COMPRESSION_DEFLATE));
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
@@ -4,6 +4,7 @@
 
 #include "net/disk_cache/blockfile/entry_impl_v3.h"
 
+#include "base/bind.h"
 #include "base/hash.h"
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram.h"
@@ -11,12 +12,13 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/blockfile/backend_impl_v3.h"
+#include "net/disk_cache/blockfile/backend_worker_v3.h"
 #include "net/disk_cache/blockfile/bitmap.h"
 #include "net/disk_cache/blockfile/disk_format_v3.h"
 #include "net/disk_cache/blockfile/histogram_macros_v3.h"
+#include "net/disk_cache/blockfile/sparse_control_v3.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/net_log_parameters.h"
-// #include "net/disk_cache/blockfile/sparse_control_v3.h"
 
 // Provide a BackendImpl object to macros from histogram_macros.h.
 #define CACHE_UMA_BACKEND_IMPL_OBJ backend_
@@ -27,15 +29,67 @@ using base::TimeTicks;
 
 namespace {
 
+// Index for the file used to store the key (files_[kKeyFileIndex]). The key is
+// also tracked by data_addr[kKeyFileIndex] of the entry record.
+const int kKeyFileIndex = 3;
+
+// This class implements FileIOCallback to buffer the callback from a file IO
+// operation from the actual net class.
+class SyncCallback: public disk_cache::FileIOCallback {
+ public:
+  // |end_event_type| is the event type to log on completion.  Logs nothing on
+  // discard, or when the NetLog is not set to log all events.
+  SyncCallback(disk_cache::EntryImplV3* entry, net::IOBuffer* buffer,
+               const net::CompletionCallback& callback,
+               net::NetLog::EventType end_event_type)
+      : entry_(entry), callback_(callback), buf_(buffer),
+        start_(TimeTicks::Now()), end_event_type_(end_event_type) {
+    entry->AddRef();
+    entry->IncrementIoCount();
+  }
+  ~SyncCallback() override {}
+
+  void OnFileIOComplete(int bytes_copied) override;
+  void Discard();
+
+ private:
+  disk_cache::EntryImplV3* entry_;
+  net::CompletionCallback callback_;
+  scoped_refptr<net::IOBuffer> buf_;
+  TimeTicks start_;
+  const net::NetLog::EventType end_event_type_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyncCallback);
+};
+
+void SyncCallback::OnFileIOComplete(int bytes_copied) {
+  entry_->DecrementIoCount();
+  if (!callback_.is_null()) {
+    if (entry_->net_log().IsLogging()) {
+      entry_->net_log().EndEvent(
+          end_event_type_,
+          disk_cache::CreateNetLogReadWriteCompleteCallback(bytes_copied));
+    }
+    entry_->ReportIOTime(disk_cache::EntryImplV3::kAsyncIO, start_);
+    buf_ = NULL;  // Release the buffer before invoking the callback.
+    callback_.Run(bytes_copied);
+  }
+  entry_->Release();
+  delete this;
+}
+
+void SyncCallback::Discard() {
+  callback_.Reset();
+  buf_ = NULL;
+  OnFileIOComplete(0);
+}
+
 const int kMaxBufferSize = 1024 * 1024;  // 1 MB.
 
 }  // namespace
 
 namespace disk_cache {
 
-typedef StorageBlock<EntryRecord> CacheEntryBlockV3;
-typedef StorageBlock<ShortEntryRecord> CacheShortEntryBlock;
-
 // This class handles individual memory buffers that store data before it is
 // sent to disk. The buffer can start at any offset, but if we try to write to
 // anywhere in the first 16KB of the file (kMaxBlockSize), we set the offset to
@@ -48,7 +102,7 @@ class EntryImplV3::UserBuffer {
     buffer_.reserve(kMaxBlockSize);
   }
   ~UserBuffer() {
-    if (backend_)
+    if (backend_.get())
       backend_->BufferDeleted(capacity() - kMaxBlockSize);
   }
 
@@ -205,7 +259,7 @@ int EntryImplV3::UserBuffer::Read(int offset, IOBuffer* buf, int len) {
 
 void EntryImplV3::UserBuffer::Reset() {
   if (!grow_allowed_) {
-    if (backend_)
+    if (backend_.get())
       backend_->BufferDeleted(capacity() - kMaxBlockSize);
     grow_allowed_ = true;
     std::vector<char> tmp;
@@ -225,7 +279,7 @@ bool EntryImplV3::UserBuffer::GrowBuffer(int required, int limit) {
   if (required > limit)
     return false;
 
-  if (!backend_)
+  if (!backend_.get())
     return false;
 
   int to_add = std::max(required - current_size, kMaxBlockSize * 4);
@@ -245,70 +299,152 @@ bool EntryImplV3::UserBuffer::GrowBuffer(int required, int limit) {
 // ------------------------------------------------------------------------
 
 EntryImplV3::EntryImplV3(BackendImplV3* backend, Addr address, bool read_only)
-    : backend_(backend->GetWeakPtr()),
-      address_(address),
-      doomed_(false),
-      read_only_(read_only),
-      dirty_(true),
+    : entry_(NULL, Addr(0)),
+      backend_(backend->GetWeakPtr()), doomed_(false), read_only_(read_only),
       modified_(false) {
+  entry_.LazyInit(backend->File(address), address);
   for (int i = 0; i < kNumStreams; i++) {
     unreported_size_[i] = 0;
   }
 }
 
-#if defined(V3_NOT_JUST_YET_READY)
+void EntryImplV3::DoomImpl() {
+  if (doomed_ || !backend_.get())
+    return;
 
-bool EntryImplV3::CreateEntry(Addr node_address, const std::string& key,
-                              uint32 hash) {
-  Trace("Create entry In");
-  EntryStore* entry_store = entry_.Data();
-  RankingsNode* node = node_.Data();
-  memset(entry_store, 0, sizeof(EntryStore) * entry_.address().num_blocks());
-  memset(node, 0, sizeof(RankingsNode));
-  if (!node_.LazyInit(backend_->File(node_address), node_address))
-    return false;
+  backend_->InternalDoomEntry(this);
+}
 
-  entry_store->rankings_node = node_address.value();
-  node->contents = entry_.address().value();
+int EntryImplV3::ReadDataImpl(int index, int offset, IOBuffer* buf,
+                              int buf_len, const CompletionCallback& callback) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, false));
+  }
 
-  entry_store->hash = hash;
-  entry_store->creation_time = Time::Now().ToInternalValue();
-  entry_store->key_len = static_cast<int32>(key.size());
-  if (entry_store->key_len > kMaxInternalKeyLength) {
-    Addr address(0);
-    if (!CreateBlock(entry_store->key_len + 1, &address))
-      return false;
+  int result = InternalReadData(index, offset, buf, buf_len, callback);
 
-    entry_store->long_key = address.value();
-    File* key_file = GetBackingFile(address, kKeyFileIndex);
-    key_ = key;
+  if (result != net::ERR_IO_PENDING && net_log_.IsLogging()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        CreateNetLogReadWriteCompleteCallback(result));
+  }
+  return result;
+}
 
-    size_t offset = 0;
-    if (address.is_block_file())
-      offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
+int EntryImplV3::WriteDataImpl(int index, int offset, IOBuffer* buf,
+                               int buf_len, const CompletionCallback& callback,
+                               bool truncate) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, truncate));
+  }
 
-    if (!key_file || !key_file->Write(key.data(), key.size(), offset)) {
-      DeleteData(address, kKeyFileIndex);
-      return false;
-    }
+  int result = InternalWriteData(index, offset, buf, buf_len, callback,
+                                 truncate);
 
-    if (address.is_separate_file())
-      key_file->SetLength(key.size() + 1);
-  } else {
-    memcpy(entry_store->key, key.data(), key.size());
-    entry_store->key[key.size()] = '\0';
+  if (result != net::ERR_IO_PENDING && net_log_.IsLogging()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        CreateNetLogReadWriteCompleteCallback(result));
   }
-  backend_->ModifyStorageSize(0, static_cast<int32>(key.size()));
-  CACHE_UMA(COUNTS, "KeySize", 0, static_cast<int32>(key.size()));
-  node->dirty = backend_->GetCurrentEntryId();
-  Log("Create Entry ");
-  return true;
+  return result;
+}
+
+int EntryImplV3::ReadSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
+                                    const CompletionCallback& callback) {
+  int result = InitSparseData();
+  if (net::OK != result)
+    return result;
+
+  TimeTicks start = TimeTicks::Now();
+  result = sparse_->StartIO(SparseControlV3::kReadOperation, offset, buf,
+                            buf_len, callback);
+  ReportIOTime(kSparseRead, start);
+  return result;
+}
+
+int EntryImplV3::WriteSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
+                                     const CompletionCallback& callback) {
+  int result = InitSparseData();
+  if (net::OK != result)
+    return result;
+
+  TimeTicks start = TimeTicks::Now();
+  result = sparse_->StartIO(SparseControlV3::kWriteOperation, offset, buf,
+                            buf_len, callback);
+  ReportIOTime(kSparseWrite, start);
+  return result;
+}
+
+int EntryImplV3::GetAvailableRangeImpl(int64 offset, int len, int64* start) {
+  int result = InitSparseData();
+  if (net::OK != result)
+    return result;
+
+  return sparse_->GetAvailableRange(offset, len, start);
+}
+
+void EntryImplV3::CancelSparseIOImpl() {
+  if (!sparse_.get())
+    return;
+
+  sparse_->CancelIO();
+}
+
+int EntryImplV3::ReadyForSparseIOImpl(const CompletionCallback& callback) {
+  DCHECK(sparse_.get());
+  return sparse_->ReadyToUse(callback);
 }
 
 uint32 EntryImplV3::GetHash() {
   return entry_.Data()->hash;
 }
 
+bool EntryImplV3::CreateEntry(const std::string& key, uint32 hash) {
+  Trace("Create entry In");
+  EntryRecord* entry_record = entry_.Data();
+  memset(entry_record, 0, sizeof(EntryRecord));
+
+  Time current = Time::Now();
+  entry_record->hash = hash;
+  entry_record->state = ENTRY_USED;
+  entry_record->creation_time = current.ToInternalValue();
+  entry_record->last_modified_time = current.ToInternalValue();
+  entry_record->last_access_time = current.ToInternalValue();
+  entry_record->key_len = static_cast<int32>(key.size());
+
+  // There is no room for the key on the record, so it always goes to its own
+  // block (or file), followed by a \0.
+  Addr address(0);
+  if (!CreateBlock(entry_record->key_len + 1, &address))
+    return false;
+
+  entry_record->data_addr[kKeyFileIndex] = address.value();
+  File* key_file = GetBackingFile(address, kKeyFileIndex);
+  key_ = key;
+
+  size_t offset = 0;
+  if (address.is_block_file())
+    offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
+
+  if (!key_file || !key_file->Write(key.data(), key.size(), offset)) {
+    entry_record->data_addr[kKeyFileIndex] = 0;
+    DeleteData(address, kKeyFileIndex);
+    return false;
+  }
+
+  if (address.is_separate_file())
+    key_file->SetLength(key.size() + 1);
+
+  backend_->ModifyStorageSize(0, static_cast<int32>(key.size()));
+  CACHE_UMA(COUNTS, "KeySize", static_cast<int32>(key.size()));
+  Log("Create Entry ");
+  return true;
+}
+
 bool EntryImplV3::IsSameEntry(const std::string& key, uint32 hash) {
   if (entry_.Data()->hash != hash ||
       static_cast<size_t>(entry_.Data()->key_len) != key.size())
@@ -319,71 +455,75 @@ bool EntryImplV3::IsSameEntry(const std::string& key, uint32 hash) {
 
 void EntryImplV3::InternalDoom() {
   net_log_.AddEvent(net::NetLog::TYPE_ENTRY_DOOM);
-  DCHECK(node_.HasData());
-  if (!node_.Data()->dirty) {
-    node_.Data()->dirty = backend_->GetCurrentEntryId();
-    node_.Store();
-  }
+  entry_.Data()->state = ENTRY_DELETED;
+  entry_.set_modified();
   doomed_ = true;
 }
 
-// This only includes checks that relate to the first block of the entry (the
-// first 256 bytes), and values that should be set from the entry creation.
-// Basically, even if there is something wrong with this entry, we want to see
-// if it is possible to load the rankings node and delete them together.
-bool EntryImplV3::SanityCheck() {
-  if (!entry_.VerifyHash())
-    return false;
+void EntryImplV3::DeleteEntryData(bool everything) {
+  DCHECK(doomed_ || !everything);
 
-  EntryStore* stored = entry_.Data();
-  if (!stored->rankings_node || stored->key_len <= 0)
-    return false;
+  if (GetEntryFlags() & PARENT_ENTRY) {
+    // We have some child entries that must go away.
+    SparseControlV3::DeleteChildren(this);
+  }
 
-  if (stored->reuse_count < 0 || stored->refetch_count < 0)
-    return false;
+  if (GetDataSize(0))
+    CACHE_UMA(COUNTS, "DeleteHeader", GetDataSize(0));
+  if (GetDataSize(1))
+    CACHE_UMA(COUNTS, "DeleteData", GetDataSize(1));
+  for (int index = 0; index < kNumStreams; index++) {
+    Addr address(entry_.Data()->data_addr[index]);
+    if (address.is_initialized()) {
+      backend_->ModifyStorageSize(entry_.Data()->data_size[index] -
+                                      unreported_size_[index], 0);
+      entry_.Data()->data_addr[index] = 0;
+      entry_.Data()->data_size[index] = 0;
+      entry_.Store();
+      DeleteData(address, index);
+    }
+  }
 
-  Addr rankings_addr(stored->rankings_node);
-  if (!rankings_addr.SanityCheckForRankings())
-    return false;
+  if (!everything)
+    return;
 
-  Addr next_addr(stored->next);
-  if (next_addr.is_initialized() && !next_addr.SanityCheckForEntry()) {
-    STRESS_NOTREACHED();
-    return false;
-  }
-  STRESS_DCHECK(next_addr.value() != entry_.address().value());
+  // Remove all traces of this entry.
+  backend_->RemoveEntry(this);
+
+  Addr address(entry_.Data()->data_addr[kKeyFileIndex]);
+  DeleteData(address, kKeyFileIndex);
+  backend_->ModifyStorageSize(entry_.Data()->key_len, 0);
 
-  if (stored->state > ENTRY_DOOMED || stored->state < ENTRY_NORMAL)
+  backend_->DeleteBlock(entry_.address(), true);
+  entry_.Discard();
+}
+
+// This only includes checks that relate to the entry record, and values that
+// should be set from the entry creation.
+bool EntryImplV3::SanityCheck() {
+  if (!entry_.VerifyHash())
     return false;
 
-  Addr key_addr(stored->long_key);
-  if ((stored->key_len <= kMaxInternalKeyLength && key_addr.is_initialized()) ||
-      (stored->key_len > kMaxInternalKeyLength && !key_addr.is_initialized()))
+  EntryRecord* stored = entry_.Data();
+  if (stored->key_len <= 0)
     return false;
 
-  if (!key_addr.SanityCheck())
+  if (stored->state < ENTRY_NEW || stored->state > ENTRY_USED)
     return false;
 
-  if (key_addr.is_initialized() &&
-      ((stored->key_len < kMaxBlockSize && key_addr.is_separate_file()) ||
-       (stored->key_len >= kMaxBlockSize && key_addr.is_block_file())))
+  Addr key_addr(stored->data_addr[kKeyFileIndex]);
+  if (!key_addr.is_initialized() || !key_addr.SanityCheckV3())
     return false;
 
-  int num_blocks = NumBlocksForEntry(stored->key_len);
-  if (entry_.address().num_blocks() != num_blocks)
+  if ((stored->key_len < kMaxBlockSize && key_addr.is_separate_file()) ||
+      (stored->key_len >= kMaxBlockSize && key_addr.is_block_file()))
     return false;
 
   return true;
 }
 
 bool EntryImplV3::DataSanityCheck() {
-  EntryStore* stored = entry_.Data();
-  Addr key_addr(stored->long_key);
-
-  // The key must be NULL terminated.
-  if (!key_addr.is_initialized() && stored->key[stored->key_len])
-    return false;
-
+  EntryRecord* stored = entry_.Data();
   if (stored->hash != base::Hash(GetKey()))
     return false;
 
@@ -394,7 +534,7 @@ bool EntryImplV3::DataSanityCheck() {
       return false;
     if (!data_size && data_addr.is_initialized())
       return false;
-    if (!data_addr.SanityCheck())
+    if (!data_addr.SanityCheckV3())
       return false;
     if (!data_size)
       continue;
@@ -407,19 +547,14 @@ bool EntryImplV3::DataSanityCheck() {
 }
 
 void EntryImplV3::FixForDelete() {
-  EntryStore* stored = entry_.Data();
-  Addr key_addr(stored->long_key);
-
-  if (!key_addr.is_initialized())
-    stored->key[stored->key_len] = '\0';
-
+  EntryRecord* stored = entry_.Data();
   for (int i = 0; i < kNumStreams; i++) {
     Addr data_addr(stored->data_addr[i]);
     int data_size = stored->data_size[i];
     if (data_addr.is_initialized()) {
       if ((data_size <= kMaxBlockSize && data_addr.is_separate_file()) ||
           (data_size > kMaxBlockSize && data_addr.is_block_file()) ||
-          !data_addr.SanityCheck()) {
+          !data_addr.SanityCheckV3()) {
         STRESS_NOTREACHED();
         // The address is weird so don't attempt to delete it.
         stored->data_addr[i] = 0;
@@ -433,10 +568,64 @@ void EntryImplV3::FixForDelete() {
   entry_.Store();
 }
 
+void EntryImplV3::IncrementIoCount() {
+  backend_->IncrementIoCount();
+}
+
+void EntryImplV3::DecrementIoCount() {
+  if (backend_.get())
+    backend_->DecrementIoCount();
+}
+
+void EntryImplV3::OnEntryCreated(base::WeakPtr<BackendImplV3::Worker> worker) {
+  // Just grab a reference to the worker.
+  worker_ = worker;
+}
+
 void EntryImplV3::SetTimes(base::Time last_used, base::Time last_modified) {
-  node_.Data()->last_used = last_used.ToInternalValue();
-  node_.Data()->last_modified = last_modified.ToInternalValue();
-  node_.set_modified();
+  entry_.Data()->last_access_time = last_used.ToInternalValue();
+  entry_.Data()->last_modified_time = last_modified.ToInternalValue();
+  entry_.set_modified();
+}
+
+void EntryImplV3::SetEntryFlags(uint32 flags) {
+  entry_.Data()->flags |= flags;
+  entry_.set_modified();
+}
+
+uint32 EntryImplV3::GetEntryFlags() {
+  return entry_.Data()->flags;
+}
+
+void EntryImplV3::ReportIOTime(Operation op, const base::TimeTicks& start) {
+  if (!backend_.get())
+    return;
+
+  switch (op) {
+    case kRead:
+      CACHE_UMA(AGE_MS, "ReadTime", start);
+      break;
+    case kWrite:
+      CACHE_UMA(AGE_MS, "WriteTime", start);
+      break;
+    case kSparseRead:
+      CACHE_UMA(AGE_MS, "SparseReadTime", start);
+      break;
+    case kSparseWrite:
+      CACHE_UMA(AGE_MS, "SparseWriteTime", start);
+      break;
+    case kAsyncIO:
+      CACHE_UMA(AGE_MS, "AsyncIOTime", start);
+      break;
+    case kReadAsync1:
+      CACHE_UMA(AGE_MS, "AsyncReadDispatchTime", start);
+      break;
+    case kWriteAsync1:
+      CACHE_UMA(AGE_MS, "AsyncWriteDispatchTime", start);
+      break;
+    default:
+      NOTREACHED();
+  }
 }
 
 void EntryImplV3::BeginLogging(net::NetLog* net_log, bool created) {
@@ -455,43 +644,38 @@ const net::BoundNetLog& EntryImplV3::net_log() const {
 // ------------------------------------------------------------------------
 
 void EntryImplV3::Doom() {
-  if (background_queue_)
-    background_queue_->DoomEntryImpl(this);
-}
-
-void EntryImplV3::DoomImpl() {
-  if (doomed_ || !backend_)
-    return;
-
-  SetPointerForInvalidEntry(backend_->GetCurrentEntryId());
-  backend_->InternalDoomEntry(this);
+  if (worker_.get()) {
+    worker_->PostTask(base::Bind(&EntryImplV3::DoomImpl,
+                                 base::Unretained(this)));
+  }
 }
 
 void EntryImplV3::Close() {
-  if (background_queue_)
-    background_queue_->CloseEntryImpl(this);
+  if (worker_.get()) {
+    worker_->PostTask(base::Bind(&EntryImplV3::Release,
+                                 base::Unretained(this)));
+  }
 }
 
 std::string EntryImplV3::GetKey() const {
-  CacheEntryBlock* entry = const_cast<CacheEntryBlock*>(&entry_);
-  int key_len = entry->Data()->key_len;
-  if (key_len <= kMaxInternalKeyLength)
-    return std::string(entry->Data()->key);
-
   // We keep a copy of the key so that we can always return it, even if the
   // backend is disabled.
   if (!key_.empty())
     return key_;
 
-  Addr address(entry->Data()->long_key);
-  DCHECK(address.is_initialized());
+  CacheEntryBlockV3* entry = const_cast<CacheEntryBlockV3*>(&entry_);
+  int key_len = entry->Data()->key_len;
+  Addr address(entry->Data()->data_addr[kKeyFileIndex]);
+  if (!address.is_initialized())
+    return std::string();
+
   size_t offset = 0;
   if (address.is_block_file())
     offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
 
   static_assert(kNumStreams == kKeyFileIndex, "invalid key index");
-  File* key_file = const_cast<EntryImpl*>(this)->GetBackingFile(address,
-                                                                kKeyFileIndex);
+  File* key_file = const_cast<EntryImplV3*>(this)->GetBackingFile(
+      address, kKeyFileIndex);
   if (!key_file)
     return std::string();
 
@@ -505,20 +689,20 @@ std::string EntryImplV3::GetKey() const {
 }
 
 Time EntryImplV3::GetLastUsed() const {
-  CacheRankingsBlock* node = const_cast<CacheRankingsBlock*>(&node_);
-  return Time::FromInternalValue(node->Data()->last_used);
+  CacheEntryBlockV3* entry = const_cast<CacheEntryBlockV3*>(&entry_);
+  return Time::FromInternalValue(entry->Data()->last_access_time);
 }
 
 Time EntryImplV3::GetLastModified() const {
-  CacheRankingsBlock* node = const_cast<CacheRankingsBlock*>(&node_);
-  return Time::FromInternalValue(node->Data()->last_modified);
+  CacheEntryBlockV3* entry = const_cast<CacheEntryBlockV3*>(&entry_);
+  return Time::FromInternalValue(entry->Data()->last_modified_time);
 }
 
 int32 EntryImplV3::GetDataSize(int index) const {
   if (index < 0 || index >= kNumStreams)
     return 0;
 
-  CacheEntryBlock* entry = const_cast<CacheEntryBlock*>(&entry_);
+  CacheEntryBlockV3* entry = const_cast<CacheEntryBlockV3*>(&entry_);
   return entry->Data()->data_size[index];
 }
 
@@ -527,7 +711,6 @@ int EntryImplV3::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
   if (callback.is_null())
     return ReadDataImpl(index, offset, buf, buf_len, callback);
 
-  DCHECK(node_.Data()->dirty || read_only_);
   if (index < 0 || index >= kNumStreams)
     return net::ERR_INVALID_ARGUMENT;
 
@@ -538,179 +721,108 @@ int EntryImplV3::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
   if (buf_len < 0)
     return net::ERR_INVALID_ARGUMENT;
 
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->ReadData(this, index, offset, buf, buf_len, callback);
+  worker_->PostEntryTask(
+      base::Bind(&EntryImplV3::ReadDataImpl, base::Unretained(this), index,
+                 offset, make_scoped_refptr(buf), buf_len),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImpl::ReadDataImpl(int index, int offset, IOBuffer* buf, int buf_len,
-                            const CompletionCallback& callback) {
-  if (net_log_.IsLogging()) {
-    net_log_.BeginEvent(
-        net::NetLog::TYPE_ENTRY_READ_DATA,
-        CreateNetLogReadWriteDataCallback(index, offset, buf_len, false));
-  }
-
-  int result = InternalReadData(index, offset, buf, buf_len, callback);
-
-  if (result != net::ERR_IO_PENDING && net_log_.IsLogging()) {
-    net_log_.EndEvent(
-        net::NetLog::TYPE_ENTRY_READ_DATA,
-        CreateNetLogReadWriteCompleteCallback(result));
-  }
-  return result;
-}
-
 int EntryImplV3::WriteData(int index, int offset, IOBuffer* buf, int buf_len,
                            const CompletionCallback& callback, bool truncate) {
   if (callback.is_null())
     return WriteDataImpl(index, offset, buf, buf_len, callback, truncate);
 
-  DCHECK(node_.Data()->dirty || read_only_);
   if (index < 0 || index >= kNumStreams)
     return net::ERR_INVALID_ARGUMENT;
 
   if (offset < 0 || buf_len < 0)
     return net::ERR_INVALID_ARGUMENT;
 
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->WriteData(this, index, offset, buf, buf_len, truncate,
-                               callback);
+  worker_->PostEntryTask(
+      base::Bind(&EntryImplV3::WriteDataOnCacheThread, base::Unretained(this),
+                 index, offset, make_scoped_refptr(buf), buf_len, truncate),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImpl::WriteDataImpl(int index, int offset, IOBuffer* buf, int buf_len,
-                             const CompletionCallback& callback,
-                             bool truncate) {
-  if (net_log_.IsLogging()) {
-    net_log_.BeginEvent(
-        net::NetLog::TYPE_ENTRY_WRITE_DATA,
-        CreateNetLogReadWriteDataCallback(index, offset, buf_len, truncate));
-  }
-
-  int result = InternalWriteData(index, offset, buf, buf_len, callback,
-                                 truncate);
-
-  if (result != net::ERR_IO_PENDING && net_log_.IsLogging()) {
-    net_log_.EndEvent(
-        net::NetLog::TYPE_ENTRY_WRITE_DATA,
-        CreateNetLogReadWriteCompleteCallback(result));
-  }
-  return result;
-}
-
 int EntryImplV3::ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
                                 const CompletionCallback& callback) {
   if (callback.is_null())
     return ReadSparseDataImpl(offset, buf, buf_len, callback);
 
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->ReadSparseData(this, offset, buf, buf_len, callback);
+  worker_->PostEntryTask(
+      base::Bind(&EntryImplV3::ReadSparseDataImpl, base::Unretained(this),
+                 offset, make_scoped_refptr(buf), buf_len),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImpl::ReadSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
-                                  const CompletionCallback& callback) {
-  DCHECK(node_.Data()->dirty || read_only_);
-  int result = InitSparseData();
-  if (net::OK != result)
-    return result;
-
-  TimeTicks start = TimeTicks::Now();
-  result = sparse_->StartIO(SparseControl::kReadOperation, offset, buf, buf_len,
-                            callback);
-  ReportIOTime(kSparseRead, start);
-  return result;
-}
-
 int EntryImplV3::WriteSparseData(int64 offset, IOBuffer* buf, int buf_len,
                                  const CompletionCallback& callback) {
   if (callback.is_null())
     return WriteSparseDataImpl(offset, buf, buf_len, callback);
 
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->WriteSparseData(this, offset, buf, buf_len, callback);
+  worker_->PostEntryTask(
+      base::Bind(&EntryImplV3::WriteSparseDataImpl, base::Unretained(this),
+                 offset, make_scoped_refptr(buf), buf_len),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImpl::WriteSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
-                                   const CompletionCallback& callback) {
-  DCHECK(node_.Data()->dirty || read_only_);
-  int result = InitSparseData();
-  if (net::OK != result)
-    return result;
-
-  TimeTicks start = TimeTicks::Now();
-  result = sparse_->StartIO(SparseControl::kWriteOperation, offset, buf,
-                            buf_len, callback);
-  ReportIOTime(kSparseWrite, start);
-  return result;
-}
-
 int EntryImplV3::GetAvailableRange(int64 offset, int len, int64* start,
                                    const CompletionCallback& callback) {
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->GetAvailableRange(this, offset, len, start, callback);
+  worker_->PostOperation(
+      base::Bind(&EntryImplV3::GetAvailableRangeImpl, base::Unretained(this),
+                 offset, len, start),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImpl::GetAvailableRangeImpl(int64 offset, int len, int64* start) {
-  int result = InitSparseData();
-  if (net::OK != result)
-    return result;
-
-  return sparse_->GetAvailableRange(offset, len, start);
-}
-
 bool EntryImplV3::CouldBeSparse() const {
   if (sparse_.get())
     return true;
 
-  scoped_ptr<SparseControl> sparse;
-  sparse.reset(new SparseControl(const_cast<EntryImpl*>(this)));
+  scoped_ptr<SparseControlV3> sparse;
+  sparse.reset(new SparseControlV3(const_cast<EntryImplV3*>(this)));
   return sparse->CouldBeSparse();
 }
 
 void EntryImplV3::CancelSparseIO() {
-  if (background_queue_)
-    background_queue_->CancelSparseIO(this);
-}
-
-void EntryImplV3::CancelSparseIOImpl() {
-  if (!sparse_.get())
-    return;
-
-  sparse_->CancelIO();
+  if (worker_.get()) {
+    worker_->PostTask(base::Bind(&EntryImplV3::CancelSparseIOImpl,
+                                 base::Unretained(this)));
+  }
 }
 
 int EntryImplV3::ReadyForSparseIO(const CompletionCallback& callback) {
   if (!sparse_.get())
     return net::OK;
 
-  if (!background_queue_)
+  if (!worker_.get())
     return net::ERR_UNEXPECTED;
 
-  background_queue_->ReadyForSparseIO(this, callback);
+  worker_->PostEntryTask(
+      base::Bind(&EntryImplV3::ReadyForSparseIOImpl, base::Unretained(this)),
+      callback);
   return net::ERR_IO_PENDING;
 }
 
-int EntryImplV3::ReadyForSparseIOImpl(const CompletionCallback& callback) {
-  DCHECK(sparse_.get());
-  return sparse_->ReadyToUse(callback);
-}
-
-// ------------------------------------------------------------------------
-
 // When an entry is deleted from the cache, we clean up all the data associated
 // with it for two reasons: to simplify the reuse of the block (we know that any
 // unused block is filled with zeros), and to simplify the handling of write /
@@ -718,12 +830,11 @@ int EntryImplV3::ReadyForSparseIOImpl(const CompletionCallback& callback) {
 // data related to a previous cache entry because the range was not fully
 // written before).
 EntryImplV3::~EntryImplV3() {
-  if (!backend_) {
+  if (!backend_.get()) {
     entry_.clear_modified();
-    node_.clear_modified();
     return;
   }
-  Log("~EntryImpl in");
+  Log("~EntryImplV3 in");
 
   // Save the sparse info to disk. This will generate IO for this entry and
   // maybe for a child entry, so it is important to do it before deleting this
@@ -743,7 +854,8 @@ EntryImplV3::~EntryImplV3() {
     bool ret = true;
     for (int index = 0; index < kNumStreams; index++) {
       if (user_buffers_[index].get()) {
-        if (!(ret = Flush(index, 0)))
+        ret = Flush(index, 0);
+        if (!ret)
           LOG(ERROR) << "Failed to save user data";
       }
       if (unreported_size_[index]) {
@@ -753,26 +865,23 @@ EntryImplV3::~EntryImplV3() {
       }
     }
 
-    if (!ret) {
-      // There was a failure writing the actual data. Mark the entry as dirty.
-      int current_id = backend_->GetCurrentEntryId();
-      node_.Data()->dirty = current_id == 1 ? -1 : current_id - 1;
-      node_.Store();
-    } else if (node_.HasData() && !dirty_ && node_.Data()->dirty) {
-      node_.Data()->dirty = 0;
-      node_.Store();
-    }
+    // If there was a failure writing the actual data, the index keeps the
+    // entry as being modified, and it will be discarded the next time that
+    // it is found.
+    if (ret && entry_.Store())
+      backend_->OnEntryClosed(this);
   }
 
-  Trace("~EntryImpl out 0x%p", reinterpret_cast<void*>(this));
+  Trace("~EntryImplV3 out 0x%p", reinterpret_cast<void*>(this));
   net_log_.EndEvent(net::NetLog::TYPE_DISK_CACHE_ENTRY_IMPL);
   backend_->OnEntryDestroyEnd();
 }
 
-int EntryImpl::InternalReadData(int index, int offset,
-                                IOBuffer* buf, int buf_len,
-                                const CompletionCallback& callback) {
-  DCHECK(node_.Data()->dirty || read_only_);
+// ------------------------------------------------------------------------
+
+int EntryImplV3::InternalReadData(int index, int offset,
+                                  IOBuffer* buf, int buf_len,
+                                  const CompletionCallback& callback) {
   DVLOG(2) << "Read from " << index << " at " << offset << " : " << buf_len;
   if (index < 0 || index >= kNumStreams)
     return net::ERR_INVALID_ARGUMENT;
@@ -784,7 +893,7 @@ int EntryImpl::InternalReadData(int index, int offset,
   if (buf_len < 0)
     return net::ERR_INVALID_ARGUMENT;
 
-  if (!backend_)
+  if (!backend_.get())
     return net::ERR_UNEXPECTED;
 
   TimeTicks start = TimeTicks::Now();
@@ -854,11 +963,10 @@ int EntryImpl::InternalReadData(int index, int offset,
   return (completed || callback.is_null()) ? buf_len : net::ERR_IO_PENDING;
 }
 
-int EntryImpl::InternalWriteData(int index, int offset,
-                                 IOBuffer* buf, int buf_len,
-                                 const CompletionCallback& callback,
-                                 bool truncate) {
-  DCHECK(node_.Data()->dirty || read_only_);
+int EntryImplV3::InternalWriteData(int index, int offset,
+                                   IOBuffer* buf, int buf_len,
+                                   const CompletionCallback& callback,
+                                   bool truncate) {
   DVLOG(2) << "Write to " << index << " at " << offset << " : " << buf_len;
   if (index < 0 || index >= kNumStreams)
     return net::ERR_INVALID_ARGUMENT;
@@ -866,7 +974,7 @@ int EntryImpl::InternalWriteData(int index, int offset,
   if (offset < 0 || buf_len < 0)
     return net::ERR_INVALID_ARGUMENT;
 
-  if (!backend_)
+  if (!backend_.get())
     return net::ERR_UNEXPECTED;
 
   int max_file_size = backend_->MaxFileSize();
@@ -958,9 +1066,15 @@ int EntryImpl::InternalWriteData(int index, int offset,
   return (completed || callback.is_null()) ? buf_len : net::ERR_IO_PENDING;
 }
 
+int EntryImplV3::WriteDataOnCacheThread(int index, int offset, IOBuffer* buf,
+                                        int buf_len, bool truncate,
+                                        const CompletionCallback& callback) {
+  return WriteDataImpl(index, offset, buf, buf_len, callback, truncate);
+}
+
 // ------------------------------------------------------------------------
 
-bool EntryImpl::CreateDataBlock(int index, int size) {
+bool EntryImplV3::CreateDataBlock(int index, int size) {
   DCHECK(index >= 0 && index < kNumStreams);
 
   Addr address(entry_.Data()->data_addr[index]);
@@ -972,9 +1086,9 @@ bool EntryImpl::CreateDataBlock(int index, int size) {
   return true;
 }
 
-bool EntryImpl::CreateBlock(int size, Addr* address) {
+bool EntryImplV3::CreateBlock(int size, Addr* address) {
   DCHECK(!address->is_initialized());
-  if (!backend_)
+  if (!backend_.get())
     return false;
 
   FileType file_type = Addr::RequiredFileType(size);
@@ -998,26 +1112,26 @@ bool EntryImpl::CreateBlock(int size, Addr* address) {
 // entry will be left dirty... and at some point it will be discarded; it is
 // important that the entry doesn't keep a reference to this address, or we'll
 // end up deleting the contents of |address| once again.
-void EntryImpl::DeleteData(Addr address, int index) {
-  DCHECK(backend_);
+void EntryImplV3::DeleteData(Addr address, int index) {
+  DCHECK(backend_.get());
   if (!address.is_initialized())
     return;
   if (address.is_separate_file()) {
     int failure = !DeleteCacheFile(backend_->GetFileName(address));
-    CACHE_UMA(COUNTS, "DeleteFailed", 0, failure);
+    CACHE_UMA(COUNTS, "DeleteFailed", failure);
     if (failure) {
       LOG(ERROR) << "Failed to delete " <<
           backend_->GetFileName(address).value() << " from the cache.";
     }
-    if (files_[index])
+    if (files_[index].get())
       files_[index] = NULL;  // Releases the object.
   } else {
     backend_->DeleteBlock(address, true);
   }
 }
 
-void EntryImpl::UpdateRank(bool modified) {
-  if (!backend_)
+void EntryImplV3::UpdateRank(bool modified) {
+  if (!backend_.get())
     return;
 
   if (!doomed_) {
@@ -1027,56 +1141,34 @@ void EntryImpl::UpdateRank(bool modified) {
   }
 
   Time current = Time::Now();
-  node_.Data()->last_used = current.ToInternalValue();
+  entry_.Data()->last_access_time = current.ToInternalValue();
 
   if (modified)
-    node_.Data()->last_modified = current.ToInternalValue();
+    entry_.Data()->last_modified_time = current.ToInternalValue();
+  entry_.set_modified();
 }
 
-void EntryImpl::DeleteEntryData(bool everything) {
-  DCHECK(doomed_ || !everything);
-
-  if (GetEntryFlags() & PARENT_ENTRY) {
-    // We have some child entries that must go away.
-    SparseControl::DeleteChildren(this);
-  }
-
-  if (GetDataSize(0))
-    CACHE_UMA(COUNTS, "DeleteHeader", 0, GetDataSize(0));
-  if (GetDataSize(1))
-    CACHE_UMA(COUNTS, "DeleteData", 0, GetDataSize(1));
-  for (int index = 0; index < kNumStreams; index++) {
-    Addr address(entry_.Data()->data_addr[index]);
-    if (address.is_initialized()) {
-      backend_->ModifyStorageSize(entry_.Data()->data_size[index] -
-                                      unreported_size_[index], 0);
-      entry_.Data()->data_addr[index] = 0;
-      entry_.Data()->data_size[index] = 0;
-      entry_.Store();
-      DeleteData(address, index);
-    }
-  }
-
-  if (!everything)
-    return;
-
-  // Remove all traces of this entry.
-  backend_->RemoveEntry(this);
-
-  // Note that at this point node_ and entry_ are just two blocks of data, and
-  // even if they reference each other, nobody should be referencing them.
-
-  Addr address(entry_.Data()->long_key);
-  DeleteData(address, kKeyFileIndex);
-  backend_->ModifyStorageSize(entry_.Data()->key_len, 0);
+File* EntryImplV3::GetBackingFile(Addr address, int index) {
+  if (!backend_.get())
+    return NULL;
 
-  backend_->DeleteBlock(entry_.address(), true);
-  entry_.Discard();
+  File* file;
+  if (address.is_separate_file())
+    file = GetExternalFile(address, index);
+  else
+    file = backend_->File(address);
+  return file;
+}
 
-  if (!LeaveRankingsBehind()) {
-    backend_->DeleteBlock(node_.address(), true);
-    node_.Discard();
+File* EntryImplV3::GetExternalFile(Addr address, int index) {
+  DCHECK(index >= 0 && index <= kKeyFileIndex);
+  if (!files_[index].get()) {
+    // For a key file, use mixed mode IO.
+    scoped_refptr<File> file(new File(kKeyFileIndex == index));
+    if (file->Init(backend_->GetFileName(address)))
+      files_[index].swap(file);
   }
+  return files_[index].get();
 }
 
 // We keep a memory buffer for everything that ends up stored on a block file
@@ -1092,8 +1184,8 @@ void EntryImpl::DeleteEntryData(bool everything) {
 // reuse it for the new data. Keep in mind that the normal use pattern is quite
 // simple (write sequentially from the beginning), so we optimize for handling
 // that case.
-bool EntryImpl::PrepareTarget(int index, int offset, int buf_len,
-                              bool truncate) {
+bool EntryImplV3::PrepareTarget(int index, int offset, int buf_len,
+                                bool truncate) {
   if (truncate)
     return HandleTruncation(index, offset, buf_len);
 
@@ -1122,7 +1214,7 @@ bool EntryImpl::PrepareTarget(int index, int offset, int buf_len,
 // We get to this function with some data already stored. If there is a
 // truncation that results on data stored internally, we'll explicitly
 // handle the case here.
-bool EntryImpl::HandleTruncation(int index, int offset, int buf_len) {
+bool EntryImplV3::HandleTruncation(int index, int offset, int buf_len) {
   Addr address(entry_.Data()->data_addr[index]);
 
   int current_size = entry_.Data()->data_size[index];
@@ -1179,7 +1271,7 @@ bool EntryImpl::HandleTruncation(int index, int offset, int buf_len) {
   return ImportSeparateFile(index, offset + buf_len);
 }
 
-bool EntryImpl::CopyToLocalBuffer(int index) {
+bool EntryImplV3::CopyToLocalBuffer(int index) {
   Addr address(entry_.Data()->data_addr[index]);
   DCHECK(!user_buffers_[index].get());
   DCHECK(address.is_initialized());
@@ -1202,7 +1294,7 @@ bool EntryImpl::CopyToLocalBuffer(int index) {
   return true;
 }
 
-bool EntryImpl::MoveToLocalBuffer(int index) {
+bool EntryImplV3::MoveToLocalBuffer(int index) {
   if (!CopyToLocalBuffer(index))
     return false;
 
@@ -1218,14 +1310,14 @@ bool EntryImpl::MoveToLocalBuffer(int index) {
   return true;
 }
 
-bool EntryImpl::ImportSeparateFile(int index, int new_size) {
+bool EntryImplV3::ImportSeparateFile(int index, int new_size) {
   if (entry_.Data()->data_size[index] > new_size)
     UpdateSize(index, entry_.Data()->data_size[index], new_size);
 
   return MoveToLocalBuffer(index);
 }
 
-bool EntryImpl::PrepareBuffer(int index, int offset, int buf_len) {
+bool EntryImplV3::PrepareBuffer(int index, int offset, int buf_len) {
   DCHECK(user_buffers_[index].get());
   if ((user_buffers_[index]->End() && offset > user_buffers_[index]->End()) ||
       offset > entry_.Data()->data_size[index]) {
@@ -1260,7 +1352,7 @@ bool EntryImpl::PrepareBuffer(int index, int offset, int buf_len) {
   return true;
 }
 
-bool EntryImpl::Flush(int index, int min_len) {
+bool EntryImplV3::Flush(int index, int min_len) {
   Addr address(entry_.Data()->data_addr[index]);
   DCHECK(user_buffers_[index].get());
   DCHECK(!address.is_initialized() || address.is_separate_file());
@@ -1299,7 +1391,7 @@ bool EntryImpl::Flush(int index, int min_len) {
   return true;
 }
 
-void EntryImpl::UpdateSize(int index, int old_size, int new_size) {
+void EntryImplV3::UpdateSize(int index, int old_size, int new_size) {
   if (entry_.Data()->data_size[index] == new_size)
     return;
 
@@ -1308,12 +1400,12 @@ void EntryImpl::UpdateSize(int index, int old_size, int new_size) {
   entry_.set_modified();
 }
 
-int EntryImpl::InitSparseData() {
+int EntryImplV3::InitSparseData() {
   if (sparse_.get())
     return net::OK;
 
   // Use a local variable so that sparse_ never goes from 'valid' to NULL.
-  scoped_ptr<SparseControl> sparse(new SparseControl(this));
+  scoped_ptr<SparseControlV3> sparse(new SparseControlV3(this));
   int result = sparse->Init();
   if (net::OK == result)
     sparse_.swap(sparse);
@@ -1321,17 +1413,8 @@ int EntryImpl::InitSparseData() {
   return result;
 }
 
-void EntryImpl::SetEntryFlags(uint32 flags) {
-  entry_.Data()->flags |= flags;
-  entry_.set_modified();
-}
-
-uint32 EntryImpl::GetEntryFlags() {
-  return entry_.Data()->flags;
-}
-
-void EntryImpl::GetData(int index, char** buffer, Addr* address) {
-  DCHECK(backend_);
+void EntryImplV3::GetData(int index, char** buffer, Addr* address) {
+  DCHECK(backend_.get());
   if (user_buffers_[index].get() && user_buffers_[index]->Size() &&
       !user_buffers_[index]->Start()) {
     // The data is already in memory, just copy it and we're done.
@@ -1357,108 +1440,14 @@ void EntryImpl::GetData(int index, char** buffer, Addr* address) {
   }
 }
 
-#endif  // defined(V3_NOT_JUST_YET_READY).
-
-void EntryImplV3::ReportIOTime(Operation op, const base::TimeTicks& start) {
-  if (!backend_)
-    return;
-
-  switch (op) {
-    case kRead:
-      CACHE_UMA(AGE_MS, "ReadTime", start);
-      break;
-    case kWrite:
-      CACHE_UMA(AGE_MS, "WriteTime", start);
-      break;
-    case kSparseRead:
-      CACHE_UMA(AGE_MS, "SparseReadTime", start);
-      break;
-    case kSparseWrite:
-      CACHE_UMA(AGE_MS, "SparseWriteTime", start);
-      break;
-    case kAsyncIO:
-      CACHE_UMA(AGE_MS, "AsyncIOTime", start);
-      break;
-    case kReadAsync1:
-      CACHE_UMA(AGE_MS, "AsyncReadDispatchTime", start);
-      break;
-    case kWriteAsync1:
-      CACHE_UMA(AGE_MS, "AsyncWriteDispatchTime", start);
-      break;
-    default:
-      NOTREACHED();
-  }
-}
-
 void EntryImplV3::Log(const char* msg) {
-  Trace("%s 0x%p 0x%x", msg, reinterpret_cast<void*>(this), address_);
-  Trace("  data: 0x%x 0x%x", entry_->data_addr[0], entry_->data_addr[1]);
-  Trace("  doomed: %d", doomed_);
-}
-
-void EntryImplV3::Doom() {
-  NOTIMPLEMENTED();
-}
-
-void EntryImplV3::Close() {
-  NOTIMPLEMENTED();
-}
-
-std::string EntryImplV3::GetKey() const {
-  return std::string();
-}
-
-Time EntryImplV3::GetLastUsed() const {
-  return Time();
-}
-
-Time EntryImplV3::GetLastModified() const {
-  return Time();
-}
-
-int32 EntryImplV3::GetDataSize(int index) const {
-  return 0;
-}
-
-int EntryImplV3::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
-                          const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
+  Trace("%s 0x%p 0x%x", msg, reinterpret_cast<void*>(this),
+        entry_.address().value());
 
-int EntryImplV3::WriteData(int index, int offset, IOBuffer* buf, int buf_len,
-                           const CompletionCallback& callback, bool truncate) {
-  return net::ERR_FAILED;
-}
-
-int EntryImplV3::ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
-                                const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int EntryImplV3::WriteSparseData(int64 offset, IOBuffer* buf, int buf_len,
-                                 const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-int EntryImplV3::GetAvailableRange(int64 offset, int len, int64* start,
-                                   const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
+  Trace("  data: 0x%x 0x%x 0x%x", entry_.Data()->data_addr[0],
+        entry_.Data()->data_addr[1], entry_.Data()->data_addr[kKeyFileIndex]);
 
-bool EntryImplV3::CouldBeSparse() const {
-  return false;
-}
-
-void EntryImplV3::CancelSparseIO() {
-  NOTIMPLEMENTED();
-}
-
-int EntryImplV3::ReadyForSparseIO(const CompletionCallback& callback) {
-  return net::ERR_FAILED;
-}
-
-EntryImplV3::~EntryImplV3() {
-  NOTIMPLEMENTED();
+  Trace("  doomed: %d", doomed_);
 }
 
 }  // namespace disk_cache
@@ -8,15 +8,17 @@
 #include <string>
 
 #include "base/memory/scoped_ptr.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
 #include "net/disk_cache/blockfile/disk_format_v3.h"
+#include "net/disk_cache/blockfile/storage_block-inl.h"
 #include "net/disk_cache/blockfile/storage_block.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/log/net_log.h"
 
 namespace disk_cache {
 
-class BackendImplV3;
 class SparseControlV3;
+typedef StorageBlock<EntryRecord> CacheEntryBlockV3;
 
 // This class implements the Entry interface. An object of this
 // class represents a single entry on the cache.
@@ -24,7 +26,7 @@ class NET_EXPORT_PRIVATE EntryImplV3
     : public Entry,
       public base::RefCounted<EntryImplV3> {
   friend class base::RefCounted<EntryImplV3>;
-  // friend class SparseControlV3;
+  friend class SparseControlV3;
  public:
   enum Operation {
     kRead,
@@ -38,18 +40,29 @@ class NET_EXPORT_PRIVATE EntryImplV3
 
   EntryImplV3(BackendImplV3* backend, Addr address, bool read_only);
 
-  // Performs the initialization of a EntryImplV3 that will be added to the
-  // cache.
-  bool CreateEntry(Addr node_address, const std::string& key, uint32 hash);
+  // Background implementation of the Entry interface.
+  void DoomImpl();
+  int ReadDataImpl(int index, int offset, IOBuffer* buf, int buf_len,
+                   const CompletionCallback& callback);
+  int WriteDataImpl(int index, int offset, IOBuffer* buf, int buf_len,
+                    const CompletionCallback& callback, bool truncate);
+  int ReadSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
+                         const CompletionCallback& callback);
+  int WriteSparseDataImpl(int64 offset, IOBuffer* buf, int buf_len,
+                          const CompletionCallback& callback);
+  int GetAvailableRangeImpl(int64 offset, int len, int64* start);
+  void CancelSparseIOImpl();
+  int ReadyForSparseIOImpl(const CompletionCallback& callback);
+
+  inline CacheEntryBlockV3* entry() {
+    return &entry_;
+  }
 
   uint32 GetHash();
 
-  uint32 GetHash() const;
-  Addr GetAddress() const;
-  int GetReuseCounter() const;
-  void SetReuseCounter(int count);
-  int GetRefetchCounter() const;
-  void SetRefetchCounter(int count);
+  // Performs the initialization of a EntryImplV3 that will be added to the
+  // cache.
+  bool CreateEntry(const std::string& key, uint32 hash);
 
   // Returns true if this entry matches the lookup arguments.
   bool IsSameEntry(const std::string& key, uint32 hash);
@@ -57,21 +70,55 @@ class NET_EXPORT_PRIVATE EntryImplV3
   // Permamently destroys this entry.
   void InternalDoom();
 
+  // Deletes this entry from disk. If |everything| is false, only the user data
+  // will be removed, leaving the key and control data intact.
+  void DeleteEntryData(bool everything);
+
+  bool doomed() {
+    return doomed_;
+  }
+
+  // Returns true if this entry was written to since it was created or opened,
+  // and records that it was.
+  bool modified() {
+    return modified_;
+  }
+  void set_modified() {
+    modified_ = true;
+  }
+
   // Returns false if the entry is clearly invalid.
   bool SanityCheck();
   bool DataSanityCheck();
 
-  // Attempts to make this entry reachable though the key.
+  // Attempts to make this entry safe to delete.
   void FixForDelete();
 
+  // Handle the pending asynchronous IO count.
+  void IncrementIoCount();
+  void DecrementIoCount();
+
+  // This entry is being returned to the user. It is always called from the
+  // primary thread (not the dedicated cache thread).
+  void OnEntryCreated(base::WeakPtr<BackendImplV3::Worker> worker);
+
   // Set the access times for this entry. This method provides support for
   // the upgrade tool.
   void SetTimes(base::Time last_used, base::Time last_modified);
 
-  // Logs a begin event and enables logging for the EntryImplV3. Will also cause
-  // an end event to be logged on destruction. The EntryImplV3 must have its key
-  // initialized before this is called. |created| is true if the Entry was
-  // created rather than opened.
+  // Adds the provided |flags| to the current EntryFlags for this entry.
+  void SetEntryFlags(uint32 flags);
+
+  // Returns the current EntryFlags for this entry.
+  uint32 GetEntryFlags();
+
+  // Generates a histogram for the time spent working on this operation.
+  void ReportIOTime(Operation op, const base::TimeTicks& start);
+
+  // Logs a begin event and enables logging for the EntryImplV3.  Will also
+  // cause an end event to be logged on destruction.  The EntryImplV3 must have
+  // its key initialized before this is called.  |created| is true if the Entry
+  // was created rather than opened.
   void BeginLogging(net::NetLog* net_log, bool created);
 
   const net::BoundNetLog& net_log() const;
@@ -125,6 +172,11 @@ class NET_EXPORT_PRIVATE EntryImplV3
   int InternalWriteData(int index, int offset, IOBuffer* buf, int buf_len,
                         const CompletionCallback& callback, bool truncate);
 
+  // WriteDataImpl() with the arguments in the order used by the worker.
+  int WriteDataOnCacheThread(int index, int offset, IOBuffer* buf,
+                             int buf_len, bool truncate,
+                             const CompletionCallback& callback);
+
   // Initializes the storage for an internal or external data block.
   bool CreateDataBlock(int index, int size);
 
@@ -140,9 +192,11 @@ class NET_EXPORT_PRIVATE EntryImplV3
   // Updates ranking information.
   void UpdateRank(bool modified);
 
-  // Deletes this entry from disk. If |everything| is false, only the user data
-  // will be removed, leaving the key and control data intact.
-  void DeleteEntryData(bool everything);
+  // Returns a pointer to the file that stores the given address.
+  File* GetBackingFile(Addr address, int index);
+
+  // Returns a pointer to the file that stores external data.
+  File* GetExternalFile(Addr address, int index);
 
   // Prepares the target file or buffer for a write of buf_len bytes at the
   // given offset.
@@ -175,12 +229,6 @@ class NET_EXPORT_PRIVATE EntryImplV3
   // Initializes the sparse control object. Returns a net error code.
   int InitSparseData();
 
-  // Adds the provided |flags| to the current EntryFlags for this entry.
-  void SetEntryFlags(uint32 flags);
-
-  // Returns the current EntryFlags for this entry.
-  uint32 GetEntryFlags();
-
   // Gets the data stored at the given index. If the information is in memory,
   // a buffer will be allocated and the data will be copied to it (the caller
   // can find out the size of the buffer before making this call). Otherwise,
@@ -191,24 +239,21 @@ class NET_EXPORT_PRIVATE EntryImplV3
   // actual cleanup.
   void GetData(int index, char** buffer, Addr* address);
 
-  // Generates a histogram for the time spent working on this operation.
-  void ReportIOTime(Operation op, const base::TimeTicks& start);
-
   // Logs this entry to the internal trace buffer.
   void Log(const char* msg);
 
-  scoped_ptr<EntryRecord> entry_;  // Basic record for this entry.
-  scoped_ptr<ShortEntryRecord> short_entry_;  // Valid for evicted entries.
+  CacheEntryBlockV3 entry_;  // Basic record for this entry.
   base::WeakPtr<BackendImplV3> backend_;  // Back pointer to the cache.
+  base::WeakPtr<BackendImplV3::Worker> worker_;  // Posts our operations.
   scoped_ptr<UserBuffer> user_buffers_[kNumStreams];  // Stores user data.
+  // Files to store external user data and key.
+  scoped_refptr<File> files_[kNumStreams + 1];
   mutable std::string key_;           // Copy of the key.
-  Addr address_;
   int unreported_size_[kNumStreams];  // Bytes not reported yet to the backend.
   bool doomed_;               // True if this entry was removed from the cache.
-  bool read_only_;
-  bool dirty_;                // True if there is something to write.
-  bool modified_;
-  // scoped_ptr<SparseControlV3> sparse_;  // Support for sparse entries.
+  bool read_only_;            // True if not yet writing.
+  bool modified_;             // True if the data changed while open.
+  scoped_ptr<SparseControlV3> sparse_;  // Support for sparse entries.
 
   net::BoundNetLog net_log_;
 
@@ -2,36 +2,37 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// The eviction policy is a very simple pure LRU, so the elements at the end of
-// the list are evicted until kCleanUpMargin free space is available. There is
-// only one list in use (Rankings::NO_USE), and elements are sent to the front
-// of the list whenever they are accessed.
+// The eviction policy is a very simple pure LRU, so the oldest elements on the
+// index are evicted until kCleanUpMargin free space is available. Every entry
+// belongs to the same group (ENTRY_NO_USE) and the timestamp of its cell is
+// updated whenever it is accessed.
 
 // The new (in-development) eviction policy adds re-use as a factor to evict
 // an entry. The story so far:
 
-// Entries are linked on separate lists depending on how often they are used.
-// When we see an element for the first time, it goes to the NO_USE list; if
-// the object is reused later on, we move it to the LOW_USE list, until it is
-// used kHighUse times, at which point it is moved to the HIGH_USE list.
-// Whenever an element is evicted, we move it to the DELETED list so that if the
-// element is accessed again, we remember the fact that it was already stored
-// and maybe in the future we don't evict that element.
-
-// When we have to evict an element, first we try to use the last element from
-// the NO_USE list, then we move to the LOW_USE and only then we evict an entry
-// from the HIGH_USE. We attempt to keep entries on the cache for at least
-// kTargetTime hours (with frequently accessed items stored for longer periods),
-// but if we cannot do that, we fall-back to keep each list roughly the same
-// size so that we have a chance to see an element again and move it to another
-// list.
+// Entries are assigned to separate groups depending on how often they are
+// used. When we see an element for the first time, it goes to the NO_USE
+// group; if the object is reused later on, we move it to the LOW_USE group,
+// until it is used kHighUse times, at which point it is moved to the HIGH_USE
+// group.
+
+// When we have to evict an element, first we try to use the oldest elements
+// from the NO_USE group, then we move to the LOW_USE group and only then we
+// evict entries from the HIGH_USE group.
+
+// Unlike the previous version of the cache, the ranking information lives on
+// the index cells, so there are no lists to walk: the index is asked for the
+// cells with the oldest timestamps, and those cells are evicted.
 
 #include "net/disk_cache/blockfile/eviction_v3.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/message_loop/message_loop.h"
+#include "base/metrics/histogram.h"
 #include "base/strings/string_util.h"
 #include "base/time/time.h"
 #include "net/disk_cache/blockfile/backend_impl_v3.h"
@@ -48,12 +49,12 @@ using base::TimeTicks;
 namespace {
 
 const int kCleanUpMargin = 1024 * 1024;
-
-#if defined(V3_NOT_JUST_YET_READY)
-const int kHighUse = 10;  // Reuse count to be on the HIGH_USE list.
-const int kTargetTime = 24 * 7;  // Time to be evicted (hours since last use).
+const int kHighUse = 10;  // Reuse count to be on the HIGH_USE group.
 const int kMaxDelayedTrims = 60;
-#endif  // defined(V3_NOT_JUST_YET_READY).
+const int kMaxCellReuse = 15;  // The reuse field of a cell has 4 bits.
+
+// Used by TrimGroup() to evict entries regardless of their group.
+const int kAllGroups = -1;
 
 int LowWaterAdjust(int high_water) {
   if (high_water < kCleanUpMargin)
@@ -62,11 +63,9 @@ int LowWaterAdjust(int high_water) {
   return high_water - kCleanUpMargin;
 }
 
-#if defined(V3_NOT_JUST_YET_READY)
 bool FallingBehind(int current_size, int max_size) {
   return current_size > max_size - kCleanUpMargin * 20;
 }
-#endif  // defined(V3_NOT_JUST_YET_READY).
 
 }  // namespace
 
@@ -77,7 +76,6 @@ namespace disk_cache {
 EvictionV3::EvictionV3()
     : backend_(NULL),
       index_(NULL),
-      header_(NULL),
       init_(false),
       ptr_factory_(this) {
 }
@@ -90,8 +88,6 @@ void EvictionV3::Init(BackendImplV3* backend) {
   // when we're actually doing work.
   backend_ = backend;
   index_ = &backend_->index_;
-  header_ = index_->header();
-  max_size_ = LowWaterAdjust(backend_->max_size_);
   lru_ = backend->lru_eviction_;
   first_trim_ = true;
   trimming_ = false;
@@ -114,121 +110,86 @@ void EvictionV3::Stop() {
   ptr_factory_.InvalidateWeakPtrs();
 }
 
-#if defined(V3_NOT_JUST_YET_READY)
-void EvictionV3::TrimCache() {
+void EvictionV3::TrimCache(bool empty) {
   if (backend_->disabled_ || trimming_)
     return;
 
   if (!empty && !ShouldTrim())
     return PostDelayedTrim();
 
-  if (new_eviction_)
-    return TrimCacheV2(empty);
-
   Trace("*** Trim Cache ***");
   trimming_ = true;
   TimeTicks start = TimeTicks::Now();
-  Rankings::ScopedRankingsBlock node(rankings_);
-  Rankings::ScopedRankingsBlock next(
-      rankings_, rankings_->GetPrev(node.get(), Rankings::NO_USE));
   int deleted_entries = 0;
-  int target_size = empty ? 0 : max_size_;
-  while ((header_->num_bytes > target_size || test_mode_) && next.get()) {
-    // The iterator could be invalidated within EvictEntry().
-    if (!next->HasData())
-      break;
-    node.reset(next.release());
-    next.reset(rankings_->GetPrev(node.get(), Rankings::NO_USE));
-    if (node->Data()->dirty != backend_->GetCurrentEntryId() || empty) {
-      // This entry is not being used by anybody.
-      // Do NOT use node as an iterator after this point.
-      rankings_->TrackRankingsBlock(node.get(), false);
-      if (EvictEntry(node.get(), empty, Rankings::NO_USE) && !test_mode_)
-        deleted_entries++;
+  int target_size = empty ? 0 : LowWaterAdjust(backend_->max_size_);
 
-      if (!empty && test_mode_)
+  if (lru_ || empty) {
+    TrimGroup(kAllGroups, empty, target_size, start, &deleted_entries);
+  } else {
+    for (int group = ENTRY_NO_USE; group <= ENTRY_HIGH_USE; group++) {
+      if (!TrimGroup(group, empty, target_size, start, &deleted_entries))
         break;
     }
-    if (!empty && (deleted_entries > 20 ||
-                   (TimeTicks::Now() - start).InMilliseconds() > 20)) {
-      base::MessageLoop::current()->PostTask(
-          FROM_HERE,
-          base::Bind(&EvictionV3::TrimCache, ptr_factory_.GetWeakPtr(), false));
-      break;
-    }
   }
 
   if (empty) {
-    CACHE_UMA(AGE_MS, "TotalClearTimeV1", 0, start);
+    CACHE_UMA(AGE_MS, "TotalClearTime", start);
   } else {
-    CACHE_UMA(AGE_MS, "TotalTrimTimeV1", 0, start);
+    CACHE_UMA(AGE_MS, "TotalTrimTime", start);
   }
-  CACHE_UMA(COUNTS, "TrimItemsV1", 0, deleted_entries);
+  CACHE_UMA(COUNTS, "TrimItems", deleted_entries);
 
   trimming_ = false;
   Trace("*** Trim Cache end ***");
-  return;
+}
+
+void EvictionV3::UpdateRank(EntryImplV3* entry, bool modified) {
+  CacheEntryBlockV3* block = entry->entry();
+  Time current = Time::Now();
+  block->Data()->last_access_time = current.ToInternalValue();
+  if (modified)
+    block->Data()->last_modified_time = current.ToInternalValue();
+  block->set_modified();
+
+  index_->UpdateTime(entry->GetHash(), block->address(), current);
+
+  // The first modification of an entry has to be recorded by the index, so
+  // that a crash before the entry is closed can be detected.
+  if (modified && !entry->modified()) {
+    entry->set_modified();
+    index_->SetSate(entry->GetHash(), block->address(), ENTRY_MODIFIED);
+  }
 }
 
 void EvictionV3::OnOpenEntry(EntryImplV3* entry) {
-  EntryStore* info = entry->entry()->Data();
-  DCHECK_EQ(ENTRY_NORMAL, info->state);
+  if (lru_)
+    return;
 
-  if (info->reuse_count < kint32max) {
+  EntryRecord* info = entry->entry()->Data();
+  if (info->reuse_count < kuint8max) {
     info->reuse_count++;
     entry->entry()->set_modified();
-
-    // We may need to move this to a new list.
-    if (1 == info->reuse_count) {
-      rankings_->Remove(entry->rankings(), Rankings::NO_USE, true);
-      rankings_->Insert(entry->rankings(), false, Rankings::LOW_USE);
-      entry->entry()->Store();
-    } else if (kHighUse == info->reuse_count) {
-      rankings_->Remove(entry->rankings(), Rankings::LOW_USE, true);
-      rankings_->Insert(entry->rankings(), false, Rankings::HIGH_USE);
-      entry->entry()->Store();
-    }
   }
-}
 
-void EvictionV3::OnCreateEntry(EntryImplV3* entry) {
-  EntryStore* info = entry->entry()->Data();
-  switch (info->state) {
-    case ENTRY_NORMAL: {
-      DCHECK(!info->reuse_count);
-      DCHECK(!info->refetch_count);
-      break;
-    };
-    case ENTRY_EVICTED: {
-      if (info->refetch_count < kint32max)
-        info->refetch_count++;
-
-      if (info->refetch_count > kHighUse && info->reuse_count < kHighUse) {
-        info->reuse_count = kHighUse;
-      } else {
-        info->reuse_count++;
-      }
-      info->state = ENTRY_NORMAL;
-      entry->entry()->Store();
-      rankings_->Remove(entry->rankings(), Rankings::DELETED, true);
-      break;
-    };
-    default:
-      NOTREACHED();
-  }
+  EntryCell cell = index_->FindEntryCell(entry->GetHash(),
+                                         entry->entry()->address());
+  if (!cell.IsValid())
+    return;
+
+  // We may need to move this to a new group.
+  if (cell.GetGroup() == ENTRY_NO_USE)
+    cell.SetGroup(ENTRY_LOW_USE);
+  if (cell.GetGroup() == ENTRY_LOW_USE && info->reuse_count >= kHighUse)
+    cell.SetGroup(ENTRY_HIGH_USE);
 
-  rankings_->Insert(entry->rankings(), true, GetListForEntryV2(entry));
+  cell.SetReuse(std::min<int>(info->reuse_count, kMaxCellReuse));
+  index_->Save(&cell);
 }
 
 void EvictionV3::SetTestMode() {
   test_mode_ = true;
 }
 
-void EvictionV3::TrimDeletedList(bool empty) {
-  DCHECK(test_mode_ && new_eviction_);
-  TrimDeleted(empty);
-}
-
 // -----------------------------------------------------------------------
 
 void EvictionV3::PostDelayedTrim() {
@@ -252,7 +213,8 @@ void EvictionV3::DelayedTrim() {
 }
 
 bool EvictionV3::ShouldTrim() {
-  if (!FallingBehind(header_->num_bytes, max_size_) &&
+  if (!FallingBehind(index_->header()->num_bytes,
+                     LowWaterAdjust(backend_->max_size_)) &&
       trim_delays_ < kMaxDelayedTrims && backend_->IsLoaded()) {
     return false;
   }
@@ -262,251 +224,84 @@ bool EvictionV3::ShouldTrim() {
   return true;
 }
 
-bool EvictionV3::ShouldTrimDeleted() {
-  int index_load = header_->num_entries * 100 / index_size_;
-
-  // If the index is not loaded, the deleted list will tend to double the size
-  // of the other lists 3 lists (40% of the total). Otherwise, all lists will be
-  // about the same size.
-  int max_length = (index_load < 25) ? header_->num_entries * 2 / 5 :
-                                       header_->num_entries / 4;
-  return (!test_mode_ && header_->lru.sizes[Rankings::DELETED] > max_length);
-}
-
-bool Eviction::EvictEntry(CacheRankingsBlock* node, bool empty,
-                          Rankings::List list) {
-  EntryImplV3* entry = backend_->GetEnumeratedEntry(node, list);
-  if (!entry) {
-    Trace("NewEntry failed on Trim 0x%x", node->address().value());
-    return false;
-  }
-
-  ReportTrimTimes(entry);
-  if (empty || !new_eviction_) {
-    entry->DoomImpl();
-  } else {
-    entry->DeleteEntryData(false);
-    EntryStore* info = entry->entry()->Data();
-    DCHECK_EQ(ENTRY_NORMAL, info->state);
-
-    rankings_->Remove(entry->rankings(), GetListForEntryV2(entry), true);
-    info->state = ENTRY_EVICTED;
-    entry->entry()->Store();
-    rankings_->Insert(entry->rankings(), true, Rankings::DELETED);
-  }
-  if (!empty)
-    backend_->OnEvent(Stats::TRIM_ENTRY);
-
-  entry->Release();
-
-  return true;
-}
-
-void EvictionV3::TrimCacheV2(bool empty) {
-  Trace("*** Trim Cache ***");
-  trimming_ = true;
-  TimeTicks start = TimeTicks::Now();
-
-  const int kListsToSearch = 3;
-  Rankings::ScopedRankingsBlock next[kListsToSearch];
-  int list = Rankings::LAST_ELEMENT;
-
-  // Get a node from each list.
-  for (int i = 0; i < kListsToSearch; i++) {
-    bool done = false;
-    next[i].set_rankings(rankings_);
-    if (done)
-      continue;
-    next[i].reset(rankings_->GetPrev(NULL, static_cast<Rankings::List>(i)));
-    if (!empty && NodeIsOldEnough(next[i].get(), i)) {
-      list = static_cast<Rankings::List>(i);
-      done = true;
+bool EvictionV3::TrimGroup(int group, bool empty, int target_size,
+                           const TimeTicks& start, int* deleted_entries) {
+  IndexIterator iterator;
+  iterator.forward = true;
+  iterator.timestamp = -1;
+
+  while (index_->header()->num_bytes > target_size || test_mode_) {
+    if (!index_->GetNextCells(&iterator))
+      return true;
+
+    CellList cells;
+    for (size_t i = 0; i < iterator.cells.size(); i++) {
+      const CellInfo& info = iterator.cells[i];
+      if (group != kAllGroups) {
+        EntryCell cell = index_->FindEntryCell(info.hash, info.address);
+        if (!cell.IsValid() || cell.GetGroup() != group)
+          continue;
+      }
+      cells.push_back(info);
     }
-  }
+    backend_->SortCells(&cells, true);
 
-  // If we are not meeting the time targets lets move on to list length.
-  if (!empty && Rankings::LAST_ELEMENT == list)
-    list = SelectListByLength(next);
+    for (size_t i = 0; i < cells.size(); i++) {
+      if (index_->header()->num_bytes <= target_size && !test_mode_)
+        return false;
 
-  if (empty)
-    list = 0;
+      // Entries in use are not evicted, unless the whole cache goes away.
+      if (!empty && backend_->GetOpenEntry(cells[i].address))
+        continue;
 
-  Rankings::ScopedRankingsBlock node(rankings_);
-  int deleted_entries = 0;
-  int target_size = empty ? 0 : max_size_;
+      if (EvictEntry(cells[i], empty))
+        (*deleted_entries)++;
 
-  for (; list < kListsToSearch; list++) {
-    while ((header_->num_bytes > target_size || test_mode_) &&
-           next[list].get()) {
-      // The iterator could be invalidated within EvictEntry().
-      if (!next[list]->HasData())
-        break;
-      node.reset(next[list].release());
-      next[list].reset(rankings_->GetPrev(node.get(),
-                                          static_cast<Rankings::List>(list)));
-      if (node->Data()->dirty != backend_->GetCurrentEntryId() || empty) {
-        // This entry is not being used by anybody.
-        // Do NOT use node as an iterator after this point.
-        rankings_->TrackRankingsBlock(node.get(), false);
-        if (EvictEntry(node.get(), empty, static_cast<Rankings::List>(list)))
-          deleted_entries++;
-
-        if (!empty && test_mode_)
-          break;
-      }
-      if (!empty && (deleted_entries > 20 ||
+      if (!empty && test_mode_)
+        return false;
+
+      if (!empty && (*deleted_entries > 20 ||
                      (TimeTicks::Now() - start).InMilliseconds() > 20)) {
         base::MessageLoop::current()->PostTask(
             FROM_HERE,
-            base::Bind(&Eviction::TrimCache, ptr_factory_.GetWeakPtr(), false));
-        break;
+            base::Bind(&EvictionV3::TrimCache, ptr_factory_.GetWeakPtr(),
+                       false));
+        return false;
       }
     }
-    if (!empty)
-      list = kListsToSearch;
-  }
-
-  if (empty) {
-    TrimDeleted(true);
-  } else if (ShouldTrimDeleted()) {
-    base::MessageLoop::current()->PostTask(
-        FROM_HERE,
-        base::Bind(&EvictionV3::TrimDeleted, ptr_factory_.GetWeakPtr(), empty));
-  }
-
-  if (empty) {
-    CACHE_UMA(AGE_MS, "TotalClearTimeV2", 0, start);
-  } else {
-    CACHE_UMA(AGE_MS, "TotalTrimTimeV2", 0, start);
   }
-  CACHE_UMA(COUNTS, "TrimItemsV2", 0, deleted_entries);
-
-  Trace("*** Trim Cache end ***");
-  trimming_ = false;
-  return;
+  return false;
 }
 
-// This is a minimal implementation that just discards the oldest nodes.
-// TODO(rvargas): Do something better here.
-void EvictionV3::TrimDeleted(bool empty) {
-  Trace("*** Trim Deleted ***");
-  if (backend_->disabled_)
-    return;
-
-  TimeTicks start = TimeTicks::Now();
-  Rankings::ScopedRankingsBlock node(rankings_);
-  Rankings::ScopedRankingsBlock next(
-    rankings_, rankings_->GetPrev(node.get(), Rankings::DELETED));
-  int deleted_entries = 0;
-  while (next.get() &&
-         (empty || (deleted_entries < 20 &&
-                    (TimeTicks::Now() - start).InMilliseconds() < 20))) {
-    node.reset(next.release());
-    next.reset(rankings_->GetPrev(node.get(), Rankings::DELETED));
-    if (RemoveDeletedNode(node.get()))
-      deleted_entries++;
-    if (test_mode_)
-      break;
+bool EvictionV3::EvictEntry(const CellInfo& cell, bool empty) {
+  EntryImplV3* entry = backend_->GetEnumeratedEntry(cell);
+  if (!entry) {
+    Trace("NewEntry failed on Trim 0x%x", cell.address.value());
+    return false;
   }
 
-  if (deleted_entries && !empty && ShouldTrimDeleted()) {
-    base::MessageLoop::current()->PostTask(
-        FROM_HERE,
-        base::Bind(&EvictionV3::TrimDeleted, ptr_factory_.GetWeakPtr(), false));
-  }
+  ReportTrimTimes(entry);
+  entry->DoomImpl();
+  if (!empty)
+    backend_->OnEvent(Stats::TRIM_ENTRY);
 
-  CACHE_UMA(AGE_MS, "TotalTrimDeletedTime", 0, start);
-  CACHE_UMA(COUNTS, "TrimDeletedItems", 0, deleted_entries);
-  Trace("*** Trim Deleted end ***");
-  return;
+  entry->Release();
+  return true;
 }
 
 void EvictionV3::ReportTrimTimes(EntryImplV3* entry) {
-  if (first_trim_) {
-    first_trim_ = false;
-    if (backend_->ShouldReportAgain()) {
-      CACHE_UMA(AGE, "TrimAge", 0, entry->GetLastUsed());
-      ReportListStats();
-    }
-
-    if (header_->lru.filled)
-      return;
-
-    header_->lru.filled = 1;
-
-    if (header_->create_time) {
-      // This is the first entry that we have to evict, generate some noise.
-      backend_->FirstEviction();
-    } else {
-      // This is an old file, but we may want more reports from this user so
-      // lets save some create_time.
-      Time::Exploded old = {0};
-      old.year = 2009;
-      old.month = 3;
-      old.day_of_month = 1;
-      header_->create_time = Time::FromLocalExploded(old).ToInternalValue();
-    }
-  }
-}
-
-bool EvictionV3::NodeIsOldEnough(CacheRankingsBlock* node, int list) {
-  if (!node)
-    return false;
-
-  // If possible, we want to keep entries on each list at least kTargetTime
-  // hours. Each successive list on the enumeration has 2x the target time of
-  // the previous list.
-  Time used = Time::FromInternalValue(node->Data()->last_used);
-  int multiplier = 1 << list;
-  return (Time::Now() - used).InHours() > kTargetTime * multiplier;
-}
-
-int EvictionV3::SelectListByLength(Rankings::ScopedRankingsBlock* next) {
-  int data_entries = header_->num_entries -
-                     header_->lru.sizes[Rankings::DELETED];
-  // Start by having each list to be roughly the same size.
-  if (header_->lru.sizes[0] > data_entries / 3)
-    return 0;
-
-  int list = (header_->lru.sizes[1] > data_entries / 3) ? 1 : 2;
-
-  // Make sure that frequently used items are kept for a minimum time; we know
-  // that this entry is not older than its current target, but it must be at
-  // least older than the target for list 0 (kTargetTime), as long as we don't
-  // exhaust list 0.
-  if (!NodeIsOldEnough(next[list].get(), 0) &&
-      header_->lru.sizes[0] > data_entries / 10)
-    list = 0;
+  if (!first_trim_)
+    return;
 
-  return list;
-}
+  first_trim_ = false;
+  if (backend_->ShouldReportAgain())
+    CACHE_UMA(AGE, "TrimAge", entry->GetLastUsed());
 
-void EvictionV3::ReportListStats() {
-  if (!new_eviction_)
+  if (index_->header()->flags & CACHE_EVICTED)
     return;
 
-  Rankings::ScopedRankingsBlock last1(rankings_,
-      rankings_->GetPrev(NULL, Rankings::NO_USE));
-  Rankings::ScopedRankingsBlock last2(rankings_,
-      rankings_->GetPrev(NULL, Rankings::LOW_USE));
-  Rankings::ScopedRankingsBlock last3(rankings_,
-      rankings_->GetPrev(NULL, Rankings::HIGH_USE));
-  Rankings::ScopedRankingsBlock last4(rankings_,
-      rankings_->GetPrev(NULL, Rankings::DELETED));
-
-  if (last1.get())
-    CACHE_UMA(AGE, "NoUseAge", 0,
-              Time::FromInternalValue(last1.get()->Data()->last_used));
-  if (last2.get())
-    CACHE_UMA(AGE, "LowUseAge", 0,
-              Time::FromInternalValue(last2.get()->Data()->last_used));
-  if (last3.get())
-    CACHE_UMA(AGE, "HighUseAge", 0,
-              Time::FromInternalValue(last3.get()->Data()->last_used));
-  if (last4.get())
-    CACHE_UMA(AGE, "DeletedAge", 0,
-              Time::FromInternalValue(last4.get()->Data()->last_used));
+  // This is the first entry that we have to evict, generate some noise.
+  backend_->FirstEviction();
 }
-#endif  // defined(V3_NOT_JUST_YET_READY).
 
 }  // namespace disk_cache
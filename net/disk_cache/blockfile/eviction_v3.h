@@ -7,21 +7,18 @@
 
 #include "base/basictypes.h"
 #include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
 #include "net/disk_cache/blockfile/disk_format_v3.h"
 #include "net/disk_cache/blockfile/index_table_v3.h"
 
 namespace disk_cache {
 
 class BackendImplV3;
-class CacheRankingsBlock;
 class EntryImplV3;
 
-namespace Rankings {
-typedef int List;
-}
-
 // This class implements the eviction algorithm for the cache and it is tightly
-// integrated with BackendImpl.
+// integrated with BackendImplV3. The ranking information lives on the index
+// (see IndexTable), so this class only decides which cells should go away.
 class EvictionV3 {
  public:
   EvictionV3();
@@ -35,32 +32,29 @@ class EvictionV3 {
   // use.
   void TrimCache(bool empty);
 
-  // Notifications of interesting events for a given entry.
+  // Updates the ranking information for an entry.
+  void UpdateRank(EntryImplV3* entry, bool modified);
+
+  // Notification of an existing entry being opened.
   void OnOpenEntry(EntryImplV3* entry);
-  void OnCreateEntry(EntryImplV3* entry);
 
   // Testing interface.
   void SetTestMode();
-  void TrimDeletedList(bool empty);
 
  private:
   void PostDelayedTrim();
   void DelayedTrim();
   bool ShouldTrim();
-  bool ShouldTrimDeleted();
-  bool EvictEntry(CacheRankingsBlock* node, bool empty, Rankings::List list);
-
-  void TrimCacheV2(bool empty);
-  void TrimDeleted(bool empty);
 
-  bool NodeIsOldEnough(CacheRankingsBlock* node, int list);
-  int SelectListByLength();
-  void ReportListStats();
+  // Evicts the entries of |group| (or from all groups if |group| is negative),
+  // oldest first. Returns true if the caller should keep trimming.
+  bool TrimGroup(int group, bool empty, int target_size,
+                 const base::TimeTicks& start, int* deleted_entries);
+  bool EvictEntry(const CellInfo& cell, bool empty);
+  void ReportTrimTimes(EntryImplV3* entry);
 
   BackendImplV3* backend_;
   IndexTable* index_;
-  IndexHeaderV3* header_;
-  int max_size_;
   int trim_delays_;
   bool lru_;
   bool first_trim_;
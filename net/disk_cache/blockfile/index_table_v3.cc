@@ -412,7 +412,10 @@ IndexIterator::IndexIterator() {
 IndexIterator::~IndexIterator() {
 }
 
-IndexTableInitData::IndexTableInitData() {
+IndexTableInitData::IndexTableInitData()
+    : index_bitmap(NULL),
+      main_table(NULL),
+      extra_table(NULL) {
 }
 
 IndexTableInitData::~IndexTableInitData() {
@@ -464,7 +467,7 @@ void IndexTable::Init(IndexTableInitData* params) {
       // This is doubling the size of main table.
       DCHECK_EQ(base::bits::Log2Floor(header_->table_len),
                 base::bits::Log2Floor(backup_header_->table_len) + 1);
-      int extra_size = (header()->max_bucket - mask_) * kCellsPerBucket;
+      int extra_size = header()->max_bucket - mask_;
       DCHECK_GE(extra_size, 0);
 
       // Doubling the size implies deleting the extra table and moving as many
@@ -636,16 +639,15 @@ EntryCell IndexTable::CreateEntryCell(uint32 hash, Addr address) {
 
   if (!found) {
     bucket_num = NewExtraBucket();
-    if (bucket_num) {
-      cell_num = bucket_num * kCellsPerBucket;
-      bucket->next = cell_num;
-      bucket = &extra_table_[bucket_num - (mask_ + 1)];
-      bucket->hash = hash & mask_;
-      found = true;
-    } else {
-      // address 0 is a reserved value, and the caller interprets it as invalid.
-      address.set_value(0);
+    if (!bucket_num) {
+      // The table is full. An empty cell is interpreted by the caller as
+      // invalid.
+      return EntryCell();
     }
+    cell_num = bucket_num * kCellsPerBucket;
+    bucket->next = cell_num;
+    bucket = &extra_table_[bucket_num - (mask_ + 1)];
+    bucket->hash = hash & mask_;
   }
 
   EntryCell entry_cell(cell_num, hash, address, small_table_);
@@ -655,12 +657,10 @@ EntryCell IndexTable::CreateEntryCell(uint32 hash, Addr address) {
     entry_cell.SetGroup(ENTRY_NO_USE);
   Save(&entry_cell);
 
-  if (found) {
-    bitmap_->Set(cell_num, true);
-    backup_bitmap_->Set(cell_num, true);
-    header()->used_cells++;
-    modified_ = true;
-  }
+  bitmap_->Set(cell_num, true);
+  backup_bitmap_->Set(cell_num, true);
+  header()->used_cells++;
+  modified_ = true;
 
   return entry_cell;
 }
@@ -702,7 +702,7 @@ void IndexTable::SetSate(uint32 hash, Addr address, EntryState state) {
       break;
     case ENTRY_DELETED:
       DCHECK(old_state == ENTRY_NEW || old_state == ENTRY_OPEN ||
-             old_state == ENTRY_MODIFIED);
+             old_state == ENTRY_MODIFIED || old_state == ENTRY_FIXING);
       break;
     case ENTRY_USED:
       DCHECK(old_state == ENTRY_NEW || old_state == ENTRY_OPEN ||
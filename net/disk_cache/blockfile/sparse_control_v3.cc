@@ -2,7 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#include "net/disk_cache/blockfile/sparse_control.h"
+#include "net/disk_cache/blockfile/sparse_control_v3.h"
 
 #include "base/bind.h"
 #include "base/format_macros.h"
@@ -13,8 +13,8 @@
 #include "base/time/time.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
-#include "net/disk_cache/blockfile/backend_impl.h"
-#include "net/disk_cache/blockfile/entry_impl.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
+#include "net/disk_cache/blockfile/entry_impl_v3.h"
 #include "net/disk_cache/blockfile/file.h"
 #include "net/disk_cache/net_log_parameters.h"
 
@@ -53,10 +53,10 @@ class ChildrenDeleter
     : public base::RefCounted<ChildrenDeleter>,
       public disk_cache::FileIOCallback {
  public:
-  ChildrenDeleter(disk_cache::BackendImpl* backend, const std::string& name)
+  ChildrenDeleter(disk_cache::BackendImplV3* backend, const std::string& name)
       : backend_(backend->GetWeakPtr()), name_(name), signature_(0) {}
 
-  virtual void OnFileIOComplete(int bytes_copied) override;
+  void OnFileIOComplete(int bytes_copied) override;
 
   // Two ways of deleting the children: if we have the children map, use Start()
   // directly, otherwise pass the data address to ReadData().
@@ -65,11 +65,11 @@ class ChildrenDeleter
 
  private:
   friend class base::RefCounted<ChildrenDeleter>;
-  virtual ~ChildrenDeleter() {}
+  ~ChildrenDeleter() override {}
 
   void DeleteChildren();
 
-  base::WeakPtr<disk_cache::BackendImpl> backend_;
+  base::WeakPtr<disk_cache::BackendImplV3> backend_;
   std::string name_;
   disk_cache::Bitmap children_map_;
   int64 signature_;
@@ -104,7 +104,7 @@ void ChildrenDeleter::Start(char* buffer, int len) {
 
 void ChildrenDeleter::ReadData(disk_cache::Addr address, int len) {
   DCHECK(address.is_block_file());
-  if (!backend_)
+  if (!backend_.get())
     return Release();
 
   disk_cache::File* file(backend_->File(address));
@@ -127,7 +127,7 @@ void ChildrenDeleter::ReadData(disk_cache::Addr address, int len) {
 
 void ChildrenDeleter::DeleteChildren() {
   int child_id = 0;
-  if (!children_map_.FindNextSetBit(&child_id) || !backend_) {
+  if (!children_map_.FindNextSetBit(&child_id) || !backend_.get()) {
     // We are done. Just delete this object.
     return Release();
   }
@@ -140,17 +140,15 @@ void ChildrenDeleter::DeleteChildren() {
       FROM_HERE, base::Bind(&ChildrenDeleter::DeleteChildren, this));
 }
 
-// -----------------------------------------------------------------------
-
 // Returns the NetLog event type corresponding to a SparseOperation.
 net::NetLog::EventType GetSparseEventType(
-    disk_cache::SparseControl::SparseOperation operation) {
+    disk_cache::SparseControlV3::SparseOperation operation) {
   switch (operation) {
-    case disk_cache::SparseControl::kReadOperation:
+    case disk_cache::SparseControlV3::kReadOperation:
       return net::NetLog::TYPE_SPARSE_READ;
-    case disk_cache::SparseControl::kWriteOperation:
+    case disk_cache::SparseControlV3::kWriteOperation:
       return net::NetLog::TYPE_SPARSE_WRITE;
-    case disk_cache::SparseControl::kGetRangeOperation:
+    case disk_cache::SparseControlV3::kGetRangeOperation:
       return net::NetLog::TYPE_SPARSE_GET_RANGE;
     default:
       NOTREACHED();
@@ -161,18 +159,18 @@ net::NetLog::EventType GetSparseEventType(
 // Logs the end event for |operation| on a child entry.  Range operations log
 // no events for each child they search through.
 void LogChildOperationEnd(const net::BoundNetLog& net_log,
-                          disk_cache::SparseControl::SparseOperation operation,
+                          disk_cache::SparseControlV3::SparseOperation operation,
                           int result) {
   if (net_log.IsLogging()) {
     net::NetLog::EventType event_type;
     switch (operation) {
-      case disk_cache::SparseControl::kReadOperation:
+      case disk_cache::SparseControlV3::kReadOperation:
         event_type = net::NetLog::TYPE_SPARSE_READ_CHILD_DATA;
         break;
-      case disk_cache::SparseControl::kWriteOperation:
+      case disk_cache::SparseControlV3::kWriteOperation:
         event_type = net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA;
         break;
-      case disk_cache::SparseControl::kGetRangeOperation:
+      case disk_cache::SparseControlV3::kGetRangeOperation:
         return;
       default:
         NOTREACHED();
@@ -186,7 +184,7 @@ void LogChildOperationEnd(const net::BoundNetLog& net_log,
 
 namespace disk_cache {
 
-SparseControl::SparseControl(EntryImpl* entry)
+SparseControlV3::SparseControlV3(EntryImplV3* entry)
     : entry_(entry),
       child_(NULL),
       operation_(kNoOperation),
@@ -205,14 +203,35 @@ SparseControl::SparseControl(EntryImpl* entry)
   memset(&child_data_, 0, sizeof(child_data_));
 }
 
-SparseControl::~SparseControl() {
+SparseControlV3::~SparseControlV3() {
   if (child_)
     CloseChild();
   if (init_)
     WriteSparseData();
 }
 
-bool SparseControl::CouldBeSparse() const {
+int SparseControlV3::Init() {
+  DCHECK(!init_);
+
+  // We should not have sparse data for the exposed entry.
+  if (entry_->GetDataSize(kSparseData))
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+
+  // Now see if there is something where we store our data.
+  int rv = net::OK;
+  int data_len = entry_->GetDataSize(kSparseIndex);
+  if (!data_len) {
+    rv = CreateSparseEntry();
+  } else {
+    rv = OpenSparseEntry(data_len);
+  }
+
+  if (rv == net::OK)
+    init_ = true;
+  return rv;
+}
+
+bool SparseControlV3::CouldBeSparse() const {
   DCHECK(!init_);
 
   if (entry_->GetDataSize(kSparseData))
@@ -222,7 +241,7 @@ bool SparseControl::CouldBeSparse() const {
   return (entry_->GetDataSize(kSparseIndex) != 0);
 }
 
-int SparseControl::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
+int SparseControlV3::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
                            int buf_len, const CompletionCallback& callback) {
   DCHECK(init_);
   // We don't support simultaneous IO for sparse data.
@@ -233,10 +252,12 @@ int SparseControl::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
     return net::ERR_INVALID_ARGUMENT;
 
   // We only support up to 64 GB.
-  if (offset + buf_len >= 0x1000000000LL || offset + buf_len < 0)
+  if (static_cast<uint64>(offset) + static_cast<unsigned int>(buf_len) >=
+      GG_UINT64_C(0x1000000000)) {
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  }
 
-  DCHECK(!user_buf_);
+  DCHECK(!user_buf_.get());
   DCHECK(user_callback_.is_null());
 
   if (!buf && (op == kReadOperation || op == kWriteOperation))
@@ -272,7 +293,7 @@ int SparseControl::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
   return net::ERR_IO_PENDING;
 }
 
-int SparseControl::GetAvailableRange(int64 offset, int len, int64* start) {
+int SparseControlV3::GetAvailableRange(int64 offset, int len, int64* start) {
   DCHECK(init_);
   // We don't support simultaneous IO for sparse data.
   if (operation_ != kNoOperation)
@@ -293,13 +314,13 @@ int SparseControl::GetAvailableRange(int64 offset, int len, int64* start) {
   return result < 0 ? result : 0;  // Don't mask error codes to the caller.
 }
 
-void SparseControl::CancelIO() {
+void SparseControlV3::CancelIO() {
   if (operation_ == kNoOperation)
     return;
   abort_ = true;
 }
 
-int SparseControl::ReadyToUse(const CompletionCallback& callback) {
+int SparseControlV3::ReadyToUse(const CompletionCallback& callback) {
   if (!abort_)
     return net::OK;
 
@@ -312,7 +333,7 @@ int SparseControl::ReadyToUse(const CompletionCallback& callback) {
 }
 
 // Static
-void SparseControl::DeleteChildren(EntryImpl* entry) {
+void SparseControlV3::DeleteChildren(EntryImplV3* entry) {
   DCHECK(entry->GetEntryFlags() & PARENT_ENTRY);
   int data_len = entry->GetDataSize(kSparseIndex);
   if (data_len < static_cast<int>(sizeof(SparseData)) ||
@@ -331,7 +352,7 @@ void SparseControl::DeleteChildren(EntryImpl* entry) {
 
   entry->net_log().AddEvent(net::NetLog::TYPE_SPARSE_DELETE_CHILDREN);
 
-  DCHECK(entry->backend_);
+  DCHECK(entry->backend_.get());
   ChildrenDeleter* deleter = new ChildrenDeleter(entry->backend_.get(),
                                                  entry->GetKey());
   // The object will self destruct when finished.
@@ -348,38 +369,15 @@ void SparseControl::DeleteChildren(EntryImpl* entry) {
   }
 }
 
-// -----------------------------------------------------------------------
-
-int SparseControl::Init() {
-  DCHECK(!init_);
-
-  // We should not have sparse data for the exposed entry.
-  if (entry_->GetDataSize(kSparseData))
-    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
-
-  // Now see if there is something where we store our data.
-  int rv = net::OK;
-  int data_len = entry_->GetDataSize(kSparseIndex);
-  if (!data_len) {
-    rv = CreateSparseEntry();
-  } else {
-    rv = OpenSparseEntry(data_len);
-  }
-
-  if (rv == net::OK)
-    init_ = true;
-  return rv;
-}
-
 // We are going to start using this entry to store sparse data, so we have to
 // initialize our control info.
-int SparseControl::CreateSparseEntry() {
+int SparseControlV3::CreateSparseEntry() {
   if (CHILD_ENTRY & entry_->GetEntryFlags())
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
 
   memset(&sparse_header_, 0, sizeof(sparse_header_));
   sparse_header_.signature = Time::Now().ToInternalValue();
-  sparse_header_.magic = kIndexMagic;
+  sparse_header_.magic = kIndexMagicV3;
   sparse_header_.parent_key_len = entry_->GetKey().size();
   children_map_.Resize(kNumSparseBits, true);
 
@@ -399,7 +397,7 @@ int SparseControl::CreateSparseEntry() {
 }
 
 // We are opening an entry from disk. Make sure that our control data is there.
-int SparseControl::OpenSparseEntry(int data_len) {
+int SparseControlV3::OpenSparseEntry(int data_len) {
   if (data_len < static_cast<int>(sizeof(SparseData)))
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
 
@@ -425,7 +423,7 @@ int SparseControl::OpenSparseEntry(int data_len) {
 
   // The real validation should be performed by the caller. This is just to
   // double check.
-  if (sparse_header_.magic != kIndexMagic ||
+  if (sparse_header_.magic != kIndexMagicV3 ||
       sparse_header_.parent_key_len !=
           static_cast<int>(entry_->GetKey().size()))
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
@@ -443,7 +441,7 @@ int SparseControl::OpenSparseEntry(int data_len) {
   return net::OK;
 }
 
-bool SparseControl::OpenChild() {
+bool SparseControlV3::OpenChild() {
   DCHECK_GE(result_, 0);
 
   std::string key = GenerateChildKey();
@@ -458,14 +456,14 @@ bool SparseControl::OpenChild() {
   if (!ChildPresent())
     return ContinueWithoutChild(key);
 
-  if (!entry_->backend_)
+  if (!entry_->backend_.get())
     return false;
 
   child_ = entry_->backend_->OpenEntryImpl(key);
   if (!child_)
     return ContinueWithoutChild(key);
 
-  EntryImpl* child = static_cast<EntryImpl*>(child_);
+  EntryImplV3* child = static_cast<EntryImplV3*>(child_);
   if (!(CHILD_ENTRY & child->GetEntryFlags()) ||
       child->GetDataSize(kSparseIndex) <
           static_cast<int>(sizeof(child_data_)))
@@ -481,11 +479,11 @@ bool SparseControl::OpenChild() {
     return KillChildAndContinue(key, true);  // This is a fatal failure.
 
   if (child_data_.header.signature != sparse_header_.signature ||
-      child_data_.header.magic != kIndexMagic)
+      child_data_.header.magic != kIndexMagicV3)
     return KillChildAndContinue(key, false);
 
   if (child_data_.header.last_block_len < 0 ||
-      child_data_.header.last_block_len > kBlockSize) {
+      child_data_.header.last_block_len >= kBlockSize) {
     // Make sure these values are always within range.
     child_data_.header.last_block_len = 0;
     child_data_.header.last_block = -1;
@@ -494,28 +492,45 @@ bool SparseControl::OpenChild() {
   return true;
 }
 
-void SparseControl::CloseChild() {
+void SparseControlV3::CloseChild() {
   scoped_refptr<net::WrappedIOBuffer> buf(
       new net::WrappedIOBuffer(reinterpret_cast<char*>(&child_data_)));
 
   // Save the allocation bitmap before closing the child entry.
   int rv = child_->WriteData(kSparseIndex, 0, buf.get(), sizeof(child_data_),
-                             CompletionCallback(),
-      false);
+                             CompletionCallback(), false);
   if (rv != sizeof(child_data_))
     DLOG(ERROR) << "Failed to save child data";
   child_->Release();
   child_ = NULL;
 }
 
+std::string SparseControlV3::GenerateChildKey() {
+  return GenerateChildName(entry_->GetKey(), sparse_header_.signature,
+                           offset_ >> 20);
+}
+
+// We are deleting the child because something went wrong.
+bool SparseControlV3::KillChildAndContinue(const std::string& key, bool fatal) {
+  SetChildBit(false);
+  child_->DoomImpl();
+  child_->Release();
+  child_ = NULL;
+  if (fatal) {
+    result_ = net::ERR_CACHE_READ_FAILURE;
+    return false;
+  }
+  return ContinueWithoutChild(key);
+}
+
 // We were not able to open this child; see what we can do.
-bool SparseControl::ContinueWithoutChild(const std::string& key) {
+bool SparseControlV3::ContinueWithoutChild(const std::string& key) {
   if (kReadOperation == operation_)
     return false;
   if (kGetRangeOperation == operation_)
     return true;
 
-  if (!entry_->backend_)
+  if (!entry_->backend_.get())
     return false;
 
   child_ = entry_->backend_->CreateEntryImpl(key);
@@ -529,122 +544,7 @@ bool SparseControl::ContinueWithoutChild(const std::string& key) {
   return true;
 }
 
-void SparseControl::WriteSparseData() {
-  scoped_refptr<net::IOBuffer> buf(new net::WrappedIOBuffer(
-      reinterpret_cast<const char*>(children_map_.GetMap())));
-
-  int len = children_map_.ArraySize() * 4;
-  int rv = entry_->WriteData(kSparseIndex, sizeof(sparse_header_), buf.get(),
-                             len, CompletionCallback(), false);
-  if (rv != len) {
-    DLOG(ERROR) << "Unable to save sparse map";
-  }
-}
-
-bool SparseControl::DoChildIO() {
-  finished_ = true;
-  if (!buf_len_ || result_ < 0)
-    return false;
-
-  if (!OpenChild())
-    return false;
-
-  if (!VerifyRange())
-    return false;
-
-  // We have more work to do. Let's not trigger a callback to the caller.
-  finished_ = false;
-  CompletionCallback callback;
-  if (!user_callback_.is_null()) {
-    callback =
-        base::Bind(&SparseControl::OnChildIOCompleted, base::Unretained(this));
-  }
-
-  int rv = 0;
-  switch (operation_) {
-    case kReadOperation:
-      if (entry_->net_log().IsLogging()) {
-        entry_->net_log().BeginEvent(
-            net::NetLog::TYPE_SPARSE_READ_CHILD_DATA,
-            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
-                                                child_len_));
-      }
-      rv = child_->ReadDataImpl(kSparseData, child_offset_, user_buf_.get(),
-                                child_len_, callback);
-      break;
-    case kWriteOperation:
-      if (entry_->net_log().IsLogging()) {
-        entry_->net_log().BeginEvent(
-            net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA,
-            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
-                                                child_len_));
-      }
-      rv = child_->WriteDataImpl(kSparseData, child_offset_, user_buf_.get(),
-                                 child_len_, callback, false);
-      break;
-    case kGetRangeOperation:
-      rv = DoGetAvailableRange();
-      break;
-    default:
-      NOTREACHED();
-  }
-
-  if (rv == net::ERR_IO_PENDING) {
-    if (!pending_) {
-      pending_ = true;
-      // The child will protect himself against closing the entry while IO is in
-      // progress. However, this entry can still be closed, and that would not
-      // be a good thing for us, so we increase the refcount until we're
-      // finished doing sparse stuff.
-      entry_->AddRef();  // Balanced in DoUserCallback.
-    }
-    return false;
-  }
-  if (!rv)
-    return false;
-
-  DoChildIOCompleted(rv);
-  return true;
-}
-
-void SparseControl::DoChildIOCompleted(int result) {
-  LogChildOperationEnd(entry_->net_log(), operation_, result);
-  if (result < 0) {
-    // We fail the whole operation if we encounter an error.
-    result_ = result;
-    return;
-  }
-
-  UpdateRange(result);
-
-  result_ += result;
-  offset_ += result;
-  buf_len_ -= result;
-
-  // We'll be reusing the user provided buffer for the next chunk.
-  if (buf_len_ && user_buf_)
-    user_buf_->DidConsume(result);
-}
-
-std::string SparseControl::GenerateChildKey() {
-  return GenerateChildName(entry_->GetKey(), sparse_header_.signature,
-                           offset_ >> 20);
-}
-
-// We are deleting the child because something went wrong.
-bool SparseControl::KillChildAndContinue(const std::string& key, bool fatal) {
-  SetChildBit(false);
-  child_->DoomImpl();
-  child_->Release();
-  child_ = NULL;
-  if (fatal) {
-    result_ = net::ERR_CACHE_READ_FAILURE;
-    return false;
-  }
-  return ContinueWithoutChild(key);
-}
-
-bool SparseControl::ChildPresent() {
+bool SparseControlV3::ChildPresent() {
   int child_bit = static_cast<int>(offset_ >> 20);
   if (children_map_.Size() <= child_bit)
     return false;
@@ -652,7 +552,7 @@ bool SparseControl::ChildPresent() {
   return children_map_.Get(child_bit);
 }
 
-void SparseControl::SetChildBit(bool value) {
+void SparseControlV3::SetChildBit(bool value) {
   int child_bit = static_cast<int>(offset_ >> 20);
 
   // We may have to increase the bitmap of child entries.
@@ -662,7 +562,19 @@ void SparseControl::SetChildBit(bool value) {
   children_map_.Set(child_bit, value);
 }
 
-bool SparseControl::VerifyRange() {
+void SparseControlV3::WriteSparseData() {
+  scoped_refptr<net::IOBuffer> buf(new net::WrappedIOBuffer(
+      reinterpret_cast<const char*>(children_map_.GetMap())));
+
+  int len = children_map_.ArraySize() * 4;
+  int rv = entry_->WriteData(kSparseIndex, sizeof(sparse_header_), buf.get(),
+                             len, CompletionCallback(), false);
+  if (rv != len) {
+    DLOG(ERROR) << "Unable to save sparse map";
+  }
+}
+
+bool SparseControlV3::VerifyRange() {
   DCHECK_GE(result_, 0);
 
   child_offset_ = static_cast<int>(offset_) & (kMaxEntrySize - 1);
@@ -678,7 +590,7 @@ bool SparseControl::VerifyRange() {
   if (child_map_.FindNextBit(&start, last_bit, false)) {
     // Something is not here.
     DCHECK_GE(child_data_.header.last_block_len, 0);
-    DCHECK_LT(child_data_.header.last_block_len, kMaxEntrySize);
+    DCHECK_LT(child_data_.header.last_block_len, kBlockSize);
     int partial_block_len = PartialBlockLength(start);
     if (start == child_offset_ >> 10) {
       // It looks like we don't have anything.
@@ -698,12 +610,12 @@ bool SparseControl::VerifyRange() {
   return true;
 }
 
-void SparseControl::UpdateRange(int result) {
+void SparseControlV3::UpdateRange(int result) {
   if (result <= 0 || operation_ != kWriteOperation)
     return;
 
   DCHECK_GE(child_data_.header.last_block_len, 0);
-  DCHECK_LT(child_data_.header.last_block_len, kMaxEntrySize);
+  DCHECK_LT(child_data_.header.last_block_len, kBlockSize);
 
   // Write the bitmap.
   int first_bit = child_offset_ >> 10;
@@ -735,22 +647,17 @@ void SparseControl::UpdateRange(int result) {
   child_map_.SetRange(first_bit, last_bit, true);
 }
 
-int SparseControl::PartialBlockLength(int block_index) const {
+int SparseControlV3::PartialBlockLength(int block_index) const {
   if (block_index == child_data_.header.last_block)
     return child_data_.header.last_block_len;
 
-  // This may be the last stored index.
-  int entry_len = child_->GetDataSize(kSparseData);
-  if (block_index == entry_len >> 10)
-    return entry_len & (kBlockSize - 1);
-
   // This is really empty.
   return 0;
 }
 
-void SparseControl::InitChildData() {
+void SparseControlV3::InitChildData() {
   // We know the real type of child_.
-  EntryImpl* child = static_cast<EntryImpl*>(child_);
+  EntryImplV3* child = static_cast<EntryImplV3*>(child_);
   child->SetEntryFlags(CHILD_ENTRY);
 
   memset(&child_data_, 0, sizeof(child_data_));
@@ -766,31 +673,140 @@ void SparseControl::InitChildData() {
   SetChildBit(true);
 }
 
-int SparseControl::DoGetAvailableRange() {
+void SparseControlV3::DoChildrenIO() {
+  while (DoChildIO()) continue;
+
+  // Range operations are finished synchronously, often without setting
+  // |finished_| to true.
+  if (kGetRangeOperation == operation_ &&
+      entry_->net_log().IsLogging()) {
+    entry_->net_log().EndEvent(
+        net::NetLog::TYPE_SPARSE_GET_RANGE,
+        CreateNetLogGetAvailableRangeResultCallback(offset_, result_));
+  }
+  if (finished_) {
+    if (kGetRangeOperation != operation_ &&
+        entry_->net_log().IsLogging()) {
+      entry_->net_log().EndEvent(GetSparseEventType(operation_));
+    }
+    if (pending_)
+      DoUserCallback();  // Don't touch this object after this point.
+  }
+}
+
+bool SparseControlV3::DoChildIO() {
+  finished_ = true;
+  if (!buf_len_ || result_ < 0)
+    return false;
+
+  if (!OpenChild())
+    return false;
+
+  if (!VerifyRange())
+    return false;
+
+  // We have more work to do. Let's not trigger a callback to the caller.
+  finished_ = false;
+  CompletionCallback callback;
+  if (!user_callback_.is_null()) {
+    callback =
+        base::Bind(&SparseControlV3::OnChildIOCompleted, base::Unretained(this));
+  }
+
+  int rv = 0;
+  switch (operation_) {
+    case kReadOperation:
+      if (entry_->net_log().IsLogging()) {
+        entry_->net_log().BeginEvent(
+            net::NetLog::TYPE_SPARSE_READ_CHILD_DATA,
+            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
+                                                child_len_));
+      }
+      rv = child_->ReadDataImpl(kSparseData, child_offset_, user_buf_.get(),
+                                child_len_, callback);
+      break;
+    case kWriteOperation:
+      if (entry_->net_log().IsLogging()) {
+        entry_->net_log().BeginEvent(
+            net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA,
+            CreateNetLogSparseReadWriteCallback(child_->net_log().source(),
+                                                child_len_));
+      }
+      rv = child_->WriteDataImpl(kSparseData, child_offset_, user_buf_.get(),
+                                 child_len_, callback, false);
+      break;
+    case kGetRangeOperation:
+      rv = DoGetAvailableRange();
+      break;
+    default:
+      NOTREACHED();
+  }
+
+  if (rv == net::ERR_IO_PENDING) {
+    if (!pending_) {
+      pending_ = true;
+      // The child will protect himself against closing the entry while IO is in
+      // progress. However, this entry can still be closed, and that would not
+      // be a good thing for us, so we increase the refcount until we're
+      // finished doing sparse stuff.
+      entry_->AddRef();  // Balanced in DoUserCallback.
+    }
+    return false;
+  }
+  if (!rv)
+    return false;
+
+  DoChildIOCompleted(rv);
+  return true;
+}
+
+int SparseControlV3::DoGetAvailableRange() {
   if (!child_)
     return child_len_;  // Move on to the next child.
 
-  // Check that there are no holes in this range.
-  int last_bit = (child_offset_ + child_len_ + 1023) >> 10;
+  // Bits on the bitmap should only be set when the corresponding block was
+  // fully written (it's really being used). If a block is partially used, it
+  // has to start with valid data, the length of the valid data is saved in
+  // |header.last_block_len| and the block itself should match
+  // |header.last_block|.
+  //
+  // In other words, (|header.last_block| + |header.last_block_len|) is the
+  // offset where the last write ended, and data in that block (which is not
+  // marked as used because it is not full) will only be reused if the next
+  // write continues at that point.
+  //
+  // This code has to find if there is any data between child_offset_ and
+  // child_offset_ + child_len_.
+  int last_bit = (child_offset_ + child_len_ + kBlockSize - 1) >> 10;
   int start = child_offset_ >> 10;
   int partial_start_bytes = PartialBlockLength(start);
   int found = start;
   int bits_found = child_map_.FindBits(&found, last_bit, true);
+  bool is_last_block_in_range = start < child_data_.header.last_block &&
+                                child_data_.header.last_block < last_bit;
 
-  // We don't care if there is a partial block in the middle of the range.
   int block_offset = child_offset_ & (kBlockSize - 1);
-  if (!bits_found && partial_start_bytes <= block_offset)
-    return child_len_;
+  if (!bits_found && partial_start_bytes <= block_offset) {
+    if (!is_last_block_in_range)
+      return child_len_;
+    found = last_bit - 1;  // There are some bytes here.
+  }
 
   // We are done. Just break the loop and reset result_ to our real result.
   range_found_ = true;
 
-  // found now points to the first 1. Lets see if we have zeros before it.
-  int empty_start = std::max((found << 10) - child_offset_, 0);
-
   int bytes_found = bits_found << 10;
   bytes_found += PartialBlockLength(found + bits_found);
 
+  // found now points to the first bytes. Lets see if we have data before it.
+  int empty_start = std::max((found << 10) - child_offset_, 0);
+  if (empty_start >= child_len_)
+    return child_len_;
+
+  // At this point we have bytes_found stored after (found << 10), and we want
+  // child_len_ bytes after child_offset_. The first empty_start bytes after
+  // child_offset_ are invalid.
+
   if (start == found)
     bytes_found -= block_offset;
 
@@ -799,7 +815,7 @@ int SparseControl::DoGetAvailableRange() {
   // query that we have to subtract from the range that we searched.
   result_ = std::min(bytes_found, child_len_ - empty_start);
 
-  if (!bits_found) {
+  if (partial_start_bytes) {
     result_ = std::min(partial_start_bytes - block_offset, child_len_);
     empty_start = 0;
   }
@@ -813,32 +829,26 @@ int SparseControl::DoGetAvailableRange() {
   return 0;
 }
 
-void SparseControl::DoUserCallback() {
-  DCHECK(!user_callback_.is_null());
-  CompletionCallback cb = user_callback_;
-  user_callback_.Reset();
-  user_buf_ = NULL;
-  pending_ = false;
-  operation_ = kNoOperation;
-  int rv = result_;
-  entry_->Release();  // Don't touch object after this line.
-  cb.Run(rv);
-}
+void SparseControlV3::DoChildIOCompleted(int result) {
+  LogChildOperationEnd(entry_->net_log(), operation_, result);
+  if (result < 0) {
+    // We fail the whole operation if we encounter an error.
+    result_ = result;
+    return;
+  }
 
-void SparseControl::DoAbortCallbacks() {
-  for (size_t i = 0; i < abort_callbacks_.size(); i++) {
-    // Releasing all references to entry_ may result in the destruction of this
-    // object so we should not be touching it after the last Release().
-    CompletionCallback cb = abort_callbacks_[i];
-    if (i == abort_callbacks_.size() - 1)
-      abort_callbacks_.clear();
+  UpdateRange(result);
 
-    entry_->Release();  // Don't touch object after this line.
-    cb.Run(net::OK);
-  }
+  result_ += result;
+  offset_ += result;
+  buf_len_ -= result;
+
+  // We'll be reusing the user provided buffer for the next chunk.
+  if (buf_len_ && user_buf_.get())
+    user_buf_->DidConsume(result);
 }
 
-void SparseControl::OnChildIOCompleted(int result) {
+void SparseControlV3::OnChildIOCompleted(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
   DoChildIOCompleted(result);
 
@@ -865,4 +875,29 @@ void SparseControl::OnChildIOCompleted(int result) {
   DoChildrenIO();
 }
 
+void SparseControlV3::DoUserCallback() {
+  DCHECK(!user_callback_.is_null());
+  CompletionCallback cb = user_callback_;
+  user_callback_.Reset();
+  user_buf_ = NULL;
+  pending_ = false;
+  operation_ = kNoOperation;
+  int rv = result_;
+  entry_->Release();  // Don't touch object after this line.
+  cb.Run(rv);
+}
+
+void SparseControlV3::DoAbortCallbacks() {
+  for (size_t i = 0; i < abort_callbacks_.size(); i++) {
+    // Releasing all references to entry_ may result in the destruction of this
+    // object so we should not be touching it after the last Release().
+    CompletionCallback cb = abort_callbacks_[i];
+    if (i == abort_callbacks_.size() - 1)
+      abort_callbacks_.clear();
+
+    entry_->Release();  // Don't touch object after this line.
+    cb.Run(net::OK);
+  }
+}
+
 }  // namespace disk_cache
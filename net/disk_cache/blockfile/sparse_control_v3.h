@@ -12,7 +12,7 @@
 #include "base/compiler_specific.h"
 #include "net/base/completion_callback.h"
 #include "net/disk_cache/blockfile/bitmap.h"
-#include "net/disk_cache/disk_format.h"
+#include "net/disk_cache/blockfile/disk_format_v3.h"
 
 namespace net {
 class IOBuffer;
@@ -22,14 +22,14 @@ class DrainableIOBuffer;
 namespace disk_cache {
 
 class Entry;
-class EntryImpl;
+class EntryImplV3;
 
 // This class provides support for the sparse capabilities of the disk cache.
-// Basically, sparse IO is directed from EntryImpl to this class, and we split
+// Basically, sparse IO is directed from EntryImplV3 to this class, and we split
 // the operation into multiple small pieces, sending each one to the
 // appropriate entry. An instance of this class is asociated with each entry
 // used directly for sparse operations (the entry passed in to the constructor).
-class SparseControl {
+class SparseControlV3 {
  public:
   typedef net::CompletionCallback CompletionCallback;
 
@@ -41,8 +41,13 @@ class SparseControl {
     kGetRangeOperation
   };
 
-  explicit SparseControl(EntryImpl* entry);
-  ~SparseControl();
+  explicit SparseControlV3(EntryImplV3* entry);
+  ~SparseControlV3();
+
+  // Initializes the object for the current entry. If this entry already stores
+  // sparse data, or can be used to do it, it updates the relevant information
+  // on disk and returns net::OK. Otherwise it returns a net error code.
+  int Init();
 
   // Performs a quick test to see if the entry is sparse or not, without
   // generating disk IO (so the answer provided is only a best effort).
@@ -69,14 +74,9 @@ class SparseControl {
   int ReadyToUse(const CompletionCallback& completion_callback);
 
   // Deletes the children entries of |entry|.
-  static void DeleteChildren(EntryImpl* entry);
+  static void DeleteChildren(EntryImplV3* entry);
 
  private:
-  // Initializes the object for the current entry. If this entry already stores
-  // sparse data, or can be used to do it, it updates the relevant information
-  // on disk and returns net::OK. Otherwise it returns a net error code.
-  int Init();
-
   // Creates a new sparse entry or opens an aready created entry from disk.
   // These methods just read / write the required info from disk for the current
   // entry, and verify that everything is correct. The return value is a net
@@ -84,31 +84,19 @@ class SparseControl {
   int CreateSparseEntry();
   int OpenSparseEntry(int data_len);
 
-  // Opens and closes a child entry. A child entry is a regular EntryImpl object
+  // Opens and closes a child entry. A child entry is a regular EntryImplV3 object
   // with a key derived from the key of the resource to store and the range
   // stored by that child.
   bool OpenChild();
   void CloseChild();
-
-  // Continues the current operation (open) without a current child.
-  bool ContinueWithoutChild(const std::string& key);
-
-    // Writes to disk the tracking information for this entry.
-  void WriteSparseData();
-
-  // Performs a single operation with the current child. Returns true when we
-  // should move on to the next child and false when we should interrupt our
-  // work.
-  bool DoChildIO();
-
-  // Performs the required work after a single IO operations finishes.
-  void DoChildIOCompleted(int result);
-
   std::string GenerateChildKey();
 
   // Deletes the current child and continues the current operation (open).
   bool KillChildAndContinue(const std::string& key, bool fatal);
 
+  // Continues the current operation (open) without a current child.
+  bool ContinueWithoutChild(const std::string& key);
+
   // Returns true if the required child is tracked by the parent entry, i.e. it
   // was already created.
   bool ChildPresent();
@@ -117,6 +105,9 @@ class SparseControl {
   // starts or stops tracking this child.
   void SetChildBit(bool value);
 
+  // Writes to disk the tracking information for this entry.
+  void WriteSparseData();
+
   // Verify that the range to be accessed for the current child is appropriate.
   // Returns false if an error is detected or there is no need to perform the
   // current IO operation (for instance if the required range is not stored by
@@ -134,18 +125,29 @@ class SparseControl {
   // Initializes the sparse info for the current child.
   void InitChildData();
 
+  // Iterates through all the children needed to complete the current operation.
+  void DoChildrenIO();
+
+  // Performs a single operation with the current child. Returns true when we
+  // should move on to the next child and false when we should interrupt our
+  // work.
+  bool DoChildIO();
+
   // Performs the required work for GetAvailableRange for one child.
   int DoGetAvailableRange();
 
-  // Reports to the user that we are done.
-  void DoUserCallback();
-  void DoAbortCallbacks();
+  // Performs the required work after a single IO operations finishes.
+  void DoChildIOCompleted(int result);
 
   // Invoked by the callback of asynchronous operations.
   void OnChildIOCompleted(int result);
 
-  EntryImpl* entry_;  // The sparse entry.
-  EntryImpl* child_;  // The current child entry.
+  // Reports to the user that we are done.
+  void DoUserCallback();
+  void DoAbortCallbacks();
+
+  EntryImplV3* entry_;  // The sparse entry.
+  EntryImplV3* child_;  // The current child entry.
   SparseOperation operation_;
   bool pending_;  // True if any child IO operation returned pending.
   bool finished_;
@@ -167,7 +169,7 @@ class SparseControl {
   int child_len_;  // Bytes to read or write for this child.
   int result_;
 
-  DISALLOW_COPY_AND_ASSIGN(SparseControl);
+  DISALLOW_COPY_AND_ASSIGN(SparseControlV3);
 };
 
 }  // namespace disk_cache
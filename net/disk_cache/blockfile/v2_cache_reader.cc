@@ -0,0 +1,114 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/blockfile/v2_cache_reader.h"
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/single_thread_task_runner.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/blockfile/backend_impl.h"
+#include "net/disk_cache/blockfile/disk_format.h"
+#include "net/disk_cache/blockfile/entry_impl.h"
+#include "net/disk_cache/blockfile/rankings.h"
+
+namespace {
+
+const char kIndexName[] = "index";
+
+}  // namespace
+
+namespace disk_cache {
+
+struct V2CacheReader::Enumeration {
+  Rankings::Iterator iterator;
+};
+
+V2CacheReader::EntryData::EntryData() : flags(0) {
+  for (int i = 0; i < kNumStreams; i++)
+    stream_sizes[i] = 0;
+}
+
+V2CacheReader::EntryData::~EntryData() {
+}
+
+V2CacheReader::V2CacheReader(
+    const base::FilePath& path,
+    const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread)
+    : path_(path),
+      cache_thread_(cache_thread) {
+}
+
+V2CacheReader::~V2CacheReader() {
+  if (enumeration_)
+    enumeration_->iterator.Reset();
+}
+
+// static
+bool V2CacheReader::IsV2Cache(const base::FilePath& path) {
+  IndexHeader header;
+  int size = static_cast<int>(sizeof(header));
+  if (base::ReadFile(path.AppendASCII(kIndexName),
+                     reinterpret_cast<char*>(&header), size) != size) {
+    return false;
+  }
+
+  return header.magic == kIndexMagic &&
+         header.version >> 16 == kCurrentVersion >> 16;
+}
+
+bool V2CacheReader::Init(net::CacheType type) {
+  DCHECK(cache_thread_->BelongsToCurrentThread());
+  backend_.reset(new BackendImpl(path_, cache_thread_, NULL));
+  backend_->SetFlags(kNoRandom);
+  backend_->SetMaxSize(kint32max);
+  backend_->SetType(type);
+
+  // Both versions of the format can be read with the new eviction algorithm,
+  // and the upgrade mode prevents changes to the rankings.
+  backend_->SetNewEviction();
+  backend_->SetUpgradeMode();
+  if (backend_->SyncInit() != net::OK) {
+    LOG(ERROR) << "Unable to open the old cache";
+    return false;
+  }
+
+  enumeration_.reset(new Enumeration);
+  return true;
+}
+
+bool V2CacheReader::ReadNextEntry(EntryData* data) {
+  DCHECK(enumeration_);
+  for (;;) {
+    EntryImpl* entry = backend_->OpenNextEntryImpl(&enumeration_->iterator);
+    if (!entry)
+      return false;
+
+    bool success = true;
+    data->key = entry->GetKey();
+    data->last_used = entry->GetLastUsed();
+    data->last_modified = entry->GetLastModified();
+    data->flags = entry->entry()->Data()->flags;
+    for (int i = 0; i < kNumStreams && success; i++) {
+      int size = entry->GetDataSize(i);
+      data->streams[i] = size ? new net::IOBuffer(size) : NULL;
+      data->stream_sizes[i] = size;
+      if (!size)
+        continue;
+
+      // There is no callback, so the read completes synchronously.
+      int rv = entry->ReadDataImpl(i, 0, data->streams[i].get(), size,
+                                   net::CompletionCallback());
+      success = (rv == size);
+    }
+    entry->Release();
+
+    if (success && !data->key.empty())
+      return true;
+    LOG(WARNING) << "Unable to read an entry from the old cache";
+  }
+}
+
+}  // namespace disk_cache
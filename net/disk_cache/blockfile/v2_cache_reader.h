@@ -0,0 +1,76 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_BLOCKFILE_V2_CACHE_READER_H_
+#define NET_DISK_CACHE_BLOCKFILE_V2_CACHE_READER_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
+
+namespace base {
+class SingleThreadTaskRunner;
+}  // namespace base
+
+namespace disk_cache {
+
+class BackendImpl;
+
+// Reads the entries stored by a cache that uses the previous version of the
+// blockfile format (see backend_impl.h), so that they can be imported by
+// BackendImplV3. This object works synchronously, and it must be used on the
+// cache thread.
+class V2CacheReader {
+ public:
+  static const int kNumStreams = 3;
+
+  // The contents of a single entry.
+  struct EntryData {
+    EntryData();
+    ~EntryData();
+
+    std::string key;
+    base::Time last_used;
+    base::Time last_modified;
+    uint32 flags;  // EntryFlags.
+    scoped_refptr<net::IOBuffer> streams[kNumStreams];
+    int stream_sizes[kNumStreams];
+  };
+
+  V2CacheReader(
+      const base::FilePath& path,
+      const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread);
+  ~V2CacheReader();
+
+  // Returns true if |path| contains the index of a cache that uses the previous
+  // version of the format.
+  static bool IsV2Cache(const base::FilePath& path);
+
+  // Opens the cache (without modifying the rankings). Returns false on failure.
+  bool Init(net::CacheType type);
+
+  // Reads the next entry of the cache into |data|. Returns false when there
+  // are no more entries. Entries that cannot be read are skipped.
+  bool ReadNextEntry(EntryData* data);
+
+ private:
+  struct Enumeration;
+
+  base::FilePath path_;
+  scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
+  scoped_ptr<BackendImpl> backend_;
+  scoped_ptr<Enumeration> enumeration_;
+
+  DISALLOW_COPY_AND_ASSIGN(V2CacheReader);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_BLOCKFILE_V2_CACHE_READER_H_
@@ -10,11 +10,17 @@
 #include "net/base/cache_type.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 
+#if defined(USE_TRACING_CACHE_BACKEND)
+#include "net/disk_cache/tracing/cache_trace.h"
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
+#endif
+
 namespace {
 
 // Builds an instance of the backend depending on platform, type, experiments
@@ -107,6 +113,19 @@ int CacheCreator::Run() {
 #if defined(OS_ANDROID)
   return net::ERR_FAILED;
 #else
+  if (backend_type_ == net::CACHE_BACKEND_BLOCKFILE_V3) {
+    disk_cache::BackendImplV3* new_cache =
+        new disk_cache::BackendImplV3(path_, thread_, net_log_);
+    created_cache_.reset(new_cache);
+    new_cache->SetMaxSize(max_bytes_);
+    new_cache->SetType(type_);
+    new_cache->SetFlags(flags_);
+    int rv = new_cache->Init(
+        base::Bind(&CacheCreator::OnIOComplete, base::Unretained(this)));
+    DCHECK_EQ(net::ERR_IO_PENDING, rv);
+    return rv;
+  }
+
   disk_cache::BackendImpl* new_cache =
       new disk_cache::BackendImpl(path_, thread_, net_log_);
   created_cache_.reset(new_cache);
@@ -126,8 +145,11 @@ void CacheCreator::DoCallback(int result) {
 #ifndef USE_TRACING_CACHE_BACKEND
     *backend_ = created_cache_.Pass();
 #else
-    *backend_.reset(
-        new disk_cache::TracingCacheBackend(created_cache_.Pass()));
+    // The trace goes next to the cache directory, which the cache owns.
+    backend_->reset(new disk_cache::TracingCacheBackend(
+        created_cache_.Pass(),
+        new disk_cache::CacheTraceWriter(
+            path_.AddExtension(FILE_PATH_LITERAL("trace")), thread_)));
 #endif
   } else {
     LOG(ERROR) << "Unable to create cache";
@@ -4,6 +4,8 @@
 
 #include "net/disk_cache/disk_cache_test_base.h"
 
+#include "base/bind.h"
+#include "base/bind_helpers.h"
 #include "base/files/file_util.h"
 #include "base/path_service.h"
 #include "base/run_loop.h"
@@ -14,10 +16,12 @@
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
+#include "net/disk_cache/blockfile/backend_impl_v3.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/memory/sharded_mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_index.h"
 
@@ -68,14 +72,21 @@ int DiskCacheTestWithCache::TestIterator::OpenNextEntry(
 
 DiskCacheTestWithCache::DiskCacheTestWithCache()
     : cache_impl_(NULL),
+      cache_impl_v3_(NULL),
       simple_cache_impl_(NULL),
       mem_cache_(NULL),
+      sharded_mem_cache_(NULL),
       mask_(0),
       size_(0),
       type_(net::DISK_CACHE),
       memory_only_(false),
+      sharded_memory_(false),
       simple_cache_mode_(false),
+      blockfile_v3_mode_(false),
       simple_cache_wait_for_index_(true),
+      simple_cache_use_io_ring_(false),
+      simple_cache_slab_entry_threshold_(0),
+      simple_cache_compression_codec_(disk_cache::SIMPLE_COMPRESSION_NONE),
       force_creation_(false),
       new_eviction_(false),
       first_cleanup_(true),
@@ -113,6 +124,10 @@ void DiskCacheTestWithCache::SimulateCrash() {
 
 void DiskCacheTestWithCache::SetTestMode() {
   ASSERT_TRUE(!memory_only_);
+  if (cache_impl_v3_) {
+    cache_impl_v3_->SetUnitTestMode();
+    return;
+  }
   cache_impl_->SetUnitTestMode();
 }
 
@@ -124,8 +139,14 @@ void DiskCacheTestWithCache::SetMaxSize(int size) {
   if (cache_impl_)
     EXPECT_TRUE(cache_impl_->SetMaxSize(size));
 
+  if (cache_impl_v3_)
+    EXPECT_TRUE(cache_impl_v3_->SetMaxSize(size));
+
   if (mem_cache_)
     EXPECT_TRUE(mem_cache_->SetMaxSize(size));
+
+  if (sharded_mem_cache_)
+    EXPECT_TRUE(sharded_mem_cache_->SetMaxSize(size));
 }
 
 int DiskCacheTestWithCache::OpenEntry(const std::string& key,
@@ -173,22 +194,36 @@ scoped_ptr<DiskCacheTestWithCache::TestIterator>
 }
 
 void DiskCacheTestWithCache::FlushQueueForTest() {
-  if (memory_only_ || !cache_impl_)
+  if (memory_only_ || (!cache_impl_ && !cache_impl_v3_))
     return;
 
   net::TestCompletionCallback cb;
-  int rv = cache_impl_->FlushQueueForTest(cb.callback());
+  int rv = cache_impl_v3_ ? cache_impl_v3_->FlushQueueForTest(cb.callback()) :
+                            cache_impl_->FlushQueueForTest(cb.callback());
   EXPECT_EQ(net::OK, cb.GetResult(rv));
 }
 
+void DiskCacheTestWithCache::FlushCacheThreadForTest() {
+  if (!cache_thread_.IsRunning())
+    return;
+
+  net::TestCompletionCallback cb;
+  cache_thread_.task_runner()->PostTaskAndReply(
+      FROM_HERE, base::Bind(&base::DoNothing),
+      base::Bind(cb.callback(), net::OK));
+  EXPECT_EQ(net::OK, cb.WaitForResult());
+}
+
 void DiskCacheTestWithCache::RunTaskForTest(const base::Closure& closure) {
-  if (memory_only_ || !cache_impl_) {
+  if (memory_only_ || (!cache_impl_ && !cache_impl_v3_)) {
     closure.Run();
     return;
   }
 
   net::TestCompletionCallback cb;
-  int rv = cache_impl_->RunTaskForTest(closure, cb.callback());
+  int rv = cache_impl_v3_ ?
+      cache_impl_v3_->RunTaskForTest(closure, cb.callback()) :
+      cache_impl_->RunTaskForTest(closure, cb.callback());
   EXPECT_EQ(net::OK, cb.GetResult(rv));
 }
 
@@ -224,6 +259,12 @@ int DiskCacheTestWithCache::WriteSparseData(disk_cache::Entry* entry,
 }
 
 void DiskCacheTestWithCache::TrimForTest(bool empty) {
+  if (cache_impl_v3_) {
+    RunTaskForTest(base::Bind(&disk_cache::BackendImplV3::TrimForTest,
+                              base::Unretained(cache_impl_v3_),
+                              empty));
+    return;
+  }
   RunTaskForTest(base::Bind(&disk_cache::BackendImpl::TrimForTest,
                             base::Unretained(cache_impl_),
                             empty));
@@ -261,7 +302,9 @@ void DiskCacheTestWithCache::TearDown() {
   if (cache_thread_.IsRunning())
     cache_thread_.Stop();
 
-  if (!memory_only_ && !simple_cache_mode_ && integrity_) {
+  // The integrity check only understands the previous blockfile format.
+  if (!memory_only_ && !simple_cache_mode_ && !blockfile_v3_mode_ &&
+      integrity_) {
     EXPECT_TRUE(CheckCacheIntegrity(cache_path_, new_eviction_, mask_));
   }
   base::RunLoop().RunUntilIdle();
@@ -270,6 +313,18 @@ void DiskCacheTestWithCache::TearDown() {
 }
 
 void DiskCacheTestWithCache::InitMemoryCache() {
+  if (sharded_memory_) {
+    sharded_mem_cache_ = new disk_cache::ShardedMemBackendImpl(NULL);
+    cache_.reset(sharded_mem_cache_);
+    ASSERT_TRUE(cache_);
+
+    if (size_)
+      EXPECT_TRUE(sharded_mem_cache_->SetMaxSize(size_));
+
+    ASSERT_TRUE(sharded_mem_cache_->Init());
+    return;
+  }
+
   mem_cache_ = new disk_cache::MemBackendImpl(NULL);
   cache_.reset(mem_cache_);
   ASSERT_TRUE(cache_);
@@ -305,6 +360,10 @@ void DiskCacheTestWithCache::CreateBackend(uint32 flags, base::Thread* thread) {
     scoped_ptr<disk_cache::SimpleBackendImpl> simple_backend(
         new disk_cache::SimpleBackendImpl(
             cache_path_, size_, type_, runner, NULL));
+    simple_backend->set_use_io_ring(simple_cache_use_io_ring_);
+    simple_backend->set_slab_entry_threshold(
+        simple_cache_slab_entry_threshold_);
+    simple_backend->set_compression_codec(simple_cache_compression_codec_);
     int rv = simple_backend->Init(cb.callback());
     ASSERT_EQ(net::OK, cb.GetResult(rv));
     simple_cache_impl_ = simple_backend.get();
@@ -318,6 +377,22 @@ void DiskCacheTestWithCache::CreateBackend(uint32 flags, base::Thread* thread) {
     return;
   }
 
+  if (blockfile_v3_mode_) {
+    cache_impl_v3_ = new disk_cache::BackendImplV3(cache_path_, runner, NULL);
+    cache_.reset(cache_impl_v3_);
+    ASSERT_TRUE(cache_);
+    if (size_)
+      EXPECT_TRUE(cache_impl_v3_->SetMaxSize(size_));
+    if (new_eviction_)
+      cache_impl_v3_->SetNewEviction();
+    cache_impl_v3_->SetType(type_);
+    cache_impl_v3_->SetFlags(flags);
+    net::TestCompletionCallback cb;
+    int rv = cache_impl_v3_->Init(cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    return;
+  }
+
   if (mask_)
     cache_impl_ = new disk_cache::BackendImpl(cache_path_, mask_, runner, NULL);
   else
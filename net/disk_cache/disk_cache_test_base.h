@@ -12,6 +12,7 @@
 #include "base/threading/thread.h"
 #include "net/base/cache_type.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_compression.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -25,8 +26,10 @@ namespace disk_cache {
 
 class Backend;
 class BackendImpl;
+class BackendImplV3;
 class Entry;
 class MemBackendImpl;
+class ShardedMemBackendImpl;
 class SimpleBackendImpl;
 
 }  // namespace disk_cache
@@ -82,10 +85,37 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     memory_only_ = true;
   }
 
+  // Makes the memory only cache use ShardedMemBackendImpl.
+  void SetShardedMemoryMode() {
+    sharded_memory_ = true;
+  }
+
   void SetSimpleCacheMode() {
     simple_cache_mode_ = true;
   }
 
+  // Makes the disk cache use the version 3 of the blockfile backend.
+  void SetBlockfileV3Mode() {
+    blockfile_v3_mode_ = true;
+  }
+
+  // Makes the simple cache do its stream IO through an io_uring, if the
+  // kernel has it.
+  void SetSimpleCacheIORing() {
+    simple_cache_use_io_ring_ = true;
+  }
+
+  // Makes the simple cache keep entries of up to |entry_threshold| bytes in
+  // slab files.
+  void SetSimpleCacheSlabs(int entry_threshold) {
+    simple_cache_slab_entry_threshold_ = entry_threshold;
+  }
+
+  // Makes the simple cache compress stream 1 of entries with |codec|.
+  void SetSimpleCacheCompression(disk_cache::SimpleCompressionCodec codec) {
+    simple_cache_compression_codec_ = codec;
+  }
+
   void SetMask(uint32 mask) {
     mask_ = mask;
   }
@@ -131,6 +161,8 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   int DoomEntriesSince(const base::Time initial_time);
   scoped_ptr<TestIterator> CreateIterator();
   void FlushQueueForTest();
+  // Waits for the tasks that are already posted to the cache thread to run.
+  void FlushCacheThreadForTest();
   void RunTaskForTest(const base::Closure& closure);
   int ReadData(disk_cache::Entry* entry, int index, int offset,
                net::IOBuffer* buf, int len);
@@ -160,15 +192,22 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   // initialized. The implementation pointers can be NULL.
   scoped_ptr<disk_cache::Backend> cache_;
   disk_cache::BackendImpl* cache_impl_;
+  disk_cache::BackendImplV3* cache_impl_v3_;
   disk_cache::SimpleBackendImpl* simple_cache_impl_;
   disk_cache::MemBackendImpl* mem_cache_;
+  disk_cache::ShardedMemBackendImpl* sharded_mem_cache_;
 
   uint32 mask_;
   int size_;
   net::CacheType type_;
   bool memory_only_;
+  bool sharded_memory_;
   bool simple_cache_mode_;
+  bool blockfile_v3_mode_;
   bool simple_cache_wait_for_index_;
+  bool simple_cache_use_io_ring_;
+  int simple_cache_slab_entry_threshold_;
+  disk_cache::SimpleCompressionCodec simple_cache_compression_codec_;
   bool force_creation_;
   bool new_eviction_;
   bool first_cleanup_;
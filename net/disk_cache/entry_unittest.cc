@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
+#include "base/run_loop.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/threading/platform_thread.h"
@@ -19,8 +22,10 @@
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/memory/mem_entry_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_test_util.h"
 #include "net/disk_cache/simple/simple_util.h"
@@ -65,6 +70,9 @@ class DiskCacheEntryTest : public DiskCacheTestWithCache {
   void PartialSparseEntry();
   bool SimpleCacheMakeBadChecksumEntry(const std::string& key, int* data_size);
   bool SimpleCacheThirdStreamFileExists(const char* key);
+  bool SimpleCacheEntryFileExists(const char* key);
+  int64 SimpleCacheEntryFileSize(const char* key);
+  void SimpleCacheReopen(bool delete_index);
   void SyncDoomEntry(const char* key);
 };
 
@@ -364,6 +372,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyInternalAsyncIO) {
   InternalAsyncIO();
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3InternalAsyncIO) {
+  SetBlockfileV3Mode();
+  InitCache();
+  InternalAsyncIO();
+}
+
 // This part of the test runs on the background thread.
 void DiskCacheEntryTest::ExternalSyncIOBackground(disk_cache::Entry* entry) {
   const int kSize1 = 17000;
@@ -450,6 +464,13 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyExternalSyncIO) {
   ExternalSyncIO();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyExternalSyncIO) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  ExternalSyncIO();
+}
+
 void DiskCacheEntryTest::ExternalAsyncIO() {
   disk_cache::Entry* entry;
   ASSERT_EQ(net::OK, CreateEntry("the first key", &entry));
@@ -610,6 +631,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyExternalAsyncIO) {
   ExternalAsyncIO();
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3ExternalAsyncIO) {
+  SetBlockfileV3Mode();
+  InitCache();
+  ExternalAsyncIO();
+}
+
 // Tests that IOBuffers are not referenced after IO completes.
 void DiskCacheEntryTest::ReleaseBuffer(int stream_index) {
   disk_cache::Entry* entry = NULL;
@@ -705,6 +732,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyStreamAccess) {
   StreamAccess();
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3StreamAccess) {
+  SetBlockfileV3Mode();
+  InitCache();
+  StreamAccess();
+}
+
 void DiskCacheEntryTest::GetKey() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -759,6 +792,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGetKey) {
   GetKey();
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3GetKey) {
+  SetBlockfileV3Mode();
+  InitCache();
+  GetKey();
+}
+
 void DiskCacheEntryTest::GetTimes(int stream_index) {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -821,6 +860,12 @@ TEST_F(DiskCacheEntryTest, ShaderCacheGetTimes) {
   GetTimes(0);
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3GetTimes) {
+  SetBlockfileV3Mode();
+  InitCache();
+  GetTimes(0);
+}
+
 void DiskCacheEntryTest::GrowData(int stream_index) {
   std::string key1("the first key");
   disk_cache::Entry* entry;
@@ -908,6 +953,19 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGrowData) {
   GrowData(0);
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyGrowData) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  GrowData(0);
+}
+
+TEST_F(DiskCacheEntryTest, BlockfileV3GrowData) {
+  SetBlockfileV3Mode();
+  InitCache();
+  GrowData(0);
+}
+
 void DiskCacheEntryTest::TruncateData(int stream_index) {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -990,6 +1048,19 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyTruncateData) {
   TruncateData(0);
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyTruncateData) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  TruncateData(0);
+}
+
+TEST_F(DiskCacheEntryTest, BlockfileV3TruncateData) {
+  SetBlockfileV3Mode();
+  InitCache();
+  TruncateData(0);
+}
+
 void DiskCacheEntryTest::ZeroLengthIO(int stream_index) {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -1045,6 +1116,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyZeroLengthIO) {
   ZeroLengthIO(0);
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3ZeroLengthIO) {
+  SetBlockfileV3Mode();
+  InitCache();
+  ZeroLengthIO(0);
+}
+
 // Tests that we handle the content correctly when buffering, a feature of the
 // standard cache that permits fast responses to certain reads.
 void DiskCacheEntryTest::Buffering() {
@@ -1264,6 +1341,12 @@ TEST_F(DiskCacheEntryTest, SizeChangesNoBuffer) {
   SizeChanges(1);
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3SizeChanges) {
+  SetBlockfileV3Mode();
+  InitCache();
+  SizeChanges(1);
+}
+
 // Write more than the total cache capacity but to a single entry. |size| is the
 // amount of bytes to write each time.
 void DiskCacheEntryTest::ReuseEntry(int size, int stream_index) {
@@ -1304,6 +1387,13 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyReuseExternalEntry) {
   ReuseEntry(20 * 1024, 0);
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3ReuseExternalEntry) {
+  SetBlockfileV3Mode();
+  SetMaxSize(200 * 1024);
+  InitCache();
+  ReuseEntry(20 * 1024, 0);
+}
+
 TEST_F(DiskCacheEntryTest, ReuseInternalEntry) {
   SetMaxSize(100 * 1024);
   InitCache();
@@ -1477,6 +1567,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomEntry) {
   DoomNormalEntry();
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3DoomEntry) {
+  SetBlockfileV3Mode();
+  InitCache();
+  DoomNormalEntry();
+}
+
 // Tests dooming an entry that's linked to an open entry.
 void DiskCacheEntryTest::DoomEntryNextToOpenEntry() {
   disk_cache::Entry* entry1;
@@ -1560,6 +1656,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomedEntry) {
   DoomedEntry(0);
 }
 
+TEST_F(DiskCacheEntryTest, BlockfileV3DoomedEntry) {
+  SetBlockfileV3Mode();
+  InitCache();
+  DoomedEntry(0);
+}
+
 // Tests that we discard entries if the data is missing.
 TEST_F(DiskCacheEntryTest, MissingData) {
   InitCache();
@@ -1702,6 +1804,19 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyBasicSparseIO) {
   BasicSparseIO();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyBasicSparseIO) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  BasicSparseIO();
+}
+
+TEST_F(DiskCacheEntryTest, BlockfileV3BasicSparseIO) {
+  SetBlockfileV3Mode();
+  InitCache();
+  BasicSparseIO();
+}
+
 void DiskCacheEntryTest::HugeSparseIO() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -1734,6 +1849,13 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyHugeSparseIO) {
   HugeSparseIO();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyHugeSparseIO) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  HugeSparseIO();
+}
+
 void DiskCacheEntryTest::GetAvailableRange() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -1799,6 +1921,19 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGetAvailableRange) {
   GetAvailableRange();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyGetAvailableRange) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  GetAvailableRange();
+}
+
+TEST_F(DiskCacheEntryTest, BlockfileV3GetAvailableRange) {
+  SetBlockfileV3Mode();
+  InitCache();
+  GetAvailableRange();
+}
+
 // Tests that non-sequential writes that are not aligned with the minimum sparse
 // data granularity (1024 bytes) do in fact result in dropped data.
 TEST_F(DiskCacheEntryTest, SparseWriteDropped) {
@@ -2091,6 +2226,14 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyUpdateSparseEntry) {
   UpdateSparseEntry();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyUpdateSparseEntry) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  SetCacheType(net::MEDIA_CACHE);
+  InitCache();
+  UpdateSparseEntry();
+}
+
 void DiskCacheEntryTest::DoomSparseEntry() {
   std::string key1("the first key");
   std::string key2("the second key");
@@ -2157,6 +2300,20 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomSparseEntry) {
   DoomSparseEntry();
 }
 
+TEST_F(DiskCacheEntryTest, ShardedMemoryOnlyDoomSparseEntry) {
+  SetMemoryOnlyMode();
+  SetShardedMemoryMode();
+  InitCache();
+  DoomSparseEntry();
+}
+
+TEST_F(DiskCacheEntryTest, BlockfileV3DoomSparseEntry) {
+  SetBlockfileV3Mode();
+  UseCurrentThread();
+  InitCache();
+  DoomSparseEntry();
+}
+
 // A CompletionCallback wrapper that deletes the cache from within the callback.
 // The way a CompletionCallback works means that all tasks (even new ones)
 // are executed by the message loop before returning to the caller so the only
@@ -2548,6 +2705,415 @@ TEST_F(DiskCacheEntryTest, SimpleCacheSizeChanges) {
   }
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheIORingExternalAsyncIO) {
+  SetSimpleCacheMode();
+  SetSimpleCacheIORing();
+  InitCache();
+  ExternalAsyncIO();
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheIORingGrowAndTruncateData) {
+  SetSimpleCacheMode();
+  SetSimpleCacheIORing();
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    GrowData(i);
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    TruncateData(i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheIORingSizeChanges) {
+  SetSimpleCacheMode();
+  SetSimpleCacheIORing();
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    SizeChanges(i);
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    ZeroLengthIO(i);
+  }
+}
+
+bool DiskCacheEntryTest::SimpleCacheEntryFileExists(const char* key) {
+  return PathExists(cache_path_.AppendASCII(
+      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0)));
+}
+
+int64 DiskCacheEntryTest::SimpleCacheEntryFileSize(const char* key) {
+  int64 file_size = -1;
+  EXPECT_TRUE(base::GetFileSize(
+      cache_path_.AppendASCII(
+          disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0)),
+      &file_size));
+  return file_size;
+}
+
+// Waits for the closed entries to reach the disk, then destroys and creates
+// the backend again, which restores the index from the entries if
+// |delete_index|.
+void DiskCacheEntryTest::SimpleCacheReopen(bool delete_index) {
+  // An optimistic write can still be running, with the close queued after it.
+  for (int i = 0; i < 2; ++i) {
+    disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::RunLoop().RunUntilIdle();
+  }
+  cache_.reset();
+  // The index is written on the cache thread.
+  FlushCacheThreadForTest();
+  if (delete_index) {
+    ASSERT_TRUE(base::DeleteFile(cache_path_.AppendASCII("index-dir"), true));
+  }
+  DisableFirstCleanup();
+  InitCache();
+}
+
+// Small entries are kept in slabs, and survive the backend going away, with
+// or without the index.
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabs) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(4096);
+  InitCache();
+
+  const char key[] = "the first key";
+  const int kSize = 200;
+  scoped_refptr<net::IOBuffer> buffer0(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer0->data(), kSize, false);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer0.get(), kSize, false));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer1.get(), kSize, false));
+  entry->Close();
+  // The operations of an entry run in order, so once it opens again, it has
+  // been written to its slab.
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  entry->Close();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(SimpleCacheEntryFileExists(key));
+  EXPECT_TRUE(base::DirectoryExists(
+      cache_path_.AppendASCII(disk_cache::SimpleSlabStore::kSlabDirectory)));
+
+  for (int i = 0; i < 3; ++i) {
+    if (i == 1)
+      SimpleCacheReopen(false);
+    if (i == 2)
+      SimpleCacheReopen(true);
+    ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+    scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize));
+    EXPECT_EQ(kSize, entry->GetDataSize(1));
+    EXPECT_EQ(kSize, ReadData(entry, 0, 0, read_buffer.get(), kSize));
+    EXPECT_EQ(0, memcmp(buffer0->data(), read_buffer->data(), kSize));
+    EXPECT_EQ(kSize, ReadData(entry, 1, 0, read_buffer.get(), kSize));
+    EXPECT_EQ(0, memcmp(buffer1->data(), read_buffer->data(), kSize));
+    entry->Close();
+  }
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  EXPECT_FALSE(SimpleCacheEntryFileExists(key));
+}
+
+// An entry that grows past the threshold moves to its own files.
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabsSpill) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(4096);
+  InitCache();
+
+  const char kSmallKey[] = "small";
+  const char kLargeKey[] = "large";
+  const int kSize = 8192;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(kLargeKey, &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+
+  ASSERT_EQ(net::OK, CreateEntry(kSmallKey, &entry));
+  EXPECT_EQ(100, WriteData(entry, 1, 0, buffer.get(), 100, false));
+  entry->Close();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(SimpleCacheEntryFileExists(kLargeKey));
+  EXPECT_FALSE(SimpleCacheEntryFileExists(kSmallKey));
+
+  ASSERT_EQ(net::OK, OpenEntry(kSmallKey, &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(SimpleCacheEntryFileExists(kSmallKey));
+
+  SimpleCacheReopen(false);
+  const char* const kKeys[] = {kSmallKey, kLargeKey};
+  for (size_t i = 0; i < arraysize(kKeys); ++i) {
+    ASSERT_EQ(net::OK, OpenEntry(kKeys[i], &entry));
+    scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize));
+    EXPECT_EQ(kSize, ReadData(entry, 1, 0, read_buffer.get(), kSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), kSize));
+    entry->Close();
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabsDoom) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(4096);
+  InitCache();
+
+  const char key[] = "the first key";
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  entry->Close();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(net::OK, DoomEntry(key));
+
+  SimpleCacheReopen(false);
+  EXPECT_NE(net::OK, OpenEntry(key, &entry));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+
+  // The killed record is not brought back by restoring the index.
+  SimpleCacheReopen(true);
+  EXPECT_NE(net::OK, OpenEntry(key, &entry));
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabsGrowAndTruncateData) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(16 * 1024);
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    GrowData(i);
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    TruncateData(i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabsSizeChanges) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(16 * 1024);
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    SizeChanges(i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheSlabsBasicSparseIO) {
+  SetSimpleCacheMode();
+  SetSimpleCacheSlabs(16 * 1024);
+  InitCache();
+  BasicSparseIO();
+}
+
+namespace {
+
+// Fills |buffer| with text that compresses about as well as a response body.
+void FillCompressibleBuffer(char* buffer, int len) {
+  std::string text;
+  for (int i = 0; static_cast<int>(text.size()) < len; ++i) {
+    text += base::StringPrintf(
+        "{\"id\": %d, \"name\": \"item %d\", \"price\": %d.%02d},\n", i,
+        (i * 7919) % 1000, (i * 31) % 500, i % 100);
+  }
+  memcpy(buffer, text.data(), len);
+}
+
+// Checks that stream 1 of |entry| holds the |size| bytes of |expected|, read
+// whole and in pieces that start and end within blocks.
+void CheckStream1Data(disk_cache::Entry* entry,
+                      const char* expected,
+                      int size) {
+  ASSERT_EQ(size, entry->GetDataSize(1));
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(size));
+  net::TestCompletionCallback cb;
+  int rv = entry->ReadData(1, 0, read_buffer.get(), size, cb.callback());
+  EXPECT_EQ(size, cb.GetResult(rv));
+  EXPECT_EQ(0, memcmp(expected, read_buffer->data(), size));
+
+  const int kPieceSize = 5000;
+  for (int offset = 17; offset < size; offset += 3 * kPieceSize) {
+    const int expected_read = std::min(kPieceSize, size - offset);
+    rv = entry->ReadData(1, offset, read_buffer.get(), kPieceSize,
+                         cb.callback());
+    EXPECT_EQ(expected_read, cb.GetResult(rv));
+    EXPECT_EQ(0, memcmp(expected + offset, read_buffer->data(), expected_read));
+  }
+  rv = entry->ReadData(1, size, read_buffer.get(), kPieceSize, cb.callback());
+  EXPECT_EQ(0, cb.GetResult(rv));
+}
+
+}  // namespace
+
+// Stream 1 is compressed when the entry is closed, and reads the same after,
+// with or without the index.
+TEST_F(DiskCacheEntryTest, SimpleCacheCompression) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+
+  const char key[] = "the first key";
+  const int kSize0 = 200;
+  const int kSize1 = 100 * 1024 + 123;
+  scoped_refptr<net::IOBuffer> buffer0(new net::IOBuffer(kSize0));
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize1));
+  CacheTestFillBuffer(buffer0->data(), kSize0, false);
+  FillCompressibleBuffer(buffer1->data(), kSize1);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  EXPECT_EQ(kSize0, WriteData(entry, 0, 0, buffer0.get(), kSize0, false));
+  EXPECT_EQ(kSize1, WriteData(entry, 1, 0, buffer1.get(), kSize1, false));
+  entry->Close();
+  SimpleCacheReopen(false);
+  EXPECT_GT(kSize1 / 2, SimpleCacheEntryFileSize(key));
+
+  for (int i = 0; i < 2; ++i) {
+    if (i == 1)
+      SimpleCacheReopen(true);
+    ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+    scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize0));
+    EXPECT_EQ(kSize0, ReadData(entry, 0, 0, read_buffer.get(), kSize0));
+    EXPECT_EQ(0, memcmp(buffer0->data(), read_buffer->data(), kSize0));
+    CheckStream1Data(entry, buffer1->data(), kSize1);
+    entry->Close();
+  }
+}
+
+// Data that does not compress is left as it is.
+TEST_F(DiskCacheEntryTest, SimpleCacheCompressionIncompressible) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+
+  const char key[] = "the first key";
+  const int kSize = 64 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+  SimpleCacheReopen(false);
+  EXPECT_LT(kSize, SimpleCacheEntryFileSize(key));
+
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  CheckStream1Data(entry, buffer->data(), kSize);
+  entry->Close();
+}
+
+// Writing to a compressed stream 1, with and without truncating it, keeps the
+// data around the write.
+TEST_F(DiskCacheEntryTest, SimpleCacheCompressionWrite) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+
+  const char key[] = "the first key";
+  const int kSize = 80 * 1024;
+  const int kWriteSize = 3000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> write_buffer(new net::IOBuffer(kWriteSize));
+  FillCompressibleBuffer(buffer->data(), kSize);
+  CacheTestFillBuffer(write_buffer->data(), kWriteSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+  SimpleCacheReopen(false);
+
+  // Across the end of the second block.
+  const int kOffset = 2 * disk_cache::kSimpleCompressionBlockSize - 1000;
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  EXPECT_EQ(kWriteSize,
+            WriteData(entry, 1, kOffset, write_buffer.get(), kWriteSize,
+                      false));
+  memcpy(buffer->data() + kOffset, write_buffer->data(), kWriteSize);
+  CheckStream1Data(entry, buffer->data(), kSize);
+  entry->Close();
+  SimpleCacheReopen(false);
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  CheckStream1Data(entry, buffer->data(), kSize);
+
+  const int kTruncateOffset = 40 * 1024 + 17;
+  EXPECT_EQ(kWriteSize, WriteData(entry, 1, kTruncateOffset,
+                                  write_buffer.get(), kWriteSize, true));
+  memcpy(buffer->data() + kTruncateOffset, write_buffer->data(), kWriteSize);
+  const int kTruncatedSize = kTruncateOffset + kWriteSize;
+  CheckStream1Data(entry, buffer->data(), kTruncatedSize);
+  entry->Close();
+  SimpleCacheReopen(true);
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  CheckStream1Data(entry, buffer->data(), kTruncatedSize);
+  entry->Close();
+}
+
+// Writing only to stream 0 of an entry keeps its compressed stream 1.
+TEST_F(DiskCacheEntryTest, SimpleCacheCompressionStream0Write) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+
+  const char key[] = "the first key";
+  const int kSize0 = 300;
+  const int kSize1 = 50 * 1024;
+  scoped_refptr<net::IOBuffer> buffer0(new net::IOBuffer(kSize0));
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize1));
+  CacheTestFillBuffer(buffer0->data(), kSize0, false);
+  FillCompressibleBuffer(buffer1->data(), kSize1);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+  EXPECT_EQ(100, WriteData(entry, 0, 0, buffer0.get(), 100, false));
+  EXPECT_EQ(kSize1, WriteData(entry, 1, 0, buffer1.get(), kSize1, false));
+  entry->Close();
+  SimpleCacheReopen(false);
+  const int64 compressed_file_size = SimpleCacheEntryFileSize(key);
+  EXPECT_GT(kSize1 / 2, compressed_file_size);
+
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  EXPECT_EQ(kSize0, WriteData(entry, 0, 0, buffer0.get(), kSize0, true));
+  entry->Close();
+  SimpleCacheReopen(false);
+  EXPECT_EQ(compressed_file_size + kSize0 - 100,
+            SimpleCacheEntryFileSize(key));
+
+  ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize0));
+  EXPECT_EQ(kSize0, ReadData(entry, 0, 0, read_buffer.get(), kSize0));
+  EXPECT_EQ(0, memcmp(buffer0->data(), read_buffer->data(), kSize0));
+  CheckStream1Data(entry, buffer1->data(), kSize1);
+  entry->Close();
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheCompressionGrowAndTruncateData) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    GrowData(i);
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    TruncateData(i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCacheCompressionSizeChanges) {
+  SetSimpleCacheMode();
+  SetSimpleCacheCompression(disk_cache::SIMPLE_COMPRESSION_DEFLATE);
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    SizeChanges(i);
+  }
+}
+
 TEST_F(DiskCacheEntryTest, SimpleCacheInvalidData) {
   SetSimpleCacheMode();
   InitCache();
@@ -4,10 +4,15 @@
 
 #include "net/disk_cache/memory/mem_backend_impl.h"
 
+#include "base/bind.h"
+#include "base/location.h"
 #include "base/logging.h"
+#include "base/sequenced_task_runner.h"
 #include "base/sys_info.h"
+#include "base/task_runner_util.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/memory/mem_backend_snapshot.h"
 #include "net/disk_cache/memory/mem_entry_impl.h"
 
 using base::Time;
@@ -24,15 +29,33 @@ int LowWaterAdjust(int high_water) {
   return high_water - kCleanUpMargin;
 }
 
+// Runs on the task runner of the snapshots.
+int WriteSnapshot(scoped_ptr<disk_cache::MemBackendSnapshot> snapshot,
+                  const base::FilePath& path) {
+  return snapshot->WriteToFile(path) ? net::OK : net::ERR_FAILED;
+}
+
+void RunCallback(const net::CompletionCallback& callback, int result) {
+  if (!callback.is_null())
+    callback.Run(result);
+}
+
 }  // namespace
 
 namespace disk_cache {
 
 MemBackendImpl::MemBackendImpl(net::NetLog* net_log)
-    : max_size_(0), current_size_(0), net_log_(net_log), weak_factory_(this) {
+    : max_size_(0),
+      current_size_(0),
+      net_log_(net_log),
+      snapshot_max_bytes_(0),
+      snapshot_loaded_(false),
+      weak_factory_(this) {
 }
 
 MemBackendImpl::~MemBackendImpl() {
+  SaveEnabledSnapshot();
+
   EntryMap::iterator it = entries_.begin();
   while (it != entries_.end()) {
     it->second->Doom();
@@ -126,6 +149,67 @@ void MemBackendImpl::RemoveFromRankingList(MemEntryImpl* entry) {
   rankings_.Remove(entry);
 }
 
+void MemBackendImpl::SaveSnapshot(
+    const base::FilePath& path,
+    int max_bytes,
+    const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+    const CompletionCallback& callback) {
+  // The entries are copied here, and only the file is written on the task
+  // runner. The ones that do not fit are skipped, so that a large entry does
+  // not keep the ones after it out of the snapshot.
+  scoped_ptr<MemBackendSnapshot> snapshot(new MemBackendSnapshot(max_bytes));
+  for (MemEntryImpl* node = rankings_.GetNext(NULL); node;
+       node = rankings_.GetNext(node)) {
+    if (node->type() != MemEntryImpl::kParentEntry || node->CouldBeSparse())
+      continue;
+
+    const char* data[MemSnapshotEntry::kNumStreams];
+    int32 data_sizes[MemSnapshotEntry::kNumStreams];
+    for (int i = 0; i < MemSnapshotEntry::kNumStreams; i++) {
+      data[i] = node->PeekData(i);
+      data_sizes[i] = node->GetDataSize(i);
+    }
+    snapshot->AddEntry(node->GetKey(), node->GetLastUsed(),
+                       node->GetLastModified(), data, data_sizes);
+  }
+
+  base::PostTaskAndReplyWithResult(
+      task_runner.get(), FROM_HERE,
+      base::Bind(&WriteSnapshot, base::Passed(&snapshot), path),
+      base::Bind(&RunCallback, callback));
+}
+
+void MemBackendImpl::LoadSnapshot(
+    const base::FilePath& path,
+    int max_bytes,
+    const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+    const CompletionCallback& callback) {
+  MemSnapshotEntries* entries = new MemSnapshotEntries;
+  base::PostTaskAndReplyWithResult(
+      task_runner.get(), FROM_HERE,
+      base::Bind(&MemBackendSnapshot::ReadFromFile, path, max_bytes, entries),
+      base::Bind(&MemBackendImpl::OnSnapshotLoaded, weak_factory_.GetWeakPtr(),
+                 base::Owned(entries), callback));
+}
+
+void MemBackendImpl::EnableSnapshots(
+    const base::FilePath& path,
+    int max_bytes,
+    const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+    base::TimeDelta interval) {
+  DCHECK(snapshot_path_.empty());
+  snapshot_path_ = path;
+  snapshot_max_bytes_ = max_bytes;
+  snapshot_task_runner_ = task_runner;
+  LoadSnapshot(path, max_bytes, task_runner, CompletionCallback());
+
+  if (interval > base::TimeDelta()) {
+    snapshot_timer_.reset(new base::RepeatingTimer<MemBackendImpl>());
+    snapshot_timer_->Start(FROM_HERE, interval, this,
+                           &MemBackendImpl::SaveEnabledSnapshot);
+  }
+}
+
 net::CacheType MemBackendImpl::GetCacheType() const {
   return net::MEMORY_CACHE;
 }
@@ -343,4 +427,53 @@ void MemBackendImpl::SubstractStorageSize(int32 bytes) {
   DCHECK_GE(current_size_, 0);
 }
 
+void MemBackendImpl::OnSnapshotLoaded(MemSnapshotEntries* entries,
+                                      const CompletionCallback& callback,
+                                      bool result) {
+  snapshot_loaded_ = true;
+  if (!result) {
+    RunCallback(callback, net::ERR_FAILED);
+    return;
+  }
+
+  // The entries come hottest first, and each one goes to the tail of the
+  // rankings, so they keep their order below the entries created since the
+  // cache started. Entries are only added while they fit, so that the
+  // snapshot never evicts anything.
+  int loaded = 0;
+  for (size_t i = 0; i < entries->size(); i++) {
+    const MemSnapshotEntry& snapshot_entry = *(*entries)[i];
+    if (entries_.find(snapshot_entry.key) != entries_.end())
+      continue;
+
+    bool fits = true;
+    int64 size = snapshot_entry.key.size();
+    for (int j = 0; j < MemSnapshotEntry::kNumStreams; j++) {
+      int64 data_size = snapshot_entry.data[j].size();
+      if (data_size > MaxFileSize())
+        fits = false;
+      size += data_size;
+    }
+    if (!fits || current_size_ + size > max_size_)
+      continue;
+
+    MemEntryImpl* cache_entry = new MemEntryImpl(this);
+    cache_entry->CreateEntry(snapshot_entry.key, net_log_);
+    cache_entry->RestoreFromSnapshot(snapshot_entry);
+    rankings_.Append(cache_entry);
+    entries_[snapshot_entry.key] = cache_entry;
+    cache_entry->Close();
+    loaded++;
+  }
+  RunCallback(callback, loaded);
+}
+
+void MemBackendImpl::SaveEnabledSnapshot() {
+  if (snapshot_path_.empty() || !snapshot_loaded_)
+    return;
+
+  SaveSnapshot(snapshot_path_, snapshot_max_bytes_, snapshot_task_runner_,
+               CompletionCallback());
+}
+
 }  // namespace disk_cache
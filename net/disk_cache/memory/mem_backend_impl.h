@@ -9,10 +9,19 @@
 
 #include "base/compiler_specific.h"
 #include "base/containers/hash_tables.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
 #include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_rankings.h"
 
+namespace base {
+class SequencedTaskRunner;
+}  // namespace base
+
 namespace net {
 class NetLog;
 }  // namespace net
@@ -20,6 +29,7 @@ class NetLog;
 namespace disk_cache {
 
 class MemEntryImpl;
+struct MemSnapshotEntry;
 
 // This class implements the Backend interface. An object of this class handles
 // the operations of the cache without writing to disk.
@@ -62,6 +72,37 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   // MemEntryImpl to remove a child entry from the ranking list.
   void RemoveFromRankingList(MemEntryImpl* entry);
 
+  // Saves the entries of the cache that were used most recently to a snapshot
+  // at |path|, in a file of up to |max_bytes|. Sparse entries are not saved.
+  // The file is written on |task_runner|, and then |callback|, if not null, is
+  // invoked with net::OK or net::ERR_FAILED.
+  void SaveSnapshot(
+      const base::FilePath& path,
+      int max_bytes,
+      const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+      const CompletionCallback& callback);
+
+  // Reads the snapshot at |path|, if it is not larger than |max_bytes|, on
+  // |task_runner|, and then adds its entries to the cache as long as they fit.
+  // They rank below the entries that are in the cache already, which are not
+  // replaced. |callback|, if not null, is invoked with the number of entries
+  // that were added, or with net::ERR_FAILED if there is no usable snapshot.
+  void LoadSnapshot(
+      const base::FilePath& path,
+      int max_bytes,
+      const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+      const CompletionCallback& callback);
+
+  // Keeps a snapshot of the cache at |path|, so that the next instance of the
+  // cache does not start cold: loads it now, and saves it every |interval|,
+  // unless it is zero, and when the backend is destroyed. Nothing is saved
+  // until the snapshot has been loaded.
+  void EnableSnapshots(
+      const base::FilePath& path,
+      int max_bytes,
+      const scoped_refptr<base::SequencedTaskRunner>& task_runner,
+      base::TimeDelta interval);
+
   // Backend interface.
   net::CacheType GetCacheType() const override;
   int32 GetEntryCount() const override;
@@ -108,6 +149,14 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   void AddStorageSize(int32 bytes);
   void SubstractStorageSize(int32 bytes);
 
+  // Adds the |entries| read from a snapshot to the cache.
+  void OnSnapshotLoaded(ScopedVector<MemSnapshotEntry>* entries,
+                        const CompletionCallback& callback,
+                        bool result);
+
+  // Saves the snapshot set up by EnableSnapshots(), once it has been loaded.
+  void SaveEnabledSnapshot();
+
   EntryMap entries_;
   MemRankings rankings_;  // Rankings to be able to trim the cache.
   int32 max_size_;        // Maximum data size for this instance.
@@ -115,6 +164,13 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
 
   net::NetLog* net_log_;
 
+  // The snapshot set up by EnableSnapshots().
+  base::FilePath snapshot_path_;
+  int snapshot_max_bytes_;
+  scoped_refptr<base::SequencedTaskRunner> snapshot_task_runner_;
+  bool snapshot_loaded_;
+  scoped_ptr<base::RepeatingTimer<MemBackendImpl> > snapshot_timer_;
+
   base::WeakPtrFactory<MemBackendImpl> weak_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(MemBackendImpl);
@@ -0,0 +1,189 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_backend_snapshot.h"
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::FilePath::CharType kTempFileSuffix[] = FILE_PATH_LITERAL(".tmp");
+
+uint32 CalculatePickleCRC(const char* payload, size_t payload_size) {
+  return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(payload),
+               payload_size);
+}
+
+// Reads the fields of an entry that this version knows about, and ignores the
+// rest.
+bool ParseEntry(const char* data, int data_len, MemSnapshotEntry* entry) {
+  Pickle record(data, data_len);
+  if (!record.data() || record.size() != static_cast<size_t>(data_len))
+    return false;
+
+  PickleIterator it(record);
+  int64 last_used;
+  int64 last_modified;
+  uint32 num_streams;
+  if (!it.ReadString(&entry->key) || !it.ReadInt64(&last_used) ||
+      !it.ReadInt64(&last_modified) || !it.ReadUInt32(&num_streams)) {
+    return false;
+  }
+  entry->last_used = base::Time::FromInternalValue(last_used);
+  entry->last_modified = base::Time::FromInternalValue(last_modified);
+
+  for (uint32 i = 0; i < num_streams; i++) {
+    const char* stream_data;
+    int stream_len;
+    if (!it.ReadData(&stream_data, &stream_len))
+      return false;
+    if (i < MemSnapshotEntry::kNumStreams)
+      entry->data[i].assign(stream_data, stream_len);
+  }
+  return true;
+}
+
+}  // namespace
+
+const uint64 MemBackendSnapshot::kMagicNumber = GG_UINT64_C(0x5a3e8b1d04c6f972);
+const uint32 MemBackendSnapshot::kVersion = 1;
+const uint32 MemBackendSnapshot::kOldestReadableVersion = 1;
+
+MemSnapshotEntry::MemSnapshotEntry() {
+}
+
+MemSnapshotEntry::~MemSnapshotEntry() {
+}
+
+MemBackendSnapshot::MemBackendSnapshot(int max_bytes)
+    : max_bytes_(max_bytes), file_(sizeof(PickleHeader)), entry_count_(0) {
+  file_.WriteUInt64(kMagicNumber);
+  file_.WriteUInt32(kVersion);
+  file_.WriteUInt32(kOldestReadableVersion);
+}
+
+MemBackendSnapshot::~MemBackendSnapshot() {
+}
+
+bool MemBackendSnapshot::AddEntry(const std::string& key,
+                                  base::Time last_used,
+                                  base::Time last_modified,
+                                  const char* const* data,
+                                  const int32* data_sizes) {
+  // Check the size first, so that entries that do not fit are not copied.
+  // Every field with a length is padded to a multiple of four bytes.
+  const size_t kPadding = sizeof(uint32) - 1;
+  size_t record_size = sizeof(Pickle::Header) + sizeof(uint32) + key.size() +
+                       kPadding + 2 * sizeof(int64) + sizeof(uint32);
+  for (int i = 0; i < MemSnapshotEntry::kNumStreams; i++)
+    record_size += sizeof(uint32) + data_sizes[i] + kPadding;
+  if (file_.size() + sizeof(uint32) + record_size >
+      static_cast<size_t>(max_bytes_)) {
+    return false;
+  }
+
+  Pickle record;
+  record.WriteString(key);
+  record.WriteInt64(last_used.ToInternalValue());
+  record.WriteInt64(last_modified.ToInternalValue());
+  record.WriteUInt32(MemSnapshotEntry::kNumStreams);
+  for (int i = 0; i < MemSnapshotEntry::kNumStreams; i++)
+    record.WriteData(data[i], data_sizes[i]);
+  DCHECK_LE(record.size(), record_size);
+
+  file_.WriteData(static_cast<const char*>(record.data()),
+                  static_cast<int>(record.size()));
+  entry_count_++;
+  return true;
+}
+
+bool MemBackendSnapshot::WriteToFile(const base::FilePath& path) {
+  const Pickle& pickle = Finish();
+  const base::FilePath temp_path = path.AddExtension(kTempFileSuffix);
+  {
+    base::File file(temp_path,
+                    base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+    if (!file.IsValid())
+      return false;
+
+    int bytes_written = file.Write(
+        0, static_cast<const char*>(pickle.data()), pickle.size());
+    if (bytes_written != static_cast<int>(pickle.size())) {
+      file.Close();
+      base::DeleteFile(temp_path, false);
+      return false;
+    }
+  }
+  if (!base::ReplaceFile(temp_path, path, NULL)) {
+    base::DeleteFile(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
+// static
+bool MemBackendSnapshot::ReadFromFile(const base::FilePath& path,
+                                      int max_bytes,
+                                      MemSnapshotEntries* entries) {
+  std::string contents;
+  if (!base::ReadFileToString(path, &contents, max_bytes))
+    return false;
+
+  return Parse(contents.data(), static_cast<int>(contents.size()), entries);
+}
+
+// static
+bool MemBackendSnapshot::Parse(const char* data, int data_len,
+                               MemSnapshotEntries* entries) {
+  Pickle pickle(data, data_len);
+  if (!pickle.data() || pickle.size() != static_cast<size_t>(data_len) ||
+      pickle.size() - pickle.payload_size() != sizeof(PickleHeader)) {
+    return false;
+  }
+
+  const PickleHeader* header = pickle.headerT<PickleHeader>();
+  if (header->crc !=
+      CalculatePickleCRC(pickle.payload(), pickle.payload_size())) {
+    return false;
+  }
+
+  PickleIterator it(pickle);
+  uint64 magic_number;
+  uint32 version;
+  uint32 oldest_readable_version;
+  if (!it.ReadUInt64(&magic_number) || !it.ReadUInt32(&version) ||
+      !it.ReadUInt32(&oldest_readable_version)) {
+    return false;
+  }
+  if (magic_number != kMagicNumber || oldest_readable_version > kVersion)
+    return false;
+
+  // The entries go all the way to the end of the file, which the CRC already
+  // checked.
+  MemSnapshotEntries parsed_entries;
+  const char* record;
+  int record_len;
+  while (it.ReadData(&record, &record_len)) {
+    parsed_entries.push_back(new MemSnapshotEntry);
+    if (!ParseEntry(record, record_len, parsed_entries.back()))
+      return false;
+  }
+
+  entries->swap(parsed_entries);
+  return true;
+}
+
+const Pickle& MemBackendSnapshot::Finish() {
+  PickleHeader* header = file_.headerT<PickleHeader>();
+  header->crc = CalculatePickleCRC(file_.payload(), file_.payload_size());
+  return file_;
+}
+
+}  // namespace disk_cache
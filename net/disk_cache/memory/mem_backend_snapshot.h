@@ -0,0 +1,101 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_MEM_BACKEND_SNAPSHOT_H_
+#define NET_DISK_CACHE_MEMORY_MEM_BACKEND_SNAPSHOT_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/pickle.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace disk_cache {
+
+// An entry of MemBackendImpl, as it is kept in a snapshot.
+struct NET_EXPORT_PRIVATE MemSnapshotEntry {
+  enum { kNumStreams = 3 };
+
+  MemSnapshotEntry();
+  ~MemSnapshotEntry();
+
+  std::string key;
+  base::Time last_used;
+  base::Time last_modified;
+  std::string data[kNumStreams];
+};
+
+typedef ScopedVector<MemSnapshotEntry> MemSnapshotEntries;
+
+// Writes and reads the snapshots of MemBackendImpl, which let a memory cache
+// start with the entries that a previous instance used the most. A snapshot is
+// a single file, so that it is written and read sequentially, with the
+// entries in the order of their ranking, the most recently used first.
+//
+// The file is a pickle that starts with a magic number, the version of the
+// code that wrote it and the oldest version that can read it. Every entry is
+// a pickle of its own, nested in the file: new fields are only ever added to
+// the end of an entry, and a reader ignores the fields that it does not know
+// about, so most format changes do not need to lock out older readers. A CRC
+// of the whole file detects files that are truncated or corrupt.
+class NET_EXPORT_PRIVATE MemBackendSnapshot {
+ public:
+  static const uint64 kMagicNumber;
+  static const uint32 kVersion;
+  static const uint32 kOldestReadableVersion;
+
+  // |max_bytes| is the size limit of the file.
+  explicit MemBackendSnapshot(int max_bytes);
+  ~MemBackendSnapshot();
+
+  // Appends an entry to the snapshot. |data| and |data_sizes| describe the
+  // MemSnapshotEntry::kNumStreams streams of the entry. Returns false, and
+  // leaves the snapshot as it was, if the entry does not fit in the limit.
+  bool AddEntry(const std::string& key,
+                base::Time last_used,
+                base::Time last_modified,
+                const char* const* data,
+                const int32* data_sizes);
+
+  int entry_count() const { return entry_count_; }
+
+  // Writes the snapshot to |path|, replacing the previous file only once the
+  // new one is complete. Performs blocking IO.
+  bool WriteToFile(const base::FilePath& path);
+
+  // Reads the snapshot at |path| into |entries|, with one read of the whole
+  // file. Snapshots larger than |max_bytes| are ignored. Returns false if
+  // there is no usable snapshot. Performs blocking IO.
+  static bool ReadFromFile(const base::FilePath& path,
+                           int max_bytes,
+                           MemSnapshotEntries* entries);
+
+  // Parses the contents of a snapshot file into |entries|.
+  static bool Parse(const char* data, int data_len,
+                    MemSnapshotEntries* entries);
+
+ private:
+  struct PickleHeader : public Pickle::Header {
+    uint32 crc;
+  };
+
+  // Returns the file with the header and the CRC filled in.
+  const Pickle& Finish();
+
+  const int max_bytes_;
+  Pickle file_;
+  int entry_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemBackendSnapshot);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_MEM_BACKEND_SNAPSHOT_H_
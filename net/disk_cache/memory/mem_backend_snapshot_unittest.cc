@@ -0,0 +1,149 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_backend_snapshot.h"
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/pickle.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The layout of the header of a snapshot file.
+struct TestPickleHeader : public Pickle::Header {
+  uint32 crc;
+};
+
+// Returns the contents of a snapshot file with the given versions, and one
+// entry for |key| that has |num_streams| streams and one more field than the
+// current version knows about.
+std::string MakeSnapshotFile(uint32 version,
+                             uint32 oldest_readable_version,
+                             const std::string& key,
+                             uint32 num_streams) {
+  Pickle record;
+  record.WriteString(key);
+  record.WriteInt64(base::Time::Now().ToInternalValue());
+  record.WriteInt64(base::Time::Now().ToInternalValue());
+  record.WriteUInt32(num_streams);
+  for (uint32 i = 0; i < num_streams; i++)
+    record.WriteString(key);
+  record.WriteString("a field from the future");
+
+  Pickle file(sizeof(TestPickleHeader));
+  file.WriteUInt64(MemBackendSnapshot::kMagicNumber);
+  file.WriteUInt32(version);
+  file.WriteUInt32(oldest_readable_version);
+  file.WriteData(static_cast<const char*>(record.data()),
+                 static_cast<int>(record.size()));
+  file.headerT<TestPickleHeader>()->crc =
+      crc32(crc32(0, Z_NULL, 0),
+            reinterpret_cast<const Bytef*>(file.payload()),
+            file.payload_size());
+  return std::string(static_cast<const char*>(file.data()), file.size());
+}
+
+bool ParseString(const std::string& data, MemSnapshotEntries* entries) {
+  return MemBackendSnapshot::Parse(data.data(), static_cast<int>(data.size()),
+                                   entries);
+}
+
+}  // namespace
+
+TEST(MemBackendSnapshotTest, WriteAndRead) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath path = temp_dir.path().AppendASCII("snapshot");
+
+  const base::Time last_used = base::Time::Now();
+  const base::Time last_modified = last_used - base::TimeDelta::FromHours(1);
+  const char* const data[] = { "headers", NULL, "metadata" };
+  const int32 data_sizes[] = { 7, 0, 8 };
+
+  MemBackendSnapshot snapshot(1024);
+  EXPECT_TRUE(snapshot.AddEntry("key1", last_used, last_modified, data,
+                                data_sizes));
+  EXPECT_TRUE(snapshot.AddEntry("key2", last_modified, last_modified, data,
+                                data_sizes));
+  EXPECT_EQ(2, snapshot.entry_count());
+  ASSERT_TRUE(snapshot.WriteToFile(path));
+
+  MemSnapshotEntries entries;
+  ASSERT_TRUE(MemBackendSnapshot::ReadFromFile(path, 1024, &entries));
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("key1", entries[0]->key);
+  EXPECT_TRUE(last_used == entries[0]->last_used);
+  EXPECT_TRUE(last_modified == entries[0]->last_modified);
+  EXPECT_EQ("headers", entries[0]->data[0]);
+  EXPECT_EQ("", entries[0]->data[1]);
+  EXPECT_EQ("metadata", entries[0]->data[2]);
+  EXPECT_EQ("key2", entries[1]->key);
+
+  // The file is ignored if it is larger than the limit of the reader.
+  int64 file_size;
+  ASSERT_TRUE(base::GetFileSize(path, &file_size));
+  EXPECT_FALSE(MemBackendSnapshot::ReadFromFile(
+      path, static_cast<int>(file_size) - 1, &entries));
+  EXPECT_FALSE(MemBackendSnapshot::ReadFromFile(
+      temp_dir.path().AppendASCII("missing"), 1024, &entries));
+}
+
+TEST(MemBackendSnapshotTest, SizeLimit) {
+  std::string value(100, 'a');
+  const char* const data[] = { value.data(), value.data(), value.data() };
+  const int32 data_sizes[] = { 100, 100, 100 };
+
+  MemBackendSnapshot snapshot(1000);
+  EXPECT_TRUE(snapshot.AddEntry("key1", base::Time(), base::Time(), data,
+                                data_sizes));
+  EXPECT_TRUE(snapshot.AddEntry("key2", base::Time(), base::Time(), data,
+                                data_sizes));
+  EXPECT_FALSE(snapshot.AddEntry("key3", base::Time(), base::Time(), data,
+                                 data_sizes));
+
+  // Smaller entries may still fit.
+  const int32 small_sizes[] = { 10, 10, 10 };
+  EXPECT_TRUE(snapshot.AddEntry("key4", base::Time(), base::Time(), data,
+                                small_sizes));
+  EXPECT_EQ(3, snapshot.entry_count());
+}
+
+TEST(MemBackendSnapshotTest, NewerVersion) {
+  // A newer file that this version can read may have more fields.
+  MemSnapshotEntries entries;
+  std::string file = MakeSnapshotFile(MemBackendSnapshot::kVersion + 1,
+                                      MemBackendSnapshot::kVersion, "key", 4);
+  ASSERT_TRUE(ParseString(file, &entries));
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("key", entries[0]->key);
+  EXPECT_EQ("key", entries[0]->data[2]);
+
+  file = MakeSnapshotFile(MemBackendSnapshot::kVersion + 1,
+                          MemBackendSnapshot::kVersion + 1, "key", 3);
+  EXPECT_FALSE(ParseString(file, &entries));
+}
+
+TEST(MemBackendSnapshotTest, BadFiles) {
+  MemSnapshotEntries entries;
+  std::string file = MakeSnapshotFile(MemBackendSnapshot::kVersion,
+                                      MemBackendSnapshot::kVersion, "key", 3);
+  ASSERT_TRUE(ParseString(file, &entries));
+
+  EXPECT_FALSE(ParseString(std::string(), &entries));
+  EXPECT_FALSE(ParseString(file.substr(0, file.size() - 4), &entries));
+
+  std::string corrupt = file;
+  corrupt[corrupt.size() - 10] ^= 1;
+  EXPECT_FALSE(ParseString(corrupt, &entries));
+}
+
+}  // namespace disk_cache
@@ -11,6 +11,7 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/memory/mem_backend_snapshot.h"
 #include "net/disk_cache/net_log_parameters.h"
 
 using base::Time;
@@ -92,6 +93,26 @@ bool MemEntryImpl::CreateEntry(const std::string& key, net::NetLog* net_log) {
   return true;
 }
 
+void MemEntryImpl::RestoreFromSnapshot(const MemSnapshotEntry& snapshot_entry) {
+  static_assert(static_cast<int>(MemSnapshotEntry::kNumStreams) == NUM_STREAMS,
+                "snapshots must save all the streams");
+  DCHECK_EQ(key_, snapshot_entry.key);
+  for (int i = 0; i < NUM_STREAMS; i++) {
+    const std::string& data = snapshot_entry.data[i];
+    DCHECK(!data_size_[i]);
+    data_[i].assign(data.begin(), data.end());
+    data_size_[i] = static_cast<int32>(data.size());
+    backend_->ModifyStorageSize(0, data_size_[i]);
+  }
+  last_used_ = snapshot_entry.last_used;
+  last_modified_ = snapshot_entry.last_modified;
+}
+
+const char* MemEntryImpl::PeekData(int index) const {
+  DCHECK(index >= 0 && index < NUM_STREAMS);
+  return data_size_[index] ? &(data_[index])[0] : NULL;
+}
+
 void MemEntryImpl::InternalDoom() {
   net_log_.AddEvent(net::NetLog::TYPE_ENTRY_DOOM);
   doomed_ = true;
@@ -14,6 +14,7 @@
 namespace disk_cache {
 
 class MemBackendImpl;
+struct MemSnapshotEntry;
 
 // This class implements the Entry interface for the memory-only cache. An
 // object of this class represents a single entry on the cache. We use two
@@ -56,6 +57,14 @@ class MemEntryImpl : public Entry {
   // cache.
   bool CreateEntry(const std::string& key, net::NetLog* net_log);
 
+  // Fills a new entry with the data and times saved by a snapshot of the
+  // cache, without updating its ranking.
+  void RestoreFromSnapshot(const MemSnapshotEntry& snapshot_entry);
+
+  // Returns the data of stream |index|, without counting it as a use of the
+  // entry the way that ReadData() does.
+  const char* PeekData(int index) const;
+
   // Permanently destroys this entry.
   void InternalDoom();
 
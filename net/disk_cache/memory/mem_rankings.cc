@@ -25,6 +25,18 @@ void MemRankings::Insert(MemEntryImpl* node) {
   head_ = node;
 }
 
+void MemRankings::Append(MemEntryImpl* node) {
+  if (tail_)
+    tail_->set_next(node);
+
+  if (!head_)
+    head_ = node;
+
+  node->set_prev(tail_);
+  node->set_next(NULL);
+  tail_ = node;
+}
+
 void MemRankings::Remove(MemEntryImpl* node) {
   MemEntryImpl* prev = node->prev();
   MemEntryImpl* next = node->next();
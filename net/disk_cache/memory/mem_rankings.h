@@ -22,6 +22,9 @@ class MemRankings {
   // Inserts a given entry at the head of the queue.
   void Insert(MemEntryImpl* node);
 
+  // Inserts a given entry at the tail of the queue.
+  void Append(MemEntryImpl* node);
+
   // Removes a given entry from the LRU list.
   void Remove(MemEntryImpl* node);
 
@@ -0,0 +1,192 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/logging.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kChunksPerSlab = 16;
+
+// The chunk that holds the byte at |offset| of a MemSlabBuffer.
+inline size_t ToChunkIndex(int offset) {
+  return static_cast<size_t>(offset / MemSlabAllocator::kMaxChunkSize);
+}
+
+inline int ToChunkOffset(int offset) {
+  return offset % MemSlabAllocator::kMaxChunkSize;
+}
+
+}  // namespace
+
+const int MemSlabAllocator::kMinChunkSize;
+const int MemSlabAllocator::kMaxChunkSize;
+const int MemSlabAllocator::kNumChunkSizes;
+
+MemSlabAllocator::MemSlabAllocator() : slab_bytes_(0) {
+  static_assert(kMinChunkSize << (kNumChunkSizes - 1) == kMaxChunkSize,
+                "chunk sizes do not add up");
+  for (int i = 0; i < kNumChunkSizes; ++i)
+    free_chunks_[i] = NULL;
+}
+
+MemSlabAllocator::~MemSlabAllocator() {
+  for (size_t i = 0; i < slabs_.size(); ++i)
+    delete[] slabs_[i];
+}
+
+// static
+int MemSlabAllocator::GetChunkSize(int size) {
+  DCHECK_LE(size, kMaxChunkSize);
+  int chunk_size = kMinChunkSize;
+  while (chunk_size < size)
+    chunk_size *= 2;
+  return chunk_size;
+}
+
+char* MemSlabAllocator::Allocate(int chunk_size) {
+  const int index = GetSizeIndex(chunk_size);
+  if (!free_chunks_[index]) {
+    char* slab = new char[chunk_size * kChunksPerSlab];
+    slabs_.push_back(slab);
+    slab_bytes_ += chunk_size * kChunksPerSlab;
+    for (int i = kChunksPerSlab - 1; i >= 0; --i)
+      Free(slab + i * chunk_size, chunk_size);
+  }
+  FreeChunk* chunk = free_chunks_[index];
+  free_chunks_[index] = chunk->next;
+  return reinterpret_cast<char*>(chunk);
+}
+
+void MemSlabAllocator::Free(char* chunk, int chunk_size) {
+  const int index = GetSizeIndex(chunk_size);
+  FreeChunk* free_chunk = reinterpret_cast<FreeChunk*>(chunk);
+  free_chunk->next = free_chunks_[index];
+  free_chunks_[index] = free_chunk;
+}
+
+// static
+int MemSlabAllocator::GetSizeIndex(int chunk_size) {
+  int index = 0;
+  while ((kMinChunkSize << index) < chunk_size)
+    ++index;
+  DCHECK_EQ(kMinChunkSize << index, chunk_size);
+  DCHECK_LT(index, kNumChunkSizes);
+  return index;
+}
+
+MemSlabBuffer::MemSlabBuffer() : first_chunk_size_(0), size_(0) {
+}
+
+MemSlabBuffer::~MemSlabBuffer() {
+  DCHECK(chunks_.empty());
+}
+
+void MemSlabBuffer::Read(int offset, char* out, int len) const {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, size_);
+  while (len > 0) {
+    const int chunk_offset = ToChunkOffset(offset);
+    const int bytes = std::min(len, MemSlabAllocator::kMaxChunkSize -
+                                        chunk_offset);
+    memcpy(out, chunks_[ToChunkIndex(offset)] + chunk_offset, bytes);
+    out += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemSlabBuffer::Write(int offset,
+                          const char* data,
+                          int len,
+                          MemSlabAllocator* allocator) {
+  DCHECK_GE(offset, 0);
+  DCHECK_GE(len, 0);
+  const int old_size = size_;
+  Reserve(std::max(size_, offset + len), allocator);
+  size_ = std::max(size_, offset + len);
+  if (offset > old_size)
+    Zero(old_size, offset - old_size);
+  while (len > 0) {
+    const int chunk_offset = ToChunkOffset(offset);
+    const int bytes = std::min(len, MemSlabAllocator::kMaxChunkSize -
+                                        chunk_offset);
+    memcpy(chunks_[ToChunkIndex(offset)] + chunk_offset, data, bytes);
+    data += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemSlabBuffer::Truncate(int size, MemSlabAllocator* allocator) {
+  DCHECK_GE(size, 0);
+  DCHECK_LE(size, size_);
+  if (!size) {
+    Clear(allocator);
+    return;
+  }
+  const size_t chunks_needed = ToChunkIndex(size - 1) + 1;
+  while (chunks_.size() > chunks_needed) {
+    allocator->Free(chunks_.back(), MemSlabAllocator::kMaxChunkSize);
+    chunks_.pop_back();
+  }
+  size_ = size;
+}
+
+void MemSlabBuffer::Clear(MemSlabAllocator* allocator) {
+  for (size_t i = 0; i < chunks_.size(); ++i)
+    allocator->Free(chunks_[i], i ? MemSlabAllocator::kMaxChunkSize
+                                  : first_chunk_size_);
+  chunks_.clear();
+  first_chunk_size_ = 0;
+  size_ = 0;
+}
+
+void MemSlabBuffer::Reserve(int size, MemSlabAllocator* allocator) {
+  const int max_chunk_size = MemSlabAllocator::kMaxChunkSize;
+  const int capacity =
+      chunks_.empty()
+          ? 0
+          : first_chunk_size_ +
+                static_cast<int>(chunks_.size() - 1) * max_chunk_size;
+  if (size <= capacity)
+    return;
+
+  // The first chunk is the only one that is ever copied, and only until it
+  // reaches the largest size.
+  const int first_chunk_size =
+      MemSlabAllocator::GetChunkSize(std::min(size, max_chunk_size));
+  if (first_chunk_size > first_chunk_size_) {
+    char* first_chunk = allocator->Allocate(first_chunk_size);
+    if (!chunks_.empty()) {
+      memcpy(first_chunk, chunks_[0], size_);
+      allocator->Free(chunks_[0], first_chunk_size_);
+      chunks_[0] = first_chunk;
+    } else {
+      chunks_.push_back(first_chunk);
+    }
+    first_chunk_size_ = first_chunk_size;
+  }
+  while (ToChunkIndex(size - 1) >= chunks_.size())
+    chunks_.push_back(allocator->Allocate(max_chunk_size));
+}
+
+void MemSlabBuffer::Zero(int offset, int len) {
+  while (len > 0) {
+    const int chunk_offset = ToChunkOffset(offset);
+    const int bytes = std::min(len, MemSlabAllocator::kMaxChunkSize -
+                                        chunk_offset);
+    memset(chunks_[ToChunkIndex(offset)] + chunk_offset, 0, bytes);
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,107 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+#define NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// Hands out chunks of memory of a few fixed sizes, from 256 bytes up to 4 KB.
+// The chunks are carved out of larger slabs, and freed chunks are kept on a
+// list per size to be handed out again, so that buffers that keep growing and
+// shrinking do not go through the heap every time. Slabs are only returned to
+// the heap when the allocator is destroyed. This class is not thread safe.
+class NET_EXPORT_PRIVATE MemSlabAllocator {
+ public:
+  static const int kMinChunkSize = 256;
+  static const int kMaxChunkSize = 4096;
+
+  MemSlabAllocator();
+  ~MemSlabAllocator();
+
+  // Returns the size of the smallest chunk that holds |size| bytes, which
+  // must be at most kMaxChunkSize.
+  static int GetChunkSize(int size);
+
+  // Returns a chunk of |chunk_size| bytes, which must be a value returned by
+  // GetChunkSize(). The contents of the chunk are undefined.
+  char* Allocate(int chunk_size);
+
+  // Takes back |chunk|, of |chunk_size| bytes.
+  void Free(char* chunk, int chunk_size);
+
+  // Returns the number of bytes held in slabs, whether they are handed out or
+  // not.
+  int64 slab_bytes() const { return slab_bytes_; }
+
+ private:
+  // Chunk sizes are the powers of two from kMinChunkSize to kMaxChunkSize.
+  static const int kNumChunkSizes = 5;
+
+  struct FreeChunk {
+    FreeChunk* next;
+  };
+
+  static int GetSizeIndex(int chunk_size);
+
+  FreeChunk* free_chunks_[kNumChunkSizes];
+  std::vector<char*> slabs_;
+  int64 slab_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabAllocator);
+};
+
+// A buffer that grows by chunks from a MemSlabAllocator, so that growing it
+// never copies what is already written past its first chunk. A buffer of up
+// to kMaxChunkSize bytes is a single chunk of the smallest size that holds
+// it; a larger buffer is made of chunks of kMaxChunkSize bytes. The allocator
+// is passed to every method that may need it, and must be the same one
+// through the life of the buffer, which must be Clear()ed before it goes
+// away. This class is not thread safe.
+class NET_EXPORT_PRIVATE MemSlabBuffer {
+ public:
+  MemSlabBuffer();
+  ~MemSlabBuffer();
+
+  int size() const { return size_; }
+
+  // Copies |len| bytes at |offset| to |out|. They must be within the buffer.
+  void Read(int offset, char* out, int len) const;
+
+  // Copies |len| bytes from |data| to |offset|, growing the buffer if needed.
+  // If |offset| is past the end of the buffer, the gap is filled with zeros.
+  void Write(int offset,
+             const char* data,
+             int len,
+             MemSlabAllocator* allocator);
+
+  // Shrinks the buffer to |size| bytes, which must be at most size().
+  void Truncate(int size, MemSlabAllocator* allocator);
+
+  // Gives all the chunks of the buffer back to |allocator|.
+  void Clear(MemSlabAllocator* allocator);
+
+ private:
+  // Makes room for |size| bytes, which must be at least size().
+  void Reserve(int size, MemSlabAllocator* allocator);
+
+  // Fills the |len| bytes at |offset| with zeros.
+  void Zero(int offset, int len);
+
+  std::vector<char*> chunks_;
+  // The size of the first chunk; all of the others are kMaxChunkSize.
+  int first_chunk_size_;
+  int size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemSlabBuffer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_MEM_SLAB_ALLOCATOR_H_
@@ -0,0 +1,388 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/sharded_mem_backend_impl.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/memory/sharded_mem_entry_impl.h"
+
+using base::Time;
+
+namespace {
+
+const int kDefaultInMemoryCacheSize = 10 * 1024 * 1024;
+
+}  // namespace
+
+namespace disk_cache {
+
+const int ShardedMemBackendImpl::kNumShards;
+
+ShardedMemBackendImpl::Shard::Shard() : hand(NULL) {
+}
+
+ShardedMemBackendImpl::Shard::~Shard() {
+}
+
+// Enumerates the entries from the most recently used one, as they are when
+// the first entry is asked for. Every shard is only locked long enough to
+// take the keys of its entries.
+class ShardedMemBackendImpl::ShardedMemIterator : public Backend::Iterator {
+ public:
+  explicit ShardedMemIterator(base::WeakPtr<ShardedMemBackendImpl> backend)
+      : backend_(backend), started_(false), next_(0) {}
+
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    if (!backend_)
+      return net::ERR_FAILED;
+
+    if (!started_) {
+      started_ = true;
+      TakeSnapshot();
+    }
+
+    // Entries that went away since the snapshot are skipped.
+    for (; next_ < snapshot_.size(); ++next_) {
+      Shard* shard = backend_->GetShard(snapshot_[next_].key);
+      base::AutoLock lock(shard->lock);
+      Shard::EntryMap::iterator it = shard->entries.find(snapshot_[next_].key);
+      if (it == shard->entries.end())
+        continue;
+      it->second->Open();
+      *next_entry = it->second;
+      ++next_;
+      return net::OK;
+    }
+    return net::ERR_FAILED;
+  }
+
+ private:
+  struct SnapshotEntry {
+    std::string key;
+    Time last_used;
+    int entry_id;
+  };
+
+  static bool CompareForMostRecentlyUsed(const SnapshotEntry& a,
+                                         const SnapshotEntry& b) {
+    if (a.last_used != b.last_used)
+      return a.last_used > b.last_used;
+    return a.entry_id > b.entry_id;
+  }
+
+  void TakeSnapshot() {
+    for (int i = 0; i < kNumShards; ++i) {
+      Shard* shard = &backend_->shards_[i];
+      base::AutoLock lock(shard->lock);
+      for (Shard::EntryMap::const_iterator it = shard->entries.begin();
+           it != shard->entries.end(); ++it) {
+        SnapshotEntry entry;
+        entry.key = it->first;
+        entry.last_used = it->second->last_used();
+        entry.entry_id = it->second->entry_id();
+        snapshot_.push_back(entry);
+      }
+    }
+    std::sort(snapshot_.begin(), snapshot_.end(), CompareForMostRecentlyUsed);
+  }
+
+  base::WeakPtr<ShardedMemBackendImpl> backend_;
+  bool started_;
+  std::vector<SnapshotEntry> snapshot_;
+  size_t next_;
+};
+
+ShardedMemBackendImpl::ShardedMemBackendImpl(net::NetLog* net_log)
+    : max_size_(0),
+      current_size_(0),
+      next_entry_id_(0),
+      eviction_shard_(0),
+      net_log_(net_log),
+      weak_factory_(this) {
+  static_assert((kNumShards & (kNumShards - 1)) == 0,
+                "the number of shards must be a power of two");
+}
+
+ShardedMemBackendImpl::~ShardedMemBackendImpl() {
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    base::AutoLock lock(shard->lock);
+    while (!shard->entries.empty())
+      InternalDoomEntry(shard, shard->entries.begin()->second);
+  }
+  DCHECK(!base::subtle::NoBarrier_Load(&current_size_));
+}
+
+// Static.
+scoped_ptr<Backend> ShardedMemBackendImpl::CreateBackend(
+    int max_bytes,
+    net::NetLog* net_log) {
+  scoped_ptr<ShardedMemBackendImpl> cache(new ShardedMemBackendImpl(net_log));
+  cache->SetMaxSize(max_bytes);
+  if (cache->Init())
+    return cache.Pass();
+
+  LOG(ERROR) << "Unable to create cache";
+  return nullptr;
+}
+
+bool ShardedMemBackendImpl::Init() {
+  if (base::subtle::NoBarrier_Load(&max_size_))
+    return true;
+
+  // Like MemBackendImpl, use up to 2% of the memory of the computer, with a
+  // limit of 50 MB.
+  int64 total_memory = base::SysInfo::AmountOfPhysicalMemory();
+  int32 max_size = kDefaultInMemoryCacheSize;
+  if (total_memory > 0) {
+    total_memory = total_memory * 2 / 100;
+    max_size = static_cast<int32>(
+        std::min(total_memory, static_cast<int64>(max_size) * 5));
+  }
+  base::subtle::NoBarrier_Store(&max_size_, max_size);
+  return true;
+}
+
+bool ShardedMemBackendImpl::SetMaxSize(int max_bytes) {
+  static_assert(sizeof(max_bytes) == sizeof(max_size_),
+                "unsupported int model");
+  if (max_bytes < 0)
+    return false;
+
+  // Zero size means use the default.
+  if (!max_bytes)
+    return true;
+
+  base::subtle::NoBarrier_Store(&max_size_, max_bytes);
+  return true;
+}
+
+int ShardedMemBackendImpl::MaxFileSize() const {
+  return base::subtle::NoBarrier_Load(&max_size_) / 8;
+}
+
+void ShardedMemBackendImpl::ModifyStorageSize(int32 old_size,
+                                              int32 new_size) {
+  if (old_size == new_size)
+    return;
+  base::subtle::Atomic32 current_size = base::subtle::NoBarrier_AtomicIncrement(
+      &current_size_, new_size - old_size);
+  DCHECK_GE(current_size, 0);
+}
+
+void ShardedMemBackendImpl::EvictIfNeeded() {
+  const int32 max_size = base::subtle::NoBarrier_Load(&max_size_);
+  if (base::subtle::NoBarrier_Load(&current_size_) <= max_size)
+    return;
+
+  // The threads that find the cache over its limit while another one evicts
+  // go on, and leave the eviction to it.
+  if (!eviction_lock_.Try())
+    return;
+
+  // Every shard gives up one entry in turn, so that eviction is spread evenly
+  // over them. Only as much is evicted as it takes to get under the limit,
+  // which keeps the hands from going around faster than the entries are used.
+  // A turn of the hand of a shard that finds no entry clears all the bits on
+  // the way, so eviction stops after two rounds of shards without entries.
+  int shards_without_entries = 0;
+  while (base::subtle::NoBarrier_Load(&current_size_) > max_size &&
+         shards_without_entries < 2 * kNumShards) {
+    Shard* shard = &shards_[eviction_shard_];
+    eviction_shard_ = (eviction_shard_ + 1) % kNumShards;
+    base::AutoLock lock(shard->lock);
+    if (EvictOneEntry(shard))
+      shards_without_entries = 0;
+    else
+      shards_without_entries++;
+  }
+
+  eviction_lock_.Release();
+}
+
+void ShardedMemBackendImpl::InternalDoomEntry(Shard* shard,
+                                              ShardedMemEntryImpl* entry) {
+  shard->lock.AssertAcquired();
+  if (shard->hand == entry) {
+    shard->hand = entry->next() == shard->clock.end() ? NULL
+                                                      : entry->next()->value();
+  }
+  entry->RemoveFromList();
+  size_t erased = shard->entries.erase(entry->key());
+  DCHECK_EQ(1u, erased);
+
+  entry->InternalDoom();
+}
+
+net::CacheType ShardedMemBackendImpl::GetCacheType() const {
+  return net::MEMORY_CACHE;
+}
+
+int32 ShardedMemBackendImpl::GetEntryCount() const {
+  int32 count = 0;
+  for (int i = 0; i < kNumShards; ++i) {
+    base::AutoLock lock(shards_[i].lock);
+    count += static_cast<int32>(shards_[i].entries.size());
+  }
+  return count;
+}
+
+int ShardedMemBackendImpl::OpenEntry(const std::string& key,
+                                     Entry** entry,
+                                     const CompletionCallback& callback) {
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  Shard::EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
+    return net::ERR_FAILED;
+
+  it->second->Open();
+  *entry = it->second;
+  return net::OK;
+}
+
+int ShardedMemBackendImpl::CreateEntry(const std::string& key,
+                                       Entry** entry,
+                                       const CompletionCallback& callback) {
+  {
+    Shard* shard = GetShard(key);
+    base::AutoLock lock(shard->lock);
+    if (shard->entries.find(key) != shard->entries.end())
+      return net::ERR_FAILED;
+
+    ShardedMemEntryImpl* cache_entry = new ShardedMemEntryImpl(
+        this, shard, key,
+        base::subtle::NoBarrier_AtomicIncrement(&next_entry_id_, 1), net_log_);
+    cache_entry->Open();
+    shard->entries[key] = cache_entry;
+    // New entries go right behind the hand, so that they are the last ones
+    // that it visits.
+    if (shard->hand)
+      cache_entry->InsertBefore(shard->hand);
+    else
+      shard->clock.Append(cache_entry);
+    *entry = cache_entry;
+  }
+  EvictIfNeeded();
+  return net::OK;
+}
+
+int ShardedMemBackendImpl::DoomEntry(const std::string& key,
+                                     const CompletionCallback& callback) {
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  Shard::EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
+    return net::ERR_FAILED;
+
+  InternalDoomEntry(shard, it->second);
+  return net::OK;
+}
+
+int ShardedMemBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  InternalDoomEntriesBetween(Time(), Time());
+  return net::OK;
+}
+
+int ShardedMemBackendImpl::DoomEntriesBetween(
+    const Time initial_time,
+    const Time end_time,
+    const CompletionCallback& callback) {
+  DCHECK(end_time.is_null() || end_time >= initial_time);
+  InternalDoomEntriesBetween(initial_time, end_time);
+  return net::OK;
+}
+
+int ShardedMemBackendImpl::DoomEntriesSince(
+    const Time initial_time,
+    const CompletionCallback& callback) {
+  InternalDoomEntriesBetween(initial_time, Time());
+  return net::OK;
+}
+
+scoped_ptr<Backend::Iterator> ShardedMemBackendImpl::CreateIterator() {
+  return scoped_ptr<Backend::Iterator>(
+      new ShardedMemIterator(weak_factory_.GetWeakPtr()));
+}
+
+void ShardedMemBackendImpl::GetStats(
+    std::vector<std::pair<std::string, std::string>>* stats) {
+  int64 slab_bytes = 0;
+  for (int i = 0; i < kNumShards; ++i) {
+    base::AutoLock lock(shards_[i].lock);
+    slab_bytes += shards_[i].allocator.slab_bytes();
+  }
+  stats->push_back(std::make_pair(
+      "Current size",
+      base::IntToString(base::subtle::NoBarrier_Load(&current_size_))));
+  stats->push_back(
+      std::make_pair("Slab bytes", base::Int64ToString(slab_bytes)));
+}
+
+void ShardedMemBackendImpl::OnExternalCacheHit(const std::string& key) {
+  Shard* shard = GetShard(key);
+  base::AutoLock lock(shard->lock);
+  Shard::EntryMap::iterator it = shard->entries.find(key);
+  if (it != shard->entries.end())
+    it->second->set_referenced();
+}
+
+ShardedMemBackendImpl::Shard* ShardedMemBackendImpl::GetShard(
+    const std::string& key) {
+  return &shards_[base::Hash(key) & (kNumShards - 1)];
+}
+
+void ShardedMemBackendImpl::InternalDoomEntriesBetween(Time initial_time,
+                                                       Time end_time) {
+  std::vector<ShardedMemEntryImpl*> entries_to_doom;
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    base::AutoLock lock(shard->lock);
+    entries_to_doom.clear();
+    for (Shard::EntryMap::iterator it = shard->entries.begin();
+         it != shard->entries.end(); ++it) {
+      const Time last_used = it->second->last_used();
+      if (last_used >= initial_time &&
+          (end_time.is_null() || last_used < end_time)) {
+        entries_to_doom.push_back(it->second);
+      }
+    }
+    for (size_t j = 0; j < entries_to_doom.size(); ++j)
+      InternalDoomEntry(shard, entries_to_doom[j]);
+  }
+}
+
+bool ShardedMemBackendImpl::EvictOneEntry(Shard* shard) {
+  shard->lock.AssertAcquired();
+  if (shard->clock.empty())
+    return false;
+
+  const size_t max_steps = shard->entries.size();
+  for (size_t i = 0; i < max_steps; ++i) {
+    ShardedMemEntryImpl* entry =
+        shard->hand ? shard->hand : shard->clock.head()->value();
+    base::LinkNode<ShardedMemEntryImpl>* next = entry->next();
+    shard->hand = next == shard->clock.end() ? NULL : next->value();
+
+    if (entry->InUse())
+      continue;
+    if (entry->referenced()) {
+      entry->clear_referenced();
+      continue;
+    }
+    InternalDoomEntry(shard, entry);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,160 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_MEMORY_SHARDED_MEM_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_MEMORY_SHARDED_MEM_BACKEND_IMPL_H_
+
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/containers/hash_tables.h"
+#include "base/containers/linked_list.h"
+#include "base/memory/weak_ptr.h"
+#include "base/synchronization/lock.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+class ShardedMemEntryImpl;
+
+// This class implements the Backend interface without writing to disk, like
+// MemBackendImpl, but the backend and its entries can be used from several
+// threads at once. The entries are spread over shards by the hash of their
+// keys, and each shard has its own lock, so that threads that work on
+// different entries rarely wait for each other. The data of the entries is
+// kept in buffers from a slab allocator per shard.
+//
+// Entries are evicted with the CLOCK algorithm: every use of an entry only
+// sets a bit on it, instead of moving it to the head of an LRU list. Eviction
+// sweeps the entries of each shard in turn, clearing the bits that it finds
+// set and evicting the first entry whose bit is already clear. Eviction only
+// brings the cache back to its limit, instead of down to a low watermark, so
+// that every entry gets a whole turn of the hand to be used again.
+//
+// All the methods of the backend, and of its entries, complete synchronously.
+// Iterators, and the destruction of the backend, must stay on the thread that
+// created the backend.
+class NET_EXPORT_PRIVATE ShardedMemBackendImpl : public Backend {
+ public:
+  // The entries whose keys hash to the same shard. Everything here is guarded
+  // by |lock|, as is the state of the entries themselves.
+  struct Shard {
+    typedef base::hash_map<std::string, ShardedMemEntryImpl*> EntryMap;
+
+    Shard();
+    ~Shard();
+
+    mutable base::Lock lock;
+    EntryMap entries;
+    // The entries of |entries|, in the order that the clock hand visits
+    // them, wrapping around at the end.
+    base::LinkedList<ShardedMemEntryImpl> clock;
+    // The next entry that the hand visits; NULL for the head of |clock|.
+    ShardedMemEntryImpl* hand;
+    MemSlabAllocator allocator;
+  };
+
+  explicit ShardedMemBackendImpl(net::NetLog* net_log);
+  ~ShardedMemBackendImpl() override;
+
+  // Returns an instance of a Backend implemented only in memory, that can be
+  // used from several threads. |max_bytes| is the maximum size the cache can
+  // grow to; if it is zero, the cache will determine the value to use based
+  // on the available memory. The returned pointer can be NULL if a fatal
+  // error is found.
+  static scoped_ptr<Backend> CreateBackend(int max_bytes,
+                                           net::NetLog* net_log);
+
+  // Performs general initialization for this current instance of the cache.
+  bool Init();
+
+  // Sets the maximum size for the total amount of data stored by this
+  // instance.
+  bool SetMaxSize(int max_bytes);
+
+  // Returns the maximum size for a file to reside on the cache.
+  int MaxFileSize() const;
+
+  // A user data block of an entry is being created, extended or truncated.
+  void ModifyStorageSize(int32 old_size, int32 new_size);
+
+  // Evicts entries until the cache is back under its limit, if it is over it.
+  // No lock may be held while this is called.
+  void EvictIfNeeded();
+
+  // Removes |entry| from |shard|, whose lock must be held, and deletes it
+  // unless it is open.
+  void InternalDoomEntry(Shard* shard, ShardedMemEntryImpl* entry);
+
+  // Backend interface.
+  net::CacheType GetCacheType() const override;
+  int32 GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  scoped_ptr<Iterator> CreateIterator() override;
+  void GetStats(
+      std::vector<std::pair<std::string, std::string>>* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+
+ private:
+  class ShardedMemIterator;
+
+  // A power of two, so that a shard is picked with a mask.
+  static const int kNumShards = 16;
+
+  Shard* GetShard(const std::string& key);
+
+  // Dooms the entries last used in [|initial_time|, |end_time|); a null
+  // |end_time| has no limit.
+  void InternalDoomEntriesBetween(base::Time initial_time,
+                                  base::Time end_time);
+
+  // Moves the hand of |shard|, whose lock must be held, for up to a turn,
+  // until it finds an entry to evict, and evicts it. Returns false if there
+  // is none.
+  bool EvictOneEntry(Shard* shard);
+
+  Shard shards_[kNumShards];
+
+  base::subtle::Atomic32 max_size_;
+  base::subtle::Atomic32 current_size_;
+  // Gives out the ids that break ties between entries last used at the same
+  // time.
+  base::subtle::Atomic32 next_entry_id_;
+
+  // Held by the thread that evicts entries, so that the others do not pile up
+  // behind it.
+  base::Lock eviction_lock_;
+  // The shard that eviction visits next. Guarded by |eviction_lock_|.
+  int eviction_shard_;
+
+  net::NetLog* net_log_;
+
+  base::WeakPtrFactory<ShardedMemBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedMemBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_SHARDED_MEM_BACKEND_IMPL_H_
@@ -0,0 +1,476 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/sharded_mem_entry_impl.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/values.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/net_log_parameters.h"
+
+using base::Time;
+
+namespace {
+
+const int kSparseData = 1;
+
+// Like in MemEntryImpl, a sparse child holds up to 2 to the power of this
+// number of bytes.
+const int kMaxSparseEntryBits = 12;
+
+const int kMaxSparseEntrySize = 1 << kMaxSparseEntryBits;
+
+inline int64 ToChildIndex(int64 offset) {
+  return offset >> kMaxSparseEntryBits;
+}
+
+inline int ToChildOffset(int64 offset) {
+  return static_cast<int>(offset & (kMaxSparseEntrySize - 1));
+}
+
+// Returns NetLog parameters for the creation of an entry. Unlike
+// CreateNetLogEntryCreationCallback(), it does not call GetKey(), which would
+// take the lock that is held while the entry is created.
+base::Value* NetLogEntryCreationCallback(
+    const std::string* key,
+    net::NetLog::LogLevel /* log_level */) {
+  base::DictionaryValue* dict = new base::DictionaryValue();
+  dict->SetString("key", *key);
+  dict->SetBoolean("created", true);
+  return dict;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+ShardedMemEntryImpl::SparseChild::SparseChild() : first_pos(0) {
+}
+
+ShardedMemEntryImpl::SparseChild::~SparseChild() {
+}
+
+ShardedMemEntryImpl::ShardedMemEntryImpl(ShardedMemBackendImpl* backend,
+                                         ShardedMemBackendImpl::Shard* shard,
+                                         const std::string& key,
+                                         int entry_id,
+                                         net::NetLog* net_log)
+    : backend_(backend),
+      shard_(shard),
+      key_(key),
+      entry_id_(entry_id),
+      sparse_(false),
+      ref_count_(0),
+      doomed_(false),
+      referenced_(false),
+      last_modified_(Time::Now()),
+      last_used_(last_modified_) {
+  shard_->lock.AssertAcquired();
+  net_log_ = net::BoundNetLog::Make(net_log,
+                                    net::NetLog::SOURCE_MEMORY_CACHE_ENTRY);
+  net_log_.BeginEvent(net::NetLog::TYPE_DISK_CACHE_MEM_ENTRY_IMPL,
+                      base::Bind(&NetLogEntryCreationCallback, &key_));
+  backend_->ModifyStorageSize(0, static_cast<int32>(key_.size()));
+}
+
+void ShardedMemEntryImpl::Open() {
+  shard_->lock.AssertAcquired();
+  DCHECK(!doomed_);
+  ref_count_++;
+  referenced_ = true;
+}
+
+bool ShardedMemEntryImpl::InternalDoom() {
+  shard_->lock.AssertAcquired();
+  net_log_.AddEvent(net::NetLog::TYPE_ENTRY_DOOM);
+  doomed_ = true;
+  if (ref_count_)
+    return false;
+  delete this;
+  return true;
+}
+
+void ShardedMemEntryImpl::Doom() {
+  base::AutoLock lock(shard_->lock);
+  if (doomed_)
+    return;
+  backend_->InternalDoomEntry(shard_, this);
+}
+
+void ShardedMemEntryImpl::Close() {
+  // |shard_| outlives the entry, so the lock can be released after the entry
+  // is gone.
+  base::AutoLock lock(shard_->lock);
+  ref_count_--;
+  DCHECK_GE(ref_count_, 0);
+  if (!ref_count_ && doomed_)
+    delete this;
+}
+
+std::string ShardedMemEntryImpl::GetKey() const {
+  return key_;
+}
+
+Time ShardedMemEntryImpl::GetLastUsed() const {
+  base::AutoLock lock(shard_->lock);
+  return last_used_;
+}
+
+Time ShardedMemEntryImpl::GetLastModified() const {
+  base::AutoLock lock(shard_->lock);
+  return last_modified_;
+}
+
+int32 ShardedMemEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= NUM_STREAMS)
+    return 0;
+  base::AutoLock lock(shard_->lock);
+  return data_[index].size();
+}
+
+int ShardedMemEntryImpl::ReadData(int index,
+                                  int offset,
+                                  IOBuffer* buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, false));
+  }
+
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = InternalReadData(index, offset, buf, buf_len);
+  }
+
+  if (net_log_.IsLogging()) {
+    net_log_.EndEvent(net::NetLog::TYPE_ENTRY_READ_DATA,
+                      CreateNetLogReadWriteCompleteCallback(result));
+  }
+  return result;
+}
+
+int ShardedMemEntryImpl::WriteData(int index,
+                                   int offset,
+                                   IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback,
+                                   bool truncate) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        CreateNetLogReadWriteDataCallback(index, offset, buf_len, truncate));
+  }
+
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = InternalWriteData(index, offset, buf, buf_len, truncate);
+  }
+  backend_->EvictIfNeeded();
+
+  if (net_log_.IsLogging()) {
+    net_log_.EndEvent(net::NetLog::TYPE_ENTRY_WRITE_DATA,
+                      CreateNetLogReadWriteCompleteCallback(result));
+  }
+  return result;
+}
+
+int ShardedMemEntryImpl::ReadSparseData(int64 offset,
+                                        IOBuffer* buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(net::NetLog::TYPE_SPARSE_READ,
+                        CreateNetLogSparseOperationCallback(offset, buf_len));
+  }
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = InternalReadSparseData(offset, buf, buf_len);
+  }
+  if (net_log_.IsLogging())
+    net_log_.EndEvent(net::NetLog::TYPE_SPARSE_READ);
+  return result;
+}
+
+int ShardedMemEntryImpl::WriteSparseData(int64 offset,
+                                         IOBuffer* buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(net::NetLog::TYPE_SPARSE_WRITE,
+                        CreateNetLogSparseOperationCallback(offset, buf_len));
+  }
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = InternalWriteSparseData(offset, buf, buf_len);
+  }
+  backend_->EvictIfNeeded();
+  if (net_log_.IsLogging())
+    net_log_.EndEvent(net::NetLog::TYPE_SPARSE_WRITE);
+  return result;
+}
+
+int ShardedMemEntryImpl::GetAvailableRange(int64 offset,
+                                           int len,
+                                           int64* start,
+                                           const CompletionCallback& callback) {
+  if (net_log_.IsLogging()) {
+    net_log_.BeginEvent(net::NetLog::TYPE_SPARSE_GET_RANGE,
+                        CreateNetLogSparseOperationCallback(offset, len));
+  }
+  int result;
+  {
+    base::AutoLock lock(shard_->lock);
+    result = InternalGetAvailableRange(offset, len, start);
+  }
+  if (net_log_.IsLogging()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_SPARSE_GET_RANGE,
+        CreateNetLogGetAvailableRangeResultCallback(*start, result));
+  }
+  return result;
+}
+
+bool ShardedMemEntryImpl::CouldBeSparse() const {
+  base::AutoLock lock(shard_->lock);
+  return sparse_;
+}
+
+int ShardedMemEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return net::OK;
+}
+
+// ------------------------------------------------------------------------
+
+ShardedMemEntryImpl::~ShardedMemEntryImpl() {
+  shard_->lock.AssertAcquired();
+  for (int i = 0; i < NUM_STREAMS; i++) {
+    backend_->ModifyStorageSize(data_[i].size(), 0);
+    data_[i].Clear(&shard_->allocator);
+  }
+  for (SparseChildMap::iterator it = children_.begin(); it != children_.end();
+       ++it) {
+    backend_->ModifyStorageSize(it->second.data.size(), 0);
+    it->second.data.Clear(&shard_->allocator);
+  }
+  backend_->ModifyStorageSize(static_cast<int32>(key_.size()), 0);
+  net_log_.EndEvent(net::NetLog::TYPE_DISK_CACHE_MEM_ENTRY_IMPL);
+}
+
+int ShardedMemEntryImpl::InternalReadData(int index,
+                                          int offset,
+                                          IOBuffer* buf,
+                                          int buf_len) {
+  if (index < 0 || index >= NUM_STREAMS)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int entry_size = data_[index].size();
+  if (offset >= entry_size || offset < 0 || !buf_len)
+    return 0;
+
+  if (buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset + buf_len > entry_size)
+    buf_len = entry_size - offset;
+
+  UpdateRank(false);
+
+  data_[index].Read(offset, buf->data(), buf_len);
+  return buf_len;
+}
+
+int ShardedMemEntryImpl::InternalWriteData(int index,
+                                           int offset,
+                                           IOBuffer* buf,
+                                           int buf_len,
+                                           bool truncate) {
+  if (index < 0 || index >= NUM_STREAMS)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int max_file_size = backend_->MaxFileSize();
+
+  // offset of buf_len could be negative numbers.
+  if (offset > max_file_size || buf_len > max_file_size ||
+      offset + buf_len > max_file_size) {
+    return net::ERR_FAILED;
+  }
+
+  MemSlabBuffer* data = &data_[index];
+  int entry_size = data->size();
+  data->Write(offset, buf_len ? buf->data() : NULL, buf_len,
+              &shard_->allocator);
+  if (truncate && entry_size > offset + buf_len)
+    data->Truncate(offset + buf_len, &shard_->allocator);
+  backend_->ModifyStorageSize(entry_size, data->size());
+
+  UpdateRank(true);
+
+  return buf_len;
+}
+
+int ShardedMemEntryImpl::InternalReadSparseData(int64 offset,
+                                                IOBuffer* buf,
+                                                int buf_len) {
+  if (!sparse_ && data_[kSparseData].size())
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  sparse_ = true;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int bytes_read = 0;
+  while (bytes_read < buf_len) {
+    const int64 current_offset = offset + bytes_read;
+    SparseChildMap::iterator child =
+        children_.find(ToChildIndex(current_offset));
+
+    // No child present for that offset.
+    if (child == children_.end())
+      break;
+
+    // Stop at the first position that the child has no data for.
+    const int child_offset = ToChildOffset(current_offset);
+    if (child_offset < child->second.first_pos ||
+        child_offset >= child->second.data.size()) {
+      break;
+    }
+
+    const int bytes = std::min(buf_len - bytes_read,
+                               child->second.data.size() - child_offset);
+    child->second.data.Read(child_offset, buf->data() + bytes_read, bytes);
+    bytes_read += bytes;
+  }
+
+  UpdateRank(false);
+
+  return bytes_read;
+}
+
+int ShardedMemEntryImpl::InternalWriteSparseData(int64 offset,
+                                                 IOBuffer* buf,
+                                                 int buf_len) {
+  if (!sparse_ && data_[kSparseData].size())
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  sparse_ = true;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  const int max_file_size = backend_->MaxFileSize();
+
+  // Writes blocks of up to kMaxSparseEntrySize bytes into each child, until
+  // all |buf_len| bytes are written. The first write can start in the middle
+  // of a child.
+  int bytes_written = 0;
+  while (bytes_written < buf_len) {
+    const int64 current_offset = offset + bytes_written;
+    const int child_offset = ToChildOffset(current_offset);
+    const int write_len = std::min(buf_len - bytes_written,
+                                   kMaxSparseEntrySize - child_offset);
+    if (child_offset + write_len > max_file_size)
+      return net::ERR_FAILED;
+
+    SparseChild* child = &children_[ToChildIndex(current_offset)];
+    MemSlabBuffer* data = &child->data;
+    const int data_size = data->size();
+
+    // Always writes to the child, truncating whatever was after the write.
+    data->Write(child_offset, buf->data() + bytes_written, write_len,
+                &shard_->allocator);
+    if (data->size() > child_offset + write_len)
+      data->Truncate(child_offset + write_len, &shard_->allocator);
+    backend_->ModifyStorageSize(data_size, data->size());
+
+    // Like in MemEntryImpl, a write that does not continue the data of the
+    // child becomes the start of its only region.
+    if (data_size != child_offset)
+      child->first_pos = child_offset;
+
+    bytes_written += write_len;
+  }
+
+  UpdateRank(true);
+
+  return bytes_written;
+}
+
+int ShardedMemEntryImpl::InternalGetAvailableRange(int64 offset,
+                                                   int len,
+                                                   int64* start) {
+  DCHECK(start);
+
+  if (!sparse_ && data_[kSparseData].size())
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  sparse_ = true;
+
+  if (offset < 0 || len < 0 || !start)
+    return net::ERR_INVALID_ARGUMENT;
+
+  SparseChildMap::iterator child;
+  const int64 empty = FindNextChild(offset, len, &child);
+  if (child == children_.end()) {
+    *start = offset;
+    return 0;
+  }
+
+  *start = offset + empty;
+  int64 remaining = len - empty;
+  int continuous = 0;
+  while (remaining && child != children_.end()) {
+    // Number of bytes available in this child.
+    int64 data_size = child->second.data.size() -
+                      ToChildOffset(*start + continuous);
+    data_size = std::min(data_size, remaining);
+    continuous += static_cast<int>(data_size);
+    remaining -= data_size;
+
+    // Stop if the data of the next child does not follow right away.
+    if (FindNextChild(*start + continuous, remaining, &child))
+      break;
+  }
+  return continuous;
+}
+
+int64 ShardedMemEntryImpl::FindNextChild(int64 offset,
+                                         int64 len,
+                                         SparseChildMap::iterator* child) {
+  *child = children_.end();
+  for (SparseChildMap::iterator it =
+           children_.lower_bound(ToChildIndex(offset));
+       it != children_.end(); ++it) {
+    const int64 child_start = it->first << kMaxSparseEntryBits;
+    const int64 first_pos =
+        std::max(offset, child_start + it->second.first_pos);
+    if (first_pos >= offset + len)
+      break;
+    if (first_pos < child_start + it->second.data.size()) {
+      *child = it;
+      return first_pos - offset;
+    }
+  }
+  return len;
+}
+
+void ShardedMemEntryImpl::UpdateRank(bool modified) {
+  Time current = Time::Now();
+  last_used_ = current;
+  if (modified)
+    last_modified_ = current;
+  referenced_ = true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,146 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_SHARDED_MEM_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_MEMORY_SHARDED_MEM_ENTRY_IMPL_H_
+
+#include <map>
+#include <string>
+
+#include "base/containers/linked_list.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_slab_allocator.h"
+#include "net/disk_cache/memory/sharded_mem_backend_impl.h"
+#include "net/log/net_log.h"
+
+namespace disk_cache {
+
+// This class implements the Entry interface for ShardedMemBackendImpl. All of
+// its state is guarded by the lock of the shard of the backend that it lives
+// in; the methods of the Entry interface take that lock, and the others must
+// be called with it held.
+//
+// Unlike MemEntryImpl, the sparse data of an entry is kept in the entry
+// itself, as a map of children of up to 4 KB each. Like with MemEntryImpl,
+// every child can only hold one continuous region, so a write that leaves a
+// gap before the data of a child drops that data.
+class ShardedMemEntryImpl : public Entry,
+                            public base::LinkNode<ShardedMemEntryImpl> {
+ public:
+  ShardedMemEntryImpl(ShardedMemBackendImpl* backend,
+                      ShardedMemBackendImpl::Shard* shard,
+                      const std::string& key,
+                      int entry_id,
+                      net::NetLog* net_log);
+
+  // Opens a reference to the entry, which counts as a use for eviction.
+  void Open();
+
+  // Drops the entry from the cache; it is deleted now if it is not open, or
+  // else when it is closed. Returns true if it was deleted.
+  bool InternalDoom();
+
+  const std::string& key() const { return key_; }
+  bool InUse() const { return ref_count_ > 0; }
+  base::Time last_used() const { return last_used_; }
+  int entry_id() const { return entry_id_; }
+
+  bool referenced() const { return referenced_; }
+  void clear_referenced() { referenced_ = false; }
+  void set_referenced() { referenced_ = true; }
+
+  // Entry interface.
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32 GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64 offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64 offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64 offset,
+                        int len,
+                        int64* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override {}
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  enum {
+    NUM_STREAMS = 3
+  };
+
+  struct SparseChild {
+    SparseChild();
+    ~SparseChild();
+
+    // The offset in the child of the first byte of its data.
+    int first_pos;
+    MemSlabBuffer data;
+  };
+
+  // Keyed by the offset of the child divided by the size of a child.
+  typedef std::map<int64, SparseChild> SparseChildMap;
+
+  ~ShardedMemEntryImpl() override;
+
+  // Do all the work for corresponding public functions, with the lock held.
+  int InternalReadData(int index, int offset, IOBuffer* buf, int buf_len);
+  int InternalWriteData(int index, int offset, IOBuffer* buf, int buf_len,
+                        bool truncate);
+  int InternalReadSparseData(int64 offset, IOBuffer* buf, int buf_len);
+  int InternalWriteSparseData(int64 offset, IOBuffer* buf, int buf_len);
+  int InternalGetAvailableRange(int64 offset, int len, int64* start);
+
+  // Finds the first byte of sparse data within [|offset|, |offset| + |len|).
+  // Returns the number of bytes before it, or |len| if there is none, and
+  // outputs the child that holds it to |child|.
+  int64 FindNextChild(int64 offset, int64 len, SparseChildMap::iterator* child);
+
+  // Updates the times of the entry, and marks it as used for eviction.
+  void UpdateRank(bool modified);
+
+  ShardedMemBackendImpl* backend_;
+  ShardedMemBackendImpl::Shard* shard_;
+  const std::string key_;
+  const int entry_id_;
+
+  MemSlabBuffer data_[NUM_STREAMS];
+  bool sparse_;
+  SparseChildMap children_;
+
+  int ref_count_;
+  bool doomed_;
+  // Set on every use; cleared by the clock hand.
+  bool referenced_;
+
+  base::Time last_modified_;
+  base::Time last_used_;
+
+  net::BoundNetLog net_log_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedMemEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_SHARDED_MEM_ENTRY_IMPL_H_
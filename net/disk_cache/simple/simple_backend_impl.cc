@@ -30,9 +30,11 @@
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_io_ring.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
@@ -58,6 +60,10 @@ const char kThreadNamePrefix[] = "SimpleCache";
 // Maximum fraction of the cache that one entry can consume.
 const int kMaxFileRatio = 8;
 
+// Entries up to this size go to slab files in the "Slabs" group of the
+// SimpleCacheSlabs field trial.
+const int kDefaultSlabEntryThreshold = 8 * 1024;
+
 class LeakySequencedWorkerPool {
  public:
   LeakySequencedWorkerPool()
@@ -235,6 +241,12 @@ SimpleBackendImpl::SimpleBackendImpl(
     : path_(path),
       cache_type_(cache_type),
       cache_thread_(cache_thread),
+      use_io_ring_(false),
+      io_ring_(NULL),
+      slab_entry_threshold_(0),
+      compression_codec_(SIMPLE_COMPRESSION_NONE),
+      open_waits_for_index_(false),
+      compacting_slabs_(false),
       orig_max_size_(max_bytes),
       entry_operations_mode_(cache_type == net::DISK_CACHE ?
                                  SimpleEntryImpl::OPTIMISTIC_OPERATIONS :
@@ -249,6 +261,22 @@ SimpleBackendImpl::~SimpleBackendImpl() {
 
 int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
   worker_pool_ = g_sequenced_worker_pool.Get().GetTaskRunner();
+  if (use_io_ring_ ||
+      base::FieldTrialList::FindFullName("SimpleCacheIOEngine") == "IORing") {
+    io_ring_ = SimpleIORing::Get();
+  }
+  if (!slab_entry_threshold_ &&
+      base::FieldTrialList::FindFullName("SimpleCacheSlabs") == "Slabs") {
+    slab_entry_threshold_ = kDefaultSlabEntryThreshold;
+  }
+  // The store also serves the entries that earlier sessions put in slabs
+  // when new entries no longer go there.
+  slab_store_ = new SimpleSlabStore(path_, slab_entry_threshold_);
+  if (compression_codec_ == SIMPLE_COMPRESSION_NONE &&
+      base::FieldTrialList::FindFullName("SimpleCacheCompression") ==
+          "Deflate") {
+    compression_codec_ = SIMPLE_COMPRESSION_DEFLATE;
+  }
 
   index_.reset(new SimpleIndex(
       base::ThreadTaskRunnerHandle::Get(),
@@ -256,6 +284,8 @@ int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
       cache_type_,
       make_scoped_ptr(new SimpleIndexFile(
           cache_thread_, worker_pool_.get(), cache_type_, path_))));
+  if (base::FieldTrialList::FindFullName("SimpleCacheEviction") == "TinyLFU")
+    index_->SetEvictionPolicy(SimpleEvictionPolicy::CreateTinyLFU());
   index_->ExecuteWhenReady(
       base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
 
@@ -375,6 +405,19 @@ int SimpleBackendImpl::OpenEntry(const std::string& key,
                                  const CompletionCallback& callback) {
   const uint64 entry_hash = simple_util::GetEntryHashKey(key);
 
+  // Creating and dooming entries before the index is ready is fine, since the
+  // index settles their slab records once it is loaded. Opening them only
+  // needs the index to know where they are, which it can tell from the index
+  // file before the entries are loaded from it.
+  if (open_waits_for_index_ && !index_->lookups_ready()) {
+    Callback<int(const net::CompletionCallback&)> operation =
+        base::Bind(&SimpleBackendImpl::OpenEntry,
+                   base::Unretained(this), key, entry);
+    return index_->ExecuteWhenLookupsReady(
+        base::Bind(&SimpleBackendImpl::IndexReadyForOperation, AsWeakPtr(),
+                   operation, callback));
+  }
+
   // TODO(gavinp): Factor out this (not quite completely) repetitive code
   // block from OpenEntry/CreateEntry/DoomEntry.
   base::hash_map<uint64, std::vector<Closure> >::iterator it =
@@ -442,6 +485,13 @@ int SimpleBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
   return DoomEntriesBetween(Time(), Time(), callback);
 }
 
+void SimpleBackendImpl::IndexReadyForOperation(
+    const Callback<int(const net::CompletionCallback&)>& operation,
+    const CompletionCallback& callback,
+    int result) {
+  RunOperationAndCallback(operation, callback);
+}
+
 void SimpleBackendImpl::IndexReadyForDoom(Time initial_time,
                                           Time end_time,
                                           const CompletionCallback& callback,
@@ -559,6 +609,8 @@ void SimpleBackendImpl::OnExternalCacheHit(const std::string& key) {
 void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
                                         const DiskStatResult& result) {
   if (result.net_error == net::OK) {
+    open_waits_for_index_ =
+        result.has_slabs || slab_store_->entry_threshold() > 0;
     index_->SetMaxSize(result.max_size);
     index_->Initialize(result.cache_dir_mtime);
   }
@@ -570,6 +622,7 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     uint64 suggested_max_size) {
   DiskStatResult result;
   result.max_size = suggested_max_size;
+  result.has_slabs = false;
   result.net_error = net::OK;
   if (!FileStructureConsistent(path)) {
     LOG(ERROR) << "Simple Cache Backend: wrong file structure on disk: "
@@ -579,6 +632,8 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     bool mtime_result =
         disk_cache::simple_util::GetMTime(path, &result.cache_dir_mtime);
     DCHECK(mtime_result);
+    result.has_slabs = base::DirectoryExists(
+        path.AppendASCII(SimpleSlabStore::kSlabDirectory));
     if (!result.max_size) {
       int64 available = base::SysInfo::AmountOfFreeDiskSpace(path);
       result.max_size = disk_cache::PreferredCacheSize(available);
@@ -588,6 +643,56 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
   return result;
 }
 
+void SimpleBackendImpl::ReleaseSlabRecord(
+    uint64 entry_hash,
+    const SimpleSlabAddress& slab_address) {
+  worker_pool_->PostTask(FROM_HERE,
+                         base::Bind(&SimpleSlabStore::Kill, slab_store_,
+                                    slab_address, entry_hash));
+  MaybeCompactSlabs();
+}
+
+void SimpleBackendImpl::MaybeCompactSlabs() {
+  // The index has to know every live record, or the records that it does not
+  // know of yet would be lost with their slab.
+  if (compacting_slabs_ || !index_->initialized() ||
+      !slab_store_->ShouldCompact()) {
+    return;
+  }
+  compacting_slabs_ = true;
+  std::vector<SimpleSlabStore::Move>* moves =
+      new std::vector<SimpleSlabStore::Move>();
+  uint32* slab_number = new uint32(0);
+  worker_pool_->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&SimpleSlabStore::Compact, slab_store_, moves, slab_number),
+      base::Bind(&SimpleBackendImpl::SlabCompactionComplete, AsWeakPtr(),
+                 base::Owned(moves), base::Owned(slab_number)));
+}
+
+void SimpleBackendImpl::SlabCompactionComplete(
+    const std::vector<SimpleSlabStore::Move>* moves,
+    const uint32* slab_number) {
+  DCHECK(compacting_slabs_);
+  compacting_slabs_ = false;
+  for (std::vector<SimpleSlabStore::Move>::const_iterator it = moves->begin();
+       it != moves->end(); ++it) {
+    // An entry that was doomed or rewritten in the meantime does not need its
+    // copy.
+    if (!index_->MoveSlabRecord(it->entry_hash, it->from, it->to)) {
+      worker_pool_->PostTask(FROM_HERE,
+                             base::Bind(&SimpleSlabStore::Kill, slab_store_,
+                                        it->to, it->entry_hash));
+    }
+  }
+  if (*slab_number) {
+    worker_pool_->PostTask(FROM_HERE,
+                           base::Bind(&SimpleSlabStore::DeleteSlab, slab_store_,
+                                      *slab_number));
+  }
+  MaybeCompactSlabs();
+}
+
 scoped_refptr<SimpleEntryImpl> SimpleBackendImpl::CreateOrFindActiveEntry(
     const uint64 entry_hash,
     const std::string& key) {
@@ -20,8 +20,10 @@
 #include "base/time/time.h"
 #include "net/base/cache_type.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_compression.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
 
 namespace base {
 class SingleThreadTaskRunner;
@@ -44,6 +46,7 @@ namespace disk_cache {
 
 class SimpleEntryImpl;
 class SimpleIndex;
+class SimpleIORing;
 
 class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
     public SimpleIndexDelegate,
@@ -63,6 +66,37 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   base::TaskRunner* worker_pool() { return worker_pool_.get(); }
 
+  // Returns the ring that entries do their stream IO through, or NULL if
+  // they use the worker pool for it.
+  SimpleIORing* io_ring() { return io_ring_; }
+
+  // Makes entries use an io_uring for their stream IO where the kernel
+  // supports it, like the "IORing" group of the SimpleCacheIOEngine field
+  // trial does. Must be called before Init().
+  void set_use_io_ring(bool use_io_ring) { use_io_ring_ = use_io_ring; }
+
+  // Returns the store of the entries that are kept in slab files.
+  SimpleSlabStore* slab_store() { return slab_store_.get(); }
+
+  // Makes entries whose files take at most |slab_entry_threshold| bytes go to
+  // slab files, like the "Slabs" group of the SimpleCacheSlabs field trial
+  // does. Must be called before Init().
+  void set_slab_entry_threshold(int slab_entry_threshold) {
+    slab_entry_threshold_ = slab_entry_threshold;
+  }
+
+  // Returns the codec that entries compress stream 1 with when they close.
+  SimpleCompressionCodec compression_codec() const {
+    return compression_codec_;
+  }
+
+  // Makes entries compress stream 1 with |compression_codec|, like the
+  // "Deflate" group of the SimpleCacheCompression field trial does. Must be
+  // called before Init().
+  void set_compression_codec(SimpleCompressionCodec compression_codec) {
+    compression_codec_ = compression_codec;
+  }
+
   int Init(const CompletionCallback& completion_callback);
 
   // Sets the maximum size for the total amount of data stored by this instance.
@@ -86,6 +120,8 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   // SimpleIndexDelegate:
   void DoomEntries(std::vector<uint64>* entry_hashes,
                    const CompletionCallback& callback) override;
+  void ReleaseSlabRecord(uint64 entry_hash,
+                         const SimpleSlabAddress& slab_address) override;
 
   // Backend:
   net::CacheType GetCacheType() const override;
@@ -125,6 +161,7 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   struct DiskStatResult {
     base::Time cache_dir_mtime;
     uint64 max_size;
+    bool has_slabs;
     bool detected_magic_number_mismatch;
     int net_error;
   };
@@ -139,6 +176,23 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
                          const CompletionCallback& callback,
                          int result);
 
+  // Runs |operation| with |callback| unless the backend is gone. Invoked when
+  // the index is ready.
+  void IndexReadyForOperation(
+      const base::Callback<int(const CompletionCallback&)>& operation,
+      const CompletionCallback& callback,
+      int result);
+
+  // Starts compacting the slab files on the worker pool unless that is
+  // already underway or not needed.
+  void MaybeCompactSlabs();
+
+  // Points the index at the records that a compaction copied, and deletes the
+  // compacted slab.
+  void SlabCompactionComplete(
+      const std::vector<SimpleSlabStore::Move>* moves,
+      const uint32* slab_number);
+
   // Try to create the directory if it doesn't exist. This must run on the IO
   // thread.
   static DiskStatResult InitCacheStructureOnDisk(const base::FilePath& path,
@@ -192,6 +246,17 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   scoped_ptr<SimpleIndex> index_;
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   scoped_refptr<base::TaskRunner> worker_pool_;
+  bool use_io_ring_;
+  SimpleIORing* io_ring_;
+  int slab_entry_threshold_;
+  scoped_refptr<SimpleSlabStore> slab_store_;
+  SimpleCompressionCodec compression_codec_;
+
+  // True if entries can only be opened once the index is ready, since only
+  // the index knows which entries are in slab files.
+  bool open_waits_for_index_;
+
+  bool compacting_slabs_;
 
   int orig_max_size_;
   const SimpleEntryImpl::OperationsMode entry_operations_mode_;
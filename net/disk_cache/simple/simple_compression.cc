@@ -0,0 +1,109 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_compression.h"
+
+#include <cstring>
+
+#include "base/logging.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The largest window, which compresses best; a block is no larger anyway.
+const int kDeflateWindowBits = 15;
+const int kDeflateMemLevel = 8;
+
+}  // namespace
+
+uint32 GetEOFFlagsForCompressionCodec(SimpleCompressionCodec codec) {
+  switch (codec) {
+    case SIMPLE_COMPRESSION_NONE:
+      return 0;
+    case SIMPLE_COMPRESSION_DEFLATE:
+      return SimpleFileEOF::FLAG_COMPRESSED_DEFLATE;
+  }
+  NOTREACHED();
+  return 0;
+}
+
+SimpleCompressionCodec GetCompressionCodecFromEOFFlags(uint32 flags) {
+  if (flags & SimpleFileEOF::FLAG_COMPRESSED_DEFLATE)
+    return SIMPLE_COMPRESSION_DEFLATE;
+  return SIMPLE_COMPRESSION_NONE;
+}
+
+SimpleBlockCodec::SimpleBlockCodec(SimpleCompressionCodec codec)
+    : codec_(codec) {
+  DCHECK_EQ(SIMPLE_COMPRESSION_DEFLATE, codec_);
+}
+
+SimpleBlockCodec::~SimpleBlockCodec() {
+  if (deflate_stream_)
+    deflateEnd(deflate_stream_.get());
+  if (inflate_stream_)
+    inflateEnd(inflate_stream_.get());
+}
+
+bool SimpleBlockCodec::Compress(const char* data, int size, std::string* out) {
+  // Only output that is smaller than the input is of use.
+  if (size <= 1)
+    return false;
+  if (!deflate_stream_) {
+    deflate_stream_.reset(new z_stream);
+    memset(deflate_stream_.get(), 0, sizeof(*deflate_stream_));
+    int result = deflateInit2(deflate_stream_.get(), Z_DEFAULT_COMPRESSION,
+                              Z_DEFLATED,
+                              -kDeflateWindowBits,  // Raw deflate.
+                              kDeflateMemLevel, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK) {
+      deflateEnd(deflate_stream_.get());
+      deflate_stream_.reset();
+      return false;
+    }
+  } else if (deflateReset(deflate_stream_.get()) != Z_OK) {
+    return false;
+  }
+
+  out->resize(size - 1);
+  z_stream* stream = deflate_stream_.get();
+  stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream->avail_in = size;
+  stream->next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  stream->avail_out = out->size();
+  // Anything but the end of the stream means that the output did not fit.
+  if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+    return false;
+  out->resize(out->size() - stream->avail_out);
+  return true;
+}
+
+bool SimpleBlockCodec::Uncompress(const char* data,
+                                  int size,
+                                  char* out,
+                                  int out_size) {
+  if (!inflate_stream_) {
+    inflate_stream_.reset(new z_stream);
+    memset(inflate_stream_.get(), 0, sizeof(*inflate_stream_));
+    if (inflateInit2(inflate_stream_.get(), -kDeflateWindowBits) != Z_OK) {
+      inflateEnd(inflate_stream_.get());
+      inflate_stream_.reset();
+      return false;
+    }
+  } else if (inflateReset(inflate_stream_.get()) != Z_OK) {
+    return false;
+  }
+
+  z_stream* stream = inflate_stream_.get();
+  stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream->avail_in = size;
+  stream->next_out = reinterpret_cast<Bytef*>(out);
+  stream->avail_out = out_size;
+  return inflate(stream, Z_FINISH) == Z_STREAM_END && stream->avail_out == 0;
+}
+
+}  // namespace disk_cache
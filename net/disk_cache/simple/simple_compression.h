@@ -0,0 +1,60 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_COMPRESSION_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_COMPRESSION_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/net_export.h"
+
+extern "C" struct z_stream_s;
+
+namespace disk_cache {
+
+// The codecs that stream 1 of an entry can be compressed with.
+enum SimpleCompressionCodec {
+  SIMPLE_COMPRESSION_NONE,
+  // Raw deflate, as zlib does it.
+  SIMPLE_COMPRESSION_DEFLATE,
+};
+
+// Returns the flags of the EOF record of a stream compressed with |codec|.
+NET_EXPORT_PRIVATE uint32
+GetEOFFlagsForCompressionCodec(SimpleCompressionCodec codec);
+
+// Returns the codec that the EOF record with |flags| says its stream is
+// compressed with.
+NET_EXPORT_PRIVATE SimpleCompressionCodec
+GetCompressionCodecFromEOFFlags(uint32 flags);
+
+// Compresses and uncompresses blocks of stream data, each on its own, so that
+// any block can be read without the ones before it. The state of the codec is
+// kept from one block to the next, so that it is only set up once.
+class NET_EXPORT_PRIVATE SimpleBlockCodec {
+ public:
+  explicit SimpleBlockCodec(SimpleCompressionCodec codec);
+  ~SimpleBlockCodec();
+
+  // Compresses the |size| bytes at |data| into |out|. Returns false if that
+  // does not make them smaller.
+  bool Compress(const char* data, int size, std::string* out);
+
+  // Uncompresses the |size| bytes at |data| into the |out_size| bytes at
+  // |out|. Returns false unless they make exactly |out_size| bytes.
+  bool Uncompress(const char* data, int size, char* out, int out_size);
+
+ private:
+  const SimpleCompressionCodec codec_;
+  scoped_ptr<z_stream_s> deflate_stream_;
+  scoped_ptr<z_stream_s> inflate_stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleBlockCodec);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_COMPRESSION_H_
@@ -0,0 +1,101 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_compression.h"
+
+#include <string>
+
+#include "base/rand_util.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+std::string GetCompressibleData(int size) {
+  std::string data;
+  while (static_cast<int>(data.size()) < size)
+    data += "<div class=\"item\">some text that repeats</div>\n";
+  data.resize(size);
+  return data;
+}
+
+}  // namespace
+
+TEST(SimpleCompressionTest, EOFFlags) {
+  EXPECT_EQ(0u, GetEOFFlagsForCompressionCodec(SIMPLE_COMPRESSION_NONE));
+  const uint32 flags =
+      SimpleFileEOF::FLAG_HAS_CRC32 |
+      GetEOFFlagsForCompressionCodec(SIMPLE_COMPRESSION_DEFLATE);
+  EXPECT_EQ(SIMPLE_COMPRESSION_DEFLATE, GetCompressionCodecFromEOFFlags(flags));
+  EXPECT_EQ(SIMPLE_COMPRESSION_NONE,
+            GetCompressionCodecFromEOFFlags(SimpleFileEOF::FLAG_HAS_CRC32));
+}
+
+TEST(SimpleCompressionTest, RoundTrip) {
+  SimpleBlockCodec codec(SIMPLE_COMPRESSION_DEFLATE);
+  const std::string data = GetCompressibleData(kSimpleCompressionBlockSize);
+  std::string compressed;
+  ASSERT_TRUE(codec.Compress(data.data(), data.size(), &compressed));
+  EXPECT_GT(data.size() / 4, compressed.size());
+
+  std::string uncompressed(data.size(), '\0');
+  ASSERT_TRUE(codec.Uncompress(compressed.data(), compressed.size(),
+                               &uncompressed[0], uncompressed.size()));
+  EXPECT_EQ(data, uncompressed);
+}
+
+// The state of the codec does not carry over from a block to the next one.
+TEST(SimpleCompressionTest, IndependentBlocks) {
+  SimpleBlockCodec codec(SIMPLE_COMPRESSION_DEFLATE);
+  const std::string data1 = GetCompressibleData(5000);
+  const std::string data2 = GetCompressibleData(7000);
+  std::string compressed1;
+  std::string compressed2;
+  ASSERT_TRUE(codec.Compress(data1.data(), data1.size(), &compressed1));
+  ASSERT_TRUE(codec.Compress(data2.data(), data2.size(), &compressed2));
+
+  SimpleBlockCodec other_codec(SIMPLE_COMPRESSION_DEFLATE);
+  std::string uncompressed2(data2.size(), '\0');
+  ASSERT_TRUE(other_codec.Uncompress(compressed2.data(), compressed2.size(),
+                                     &uncompressed2[0], uncompressed2.size()));
+  EXPECT_EQ(data2, uncompressed2);
+  std::string uncompressed1(data1.size(), '\0');
+  ASSERT_TRUE(other_codec.Uncompress(compressed1.data(), compressed1.size(),
+                                     &uncompressed1[0], uncompressed1.size()));
+  EXPECT_EQ(data1, uncompressed1);
+}
+
+TEST(SimpleCompressionTest, Incompressible) {
+  SimpleBlockCodec codec(SIMPLE_COMPRESSION_DEFLATE);
+  const std::string data = base::RandBytesAsString(4096);
+  std::string compressed;
+  EXPECT_FALSE(codec.Compress(data.data(), data.size(), &compressed));
+  EXPECT_FALSE(codec.Compress(data.data(), 1, &compressed));
+
+  // The codec is still of use after that.
+  const std::string compressible_data = GetCompressibleData(4096);
+  EXPECT_TRUE(codec.Compress(compressible_data.data(),
+                             compressible_data.size(), &compressed));
+}
+
+TEST(SimpleCompressionTest, UncompressWrongSize) {
+  SimpleBlockCodec codec(SIMPLE_COMPRESSION_DEFLATE);
+  const std::string data = GetCompressibleData(4096);
+  std::string compressed;
+  ASSERT_TRUE(codec.Compress(data.data(), data.size(), &compressed));
+
+  std::string uncompressed(data.size() + 1, '\0');
+  EXPECT_FALSE(codec.Uncompress(compressed.data(), compressed.size(),
+                                &uncompressed[0], data.size() - 1));
+  EXPECT_FALSE(codec.Uncompress(compressed.data(), compressed.size(),
+                                &uncompressed[0], data.size() + 1));
+  EXPECT_FALSE(codec.Uncompress(compressed.data(), compressed.size() / 2,
+                                &uncompressed[0], data.size()));
+  EXPECT_TRUE(codec.Uncompress(compressed.data(), compressed.size(),
+                               &uncompressed[0], data.size()));
+}
+
+}  // namespace disk_cache
@@ -18,6 +18,11 @@ SimpleFileEOF::SimpleFileEOF() {
   std::memset(this, 0, sizeof(*this));
 }
 
+SimpleSlabRecordHeader::SimpleSlabRecordHeader() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
 SimpleFileSparseRangeHeader::SimpleFileSparseRangeHeader() {
   // Make hashing repeatable: leave no padding bytes untouched.
   std::memset(this, 0, sizeof(*this));
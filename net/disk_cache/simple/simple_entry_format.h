@@ -19,6 +19,9 @@ namespace disk_cache {
 const uint64 kSimpleInitialMagicNumber = GG_UINT64_C(0xfcfb6d1ba7725c30);
 const uint64 kSimpleFinalMagicNumber = GG_UINT64_C(0xf4fa6f45970d41d8);
 const uint64 kSimpleSparseRangeMagicNumber = GG_UINT64_C(0xeb97bf016553676b);
+const uint64 kSimpleSlabRecordMagicNumber = GG_UINT64_C(0xd3a1c5e8204b79f6);
+const uint64 kSimpleSlabKilledRecordMagicNumber =
+    GG_UINT64_C(0x9e6c02f7d15a48b3);
 
 // A file containing stream 0 and stream 1 in the Simple cache consists of:
 //   - a SimpleFileHeader.
@@ -28,13 +31,28 @@ const uint64 kSimpleSparseRangeMagicNumber = GG_UINT64_C(0xeb97bf016553676b);
 //   - the data from stream 0.
 //   - a SimpleFileEOF record for stream 0.
 
+// Stream 1 can be compressed, which the flags of its SimpleFileEOF record say.
+// Its data is then cut into blocks of kSimpleCompressionBlockSize bytes, the
+// last one possibly shorter, and in the place of the data, there are:
+//   - each block, compressed on its own, or as is if that is not smaller.
+//   - the offset of the end of each block from the end of the key, as uint32s.
+// The EOF record keeps the size and the crc32 of the uncompressed data.
+
 // A file containing stream 2 in the Simple cache consists of:
 //   - a SimpleFileHeader.
 //   - the key.
 //   - the data.
 //   - at the end, a SimpleFileEOF record.
+
+// A slab file in the Simple cache holds small entries one after the other, as
+// records that each consist of:
+//   - a SimpleSlabRecordHeader.
+//   - the contents the entry files would have, in file index order.
+//   - padding up to a multiple of 8 bytes.
+// A record that is no longer used has kSimpleSlabKilledRecordMagicNumber.
 static const int kSimpleEntryFileCount = 2;
 static const int kSimpleEntryStreamCount = 3;
+static const int kSimpleCompressionBlockSize = 16 * 1024;
 
 struct NET_EXPORT_PRIVATE SimpleFileHeader {
   SimpleFileHeader();
@@ -48,6 +66,7 @@ struct NET_EXPORT_PRIVATE SimpleFileHeader {
 struct NET_EXPORT_PRIVATE SimpleFileEOF {
   enum Flags {
     FLAG_HAS_CRC32 = (1U << 0),
+    FLAG_COMPRESSED_DEFLATE = (1U << 1),
   };
 
   SimpleFileEOF();
@@ -55,10 +74,24 @@ struct NET_EXPORT_PRIVATE SimpleFileEOF {
   uint64 final_magic_number;
   uint32 flags;
   uint32 data_crc32;
-  // |stream_size| is only used in the EOF record for stream 0.
+  // |stream_size| is only used in the EOF record for stream 0, and in that for
+  // stream 1 if it is compressed.
   uint32 stream_size;
 };
 
+struct NET_EXPORT_PRIVATE SimpleSlabRecordHeader {
+  SimpleSlabRecordHeader();
+
+  uint64 magic_number;
+  uint64 entry_hash;
+  // Orders the records of an entry; the highest one is the current one.
+  uint64 sequence;
+  int64 last_modified;
+  // A size of 0 means that the file is omitted.
+  uint32 file_size[kSimpleEntryFileCount];
+  uint32 data_crc32;
+};
+
 struct SimpleFileSparseRangeHeader {
   SimpleFileSparseRangeHeader();
 
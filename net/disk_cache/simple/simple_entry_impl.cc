@@ -172,12 +172,16 @@ SimpleEntryImpl::SimpleEntryImpl(net::CacheType cache_type,
     : backend_(backend->AsWeakPtr()),
       cache_type_(cache_type),
       worker_pool_(backend->worker_pool()),
+      io_ring_(backend->io_ring()),
+      slab_store_(backend->slab_store()),
+      compression_codec_(backend->compression_codec()),
       path_(path),
       entry_hash_(entry_hash),
       use_optimistic_operations_(operations_mode == OPTIMISTIC_OPERATIONS),
       last_used_(Time::Now()),
       last_modified_(last_used_),
       sparse_data_size_(0),
+      compressed_stream_1_size_(0),
       open_count_(0),
       doomed_(false),
       state_(STATE_UNINITIALIZED),
@@ -210,7 +214,7 @@ int SimpleEntryImpl::OpenEntry(Entry** out_entry,
 
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_CALL);
 
-  bool have_index = backend_->index()->initialized();
+  bool have_index = backend_->index()->lookups_ready();
   // This enumeration is used in histograms, add entries only at end.
   enum OpenEntryIndexEnum {
     INDEX_NOEXIST = 0,
@@ -554,6 +558,7 @@ void SimpleEntryImpl::MakeUninitialized() {
   std::memset(crc32s_, 0, sizeof(crc32s_));
   std::memset(have_written_, 0, sizeof(have_written_));
   std::memset(data_size_, 0, sizeof(data_size_));
+  compressed_stream_1_size_ = 0;
   for (size_t i = 0; i < arraysize(crc_check_state_); ++i) {
     crc_check_state_[i] = CRC_CHECK_NEVER_READ_AT_ALL;
   }
@@ -686,11 +691,16 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
       new SimpleEntryCreationResults(
           SimpleEntryStat(last_used_, last_modified_, data_size_,
                           sparse_data_size_)));
+  slab_address_ = backend_.get()
+                      ? backend_->index()->GetSlabAddress(entry_hash_)
+                      : SimpleSlabAddress();
   Closure task = base::Bind(&SimpleSynchronousEntry::OpenEntry,
                             cache_type_,
                             path_,
                             entry_hash_,
                             have_index,
+                            slab_store_,
+                            slab_address_,
                             results.get());
   Closure reply = base::Bind(&SimpleEntryImpl::CreationOperationComplete,
                              this,
@@ -735,12 +745,17 @@ void SimpleEntryImpl::CreateEntryInternal(bool have_index,
       new SimpleEntryCreationResults(
           SimpleEntryStat(last_used_, last_modified_, data_size_,
                           sparse_data_size_)));
+  slab_address_ = backend_.get()
+                      ? backend_->index()->GetSlabAddress(entry_hash_)
+                      : SimpleSlabAddress();
   Closure task = base::Bind(&SimpleSynchronousEntry::CreateEntry,
                             cache_type_,
                             path_,
                             key_,
                             entry_hash_,
                             have_index,
+                            slab_store_,
+                            slab_address_,
                             results.get());
   Closure reply = base::Bind(&SimpleEntryImpl::CreationOperationComplete,
                              this,
@@ -778,14 +793,20 @@ void SimpleEntryImpl::CloseInternal() {
   }
 
   if (synchronous_entry_) {
+    scoped_ptr<SimpleEntryCloseResults> results(new SimpleEntryCloseResults());
     Closure task =
         base::Bind(&SimpleSynchronousEntry::Close,
                    base::Unretained(synchronous_entry_),
                    SimpleEntryStat(last_used_, last_modified_, data_size_,
                                    sparse_data_size_),
                    base::Passed(&crc32s_to_write),
-                   stream_0_data_);
-    Closure reply = base::Bind(&SimpleEntryImpl::CloseOperationComplete, this);
+                   stream_0_data_,
+                   doomed_,
+                   compression_codec_,
+                   results.get());
+    Closure reply = base::Bind(&SimpleEntryImpl::CloseOperationComplete,
+                               this,
+                               base::Passed(&results));
     synchronous_entry_ = NULL;
     worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
 
@@ -797,7 +818,7 @@ void SimpleEntryImpl::CloseInternal() {
       }
     }
   } else {
-    CloseOperationComplete();
+    CloseOperationComplete(scoped_ptr<SimpleEntryCloseResults>());
   }
 }
 
@@ -864,14 +885,11 @@ void SimpleEntryImpl::ReadDataInternal(int stream_index,
   scoped_ptr<SimpleEntryStat> entry_stat(
       new SimpleEntryStat(last_used_, last_modified_, data_size_,
                           sparse_data_size_));
-  Closure task = base::Bind(
-      &SimpleSynchronousEntry::ReadData,
-      base::Unretained(synchronous_entry_),
-      SimpleSynchronousEntry::EntryOperationData(stream_index, offset, buf_len),
-      make_scoped_refptr(buf),
-      read_crc32.get(),
-      entry_stat.get(),
-      result.get());
+  SimpleSynchronousEntry::EntryOperationData entry_op(
+      stream_index, offset, buf_len);
+  uint32* out_crc32 = read_crc32.get();
+  SimpleEntryStat* out_entry_stat = entry_stat.get();
+  int* out_result = result.get();
   Closure reply = base::Bind(&SimpleEntryImpl::ReadOperationComplete,
                              this,
                              stream_index,
@@ -880,6 +898,19 @@ void SimpleEntryImpl::ReadDataInternal(int stream_index,
                              base::Passed(&read_crc32),
                              base::Passed(&entry_stat),
                              base::Passed(&result));
+  if (io_ring_) {
+    synchronous_entry_->ReadDataOnRing(io_ring_, worker_pool_.get(), entry_op,
+                                       buf, out_crc32, out_entry_stat,
+                                       out_result, reply);
+    return;
+  }
+  Closure task = base::Bind(&SimpleSynchronousEntry::ReadData,
+                            base::Unretained(synchronous_entry_),
+                            entry_op,
+                            make_scoped_refptr(buf),
+                            out_crc32,
+                            out_entry_stat,
+                            out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
 }
 
@@ -961,25 +992,35 @@ void SimpleEntryImpl::WriteDataInternal(int stream_index,
 
   have_written_[stream_index] = true;
   // Writing on stream 1 affects the placement of stream 0 in the file, the EOF
-  // record will have to be rewritten.
-  if (stream_index == 1)
+  // record will have to be rewritten. The write also uncompresses the stream.
+  if (stream_index == 1) {
     have_written_[0] = true;
+    compressed_stream_1_size_ = 0;
+  }
 
   scoped_ptr<int> result(new int());
-  Closure task = base::Bind(&SimpleSynchronousEntry::WriteData,
-                            base::Unretained(synchronous_entry_),
-                            SimpleSynchronousEntry::EntryOperationData(
-                                stream_index, offset, buf_len, truncate,
-                                doomed_),
-                            make_scoped_refptr(buf),
-                            entry_stat.get(),
-                            result.get());
+  SimpleSynchronousEntry::EntryOperationData entry_op(
+      stream_index, offset, buf_len, truncate, doomed_);
+  SimpleEntryStat* out_entry_stat = entry_stat.get();
+  int* out_result = result.get();
   Closure reply = base::Bind(&SimpleEntryImpl::WriteOperationComplete,
                              this,
                              stream_index,
                              callback,
                              base::Passed(&entry_stat),
                              base::Passed(&result));
+  if (io_ring_) {
+    synchronous_entry_->WriteDataOnRing(io_ring_, worker_pool_.get(), entry_op,
+                                        buf, out_entry_stat, out_result,
+                                        reply);
+    return;
+  }
+  Closure task = base::Bind(&SimpleSynchronousEntry::WriteData,
+                            base::Unretained(synchronous_entry_),
+                            entry_op,
+                            make_scoped_refptr(buf),
+                            out_entry_stat,
+                            out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
 }
 
@@ -1130,6 +1171,7 @@ void SimpleEntryImpl::CreationOperationComplete(
     // the open case is handled in SimpleBackendImpl.
     DCHECK_EQ(key_, synchronous_entry_->key());
   }
+  compressed_stream_1_size_ = synchronous_entry_->compressed_stream_1_size();
   UpdateDataFromEntryStat(in_results->entry_stat);
   SIMPLE_CACHE_UMA(TIMES,
                    "EntryCreationTime", cache_type_,
@@ -1344,11 +1386,33 @@ void SimpleEntryImpl::ChecksumOperationComplete(
   EntryOperationComplete(completion_callback, entry_stat, result.Pass());
 }
 
-void SimpleEntryImpl::CloseOperationComplete() {
+void SimpleEntryImpl::CloseOperationComplete(
+    scoped_ptr<SimpleEntryCloseResults> results) {
   DCHECK(!synchronous_entry_);
   DCHECK_EQ(0, open_count_);
   DCHECK(STATE_IO_PENDING == state_ || STATE_FAILURE == state_ ||
          STATE_UNINITIALIZED == state_);
+  // An unchanged entry stays where the index has it, which can be a copy made
+  // by a compaction of the slab that the entry was opened from.
+  if (results && results->slab_address != slab_address_) {
+    if (doomed_ || !backend_.get() ||
+        !backend_->index()->SetSlabAddress(entry_hash_,
+                                           results->slab_address)) {
+      if (results->slab_address.is_valid()) {
+        worker_pool_->PostTask(
+            FROM_HERE, base::Bind(&SimpleSlabStore::Kill, slab_store_,
+                                  results->slab_address, entry_hash_));
+      }
+    }
+  }
+  // The index counts what the entry takes on disk, so that compressing
+  // stream 1 makes room for more entries.
+  if (results &&
+      results->compressed_stream_1_size != compressed_stream_1_size_) {
+    compressed_stream_1_size_ = results->compressed_stream_1_size;
+    if (!doomed_ && backend_.get())
+      backend_->index()->UpdateEntrySize(entry_hash_, GetDiskUsage());
+  }
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_CLOSE_END);
   AdjustOpenEntryCountBy(cache_type_, -1);
   MakeUninitialized();
@@ -1374,8 +1438,10 @@ void SimpleEntryImpl::UpdateDataFromEntryStat(
 int64 SimpleEntryImpl::GetDiskUsage() const {
   int64 file_size = 0;
   for (int i = 0; i < kSimpleEntryStreamCount; ++i) {
-    file_size +=
-        simple_util::GetFileSizeFromKeyAndDataSize(key_, data_size_[i]);
+    const int32 size = i == 1 && compressed_stream_1_size_
+                           ? compressed_stream_1_size_
+                           : data_size_[i];
+    file_size += simple_util::GetFileSizeFromKeyAndDataSize(key_, size);
   }
   file_size += sparse_data_size_;
   return file_size;
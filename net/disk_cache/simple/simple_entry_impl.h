@@ -15,8 +15,10 @@
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_compression.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_operation.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
 #include "net/log/net_log.h"
 
 namespace base {
@@ -31,8 +33,10 @@ class IOBuffer;
 namespace disk_cache {
 
 class SimpleBackendImpl;
+class SimpleIORing;
 class SimpleSynchronousEntry;
 class SimpleEntryStat;
+struct SimpleEntryCloseResults;
 struct SimpleEntryCreationResults;
 
 // SimpleEntryImpl is the IO thread interface to an entry in the very simple
@@ -223,8 +227,9 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
 
   // Called after we've closed and written the EOF record to our entry. Until
   // this point it hasn't been safe to OpenEntry() the same entry, but from this
-  // point it is.
-  void CloseOperationComplete();
+  // point it is. |results| say where the closed entry is stored in the slab
+  // store, and how large its compressed stream 1 is, if the close got that far.
+  void CloseOperationComplete(scoped_ptr<SimpleEntryCloseResults> results);
 
   // Internal utility method used by other completion methods. Calls
   // |completion_callback| after updating state and dooming on errors.
@@ -311,6 +316,11 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   const base::WeakPtr<SimpleBackendImpl> backend_;
   const net::CacheType cache_type_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
+  // If not NULL, stream reads and writes go through this ring rather than
+  // |worker_pool_|.
+  SimpleIORing* const io_ring_;
+  const scoped_refptr<SimpleSlabStore> slab_store_;
+  const SimpleCompressionCodec compression_codec_;
   const base::FilePath path_;
   const uint64 entry_hash_;
   const bool use_optimistic_operations_;
@@ -324,6 +334,10 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   int32 data_size_[kSimpleEntryStreamCount];
   int32 sparse_data_size_;
 
+  // The size that stream 1 takes on disk if it is compressed, or 0. Its data
+  // is stored as it is again once it is written.
+  int32 compressed_stream_1_size_;
+
   // Number of times this object has been returned from Backend::OpenEntry() and
   // Backend::CreateEntry() without subsequent Entry::Close() calls. Used to
   // notify the backend when this entry not used by any callers.
@@ -356,6 +370,9 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   // would leak the SimpleSynchronousEntry.
   SimpleSynchronousEntry* synchronous_entry_;
 
+  // The slab record that the entry was last opened from, if any.
+  SimpleSlabAddress slab_address_;
+
   std::queue<SimpleEntryOperation> pending_operations_;
 
   net::BoundNetLog net_log_;
@@ -0,0 +1,264 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/time/time.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Multipliers that spread an entry hash over the rows of the sketch; odd, so
+// that every one of them is a bijection on 64 bits.
+const uint64 kRowSeeds[] = {
+    0x9e3779b97f4a7c15ULL,
+    0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL,
+    0xd6e8feb86659fd93ULL,
+};
+
+// The sketch is halved after this many increments per counter in a row.
+const size_t kSampleSizeMultiplier = 10;
+
+const size_t kInitialSketchCapacity = 1024;
+
+// The most recently used entries that take up to this share of the cache are
+// evicted last by TinyLFU.
+const uint64 kWindowDivisor = 100;
+
+int GetNibble(const std::vector<uint8>& table, size_t index) {
+  return (table[index / 2] >> ((index % 2) * 4)) & 0xf;
+}
+
+struct Candidate {
+  uint64 entry_hash;
+  base::Time last_used_time;
+  uint64 entry_size;
+  int frequency;
+};
+
+bool CompareCandidatesForLastUsed(const Candidate& a, const Candidate& b) {
+  return a.last_used_time < b.last_used_time;
+}
+
+bool CompareCandidatesForMostRecentlyUsed(const Candidate& a,
+                                          const Candidate& b) {
+  return a.last_used_time > b.last_used_time;
+}
+
+bool CompareCandidatesForFrequency(const Candidate& a, const Candidate& b) {
+  if (a.frequency != b.frequency)
+    return a.frequency < b.frequency;
+  return a.last_used_time < b.last_used_time;
+}
+
+void GetCandidates(const SimpleIndex::EntrySet& entries,
+                   std::vector<Candidate>* out_candidates) {
+  out_candidates->reserve(entries.size());
+  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    Candidate candidate;
+    candidate.entry_hash = it->first;
+    candidate.last_used_time = it->second.GetLastUsedTime();
+    candidate.entry_size = it->second.GetEntrySize();
+    candidate.frequency = 0;
+    out_candidates->push_back(candidate);
+  }
+}
+
+// Adds the candidates in [|begin|, |end|) to |out_entry_hashes| until
+// |*evicted_so_far_size| reaches |bytes_to_evict|.
+template <typename Iterator>
+void AddEntriesToEvict(Iterator begin,
+                       Iterator end,
+                       uint64 bytes_to_evict,
+                       uint64* evicted_so_far_size,
+                       std::vector<uint64>* out_entry_hashes) {
+  for (Iterator it = begin;
+       it != end && *evicted_so_far_size < bytes_to_evict; ++it) {
+    out_entry_hashes->push_back(it->entry_hash);
+    *evicted_so_far_size += it->entry_size;
+  }
+}
+
+class LRUEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  LRUEvictionPolicy() {}
+  ~LRUEvictionPolicy() override {}
+
+  void OnUse(uint64 entry_hash) override {}
+
+  void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                            uint64 bytes_to_evict,
+                            std::vector<uint64>* out_entry_hashes) override {
+    std::vector<Candidate> candidates;
+    GetCandidates(entries, &candidates);
+    std::sort(candidates.begin(), candidates.end(),
+              CompareCandidatesForLastUsed);
+    uint64 evicted_so_far_size = 0;
+    AddEntriesToEvict(candidates.begin(), candidates.end(), bytes_to_evict,
+                      &evicted_so_far_size, out_entry_hashes);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LRUEvictionPolicy);
+};
+
+// Admission in TinyLFU compares the frequency of each new entry with that of
+// the entry it would replace. The index evicts in batches instead, so here
+// the entries that left the window of the most recently used ones all
+// compete at once: the least frequently used go first, and the least
+// recently used among those that are used as often.
+class TinyLFUEvictionPolicy : public SimpleEvictionPolicy {
+ public:
+  TinyLFUEvictionPolicy() : sketch_(kInitialSketchCapacity) {}
+  ~TinyLFUEvictionPolicy() override {}
+
+  void OnUse(uint64 entry_hash) override { sketch_.Increment(entry_hash); }
+
+  void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                            uint64 bytes_to_evict,
+                            std::vector<uint64>* out_entry_hashes) override {
+    sketch_.EnsureCapacity(entries.size());
+
+    std::vector<Candidate> candidates;
+    GetCandidates(entries, &candidates);
+    std::sort(candidates.begin(), candidates.end(),
+              CompareCandidatesForMostRecentlyUsed);
+
+    uint64 total_size = 0;
+    for (size_t i = 0; i < candidates.size(); ++i)
+      total_size += candidates[i].entry_size;
+    const uint64 window_size = total_size / kWindowDivisor;
+    std::vector<Candidate>::iterator window_end = candidates.begin();
+    uint64 window_so_far_size = 0;
+    while (window_end != candidates.end() &&
+           window_so_far_size + window_end->entry_size <= window_size) {
+      window_so_far_size += window_end->entry_size;
+      ++window_end;
+    }
+
+    for (std::vector<Candidate>::iterator it = window_end;
+         it != candidates.end(); ++it) {
+      it->frequency = sketch_.GetFrequency(it->entry_hash);
+    }
+    std::sort(window_end, candidates.end(), CompareCandidatesForFrequency);
+
+    uint64 evicted_so_far_size = 0;
+    AddEntriesToEvict(window_end, candidates.end(), bytes_to_evict,
+                      &evicted_so_far_size, out_entry_hashes);
+    AddEntriesToEvict(std::vector<Candidate>::reverse_iterator(window_end),
+                      candidates.rend(), bytes_to_evict, &evicted_so_far_size,
+                      out_entry_hashes);
+  }
+
+ private:
+  SimpleFrequencySketch sketch_;
+
+  DISALLOW_COPY_AND_ASSIGN(TinyLFUEvictionPolicy);
+};
+
+}  // namespace
+
+const int SimpleFrequencySketch::kMaxFrequency;
+const int SimpleFrequencySketch::kDepth;
+
+SimpleFrequencySketch::SimpleFrequencySketch(size_t capacity)
+    : width_bits_(1), increments_(0) {
+  while (this->capacity() < capacity)
+    ++width_bits_;
+  table_.resize(kDepth * this->capacity() / 2);
+}
+
+SimpleFrequencySketch::~SimpleFrequencySketch() {
+}
+
+void SimpleFrequencySketch::Increment(uint64 entry_hash) {
+  // Only the smallest counters are incremented, which keeps the estimates of
+  // the other entries that share the larger ones from growing.
+  const int frequency = GetFrequency(entry_hash);
+  if (frequency < kMaxFrequency) {
+    for (int row = 0; row < kDepth; ++row) {
+      const size_t index = GetCounterIndex(entry_hash, row);
+      if (GetCounter(index) == frequency)
+        SetCounter(index, frequency + 1);
+    }
+  }
+  if (++increments_ >= kSampleSizeMultiplier * capacity())
+    Age();
+}
+
+int SimpleFrequencySketch::GetFrequency(uint64 entry_hash) const {
+  int frequency = kMaxFrequency;
+  for (int row = 0; row < kDepth; ++row) {
+    frequency =
+        std::min(frequency, GetCounter(GetCounterIndex(entry_hash, row)));
+  }
+  return frequency;
+}
+
+void SimpleFrequencySketch::EnsureCapacity(size_t capacity) {
+  int width_bits = width_bits_;
+  while ((static_cast<size_t>(1) << width_bits) < capacity)
+    ++width_bits;
+  if (width_bits == width_bits_)
+    return;
+
+  // The counters of a row are indexed by the top bits of the spread hash, so
+  // each old counter is split into the counters of the same prefix. They all
+  // start with its count, which stays an overestimate.
+  const int shift = width_bits - width_bits_;
+  const size_t old_width = this->capacity();
+  std::vector<uint8> old_table;
+  old_table.swap(table_);
+  width_bits_ = width_bits;
+  table_.resize(kDepth * this->capacity() / 2);
+  for (int row = 0; row < kDepth; ++row) {
+    for (size_t i = 0; i < this->capacity(); ++i) {
+      SetCounter(row * this->capacity() + i,
+                 GetNibble(old_table, row * old_width + (i >> shift)));
+    }
+  }
+}
+
+size_t SimpleFrequencySketch::GetCounterIndex(uint64 entry_hash,
+                                              int row) const {
+  DCHECK_LT(static_cast<size_t>(row), arraysize(kRowSeeds));
+  const uint64 spread_hash = entry_hash * kRowSeeds[row];
+  return row * capacity() +
+         static_cast<size_t>(spread_hash >> (64 - width_bits_));
+}
+
+int SimpleFrequencySketch::GetCounter(size_t index) const {
+  return GetNibble(table_, index);
+}
+
+void SimpleFrequencySketch::SetCounter(size_t index, int value) {
+  DCHECK_LE(value, kMaxFrequency);
+  const int shift = (index % 2) * 4;
+  uint8& byte = table_[index / 2];
+  byte = (byte & ~(0xf << shift)) | (value << shift);
+}
+
+void SimpleFrequencySketch::Age() {
+  for (size_t i = 0; i < table_.size(); ++i)
+    table_[i] = (table_[i] >> 1) & 0x77;
+  increments_ /= 2;
+}
+
+// static
+scoped_ptr<SimpleEvictionPolicy> SimpleEvictionPolicy::CreateLRU() {
+  return scoped_ptr<SimpleEvictionPolicy>(new LRUEvictionPolicy());
+}
+
+// static
+scoped_ptr<SimpleEvictionPolicy> SimpleEvictionPolicy::CreateTinyLFU() {
+  return scoped_ptr<SimpleEvictionPolicy>(new TinyLFUEvictionPolicy());
+}
+
+}  // namespace disk_cache
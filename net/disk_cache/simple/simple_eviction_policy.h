@@ -0,0 +1,83 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace disk_cache {
+
+// Estimates how often each entry hash was used recently, in a count-min
+// sketch of 4-bit counters that takes two bytes per entry of capacity. Counts
+// are halved after ten uses per entry of capacity, so that entries that
+// stopped being used are forgotten.
+class NET_EXPORT_PRIVATE SimpleFrequencySketch {
+ public:
+  // The largest estimate.
+  static const int kMaxFrequency = 15;
+
+  explicit SimpleFrequencySketch(size_t capacity);
+  ~SimpleFrequencySketch();
+
+  size_t capacity() const { return static_cast<size_t>(1) << width_bits_; }
+
+  void Increment(uint64 entry_hash);
+  int GetFrequency(uint64 entry_hash) const;
+
+  // Makes room for |capacity| entries, keeping the estimates. Never shrinks.
+  void EnsureCapacity(size_t capacity);
+
+ private:
+  static const int kDepth = 4;
+
+  // Returns the index of the counter of |entry_hash| in |row|.
+  size_t GetCounterIndex(uint64 entry_hash, int row) const;
+  int GetCounter(size_t index) const;
+  void SetCounter(size_t index, int value);
+
+  void Age();
+
+  // Each row has 2^|width_bits_| counters.
+  int width_bits_;
+  // |kDepth| rows of counters, two counters per byte.
+  std::vector<uint8> table_;
+  size_t increments_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleFrequencySketch);
+};
+
+// Decides which entries a SimpleIndex evicts when it grows too large.
+class NET_EXPORT_PRIVATE SimpleEvictionPolicy {
+ public:
+  // Evicts the least recently used entries first.
+  static scoped_ptr<SimpleEvictionPolicy> CreateLRU();
+
+  // Keeps the entries that are used often over the ones that were merely
+  // used last, like TinyLFU: a one-off burst of new entries cannot flush out
+  // the working set. The most recently used entries, a small share of the
+  // cache, are still evicted last, so that new entries get the chance to be
+  // used again.
+  static scoped_ptr<SimpleEvictionPolicy> CreateTinyLFU();
+
+  virtual ~SimpleEvictionPolicy() {}
+
+  // Called whenever the entry |entry_hash| is created or used.
+  virtual void OnUse(uint64 entry_hash) = 0;
+
+  // Fills |out_entry_hashes| with the entries of |entries| to evict, which
+  // together take at least |bytes_to_evict| bytes, or all of them.
+  virtual void SelectEntriesToEvict(const SimpleIndex::EntrySet& entries,
+                                    uint64 bytes_to_evict,
+                                    std::vector<uint64>* out_entry_hashes) = 0;
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_EVICTION_POLICY_H_
@@ -0,0 +1,156 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+uint64 GetHash(int i) {
+  return simple_util::GetEntryHashKey(base::StringPrintf("key%d", i));
+}
+
+// Adds the entry |i| to |entries|, last used |i| seconds after the epoch.
+void AddEntry(int i, uint64 entry_size, SimpleIndex::EntrySet* entries) {
+  SimpleIndex::InsertInEntrySet(
+      GetHash(i),
+      EntryMetadata(base::Time::UnixEpoch() + base::TimeDelta::FromSeconds(i),
+                    entry_size),
+      entries);
+}
+
+bool Contains(const std::vector<uint64>& entry_hashes, uint64 entry_hash) {
+  return std::find(entry_hashes.begin(), entry_hashes.end(), entry_hash) !=
+         entry_hashes.end();
+}
+
+}  // namespace
+
+TEST(SimpleFrequencySketchTest, Basics) {
+  SimpleFrequencySketch sketch(1000);
+  EXPECT_EQ(1024u, sketch.capacity());
+  EXPECT_EQ(0, sketch.GetFrequency(GetHash(1)));
+
+  for (int i = 0; i < 5; ++i)
+    sketch.Increment(GetHash(1));
+  sketch.Increment(GetHash(2));
+  EXPECT_EQ(5, sketch.GetFrequency(GetHash(1)));
+  EXPECT_EQ(1, sketch.GetFrequency(GetHash(2)));
+  EXPECT_EQ(0, sketch.GetFrequency(GetHash(3)));
+
+  for (int i = 0; i < 100; ++i)
+    sketch.Increment(GetHash(1));
+  EXPECT_EQ(SimpleFrequencySketch::kMaxFrequency,
+            sketch.GetFrequency(GetHash(1)));
+}
+
+TEST(SimpleFrequencySketchTest, Aging) {
+  SimpleFrequencySketch sketch(16);
+  for (int i = 0; i < 8; ++i)
+    sketch.Increment(GetHash(1));
+
+  // Ten uses per counter of a row, whatever the entries, halve the counts.
+  for (int i = 8; i < 10 * 16 - 1; ++i)
+    sketch.Increment(GetHash(2));
+  EXPECT_EQ(8, sketch.GetFrequency(GetHash(1)));
+  sketch.Increment(GetHash(2));
+  EXPECT_EQ(4, sketch.GetFrequency(GetHash(1)));
+  EXPECT_EQ(7, sketch.GetFrequency(GetHash(2)));
+}
+
+TEST(SimpleFrequencySketchTest, EnsureCapacity) {
+  SimpleFrequencySketch sketch(16);
+  for (int i = 0; i < 3; ++i)
+    sketch.Increment(GetHash(1));
+  sketch.Increment(GetHash(2));
+
+  sketch.EnsureCapacity(4000);
+  EXPECT_EQ(4096u, sketch.capacity());
+  EXPECT_LE(3, sketch.GetFrequency(GetHash(1)));
+  EXPECT_LE(1, sketch.GetFrequency(GetHash(2)));
+
+  sketch.EnsureCapacity(100);
+  EXPECT_EQ(4096u, sketch.capacity());
+}
+
+TEST(SimpleEvictionPolicyTest, LRU) {
+  scoped_ptr<SimpleEvictionPolicy> policy = SimpleEvictionPolicy::CreateLRU();
+  SimpleIndex::EntrySet entries;
+  for (int i = 1; i <= 10; ++i)
+    AddEntry(i, 100, &entries);
+  // Uses do not matter to LRU.
+  for (int i = 0; i < 10; ++i)
+    policy->OnUse(GetHash(1));
+
+  std::vector<uint64> entry_hashes;
+  policy->SelectEntriesToEvict(entries, 250, &entry_hashes);
+  ASSERT_EQ(3u, entry_hashes.size());
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(GetHash(i + 1), entry_hashes[i]);
+
+  entry_hashes.clear();
+  policy->SelectEntriesToEvict(entries, 5000, &entry_hashes);
+  EXPECT_EQ(10u, entry_hashes.size());
+}
+
+// A burst of entries used once does not flush out the entries that are used
+// often.
+TEST(SimpleEvictionPolicyTest, TinyLFUKeepsFrequentEntries) {
+  scoped_ptr<SimpleEvictionPolicy> policy =
+      SimpleEvictionPolicy::CreateTinyLFU();
+  SimpleIndex::EntrySet entries;
+  for (int i = 1; i <= 10; ++i) {
+    AddEntry(i, 100, &entries);
+    for (int j = 0; j < 3; ++j)
+      policy->OnUse(GetHash(i));
+  }
+  for (int i = 11; i <= 1000; ++i) {
+    AddEntry(i, 100, &entries);
+    policy->OnUse(GetHash(i));
+  }
+
+  std::vector<uint64> entry_hashes;
+  policy->SelectEntriesToEvict(entries, 500 * 100, &entry_hashes);
+  EXPECT_EQ(500u, entry_hashes.size());
+  for (int i = 1; i <= 10; ++i)
+    EXPECT_FALSE(Contains(entry_hashes, GetHash(i)));
+  // Among the entries used as often, the least recently used go first.
+  EXPECT_TRUE(Contains(entry_hashes, GetHash(11)));
+  EXPECT_FALSE(Contains(entry_hashes, GetHash(900)));
+}
+
+// The most recently used entries are evicted last, however rarely used.
+TEST(SimpleEvictionPolicyTest, TinyLFUWindow) {
+  scoped_ptr<SimpleEvictionPolicy> policy =
+      SimpleEvictionPolicy::CreateTinyLFU();
+  SimpleIndex::EntrySet entries;
+  for (int i = 1; i <= 200; ++i) {
+    AddEntry(i, 100, &entries);
+    for (int j = 0; j < 2; ++j)
+      policy->OnUse(GetHash(i));
+  }
+  // Makes up 1% of the cache.
+  AddEntry(201, 202, &entries);
+
+  std::vector<uint64> entry_hashes;
+  policy->SelectEntriesToEvict(entries, 200 * 100, &entry_hashes);
+  ASSERT_EQ(200u, entry_hashes.size());
+  EXPECT_FALSE(Contains(entry_hashes, GetHash(201)));
+
+  entry_hashes.clear();
+  policy->SelectEntriesToEvict(entries, 200 * 100 + 1, &entry_hashes);
+  ASSERT_EQ(201u, entry_hashes.size());
+  EXPECT_EQ(GetHash(201), entry_hashes.back());
+}
+
+}  // namespace disk_cache
@@ -4,7 +4,6 @@
 
 #include "net/disk_cache/simple/simple_index.h"
 
-#include <algorithm>
 #include <limits>
 #include <string>
 #include <utility>
@@ -25,6 +24,7 @@
 #include "base/time/time.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
@@ -49,30 +49,6 @@ const uint32 kEvictionMarginDivisor = 20;
 
 const uint32 kBytesInKb = 1024;
 
-// Utility class used for timestamp comparisons in entry metadata while sorting.
-class CompareHashesForTimestamp {
-  typedef disk_cache::SimpleIndex SimpleIndex;
-  typedef disk_cache::SimpleIndex::EntrySet EntrySet;
- public:
-  explicit CompareHashesForTimestamp(const EntrySet& set);
-
-  bool operator()(uint64 hash1, uint64 hash2);
- private:
-  const EntrySet& entry_set_;
-};
-
-CompareHashesForTimestamp::CompareHashesForTimestamp(const EntrySet& set)
-  : entry_set_(set) {
-}
-
-bool CompareHashesForTimestamp::operator()(uint64 hash1, uint64 hash2) {
-  EntrySet::const_iterator it1 = entry_set_.find(hash1);
-  DCHECK(it1 != entry_set_.end());
-  EntrySet::const_iterator it2 = entry_set_.find(hash2);
-  DCHECK(it2 != entry_set_.end());
-  return it1->second.GetLastUsedTime() < it2->second.GetLastUsedTime();
-}
-
 }  // namespace
 
 namespace disk_cache {
@@ -150,6 +126,7 @@ SimpleIndex::SimpleIndex(
       high_watermark_(0),
       low_watermark_(0),
       eviction_in_progress_(false),
+      eviction_policy_(SimpleEvictionPolicy::CreateLRU()),
       initialized_(false),
       index_file_(index_file.Pass()),
       io_thread_(io_thread),
@@ -167,6 +144,10 @@ SimpleIndex::~SimpleIndex() {
        end = to_run_when_initialized_.end(); it != end; ++it) {
     it->Run(net::ERR_ABORTED);
   }
+  for (CallbackList::iterator it = to_run_when_lookups_ready_.begin(),
+       end = to_run_when_lookups_ready_.end(); it != end; ++it) {
+    it->Run(net::ERR_ABORTED);
+  }
 }
 
 void SimpleIndex::Initialize(base::Time cache_mtime) {
@@ -185,7 +166,9 @@ void SimpleIndex::Initialize(base::Time cache_mtime) {
       &SimpleIndex::MergeInitializingSet,
       AsWeakPtr(),
       base::Passed(&load_result_scoped));
-  index_file_->LoadIndexEntries(cache_mtime, reply, load_result);
+  index_file_->LoadIndexEntries(
+      cache_mtime, base::Bind(&SimpleIndex::SetMappedIndex, AsWeakPtr()),
+      reply, load_result);
 }
 
 void SimpleIndex::SetMaxSize(uint64 max_bytes) {
@@ -197,6 +180,12 @@ void SimpleIndex::SetMaxSize(uint64 max_bytes) {
   }
 }
 
+void SimpleIndex::SetEvictionPolicy(
+    scoped_ptr<SimpleEvictionPolicy> eviction_policy) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  eviction_policy_ = eviction_policy.Pass();
+}
+
 int SimpleIndex::ExecuteWhenReady(const net::CompletionCallback& task) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (initialized_)
@@ -206,6 +195,15 @@ int SimpleIndex::ExecuteWhenReady(const net::CompletionCallback& task) {
   return net::ERR_IO_PENDING;
 }
 
+int SimpleIndex::ExecuteWhenLookupsReady(const net::CompletionCallback& task) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (lookups_ready())
+    io_thread_->PostTask(FROM_HERE, base::Bind(task, net::OK));
+  else
+    to_run_when_lookups_ready_.push_back(task);
+  return net::ERR_IO_PENDING;
+}
+
 scoped_ptr<SimpleIndex::HashList> SimpleIndex::GetEntriesBetween(
     base::Time initial_time, base::Time end_time) {
   DCHECK_EQ(true, initialized_);
@@ -246,9 +244,10 @@ void SimpleIndex::Insert(uint64 entry_hash) {
   // creating the new entry, and then UpdateEntrySize will be called.
   InsertInEntrySet(
       entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
+  eviction_policy_->OnUse(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
-  PostponeWritingToDisk();
+  PostponeWritingToDisk(entry_hash);
 }
 
 void SimpleIndex::Remove(uint64 entry_hash) {
@@ -256,30 +255,40 @@ void SimpleIndex::Remove(uint64 entry_hash) {
   EntrySet::iterator it = entries_set_.find(entry_hash);
   if (it != entries_set_.end()) {
     UpdateEntryIteratorSize(&it, 0);
+    ReleaseSlabRecord(entry_hash);
     entries_set_.erase(it);
   }
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
-  PostponeWritingToDisk();
+  PostponeWritingToDisk(entry_hash);
 }
 
 bool SimpleIndex::Has(uint64 hash) const {
   DCHECK(io_thread_checker_.CalledOnValidThread());
-  // If not initialized, always return true, forcing it to go to the disk.
-  return !initialized_ || entries_set_.count(hash) > 0;
+  // If lookups are not ready, always return true, forcing it to go to the
+  // disk.
+  if (!lookups_ready())
+    return true;
+  if (entries_set_.count(hash) > 0)
+    return true;
+  if (initialized_ || removed_entries_.count(hash) > 0)
+    return false;
+  return mapped_index_->Find(hash, NULL, NULL);
 }
 
 bool SimpleIndex::UseIfExists(uint64 entry_hash) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   // Always update the last used time, even if it is during initialization.
   // It will be merged later.
-  EntrySet::iterator it = entries_set_.find(entry_hash);
+  EntrySet::iterator it = FindEntry(entry_hash);
   if (it == entries_set_.end())
-    // If not initialized, always return true, forcing it to go to the disk.
-    return !initialized_;
+    // If lookups are not ready, always return true, forcing it to go to the
+    // disk.
+    return !lookups_ready();
   it->second.SetLastUsedTime(base::Time::Now());
-  PostponeWritingToDisk();
+  eviction_policy_->OnUse(entry_hash);
+  PostponeWritingToDisk(entry_hash);
   return true;
 }
 
@@ -287,7 +296,6 @@ void SimpleIndex::StartEvictionIfNeeded() {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (eviction_in_progress_ || cache_size_ <= high_watermark_)
     return;
-  // Take all live key hashes from the index and sort them by time.
   eviction_in_progress_ = true;
   eviction_start_time_ = base::TimeTicks::Now();
   SIMPLE_CACHE_UMA(
@@ -296,28 +304,17 @@ void SimpleIndex::StartEvictionIfNeeded() {
   SIMPLE_CACHE_UMA(
       MEMORY_KB, "Eviction.MaxCacheSizeOnStart2", cache_type_,
       static_cast<base::HistogramBase::Sample>(max_size_ / kBytesInKb));
-  std::vector<uint64> entry_hashes;
-  entry_hashes.reserve(entries_set_.size());
-  for (EntrySet::const_iterator it = entries_set_.begin(),
-       end = entries_set_.end(); it != end; ++it) {
-    entry_hashes.push_back(it->first);
-  }
-  std::sort(entry_hashes.begin(), entry_hashes.end(),
-            CompareHashesForTimestamp(entries_set_));
-
   // Remove as many entries from the index to get below |low_watermark_|.
-  std::vector<uint64>::iterator it = entry_hashes.begin();
+  std::vector<uint64> entry_hashes;
+  eviction_policy_->SelectEntriesToEvict(
+      entries_set_, cache_size_ - low_watermark_, &entry_hashes);
   uint64 evicted_so_far_size = 0;
-  while (evicted_so_far_size < cache_size_ - low_watermark_) {
-    DCHECK(it != entry_hashes.end());
-    EntrySet::iterator found_meta = entries_set_.find(*it);
+  for (size_t i = 0; i < entry_hashes.size(); ++i) {
+    EntrySet::const_iterator found_meta = entries_set_.find(entry_hashes[i]);
     DCHECK(found_meta != entries_set_.end());
     evicted_so_far_size += found_meta->second.GetEntrySize();
-    ++it;
   }
 
-  // Take out the rest of hashes from the eviction list.
-  entry_hashes.erase(it, entry_hashes.end());
   SIMPLE_CACHE_UMA(COUNTS,
                    "Eviction.EntryCount", cache_type_, entry_hashes.size());
   SIMPLE_CACHE_UMA(TIMES,
@@ -334,16 +331,56 @@ void SimpleIndex::StartEvictionIfNeeded() {
 
 bool SimpleIndex::UpdateEntrySize(uint64 entry_hash, int64 entry_size) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
-  EntrySet::iterator it = entries_set_.find(entry_hash);
+  EntrySet::iterator it = FindEntry(entry_hash);
   if (it == entries_set_.end())
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
-  PostponeWritingToDisk();
+  PostponeWritingToDisk(entry_hash);
   StartEvictionIfNeeded();
   return true;
 }
 
+SimpleSlabAddress SimpleIndex::GetSlabAddress(uint64 entry_hash) const {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  SlabAddressMap::const_iterator it = slab_addresses_.find(entry_hash);
+  if (it != slab_addresses_.end())
+    return it->second;
+  SimpleSlabAddress slab_address;
+  if (!initialized_ && mapped_index_.get() && !entries_set_.count(entry_hash) &&
+      !removed_entries_.count(entry_hash)) {
+    mapped_index_->Find(entry_hash, NULL, &slab_address);
+  }
+  return slab_address;
+}
+
+bool SimpleIndex::SetSlabAddress(uint64 entry_hash,
+                                 const SimpleSlabAddress& slab_address) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (FindEntry(entry_hash) == entries_set_.end())
+    return false;
+  if (GetSlabAddress(entry_hash) == slab_address)
+    return true;
+
+  ReleaseSlabRecord(entry_hash);
+  if (slab_address.is_valid())
+    slab_addresses_[entry_hash] = slab_address;
+  PostponeWritingToDisk(entry_hash);
+  return true;
+}
+
+bool SimpleIndex::MoveSlabRecord(uint64 entry_hash,
+                                 const SimpleSlabAddress& from,
+                                 const SimpleSlabAddress& to) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  SlabAddressMap::iterator it = slab_addresses_.find(entry_hash);
+  if (it == slab_addresses_.end() || it->second != from)
+    return false;
+  it->second = to;
+  PostponeWritingToDisk(entry_hash);
+  return true;
+}
+
 void SimpleIndex::EvictionDone(int result) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
 
@@ -367,9 +404,10 @@ void SimpleIndex::InsertInEntrySet(
   entry_set->insert(std::make_pair(entry_hash, entry_metadata));
 }
 
-void SimpleIndex::PostponeWritingToDisk() {
+void SimpleIndex::PostponeWritingToDisk(uint64 entry_hash) {
   if (!initialized_)
     return;
+  changed_entries_.insert(entry_hash);
   const int delay = app_on_background_ ? kWriteToDiskOnBackgroundDelayMSecs
                                        : kWriteToDiskDelayMSecs;
   // If the timer is already active, Start() will just Reset it, postponing it.
@@ -387,16 +425,68 @@ void SimpleIndex::UpdateEntryIteratorSize(EntrySet::iterator* it,
   (*it)->second.SetEntrySize(entry_size);
 }
 
+void SimpleIndex::ReleaseSlabRecord(uint64 entry_hash) {
+  SlabAddressMap::iterator it = slab_addresses_.find(entry_hash);
+  if (it == slab_addresses_.end())
+    return;
+  delegate_->ReleaseSlabRecord(entry_hash, it->second);
+  slab_addresses_.erase(it);
+}
+
+SimpleIndex::EntrySet::iterator SimpleIndex::FindEntry(uint64 entry_hash) {
+  EntrySet::iterator it = entries_set_.find(entry_hash);
+  if (it != entries_set_.end() || initialized_ || !mapped_index_.get() ||
+      removed_entries_.count(entry_hash)) {
+    return it;
+  }
+  EntryMetadata entry_metadata;
+  SimpleSlabAddress slab_address;
+  if (!mapped_index_->Find(entry_hash, &entry_metadata, &slab_address))
+    return it;
+
+  // The loaded entry will be the same, so the merge must not release its slab
+  // record, which this now owns.
+  it = entries_set_.insert(std::make_pair(entry_hash, entry_metadata)).first;
+  cache_size_ += entry_metadata.GetEntrySize();
+  if (slab_address.is_valid())
+    slab_addresses_[entry_hash] = slab_address;
+  entries_from_mapped_index_.insert(entry_hash);
+  return it;
+}
+
+void SimpleIndex::SetMappedIndex(
+    const scoped_refptr<SimpleMappedIndex>& mapped_index) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  DCHECK(mapped_index->in_order());
+  if (initialized_)
+    return;
+  mapped_index_ = mapped_index;
+
+  // Run all callbacks waiting for lookups.
+  for (CallbackList::iterator it = to_run_when_lookups_ready_.begin(),
+       end = to_run_when_lookups_ready_.end(); it != end; ++it) {
+    io_thread_->PostTask(FROM_HERE, base::Bind((*it), net::OK));
+  }
+  to_run_when_lookups_ready_.clear();
+}
+
 void SimpleIndex::MergeInitializingSet(
     scoped_ptr<SimpleIndexLoadResult> load_result) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   DCHECK(load_result->did_load);
 
   EntrySet* index_file_entries = &load_result->entries;
+  SlabAddressMap* index_file_slab_addresses = &load_result->slab_addresses;
 
   for (base::hash_set<uint64>::const_iterator it = removed_entries_.begin();
        it != removed_entries_.end(); ++it) {
     index_file_entries->erase(*it);
+    SlabAddressMap::iterator found = index_file_slab_addresses->find(*it);
+    if (found != index_file_slab_addresses->end()) {
+      if (!entries_from_mapped_index_.count(*it))
+        delegate_->ReleaseSlabRecord(*it, found->second);
+      index_file_slab_addresses->erase(found);
+    }
   }
   removed_entries_.clear();
 
@@ -408,6 +498,20 @@ void SimpleIndex::MergeInitializingSet(
                                                         EntryMetadata()));
     EntrySet::iterator& possibly_inserted_entry = insert_result.first;
     possibly_inserted_entry->second = it->second;
+
+    // What happened to the entry since it was loaded supersedes its record.
+    const SimpleSlabAddress slab_address = GetSlabAddress(entry_hash);
+    SlabAddressMap::iterator found =
+        index_file_slab_addresses->find(entry_hash);
+    if (found != index_file_slab_addresses->end()) {
+      if (found->second != slab_address &&
+          !entries_from_mapped_index_.count(entry_hash)) {
+        delegate_->ReleaseSlabRecord(entry_hash, found->second);
+      }
+      index_file_slab_addresses->erase(found);
+    }
+    if (slab_address.is_valid())
+      (*index_file_slab_addresses)[entry_hash] = slab_address;
   }
 
   uint64 merged_cache_size = 0;
@@ -417,8 +521,11 @@ void SimpleIndex::MergeInitializingSet(
   }
 
   entries_set_.swap(*index_file_entries);
+  slab_addresses_.swap(*index_file_slab_addresses);
   cache_size_ = merged_cache_size;
   initialized_ = true;
+  entries_from_mapped_index_.clear();
+  mapped_index_ = NULL;
 
   // The actual IO is asynchronous, so calling WriteToDisk() shouldn't slow the
   // merge down much.
@@ -434,6 +541,11 @@ void SimpleIndex::MergeInitializingSet(
     io_thread_->PostTask(FROM_HERE, base::Bind((*it), net::OK));
   }
   to_run_when_initialized_.clear();
+  for (CallbackList::iterator it = to_run_when_lookups_ready_.begin(),
+       end = to_run_when_lookups_ready_.end(); it != end; ++it) {
+    io_thread_->PostTask(FROM_HERE, base::Bind((*it), net::OK));
+  }
+  to_run_when_lookups_ready_.clear();
 }
 
 #if defined(OS_ANDROID)
@@ -473,8 +585,10 @@ void SimpleIndex::WriteToDisk() {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(entries_set_, cache_size_,
-                           start, app_on_background_, base::Closure());
+  index_file_->WriteToDisk(entries_set_, slab_addresses_, &changed_entries_,
+                           cache_size_, start, app_on_background_,
+                           base::Closure());
+  changed_entries_.clear();
 }
 
 }  // namespace disk_cache
@@ -23,6 +23,7 @@
 #include "net/base/cache_type.h"
 #include "net/base/completion_callback.h"
 #include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
 
 #if defined(OS_ANDROID)
 #include "base/android/application_status_listener.h"
@@ -33,8 +34,10 @@ class PickleIterator;
 
 namespace disk_cache {
 
+class SimpleEvictionPolicy;
 class SimpleIndexDelegate;
 class SimpleIndexFile;
+class SimpleMappedIndex;
 struct SimpleIndexLoadResult;
 
 class NET_EXPORT_PRIVATE EntryMetadata {
@@ -89,10 +92,15 @@ class NET_EXPORT_PRIVATE SimpleIndex
   void SetMaxSize(uint64 max_bytes);
   uint64 max_size() const { return max_size_; }
 
+  // Replaces the policy that picks the entries to evict, which is LRU by
+  // default.
+  void SetEvictionPolicy(scoped_ptr<SimpleEvictionPolicy> eviction_policy);
+
   void Insert(uint64 entry_hash);
   void Remove(uint64 entry_hash);
 
-  // Check whether the index has the entry given the hash of its key.
+  // Check whether the index has the entry given the hash of its key. Always
+  // true until lookups_ready().
   bool Has(uint64 entry_hash) const;
 
   // Update the last used time of the entry with the given key and return true
@@ -106,8 +114,28 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // entry.
   bool UpdateEntrySize(uint64 entry_hash, int64 entry_size);
 
+  // Returns the address of the slab record of an entry, which is invalid if
+  // the entry is stored in its own files or is not in the index.
+  SimpleSlabAddress GetSlabAddress(uint64 entry_hash) const;
+
+  // Sets the address of the slab record of an entry, and releases the record
+  // it replaces. Returns false if the entry is not in the index, in which case
+  // the caller still owns the record at |slab_address|.
+  bool SetSlabAddress(uint64 entry_hash, const SimpleSlabAddress& slab_address);
+
+  // Moves an entry to |to|, the copy of its record at |from|, unless the entry
+  // is not at |from| any more, in which case it returns false and the caller
+  // still owns the copy.
+  bool MoveSlabRecord(uint64 entry_hash,
+                      const SimpleSlabAddress& from,
+                      const SimpleSlabAddress& to);
+
   typedef base::hash_map<uint64, EntryMetadata> EntrySet;
 
+  // Where the records of the entries that are in slab files are. Only those
+  // entries are in it, so that the other entries don't pay for it.
+  typedef base::hash_map<uint64, SimpleSlabAddress> SlabAddressMap;
+
   static void InsertInEntrySet(uint64 entry_hash,
                                const EntryMetadata& entry_metadata,
                                EntrySet* entry_set);
@@ -115,6 +143,10 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // Executes the |callback| when the index is ready. Allows multiple callbacks.
   int ExecuteWhenReady(const net::CompletionCallback& callback);
 
+  // Executes the |callback| when lookups_ready(), which can be before the
+  // index is ready. Allows multiple callbacks.
+  int ExecuteWhenLookupsReady(const net::CompletionCallback& callback);
+
   // Returns entries from the index that have last accessed time matching the
   // range between |initial_time| and |end_time| where open intervals are
   // possible according to the definition given in |DoomEntriesBetween()| in the
@@ -131,20 +163,38 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // Returns whether the index has been initialized yet.
   bool initialized() const { return initialized_; }
 
+  // Returns whether the index can tell which entries are in the cache, which
+  // it can from the index file while it is still loading the entries from it.
+  bool lookups_ready() const { return initialized_ || mapped_index_.get(); }
+
  private:
   friend class SimpleIndexTest;
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, IndexSizeCorrectOnMerge);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteQueued);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWriteExecuted);
   FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, DiskWritePostponed);
+  FRIEND_TEST_ALL_PREFIXES(SimpleIndexTest, LookupsBeforeInit);
 
   void StartEvictionIfNeeded();
   void EvictionDone(int result);
 
-  void PostponeWritingToDisk();
+  // Records that |entry_hash| changed, to be written with the next write.
+  void PostponeWritingToDisk(uint64 entry_hash);
 
   void UpdateEntryIteratorSize(EntrySet::iterator* it, int64 entry_size);
 
+  // Forgets the slab record of an entry, and tells the delegate that it is no
+  // longer used.
+  void ReleaseSlabRecord(uint64 entry_hash);
+
+  // Returns the entry |entry_hash| in |entries_set_|. Before the index is
+  // initialized, an entry that is only in |mapped_index_| is copied there
+  // first, so that it can be changed.
+  EntrySet::iterator FindEntry(uint64 entry_hash);
+
+  // Must run on IO Thread.
+  void SetMappedIndex(const scoped_refptr<SimpleMappedIndex>& mapped_index);
+
   // Must run on IO Thread.
   void MergeInitializingSet(scoped_ptr<SimpleIndexLoadResult> load_result);
 
@@ -158,6 +208,7 @@ class NET_EXPORT_PRIVATE SimpleIndex
   SimpleIndexDelegate* delegate_;
 
   EntrySet entries_set_;
+  SlabAddressMap slab_addresses_;
 
   const net::CacheType cache_type_;
   uint64 cache_size_;  // Total cache storage size in bytes.
@@ -166,12 +217,22 @@ class NET_EXPORT_PRIVATE SimpleIndex
   uint64 low_watermark_;
   bool eviction_in_progress_;
   base::TimeTicks eviction_start_time_;
+  scoped_ptr<SimpleEvictionPolicy> eviction_policy_;
 
   // This stores all the entry_hash of entries that are removed during
   // initialization.
   base::hash_set<uint64> removed_entries_;
   bool initialized_;
 
+  // The index file, which answers lookups until the index is initialized.
+  scoped_refptr<SimpleMappedIndex> mapped_index_;
+  // The entries that FindEntry() copied from |mapped_index_|, whose slab
+  // records the loaded entries share.
+  base::hash_set<uint64> entries_from_mapped_index_;
+
+  // The entries that changed since the index was last written to disk.
+  base::hash_set<uint64> changed_entries_;
+
   scoped_ptr<SimpleIndexFile> index_file_;
 
   scoped_refptr<base::SingleThreadTaskRunner> io_thread_;
@@ -190,6 +251,7 @@ class NET_EXPORT_PRIVATE SimpleIndex
 
   typedef std::list<net::CompletionCallback> CallbackList;
   CallbackList to_run_when_initialized_;
+  CallbackList to_run_when_lookups_ready_;
 
   // Set to true when the app is on the background. When the app is in the
   // background we can write the index much more frequently, to insure fresh
@@ -12,6 +12,8 @@
 
 namespace disk_cache {
 
+struct SimpleSlabAddress;
+
 class NET_EXPORT_PRIVATE SimpleIndexDelegate {
  public:
   virtual ~SimpleIndexDelegate() {}
@@ -21,6 +23,11 @@ class NET_EXPORT_PRIVATE SimpleIndexDelegate {
   // for efficiency.
   virtual void DoomEntries(std::vector<uint64>* entry_hashes,
                            const net::CompletionCallback& callback) = 0;
+
+  // Kills the slab record of the entry |entry_hash| at |slab_address|, which
+  // the index no longer points to.
+  virtual void ReleaseSlabRecord(uint64 entry_hash,
+                                 const SimpleSlabAddress& slab_address) = 0;
 };
 
 }  // namespace disk_cache
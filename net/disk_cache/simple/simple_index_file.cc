@@ -4,8 +4,13 @@
 
 #include "net/disk_cache/simple/simple_index_file.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
 #include <vector>
 
+#include "base/containers/hash_tables.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
@@ -14,11 +19,13 @@
 #include "base/pickle.h"
 #include "base/single_thread_task_runner.h"
 #include "base/task_runner_util.h"
+#include "base/thread_task_runner_handle.h"
 #include "base/threading/thread_restrictions.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -33,6 +40,110 @@ const int kEntryFilesSuffixLength = 2;
 
 const uint64 kMaxEntiresInIndex = 100000000;
 
+// Returns the end of the pickle with a header of |header_size| bytes that
+// starts at |start|, or NULL if it does not end by |end|.
+const char* FindPickleEnd(size_t header_size,
+                          const char* start,
+                          const char* end) {
+  const size_t length = end - start;
+  if (length < header_size)
+    return NULL;
+  const Pickle::Header* header = reinterpret_cast<const Pickle::Header*>(start);
+  if (header->payload_size > length - header_size)
+    return NULL;
+  return start + header_size + header->payload_size;
+}
+
+// The sizes of the records of an entry and of a slab address in the index
+// file, as Serialize() writes them.
+const size_t kEntryRecordSize = 3 * sizeof(uint64);
+const size_t kSlabAddressRecordSize = sizeof(uint64) + 2 * sizeof(uint32);
+
+// Pickles only align their fields to four bytes, so the fields of the records
+// are copied out.
+template <typename T>
+T ReadRecordField(const char* record, size_t offset) {
+  T field;
+  memcpy(&field, record + offset, sizeof(field));
+  return field;
+}
+
+uint64 RecordHash(const char* record) {
+  return ReadRecordField<uint64>(record, 0);
+}
+
+EntryMetadata EntryMetadataFromRecord(const char* record) {
+  return EntryMetadata(
+      base::Time::FromInternalValue(
+          ReadRecordField<int64>(record, sizeof(uint64))),
+      ReadRecordField<uint64>(record, 2 * sizeof(uint64)));
+}
+
+SimpleSlabAddress SlabAddressFromRecord(const char* record) {
+  return SimpleSlabAddress(
+      ReadRecordField<uint32>(record, sizeof(uint64)),
+      ReadRecordField<uint32>(record, sizeof(uint64) + sizeof(uint32)));
+}
+
+// Returns the record of |entry_hash| among the |number_of_records| records of
+// |record_size| bytes at |records|, which are in the order of their hashes, or
+// NULL if there is none.
+const char* FindRecord(const char* records,
+                       uint64 number_of_records,
+                       size_t record_size,
+                       uint64 entry_hash) {
+  uint64 begin = 0;
+  uint64 end = number_of_records;
+  while (begin < end) {
+    const uint64 middle = begin + (end - begin) / 2;
+    const char* record = records + middle * record_size;
+    const uint64 record_hash = RecordHash(record);
+    if (record_hash == entry_hash)
+      return record;
+    if (record_hash < entry_hash)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  return NULL;
+}
+
+// Returns whether the hashes of the |number_of_records| records of
+// |record_size| bytes at |records| are in strictly increasing order.
+bool RecordsInOrder(const char* records,
+                    uint64 number_of_records,
+                    size_t record_size) {
+  for (uint64 i = 1; i < number_of_records; ++i) {
+    if (RecordHash(records + (i - 1) * record_size) >=
+        RecordHash(records + i * record_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Iterator>
+bool KeyLess(const Iterator& a, const Iterator& b) {
+  return a->first < b->first;
+}
+
+// Returns iterators to the items of |map| in the order of their keys.
+template <typename Map>
+std::vector<typename Map::const_iterator> SortByKey(const Map& map) {
+  std::vector<typename Map::const_iterator> sorted;
+  sorted.reserve(map.size());
+  for (typename Map::const_iterator it = map.begin(); it != map.end(); ++it)
+    sorted.push_back(it);
+  std::sort(sorted.begin(), sorted.end(),
+            &KeyLess<typename Map::const_iterator>);
+  return sorted;
+}
+
+// The last reference to a SimpleMappedIndex can go on the IO thread, so its
+// file is closed on a thread that allows IO.
+void CloseIndexFileMap(scoped_ptr<base::MemoryMappedFile> index_file_map) {
+}
+
 uint32 CalculatePickleCRC(const Pickle& pickle) {
   return crc32(crc32(0, Z_NULL, 0),
                reinterpret_cast<const Bytef*>(pickle.payload()),
@@ -131,6 +242,62 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
   }
 }
 
+void SerializeSlabAddress(const SimpleSlabAddress& slab_address,
+                          Pickle* pickle) {
+  pickle->WriteUInt32(slab_address.slab_number);
+  pickle->WriteUInt32(slab_address.offset);
+}
+
+bool DeserializeSlabAddress(PickleIterator* it,
+                            SimpleSlabAddress* slab_address) {
+  return it->ReadUInt32(&slab_address->slab_number) &&
+         it->ReadUInt32(&slab_address->offset);
+}
+
+// Called for each live slab record while restoring the index. Of the records
+// of an entry, the one with the highest sequence number is current, unless
+// the entry has files of its own.
+void ProcessSlabRecord(SimpleIndex::EntrySet* entries,
+                       SimpleIndex::SlabAddressMap* slab_addresses,
+                       base::hash_map<uint64, uint64>* sequences,
+                       uint64 entry_hash,
+                       const SimpleSlabAddress& slab_address,
+                       base::Time last_modified,
+                       int64 entry_size,
+                       uint64 sequence) {
+  SimpleIndex::EntrySet::iterator it = entries->find(entry_hash);
+  base::hash_map<uint64, uint64>::iterator sequence_it =
+      sequences->find(entry_hash);
+  if (sequence_it == sequences->end()) {
+    if (it != entries->end())
+      return;
+  } else if (sequence_it->second > sequence) {
+    return;
+  }
+  EntryMetadata entry_metadata(last_modified, entry_size);
+  (*slab_addresses)[entry_hash] = slab_address;
+  if (it == entries->end())
+    SimpleIndex::InsertInEntrySet(entry_hash, entry_metadata, entries);
+  else
+    it->second = entry_metadata;
+  (*sequences)[entry_hash] = sequence;
+}
+
+// Sets |*out_last_modified| to the last time an entry was written to the
+// cache, in its own files or in a slab.
+bool GetCacheLastModified(const base::FilePath& cache_directory,
+                          base::Time* out_last_modified) {
+  if (!simple_util::GetMTime(cache_directory, out_last_modified))
+    return false;
+  base::Time slabs_last_modified;
+  if (SimpleSlabStore::GetLastModified(cache_directory,
+                                       &slabs_last_modified) &&
+      slabs_last_modified > *out_last_modified) {
+    *out_last_modified = slabs_last_modified;
+  }
+  return true;
+}
+
 }  // namespace
 
 SimpleIndexLoadResult::SimpleIndexLoadResult() : did_load(false),
@@ -144,6 +311,191 @@ void SimpleIndexLoadResult::Reset() {
   did_load = false;
   flush_required = false;
   entries.clear();
+  slab_addresses.clear();
+}
+
+SimpleMappedIndex::LogChange::LogChange() : present(false) {
+}
+
+// static
+scoped_refptr<SimpleMappedIndex> SimpleMappedIndex::Map(
+    scoped_ptr<base::MemoryMappedFile> index_file_map,
+    const scoped_refptr<base::TaskRunner>& close_runner) {
+  const char* data = reinterpret_cast<const char*>(index_file_map->data());
+  const int data_len = index_file_map->length();
+  scoped_refptr<SimpleMappedIndex> mapped_index(
+      new SimpleMappedIndex(index_file_map.Pass(), close_runner));
+  if (!mapped_index->Init(data, data_len))
+    return NULL;
+  return mapped_index;
+}
+
+// static
+scoped_refptr<SimpleMappedIndex> SimpleMappedIndex::Read(const char* data,
+                                                         int data_len) {
+  scoped_refptr<SimpleMappedIndex> mapped_index(new SimpleMappedIndex(
+      scoped_ptr<base::MemoryMappedFile>(), scoped_refptr<base::TaskRunner>()));
+  if (!mapped_index->Init(data, data_len))
+    return NULL;
+  return mapped_index;
+}
+
+void SimpleMappedIndex::SetLogChanges(LogChanges* log_changes) {
+  DCHECK(HasOneRef());
+  log_changes_.swap(*log_changes);
+}
+
+bool SimpleMappedIndex::Find(uint64 entry_hash,
+                             EntryMetadata* out_entry_metadata,
+                             SimpleSlabAddress* out_slab_address) const {
+  DCHECK(in_order_);
+  LogChanges::const_iterator change = log_changes_.find(entry_hash);
+  if (change != log_changes_.end()) {
+    if (!change->second.present)
+      return false;
+    if (out_entry_metadata)
+      *out_entry_metadata = change->second.entry_metadata;
+    if (out_slab_address)
+      *out_slab_address = change->second.slab_address;
+    return true;
+  }
+
+  const char* record =
+      FindRecord(entries_, number_of_entries_, kEntryRecordSize, entry_hash);
+  if (!record)
+    return false;
+  if (out_entry_metadata)
+    *out_entry_metadata = EntryMetadataFromRecord(record);
+  if (out_slab_address) {
+    const char* slab_address_record =
+        FindRecord(slab_addresses_, number_of_slab_addresses_,
+                   kSlabAddressRecordSize, entry_hash);
+    *out_slab_address = slab_address_record
+                            ? SlabAddressFromRecord(slab_address_record)
+                            : SimpleSlabAddress();
+  }
+  return true;
+}
+
+void SimpleMappedIndex::GetEntries(SimpleIndexLoadResult* out_result) const {
+  out_result->Reset();
+  SimpleIndex::EntrySet* entries = &out_result->entries;
+  SimpleIndex::SlabAddressMap* slab_addresses = &out_result->slab_addresses;
+
+#if !defined(OS_WIN)
+  // TODO(gavinp): Consider using std::unordered_map.
+  entries->resize(number_of_entries_ + SimpleIndexFile::kExtraSizeForMerge);
+#endif
+  for (uint64 i = 0; i < number_of_entries_; ++i) {
+    const char* record = entries_ + i * kEntryRecordSize;
+    SimpleIndex::InsertInEntrySet(RecordHash(record),
+                                  EntryMetadataFromRecord(record), entries);
+  }
+  for (uint64 i = 0; i < number_of_slab_addresses_; ++i) {
+    const char* record = slab_addresses_ + i * kSlabAddressRecordSize;
+    (*slab_addresses)[RecordHash(record)] = SlabAddressFromRecord(record);
+  }
+
+  for (LogChanges::const_iterator it = log_changes_.begin();
+       it != log_changes_.end(); ++it) {
+    if (!it->second.present) {
+      entries->erase(it->first);
+      slab_addresses->erase(it->first);
+      continue;
+    }
+    (*entries)[it->first] = it->second.entry_metadata;
+    if (it->second.slab_address.is_valid())
+      (*slab_addresses)[it->first] = it->second.slab_address;
+    else
+      slab_addresses->erase(it->first);
+  }
+  out_result->did_load = true;
+}
+
+SimpleMappedIndex::SimpleMappedIndex(
+    scoped_ptr<base::MemoryMappedFile> index_file_map,
+    const scoped_refptr<base::TaskRunner>& close_runner)
+    : index_file_map_(index_file_map.Pass()),
+      close_runner_(close_runner),
+      entries_(NULL),
+      number_of_entries_(0),
+      slab_addresses_(NULL),
+      number_of_slab_addresses_(0),
+      in_order_(false),
+      crc_(0),
+      size_(0) {
+}
+
+SimpleMappedIndex::~SimpleMappedIndex() {
+  if (index_file_map_ && !close_runner_->RunsTasksOnCurrentThread()) {
+    close_runner_->PostTask(
+        FROM_HERE,
+        base::Bind(&CloseIndexFileMap, base::Passed(&index_file_map_)));
+  }
+}
+
+bool SimpleMappedIndex::Init(const char* data, int data_len) {
+  Pickle pickle(data, data_len);
+  if (!pickle.data() || pickle.size() - pickle.payload_size() !=
+                            sizeof(SimpleIndexFile::PickleHeader)) {
+    LOG(WARNING) << "Corrupt Simple Index File.";
+    return false;
+  }
+
+  const SimpleIndexFile::PickleHeader* header_p =
+      pickle.headerT<SimpleIndexFile::PickleHeader>();
+  if (header_p->crc != CalculatePickleCRC(pickle)) {
+    LOG(WARNING) << "Invalid CRC in Simple Index file.";
+    return false;
+  }
+
+  PickleIterator pickle_it(pickle);
+  SimpleIndexFile::IndexMetadata index_metadata;
+  if (!index_metadata.Deserialize(&pickle_it) ||
+      !index_metadata.CheckIndexMetadata()) {
+    LOG(ERROR) << "Invalid index_metadata on Simple Cache Index.";
+    return false;
+  }
+
+  // The records are read in place.
+  number_of_entries_ = index_metadata.GetNumberOfEntries();
+  if (number_of_entries_ > pickle.payload_size() / kEntryRecordSize ||
+      !pickle_it.ReadBytes(
+          &entries_, static_cast<int>(number_of_entries_ * kEntryRecordSize))) {
+    LOG(WARNING) << "Invalid EntryMetadata in Simple Index file.";
+    return false;
+  }
+  for (uint64 i = 0; i < number_of_entries_; ++i) {
+    if (ReadRecordField<uint64>(entries_ + i * kEntryRecordSize,
+                                2 * sizeof(uint64)) >
+        static_cast<uint64>(std::numeric_limits<int32>::max())) {
+      LOG(WARNING) << "Invalid EntryMetadata in Simple Index file.";
+      return false;
+    }
+  }
+
+  if (!pickle_it.ReadUInt64(&number_of_slab_addresses_) ||
+      number_of_slab_addresses_ > number_of_entries_ ||
+      !pickle_it.ReadBytes(
+          &slab_addresses_,
+          static_cast<int>(number_of_slab_addresses_ *
+                           kSlabAddressRecordSize))) {
+    LOG(WARNING) << "Invalid slab addresses in Simple Index file.";
+    return false;
+  }
+
+  int64 cache_last_modified;
+  if (!pickle_it.ReadInt64(&cache_last_modified))
+    return false;
+  cache_last_modified_ = base::Time::FromInternalValue(cache_last_modified);
+
+  in_order_ =
+      RecordsInOrder(entries_, number_of_entries_, kEntryRecordSize) &&
+      RecordsInOrder(slab_addresses_, number_of_slab_addresses_,
+                     kSlabAddressRecordSize);
+  crc_ = header_p->crc;
+  size_ = data_len;
+  return true;
 }
 
 // static
@@ -152,6 +504,8 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
+// static
+const char SimpleIndexFile::kLogFileName[] = "index-log";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
     : magic_number_(kSimpleIndexMagicNumber),
@@ -196,6 +550,7 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
                                       const base::FilePath& cache_directory,
                                       const base::FilePath& index_filename,
                                       const base::FilePath& temp_index_filename,
+                                      const base::FilePath& log_filename,
                                       scoped_ptr<Pickle> pickle,
                                       const base::TimeTicks& start_time,
                                       bool app_on_background) {
@@ -208,13 +563,17 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
     return;
   }
 
+  // Until the new log is in place, the changes that are appended go nowhere,
+  // and make the index file be deleted.
+  simple_util::SimpleCacheDeleteFile(log_filename);
+
   // There is a chance that the index containing all the necessary data about
   // newly created entries will appear to be stale. This can happen if on-disk
   // part of a Create operation does not fit into the time budget for the index
   // flush delay. This simple approach will be reconsidered if it does not allow
   // for maintaining freshness.
   base::Time cache_dir_mtime;
-  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+  if (!GetCacheLastModified(cache_directory, &cache_dir_mtime)) {
     LOG(ERROR) << "Could obtain information about cache age";
     return;
   }
@@ -231,6 +590,15 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   if (!base::ReplaceFile(temp_index_filename, index_filename, NULL))
     return;
 
+  Pickle log_header(sizeof(PickleHeader));
+  log_header.WriteUInt64(kSimpleIndexLogMagicNumber);
+  log_header.WriteUInt32(kSimpleVersion);
+  log_header.WriteUInt32(pickle->headerT<PickleHeader>()->crc);
+  log_header.WriteUInt64(pickle->size());
+  log_header.headerT<PickleHeader>()->crc = CalculatePickleCRC(log_header);
+  if (!WritePickleFile(&log_header, log_filename))
+    LOG(ERROR) << "Failed to start the index log";
+
   if (app_on_background) {
     SIMPLE_CACHE_UMA(TIMES,
                      "IndexWriteToDiskTime.Background", cache_type,
@@ -242,6 +610,29 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   }
 }
 
+// static
+void SimpleIndexFile::SyncAppendToLog(const base::FilePath& cache_directory,
+                                      const base::FilePath& index_filename,
+                                      const base::FilePath& log_filename,
+                                      scoped_ptr<Pickle> pickle) {
+  base::Time cache_dir_mtime;
+  if (!GetCacheLastModified(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return;
+  }
+  SerializeFinalData(cache_dir_mtime, pickle.get());
+
+  File file(log_filename, File::FLAG_OPEN | File::FLAG_APPEND |
+                              File::FLAG_SHARE_DELETE);
+  if (!file.IsValid() ||
+      file.WriteAtCurrentPos(static_cast<const char*>(pickle->data()),
+                             pickle->size()) !=
+          implicit_cast<int>(pickle->size())) {
+    LOG(ERROR) << "Failed to append to the index log";
+    simple_util::SimpleCacheDeleteFile(index_filename);
+  }
+}
+
 bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
   return number_of_entries_ <= kMaxEntiresInIndex &&
       magic_number_ == kSimpleIndexMagicNumber &&
@@ -260,32 +651,57 @@ SimpleIndexFile::SimpleIndexFile(
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
                       .AppendASCII(kIndexFileName)),
       temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+                           .AppendASCII(kTempIndexFileName)),
+      log_file_(cache_directory_.AppendASCII(kIndexDirectory)
+                    .AppendASCII(kLogFileName)),
+      can_append_to_log_(false),
+      changes_in_log_(0) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
 
-void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
-                                       const base::Closure& callback,
-                                       SimpleIndexLoadResult* out_result) {
+void SimpleIndexFile::LoadIndexEntries(
+    base::Time cache_last_modified,
+    const MappedIndexCallback& mapped_index_callback,
+    const base::Closure& callback,
+    SimpleIndexLoadResult* out_result) {
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
                                   cache_type_,
                                   cache_last_modified, cache_directory_,
-                                  index_file_, out_result);
+                                  index_file_, log_file_, worker_pool_,
+                                  base::ThreadTaskRunnerHandle::Get(),
+                                  mapped_index_callback, out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
-void SimpleIndexFile::WriteToDisk(const SimpleIndex::EntrySet& entry_set,
-                                  uint64 cache_size,
-                                  const base::TimeTicks& start,
-                                  bool app_on_background,
-                                  const base::Closure& callback) {
-  IndexMetadata index_metadata(entry_set.size(), cache_size);
-  scoped_ptr<Pickle> pickle = Serialize(index_metadata, entry_set);
-  base::Closure task =
-      base::Bind(&SimpleIndexFile::SyncWriteToDisk,
-                 cache_type_, cache_directory_, index_file_, temp_index_file_,
-                 base::Passed(&pickle), start, app_on_background);
+void SimpleIndexFile::WriteToDisk(
+    const SimpleIndex::EntrySet& entry_set,
+    const SimpleIndex::SlabAddressMap& slab_addresses,
+    const base::hash_set<uint64>* changed_entries,
+    uint64 cache_size,
+    const base::TimeTicks& start,
+    bool app_on_background,
+    const base::Closure& callback) {
+  base::Closure task;
+  if (changed_entries && can_append_to_log_ &&
+      changes_in_log_ + changed_entries->size() <=
+          std::max(kMinChangesToRewrite, entry_set.size() / 2)) {
+    changes_in_log_ += changed_entries->size();
+    scoped_ptr<Pickle> pickle =
+        SerializeChanges(entry_set, slab_addresses, *changed_entries);
+    task = base::Bind(&SimpleIndexFile::SyncAppendToLog, cache_directory_,
+                      index_file_, log_file_, base::Passed(&pickle));
+  } else {
+    can_append_to_log_ = true;
+    changes_in_log_ = 0;
+    IndexMetadata index_metadata(entry_set.size(), cache_size);
+    scoped_ptr<Pickle> pickle =
+        Serialize(index_metadata, entry_set, slab_addresses);
+    task = base::Bind(&SimpleIndexFile::SyncWriteToDisk, cache_type_,
+                      cache_directory_, index_file_, temp_index_file_,
+                      log_file_, base::Passed(&pickle), start,
+                      app_on_background);
+  }
   if (callback.is_null())
     cache_thread_->PostTask(FROM_HERE, task);
   else
@@ -298,17 +714,33 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    const base::FilePath& log_file_path,
+    const scoped_refptr<base::TaskRunner>& close_runner,
+    const scoped_refptr<base::SingleThreadTaskRunner>& mapped_index_runner,
+    const MappedIndexCallback& mapped_index_callback,
     SimpleIndexLoadResult* out_result) {
-  // Load the index and find its age.
+  out_result->Reset();
+
+  // Map the index and find its age.
   base::Time last_cache_seen_by_index;
-  SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  bool flush_required = false;
+  scoped_refptr<SimpleMappedIndex> mapped_index =
+      SyncMapIndex(index_file_path, log_file_path, close_runner,
+                   &last_cache_seen_by_index, &flush_required);
 
   // Consider the index loaded if it is fresh.
   const bool index_file_existed = base::PathExists(index_file_path);
-  if (!out_result->did_load) {
+  if (!mapped_index.get()) {
     if (index_file_existed)
       UmaRecordIndexFileState(INDEX_STATE_CORRUPT, cache_type);
   } else {
+    // Slabs are written to without touching the cache directory.
+    base::Time slabs_last_modified;
+    if (SimpleSlabStore::GetLastModified(cache_directory,
+                                         &slabs_last_modified) &&
+        slabs_last_modified > cache_last_modified) {
+      cache_last_modified = slabs_last_modified;
+    }
     if (cache_last_modified <= last_cache_seen_by_index) {
       base::Time latest_dir_mtime;
       simple_util::GetMTime(cache_directory, &latest_dir_mtime);
@@ -319,14 +751,26 @@ void SimpleIndexFile::SyncLoadIndexEntries(
         UmaRecordIndexFileState(INDEX_STATE_FRESH, cache_type);
       }
       UmaRecordIndexInitMethod(INITIALIZE_METHOD_LOADED, cache_type);
+
+      // The index can answer lookups from the file while its entries are
+      // read, unless the file predates the sorted records.
+      if (mapped_index->in_order() && !mapped_index_callback.is_null()) {
+        mapped_index_runner->PostTask(
+            FROM_HERE, base::Bind(mapped_index_callback, mapped_index));
+      }
+      mapped_index->GetEntries(out_result);
+      out_result->flush_required = flush_required;
       return;
     }
     UmaRecordIndexFileState(INDEX_STATE_STALE, cache_type);
   }
+  // The restore deletes the index file.
+  mapped_index = NULL;
 
   // Reconstruct the index by scanning the disk for entries.
   const base::TimeTicks start = base::TimeTicks::Now();
-  SyncRestoreFromDisk(cache_directory, index_file_path, out_result);
+  SyncRestoreFromDisk(cache_directory, index_file_path, log_file_path,
+                      out_result);
   SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type,
                    base::TimeTicks::Now() - start);
   SIMPLE_CACHE_UMA(COUNTS, "IndexEntriesRestored", cache_type,
@@ -342,118 +786,217 @@ void SimpleIndexFile::SyncLoadIndexEntries(
 }
 
 // static
-void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
-                                       base::Time* out_last_cache_seen_by_index,
-                                       SimpleIndexLoadResult* out_result) {
-  out_result->Reset();
-
+scoped_refptr<SimpleMappedIndex> SimpleIndexFile::SyncMapIndex(
+    const base::FilePath& index_filename,
+    const base::FilePath& log_filename,
+    const scoped_refptr<base::TaskRunner>& close_runner,
+    base::Time* out_last_cache_seen_by_index,
+    bool* out_flush_required) {
   File file(index_filename,
             File::FLAG_OPEN | File::FLAG_READ | File::FLAG_SHARE_DELETE);
   if (!file.IsValid())
-    return;
+    return NULL;
 
-  base::MemoryMappedFile index_file_map;
-  if (!index_file_map.Initialize(file.Pass())) {
+  scoped_ptr<base::MemoryMappedFile> index_file_map(
+      new base::MemoryMappedFile());
+  if (!index_file_map->Initialize(file.Pass())) {
     simple_util::SimpleCacheDeleteFile(index_filename);
-    return;
+    return NULL;
   }
 
-  SimpleIndexFile::Deserialize(
-      reinterpret_cast<const char*>(index_file_map.data()),
-      index_file_map.length(),
-      out_last_cache_seen_by_index,
-      out_result);
-
-  if (!out_result->did_load)
+  scoped_refptr<SimpleMappedIndex> mapped_index =
+      SimpleMappedIndex::Map(index_file_map.Pass(), close_runner);
+  if (!mapped_index.get()) {
     simple_util::SimpleCacheDeleteFile(index_filename);
+    return NULL;
+  }
+  *out_last_cache_seen_by_index = mapped_index->cache_last_modified();
+
+  File log_file(log_filename,
+                File::FLAG_OPEN | File::FLAG_READ | File::FLAG_SHARE_DELETE);
+  if (!log_file.IsValid())
+    return mapped_index;
+  base::MemoryMappedFile log_file_map;
+  if (!log_file_map.Initialize(log_file.Pass()))
+    return mapped_index;
+  SimpleMappedIndex::LogChanges log_changes;
+  *out_flush_required =
+      !ReplayLog(reinterpret_cast<const char*>(log_file_map.data()),
+                 log_file_map.length(), mapped_index->crc(),
+                 mapped_index->size(), out_last_cache_seen_by_index,
+                 &log_changes);
+  mapped_index->SetLogChanges(&log_changes);
+  return mapped_index;
 }
 
 // static
 scoped_ptr<Pickle> SimpleIndexFile::Serialize(
     const SimpleIndexFile::IndexMetadata& index_metadata,
-    const SimpleIndex::EntrySet& entries) {
+    const SimpleIndex::EntrySet& entries,
+    const SimpleIndex::SlabAddressMap& slab_addresses) {
   scoped_ptr<Pickle> pickle(new Pickle(sizeof(SimpleIndexFile::PickleHeader)));
 
   index_metadata.Serialize(pickle.get());
-  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
-       it != entries.end(); ++it) {
-    pickle->WriteUInt64(it->first);
-    it->second.Serialize(pickle.get());
+  const std::vector<SimpleIndex::EntrySet::const_iterator> sorted_entries =
+      SortByKey(entries);
+  for (size_t i = 0; i < sorted_entries.size(); ++i) {
+    pickle->WriteUInt64(sorted_entries[i]->first);
+    sorted_entries[i]->second.Serialize(pickle.get());
+  }
+  const std::vector<SimpleIndex::SlabAddressMap::const_iterator>
+      sorted_slab_addresses = SortByKey(slab_addresses);
+  pickle->WriteUInt64(sorted_slab_addresses.size());
+  for (size_t i = 0; i < sorted_slab_addresses.size(); ++i) {
+    pickle->WriteUInt64(sorted_slab_addresses[i]->first);
+    SerializeSlabAddress(sorted_slab_addresses[i]->second, pickle.get());
   }
   return pickle.Pass();
 }
 
 // static
-void SimpleIndexFile::Deserialize(const char* data, int data_len,
-                                  base::Time* out_cache_last_modified,
-                                  SimpleIndexLoadResult* out_result) {
-  DCHECK(data);
-
-  out_result->Reset();
-  SimpleIndex::EntrySet* entries = &out_result->entries;
-
-  Pickle pickle(data, data_len);
-  if (!pickle.data()) {
-    LOG(WARNING) << "Corrupt Simple Index File.";
-    return;
-  }
-
-  PickleIterator pickle_it(pickle);
-  SimpleIndexFile::PickleHeader* header_p =
-      pickle.headerT<SimpleIndexFile::PickleHeader>();
-  const uint32 crc_read = header_p->crc;
-  const uint32 crc_calculated = CalculatePickleCRC(pickle);
+scoped_ptr<Pickle> SimpleIndexFile::SerializeChanges(
+    const SimpleIndex::EntrySet& entries,
+    const SimpleIndex::SlabAddressMap& slab_addresses,
+    const base::hash_set<uint64>& changed_entries) {
+  scoped_ptr<Pickle> pickle(new Pickle(sizeof(SimpleIndexFile::PickleHeader)));
 
-  if (crc_read != crc_calculated) {
-    LOG(WARNING) << "Invalid CRC in Simple Index file.";
-    return;
+  pickle->WriteUInt64(changed_entries.size());
+  for (base::hash_set<uint64>::const_iterator it = changed_entries.begin();
+       it != changed_entries.end(); ++it) {
+    pickle->WriteUInt64(*it);
+    SimpleIndex::EntrySet::const_iterator found = entries.find(*it);
+    pickle->WriteBool(found != entries.end());
+    if (found == entries.end())
+      continue;
+    found->second.Serialize(pickle.get());
+    SimpleIndex::SlabAddressMap::const_iterator slab_address =
+        slab_addresses.find(*it);
+    SerializeSlabAddress(slab_address == slab_addresses.end()
+                             ? SimpleSlabAddress()
+                             : slab_address->second,
+                         pickle.get());
   }
+  return pickle.Pass();
+}
 
-  SimpleIndexFile::IndexMetadata index_metadata;
-  if (!index_metadata.Deserialize(&pickle_it)) {
-    LOG(ERROR) << "Invalid index_metadata on Simple Cache Index.";
-    return;
+// static
+bool SimpleIndexFile::ReplayLog(const char* data,
+                                int data_len,
+                                uint32 index_crc,
+                                size_t index_size,
+                                base::Time* out_cache_last_modified,
+                                SimpleMappedIndex::LogChanges* out_log_changes) {
+  const char* const end = data + data_len;
+  const char* next = FindPickleEnd(sizeof(PickleHeader), data, end);
+  if (!next)
+    return true;
+  Pickle log_header(data, next - data);
+  PickleIterator log_header_it(log_header);
+  uint64 magic_number;
+  uint32 version;
+  uint32 log_index_crc;
+  uint64 log_index_size;
+  if (!log_header.data() ||
+      log_header.headerT<PickleHeader>()->crc !=
+          CalculatePickleCRC(log_header) ||
+      !log_header_it.ReadUInt64(&magic_number) ||
+      !log_header_it.ReadUInt32(&version) ||
+      !log_header_it.ReadUInt32(&log_index_crc) ||
+      !log_header_it.ReadUInt64(&log_index_size) ||
+      magic_number != kSimpleIndexLogMagicNumber ||
+      version != kSimpleVersion || log_index_crc != index_crc ||
+      log_index_size != index_size) {
+    // The log of an older index file, left behind by a crash.
+    return true;
   }
 
-  if (!index_metadata.CheckIndexMetadata()) {
-    LOG(ERROR) << "Invalid index_metadata on Simple Cache Index.";
-    return;
-  }
+  while (next != end) {
+    const char* batch_start = next;
+    next = FindPickleEnd(sizeof(PickleHeader), batch_start, end);
+    if (!next) {
+      LOG(WARNING) << "Torn batch at the end of the Simple Index log.";
+      return false;
+    }
+    Pickle batch(batch_start, next - batch_start);
+    if (!batch.data() ||
+        batch.headerT<PickleHeader>()->crc != CalculatePickleCRC(batch)) {
+      LOG(WARNING) << "Invalid CRC in Simple Index log.";
+      return false;
+    }
+    // The batch is checked as a whole before any of it is applied.
+    PickleIterator batch_it(batch);
+    uint64 number_of_changes;
+    if (!batch_it.ReadUInt64(&number_of_changes) ||
+        number_of_changes > kMaxEntiresInIndex) {
+      return false;
+    }
+    std::vector<std::pair<uint64, EntryMetadata> > changes;
+    std::vector<SimpleSlabAddress> change_slab_addresses;
+    std::vector<uint64> removals;
+    for (uint64 i = 0; i < number_of_changes; ++i) {
+      uint64 hash_key;
+      bool present;
+      if (!batch_it.ReadUInt64(&hash_key) || !batch_it.ReadBool(&present)) {
+        return false;
+      }
+      if (!present) {
+        removals.push_back(hash_key);
+        continue;
+      }
+      EntryMetadata entry_metadata;
+      SimpleSlabAddress slab_address;
+      if (!entry_metadata.Deserialize(&batch_it) ||
+          !DeserializeSlabAddress(&batch_it, &slab_address)) {
+        return false;
+      }
+      changes.push_back(std::make_pair(hash_key, entry_metadata));
+      change_slab_addresses.push_back(slab_address);
+    }
+    int64 cache_last_modified;
+    if (!batch_it.ReadInt64(&cache_last_modified)) {
+      return false;
+    }
 
-#if !defined(OS_WIN)
-  // TODO(gavinp): Consider using std::unordered_map.
-  entries->resize(index_metadata.GetNumberOfEntries() + kExtraSizeForMerge);
-#endif
-  while (entries->size() < index_metadata.GetNumberOfEntries()) {
-    uint64 hash_key;
-    EntryMetadata entry_metadata;
-    if (!pickle_it.ReadUInt64(&hash_key) ||
-        !entry_metadata.Deserialize(&pickle_it)) {
-      LOG(WARNING) << "Invalid EntryMetadata in Simple Index file.";
-      entries->clear();
-      return;
+    for (size_t i = 0; i < removals.size(); ++i)
+      (*out_log_changes)[removals[i]] = SimpleMappedIndex::LogChange();
+    for (size_t i = 0; i < changes.size(); ++i) {
+      SimpleMappedIndex::LogChange* change =
+          &(*out_log_changes)[changes[i].first];
+      change->present = true;
+      change->entry_metadata = changes[i].second;
+      change->slab_address = change_slab_addresses[i];
     }
-    SimpleIndex::InsertInEntrySet(hash_key, entry_metadata, entries);
+    *out_cache_last_modified =
+        base::Time::FromInternalValue(cache_last_modified);
   }
+  return true;
+}
 
-  int64 cache_last_modified;
-  if (!pickle_it.ReadInt64(&cache_last_modified)) {
-    entries->clear();
+// static
+void SimpleIndexFile::Deserialize(const char* data, int data_len,
+                                  base::Time* out_cache_last_modified,
+                                  SimpleIndexLoadResult* out_result) {
+  DCHECK(data);
+
+  out_result->Reset();
+  scoped_refptr<SimpleMappedIndex> mapped_index =
+      SimpleMappedIndex::Read(data, data_len);
+  if (!mapped_index.get())
     return;
-  }
+  mapped_index->GetEntries(out_result);
   DCHECK(out_cache_last_modified);
-  *out_cache_last_modified = base::Time::FromInternalValue(cache_last_modified);
-
-  out_result->did_load = true;
+  *out_cache_last_modified = mapped_index->cache_last_modified();
 }
 
 // static
 void SimpleIndexFile::SyncRestoreFromDisk(
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    const base::FilePath& log_file_path,
     SimpleIndexLoadResult* out_result) {
   VLOG(1) << "Simple Cache Index is being restored from disk.";
   simple_util::SimpleCacheDeleteFile(index_file_path);
+  simple_util::SimpleCacheDeleteFile(log_file_path);
   out_result->Reset();
   SimpleIndex::EntrySet* entries = &out_result->entries;
 
@@ -463,6 +1006,11 @@ void SimpleIndexFile::SyncRestoreFromDisk(
     LOG(ERROR) << "Could not reconstruct index from disk";
     return;
   }
+  base::hash_map<uint64, uint64> slab_record_sequences;
+  SimpleSlabStore::ScanRecords(
+      cache_directory,
+      base::Bind(&ProcessSlabRecord, entries, &out_result->slab_addresses,
+                 &slab_record_sequences));
   out_result->did_load = true;
   // When we restore from disk we write the merged index file to disk right
   // away, this might save us from having to restore again next time.
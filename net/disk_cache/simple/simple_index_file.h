@@ -13,6 +13,7 @@
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/port.h"
@@ -21,6 +22,7 @@
 #include "net/disk_cache/simple/simple_index.h"
 
 namespace base {
+class MemoryMappedFile;
 class SingleThreadTaskRunner;
 class TaskRunner;
 }
@@ -28,6 +30,7 @@ class TaskRunner;
 namespace disk_cache {
 
 const uint64 kSimpleIndexMagicNumber = GG_UINT64_C(0x656e74657220796f);
+const uint64 kSimpleIndexLogMagicNumber = GG_UINT64_C(0x6c6f67206f662069);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   SimpleIndexLoadResult();
@@ -36,15 +39,107 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 
   bool did_load;
   SimpleIndex::EntrySet entries;
+  SimpleIndex::SlabAddressMap slab_addresses;
   bool flush_required;
 };
 
+// A view of an index file that is mapped in memory, with its log replayed on
+// top, which answers lookups while the index is still being loaded from it.
+// SimpleIndexFile::Serialize() writes the entries and their slab addresses as
+// records of a fixed size, in the order of their hashes, so that a lookup is a
+// binary search of the mapped file. The view is made on a worker thread, and
+// does not change once it is handed to the IO thread.
+class NET_EXPORT_PRIVATE SimpleMappedIndex
+    : public base::RefCountedThreadSafe<SimpleMappedIndex> {
+ public:
+  // What the log says about an entry. An entry that was removed is not
+  // |present|.
+  struct NET_EXPORT_PRIVATE LogChange {
+    LogChange();
+
+    bool present;
+    EntryMetadata entry_metadata;
+    SimpleSlabAddress slab_address;
+  };
+  typedef base::hash_map<uint64, LogChange> LogChanges;
+
+  // Returns a view of the index file in |index_file_map|, or NULL if the file
+  // is corrupt. The file is closed on |close_runner|, since the last reference
+  // to the view can go on a thread that does not allow IO.
+  static scoped_refptr<SimpleMappedIndex> Map(
+      scoped_ptr<base::MemoryMappedFile> index_file_map,
+      const scoped_refptr<base::TaskRunner>& close_runner);
+
+  // Like Map(), for the index file |data| of length |data_len|, which has to
+  // outlive the view.
+  static scoped_refptr<SimpleMappedIndex> Read(const char* data, int data_len);
+
+  // Replays |log_changes| on top of the index file, taking its contents. Only
+  // before the view is shared.
+  void SetLogChanges(LogChanges* log_changes);
+
+  // Returns whether the entry |entry_hash| is in the index, in which case
+  // |*out_entry_metadata| and |*out_slab_address| are set unless they are
+  // NULL. Only if in_order().
+  bool Find(uint64 entry_hash,
+            EntryMetadata* out_entry_metadata,
+            SimpleSlabAddress* out_slab_address) const;
+
+  // Reads all the entries into |out_result|.
+  void GetEntries(SimpleIndexLoadResult* out_result) const;
+
+  // Whether the records are in the order of their hashes, which they are not
+  // in the index files written before they were sorted.
+  bool in_order() const { return in_order_; }
+
+  uint32 crc() const { return crc_; }
+  size_t size() const { return size_; }
+  base::Time cache_last_modified() const { return cache_last_modified_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<SimpleMappedIndex>;
+
+  SimpleMappedIndex(scoped_ptr<base::MemoryMappedFile> index_file_map,
+                    const scoped_refptr<base::TaskRunner>& close_runner);
+  ~SimpleMappedIndex();
+
+  // Checks the index file |data|, and finds the records in it.
+  bool Init(const char* data, int data_len);
+
+  scoped_ptr<base::MemoryMappedFile> index_file_map_;
+  const scoped_refptr<base::TaskRunner> close_runner_;
+
+  const char* entries_;
+  uint64 number_of_entries_;
+  const char* slab_addresses_;
+  uint64 number_of_slab_addresses_;
+  bool in_order_;
+  uint32 crc_;
+  size_t size_;
+  base::Time cache_last_modified_;
+
+  LogChanges log_changes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleMappedIndex);
+};
+
 // Simple Index File format is a pickle serialized data of IndexMetadata and
 // EntryMetadata objects. The file format is as follows: one instance of
 // serialized |IndexMetadata| followed serialized |EntryMetadata| entries
-// repeated |number_of_entries| amount of times. To know more about the format,
-// see SimpleIndexFile::Serialize() and SeeSimpleIndexFile::LoadFromDisk()
-// methods.
+// repeated |number_of_entries| amount of times, then the number of entries that
+// are in slab files and the slab address of each of them. To know more about
+// the format, see SimpleIndexFile::Serialize() and
+// SeeSimpleIndexFile::LoadFromDisk() methods.
+//
+// Between two writes of the whole index file, the entries that changed are
+// appended to a log next to it instead, which is replayed on top of the index
+// file when it is loaded. The log starts with a pickle that names the index
+// file it belongs to by its CRC and size; each batch of changes is a pickle
+// of its own, so that a write torn by a crash only loses the last batch. See
+// SimpleIndexFile::SerializeChanges() and SimpleIndexFile::ReplayLog().
+//
+// The entries and slab addresses are written in the order of their hashes, so
+// that SimpleMappedIndex can look them up before the index file is loaded.
 //
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
@@ -81,19 +176,32 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_directory);
   virtual ~SimpleIndexFile();
 
-  // Get index entries based on current disk context.
-  virtual void LoadIndexEntries(base::Time cache_last_modified,
-                                const base::Closure& callback,
-                                SimpleIndexLoadResult* out_result);
-
-  // Write the specified set of entries to disk.
+  typedef base::Callback<void(const scoped_refptr<SimpleMappedIndex>&)>
+      MappedIndexCallback;
+
+  // Get index entries based on current disk context. If the index file is
+  // fresh, |mapped_index_callback| is run on this thread with a view of it
+  // before its entries are read, and so before |callback|.
+  virtual void LoadIndexEntries(
+      base::Time cache_last_modified,
+      const MappedIndexCallback& mapped_index_callback,
+      const base::Closure& callback,
+      SimpleIndexLoadResult* out_result);
+
+  // Write the specified set of entries to disk. If |changed_entries| is not
+  // NULL, it holds the entries that changed since the last write, and only
+  // those are appended to the log, unless the log has grown too large.
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const SimpleIndex::SlabAddressMap& slab_addresses,
+                           const base::hash_set<uint64>* changed_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background,
                            const base::Closure& callback);
 
  private:
+  friend class SimpleIndexTest;
+  friend class SimpleMappedIndex;
   friend class WrappedSimpleIndexFile;
 
   // Used for cache directory traversal.
@@ -103,17 +211,33 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // prevent reallocation on the IO thread when merging in new live entries.
   static const int kExtraSizeForMerge = 512;
 
-  // Synchronous (IO performing) implementation of LoadIndexEntries.
-  static void SyncLoadIndexEntries(net::CacheType cache_type,
-                                   base::Time cache_last_modified,
-                                   const base::FilePath& cache_directory,
-                                   const base::FilePath& index_file_path,
-                                   SimpleIndexLoadResult* out_result);
+  // The whole index file is written again once the log holds more changes
+  // than this, or than half the entries.
+  static const size_t kMinChangesToRewrite = 1024;
 
-  // Load the index file from disk returning an EntrySet.
-  static void SyncLoadFromDisk(const base::FilePath& index_filename,
-                               base::Time* out_last_cache_seen_by_index,
-                               SimpleIndexLoadResult* out_result);
+  // Synchronous (IO performing) implementation of LoadIndexEntries. The view
+  // of the index file is handed to |mapped_index_callback| on
+  // |mapped_index_runner|, and closed on |close_runner|.
+  static void SyncLoadIndexEntries(
+      net::CacheType cache_type,
+      base::Time cache_last_modified,
+      const base::FilePath& cache_directory,
+      const base::FilePath& index_file_path,
+      const base::FilePath& log_file_path,
+      const scoped_refptr<base::TaskRunner>& close_runner,
+      const scoped_refptr<base::SingleThreadTaskRunner>& mapped_index_runner,
+      const MappedIndexCallback& mapped_index_callback,
+      SimpleIndexLoadResult* out_result);
+
+  // Maps the index file, and replays the log at |log_filename| on top of it.
+  // Returns NULL if there is no valid index file. Sets |*out_flush_required|
+  // if the log ends in a torn batch.
+  static scoped_refptr<SimpleMappedIndex> SyncMapIndex(
+      const base::FilePath& index_filename,
+      const base::FilePath& log_filename,
+      const scoped_refptr<base::TaskRunner>& close_runner,
+      base::Time* out_last_cache_seen_by_index,
+      bool* out_flush_required);
 
   // Returns a scoped_ptr for a newly allocated Pickle containing the serialized
   // data to be written to a file. Note: the pickle is not in a consistent state
@@ -121,7 +245,8 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // SerializeFinalData to make it ready to write to a file.
   static scoped_ptr<Pickle> Serialize(
       const SimpleIndexFile::IndexMetadata& index_metadata,
-      const SimpleIndex::EntrySet& entries);
+      const SimpleIndex::EntrySet& entries,
+      const SimpleIndex::SlabAddressMap& slab_addresses);
 
   // Appends cache modification time data to the serialized format. This is
   // performed on a thread accessing the disk. It is not combined with the main
@@ -129,6 +254,26 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // worker thread.
   static bool SerializeFinalData(base::Time cache_modified, Pickle* pickle);
 
+  // Returns a pickle that holds the entries in |changed_entries|, as they are
+  // in |entries|, and the ones that are not there any more. Like for
+  // Serialize(), SerializeFinalData() finishes it.
+  static scoped_ptr<Pickle> SerializeChanges(
+      const SimpleIndex::EntrySet& entries,
+      const SimpleIndex::SlabAddressMap& slab_addresses,
+      const base::hash_set<uint64>& changed_entries);
+
+  // Collects the batches of changes in the log |data| of length |data_len| in
+  // |out_log_changes|, if the log belongs to the index file whose CRC is
+  // |index_crc| and whose size is |index_size|. Updates
+  // |*out_cache_last_modified| with each batch. Returns false if the log ends
+  // in a torn batch, which requires a flush.
+  static bool ReplayLog(const char* data,
+                        int data_len,
+                        uint32 index_crc,
+                        size_t index_size,
+                        base::Time* out_cache_last_modified,
+                        SimpleMappedIndex::LogChanges* out_log_changes);
+
   // Given the contents of an index file |data| of length |data_len|, returns
   // the corresponding EntrySet. Returns NULL on error.
   static void Deserialize(const char* data, int data_len,
@@ -144,19 +289,28 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_path,
       const EntryFileCallback& entry_file_callback);
 
-  // Writes the index file to disk atomically.
+  // Writes the index file to disk atomically, and starts a new log for it.
   static void SyncWriteToDisk(net::CacheType cache_type,
                               const base::FilePath& cache_directory,
                               const base::FilePath& index_filename,
                               const base::FilePath& temp_index_filename,
+                              const base::FilePath& log_filename,
                               scoped_ptr<Pickle> pickle,
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Appends the batch of changes |pickle| to the log. If that fails, the
+  // index file no longer describes the cache, and is deleted.
+  static void SyncAppendToLog(const base::FilePath& cache_directory,
+                              const base::FilePath& index_filename,
+                              const base::FilePath& log_filename,
+                              scoped_ptr<Pickle> pickle);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
                                   const base::FilePath& index_file_path,
+                                  const base::FilePath& log_file_path,
                                   SimpleIndexLoadResult* out_result);
 
   // Determines if an index file is stale relative to the time of last
@@ -176,10 +330,18 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   const base::FilePath cache_directory_;
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
+  const base::FilePath log_file_;
+
+  // Whether the whole index file has been written since this was created, so
+  // that changes can be appended to the log.
+  bool can_append_to_log_;
+  // The number of changes appended to the log since then.
+  size_t changes_in_log_;
 
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
   static const char kTempIndexFileName[];
+  static const char kLogFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
 };
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
@@ -71,6 +72,7 @@ class WrappedSimpleIndexFile : public SimpleIndexFile {
  public:
   using SimpleIndexFile::Deserialize;
   using SimpleIndexFile::LegacyIsIndexFileStale;
+  using SimpleIndexFile::PickleHeader;
   using SimpleIndexFile::Serialize;
   using SimpleIndexFile::SerializeFinalData;
 
@@ -85,6 +87,10 @@ class WrappedSimpleIndexFile : public SimpleIndexFile {
     return index_file_;
   }
 
+  const base::FilePath& GetLogFilePath() const {
+    return log_file_;
+  }
+
   bool CreateIndexFileDirectory() const {
     return base::CreateDirectory(index_file_.DirName());
   }
@@ -113,9 +119,11 @@ TEST_F(SimpleIndexFileTest, Serialize) {
     metadata_entries[i] = EntryMetadata(Time(), hash);
     SimpleIndex::InsertInEntrySet(hash, metadata_entries[i], &entries);
   }
+  SimpleIndex::SlabAddressMap slab_addresses;
+  slab_addresses[kHashes[1]] = SimpleSlabAddress(3, 4096);
 
   scoped_ptr<Pickle> pickle = WrappedSimpleIndexFile::Serialize(
-      index_metadata, entries);
+      index_metadata, entries, slab_addresses);
   EXPECT_TRUE(pickle.get() != NULL);
   base::Time now = base::Time::Now();
   EXPECT_TRUE(WrappedSimpleIndexFile::SerializeFinalData(now, pickle.get()));
@@ -135,6 +143,9 @@ TEST_F(SimpleIndexFileTest, Serialize) {
     EXPECT_TRUE(new_entries.end() != it);
     EXPECT_TRUE(CompareTwoEntryMetadata(it->second, metadata_entries[i]));
   }
+  ASSERT_EQ(1U, deserialize_result.slab_addresses.size());
+  EXPECT_TRUE(SimpleSlabAddress(3, 4096) ==
+              deserialize_result.slab_addresses[kHashes[1]]);
 }
 
 TEST_F(SimpleIndexFileTest, LegacyIsIndexFileStale) {
@@ -188,8 +199,9 @@ TEST_F(SimpleIndexFileTest, WriteThenLoadIndex) {
   net::TestClosure closure;
   {
     WrappedSimpleIndexFile simple_index_file(cache_dir.path());
-    simple_index_file.WriteToDisk(entries, kCacheSize, base::TimeTicks(),
-                                  false, closure.closure());
+    simple_index_file.WriteToDisk(entries, SimpleIndex::SlabAddressMap(), NULL,
+                                  kCacheSize, base::TimeTicks(), false,
+                                  closure.closure());
     closure.WaitForResult();
     EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
   }
@@ -198,8 +210,9 @@ TEST_F(SimpleIndexFileTest, WriteThenLoadIndex) {
   base::Time fake_cache_mtime;
   ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
   SimpleIndexLoadResult load_index_result;
-  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
-                                     &load_index_result);
+  simple_index_file.LoadIndexEntries(fake_cache_mtime,
+                                     SimpleIndexFile::MappedIndexCallback(),
+                                     closure.closure(), &load_index_result);
   closure.WaitForResult();
 
   EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
@@ -211,6 +224,278 @@ TEST_F(SimpleIndexFileTest, WriteThenLoadIndex) {
     EXPECT_EQ(1U, load_index_result.entries.count(kHashes[i]));
 }
 
+// Writes |entries| and |slab_addresses| with |simple_index_file|, and waits for
+// it. Only the changes in |changed_entries| may be written, if it is not NULL.
+void WriteEntries(const SimpleIndex::EntrySet& entries,
+                  const SimpleIndex::SlabAddressMap& slab_addresses,
+                  const base::hash_set<uint64>* changed_entries,
+                  WrappedSimpleIndexFile* simple_index_file) {
+  net::TestClosure closure;
+  simple_index_file->WriteToDisk(entries, slab_addresses, changed_entries, 0,
+                                 base::TimeTicks(), false, closure.closure());
+  closure.WaitForResult();
+}
+
+void LoadEntries(const base::FilePath& cache_path,
+                 SimpleIndexLoadResult* out_result) {
+  WrappedSimpleIndexFile simple_index_file(cache_path);
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_path, &fake_cache_mtime));
+  net::TestClosure closure;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime,
+                                     SimpleIndexFile::MappedIndexCallback(),
+                                     closure.closure(), out_result);
+  closure.WaitForResult();
+}
+
+TEST_F(SimpleIndexFileTest, AppendThenLoadIndex) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  SimpleIndex::EntrySet entries;
+  for (uint64 hash = 1; hash <= 3; ++hash)
+    SimpleIndex::InsertInEntrySet(hash, EntryMetadata(Time(), 100), &entries);
+  SimpleIndex::SlabAddressMap slab_addresses;
+  slab_addresses[3] = SimpleSlabAddress(1, 0);
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_path);
+    // The first write is always of the whole index file.
+    base::hash_set<uint64> changed_entries;
+    changed_entries.insert(1);
+    WriteEntries(entries, slab_addresses, &changed_entries,
+                 &simple_index_file);
+    std::string log_contents;
+    ASSERT_TRUE(base::ReadFileToString(simple_index_file.GetLogFilePath(),
+                                       &log_contents));
+
+    // Then only the changes are appended to the log.
+    std::string index_contents;
+    ASSERT_TRUE(base::ReadFileToString(simple_index_file.GetIndexFilePath(),
+                                       &index_contents));
+    entries[1].SetEntrySize(200);
+    entries.erase(2);
+    SimpleIndex::InsertInEntrySet(4, EntryMetadata(Time(), 400), &entries);
+    slab_addresses[1] = SimpleSlabAddress(2, 64);
+    changed_entries.insert(2);
+    changed_entries.insert(4);
+    WriteEntries(entries, slab_addresses, &changed_entries,
+                 &simple_index_file);
+    std::string new_index_contents;
+    ASSERT_TRUE(base::ReadFileToString(simple_index_file.GetIndexFilePath(),
+                                       &new_index_contents));
+    EXPECT_EQ(index_contents, new_index_contents);
+    std::string new_log_contents;
+    ASSERT_TRUE(base::ReadFileToString(simple_index_file.GetLogFilePath(),
+                                       &new_log_contents));
+    EXPECT_LT(log_contents.size(), new_log_contents.size());
+  }
+
+  SimpleIndexLoadResult load_index_result;
+  LoadEntries(cache_path, &load_index_result);
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.flush_required);
+  ASSERT_EQ(3U, load_index_result.entries.size());
+  EXPECT_EQ(200U, load_index_result.entries[1].GetEntrySize());
+  EXPECT_EQ(0U, load_index_result.entries.count(2));
+  EXPECT_EQ(100U, load_index_result.entries[3].GetEntrySize());
+  EXPECT_EQ(400U, load_index_result.entries[4].GetEntrySize());
+  ASSERT_EQ(2U, load_index_result.slab_addresses.size());
+  EXPECT_TRUE(SimpleSlabAddress(2, 64) == load_index_result.slab_addresses[1]);
+  EXPECT_TRUE(SimpleSlabAddress(1, 0) == load_index_result.slab_addresses[3]);
+}
+
+TEST_F(SimpleIndexFileTest, LoadTornLog) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(1, EntryMetadata(Time(), 100), &entries);
+  base::FilePath log_path;
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_path);
+    log_path = simple_index_file.GetLogFilePath();
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), NULL,
+                 &simple_index_file);
+    base::hash_set<uint64> changed_entries;
+    changed_entries.insert(2);
+    SimpleIndex::InsertInEntrySet(2, EntryMetadata(Time(), 200), &entries);
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), &changed_entries,
+                 &simple_index_file);
+    changed_entries.clear();
+    changed_entries.insert(3);
+    SimpleIndex::InsertInEntrySet(3, EntryMetadata(Time(), 300), &entries);
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), &changed_entries,
+                 &simple_index_file);
+  }
+
+  // Tear the last batch of changes.
+  std::string log_contents;
+  ASSERT_TRUE(base::ReadFileToString(log_path, &log_contents));
+  log_contents.resize(log_contents.size() - 3);
+  ASSERT_EQ(static_cast<int>(log_contents.size()),
+            base::WriteFile(log_path, log_contents.data(),
+                            log_contents.size()));
+
+  SimpleIndexLoadResult load_index_result;
+  LoadEntries(cache_path, &load_index_result);
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_TRUE(load_index_result.flush_required);
+  EXPECT_EQ(2U, load_index_result.entries.size());
+  EXPECT_EQ(1U, load_index_result.entries.count(2));
+  EXPECT_EQ(0U, load_index_result.entries.count(3));
+}
+
+// The log of an older index file is not replayed on a newer one.
+TEST_F(SimpleIndexFileTest, IgnoreLogOfOtherIndex) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(1, EntryMetadata(Time(), 100), &entries);
+  base::FilePath log_path;
+  std::string old_log_contents;
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_path);
+    log_path = simple_index_file.GetLogFilePath();
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), NULL,
+                 &simple_index_file);
+    base::hash_set<uint64> changed_entries;
+    changed_entries.insert(2);
+    SimpleIndex::InsertInEntrySet(2, EntryMetadata(Time(), 200), &entries);
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), &changed_entries,
+                 &simple_index_file);
+    ASSERT_TRUE(base::ReadFileToString(log_path, &old_log_contents));
+
+    entries.erase(2);
+    entries[1].SetEntrySize(150);
+    WriteEntries(entries, SimpleIndex::SlabAddressMap(), NULL,
+                 &simple_index_file);
+  }
+  ASSERT_EQ(static_cast<int>(old_log_contents.size()),
+            base::WriteFile(log_path, old_log_contents.data(),
+                            old_log_contents.size()));
+
+  SimpleIndexLoadResult load_index_result;
+  LoadEntries(cache_path, &load_index_result);
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.flush_required);
+  ASSERT_EQ(1U, load_index_result.entries.size());
+  EXPECT_EQ(150U, load_index_result.entries[1].GetEntrySize());
+}
+
+void StoreMappedIndex(scoped_refptr<SimpleMappedIndex>* out_mapped_index,
+                      const scoped_refptr<SimpleMappedIndex>& mapped_index) {
+  EXPECT_FALSE(out_mapped_index->get());
+  *out_mapped_index = mapped_index;
+}
+
+// Before the entries are loaded, the index gets a view of the index file with
+// the log replayed on top, which finds the same entries.
+TEST_F(SimpleIndexFileTest, MappedIndexBeforeLoad) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath cache_path = cache_dir.path();
+
+  SimpleIndex::EntrySet entries;
+  for (uint64 hash = 1; hash <= 3; ++hash)
+    SimpleIndex::InsertInEntrySet(hash, EntryMetadata(Time(), 100), &entries);
+  SimpleIndex::SlabAddressMap slab_addresses;
+  slab_addresses[3] = SimpleSlabAddress(1, 0);
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_path);
+    WriteEntries(entries, slab_addresses, NULL, &simple_index_file);
+    base::hash_set<uint64> changed_entries;
+    entries[1].SetEntrySize(200);
+    entries.erase(2);
+    SimpleIndex::InsertInEntrySet(4, EntryMetadata(Time(), 400), &entries);
+    slab_addresses[1] = SimpleSlabAddress(2, 64);
+    changed_entries.insert(1);
+    changed_entries.insert(2);
+    changed_entries.insert(4);
+    WriteEntries(entries, slab_addresses, &changed_entries,
+                 &simple_index_file);
+  }
+
+  WrappedSimpleIndexFile simple_index_file(cache_path);
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_path, &fake_cache_mtime));
+  scoped_refptr<SimpleMappedIndex> mapped_index;
+  SimpleIndexLoadResult load_index_result;
+  net::TestClosure closure;
+  simple_index_file.LoadIndexEntries(
+      fake_cache_mtime, base::Bind(&StoreMappedIndex, &mapped_index),
+      closure.closure(), &load_index_result);
+  closure.WaitForResult();
+
+  ASSERT_TRUE(mapped_index.get());
+  EXPECT_TRUE(mapped_index->in_order());
+  EntryMetadata entry_metadata;
+  SimpleSlabAddress slab_address;
+  ASSERT_TRUE(mapped_index->Find(1, &entry_metadata, &slab_address));
+  EXPECT_EQ(200U, entry_metadata.GetEntrySize());
+  EXPECT_TRUE(SimpleSlabAddress(2, 64) == slab_address);
+  EXPECT_FALSE(mapped_index->Find(2, NULL, NULL));
+  ASSERT_TRUE(mapped_index->Find(3, &entry_metadata, &slab_address));
+  EXPECT_EQ(100U, entry_metadata.GetEntrySize());
+  EXPECT_TRUE(SimpleSlabAddress(1, 0) == slab_address);
+  ASSERT_TRUE(mapped_index->Find(4, &entry_metadata, &slab_address));
+  EXPECT_EQ(400U, entry_metadata.GetEntrySize());
+  EXPECT_FALSE(slab_address.is_valid());
+  EXPECT_FALSE(mapped_index->Find(5, NULL, NULL));
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_EQ(3U, load_index_result.entries.size());
+  EXPECT_EQ(2U, load_index_result.slab_addresses.size());
+}
+
+// Index files written before the records were sorted still load, but do not
+// answer lookups before they are loaded.
+TEST_F(SimpleIndexFileTest, LoadUnsortedIndex) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+  ASSERT_TRUE(simple_index_file.CreateIndexFileDirectory());
+  Pickle pickle(sizeof(WrappedSimpleIndexFile::PickleHeader));
+  SimpleIndexFile::IndexMetadata(2, 300).Serialize(&pickle);
+  pickle.WriteUInt64(22);
+  EntryMetadata(Time(), 200).Serialize(&pickle);
+  pickle.WriteUInt64(11);
+  EntryMetadata(Time(), 100).Serialize(&pickle);
+  pickle.WriteUInt64(0);
+  ASSERT_TRUE(
+      WrappedSimpleIndexFile::SerializeFinalData(Time::Now(), &pickle));
+
+  scoped_refptr<SimpleMappedIndex> mapped_index = SimpleMappedIndex::Read(
+      static_cast<const char*>(pickle.data()), pickle.size());
+  ASSERT_TRUE(mapped_index.get());
+  EXPECT_FALSE(mapped_index->in_order());
+
+  const base::FilePath& index_path = simple_index_file.GetIndexFilePath();
+  ASSERT_EQ(static_cast<int>(pickle.size()),
+            base::WriteFile(index_path, static_cast<const char*>(pickle.data()),
+                            pickle.size()));
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  scoped_refptr<SimpleMappedIndex> handed_mapped_index;
+  SimpleIndexLoadResult load_index_result;
+  net::TestClosure closure;
+  simple_index_file.LoadIndexEntries(
+      fake_cache_mtime, base::Bind(&StoreMappedIndex, &handed_mapped_index),
+      closure.closure(), &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_FALSE(handed_mapped_index.get());
+  EXPECT_TRUE(base::PathExists(index_path));
+  EXPECT_TRUE(load_index_result.did_load);
+  ASSERT_EQ(2U, load_index_result.entries.size());
+  EXPECT_EQ(100U, load_index_result.entries[11].GetEntrySize());
+  EXPECT_EQ(200U, load_index_result.entries[22].GetEntrySize());
+}
+
 TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
   base::ScopedTempDir cache_dir;
   ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
@@ -229,8 +514,9 @@ TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
                                                               index_path));
   SimpleIndexLoadResult load_index_result;
   net::TestClosure closure;
-  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
-                                     &load_index_result);
+  simple_index_file.LoadIndexEntries(fake_cache_mtime,
+                                     SimpleIndexFile::MappedIndexCallback(),
+                                     closure.closure(), &load_index_result);
   closure.WaitForResult();
 
   EXPECT_FALSE(base::PathExists(index_path));
@@ -4,6 +4,8 @@
 
 #include <algorithm>
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include "base/files/scoped_temp_dir.h"
 #include "base/hash.h"
@@ -58,14 +60,18 @@ class MockSimpleIndexFile : public SimpleIndexFile,
         disk_writes_(0) {}
 
   void LoadIndexEntries(base::Time cache_last_modified,
+                        const MappedIndexCallback& mapped_index_callback,
                         const base::Closure& callback,
                         SimpleIndexLoadResult* out_load_result) override {
+    mapped_index_callback_ = mapped_index_callback;
     load_callback_ = callback;
     load_result_ = out_load_result;
     ++load_index_entries_calls_;
   }
 
   void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                   const SimpleIndex::SlabAddressMap& slab_addresses,
+                   const base::hash_set<uint64>* changed_entries,
                    uint64 cache_size,
                    const base::TimeTicks& start,
                    bool app_on_background,
@@ -78,12 +84,16 @@ class MockSimpleIndexFile : public SimpleIndexFile,
     entry_set->swap(disk_write_entry_set_);
   }
 
+  const MappedIndexCallback& mapped_index_callback() const {
+    return mapped_index_callback_;
+  }
   const base::Closure& load_callback() const { return load_callback_; }
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
   int disk_writes() const { return disk_writes_; }
 
  private:
+  MappedIndexCallback mapped_index_callback_;
   base::Closure load_callback_;
   SimpleIndexLoadResult* load_result_;
   int load_index_entries_calls_;
@@ -129,6 +139,11 @@ class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
     ++doom_entries_calls_;
   }
 
+  void ReleaseSlabRecord(uint64 entry_hash,
+                         const SimpleSlabAddress& slab_address) override {
+    released_slab_records_.push_back(std::make_pair(entry_hash, slab_address));
+  }
+
   // Redirect to allow single "friend" declaration in base class.
   bool GetEntryForTesting(uint64 key, EntryMetadata* metadata) {
     SimpleIndex::EntrySet::iterator it = index_->entries_set_.find(key);
@@ -150,6 +165,21 @@ class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
     index_file_->load_callback().Run();
   }
 
+  // Hands the index a view of an index file that holds what the load will
+  // return, as the index file does before the entries are loaded.
+  void ReturnMappedIndex() {
+    const SimpleIndexLoadResult& load_result = *index_file_->load_result();
+    SimpleIndexFile::IndexMetadata index_metadata(load_result.entries.size(),
+                                                  0);
+    mapped_index_pickle_ = SimpleIndexFile::Serialize(
+        index_metadata, load_result.entries, load_result.slab_addresses);
+    SimpleIndexFile::SerializeFinalData(base::Time::Now(),
+                                        mapped_index_pickle_.get());
+    index_file_->mapped_index_callback().Run(SimpleMappedIndex::Read(
+        static_cast<const char*>(mapped_index_pickle_->data()),
+        mapped_index_pickle_->size()));
+  }
+
   // Non-const for timer manipulation.
   SimpleIndex* index() { return index_.get(); }
   const MockSimpleIndexFile* index_file() const { return index_file_.get(); }
@@ -159,13 +189,21 @@ class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
   }
   int doom_entries_calls() const { return doom_entries_calls_; }
 
+  const std::vector<std::pair<uint64, SimpleSlabAddress> >&
+  released_slab_records() const {
+    return released_slab_records_;
+  }
+
 
   const simple_util::ImmutableArray<uint64, 16> hashes_;
+  // Outlives |index_|, which can hold a view of it.
+  scoped_ptr<Pickle> mapped_index_pickle_;
   scoped_ptr<SimpleIndex> index_;
   base::WeakPtr<MockSimpleIndexFile> index_file_;
 
   std::vector<uint64> last_doom_entry_hashes_;
   int doom_entries_calls_;
+  std::vector<std::pair<uint64, SimpleSlabAddress> > released_slab_records_;
 };
 
 TEST_F(EntryMetadataTest, Basics) {
@@ -625,4 +663,149 @@ TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->write_to_disk_timer_.Stop();
 }
 
+// Whoever replaces or removes the slab address of an entry releases the record
+// at the old one.
+TEST_F(SimpleIndexTest, SlabAddress) {
+  ReturnIndexFile();
+  const uint64 kHash1 = hashes_.at<1>();
+  const SimpleSlabAddress kAddress1(1, 0);
+  const SimpleSlabAddress kAddress2(1, 256);
+  const SimpleSlabAddress kAddress3(2, 0);
+
+  EXPECT_FALSE(index()->SetSlabAddress(kHash1, kAddress1));
+  EXPECT_FALSE(index()->GetSlabAddress(kHash1).is_valid());
+
+  index()->Insert(kHash1);
+  EXPECT_TRUE(index()->SetSlabAddress(kHash1, kAddress1));
+  EXPECT_TRUE(kAddress1 == index()->GetSlabAddress(kHash1));
+  EXPECT_TRUE(released_slab_records().empty());
+
+  EXPECT_TRUE(index()->SetSlabAddress(kHash1, kAddress2));
+  ASSERT_EQ(1u, released_slab_records().size());
+  EXPECT_EQ(kHash1, released_slab_records()[0].first);
+  EXPECT_TRUE(kAddress1 == released_slab_records()[0].second);
+
+  // A move only happens if the entry is still where the copy came from, and
+  // releases nothing.
+  EXPECT_FALSE(index()->MoveSlabRecord(kHash1, kAddress1, kAddress3));
+  EXPECT_TRUE(kAddress2 == index()->GetSlabAddress(kHash1));
+  EXPECT_TRUE(index()->MoveSlabRecord(kHash1, kAddress2, kAddress3));
+  EXPECT_TRUE(kAddress3 == index()->GetSlabAddress(kHash1));
+  EXPECT_EQ(1u, released_slab_records().size());
+
+  index()->Remove(kHash1);
+  ASSERT_EQ(2u, released_slab_records().size());
+  EXPECT_TRUE(kAddress3 == released_slab_records()[1].second);
+}
+
+// Entries removed before the index file is loaded release their loaded
+// records, and so do entries that were inserted again, since they were
+// created without knowing of their records.
+TEST_F(SimpleIndexTest, SlabAddressMerge) {
+  const uint64 kHash1 = hashes_.at<1>();
+  const uint64 kHash2 = hashes_.at<2>();
+  const uint64 kHash3 = hashes_.at<3>();
+  index()->Remove(kHash1);
+  index()->Insert(kHash2);
+  index()->Insert(kHash3);
+  EXPECT_TRUE(index()->SetSlabAddress(kHash3, SimpleSlabAddress(2, 8)));
+
+  const uint64 kLoadedHashes[] = {kHash1, kHash2, kHash3};
+  for (size_t i = 0; i < arraysize(kLoadedHashes); ++i) {
+    index_file_->load_result()->entries.insert(
+        std::make_pair(kLoadedHashes[i], EntryMetadata(base::Time::Now(), 10)));
+    index_file_->load_result()->slab_addresses.insert(
+        std::make_pair(kLoadedHashes[i], SimpleSlabAddress(1, (i + 1) * 8)));
+  }
+  ReturnIndexFile();
+
+  // The loaded record of every entry is released.
+  ASSERT_EQ(3u, released_slab_records().size());
+  for (size_t i = 0; i < released_slab_records().size(); ++i) {
+    const uint64 hash = released_slab_records()[i].first;
+    const SimpleSlabAddress& address = released_slab_records()[i].second;
+    if (hash == kHash1)
+      EXPECT_TRUE(SimpleSlabAddress(1, 8) == address);
+    else if (hash == kHash2)
+      EXPECT_TRUE(SimpleSlabAddress(1, 16) == address);
+    else
+      EXPECT_TRUE(SimpleSlabAddress(1, 24) == address);
+  }
+  EXPECT_FALSE(index()->GetSlabAddress(kHash2).is_valid());
+  EXPECT_TRUE(SimpleSlabAddress(2, 8) == index()->GetSlabAddress(kHash3));
+}
+
+// Before the index file is loaded, the index answers lookups from a view of
+// it, and takes over the entries that are changed.
+TEST_F(SimpleIndexTest, LookupsBeforeInit) {
+  index()->SetMaxSize(1000);
+  const uint64 kHash1 = hashes_.at<1>();
+  const uint64 kHash2 = hashes_.at<2>();
+  const uint64 kHash3 = hashes_.at<3>();
+  InsertIntoIndexFileReturn(kHash1, kTestLastUsedTime, 10);
+  InsertIntoIndexFileReturn(kHash2, kTestLastUsedTime, 20);
+  index_file_->load_result()->slab_addresses[kHash2] = SimpleSlabAddress(1, 8);
+
+  EXPECT_FALSE(index()->lookups_ready());
+  EXPECT_TRUE(index()->Has(kHash3));
+  EXPECT_TRUE(index()->UseIfExists(kHash3));
+
+  ReturnMappedIndex();
+  EXPECT_TRUE(index()->lookups_ready());
+  EXPECT_FALSE(index()->initialized());
+  EXPECT_TRUE(index()->Has(kHash1));
+  EXPECT_TRUE(index()->Has(kHash2));
+  EXPECT_FALSE(index()->Has(kHash3));
+  EXPECT_FALSE(index()->UseIfExists(kHash3));
+  EXPECT_TRUE(SimpleSlabAddress(1, 8) == index()->GetSlabAddress(kHash2));
+
+  index()->Remove(kHash1);
+  EXPECT_FALSE(index()->Has(kHash1));
+  EXPECT_FALSE(index()->UseIfExists(kHash1));
+  index()->Insert(kHash3);
+  EXPECT_TRUE(index()->Has(kHash3));
+
+  EXPECT_TRUE(index()->UseIfExists(kHash2));
+  EXPECT_EQ(20U, index()->cache_size_);
+  EXPECT_TRUE(index()->UpdateEntrySize(kHash2, 30));
+  EXPECT_EQ(30U, index()->cache_size_);
+
+  ReturnIndexFile();
+  EXPECT_TRUE(index()->initialized());
+  EXPECT_FALSE(index()->Has(kHash1));
+  EXPECT_TRUE(index()->Has(kHash2));
+  EXPECT_TRUE(index()->Has(kHash3));
+  EXPECT_EQ(30U, index()->cache_size_);
+  EXPECT_TRUE(SimpleSlabAddress(1, 8) == index()->GetSlabAddress(kHash2));
+  EXPECT_TRUE(released_slab_records().empty());
+}
+
+// The records of the entries taken over from the view of the index file are
+// released once, when they are replaced, and not again when it is loaded.
+TEST_F(SimpleIndexTest, SlabAddressBeforeInit) {
+  const uint64 kHash1 = hashes_.at<1>();
+  const uint64 kHash2 = hashes_.at<2>();
+  InsertIntoIndexFileReturn(kHash1, kTestLastUsedTime, 10);
+  InsertIntoIndexFileReturn(kHash2, kTestLastUsedTime, 20);
+  index_file_->load_result()->slab_addresses[kHash1] = SimpleSlabAddress(1, 8);
+  index_file_->load_result()->slab_addresses[kHash2] = SimpleSlabAddress(1, 16);
+  ReturnMappedIndex();
+
+  EXPECT_TRUE(index()->SetSlabAddress(kHash1, SimpleSlabAddress(2, 0)));
+  ASSERT_EQ(1u, released_slab_records().size());
+  EXPECT_EQ(kHash1, released_slab_records()[0].first);
+  EXPECT_TRUE(SimpleSlabAddress(1, 8) == released_slab_records()[0].second);
+
+  EXPECT_TRUE(index()->UseIfExists(kHash2));
+  index()->Remove(kHash2);
+  ASSERT_EQ(2u, released_slab_records().size());
+  EXPECT_EQ(kHash2, released_slab_records()[1].first);
+  EXPECT_TRUE(SimpleSlabAddress(1, 16) == released_slab_records()[1].second);
+
+  ReturnIndexFile();
+  EXPECT_EQ(2u, released_slab_records().size());
+  EXPECT_TRUE(SimpleSlabAddress(2, 0) == index()->GetSlabAddress(kHash1));
+  EXPECT_FALSE(index()->Has(kHash2));
+}
+
 }  // namespace disk_cache
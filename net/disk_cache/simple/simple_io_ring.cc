@@ -0,0 +1,558 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_io_ring.h"
+
+#include <errno.h>
+
+#if defined(OS_LINUX)
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/single_thread_task_runner.h"
+#include "base/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Size of the submission queue. The kernel makes the completion queue twice
+// as large.
+const unsigned kQueueSize = 256;
+
+// Tags the operation of a request whose result is a byte count.
+const uint64 kDataOpTag = 1;
+
+enum OpType {
+  OP_READ,
+  OP_WRITE,
+  OP_TRUNCATE,
+};
+
+base::LazyInstance<SimpleIORing>::Leaky g_io_ring = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+struct SimpleIORing::Op {
+  OpType type;
+  // The file offset, or the new length for OP_TRUNCATE.
+  int64 offset;
+  char* data;
+  int len;
+};
+
+struct SimpleIORing::Request {
+  Request(base::PlatformFile file,
+          net::IOBuffer* buf,
+          int write_len,
+          const net::CompletionCallback& callback)
+      : file(file),
+        buf(buf),
+        write_len(write_len),
+        callback(callback),
+        task_runner(base::ThreadTaskRunnerHandle::Get()),
+        pending_ops(0),
+        result(write_len >= 0 ? write_len : 0) {}
+
+  const base::PlatformFile file;
+  const scoped_refptr<net::IOBuffer> buf;
+  // The length of the data a write must transfer, or -1 for a read.
+  const int write_len;
+  const net::CompletionCallback callback;
+  const scoped_refptr<base::SingleThreadTaskRunner> task_runner;
+
+  // Only accessed on the completion thread once submitted.
+  int pending_ops;
+  int result;
+};
+
+#if defined(OS_LINUX)
+
+namespace {
+
+// The parts of the io_uring ABI that are used here. They are declared here
+// rather than taken from <linux/io_uring.h>, which kernel headers before 5.1
+// don't have, and which lacks the plain reads and writes and the probe before
+// 5.6.
+
+#if defined(__NR_io_uring_setup)
+const long kSysIoUringSetup = __NR_io_uring_setup;
+const long kSysIoUringEnter = __NR_io_uring_enter;
+const long kSysIoUringRegister = __NR_io_uring_register;
+#else
+// The numbers are the same on every architecture, after the base that MIPS
+// adds to all of its system calls.
+#if defined(__NR_Linux)
+const long kSysCallBase = __NR_Linux;
+#else
+const long kSysCallBase = 0;
+#endif
+const long kSysIoUringSetup = kSysCallBase + 425;
+const long kSysIoUringEnter = kSysCallBase + 426;
+const long kSysIoUringRegister = kSysCallBase + 427;
+#endif
+
+// Offsets of the mappings of the ring fd.
+const off_t kOffSqRing = 0;
+const off_t kOffCqRing = 0x8000000;
+const off_t kOffSqes = 0x10000000;
+
+const unsigned kEnterGetEvents = 1 << 0;
+const unsigned kRegisterProbe = 8;
+
+const uint8 kOpRead = 22;
+const uint8 kOpWrite = 23;
+const uint8 kOpFtruncate = 55;
+
+// Flags of IoUringSqe and IoUringProbeOp.
+const uint8 kSqeIoLink = 1 << 2;
+const uint16 kOpSupported = 1 << 0;
+
+struct IoSqringOffsets {
+  uint32 head;
+  uint32 tail;
+  uint32 ring_mask;
+  uint32 ring_entries;
+  uint32 flags;
+  uint32 dropped;
+  uint32 array;
+  uint32 resv1;
+  uint64 resv2;
+};
+
+struct IoCqringOffsets {
+  uint32 head;
+  uint32 tail;
+  uint32 ring_mask;
+  uint32 ring_entries;
+  uint32 overflow;
+  uint32 cqes;
+  uint32 flags;
+  uint32 resv1;
+  uint64 resv2;
+};
+
+struct IoUringParams {
+  uint32 sq_entries;
+  uint32 cq_entries;
+  uint32 flags;
+  uint32 sq_thread_cpu;
+  uint32 sq_thread_idle;
+  uint32 features;
+  uint32 wq_fd;
+  uint32 resv[3];
+  IoSqringOffsets sq_off;
+  IoCqringOffsets cq_off;
+};
+static_assert(sizeof(IoUringParams) == 120, "incorrect io_uring_params size");
+
+struct IoUringSqe {
+  uint8 opcode;
+  uint8 flags;
+  uint16 ioprio;
+  int32 fd;
+  uint64 off;
+  uint64 addr;
+  uint32 len;
+  uint32 rw_flags;
+  uint64 user_data;
+  uint64 pad[3];
+};
+static_assert(sizeof(IoUringSqe) == 64, "incorrect io_uring_sqe size");
+
+struct IoUringCqe {
+  uint64 user_data;
+  int32 res;
+  uint32 flags;
+};
+static_assert(sizeof(IoUringCqe) == 16, "incorrect io_uring_cqe size");
+
+struct IoUringProbeOp {
+  uint8 op;
+  uint8 resv;
+  uint16 flags;
+  uint32 resv2;
+};
+
+// The kernel fills in as many ops as it is asked for; all the ops so far fit.
+const unsigned kMaxProbeOps = 256;
+
+struct IoUringProbe {
+  uint8 last_op;
+  uint8 ops_len;
+  uint16 resv;
+  uint32 resv2[3];
+  IoUringProbeOp ops[kMaxProbeOps];
+};
+static_assert(offsetof(IoUringProbe, ops) == 16,
+              "incorrect io_uring_probe size");
+
+int IoUringSetup(unsigned entries, IoUringParams* params) {
+  return syscall(kSysIoUringSetup, entries, params);
+}
+
+int IoUringEnter(int fd,
+                 unsigned to_submit,
+                 unsigned min_complete,
+                 unsigned flags) {
+  return syscall(kSysIoUringEnter, fd, to_submit, min_complete, flags, NULL,
+                 0);
+}
+
+int IoUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+  return syscall(kSysIoUringRegister, fd, opcode, arg, nr_args);
+}
+
+void* MapRing(int fd, size_t size, off_t offset) {
+  void* address = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, offset);
+  return address == MAP_FAILED ? NULL : address;
+}
+
+}  // namespace
+
+// The memory shared with the kernel.
+struct SimpleIORing::Ring {
+  Ring()
+      : fd(-1),
+        sq_map(NULL),
+        sq_map_size(0),
+        cq_map(NULL),
+        cq_map_size(0),
+        sqes(NULL),
+        sqes_size(0),
+        sq_tail_value(0) {}
+
+  ~Ring() {
+    if (sqes)
+      munmap(sqes, sqes_size);
+    if (cq_map)
+      munmap(cq_map, cq_map_size);
+    if (sq_map)
+      munmap(sq_map, sq_map_size);
+    if (fd >= 0)
+      close(fd);
+  }
+
+  // Returns the number of free entries of the submission queue.
+  unsigned sq_space() const {
+    return sq_entries -
+           (sq_tail_value -
+            static_cast<unsigned>(base::subtle::Acquire_Load(sq_head)));
+  }
+
+  int fd;
+  void* sq_map;
+  size_t sq_map_size;
+  void* cq_map;
+  size_t cq_map_size;
+  IoUringSqe* sqes;
+  size_t sqes_size;
+
+  // The kernel advances the heads, and this process the tails.
+  base::subtle::Atomic32* sq_head;
+  base::subtle::Atomic32* sq_tail;
+  unsigned* sq_array;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  // The tail including the entries that are being filled in.
+  unsigned sq_tail_value;
+
+  base::subtle::Atomic32* cq_head;
+  base::subtle::Atomic32* cq_tail;
+  IoUringCqe* cqes;
+  unsigned cq_mask;
+  unsigned cq_entries;
+};
+
+#else
+
+struct SimpleIORing::Ring {};
+
+#endif  // defined(OS_LINUX)
+
+// static
+SimpleIORing* SimpleIORing::Get() {
+  SimpleIORing* io_ring = g_io_ring.Pointer();
+  return io_ring->ring_ ? io_ring : NULL;
+}
+
+bool SimpleIORing::Read(base::PlatformFile file,
+                        int64 offset,
+                        net::IOBuffer* buf,
+                        int len,
+                        const net::CompletionCallback& callback) {
+  DCHECK_GT(len, 0);
+  Op op = {OP_READ, offset, buf->data(), len};
+  scoped_ptr<Request> request(new Request(file, buf, -1, callback));
+  if (!Submit(request.get(), &op, 1))
+    return false;
+  ignore_result(request.release());
+  return true;
+}
+
+bool SimpleIORing::Write(base::PlatformFile file,
+                         int64 length_before,
+                         int64 offset,
+                         net::IOBuffer* buf,
+                         int len,
+                         int64 length_after,
+                         const net::CompletionCallback& callback) {
+  DCHECK(can_truncate_ || (length_before < 0 && length_after < 0));
+  Op ops[3];
+  int count = 0;
+  if (length_before >= 0) {
+    Op op = {OP_TRUNCATE, length_before, NULL, 0};
+    ops[count++] = op;
+  }
+  if (len > 0) {
+    Op op = {OP_WRITE, offset, buf->data(), len};
+    ops[count++] = op;
+  }
+  if (length_after >= 0) {
+    Op op = {OP_TRUNCATE, length_after, NULL, 0};
+    ops[count++] = op;
+  }
+  DCHECK_GT(count, 0);
+
+  scoped_ptr<Request> request(new Request(file, buf, len, callback));
+  if (!Submit(request.get(), ops, count))
+    return false;
+  ignore_result(request.release());
+  return true;
+}
+
+SimpleIORing::SimpleIORing()
+    : can_truncate_(false),
+      queued_(0),
+      in_flight_(0),
+      flush_posted_(false) {
+  if (!Init())
+    ring_.reset();
+}
+
+SimpleIORing::~SimpleIORing() {
+  // Leaky; the completion thread uses the ring until the process exits.
+  NOTREACHED();
+}
+
+bool SimpleIORing::Init() {
+#if defined(OS_LINUX)
+  IoUringParams params;
+  memset(&params, 0, sizeof(params));
+  int fd = IoUringSetup(kQueueSize, &params);
+  if (fd < 0)
+    return false;
+  ring_.reset(new Ring);
+  Ring* ring = ring_.get();
+  ring->fd = fd;
+
+  ring->sq_map_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->sq_map = MapRing(fd, ring->sq_map_size, kOffSqRing);
+  ring->cq_map_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(IoUringCqe);
+  ring->cq_map = MapRing(fd, ring->cq_map_size, kOffCqRing);
+  ring->sqes_size = params.sq_entries * sizeof(IoUringSqe);
+  ring->sqes = static_cast<IoUringSqe*>(
+      MapRing(fd, ring->sqes_size, kOffSqes));
+  if (!ring->sq_map || !ring->cq_map || !ring->sqes)
+    return false;
+
+  char* sq = static_cast<char*>(ring->sq_map);
+  ring->sq_head =
+      reinterpret_cast<base::subtle::Atomic32*>(sq + params.sq_off.head);
+  ring->sq_tail =
+      reinterpret_cast<base::subtle::Atomic32*>(sq + params.sq_off.tail);
+  ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  ring->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sq_entries = params.sq_entries;
+  ring->sq_tail_value = base::subtle::NoBarrier_Load(ring->sq_tail);
+
+  char* cq = static_cast<char*>(ring->cq_map);
+  ring->cq_head =
+      reinterpret_cast<base::subtle::Atomic32*>(cq + params.cq_off.head);
+  ring->cq_tail =
+      reinterpret_cast<base::subtle::Atomic32*>(cq + params.cq_off.tail);
+  ring->cqes = reinterpret_cast<IoUringCqe*>(cq + params.cq_off.cqes);
+  ring->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cq_entries = params.cq_entries;
+
+  // Check that the kernel has plain reads and writes, which came after
+  // io_uring itself, and whether it can truncate files.
+  scoped_ptr<IoUringProbe> probe(new IoUringProbe());
+  if (IoUringRegister(fd, kRegisterProbe, probe.get(), kMaxProbeOps) < 0)
+    return false;
+  const uint8 kRequiredOps[] = {kOpRead, kOpWrite};
+  for (size_t i = 0; i < arraysize(kRequiredOps); ++i) {
+    if (kRequiredOps[i] > probe->last_op ||
+        !(probe->ops[kRequiredOps[i]].flags & kOpSupported)) {
+      return false;
+    }
+  }
+  can_truncate_ = kOpFtruncate <= probe->last_op &&
+                  (probe->ops[kOpFtruncate].flags & kOpSupported);
+
+  return base::PlatformThread::CreateNonJoinable(0, this);
+#else
+  return false;
+#endif
+}
+
+bool SimpleIORing::Submit(Request* request, const Op* ops, int count) {
+#if defined(OS_LINUX)
+  base::AutoLock auto_lock(lock_);
+  Ring* ring = ring_.get();
+  const unsigned num_ops = count;
+  if (in_flight_ + num_ops > ring->cq_entries)
+    return false;
+  if (ring->sq_space() < num_ops) {
+    FlushLocked();
+    if (ring->sq_space() < num_ops)
+      return false;
+  }
+
+  request->pending_ops = count;
+  for (int i = 0; i < count; ++i) {
+    unsigned index = ring->sq_tail_value & ring->sq_mask;
+    IoUringSqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    switch (ops[i].type) {
+      case OP_READ:
+        sqe->opcode = kOpRead;
+        break;
+      case OP_WRITE:
+        sqe->opcode = kOpWrite;
+        break;
+      case OP_TRUNCATE:
+        sqe->opcode = kOpFtruncate;
+        break;
+    }
+    sqe->fd = request->file;
+    sqe->off = ops[i].offset;
+    sqe->addr = reinterpret_cast<uintptr_t>(ops[i].data);
+    sqe->len = ops[i].len;
+    sqe->user_data = reinterpret_cast<uintptr_t>(request) |
+                     (ops[i].type == OP_TRUNCATE ? 0 : kDataOpTag);
+    if (i + 1 < count)
+      sqe->flags = kSqeIoLink;
+    ring->sq_array[index] = index;
+    ++ring->sq_tail_value;
+  }
+  base::subtle::Release_Store(ring->sq_tail, ring->sq_tail_value);
+  queued_ += num_ops;
+  in_flight_ += num_ops;
+
+  if (!flush_posted_) {
+    flush_posted_ = true;
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(&SimpleIORing::Flush, base::Unretained(this)));
+  }
+  return true;
+#else
+  NOTREACHED();
+  return false;
+#endif
+}
+
+void SimpleIORing::Flush() {
+  base::AutoLock auto_lock(lock_);
+  flush_posted_ = false;
+  FlushLocked();
+}
+
+void SimpleIORing::FlushLocked() {
+#if defined(OS_LINUX)
+  lock_.AssertAcquired();
+  while (queued_) {
+    int submitted = IoUringEnter(ring_->fd, queued_, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EBUSY) {
+        // The kernel is short of memory or of room for completions; those
+        // the completion thread reaps make room.
+        base::PlatformThread::YieldCurrentThread();
+        continue;
+      }
+      PLOG(DFATAL) << "io_uring_enter";
+      return;
+    }
+    queued_ -= submitted;
+  }
+#else
+  NOTREACHED();
+#endif
+}
+
+// static
+void SimpleIORing::Complete(uint64 user_data, int32 result) {
+  Request* request = reinterpret_cast<Request*>(user_data & ~kDataOpTag);
+  if (request->result >= 0) {
+    if (result < 0) {
+      // The operations linked after a failed one are cancelled; keep the
+      // error of the failed one.
+      if (result != -ECANCELED)
+        request->result = net::MapSystemError(-result);
+    } else if (user_data & kDataOpTag) {
+      if (request->write_len < 0)
+        request->result = result;
+      else if (result != request->write_len)
+        request->result = net::ERR_FAILED;
+    }
+  }
+  if (--request->pending_ops)
+    return;
+  // Like PostTaskAndReply(), leak the request if its thread is gone, rather
+  // than destroying its callback on the wrong thread.
+  request->task_runner->PostTask(
+      FROM_HERE, base::Bind(&SimpleIORing::RunRequest, request));
+}
+
+// static
+void SimpleIORing::RunRequest(Request* request) {
+  scoped_ptr<Request> owned_request(request);
+  request->callback.Run(request->result);
+}
+
+void SimpleIORing::ThreadMain() {
+#if defined(OS_LINUX)
+  base::PlatformThread::SetName("SimpleCacheIORing");
+  Ring* ring = ring_.get();
+  unsigned head = base::subtle::NoBarrier_Load(ring->cq_head);
+  for (;;) {
+    unsigned tail = base::subtle::Acquire_Load(ring->cq_tail);
+    if (head == tail) {
+      // Errors, such as EINTR, just lead to another look at the queue.
+      IoUringEnter(ring->fd, 0, 1, kEnterGetEvents);
+      continue;
+    }
+    unsigned completed = tail - head;
+    for (; head != tail; ++head) {
+      const IoUringCqe& cqe = ring->cqes[head & ring->cq_mask];
+      uint64 user_data = cqe.user_data;
+      int32 result = cqe.res;
+      Complete(user_data, result);
+    }
+    base::subtle::Release_Store(ring->cq_head, head);
+    base::AutoLock auto_lock(lock_);
+    in_flight_ -= completed;
+  }
+#else
+  NOTREACHED();
+#endif
+}
+
+}  // namespace disk_cache
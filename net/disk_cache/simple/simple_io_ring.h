@@ -0,0 +1,125 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_IO_RING_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_IO_RING_H_
+
+#include "base/basictypes.h"
+#include "base/files/file.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+
+namespace base {
+template <typename Type>
+struct DefaultLazyInstanceTraits;
+}
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+// Performs file IO for the simple cache through a Linux io_uring, so that any
+// number of reads and writes can be outstanding without tying up a worker
+// thread each. Operations posted during one task of a thread are submitted to
+// the kernel together in a single system call at the end of the task, and a
+// single thread waits for all completions.
+//
+// Callbacks run on the thread that started the operation, which must have a
+// ThreadTaskRunnerHandle. The IOBuffer is kept alive until then. A method
+// that returns false has not started the operation, and the caller should
+// perform it on a worker thread instead. This happens when too many
+// operations are already outstanding.
+//
+// The methods may be called on any thread.
+class NET_EXPORT_PRIVATE SimpleIORing : public base::PlatformThread::Delegate {
+ public:
+  // Returns the process-wide ring, or NULL if the kernel does not support
+  // io_uring or the operations that the simple cache needs.
+  static SimpleIORing* Get();
+
+  // Returns true if Write() can change the length of a file.
+  bool can_truncate() const { return can_truncate_; }
+
+  // Reads up to |len| bytes at |offset| of |file| into |buf|. |callback| gets
+  // the number of bytes read, or a net error.
+  bool Read(base::PlatformFile file,
+            int64 offset,
+            net::IOBuffer* buf,
+            int len,
+            const net::CompletionCallback& callback);
+
+  // Sets the length of |file| to |length_before| unless it is negative, then
+  // writes |len| bytes of |buf| at |offset| unless |len| is 0, then sets the
+  // length to |length_after| unless it is negative. A step only runs if the
+  // previous ones succeeded. |callback| gets |len|, or a net error; a short
+  // write is an error. The truncations require can_truncate().
+  bool Write(base::PlatformFile file,
+             int64 length_before,
+             int64 offset,
+             net::IOBuffer* buf,
+             int len,
+             int64 length_after,
+             const net::CompletionCallback& callback);
+
+ private:
+  friend struct base::DefaultLazyInstanceTraits<SimpleIORing>;
+
+  struct Op;
+  struct Request;
+  struct Ring;
+
+  SimpleIORing();
+  ~SimpleIORing() override;
+
+  // Sets up the ring and starts the completion thread. Returns false if the
+  // ring is unusable.
+  bool Init();
+
+  // Queues the |count| operations of |ops| for |request| as one linked
+  // chain. Returns false if they do not fit.
+  bool Submit(Request* request, const Op* ops, int count);
+
+  // Passes all the queued operations to the kernel.
+  void Flush();
+  void FlushLocked();
+
+  // Records the completion of one operation of a request, and posts the
+  // request's callback once all its operations are done.
+  static void Complete(uint64 user_data, int32 result);
+
+  // Runs and deletes |request|.
+  static void RunRequest(Request* request);
+
+  // base::PlatformThread::Delegate:
+  // Waits for completions, forever.
+  void ThreadMain() override;
+
+  scoped_ptr<Ring> ring_;
+  bool can_truncate_;
+
+  // Guards the submission queue and the counters below.
+  base::Lock lock_;
+
+  // Number of operations queued but not yet passed to the kernel.
+  unsigned queued_;
+
+  // Number of operations passed to the kernel or queued that have not
+  // completed. Kept below the size of the completion queue so that no
+  // completion is ever dropped.
+  unsigned in_flight_;
+
+  // True if a Flush() task has been posted for the queued operations.
+  bool flush_posted_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleIORing);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_IO_RING_H_
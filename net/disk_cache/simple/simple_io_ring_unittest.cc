@@ -0,0 +1,158 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_io_ring.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+class SimpleIORingTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    io_ring_ = SimpleIORing::Get();
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_.Initialize(temp_dir_.path().AppendASCII("file"),
+                     base::File::FLAG_CREATE | base::File::FLAG_READ |
+                         base::File::FLAG_WRITE);
+    ASSERT_TRUE(file_.IsValid());
+  }
+
+  std::string ReadFile() {
+    std::string contents;
+    EXPECT_TRUE(
+        base::ReadFileToString(temp_dir_.path().AppendASCII("file"),
+                               &contents));
+    return contents;
+  }
+
+  // NULL if the kernel lacks io_uring, in which case the tests pass
+  // trivially.
+  SimpleIORing* io_ring_;
+  base::MessageLoopForIO message_loop_;
+  base::ScopedTempDir temp_dir_;
+  base::File file_;
+};
+
+void CountCompletion(int* completed,
+                     int expected_result,
+                     const base::Closure& quit,
+                     int result) {
+  EXPECT_EQ(expected_result, result);
+  if (--*completed == 0)
+    quit.Run();
+}
+
+}  // namespace
+
+TEST_F(SimpleIORingTest, WriteAndRead) {
+  if (!io_ring_)
+    return;
+  const std::string kData = "hello, world";
+  scoped_refptr<net::StringIOBuffer> buf(new net::StringIOBuffer(kData));
+  net::TestCompletionCallback write_callback;
+  ASSERT_TRUE(io_ring_->Write(file_.GetPlatformFile(), -1, 4, buf.get(),
+                              buf->size(), -1, write_callback.callback()));
+  EXPECT_EQ(buf->size(), write_callback.WaitForResult());
+  EXPECT_EQ(std::string(4, '\0') + kData, ReadFile());
+
+  scoped_refptr<net::IOBuffer> read_buf(new net::IOBuffer(100));
+  net::TestCompletionCallback read_callback;
+  ASSERT_TRUE(io_ring_->Read(file_.GetPlatformFile(), 4, read_buf.get(), 100,
+                             read_callback.callback()));
+  ASSERT_EQ(buf->size(), read_callback.WaitForResult());
+  EXPECT_EQ(kData, std::string(read_buf->data(), kData.size()));
+
+  // Reading at the end of the file reads nothing.
+  ASSERT_TRUE(io_ring_->Read(file_.GetPlatformFile(), 100, read_buf.get(), 1,
+                             read_callback.callback()));
+  EXPECT_EQ(0, read_callback.WaitForResult());
+}
+
+TEST_F(SimpleIORingTest, Truncate) {
+  if (!io_ring_ || !io_ring_->can_truncate())
+    return;
+  scoped_refptr<net::StringIOBuffer> buf(new net::StringIOBuffer("abcdef"));
+  net::TestCompletionCallback callback;
+  ASSERT_TRUE(io_ring_->Write(file_.GetPlatformFile(), -1, 0, buf.get(),
+                              buf->size(), -1, callback.callback()));
+  EXPECT_EQ(buf->size(), callback.WaitForResult());
+
+  // Cut the file, write past its end, then cut the write short.
+  scoped_refptr<net::StringIOBuffer> tail(new net::StringIOBuffer("xyz"));
+  ASSERT_TRUE(io_ring_->Write(file_.GetPlatformFile(), 2, 4, tail.get(),
+                              tail->size(), 6, callback.callback()));
+  EXPECT_EQ(tail->size(), callback.WaitForResult());
+  EXPECT_EQ(std::string("ab\0\0xy", 6), ReadFile());
+
+  // A truncation alone.
+  ASSERT_TRUE(io_ring_->Write(file_.GetPlatformFile(), -1, 0, NULL, 0, 1,
+                              callback.callback()));
+  EXPECT_EQ(0, callback.WaitForResult());
+  EXPECT_EQ("a", ReadFile());
+}
+
+TEST_F(SimpleIORingTest, Errors) {
+  if (!io_ring_)
+    return;
+  base::File read_only(temp_dir_.path().AppendASCII("file"),
+                       base::File::FLAG_OPEN | base::File::FLAG_READ);
+  ASSERT_TRUE(read_only.IsValid());
+  scoped_refptr<net::StringIOBuffer> buf(new net::StringIOBuffer("abc"));
+  net::TestCompletionCallback callback;
+  ASSERT_TRUE(io_ring_->Write(read_only.GetPlatformFile(), -1, 0, buf.get(),
+                              buf->size(), -1, callback.callback()));
+  EXPECT_GT(0, callback.WaitForResult());
+
+  if (!io_ring_->can_truncate())
+    return;
+  // The write after a failed truncation does not happen.
+  ASSERT_TRUE(io_ring_->Write(read_only.GetPlatformFile(), 10, 0, buf.get(),
+                              buf->size(), -1, callback.callback()));
+  EXPECT_GT(0, callback.WaitForResult());
+  EXPECT_EQ("", ReadFile());
+}
+
+// Starts many more operations than there are worker threads; all of them
+// complete, or are refused up front.
+TEST_F(SimpleIORingTest, ManyOutstanding) {
+  if (!io_ring_)
+    return;
+  const int kWrites = 1000;
+  const int kSize = 16;
+  base::RunLoop run_loop;
+  int outstanding = 0;
+  int started = 0;
+  for (int i = 0; i < kWrites; ++i) {
+    scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kSize));
+    memset(buf->data(), 'a' + i % 26, kSize);
+    ++outstanding;
+    if (io_ring_->Write(file_.GetPlatformFile(), -1, i * kSize, buf.get(),
+                        kSize, -1,
+                        base::Bind(&CountCompletion, &outstanding, kSize,
+                                   run_loop.QuitClosure()))) {
+      ++started;
+    } else {
+      --outstanding;
+    }
+  }
+  EXPECT_LT(0, started);
+  run_loop.Run();
+  EXPECT_EQ(0, outstanding);
+}
+
+}  // namespace disk_cache
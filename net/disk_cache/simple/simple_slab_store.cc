@@ -0,0 +1,527 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_slab_store.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/callback.h"
+#include "base/files/file.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "third_party/zlib/zlib.h"
+
+using base::File;
+using base::FilePath;
+
+namespace disk_cache {
+
+namespace {
+
+// Once a slab has grown to this size, records are appended to a new one.
+const int64 kMaxSlabSize = 8 * 1024 * 1024;
+
+const char kSlabFilePrefix[] = "slab_";
+
+FilePath GetSlabPath(const FilePath& slab_directory, uint32 slab_number) {
+  return slab_directory.AppendASCII(
+      base::StringPrintf("%s%08x", kSlabFilePrefix, slab_number));
+}
+
+bool GetSlabNumberFromPath(const FilePath& path, uint32* out_slab_number) {
+  const std::string name = path.BaseName().MaybeAsASCII();
+  const size_t prefix_length = arraysize(kSlabFilePrefix) - 1;
+  if (name.size() != prefix_length + 8 ||
+      !StartsWithASCII(name, kSlabFilePrefix, true)) {
+    return false;
+  }
+  return base::HexStringToUInt(name.substr(prefix_length), out_slab_number) &&
+         *out_slab_number != 0;
+}
+
+int64 GetRecordSize(const SimpleSlabRecordHeader& header) {
+  int64 size = sizeof(header);
+  for (int i = 0; i < kSimpleEntryFileCount; ++i)
+    size += header.file_size[i];
+  return (size + 7) & ~static_cast<int64>(7);
+}
+
+// Returns true if |header| is that of a record, live or dead, at |offset| of
+// a slab that is |slab_length| bytes long.
+bool IsRecordHeader(const SimpleSlabRecordHeader& header,
+                    int64 offset,
+                    int64 slab_length) {
+  if (header.magic_number != kSimpleSlabRecordMagicNumber &&
+      header.magic_number != kSimpleSlabKilledRecordMagicNumber) {
+    return false;
+  }
+  for (int i = 0; i < kSimpleEntryFileCount; ++i) {
+    if (header.file_size[i] > kMaxSlabSize)
+      return false;
+  }
+  return offset + GetRecordSize(header) <= slab_length;
+}
+
+// Reads the header of the record at |offset| of a slab. Returns false if
+// there is no record there, which is also the case at the end of the slab.
+bool ReadRecordHeader(File* file,
+                      int64 offset,
+                      int64 slab_length,
+                      SimpleSlabRecordHeader* out_header) {
+  if (offset + static_cast<int64>(sizeof(*out_header)) > slab_length)
+    return false;
+  if (file->Read(offset, reinterpret_cast<char*>(out_header),
+                 sizeof(*out_header)) != sizeof(*out_header)) {
+    return false;
+  }
+  return IsRecordHeader(*out_header, offset, slab_length);
+}
+
+uint32 GetImagesCRC(const char* data, int64 len) {
+  return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(data),
+               static_cast<uInt>(len));
+}
+
+}  // namespace
+
+class SimpleSlabStore::Slab : public base::RefCountedThreadSafe<Slab> {
+ public:
+  Slab(uint32 number_p, File file, int64 length_p)
+      : number(number_p),
+        length(length_p),
+        dead_bytes(0),
+        pending_appends(0),
+        dead_bytes_counted(false),
+        compacting(false),
+        file_(file.Pass()) {}
+
+  File* file() { return &file_; }
+
+  const uint32 number;
+
+  // The members below are guarded by the lock of the store.
+
+  // The end of the last record, including records still being appended.
+  int64 length;
+  // The size of the killed records, as far as known.
+  int64 dead_bytes;
+  int pending_appends;
+  // False if the slab was there at startup and has not been looked at, in
+  // which case |dead_bytes| only counts the records killed since.
+  bool dead_bytes_counted;
+  bool compacting;
+
+ private:
+  friend class base::RefCountedThreadSafe<Slab>;
+
+  ~Slab() {}
+
+  File file_;
+
+  DISALLOW_COPY_AND_ASSIGN(Slab);
+};
+
+SimpleSlabStore::Record::Record() : entry_hash(0) {
+}
+
+SimpleSlabStore::Record::~Record() {
+}
+
+// static
+const char SimpleSlabStore::kSlabDirectory[] = "slab-dir";
+
+SimpleSlabStore::SimpleSlabStore(const FilePath& cache_directory,
+                                 int entry_threshold)
+    : slab_directory_(cache_directory.AppendASCII(kSlabDirectory)),
+      entry_threshold_(entry_threshold),
+      initialized_(false),
+      active_slab_number_(0),
+      last_slab_number_(0),
+      last_sequence_(0) {
+  DCHECK_LE(entry_threshold_, kMaxSlabSize / 4);
+}
+
+SimpleSlabStore::~SimpleSlabStore() {
+}
+
+bool SimpleSlabStore::Append(const Record& record,
+                             SimpleSlabAddress* out_address) {
+  SimpleSlabRecordHeader header;
+  header.magic_number = kSimpleSlabRecordMagicNumber;
+  header.entry_hash = record.entry_hash;
+  header.last_modified = record.last_modified.ToInternalValue();
+  for (int i = 0; i < kSimpleEntryFileCount; ++i)
+    header.file_size[i] = record.file_images[i].size();
+
+  std::string buffer(GetRecordSize(header), '\0');
+  size_t offset = sizeof(header);
+  for (int i = 0; i < kSimpleEntryFileCount; ++i) {
+    buffer.replace(offset, record.file_images[i].size(),
+                   record.file_images[i]);
+    offset += record.file_images[i].size();
+  }
+  header.data_crc32 =
+      GetImagesCRC(buffer.data() + sizeof(header), offset - sizeof(header));
+  memcpy(&buffer[0], &header, sizeof(header));
+  return AppendRecord(&buffer, out_address);
+}
+
+bool SimpleSlabStore::Read(const SimpleSlabAddress& address,
+                           uint64 entry_hash,
+                           Record* out_record) {
+  scoped_refptr<Slab> slab = GetSlab(address.slab_number);
+  if (!slab.get())
+    return false;
+
+  // Records are at most as large as the threshold, so one read usually gets
+  // the whole record.
+  std::string buffer(sizeof(SimpleSlabRecordHeader) + entry_threshold_, '\0');
+  int bytes_read =
+      slab->file()->Read(address.offset, &buffer[0], buffer.size());
+  if (bytes_read < static_cast<int>(sizeof(SimpleSlabRecordHeader)))
+    return false;
+
+  SimpleSlabRecordHeader header;
+  memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic_number != kSimpleSlabRecordMagicNumber ||
+      header.entry_hash != entry_hash) {
+    return false;
+  }
+  int64 images_size = GetRecordSize(header) - sizeof(header);
+  if (images_size > kMaxSlabSize)
+    return false;
+  if (bytes_read < static_cast<int64>(sizeof(header)) + images_size) {
+    buffer.resize(sizeof(header) + images_size);
+    int rest = static_cast<int>(buffer.size()) - bytes_read;
+    if (slab->file()->Read(address.offset + bytes_read, &buffer[bytes_read],
+                           rest) != rest) {
+      return false;
+    }
+  }
+
+  const char* images = buffer.data() + sizeof(header);
+  int64 offset = 0;
+  for (int i = 0; i < kSimpleEntryFileCount; ++i) {
+    out_record->file_images[i].assign(images + offset, header.file_size[i]);
+    offset += header.file_size[i];
+  }
+  if (GetImagesCRC(images, offset) != header.data_crc32) {
+    DLOG(WARNING) << "Slab record had bad crc.";
+    return false;
+  }
+  out_record->entry_hash = header.entry_hash;
+  out_record->last_modified =
+      base::Time::FromInternalValue(header.last_modified);
+  return true;
+}
+
+void SimpleSlabStore::Kill(const SimpleSlabAddress& address,
+                           uint64 entry_hash) {
+  scoped_refptr<Slab> slab = GetSlab(address.slab_number);
+  if (!slab.get())
+    return;
+
+  SimpleSlabRecordHeader header;
+  int64 slab_length;
+  {
+    base::AutoLock auto_lock(lock_);
+    slab_length = slab->length;
+  }
+  if (!ReadRecordHeader(slab->file(), address.offset, slab_length, &header) ||
+      header.magic_number != kSimpleSlabRecordMagicNumber ||
+      header.entry_hash != entry_hash) {
+    return;
+  }
+  const uint64 killed_magic_number = kSimpleSlabKilledRecordMagicNumber;
+  if (slab->file()->Write(address.offset,
+                          reinterpret_cast<const char*>(&killed_magic_number),
+                          sizeof(killed_magic_number)) !=
+      sizeof(killed_magic_number)) {
+    DLOG(WARNING) << "Could not kill slab record.";
+    return;
+  }
+  base::AutoLock auto_lock(lock_);
+  slab->dead_bytes += GetRecordSize(header);
+}
+
+bool SimpleSlabStore::ShouldCompact() {
+  base::AutoLock auto_lock(lock_);
+  for (SlabMap::const_iterator it = slabs_.begin(); it != slabs_.end(); ++it) {
+    const Slab* slab = it->second.get();
+    if (slab->number == active_slab_number_ || slab->pending_appends ||
+        slab->compacting) {
+      continue;
+    }
+    if (!slab->dead_bytes_counted || slab->dead_bytes * 2 >= slab->length)
+      return true;
+  }
+  return false;
+}
+
+void SimpleSlabStore::Compact(std::vector<Move>* out_moves,
+                              uint32* out_slab_number) {
+  *out_slab_number = 0;
+
+  // Slabs found at startup are looked at one per call, so that no single
+  // compaction takes long.
+  scoped_refptr<Slab> uncounted_slab;
+  {
+    base::AutoLock auto_lock(lock_);
+    InitializeIfNeededLocked();
+    for (SlabMap::const_iterator it = slabs_.begin(); it != slabs_.end();
+         ++it) {
+      if (!it->second->dead_bytes_counted &&
+          it->first != active_slab_number_) {
+        uncounted_slab = it->second;
+        break;
+      }
+    }
+  }
+  if (uncounted_slab.get())
+    CountDeadBytes(uncounted_slab.get());
+
+  scoped_refptr<Slab> victim;
+  int64 victim_length = 0;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (SlabMap::const_iterator it = slabs_.begin(); it != slabs_.end();
+         ++it) {
+      Slab* slab = it->second.get();
+      if (slab->number == active_slab_number_ || slab->pending_appends ||
+          slab->compacting || !slab->dead_bytes_counted ||
+          slab->dead_bytes * 2 < slab->length) {
+        continue;
+      }
+      if (!victim.get() || slab->dead_bytes > victim->dead_bytes)
+        victim = slab;
+    }
+    if (!victim.get())
+      return;
+    victim->compacting = true;
+    victim_length = victim->length;
+  }
+
+  std::string contents(victim_length, '\0');
+  if (victim_length &&
+      victim->file()->Read(0, &contents[0], victim_length) != victim_length) {
+    base::AutoLock auto_lock(lock_);
+    victim->compacting = false;
+    return;
+  }
+
+  // The copies keep their sequence numbers, so that a copy never wins over a
+  // newer record of its entry when the index is restored.
+  int64 offset = 0;
+  SimpleSlabRecordHeader header;
+  while (offset + static_cast<int64>(sizeof(header)) <= victim_length) {
+    memcpy(&header, contents.data() + offset, sizeof(header));
+    if (!IsRecordHeader(header, offset, victim_length))
+      break;
+    const int64 record_size = GetRecordSize(header);
+    if (header.magic_number == kSimpleSlabRecordMagicNumber) {
+      std::string record = contents.substr(offset, record_size);
+      Move move;
+      move.entry_hash = header.entry_hash;
+      move.from = SimpleSlabAddress(victim->number, offset);
+      if (!AppendRecord(&record, &move.to)) {
+        base::AutoLock auto_lock(lock_);
+        victim->compacting = false;
+        return;
+      }
+      out_moves->push_back(move);
+    }
+    offset += record_size;
+  }
+  *out_slab_number = victim->number;
+}
+
+void SimpleSlabStore::DeleteSlab(uint32 slab_number) {
+  {
+    base::AutoLock auto_lock(lock_);
+    slabs_.erase(slab_number);
+  }
+  // The file stays open, and readable, until the last reader is done.
+  base::DeleteFile(GetSlabPath(slab_directory_, slab_number), false);
+}
+
+// static
+void SimpleSlabStore::ScanRecords(const FilePath& cache_directory,
+                                  const RecordCallback& callback) {
+  base::FileEnumerator enumerator(cache_directory.AppendASCII(kSlabDirectory),
+                                  false /* recursive */,
+                                  base::FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    uint32 slab_number;
+    if (!GetSlabNumberFromPath(path, &slab_number))
+      continue;
+    File file(path, File::FLAG_OPEN | File::FLAG_READ);
+    if (!file.IsValid())
+      continue;
+    const int64 slab_length = file.GetLength();
+    int64 offset = 0;
+    SimpleSlabRecordHeader header;
+    while (ReadRecordHeader(&file, offset, slab_length, &header)) {
+      if (header.magic_number == kSimpleSlabRecordMagicNumber) {
+        int64 entry_size = 0;
+        for (int i = 0; i < kSimpleEntryFileCount; ++i)
+          entry_size += header.file_size[i];
+        callback.Run(header.entry_hash,
+                     SimpleSlabAddress(slab_number, offset),
+                     base::Time::FromInternalValue(header.last_modified),
+                     entry_size,
+                     header.sequence);
+      }
+      offset += GetRecordSize(header);
+    }
+  }
+}
+
+// static
+bool SimpleSlabStore::GetLastModified(const FilePath& cache_directory,
+                                      base::Time* out_last_modified) {
+  // Creating and deleting slabs changes the directory.
+  const FilePath slab_directory = cache_directory.AppendASCII(kSlabDirectory);
+  File::Info directory_info;
+  if (!base::GetFileInfo(slab_directory, &directory_info))
+    return false;
+  *out_last_modified = directory_info.last_modified;
+  base::FileEnumerator enumerator(slab_directory, false /* recursive */,
+                                  base::FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    *out_last_modified = std::max(*out_last_modified,
+                                  enumerator.GetInfo().GetLastModifiedTime());
+  }
+  return true;
+}
+
+void SimpleSlabStore::InitializeIfNeededLocked() {
+  lock_.AssertAcquired();
+  if (initialized_)
+    return;
+  initialized_ = true;
+
+  if (!base::CreateDirectory(slab_directory_))
+    LOG(ERROR) << "Could not create the slab directory";
+  base::FileEnumerator enumerator(slab_directory_, false /* recursive */,
+                                  base::FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    uint32 slab_number;
+    if (!GetSlabNumberFromPath(path, &slab_number))
+      continue;
+    File file(path, File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE |
+                        File::FLAG_SHARE_DELETE);
+    if (!file.IsValid())
+      continue;
+    const int64 length = file.GetLength();
+    slabs_[slab_number] = new Slab(slab_number, file.Pass(), length);
+    last_slab_number_ = std::max(last_slab_number_, slab_number);
+  }
+}
+
+scoped_refptr<SimpleSlabStore::Slab> SimpleSlabStore::GetSlab(
+    uint32 slab_number) {
+  base::AutoLock auto_lock(lock_);
+  InitializeIfNeededLocked();
+  SlabMap::const_iterator it = slabs_.find(slab_number);
+  if (it == slabs_.end())
+    return NULL;
+  return it->second;
+}
+
+bool SimpleSlabStore::AppendRecord(std::string* record,
+                                   SimpleSlabAddress* out_address) {
+  DCHECK_EQ(0u, record->size() % 8);
+  SimpleSlabRecordHeader* header =
+      reinterpret_cast<SimpleSlabRecordHeader*>(&(*record)[0]);
+  const int64 record_size = record->size();
+
+  scoped_refptr<Slab> slab;
+  int64 offset;
+  {
+    base::AutoLock auto_lock(lock_);
+    InitializeIfNeededLocked();
+    if (!header->sequence) {
+      // Sequence numbers have to keep growing across restarts, so they start
+      // from the clock.
+      last_sequence_ = std::max(
+          last_sequence_ + 1,
+          static_cast<uint64>(base::Time::Now().ToInternalValue()));
+      header->sequence = last_sequence_;
+    }
+
+    SlabMap::const_iterator it = slabs_.find(active_slab_number_);
+    if (it != slabs_.end() && it->second->length + record_size <= kMaxSlabSize) {
+      slab = it->second;
+    } else {
+      // Slabs from before a restart are never appended to, since their ends
+      // may hold a partial record.
+      const uint32 slab_number = last_slab_number_ + 1;
+      File file(GetSlabPath(slab_directory_, slab_number),
+                File::FLAG_CREATE_ALWAYS | File::FLAG_READ | File::FLAG_WRITE |
+                    File::FLAG_SHARE_DELETE);
+      if (!file.IsValid()) {
+        DLOG(WARNING) << "Could not create slab file.";
+        return false;
+      }
+      last_slab_number_ = slab_number;
+      slab = new Slab(slab_number, file.Pass(), 0);
+      slab->dead_bytes_counted = true;
+      slabs_[slab_number] = slab;
+      active_slab_number_ = slab_number;
+    }
+    offset = slab->length;
+    slab->length += record_size;
+    ++slab->pending_appends;
+  }
+
+  const bool written =
+      slab->file()->Write(offset, record->data(), record_size) == record_size;
+
+  base::AutoLock auto_lock(lock_);
+  --slab->pending_appends;
+  if (!written) {
+    // Stop appending after the hole, which would end a scan of the slab.
+    DLOG(WARNING) << "Could not write slab record.";
+    slab->dead_bytes = slab->length;
+    if (active_slab_number_ == slab->number)
+      active_slab_number_ = 0;
+    return false;
+  }
+  *out_address = SimpleSlabAddress(slab->number, static_cast<uint32>(offset));
+  return true;
+}
+
+void SimpleSlabStore::CountDeadBytes(Slab* slab) {
+  int64 slab_length;
+  {
+    base::AutoLock auto_lock(lock_);
+    slab_length = slab->length;
+  }
+  int64 dead_bytes = 0;
+  int64 offset = 0;
+  SimpleSlabRecordHeader header;
+  while (ReadRecordHeader(slab->file(), offset, slab_length, &header)) {
+    const int64 record_size = GetRecordSize(header);
+    if (header.magic_number == kSimpleSlabKilledRecordMagicNumber)
+      dead_bytes += record_size;
+    offset += record_size;
+  }
+  // Whatever follows the last record is garbage left by a crash.
+  dead_bytes += slab_length - offset;
+
+  base::AutoLock auto_lock(lock_);
+  // Records killed while counting may or may not have been counted already.
+  slab->dead_bytes = std::max(slab->dead_bytes, dead_bytes);
+  slab->dead_bytes_counted = true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,177 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_SLAB_STORE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_SLAB_STORE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback_forward.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+namespace disk_cache {
+
+// The location of the record of an entry in the slab files. An invalid
+// address, with a slab number of 0, means that the entry is in its own files.
+struct NET_EXPORT_PRIVATE SimpleSlabAddress {
+  SimpleSlabAddress() : slab_number(0), offset(0) {}
+  SimpleSlabAddress(uint32 slab_number_p, uint32 offset_p)
+      : slab_number(slab_number_p), offset(offset_p) {}
+
+  bool is_valid() const { return slab_number != 0; }
+
+  bool operator==(const SimpleSlabAddress& other) const {
+    return slab_number == other.slab_number && offset == other.offset;
+  }
+  bool operator!=(const SimpleSlabAddress& other) const {
+    return !(*this == other);
+  }
+
+  uint32 slab_number;
+  uint32 offset;
+};
+
+// Stores small entries of the Simple cache as records in a few shared slab
+// files, instead of in files of their own, which saves the inodes, the open()
+// calls and the directory lookups of the per-entry files. A record holds the
+// complete contents that the files of the entry would have; it is written in
+// one go when the entry is closed, and read in one go when it is opened.
+//
+// Records are only ever appended. A record that is superseded by a newer one,
+// or whose entry is doomed, is killed in place, and once enough of a slab is
+// dead its live records are copied to the slab being appended to and the slab
+// is deleted. The SimpleIndex holds the address of the live record of each
+// entry, and decides which record is live: the store does not keep track of
+// entries at all.
+//
+// All the methods may be called on any thread, and all but ShouldCompact()
+// may block on IO.
+class NET_EXPORT_PRIVATE SimpleSlabStore
+    : public base::RefCountedThreadSafe<SimpleSlabStore> {
+ public:
+  struct NET_EXPORT_PRIVATE Record {
+    Record();
+    ~Record();
+
+    uint64 entry_hash;
+    base::Time last_modified;
+    // An empty image stands for an omitted file.
+    std::string file_images[kSimpleEntryFileCount];
+  };
+
+  // A record copied by Compact().
+  struct Move {
+    uint64 entry_hash;
+    SimpleSlabAddress from;
+    SimpleSlabAddress to;
+  };
+
+  // Called by ScanRecords() with the hash of an entry, the address of one of
+  // its records, when it was last modified, the size of its files and the
+  // sequence number of the record.
+  typedef base::Callback<void(uint64 entry_hash,
+                              const SimpleSlabAddress& address,
+                              base::Time last_modified,
+                              int64 entry_size,
+                              uint64 sequence)> RecordCallback;
+
+  // The name of the directory of the slab files, in the cache directory.
+  static const char kSlabDirectory[];
+
+  // Entries whose files together take more than |entry_threshold| bytes are
+  // not stored in slabs.
+  SimpleSlabStore(const base::FilePath& cache_directory, int entry_threshold);
+
+  int entry_threshold() const { return entry_threshold_; }
+
+  // Appends a record for |record|, and sets |*out_address| to its address.
+  bool Append(const Record& record, SimpleSlabAddress* out_address);
+
+  // Reads the live record of the entry |entry_hash| at |address|.
+  bool Read(const SimpleSlabAddress& address,
+            uint64 entry_hash,
+            Record* out_record);
+
+  // Kills the record of the entry |entry_hash| at |address|, if it is there
+  // and alive.
+  void Kill(const SimpleSlabAddress& address, uint64 entry_hash);
+
+  // Returns true if Compact() may have work to do.
+  bool ShouldCompact();
+
+  // Copies the live records out of the slab that has the most dead bytes, if
+  // at least half of it is dead, and adds the copies to |out_moves|. Sets
+  // |*out_slab_number| to the number of that slab, which the caller deletes
+  // with DeleteSlab() once the index points to the copies; 0 if no slab was
+  // compacted.
+  void Compact(std::vector<Move>* out_moves, uint32* out_slab_number);
+
+  // Deletes the slab |slab_number|. Opened entries do not need their records
+  // any more, but an entry that is being opened at its old address fails to.
+  void DeleteSlab(uint32 slab_number);
+
+  // Calls |callback| for every live record in the slabs of |cache_directory|,
+  // which must not be in use. Used to restore the index.
+  static void ScanRecords(const base::FilePath& cache_directory,
+                          const RecordCallback& callback);
+
+  // Sets |*out_last_modified| to the last time that the slabs in
+  // |cache_directory| changed. Returns false if there are no slabs.
+  static bool GetLastModified(const base::FilePath& cache_directory,
+                              base::Time* out_last_modified);
+
+ private:
+  friend class base::RefCountedThreadSafe<SimpleSlabStore>;
+
+  class Slab;
+  typedef std::map<uint32, scoped_refptr<Slab> > SlabMap;
+
+  ~SimpleSlabStore();
+
+  // Opens the slab files on the first call.
+  void InitializeIfNeededLocked();
+
+  // Returns the slab |slab_number|, or NULL if it does not exist.
+  scoped_refptr<Slab> GetSlab(uint32 slab_number);
+
+  // Appends |record|, a header followed by the file images and the padding,
+  // and sets |*out_address|. Gives the record a sequence number unless it has
+  // one.
+  bool AppendRecord(std::string* record, SimpleSlabAddress* out_address);
+
+  // Reads the headers of all the records of |slab| to learn how much of it is
+  // dead.
+  void CountDeadBytes(Slab* slab);
+
+  const base::FilePath slab_directory_;
+  const int entry_threshold_;
+
+  // Guards all the members below, and the bookkeeping in the slabs.
+  base::Lock lock_;
+
+  bool initialized_;
+  SlabMap slabs_;
+
+  // The slab that records are appended to, or 0 before the first append.
+  uint32 active_slab_number_;
+
+  // Slab numbers are never reused.
+  uint32 last_slab_number_;
+
+  uint64 last_sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleSlabStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_SLAB_STORE_H_
@@ -0,0 +1,195 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_slab_store.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kEntryThreshold = 4096;
+
+SimpleSlabStore::Record MakeRecord(uint64 entry_hash,
+                                   const std::string& file_0,
+                                   const std::string& file_1) {
+  SimpleSlabStore::Record record;
+  record.entry_hash = entry_hash;
+  record.last_modified = base::Time::Now();
+  record.file_images[0] = file_0;
+  record.file_images[1] = file_1;
+  return record;
+}
+
+struct ScannedRecord {
+  SimpleSlabAddress address;
+  int64 entry_size;
+  uint64 sequence;
+};
+
+// Keeps the record of each entry with the highest sequence number, like
+// restoring the index does.
+void AddScannedRecord(std::map<uint64, ScannedRecord>* records,
+                      uint64 entry_hash,
+                      const SimpleSlabAddress& address,
+                      base::Time last_modified,
+                      int64 entry_size,
+                      uint64 sequence) {
+  if (records->count(entry_hash) &&
+      (*records)[entry_hash].sequence > sequence) {
+    return;
+  }
+  ScannedRecord record;
+  record.address = address;
+  record.entry_size = entry_size;
+  record.sequence = sequence;
+  (*records)[entry_hash] = record;
+}
+
+class SimpleSlabStoreTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    store_ = new SimpleSlabStore(temp_dir_.path(), kEntryThreshold);
+  }
+
+  std::map<uint64, ScannedRecord> ScanRecords() {
+    std::map<uint64, ScannedRecord> records;
+    SimpleSlabStore::ScanRecords(temp_dir_.path(),
+                                 base::Bind(&AddScannedRecord, &records));
+    return records;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  scoped_refptr<SimpleSlabStore> store_;
+};
+
+}  // namespace
+
+TEST_F(SimpleSlabStoreTest, AppendAndRead) {
+  base::Time last_modified;
+  EXPECT_FALSE(
+      SimpleSlabStore::GetLastModified(temp_dir_.path(), &last_modified));
+
+  const SimpleSlabStore::Record record = MakeRecord(1, "header and key", "");
+  SimpleSlabAddress address;
+  ASSERT_TRUE(store_->Append(record, &address));
+  EXPECT_TRUE(address.is_valid());
+
+  // A record larger than a single read.
+  const SimpleSlabStore::Record large_record =
+      MakeRecord(2, std::string(kEntryThreshold, 'a'), "stream 2");
+  SimpleSlabAddress large_address;
+  ASSERT_TRUE(store_->Append(large_record, &large_address));
+  EXPECT_TRUE(large_address != address);
+
+  SimpleSlabStore::Record read_record;
+  ASSERT_TRUE(store_->Read(address, 1, &read_record));
+  EXPECT_EQ(1u, read_record.entry_hash);
+  EXPECT_EQ(record.last_modified, read_record.last_modified);
+  EXPECT_EQ(record.file_images[0], read_record.file_images[0]);
+  EXPECT_EQ("", read_record.file_images[1]);
+
+  ASSERT_TRUE(store_->Read(large_address, 2, &read_record));
+  EXPECT_EQ(large_record.file_images[0], read_record.file_images[0]);
+  EXPECT_EQ(large_record.file_images[1], read_record.file_images[1]);
+
+  // The record of another entry is not read.
+  EXPECT_FALSE(store_->Read(address, 2, &read_record));
+  EXPECT_FALSE(store_->Read(SimpleSlabAddress(address.slab_number + 1, 0), 1,
+                            &read_record));
+
+  EXPECT_TRUE(
+      SimpleSlabStore::GetLastModified(temp_dir_.path(), &last_modified));
+}
+
+TEST_F(SimpleSlabStoreTest, Kill) {
+  SimpleSlabAddress address;
+  ASSERT_TRUE(store_->Append(MakeRecord(1, "one", ""), &address));
+
+  // Only the record of the right entry is killed.
+  store_->Kill(address, 2);
+  SimpleSlabStore::Record read_record;
+  EXPECT_TRUE(store_->Read(address, 1, &read_record));
+
+  store_->Kill(address, 1);
+  EXPECT_FALSE(store_->Read(address, 1, &read_record));
+  EXPECT_TRUE(ScanRecords().empty());
+}
+
+TEST_F(SimpleSlabStoreTest, ScanRecords) {
+  SimpleSlabAddress address1, address2, address3;
+  ASSERT_TRUE(store_->Append(MakeRecord(1, "one", ""), &address1));
+  ASSERT_TRUE(store_->Append(MakeRecord(2, "two", "2"), &address2));
+  ASSERT_TRUE(store_->Append(MakeRecord(1, "newer one", ""), &address3));
+  store_->Kill(address2, 2);
+
+  std::map<uint64, ScannedRecord> records = ScanRecords();
+  ASSERT_EQ(1u, records.size());
+  EXPECT_TRUE(address3 == records[1].address);
+  EXPECT_EQ(9, records[1].entry_size);
+
+  // A record that is superseded but not killed is still found.
+  store_->Kill(address3, 1);
+  records = ScanRecords();
+  ASSERT_EQ(1u, records.size());
+  EXPECT_TRUE(address1 == records[1].address);
+  EXPECT_EQ(3, records[1].entry_size);
+}
+
+TEST_F(SimpleSlabStoreTest, Compact) {
+  SimpleSlabAddress address1, address2, address3;
+  ASSERT_TRUE(store_->Append(MakeRecord(1, "one", ""), &address1));
+  ASSERT_TRUE(store_->Append(MakeRecord(2, "two", "2"), &address2));
+  ASSERT_TRUE(store_->Append(MakeRecord(3, "three", ""), &address3));
+  store_->Kill(address1, 1);
+  store_->Kill(address3, 3);
+  const uint64 sequence = ScanRecords()[2].sequence;
+
+  // The slab being appended to is never compacted.
+  std::vector<SimpleSlabStore::Move> moves;
+  uint32 slab_number;
+  EXPECT_FALSE(store_->ShouldCompact());
+  store_->Compact(&moves, &slab_number);
+  EXPECT_EQ(0u, slab_number);
+  EXPECT_TRUE(moves.empty());
+
+  // After a restart, records go to a new slab, and the old one, mostly dead,
+  // is compacted once it has been looked at.
+  store_ = new SimpleSlabStore(temp_dir_.path(), kEntryThreshold);
+  SimpleSlabStore::Record read_record;
+  ASSERT_TRUE(store_->Read(address2, 2, &read_record));
+  EXPECT_TRUE(store_->ShouldCompact());
+  store_->Compact(&moves, &slab_number);
+  EXPECT_EQ(address2.slab_number, slab_number);
+  ASSERT_EQ(1u, moves.size());
+  EXPECT_EQ(2u, moves[0].entry_hash);
+  EXPECT_TRUE(address2 == moves[0].from);
+  EXPECT_NE(address2.slab_number, moves[0].to.slab_number);
+  ASSERT_TRUE(store_->Read(moves[0].to, 2, &read_record));
+  EXPECT_EQ("two", read_record.file_images[0]);
+  EXPECT_EQ("2", read_record.file_images[1]);
+  EXPECT_FALSE(store_->ShouldCompact());
+
+  store_->DeleteSlab(slab_number);
+  EXPECT_FALSE(store_->Read(address2, 2, &read_record));
+
+  // The copy keeps the sequence number of the record.
+  std::map<uint64, ScannedRecord> records = ScanRecords();
+  ASSERT_EQ(1u, records.size());
+  EXPECT_TRUE(moves[0].to == records[2].address);
+  EXPECT_EQ(sequence, records[2].sequence);
+}
+
+}  // namespace disk_cache
@@ -10,6 +10,7 @@
 #include <limits>
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/files/file_util.h"
 #include "base/hash.h"
@@ -17,10 +18,12 @@
 #include "base/numerics/safe_conversions.h"
 #include "base/sha1.h"
 #include "base/strings/stringprintf.h"
+#include "base/task_runner.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
+#include "net/disk_cache/simple/simple_io_ring.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
 
@@ -41,7 +44,8 @@ enum OpenEntryResult {
   // OPEN_ENTRY_KEY_MISMATCH = 6, Deprecated.
   OPEN_ENTRY_KEY_HASH_MISMATCH = 7,
   OPEN_ENTRY_SPARSE_OPEN_FAILED = 8,
-  OPEN_ENTRY_MAX = 9,
+  OPEN_ENTRY_SLAB_READ_FAILED = 9,
+  OPEN_ENTRY_MAX = 10,
 };
 
 // Used in histograms, please only add entries at the end.
@@ -104,6 +108,14 @@ void RecordCloseResult(net::CacheType cache_type, CloseResult result) {
                    "SyncCloseResult", cache_type, result, WRITE_RESULT_MAX);
 }
 
+// Smaller streams would rarely take fewer clusters of the file system once
+// compressed.
+const int kMinStreamSizeToCompress = 4096;
+
+// Stream 1 is only compressed if its first block gets at least this much
+// smaller, in eighths.
+const int kMinCompressionSavingEighths = 1;
+
 bool CanOmitEmptyFile(int file_index) {
   DCHECK_GE(file_index, 0);
   DCHECK_LT(file_index, disk_cache::kSimpleEntryFileCount);
@@ -173,6 +185,10 @@ SimpleEntryCreationResults::SimpleEntryCreationResults(
 SimpleEntryCreationResults::~SimpleEntryCreationResults() {
 }
 
+SimpleEntryCloseResults::SimpleEntryCloseResults()
+    : compressed_stream_1_size(0) {
+}
+
 SimpleSynchronousEntry::CRCRecord::CRCRecord() : index(-1),
                                                  has_crc32(false),
                                                  data_crc32(0) {
@@ -215,9 +231,11 @@ void SimpleSynchronousEntry::OpenEntry(
     const FilePath& path,
     const uint64 entry_hash,
     bool had_index,
+    SimpleSlabStore* slab_store,
+    const SimpleSlabAddress& slab_address,
     SimpleEntryCreationResults *out_results) {
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, "", entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, "", entry_hash, slab_store, slab_address);
   out_results->result =
       sync_entry->InitializeForOpen(had_index,
                                     &out_results->entry_stat,
@@ -240,10 +258,12 @@ void SimpleSynchronousEntry::CreateEntry(
     const std::string& key,
     const uint64 entry_hash,
     bool had_index,
+    SimpleSlabStore* slab_store,
+    const SimpleSlabAddress& slab_address,
     SimpleEntryCreationResults *out_results) {
   DCHECK_EQ(entry_hash, GetEntryHashKey(key));
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, key, entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, key, entry_hash, slab_store, slab_address);
   out_results->result = sync_entry->InitializeForCreate(
       had_index, &out_results->entry_stat);
   if (out_results->result != net::OK) {
@@ -281,16 +301,22 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
                                       int* out_result) const {
   DCHECK(initialized_);
   DCHECK_NE(0, in_entry_op.index);
-  const int64 file_offset =
-      entry_stat->GetOffsetInFile(key_, in_entry_op.offset, in_entry_op.index);
   int file_index = GetFileIndexFromStreamIndex(in_entry_op.index);
   // Zero-length reads and reads to the empty streams of omitted files should
   // be handled in the SimpleEntryImpl.
   DCHECK_GT(in_entry_op.buf_len, 0);
   DCHECK(!empty_file_omitted_[file_index]);
-  File* file = const_cast<File*>(&files_[file_index]);
-  int bytes_read =
-      file->Read(file_offset, out_buf->data(), in_entry_op.buf_len);
+  int bytes_read;
+  if (in_entry_op.index == 1 && stream_1_codec_ != SIMPLE_COMPRESSION_NONE) {
+    bytes_read = ReadCompressedStream1(entry_stat->data_size(1),
+                                       in_entry_op.offset, out_buf->data(),
+                                       in_entry_op.buf_len);
+  } else {
+    const int64 file_offset = entry_stat->GetOffsetInFile(
+        key_, in_entry_op.offset, in_entry_op.index);
+    bytes_read = ReadFromFile(file_index, file_offset, out_buf->data(),
+                              in_entry_op.buf_len);
+  }
   if (bytes_read > 0) {
     entry_stat->set_last_used(Time::Now());
     *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
@@ -317,6 +343,19 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   int buf_len = in_entry_op.buf_len;
   bool truncate = in_entry_op.truncate;
   bool doomed = in_entry_op.doomed;
+  // Stream 1 is stored as it is from its first write on. Only the data that
+  // the write keeps needs to be uncompressed.
+  if (index == 1 && stream_1_codec_ != SIMPLE_COMPRESSION_NONE) {
+    const int data_size = out_entry_stat->data_size(1);
+    if (!UncompressStream1(data_size,
+                           truncate ? std::min(offset, data_size)
+                                    : data_size)) {
+      RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
+      Doom();
+      *out_result = net::ERR_CACHE_WRITE_FAILURE;
+      return;
+    }
+  }
   const int64 file_offset = out_entry_stat->GetOffsetInFile(
       key_, in_entry_op.offset, in_entry_op.index);
   bool extending_by_write = offset + buf_len > out_entry_stat->data_size(index);
@@ -352,7 +391,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     // The EOF record and the eventual stream afterward need to be zeroed out.
     const int64 file_eof_offset =
         out_entry_stat->GetEOFOffsetInFile(key_, index);
-    if (!files_[file_index].SetLength(file_eof_offset)) {
+    if (!SetFileLength(file_index, file_eof_offset)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_PRETRUNCATE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -360,8 +399,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     }
   }
   if (buf_len > 0) {
-    if (files_[file_index].Write(file_offset, in_buf->data(), buf_len) !=
-        buf_len) {
+    if (!WriteToFile(file_index, file_offset, in_buf->data(), buf_len)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -374,7 +412,7 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   } else {
     out_entry_stat->set_data_size(index, offset + buf_len);
     int file_eof_offset = out_entry_stat->GetLastEOFOffsetInFile(key_, index);
-    if (!files_[file_index].SetLength(file_eof_offset)) {
+    if (!SetFileLength(file_index, file_eof_offset)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_TRUNCATE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -382,6 +420,17 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     }
   }
 
+  // An entry that outgrows the slab store moves to files of its own, unless
+  // it is doomed: then it stays in memory until it is closed and dropped.
+  if (in_memory_ && !doomed &&
+      GetFileImagesSize() > slab_store_->entry_threshold() &&
+      !SpillToFiles()) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
+    Doom();
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   RecordWriteResult(cache_type_, WRITE_RESULT_SUCCESS);
   base::Time modification_time = Time::Now();
   out_entry_stat->set_last_used(modification_time);
@@ -389,6 +438,117 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   *out_result = buf_len;
 }
 
+void SimpleSynchronousEntry::ReadDataOnRing(
+    SimpleIORing* io_ring,
+    base::TaskRunner* worker_pool,
+    const EntryOperationData& in_entry_op,
+    net::IOBuffer* out_buf,
+    uint32* out_crc32,
+    SimpleEntryStat* entry_stat,
+    int* out_result,
+    const base::Closure& done) {
+  DCHECK(initialized_);
+  DCHECK_NE(0, in_entry_op.index);
+  const int64 file_offset =
+      entry_stat->GetOffsetInFile(key_, in_entry_op.offset, in_entry_op.index);
+  int file_index = GetFileIndexFromStreamIndex(in_entry_op.index);
+  DCHECK_GT(in_entry_op.buf_len, 0);
+  DCHECK(!empty_file_omitted_[file_index]);
+  const bool compressed =
+      in_entry_op.index == 1 && stream_1_codec_ != SIMPLE_COMPRESSION_NONE;
+  base::Closure fallback = base::Bind(&SimpleSynchronousEntry::ReadData,
+                                      base::Unretained(this),
+                                      in_entry_op,
+                                      make_scoped_refptr(out_buf),
+                                      out_crc32,
+                                      entry_stat,
+                                      out_result);
+  // An entry kept in memory has no files to read from, and compressed data
+  // needs to be uncompressed.
+  if (in_memory_ || compressed) {
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+    return;
+  }
+  if (!io_ring->Read(files_[file_index].GetPlatformFile(),
+                     file_offset,
+                     out_buf,
+                     in_entry_op.buf_len,
+                     base::Bind(&SimpleSynchronousEntry::RingReadComplete,
+                                make_scoped_refptr(worker_pool),
+                                fallback,
+                                make_scoped_refptr(out_buf),
+                                out_crc32,
+                                entry_stat,
+                                out_result,
+                                done))) {
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+  }
+}
+
+void SimpleSynchronousEntry::WriteDataOnRing(
+    SimpleIORing* io_ring,
+    base::TaskRunner* worker_pool,
+    const EntryOperationData& in_entry_op,
+    net::IOBuffer* in_buf,
+    SimpleEntryStat* out_entry_stat,
+    int* out_result,
+    const base::Closure& done) {
+  DCHECK(initialized_);
+  DCHECK_NE(0, in_entry_op.index);
+  int index = in_entry_op.index;
+  int file_index = GetFileIndexFromStreamIndex(index);
+  int offset = in_entry_op.offset;
+  int buf_len = in_entry_op.buf_len;
+  bool extending_by_write = offset + buf_len > out_entry_stat->data_size(index);
+  // The same steps as WriteData().
+  bool truncate_after =
+      in_entry_op.truncate || (buf_len == 0 && extending_by_write);
+  base::Closure fallback = base::Bind(&SimpleSynchronousEntry::WriteData,
+                                      base::Unretained(this),
+                                      in_entry_op,
+                                      make_scoped_refptr(in_buf),
+                                      out_entry_stat,
+                                      out_result);
+
+  // Creating a lazily omitted file, writing an entry kept in memory, and
+  // writing compressed data, are left to WriteData().
+  if (in_memory_ || empty_file_omitted_[file_index] ||
+      (index == 1 && stream_1_codec_ != SIMPLE_COMPRESSION_NONE) ||
+      ((extending_by_write || truncate_after) && !io_ring->can_truncate())) {
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+    return;
+  }
+
+  int64 length_before = -1;
+  if (extending_by_write)
+    length_before = out_entry_stat->GetEOFOffsetInFile(key_, index);
+  int data_size = std::max(out_entry_stat->data_size(index), offset + buf_len);
+  int64 length_after = -1;
+  if (truncate_after) {
+    data_size = offset + buf_len;
+    SimpleEntryStat new_entry_stat(*out_entry_stat);
+    new_entry_stat.set_data_size(index, data_size);
+    length_after = new_entry_stat.GetLastEOFOffsetInFile(key_, index);
+  }
+  if (!io_ring->Write(files_[file_index].GetPlatformFile(),
+                      length_before,
+                      out_entry_stat->GetOffsetInFile(key_, offset, index),
+                      in_buf,
+                      buf_len,
+                      length_after,
+                      base::Bind(&SimpleSynchronousEntry::RingWriteComplete,
+                                 cache_type_,
+                                 make_scoped_refptr(worker_pool),
+                                 fallback,
+                                 index,
+                                 data_size,
+                                 out_entry_stat,
+                                 out_result,
+                                 done))) {
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+  }
+}
+
 void SimpleSynchronousEntry::ReadSparseData(
     const EntryOperationData& in_entry_op,
     net::IOBuffer* out_buf,
@@ -599,8 +759,8 @@ void SimpleSynchronousEntry::CheckEOFRecord(int index,
   uint32 crc32;
   bool has_crc32;
   int stream_size;
-  *out_result =
-      GetEOFRecordData(index, entry_stat, &has_crc32, &crc32, &stream_size);
+  *out_result = GetEOFRecordData(index, GetFileEntryStat(entry_stat),
+                                 &has_crc32, &crc32, &stream_size);
   if (*out_result != net::OK) {
     Doom();
     return;
@@ -618,13 +778,36 @@ void SimpleSynchronousEntry::CheckEOFRecord(int index,
 void SimpleSynchronousEntry::Close(
     const SimpleEntryStat& entry_stat,
     scoped_ptr<std::vector<CRCRecord> > crc32s_to_write,
-    net::GrowableIOBuffer* stream_0_data) {
+    net::GrowableIOBuffer* stream_0_data,
+    bool doomed,
+    SimpleCompressionCodec compression_codec,
+    SimpleEntryCloseResults* out_results) {
   DCHECK(stream_0_data);
+  *out_results = SimpleEntryCloseResults();
+  // Compressing stream 1 moves stream 0 and the EOF records, which are only
+  // all rewritten here once both streams were written. The entries kept in
+  // memory are too small to gain from it.
+  bool writes_stream_0 = false;
+  bool writes_stream_1 = false;
+  for (std::vector<CRCRecord>::const_iterator it = crc32s_to_write->begin();
+       it != crc32s_to_write->end(); ++it) {
+    writes_stream_0 |= it->index == 0;
+    writes_stream_1 |= it->index == 1;
+  }
+  if (compression_codec != SIMPLE_COMPRESSION_NONE && !in_memory_ &&
+      !doomed && writes_stream_0 && writes_stream_1 &&
+      entry_stat.data_size(1) >= kMinStreamSizeToCompress &&
+      !CompressStream1(compression_codec, entry_stat.data_size(1))) {
+    RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+    DVLOG(1) << "Could not compress stream 1.";
+    Doom();
+  }
+  const SimpleEntryStat file_entry_stat = GetFileEntryStat(entry_stat);
+
   // Write stream 0 data.
-  int stream_0_offset = entry_stat.GetOffsetInFile(key_, 0, 0);
-  if (files_[0].Write(stream_0_offset, stream_0_data->data(),
-                      entry_stat.data_size(0)) !=
-      entry_stat.data_size(0)) {
+  int stream_0_offset = file_entry_stat.GetOffsetInFile(key_, 0, 0);
+  if (!WriteToFile(0, stream_0_offset, stream_0_data->data(),
+                   entry_stat.data_size(0))) {
     RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
     DVLOG(1) << "Could not write stream 0 data.";
     Doom();
@@ -643,34 +826,65 @@ void SimpleSynchronousEntry::Close(
     eof_record.flags = 0;
     if (it->has_crc32)
       eof_record.flags |= SimpleFileEOF::FLAG_HAS_CRC32;
+    if (stream_index == 1)
+      eof_record.flags |= GetEOFFlagsForCompressionCodec(stream_1_codec_);
     eof_record.data_crc32 = it->data_crc32;
-    int eof_offset = entry_stat.GetEOFOffsetInFile(key_, stream_index);
+    int eof_offset = file_entry_stat.GetEOFOffsetInFile(key_, stream_index);
     // If stream 0 changed size, the file needs to be resized, otherwise the
     // next open will yield wrong stream sizes. On stream 1 and stream 2 proper
     // resizing of the file is handled in SimpleSynchronousEntry::WriteData().
-    if (stream_index == 0 &&
-        !files_[file_index].SetLength(eof_offset)) {
+    if (stream_index == 0 && !SetFileLength(file_index, eof_offset)) {
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not truncate stream 0 file.";
       Doom();
       break;
     }
-    if (files_[file_index].Write(eof_offset,
-                                 reinterpret_cast<const char*>(&eof_record),
-                                 sizeof(eof_record)) !=
-        sizeof(eof_record)) {
+    if (!WriteToFile(file_index, eof_offset,
+                     reinterpret_cast<const char*>(&eof_record),
+                     sizeof(eof_record))) {
       RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
       DVLOG(1) << "Could not write eof record.";
       Doom();
       break;
     }
   }
+
+  // Stream 0 is only written here, so it can still push the entry over the
+  // threshold of the slab store.
+  if (in_memory_ && !doomed &&
+      GetFileImagesSize() > slab_store_->entry_threshold() &&
+      !SpillToFiles()) {
+    RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+    DVLOG(1) << "Could not move entry to its own files.";
+    Doom();
+    doomed = true;
+  }
+  if (in_memory_) {
+    if (doomed) {
+      // The index no longer refers to the entry, and drops its record.
+    } else if (file_images_changed_ || !slab_address_.is_valid()) {
+      SimpleSlabStore::Record record;
+      record.entry_hash = entry_hash_;
+      record.last_modified = entry_stat.last_modified();
+      for (int i = 0; i < kSimpleEntryFileCount; ++i)
+        record.file_images[i].swap(file_images_[i]);
+      if (!slab_store_->Append(record, &out_results->slab_address)) {
+        RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+        DVLOG(1) << "Could not append entry to slab.";
+      }
+    } else {
+      out_results->slab_address = slab_address_;
+    }
+    for (int i = 0; i < kSimpleEntryFileCount; ++i)
+      file_images_[i].clear();
+  }
+
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
-    if (empty_file_omitted_[i])
+    if (empty_file_omitted_[i] || in_memory_)
       continue;
 
     files_[i].Close();
-    const int64 file_size = entry_stat.GetFileSize(key_, i);
+    const int64 file_size = file_entry_stat.GetFileSize(key_, i);
     SIMPLE_CACHE_UMA(CUSTOM_COUNTS,
                      "LastClusterSize", cache_type_,
                      file_size % 4096, 0, 4097, 50);
@@ -689,6 +903,7 @@ void SimpleSynchronousEntry::Close(
     SIMPLE_CACHE_UMA(BOOLEAN, "EntryCreatedAndStream2Omitted", cache_type_,
                      empty_file_omitted_[stream2_file_index]);
   }
+  out_results->compressed_stream_1_size = compressed_stream_1_size_;
   RecordCloseResult(cache_type_, CLOSE_RESULT_SUCCESS);
   have_open_files_ = false;
   delete this;
@@ -697,13 +912,22 @@ void SimpleSynchronousEntry::Close(
 SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
                                                const FilePath& path,
                                                const std::string& key,
-                                               const uint64 entry_hash)
+                                               const uint64 entry_hash,
+                                               SimpleSlabStore* slab_store,
+                                               const SimpleSlabAddress&
+                                                   slab_address)
     : cache_type_(cache_type),
       path_(path),
       entry_hash_(entry_hash),
       key_(key),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      slab_store_(slab_store),
+      slab_address_(slab_address),
+      in_memory_(false),
+      file_images_changed_(false),
+      stream_1_codec_(SIMPLE_COMPRESSION_NONE),
+      compressed_stream_1_size_(0) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -746,6 +970,18 @@ bool SimpleSynchronousEntry::MaybeCreateFile(
   }
 
   FilePath filename = GetFilenameFromFileIndex(file_index);
+  if (in_memory_) {
+    // Like FLAG_CREATE, fail if the entry already has its own files.
+    if (base::PathExists(filename)) {
+      *out_error = File::FILE_ERROR_EXISTS;
+      return false;
+    }
+    file_images_[file_index].clear();
+    file_images_changed_ = true;
+    empty_file_omitted_[file_index] = false;
+    return true;
+  }
+
   int flags = File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE |
               File::FLAG_SHARE_DELETE;
   files_[file_index].Initialize(filename, flags);
@@ -836,6 +1072,34 @@ bool SimpleSynchronousEntry::OpenFiles(
   return true;
 }
 
+bool SimpleSynchronousEntry::OpenFileImages(
+    bool had_index,
+    SimpleEntryStat* out_entry_stat) {
+  SimpleSlabStore::Record record;
+  if (!slab_store_->Read(slab_address_, entry_hash_, &record) ||
+      record.file_images[0].empty()) {
+    RecordSyncOpenResult(cache_type_, OPEN_ENTRY_SLAB_READ_FAILED, had_index);
+    return false;
+  }
+
+  have_open_files_ = true;
+
+  for (int i = 0; i < kSimpleEntryFileCount; ++i) {
+    file_images_[i].swap(record.file_images[i]);
+    empty_file_omitted_[i] = file_images_[i].empty();
+    // As in OpenFiles(), the file sizes are kept in |data_size| until the key
+    // is known.
+    out_entry_stat->set_data_size(i + 1,
+                                  static_cast<int>(file_images_[i].size()));
+  }
+  out_entry_stat->set_last_used(record.last_modified);
+  out_entry_stat->set_last_modified(record.last_modified);
+
+  files_created_ = false;
+
+  return true;
+}
+
 bool SimpleSynchronousEntry::CreateFiles(
     bool had_index,
     SimpleEntryStat* out_entry_stat) {
@@ -880,6 +1144,8 @@ bool SimpleSynchronousEntry::CreateFiles(
 void SimpleSynchronousEntry::CloseFile(int index) {
   if (empty_file_omitted_[index]) {
     empty_file_omitted_[index] = false;
+  } else if (in_memory_) {
+    file_images_[index].clear();
   } else {
     DCHECK(files_[index].IsValid());
     files_[index].Close();
@@ -900,7 +1166,9 @@ int SimpleSynchronousEntry::InitializeForOpen(
     scoped_refptr<net::GrowableIOBuffer>* stream_0_data,
     uint32* out_stream_0_crc32) {
   DCHECK(!initialized_);
-  if (!OpenFiles(had_index, out_entry_stat)) {
+  in_memory_ = slab_store_.get() && slab_address_.is_valid();
+  if (in_memory_ ? !OpenFileImages(had_index, out_entry_stat)
+                 : !OpenFiles(had_index, out_entry_stat)) {
     DLOG(WARNING) << "Could not open platform files for entry.";
     return net::ERR_FAILED;
   }
@@ -910,7 +1178,7 @@ int SimpleSynchronousEntry::InitializeForOpen(
 
     SimpleFileHeader header;
     int header_read_result =
-        files_[i].Read(0, reinterpret_cast<char*>(&header), sizeof(header));
+        ReadFromFile(i, 0, reinterpret_cast<char*>(&header), sizeof(header));
     if (header_read_result != sizeof(header)) {
       DLOG(WARNING) << "Cannot read header from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_HEADER, had_index);
@@ -933,8 +1201,8 @@ int SimpleSynchronousEntry::InitializeForOpen(
     }
 
     scoped_ptr<char[]> key(new char[header.key_length]);
-    int key_read_result = files_[i].Read(sizeof(header), key.get(),
-                                         header.key_length);
+    int key_read_result =
+        ReadFromFile(i, sizeof(header), key.get(), header.key_length);
     if (key_read_result != implicit_cast<int>(header.key_length)) {
       DLOG(WARNING) << "Cannot read key from entry.";
       RecordSyncOpenResult(cache_type_, OPEN_ENTRY_CANT_READ_KEY, had_index);
@@ -946,10 +1214,16 @@ int SimpleSynchronousEntry::InitializeForOpen(
       // File size for stream 0 has been stored temporarily in data_size[1].
       int total_data_size =
           GetDataSizeFromKeyAndFileSize(key_, out_entry_stat->data_size(1));
-      int ret_value_stream_0 = ReadAndValidateStream0(
-          total_data_size, out_entry_stat, stream_0_data, out_stream_0_crc32);
+      SimpleFileEOF stream_1_eof;
+      int ret_value_stream_0 =
+          ReadAndValidateStream0(total_data_size, out_entry_stat, stream_0_data,
+                                 out_stream_0_crc32, &stream_1_eof);
       if (ret_value_stream_0 != net::OK)
         return ret_value_stream_0;
+      if (!ReadStream1BlockTable(stream_1_eof, out_entry_stat)) {
+        DLOG(WARNING) << "Cannot read the block table of stream 1.";
+        return net::ERR_FAILED;
+      }
     } else {
       out_entry_stat->set_data_size(
           2, GetDataSizeFromKeyAndFileSize(key_, out_entry_stat->data_size(2)));
@@ -967,8 +1241,9 @@ int SimpleSynchronousEntry::InitializeForOpen(
     }
   }
 
+  // An entry with sparse data is never kept in a slab.
   int32 sparse_data_size = 0;
-  if (!OpenSparseFileIfExists(&sparse_data_size)) {
+  if (!in_memory_ && !OpenSparseFileIfExists(&sparse_data_size)) {
     RecordSyncOpenResult(
         cache_type_, OPEN_ENTRY_SPARSE_OPEN_FAILED, had_index);
     return net::ERR_FAILED;
@@ -982,7 +1257,10 @@ int SimpleSynchronousEntry::InitializeForOpen(
       out_entry_stat->data_size(2) == 0) {
     DVLOG(1) << "Removing empty stream 2 file.";
     CloseFile(stream2_file_index);
-    DeleteFileForEntryHash(path_, entry_hash_, stream2_file_index);
+    if (in_memory_)
+      file_images_changed_ = true;
+    else
+      DeleteFileForEntryHash(path_, entry_hash_, stream2_file_index);
     empty_file_omitted_[stream2_file_index] = true;
     removed_stream2 = true;
   }
@@ -1005,16 +1283,13 @@ bool SimpleSynchronousEntry::InitializeCreatedFile(
   header.key_length = key_.size();
   header.key_hash = base::Hash(key_);
 
-  int bytes_written = files_[file_index].Write(
-      0, reinterpret_cast<char*>(&header), sizeof(header));
-  if (bytes_written != sizeof(header)) {
+  if (!WriteToFile(file_index, 0, reinterpret_cast<char*>(&header),
+                   sizeof(header))) {
     *out_result = CREATE_ENTRY_CANT_WRITE_HEADER;
     return false;
   }
 
-  bytes_written = files_[file_index].Write(sizeof(header), key_.data(),
-                                           key_.size());
-  if (bytes_written != implicit_cast<int>(key_.size())) {
+  if (!WriteToFile(file_index, sizeof(header), key_.data(), key_.size())) {
     *out_result = CREATE_ENTRY_CANT_WRITE_KEY;
     return false;
   }
@@ -1026,6 +1301,11 @@ int SimpleSynchronousEntry::InitializeForCreate(
     bool had_index,
     SimpleEntryStat* out_entry_stat) {
   DCHECK(!initialized_);
+  if (slab_address_.is_valid()) {
+    DLOG(WARNING) << "Entry already exists in a slab.";
+    return net::ERR_FILE_EXISTS;
+  }
+  in_memory_ = slab_store_.get() && slab_store_->entry_threshold() > 0;
   if (!CreateFiles(had_index, out_entry_stat)) {
     DLOG(WARNING) << "Could not create platform files.";
     return net::ERR_FILE_EXISTS;
@@ -1049,7 +1329,8 @@ int SimpleSynchronousEntry::ReadAndValidateStream0(
     int total_data_size,
     SimpleEntryStat* out_entry_stat,
     scoped_refptr<net::GrowableIOBuffer>* stream_0_data,
-    uint32* out_stream_0_crc32) const {
+    uint32* out_stream_0_crc32,
+    SimpleFileEOF* out_stream_1_eof) const {
   // Temporarily assign all the data size to stream 1 in order to read the
   // EOF record for stream 0, which contains the size of stream 0.
   out_entry_stat->set_data_size(0, 0);
@@ -1071,15 +1352,20 @@ int SimpleSynchronousEntry::ReadAndValidateStream0(
   out_entry_stat->set_data_size(
       1, out_entry_stat->data_size(1) - stream_0_size);
 
-  // Put stream 0 data in memory.
+  // Put stream 0 data in memory, and the EOF record of stream 1 before it
+  // with the same read.
   *stream_0_data = new net::GrowableIOBuffer();
-  (*stream_0_data)->SetCapacity(stream_0_size);
-  int file_offset = out_entry_stat->GetOffsetInFile(key_, 0, 0);
-  File* file = const_cast<File*>(&files_[0]);
+  const int read_size = sizeof(SimpleFileEOF) + stream_0_size;
+  (*stream_0_data)->SetCapacity(read_size);
+  int file_offset = out_entry_stat->GetEOFOffsetInFile(key_, 1);
   int bytes_read =
-      file->Read(file_offset, (*stream_0_data)->data(), stream_0_size);
-  if (bytes_read != stream_0_size)
+      ReadFromFile(0, file_offset, (*stream_0_data)->data(), read_size);
+  if (bytes_read != read_size)
     return net::ERR_FAILED;
+  memcpy(out_stream_1_eof, (*stream_0_data)->data(), sizeof(SimpleFileEOF));
+  memmove((*stream_0_data)->data(),
+          (*stream_0_data)->data() + sizeof(SimpleFileEOF), stream_0_size);
+  (*stream_0_data)->SetCapacity(stream_0_size);
 
   // Check the CRC32.
   uint32 expected_crc32 =
@@ -1106,10 +1392,9 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
   SimpleFileEOF eof_record;
   int file_offset = entry_stat.GetEOFOffsetInFile(key_, index);
   int file_index = GetFileIndexFromStreamIndex(index);
-  File* file = const_cast<File*>(&files_[file_index]);
-  if (file->Read(file_offset, reinterpret_cast<char*>(&eof_record),
-                 sizeof(eof_record)) !=
-      sizeof(eof_record)) {
+  if (ReadFromFile(file_index, file_offset,
+                   reinterpret_cast<char*>(&eof_record),
+                   sizeof(eof_record)) != sizeof(eof_record)) {
     RecordCheckEOFResult(cache_type_, CHECK_EOF_RESULT_READ_FAILURE);
     return net::ERR_CACHE_CHECKSUM_READ_FAILURE;
   }
@@ -1128,6 +1413,321 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
   return net::OK;
 }
 
+bool SimpleSynchronousEntry::ReadStream1BlockTable(
+    const SimpleFileEOF& stream_1_eof,
+    SimpleEntryStat* out_entry_stat) {
+  // A stream 1 EOF record that is not there is only noticed by the crc32
+  // checks, as before streams could be compressed.
+  if (stream_1_eof.final_magic_number != kSimpleFinalMagicNumber)
+    return true;
+  const SimpleCompressionCodec codec =
+      GetCompressionCodecFromEOFFlags(stream_1_eof.flags);
+  if (codec == SIMPLE_COMPRESSION_NONE)
+    return true;
+
+  const int compressed_size = out_entry_stat->data_size(1);
+  if (stream_1_eof.stream_size == 0 ||
+      stream_1_eof.stream_size >
+          static_cast<uint32>(std::numeric_limits<int32>::max())) {
+    return false;
+  }
+  const int data_size = stream_1_eof.stream_size;
+  const int block_count = (data_size - 1) / kSimpleCompressionBlockSize + 1;
+  const int table_size = block_count * sizeof(uint32);
+  if (compressed_size < table_size)
+    return false;
+  std::vector<uint32> block_ends(block_count);
+  const int64 table_offset =
+      sizeof(SimpleFileHeader) + key_.size() + compressed_size - table_size;
+  if (ReadFromFile(0, table_offset, reinterpret_cast<char*>(&block_ends[0]),
+                   table_size) != table_size) {
+    return false;
+  }
+  uint32 block_start = 0;
+  for (int i = 0; i < block_count; ++i) {
+    const uint32 block_size =
+        std::min(kSimpleCompressionBlockSize,
+                 data_size - i * kSimpleCompressionBlockSize);
+    if (block_ends[i] < block_start ||
+        block_ends[i] - block_start > block_size) {
+      return false;
+    }
+    block_start = block_ends[i];
+  }
+  if (block_start != static_cast<uint32>(compressed_size - table_size))
+    return false;
+
+  stream_1_codec_ = codec;
+  compressed_stream_1_size_ = compressed_size;
+  stream_1_block_ends_.swap(block_ends);
+  out_entry_stat->set_data_size(1, data_size);
+  return true;
+}
+
+SimpleEntryStat SimpleSynchronousEntry::GetFileEntryStat(
+    const SimpleEntryStat& entry_stat) const {
+  SimpleEntryStat file_entry_stat(entry_stat);
+  if (stream_1_codec_ != SIMPLE_COMPRESSION_NONE)
+    file_entry_stat.set_data_size(1, compressed_stream_1_size_);
+  return file_entry_stat;
+}
+
+int SimpleSynchronousEntry::ReadCompressedStream1(int data_size,
+                                                  int offset,
+                                                  char* data,
+                                                  int size) const {
+  DCHECK_NE(SIMPLE_COMPRESSION_NONE, stream_1_codec_);
+  if (offset < 0 || size < 0)
+    return -1;
+  if (offset >= data_size || size == 0)
+    return 0;
+  size = std::min(size, data_size - offset);
+  const int first_block = offset / kSimpleCompressionBlockSize;
+  const int last_block = (offset + size - 1) / kSimpleCompressionBlockSize;
+  const uint32 stored_start =
+      first_block == 0 ? 0 : stream_1_block_ends_[first_block - 1];
+  const int stored_size = stream_1_block_ends_[last_block] - stored_start;
+
+  // The blocks are next to each other in the file, and read at once.
+  scoped_ptr<char[]> stored(new char[stored_size]);
+  if (ReadFromFile(0, sizeof(SimpleFileHeader) + key_.size() + stored_start,
+                   stored.get(), stored_size) != stored_size) {
+    return -1;
+  }
+  SimpleBlockCodec block_codec(stream_1_codec_);
+  scoped_ptr<char[]> block;
+  uint32 block_start = stored_start;
+  int bytes_read = 0;
+  for (int i = first_block; i <= last_block; ++i) {
+    const int block_offset = i * kSimpleCompressionBlockSize;
+    const int block_size =
+        std::min(kSimpleCompressionBlockSize, data_size - block_offset);
+    const char* stored_block = stored.get() + (block_start - stored_start);
+    const int stored_block_size = stream_1_block_ends_[i] - block_start;
+    block_start = stream_1_block_ends_[i];
+    const int begin = std::max(offset, block_offset) - block_offset;
+    const int end =
+        std::min(offset + size, block_offset + block_size) - block_offset;
+    char* out = data + bytes_read;
+    bytes_read += end - begin;
+
+    if (stored_block_size == block_size) {
+      memcpy(out, stored_block + begin, end - begin);
+    } else if (begin == 0 && end == block_size) {
+      if (!block_codec.Uncompress(stored_block, stored_block_size, out,
+                                  block_size)) {
+        return -1;
+      }
+    } else {
+      if (!block)
+        block.reset(new char[kSimpleCompressionBlockSize]);
+      if (!block_codec.Uncompress(stored_block, stored_block_size, block.get(),
+                                  block_size)) {
+        return -1;
+      }
+      memcpy(out, block.get() + begin, end - begin);
+    }
+  }
+  return bytes_read;
+}
+
+bool SimpleSynchronousEntry::CompressStream1(SimpleCompressionCodec codec,
+                                             int data_size) {
+  DCHECK_EQ(SIMPLE_COMPRESSION_NONE, stream_1_codec_);
+  DCHECK(!in_memory_);
+  const int64 stream_offset = sizeof(SimpleFileHeader) + key_.size();
+  const int block_count =
+      (data_size + kSimpleCompressionBlockSize - 1) /
+      kSimpleCompressionBlockSize;
+  SimpleBlockCodec block_codec(codec);
+  scoped_ptr<char[]> block(new char[kSimpleCompressionBlockSize]);
+  std::string compressed;
+  std::vector<uint32> block_ends;
+  block_ends.reserve(block_count);
+  uint32 compressed_size = 0;
+  for (int i = 0; i < block_count; ++i) {
+    const int block_size =
+        std::min(kSimpleCompressionBlockSize,
+                 data_size - i * kSimpleCompressionBlockSize);
+    if (ReadFromFile(0, stream_offset + i * kSimpleCompressionBlockSize,
+                     block.get(), block_size) != block_size) {
+      return false;
+    }
+    const bool is_compressed =
+        block_codec.Compress(block.get(), block_size, &compressed);
+    if (i == 0) {
+      // Data that is already compressed, like most images, is left as it is.
+      if (!is_compressed ||
+          static_cast<int>(compressed.size()) >
+              block_size - block_size * kMinCompressionSavingEighths / 8) {
+        return true;
+      }
+      // Until Close() writes the EOF records again, the file does not open.
+      if (!SetFileLength(0, stream_offset + data_size))
+        return false;
+    }
+    // A block never takes more room than it did before, so that it does not
+    // overwrite the blocks that are still to be read.
+    const char* stored_block = is_compressed ? compressed.data() : block.get();
+    const int stored_block_size =
+        is_compressed ? static_cast<int>(compressed.size()) : block_size;
+    if (!WriteToFile(0, stream_offset + compressed_size, stored_block,
+                     stored_block_size)) {
+      return false;
+    }
+    compressed_size += stored_block_size;
+    block_ends.push_back(compressed_size);
+  }
+  const int table_size = block_count * sizeof(uint32);
+  if (!WriteToFile(0, stream_offset + compressed_size,
+                   reinterpret_cast<const char*>(&block_ends[0]),
+                   table_size) ||
+      !SetFileLength(0, stream_offset + compressed_size + table_size)) {
+    return false;
+  }
+
+  SIMPLE_CACHE_UMA(PERCENTAGE, "CompressedStream1SizePercent", cache_type_,
+                   static_cast<base::HistogramBase::Sample>(
+                       (compressed_size + table_size) * 100LL / data_size));
+  stream_1_codec_ = codec;
+  compressed_stream_1_size_ = compressed_size + table_size;
+  stream_1_block_ends_.swap(block_ends);
+  return true;
+}
+
+bool SimpleSynchronousEntry::UncompressStream1(int data_size, int keep_size) {
+  DCHECK_NE(SIMPLE_COMPRESSION_NONE, stream_1_codec_);
+  DCHECK_LE(keep_size, data_size);
+  const SimpleCompressionCodec codec = stream_1_codec_;
+  std::vector<uint32> block_ends;
+  block_ends.swap(stream_1_block_ends_);
+  stream_1_codec_ = SIMPLE_COMPRESSION_NONE;
+  compressed_stream_1_size_ = 0;
+
+  const int64 stream_offset = sizeof(SimpleFileHeader) + key_.size();
+  const int block_count =
+      (keep_size + kSimpleCompressionBlockSize - 1) /
+      kSimpleCompressionBlockSize;
+  if (block_count == 0)
+    return SetFileLength(0, stream_offset);
+
+  // Uncompressed blocks take more room, so all of the compressed ones are read
+  // before any is written.
+  const int stored_size = block_ends[block_count - 1];
+  scoped_ptr<char[]> stored(new char[stored_size]);
+  if (ReadFromFile(0, stream_offset, stored.get(), stored_size) !=
+      stored_size) {
+    return false;
+  }
+  SimpleBlockCodec block_codec(codec);
+  scoped_ptr<char[]> block(new char[kSimpleCompressionBlockSize]);
+  uint32 block_start = 0;
+  for (int i = 0; i < block_count; ++i) {
+    const int block_offset = i * kSimpleCompressionBlockSize;
+    const int block_size =
+        std::min(kSimpleCompressionBlockSize, data_size - block_offset);
+    const char* block_data = stored.get() + block_start;
+    const int stored_block_size = block_ends[i] - block_start;
+    block_start = block_ends[i];
+    if (stored_block_size != block_size) {
+      if (!block_codec.Uncompress(block_data, stored_block_size, block.get(),
+                                  block_size)) {
+        return false;
+      }
+      block_data = block.get();
+    }
+    if (!WriteToFile(0, stream_offset + block_offset, block_data,
+                     std::min(block_size, keep_size - block_offset))) {
+      return false;
+    }
+  }
+  return SetFileLength(0, stream_offset + keep_size);
+}
+
+int SimpleSynchronousEntry::ReadFromFile(int file_index,
+                                         int64 offset,
+                                         char* data,
+                                         int size) const {
+  if (!in_memory_) {
+    File* file = const_cast<File*>(&files_[file_index]);
+    return file->Read(offset, data, size);
+  }
+  const std::string& image = file_images_[file_index];
+  if (offset < 0 || size < 0)
+    return -1;
+  if (offset >= static_cast<int64>(image.size()))
+    return 0;
+  const int bytes_read =
+      static_cast<int>(std::min<int64>(size, image.size() - offset));
+  memcpy(data, image.data() + offset, bytes_read);
+  return bytes_read;
+}
+
+bool SimpleSynchronousEntry::WriteToFile(int file_index,
+                                         int64 offset,
+                                         const char* data,
+                                         int size) {
+  if (!in_memory_)
+    return files_[file_index].Write(offset, data, size) == size;
+  if (offset < 0 || size < 0)
+    return false;
+  std::string* image = &file_images_[file_index];
+  if (offset + size > static_cast<int64>(image->size())) {
+    image->resize(offset + size);
+    file_images_changed_ = true;
+  }
+  // Close() rewrites stream 0 and the EOF records even if they did not
+  // change, which must not make the entry go back to the slab store.
+  if (size > 0 && memcmp(&(*image)[offset], data, size) != 0) {
+    memcpy(&(*image)[offset], data, size);
+    file_images_changed_ = true;
+  }
+  return true;
+}
+
+bool SimpleSynchronousEntry::SetFileLength(int file_index, int64 length) {
+  if (!in_memory_)
+    return files_[file_index].SetLength(length);
+  if (length < 0)
+    return false;
+  if (length != static_cast<int64>(file_images_[file_index].size())) {
+    file_images_[file_index].resize(length);
+    file_images_changed_ = true;
+  }
+  return true;
+}
+
+int64 SimpleSynchronousEntry::GetFileImagesSize() const {
+  int64 size = 0;
+  for (int i = 0; i < kSimpleEntryFileCount; ++i)
+    size += file_images_[i].size();
+  return size;
+}
+
+bool SimpleSynchronousEntry::SpillToFiles() {
+  DCHECK(in_memory_);
+  for (int i = 0; i < kSimpleEntryFileCount; ++i) {
+    if (empty_file_omitted_[i])
+      continue;
+    // Files left over from before the entry went to a slab are stale.
+    files_[i].Initialize(GetFilenameFromFileIndex(i),
+                         File::FLAG_CREATE_ALWAYS | File::FLAG_READ |
+                             File::FLAG_WRITE | File::FLAG_SHARE_DELETE);
+    const std::string& image = file_images_[i];
+    if (!files_[i].IsValid() ||
+        files_[i].Write(0, image.data(), image.size()) !=
+            static_cast<int>(image.size())) {
+      for (int j = 0; j <= i; ++j)
+        files_[j].Close();
+      return false;
+    }
+  }
+  in_memory_ = false;
+  for (int i = 0; i < kSimpleEntryFileCount; ++i)
+    file_images_[i].clear();
+  return true;
+}
+
 void SimpleSynchronousEntry::Doom() const {
   DeleteFilesForEntryHash(path_, entry_hash_);
 }
@@ -1178,6 +1778,56 @@ FilePath SimpleSynchronousEntry::GetFilenameFromFileIndex(int file_index) {
       GetFilenameFromEntryHashAndFileIndex(entry_hash_, file_index));
 }
 
+// static
+void SimpleSynchronousEntry::RingReadComplete(
+    const scoped_refptr<base::TaskRunner>& worker_pool,
+    const base::Closure& fallback,
+    const scoped_refptr<net::IOBuffer>& out_buf,
+    uint32* out_crc32,
+    SimpleEntryStat* entry_stat,
+    int* out_result,
+    const base::Closure& done,
+    int result) {
+  if (result < 0) {
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+    return;
+  }
+  if (result > 0) {
+    entry_stat->set_last_used(Time::Now());
+    *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
+                       reinterpret_cast<const Bytef*>(out_buf->data()),
+                       result);
+  }
+  *out_result = result;
+  done.Run();
+}
+
+// static
+void SimpleSynchronousEntry::RingWriteComplete(
+    net::CacheType cache_type,
+    const scoped_refptr<base::TaskRunner>& worker_pool,
+    const base::Closure& fallback,
+    int index,
+    int data_size,
+    SimpleEntryStat* out_entry_stat,
+    int* out_result,
+    const base::Closure& done,
+    int result) {
+  if (result < 0) {
+    // Nothing was recorded in |out_entry_stat| yet, so WriteData() starts
+    // over from the same state.
+    worker_pool->PostTaskAndReply(FROM_HERE, fallback, done);
+    return;
+  }
+  out_entry_stat->set_data_size(index, data_size);
+  RecordWriteResult(cache_type, WRITE_RESULT_SUCCESS);
+  base::Time modification_time = Time::Now();
+  out_entry_stat->set_last_used(modification_time);
+  out_entry_stat->set_last_modified(modification_time);
+  *out_result = result;
+  done.Run();
+}
+
 bool SimpleSynchronousEntry::OpenSparseFileIfExists(
     int32* out_sparse_data_size) {
   DCHECK(!sparse_file_open());
@@ -1196,6 +1846,9 @@ bool SimpleSynchronousEntry::OpenSparseFileIfExists(
 bool SimpleSynchronousEntry::CreateSparseFile() {
   DCHECK(!sparse_file_open());
 
+  if (in_memory_ && !SpillToFiles())
+    return false;
+
   FilePath filename = path_.AppendASCII(
       GetSparseFilenameFromEntryHash(entry_hash_));
   int flags = File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE |
@@ -11,6 +11,7 @@
 #include <utility>
 #include <vector>
 
+#include "base/callback_forward.h"
 #include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
@@ -18,7 +19,13 @@
 #include "base/time/time.h"
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_compression.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_slab_store.h"
+
+namespace base {
+class TaskRunner;
+}
 
 namespace net {
 class GrowableIOBuffer;
@@ -27,6 +34,7 @@ class IOBuffer;
 
 namespace disk_cache {
 
+class SimpleIORing;
 class SimpleSynchronousEntry;
 
 // This class handles the passing of data about the entry between
@@ -81,6 +89,16 @@ struct SimpleEntryCreationResults {
   int result;
 };
 
+struct SimpleEntryCloseResults {
+  SimpleEntryCloseResults();
+
+  // The address of the record of an entry kept in a slab, or an invalid
+  // address if the entry is in files of its own.
+  SimpleSlabAddress slab_address;
+  // The size that stream 1 takes in its file if it is compressed, or 0.
+  int32 compressed_stream_1_size;
+};
+
 // Worker thread interface to the very simple cache. This interface is not
 // thread safe, and callers must ensure that it is only ever accessed from
 // a single thread between synchronization points.
@@ -112,17 +130,26 @@ class SimpleSynchronousEntry {
     bool doomed;
   };
 
+  // An entry with a valid |slab_address| is read from its record in
+  // |slab_store|, and kept in memory while it is open.
   static void OpenEntry(net::CacheType cache_type,
                         const base::FilePath& path,
                         uint64 entry_hash,
                         bool had_index,
+                        SimpleSlabStore* slab_store,
+                        const SimpleSlabAddress& slab_address,
                         SimpleEntryCreationResults* out_results);
 
+  // A created entry is kept in memory, to be stored in |slab_store| when it
+  // is closed, if the store takes new entries. |slab_address| is where the
+  // index has a record for |entry_hash|, if it does.
   static void CreateEntry(net::CacheType cache_type,
                           const base::FilePath& path,
                           const std::string& key,
                           uint64 entry_hash,
                           bool had_index,
+                          SimpleSlabStore* slab_store,
+                          const SimpleSlabAddress& slab_address,
                           SimpleEntryCreationResults* out_results);
 
   // Deletes an entry from the file system without affecting the state of the
@@ -152,6 +179,27 @@ class SimpleSynchronousEntry {
                       uint32 expected_crc32,
                       int* out_result) const;
 
+  // Like ReadData() and WriteData(), but called on the IO thread, which they
+  // do not block: the IO goes through |io_ring|, and |done| runs on the IO
+  // thread once the outputs are set. An operation that the ring cannot take,
+  // or that fails, is handed to ReadData() or WriteData() on |worker_pool|,
+  // which then deals with the failure.
+  void ReadDataOnRing(SimpleIORing* io_ring,
+                      base::TaskRunner* worker_pool,
+                      const EntryOperationData& in_entry_op,
+                      net::IOBuffer* out_buf,
+                      uint32* out_crc32,
+                      SimpleEntryStat* entry_stat,
+                      int* out_result,
+                      const base::Closure& done);
+  void WriteDataOnRing(SimpleIORing* io_ring,
+                       base::TaskRunner* worker_pool,
+                       const EntryOperationData& in_entry_op,
+                       net::IOBuffer* in_buf,
+                       SimpleEntryStat* out_entry_stat,
+                       int* out_result,
+                       const base::Closure& done);
+
   void ReadSparseData(const EntryOperationData& in_entry_op,
                       net::IOBuffer* out_buf,
                       base::Time* out_last_used,
@@ -166,14 +214,23 @@ class SimpleSynchronousEntry {
                          int* out_result);
 
   // Close all streams, and add write EOF records to streams indicated by the
-  // CRCRecord entries in |crc32s_to_write|.
+  // CRCRecord entries in |crc32s_to_write|. Stream 1 is compressed with
+  // |compression_codec|, unless it is NONE, if it was written since the entry
+  // was opened and compresses well. An entry kept in memory is stored in the
+  // slab store unless it is |doomed|.
   void Close(const SimpleEntryStat& entry_stat,
              scoped_ptr<std::vector<CRCRecord> > crc32s_to_write,
-             net::GrowableIOBuffer* stream_0_data);
+             net::GrowableIOBuffer* stream_0_data,
+             bool doomed,
+             SimpleCompressionCodec compression_codec,
+             SimpleEntryCloseResults* out_results);
 
   const base::FilePath& path() const { return path_; }
   std::string key() const { return key_; }
 
+  // The size that stream 1 takes in its file if it is compressed, or 0.
+  int32 compressed_stream_1_size() const { return compressed_stream_1_size_; }
+
  private:
   enum CreateEntryResult {
     CREATE_ENTRY_SUCCESS = 0,
@@ -203,7 +260,9 @@ class SimpleSynchronousEntry {
       net::CacheType cache_type,
       const base::FilePath& path,
       const std::string& key,
-      uint64 entry_hash);
+      uint64 entry_hash,
+      SimpleSlabStore* slab_store,
+      const SimpleSlabAddress& slab_address);
 
   // Like Entry, the SimpleSynchronousEntry self releases when Close() is
   // called.
@@ -222,11 +281,26 @@ class SimpleSynchronousEntry {
                        base::File::Error* out_error);
   bool OpenFiles(bool had_index,
                  SimpleEntryStat* out_entry_stat);
+  // Reads the record of an entry kept in memory into |file_images_|.
+  bool OpenFileImages(bool had_index, SimpleEntryStat* out_entry_stat);
   bool CreateFiles(bool had_index,
                    SimpleEntryStat* out_entry_stat);
   void CloseFile(int index);
   void CloseFiles();
 
+  // Read, write and set the length of one of the entry files, or of its image
+  // in |file_images_| if the entry is kept in memory.
+  int ReadFromFile(int file_index, int64 offset, char* data, int size) const;
+  bool WriteToFile(int file_index, int64 offset, const char* data, int size);
+  bool SetFileLength(int file_index, int64 length);
+
+  // Returns the combined size of the files of an entry kept in memory.
+  int64 GetFileImagesSize() const;
+
+  // Writes the files of an entry kept in memory to disk, and from then on
+  // keeps the entry in its files.
+  bool SpillToFiles();
+
   // Returns a net error, i.e. net::OK on success. |had_index| is passed
   // from the main entry for metrics purposes, and is true if the index was
   // initialized when the open operation began.
@@ -247,12 +321,40 @@ class SimpleSynchronousEntry {
   int InitializeForCreate(bool had_index, SimpleEntryStat* out_entry_stat);
 
   // Allocates and fills a buffer with stream 0 data in |stream_0_data|, then
-  // checks its crc32.
+  // checks its crc32. The EOF record of stream 1, which comes right before
+  // stream 0 in the file, is read into |out_stream_1_eof| along the way.
   int ReadAndValidateStream0(
       int total_data_size,
       SimpleEntryStat* out_entry_stat,
       scoped_refptr<net::GrowableIOBuffer>* stream_0_data,
-      uint32* out_stream_0_crc32) const;
+      uint32* out_stream_0_crc32,
+      SimpleFileEOF* out_stream_1_eof) const;
+
+  // Reads the block table of stream 1 if |stream_1_eof| says that it is
+  // compressed, in which case the size of its data goes to |out_entry_stat|.
+  bool ReadStream1BlockTable(const SimpleFileEOF& stream_1_eof,
+                             SimpleEntryStat* out_entry_stat);
+
+  // Returns |entry_stat| with the size that stream 1 takes in file 0 instead
+  // of the size of its data, which is what the offsets in the file go by.
+  SimpleEntryStat GetFileEntryStat(const SimpleEntryStat& entry_stat) const;
+
+  // Reads up to |size| bytes from |offset| in compressed stream 1, of
+  // |data_size| bytes, into |data|. Only the blocks that the bytes are in are
+  // read and uncompressed. Returns the number of bytes read, or -1.
+  int ReadCompressedStream1(int data_size,
+                            int offset,
+                            char* data,
+                            int size) const;
+
+  // Compresses stream 1, of |data_size| bytes, in place with |codec|, and
+  // drops what follows it in file 0. Leaves the stream as it is and returns
+  // true if its first block does not compress well.
+  bool CompressStream1(SimpleCompressionCodec codec, int data_size);
+
+  // Stores the first |keep_size| bytes of compressed stream 1, of |data_size|
+  // bytes, as they are, and drops what follows them in file 0.
+  bool UncompressStream1(int data_size, int keep_size);
 
   int GetEOFRecordData(int index,
                        const SimpleEntryStat& entry_stat,
@@ -261,6 +363,28 @@ class SimpleSynchronousEntry {
                        int* out_data_size) const;
   void Doom() const;
 
+  // Completions of ReadDataOnRing() and WriteDataOnRing(). |fallback| redoes
+  // the operation with ReadData() or WriteData().
+  static void RingReadComplete(
+      const scoped_refptr<base::TaskRunner>& worker_pool,
+      const base::Closure& fallback,
+      const scoped_refptr<net::IOBuffer>& out_buf,
+      uint32* out_crc32,
+      SimpleEntryStat* entry_stat,
+      int* out_result,
+      const base::Closure& done,
+      int result);
+  static void RingWriteComplete(
+      net::CacheType cache_type,
+      const scoped_refptr<base::TaskRunner>& worker_pool,
+      const base::Closure& fallback,
+      int index,
+      int data_size,
+      SimpleEntryStat* out_entry_stat,
+      int* out_result,
+      const base::Closure& done,
+      int result);
+
   // Opens the sparse data file and scans it if it exists.
   bool OpenSparseFileIfExists(int32* out_sparse_data_size);
 
@@ -333,6 +457,26 @@ class SimpleSynchronousEntry {
   // True if the entry was created, or false if it was opened. Used to log
   // SimpleCache.*.EntryCreatedWithStream2Omitted only for created entries.
   bool files_created_;
+
+  scoped_refptr<SimpleSlabStore> slab_store_;
+
+  // The record that the entry was opened from, if any.
+  const SimpleSlabAddress slab_address_;
+
+  // True if the entry is kept in |file_images_| instead of in |files_|, and
+  // goes to the slab store when closed.
+  bool in_memory_;
+  std::string file_images_[kSimpleEntryFileCount];
+
+  // True if |file_images_| differ from the record at |slab_address_|.
+  bool file_images_changed_;
+
+  // Stream 1 is stored in compressed blocks if it has a codec, which is the
+  // case from when it is compressed on close until it is next written.
+  SimpleCompressionCodec stream_1_codec_;
+  int32 compressed_stream_1_size_;
+  // The offset of the end of each block from the start of stream 1.
+  std::vector<uint32> stream_1_block_ends_;
 };
 
 }  // namespace disk_cache
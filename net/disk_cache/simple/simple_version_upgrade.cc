@@ -170,6 +170,20 @@ bool UpgradeSimpleCacheOnDisk(const base::FilePath& path) {
     }
     version_from++;
   }
+  if (version_from == 6) {
+    // The V7 index also records where entries stored in slab files are. A V6
+    // index fails to load because of its version, and the index is restored
+    // from the entry files, so there is nothing to do on disk. Sparse files
+    // carry the backend version, so entries with sparse data are dropped when
+    // they are next opened.
+    version_from++;
+  }
+  if (version_from == 7) {
+    // V8 entries can have stream 1 compressed, which is flagged in its EOF
+    // record, so V7 entries are still read as they are. As for V7, the index
+    // is restored from the entry files, and sparse data is dropped.
+    version_from++;
+  }
   if (version_from == kSimpleVersion) {
     if (!upgrade_needed) {
       return true;
@@ -0,0 +1,134 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/cache_trace.h"
+
+#include <cstring>
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/sequenced_task_runner.h"
+#include "net/disk_cache/simple/simple_util.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The records are written out in batches of this many.
+const size_t kRecordsPerWrite = 1024;
+
+void WriteTraceHeader(const base::FilePath& path) {
+  CacheTraceHeader header;
+  if (base::WriteFile(path, reinterpret_cast<const char*>(&header),
+                      sizeof(header)) != sizeof(header)) {
+    LOG(WARNING) << "Could not create cache trace " << path.value();
+  }
+}
+
+void AppendTraceRecords(const base::FilePath& path,
+                        const std::vector<CacheTraceRecord>& records) {
+  const int size = records.size() * sizeof(CacheTraceRecord);
+  if (!base::AppendToFile(path, reinterpret_cast<const char*>(&records[0]),
+                          size)) {
+    LOG(WARNING) << "Could not write to cache trace " << path.value();
+  }
+}
+
+}  // namespace
+
+CacheTraceHeader::CacheTraceHeader()
+    : magic_number(kCacheTraceMagicNumber),
+      version(kCacheTraceVersion),
+      record_size(sizeof(CacheTraceRecord)) {
+}
+
+CacheTraceRecord::CacheTraceRecord()
+    : op(0),
+      stream_index(0),
+      truncate(0),
+      unused(0),
+      entry_id(0),
+      time_us(0),
+      key_hash(0),
+      offset(0),
+      size(0),
+      key_length(0) {
+}
+
+CacheTraceWriter::CacheTraceWriter(
+    const base::FilePath& path,
+    const scoped_refptr<base::SequencedTaskRunner>& task_runner)
+    : path_(path),
+      task_runner_(task_runner),
+      start_time_(base::TimeTicks::Now()),
+      next_entry_id_(1) {
+  records_.reserve(kRecordsPerWrite);
+  task_runner_->PostTask(FROM_HERE, base::Bind(&WriteTraceHeader, path_));
+}
+
+CacheTraceWriter::~CacheTraceWriter() {
+  Flush();
+}
+
+// static
+CacheTraceRecord CacheTraceWriter::MakeRecord(CacheTraceOp op,
+                                              uint32 entry_id,
+                                              const std::string& key) {
+  CacheTraceRecord record;
+  record.op = op;
+  record.entry_id = entry_id;
+  record.key_hash = simple_util::GetEntryHashKey(key);
+  record.key_length = key.size();
+  return record;
+}
+
+void CacheTraceWriter::AddRecord(const CacheTraceRecord& record) {
+  DCHECK_LT(record.op, CACHE_TRACE_OP_MAX);
+  records_.push_back(record);
+  records_.back().time_us =
+      (base::TimeTicks::Now() - start_time_).InMicroseconds();
+  if (records_.size() >= kRecordsPerWrite)
+    Flush();
+}
+
+void CacheTraceWriter::Flush() {
+  if (records_.empty())
+    return;
+  task_runner_->PostTask(FROM_HERE,
+                         base::Bind(&AppendTraceRecords, path_, records_));
+  records_.clear();
+}
+
+bool ReadCacheTrace(const base::FilePath& path,
+                    std::vector<CacheTraceRecord>* out_records) {
+  std::string contents;
+  if (!base::ReadFileToString(path, &contents) ||
+      contents.size() < sizeof(CacheTraceHeader)) {
+    return false;
+  }
+  CacheTraceHeader header;
+  memcpy(&header, contents.data(), sizeof(header));
+  if (header.magic_number != kCacheTraceMagicNumber ||
+      header.version != kCacheTraceVersion ||
+      header.record_size != sizeof(CacheTraceRecord)) {
+    return false;
+  }
+  const size_t records_size = contents.size() - sizeof(header);
+  if (records_size % sizeof(CacheTraceRecord))
+    return false;
+  out_records->resize(records_size / sizeof(CacheTraceRecord));
+  if (!out_records->empty()) {
+    memcpy(&(*out_records)[0], contents.data() + sizeof(header),
+           records_size);
+  }
+  for (size_t i = 0; i < out_records->size(); ++i) {
+    if ((*out_records)[i].op >= CACHE_TRACE_OP_MAX)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,125 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
+#define NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class SequencedTaskRunner;
+}
+
+namespace disk_cache {
+
+// A cache trace file consists of:
+//   - a CacheTraceHeader.
+//   - a CacheTraceRecord for each call made to the cache, in the order they
+//     were made.
+// Keys are only kept as their hash and their length, so that a trace does not
+// tell what was browsed, and the data that was read or written only as its
+// size.
+
+const uint64 kCacheTraceMagicNumber = GG_UINT64_C(0x5b1e4a8d3c27f690);
+const uint32 kCacheTraceVersion = 1;
+
+enum CacheTraceOp {
+  CACHE_TRACE_OPEN = 0,
+  CACHE_TRACE_CREATE = 1,
+  // Backend::DoomEntry().
+  CACHE_TRACE_DOOM = 2,
+  CACHE_TRACE_DOOM_ALL = 3,
+  // Entry::Doom().
+  CACHE_TRACE_DOOM_ENTRY = 4,
+  CACHE_TRACE_CLOSE = 5,
+  CACHE_TRACE_READ = 6,
+  CACHE_TRACE_WRITE = 7,
+  CACHE_TRACE_READ_SPARSE = 8,
+  CACHE_TRACE_WRITE_SPARSE = 9,
+  CACHE_TRACE_OP_MAX = 10,
+};
+
+struct NET_EXPORT_PRIVATE CacheTraceHeader {
+  CacheTraceHeader();
+
+  uint64 magic_number;
+  uint32 version;
+  uint32 record_size;
+};
+
+struct NET_EXPORT_PRIVATE CacheTraceRecord {
+  CacheTraceRecord();
+
+  uint8 op;
+  // The stream of a read or a write.
+  uint8 stream_index;
+  // Whether a write truncates the stream.
+  uint8 truncate;
+  uint8 unused;
+  // Tells the entries that are open at once apart; the ops on an entry, and
+  // the open or create that returned it, have the same id.
+  uint32 entry_id;
+  // When the call was made, from the start of the trace.
+  int64 time_us;
+  uint64 key_hash;
+  // The offset and the size of a read or a write.
+  int64 offset;
+  int32 size;
+  uint32 key_length;
+};
+
+// Records the calls made to a cache. The records are buffered, and written to
+// the trace file on a task runner that can do IO.
+class NET_EXPORT_PRIVATE CacheTraceWriter
+    : public base::RefCounted<CacheTraceWriter> {
+ public:
+  // Replaces the file at |path| with an empty trace, on |task_runner|.
+  CacheTraceWriter(const base::FilePath& path,
+                   const scoped_refptr<base::SequencedTaskRunner>& task_runner);
+
+  // Returns an id for an entry that is being opened or created.
+  uint32 GetNewEntryId() { return next_entry_id_++; }
+
+  // Returns a record of |op| on the entry with |key|, to fill in further.
+  static CacheTraceRecord MakeRecord(CacheTraceOp op,
+                                     uint32 entry_id,
+                                     const std::string& key);
+
+  // Adds |record|, stamped with the current time.
+  void AddRecord(const CacheTraceRecord& record);
+
+  // Writes out the records so far.
+  void Flush();
+
+ private:
+  friend class base::RefCounted<CacheTraceWriter>;
+
+  // Flushes the records that are left.
+  ~CacheTraceWriter();
+
+  const base::FilePath path_;
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+  const base::TimeTicks start_time_;
+  uint32 next_entry_id_;
+  std::vector<CacheTraceRecord> records_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheTraceWriter);
+};
+
+// Reads the trace at |path| into |out_records|. Returns false if it is not a
+// trace file that this version can read.
+NET_EXPORT_PRIVATE bool ReadCacheTrace(
+    const base::FilePath& path,
+    std::vector<CacheTraceRecord>* out_records);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TRACING_CACHE_TRACE_H_
@@ -0,0 +1,284 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
+
+#include "base/bind.h"
+#include "base/callback.h"
+#include "net/base/completion_callback.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Records the calls made to an entry, which it forwards to |entry_|.
+class TracingEntry : public Entry {
+ public:
+  TracingEntry(const scoped_refptr<CacheTraceWriter>& writer,
+               uint32 entry_id,
+               Entry* entry)
+      : writer_(writer),
+        entry_(entry),
+        record_(CacheTraceWriter::MakeRecord(CACHE_TRACE_OPEN,
+                                             entry_id,
+                                             entry->GetKey())) {}
+
+  // Records the open that returned the entry, when it is only known once it
+  // is done.
+  void AddOpenRecord() { AddRecord(CACHE_TRACE_OPEN, 0, 0, 0, false); }
+
+  // Entry interface.
+  void Doom() override {
+    AddRecord(CACHE_TRACE_DOOM_ENTRY, 0, 0, 0, false);
+    entry_->Doom();
+  }
+  void Close() override {
+    AddRecord(CACHE_TRACE_CLOSE, 0, 0, 0, false);
+    entry_->Close();
+    delete this;
+  }
+  std::string GetKey() const override { return entry_->GetKey(); }
+  base::Time GetLastUsed() const override { return entry_->GetLastUsed(); }
+  base::Time GetLastModified() const override {
+    return entry_->GetLastModified();
+  }
+  int32 GetDataSize(int index) const override {
+    return entry_->GetDataSize(index);
+  }
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override {
+    AddRecord(CACHE_TRACE_READ, index, offset, buf_len, false);
+    return entry_->ReadData(index, offset, buf, buf_len, callback);
+  }
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override {
+    AddRecord(CACHE_TRACE_WRITE, index, offset, buf_len, truncate);
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+  }
+  int ReadSparseData(int64 offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override {
+    AddRecord(CACHE_TRACE_READ_SPARSE, 0, offset, buf_len, false);
+    return entry_->ReadSparseData(offset, buf, buf_len, callback);
+  }
+  int WriteSparseData(int64 offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override {
+    AddRecord(CACHE_TRACE_WRITE_SPARSE, 0, offset, buf_len, false);
+    return entry_->WriteSparseData(offset, buf, buf_len, callback);
+  }
+  int GetAvailableRange(int64 offset,
+                        int len,
+                        int64* start,
+                        const CompletionCallback& callback) override {
+    return entry_->GetAvailableRange(offset, len, start, callback);
+  }
+  bool CouldBeSparse() const override { return entry_->CouldBeSparse(); }
+  void CancelSparseIO() override { entry_->CancelSparseIO(); }
+  int ReadyForSparseIO(const CompletionCallback& callback) override {
+    return entry_->ReadyForSparseIO(callback);
+  }
+
+ private:
+  ~TracingEntry() override {}
+
+  void AddRecord(CacheTraceOp op,
+                 int stream_index,
+                 int64 offset,
+                 int size,
+                 bool truncate) {
+    CacheTraceRecord record = record_;
+    record.op = op;
+    record.stream_index = stream_index;
+    record.offset = offset;
+    record.size = size;
+    record.truncate = truncate;
+    writer_->AddRecord(record);
+  }
+
+  scoped_refptr<CacheTraceWriter> writer_;
+  Entry* const entry_;
+  // The fields that all the records of the entry share.
+  const CacheTraceRecord record_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracingEntry);
+};
+
+// Opens, creates or iterates to an entry, given where to return it and the
+// callback to run once it is done.
+typedef base::Callback<int(Entry**, const net::CompletionCallback&)> EntryOp;
+
+// An entry being returned by an EntryOp, until it is handed to the caller in a
+// TracingEntry.
+struct PendingEntry {
+  PendingEntry(const scoped_refptr<CacheTraceWriter>& writer,
+               uint32 entry_id,
+               bool add_open_record,
+               Entry** out_entry)
+      : writer(writer),
+        entry_id(entry_id),
+        add_open_record(add_open_record),
+        out_entry(out_entry),
+        entry(NULL) {}
+
+  scoped_refptr<CacheTraceWriter> writer;
+  uint32 entry_id;
+  bool add_open_record;
+  Entry** out_entry;
+  Entry* entry;
+};
+
+int OnEntryOpComplete(PendingEntry* pending, int result) {
+  if (result != net::OK)
+    return result;
+  TracingEntry* tracing_entry =
+      new TracingEntry(pending->writer, pending->entry_id, pending->entry);
+  if (pending->add_open_record)
+    tracing_entry->AddOpenRecord();
+  *pending->out_entry = tracing_entry;
+  return result;
+}
+
+void RunEntryOpCallback(scoped_ptr<PendingEntry> pending,
+                        const net::CompletionCallback& callback,
+                        int result) {
+  callback.Run(OnEntryOpComplete(pending.get(), result));
+}
+
+int RunEntryOp(const EntryOp& entry_op,
+               const scoped_refptr<CacheTraceWriter>& writer,
+               uint32 entry_id,
+               bool add_open_record,
+               Entry** entry,
+               const net::CompletionCallback& callback) {
+  scoped_ptr<PendingEntry> pending(
+      new PendingEntry(writer, entry_id, add_open_record, entry));
+  PendingEntry* pending_ptr = pending.get();
+  // Owns |pending| until the op is done.
+  const net::CompletionCallback op_callback =
+      base::Bind(&RunEntryOpCallback, base::Passed(&pending), callback);
+  const int rv = entry_op.Run(&pending_ptr->entry, op_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return OnEntryOpComplete(pending_ptr, rv);
+}
+
+// Records an open of each entry that it returns.
+class TracingIterator : public Backend::Iterator {
+ public:
+  TracingIterator(const scoped_refptr<CacheTraceWriter>& writer,
+                  scoped_ptr<Backend::Iterator> iterator)
+      : writer_(writer), iterator_(iterator.Pass()) {}
+  ~TracingIterator() override {}
+
+  int OpenNextEntry(Entry** next_entry,
+                    const net::CompletionCallback& callback) override {
+    return RunEntryOp(base::Bind(&Backend::Iterator::OpenNextEntry,
+                                 base::Unretained(iterator_.get())),
+                      writer_, writer_->GetNewEntryId(), true, next_entry,
+                      callback);
+  }
+
+ private:
+  scoped_refptr<CacheTraceWriter> writer_;
+  scoped_ptr<Backend::Iterator> iterator_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracingIterator);
+};
+
+}  // namespace
+
+TracingCacheBackend::TracingCacheBackend(
+    scoped_ptr<Backend> backend,
+    const scoped_refptr<CacheTraceWriter>& writer)
+    : backend_(backend.Pass()), writer_(writer) {
+}
+
+TracingCacheBackend::~TracingCacheBackend() {
+  writer_->Flush();
+}
+
+net::CacheType TracingCacheBackend::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32 TracingCacheBackend::GetEntryCount() const {
+  return backend_->GetEntryCount();
+}
+
+int TracingCacheBackend::OpenEntry(const std::string& key,
+                                   Entry** entry,
+                                   const CompletionCallback& callback) {
+  const uint32 entry_id = writer_->GetNewEntryId();
+  writer_->AddRecord(
+      CacheTraceWriter::MakeRecord(CACHE_TRACE_OPEN, entry_id, key));
+  return RunEntryOp(
+      base::Bind(&Backend::OpenEntry, base::Unretained(backend_.get()), key),
+      writer_, entry_id, false, entry, callback);
+}
+
+int TracingCacheBackend::CreateEntry(const std::string& key,
+                                     Entry** entry,
+                                     const CompletionCallback& callback) {
+  const uint32 entry_id = writer_->GetNewEntryId();
+  writer_->AddRecord(
+      CacheTraceWriter::MakeRecord(CACHE_TRACE_CREATE, entry_id, key));
+  return RunEntryOp(
+      base::Bind(&Backend::CreateEntry, base::Unretained(backend_.get()), key),
+      writer_, entry_id, false, entry, callback);
+}
+
+int TracingCacheBackend::DoomEntry(const std::string& key,
+                                   const CompletionCallback& callback) {
+  writer_->AddRecord(CacheTraceWriter::MakeRecord(CACHE_TRACE_DOOM, 0, key));
+  return backend_->DoomEntry(key, callback);
+}
+
+int TracingCacheBackend::DoomAllEntries(const CompletionCallback& callback) {
+  writer_->AddRecord(
+      CacheTraceWriter::MakeRecord(CACHE_TRACE_DOOM_ALL, 0, std::string()));
+  return backend_->DoomAllEntries(callback);
+}
+
+// The entries that a time range dooms are not known, so they are left out of
+// the trace.
+int TracingCacheBackend::DoomEntriesBetween(
+    base::Time initial_time,
+    base::Time end_time,
+    const CompletionCallback& callback) {
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int TracingCacheBackend::DoomEntriesSince(base::Time initial_time,
+                                          const CompletionCallback& callback) {
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+scoped_ptr<Backend::Iterator> TracingCacheBackend::CreateIterator() {
+  return scoped_ptr<Backend::Iterator>(
+      new TracingIterator(writer_, backend_->CreateIterator()));
+}
+
+void TracingCacheBackend::GetStats(
+    std::vector<std::pair<std::string, std::string>>* stats) {
+  backend_->GetStats(stats);
+}
+
+void TracingCacheBackend::OnExternalCacheHit(const std::string& key) {
+  backend_->OnExternalCacheHit(key);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,61 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TRACING_TRACING_CACHE_BACKEND_H_
+#define NET_DISK_CACHE_TRACING_TRACING_CACHE_BACKEND_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+class CacheTraceWriter;
+
+// A Backend that records the calls made to another one, and to its entries,
+// to a cache trace, which disk_cache_trace_replay plays back against each of
+// the backends.
+class NET_EXPORT_PRIVATE TracingCacheBackend : public Backend {
+ public:
+  TracingCacheBackend(scoped_ptr<Backend> backend,
+                      const scoped_refptr<CacheTraceWriter>& writer);
+  ~TracingCacheBackend() override;
+
+  // Backend interface.
+  net::CacheType GetCacheType() const override;
+  int32 GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  scoped_ptr<Iterator> CreateIterator() override;
+  void GetStats(
+      std::vector<std::pair<std::string, std::string>>* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+
+ private:
+  scoped_ptr<Backend> backend_;
+  scoped_refptr<CacheTraceWriter> writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracingCacheBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TRACING_TRACING_CACHE_BACKEND_H_
@@ -0,0 +1,186 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tracing/tracing_cache_backend.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_util.h"
+#include "base/run_loop.h"
+#include "base/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+class TracingCacheBackendTest : public DiskCacheTest {
+ protected:
+  TracingCacheBackendTest()
+      : trace_path_(cache_path_.AppendASCII("trace")),
+        writer_(new CacheTraceWriter(trace_path_,
+                                     base::ThreadTaskRunnerHandle::Get())) {}
+
+  void InitMemoryCache() {
+    backend_.reset(new TracingCacheBackend(
+        MemBackendImpl::CreateBackend(0, NULL), writer_));
+  }
+
+  void InitSimpleCache() {
+    scoped_ptr<Backend> simple_backend;
+    net::TestCompletionCallback cb;
+    int rv = CreateCacheBackend(
+        net::DISK_CACHE, net::CACHE_BACKEND_SIMPLE,
+        cache_path_.AppendASCII("cache"), 0, false,
+        base::ThreadTaskRunnerHandle::Get(), NULL, &simple_backend,
+        cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    backend_.reset(new TracingCacheBackend(simple_backend.Pass(), writer_));
+  }
+
+  // Destroys the backend, and reads the records it wrote.
+  void ReadTrace(std::vector<CacheTraceRecord>* records) {
+    backend_.reset();
+    writer_ = NULL;
+    SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::RunLoop().RunUntilIdle();
+    ASSERT_TRUE(ReadCacheTrace(trace_path_, records));
+  }
+
+  void RecordsCalls();
+
+  const base::FilePath trace_path_;
+  scoped_refptr<CacheTraceWriter> writer_;
+  scoped_ptr<Backend> backend_;
+};
+
+void ExpectRecord(const CacheTraceRecord& record,
+                  CacheTraceOp op,
+                  uint32 entry_id,
+                  const std::string& key) {
+  EXPECT_EQ(op, record.op);
+  EXPECT_EQ(entry_id, record.entry_id);
+  EXPECT_EQ(simple_util::GetEntryHashKey(key), record.key_hash);
+  EXPECT_EQ(key.size(), record.key_length);
+}
+
+void TracingCacheBackendTest::RecordsCalls() {
+  const int kSize = 100;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  net::TestCompletionCallback cb;
+
+  Entry* entry = NULL;
+  int rv = backend_->CreateEntry("key1", &entry, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_TRUE(entry);
+  EXPECT_EQ("key1", entry->GetKey());
+  rv = entry->WriteData(1, 0, buffer.get(), kSize, cb.callback(), true);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  rv = entry->ReadData(1, 10, buffer.get(), 50, cb.callback());
+  EXPECT_EQ(50, cb.GetResult(rv));
+  entry->Close();
+
+  rv = backend_->OpenEntry("key1", &entry, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  entry->Doom();
+  entry->Close();
+
+  rv = backend_->OpenEntry("missing key", &entry, cb.callback());
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+  rv = backend_->DoomEntry("key2", cb.callback());
+  cb.GetResult(rv);
+
+  std::vector<CacheTraceRecord> records;
+  ReadTrace(&records);
+  ASSERT_EQ(9u, records.size());
+  ExpectRecord(records[0], CACHE_TRACE_CREATE, 1, "key1");
+  ExpectRecord(records[1], CACHE_TRACE_WRITE, 1, "key1");
+  EXPECT_EQ(1, records[1].stream_index);
+  EXPECT_EQ(0, records[1].offset);
+  EXPECT_EQ(kSize, records[1].size);
+  EXPECT_EQ(1, records[1].truncate);
+  ExpectRecord(records[2], CACHE_TRACE_READ, 1, "key1");
+  EXPECT_EQ(10, records[2].offset);
+  EXPECT_EQ(50, records[2].size);
+  ExpectRecord(records[3], CACHE_TRACE_CLOSE, 1, "key1");
+  ExpectRecord(records[4], CACHE_TRACE_OPEN, 2, "key1");
+  ExpectRecord(records[5], CACHE_TRACE_DOOM_ENTRY, 2, "key1");
+  ExpectRecord(records[6], CACHE_TRACE_CLOSE, 2, "key1");
+  ExpectRecord(records[7], CACHE_TRACE_OPEN, 3, "missing key");
+  ExpectRecord(records[8], CACHE_TRACE_DOOM, 0, "key2");
+  for (size_t i = 1; i < records.size(); ++i)
+    EXPECT_LE(records[i - 1].time_us, records[i].time_us);
+}
+
+}  // namespace
+
+TEST_F(TracingCacheBackendTest, MemoryCache) {
+  InitMemoryCache();
+  RecordsCalls();
+}
+
+TEST_F(TracingCacheBackendTest, SimpleCache) {
+  InitSimpleCache();
+  RecordsCalls();
+}
+
+// The entries that an iterator returns are recorded as opened.
+TEST_F(TracingCacheBackendTest, Iterator) {
+  InitMemoryCache();
+  net::TestCompletionCallback cb;
+  Entry* entry = NULL;
+  int rv = backend_->CreateEntry("key", &entry, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  entry->Close();
+
+  scoped_ptr<Backend::Iterator> iterator = backend_->CreateIterator();
+  rv = iterator->OpenNextEntry(&entry, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ("key", entry->GetKey());
+  entry->Close();
+  rv = iterator->OpenNextEntry(&entry, cb.callback());
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+  iterator.reset();
+
+  std::vector<CacheTraceRecord> records;
+  ReadTrace(&records);
+  ASSERT_EQ(4u, records.size());
+  ExpectRecord(records[0], CACHE_TRACE_CREATE, 1, "key");
+  ExpectRecord(records[1], CACHE_TRACE_CLOSE, 1, "key");
+  ExpectRecord(records[2], CACHE_TRACE_OPEN, 2, "key");
+  ExpectRecord(records[3], CACHE_TRACE_CLOSE, 2, "key");
+}
+
+TEST_F(TracingCacheBackendTest, ReadBadTrace) {
+  writer_ = NULL;
+  base::RunLoop().RunUntilIdle();
+  std::vector<CacheTraceRecord> records;
+  EXPECT_TRUE(ReadCacheTrace(trace_path_, &records));
+  EXPECT_TRUE(records.empty());
+
+  // A record that was cut short.
+  ASSERT_TRUE(base::AppendToFile(trace_path_, "abc", 3));
+  EXPECT_FALSE(ReadCacheTrace(trace_path_, &records));
+
+  const char kGarbage[] = "not a cache trace, but long enough to be one";
+  ASSERT_EQ(static_cast<int>(sizeof(kGarbage)),
+            base::WriteFile(trace_path_, kGarbage, sizeof(kGarbage)));
+  EXPECT_FALSE(ReadCacheTrace(trace_path_, &records));
+  EXPECT_FALSE(
+      ReadCacheTrace(cache_path_.AppendASCII("missing trace"), &records));
+}
+
+}  // namespace disk_cache
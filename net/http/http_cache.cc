@@ -102,7 +102,8 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      shared_writing(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -455,6 +456,7 @@ HttpCache::HttpCache(const net::HttpNetworkSession::Params& params,
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
       use_stale_while_revalidate_(params.use_stale_while_revalidate),
+      use_shared_writing_(params.use_http_cache_shared_writing),
       mode_(NORMAL),
       network_layer_(new HttpNetworkLayer(new HttpNetworkSession(params))),
       clock_(new base::DefaultClock()),
@@ -473,6 +475,7 @@ HttpCache::HttpCache(HttpNetworkSession* session,
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
       use_stale_while_revalidate_(session->params().use_stale_while_revalidate),
+      use_shared_writing_(session->params().use_http_cache_shared_writing),
       mode_(NORMAL),
       network_layer_(new HttpNetworkLayer(session)),
       clock_(new base::DefaultClock()),
@@ -488,14 +491,17 @@ HttpCache::HttpCache(HttpTransactionFactory* network_layer,
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
       use_stale_while_revalidate_(false),
+      use_shared_writing_(false),
       mode_(NORMAL),
       network_layer_(network_layer),
       clock_(new base::DefaultClock()),
       weak_factory_(this) {
   SetupQuicServerInfoFactory(network_layer_->GetSession());
   HttpNetworkSession* session = network_layer_->GetSession();
-  if (session)
+  if (session) {
     use_stale_while_revalidate_ = session->params().use_stale_while_revalidate;
+    use_shared_writing_ = session->params().use_http_cache_shared_writing;
+  }
 }
 
 HttpCache::~HttpCache() {
@@ -512,6 +518,7 @@ HttpCache::~HttpCache() {
     entry->will_process_pending_queue = false;
     entry->pending_queue.clear();
     entry->readers.clear();
+    entry->tailing_readers.clear();
     entry->writer = NULL;
     DeactivateEntry(entry);
   }
@@ -971,6 +978,18 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
+  //
+  // The readers of an entry whose writer shares it are the exception: they
+  // read the body while it is written.
+
+  if (entry->writer && entry->shared_writing &&
+      !entry->will_process_pending_queue && trans->CanReadSharedEntry()) {
+    entry->readers.push_back(trans);
+    entry->tailing_readers.push_back(trans);
+    if (!entry->pending_queue.empty())
+      ProcessPendingQueue(entry);
+    return OK;
+  }
 
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
@@ -1003,16 +1022,18 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
                               bool cancel) {
   // If we already posted a task to move on to the next transaction and this was
   // the writer, there is nothing to cancel.
-  if (entry->will_process_pending_queue && entry->readers.empty())
+  if (entry->will_process_pending_queue && entry->readers.empty() &&
+      entry->writer != trans) {
     return;
+  }
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
-
+  if (entry->writer == trans) {
     // Assume there was a failure.
     bool success = false;
     if (cancel) {
       DCHECK(entry->disk_entry);
+      // Even if the entry is kept, the body is not all there.
+      StopSharedWriting(entry, false);
       // This is a successful operation in the sense that we want to keep the
       // entry.
       success = trans->AddTruncatedFlag();
@@ -1027,21 +1048,25 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 }
 
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
-  DCHECK(entry->readers.empty());
+  DCHECK(entry->writer);
 
+  StopSharedWriting(entry, success);
   entry->writer = NULL;
 
   if (success) {
     ProcessPendingQueue(entry);
   } else {
-    DCHECK(!entry->will_process_pending_queue);
-
     // We failed to create this entry.
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty() && !entry->will_process_pending_queue) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // The entry was shared; it goes away once its readers are done with it.
+      DoomEntry(entry->disk_entry->GetKey(), NULL);
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -1054,13 +1079,14 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  DCHECK(entry->writer != trans);
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
   DCHECK(it != entry->readers.end());
 
   entry->readers.erase(it);
+  entry->tailing_readers.remove(trans);
 
   ProcessPendingQueue(entry);
 }
@@ -1078,6 +1104,37 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::StartSharedWriting(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(entry->readers.empty());
+
+  entry->shared_writing = true;
+  if (!entry->pending_queue.empty())
+    ProcessPendingQueue(entry);
+}
+
+void HttpCache::OnSharedWriterData(ActiveEntry* entry) {
+  // Copy the list, for a transaction may leave the entry when told.
+  TransactionList tailing_readers(entry->tailing_readers);
+  for (TransactionList::iterator it = tailing_readers.begin();
+       it != tailing_readers.end(); ++it) {
+    (*it)->OnSharedWriterData();
+  }
+}
+
+void HttpCache::StopSharedWriting(ActiveEntry* entry, bool complete) {
+  if (!entry->shared_writing)
+    return;
+
+  entry->shared_writing = false;
+  TransactionList tailing_readers;
+  tailing_readers.swap(entry->tailing_readers);
+  for (TransactionList::iterator it = tailing_readers.begin();
+       it != tailing_readers.end(); ++it) {
+    (*it)->OnSharedWriterDone(complete);
+  }
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -1218,15 +1275,33 @@ void HttpCache::DeleteAsyncValidation(const std::string& url) {
 
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
-  DCHECK(!entry->writer);
 
   // If no one is interested in this entry, then we can deactivate it.
   if (entry->pending_queue.empty()) {
-    if (entry->readers.empty())
+    if (!entry->writer && entry->readers.empty())
       DestroyEntry(entry);
     return;
   }
 
+  if (entry->writer) {
+    // Only the transactions that can read the body while it is written may
+    // join; the others keep waiting for the writer.
+    if (!entry->shared_writing)
+      return;
+    for (TransactionList::iterator it = entry->pending_queue.begin();
+         it != entry->pending_queue.end(); ++it) {
+      Transaction* next = *it;
+      if (!next->CanReadSharedEntry())
+        continue;
+      entry->pending_queue.erase(it);
+      int rv = AddTransactionToEntry(entry, next);
+      DCHECK_EQ(OK, rv);
+      next->io_callback().Run(rv);
+      return;
+    }
+    return;
+  }
+
   // Promote next transaction from the pending queue.
   Transaction* next = entry->pending_queue.front();
   if ((next->mode() & Transaction::WRITE) && !entry->readers.empty())
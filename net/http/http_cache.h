@@ -221,6 +221,13 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     use_stale_while_revalidate_ = use_stale_while_revalidate;
   }
 
+  bool use_shared_writing() const { return use_shared_writing_; }
+
+  // Enables shared writing of entries for testing purposes.
+  void set_use_shared_writing_for_testing(bool use_shared_writing) {
+    use_shared_writing_ = use_shared_writing;
+  }
+
   // HttpTransactionFactory implementation:
   int CreateTransaction(RequestPriority priority,
                         scoped_ptr<HttpTransaction>* trans) override;
@@ -273,6 +280,12 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+    // Whether |writer| lets readers read the body while it writes it. See
+    // StartSharedWriting().
+    bool               shared_writing;
+    // The readers that joined while |writer| shares the entry, and that are
+    // told when it writes more of the body or stops writing it.
+    TransactionList    tailing_readers;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
@@ -375,6 +388,22 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once it has written the headers of a
+  // response that others can use as is. From then on, the pending
+  // transactions that can read the entry without validating it join as
+  // readers right away, and read the body as the writer appends to it,
+  // instead of waiting for the whole of it. This way, concurrent requests
+  // for a resource that is not cached yet cost a single network fetch.
+  void StartSharedWriting(ActiveEntry* entry);
+
+  // Called by the writer of |entry| after it appends to the body.
+  void OnSharedWriterData(ActiveEntry* entry);
+
+  // Ends the shared writing of |entry|, if any. |complete| tells whether the
+  // writer wrote the whole body; otherwise its tailing readers fail once they
+  // have read what it wrote.
+  void StopSharedWriting(ActiveEntry* entry, bool complete);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -441,6 +470,10 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // directive is enabled (either via command-line flag or experiment).
   bool use_stale_while_revalidate_;
 
+  // true if readers may read the body of an entry while it is written. See
+  // StartSharedWriting().
+  bool use_shared_writing_;
+
   Mode mode_;
 
   scoped_ptr<QuicServerInfoFactoryAdaptor> quic_server_info_factory_;
@@ -330,6 +330,10 @@ HttpCache::Transaction::Transaction(RequestPriority priority, HttpCache* cache)
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
+      tailing_writer_(false),
+      waiting_for_writer_(false),
+      shared_writer_failed_(false),
+      shared_entry_rejected_(false),
       io_buf_len_(0),
       read_offset_(0),
       effective_load_flags_(0),
@@ -414,6 +418,29 @@ LoadState HttpCache::Transaction::GetWriterLoadState() const {
   return LOAD_STATE_WAITING_FOR_CACHE;
 }
 
+bool HttpCache::Transaction::CanReadSharedEntry() const {
+  // Readers of a shared entry cannot write to it, nor send a request of their
+  // own.
+  return (mode_ == READ || mode_ == READ_WRITE) && !shared_entry_rejected_ &&
+         !partial_.get() && request_->method == "GET" &&
+         !(effective_load_flags_ & (LOAD_VALIDATE_CACHE | LOAD_PREFETCH));
+}
+
+void HttpCache::Transaction::OnSharedWriterData() {
+  if (!waiting_for_writer_)
+    return;
+  waiting_for_writer_ = false;
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&Transaction::OnIOComplete, weak_factory_.GetWeakPtr(), OK));
+}
+
+void HttpCache::Transaction::OnSharedWriterDone(bool complete) {
+  tailing_writer_ = false;
+  shared_writer_failed_ = !complete;
+  OnSharedWriterData();
+}
+
 const BoundNetLog& HttpCache::Transaction::net_log() const {
   return net_log_;
 }
@@ -597,6 +624,8 @@ void HttpCache::Transaction::StopCaching() {
   //                Fix this.
   if (cache_.get() && entry_ && (mode_ & WRITE) && network_trans_.get() &&
       !is_sparse_ && !range_requested_) {
+    // Our readers won't get the rest of the body.
+    cache_->StopSharedWriting(entry_, false);
     mode_ = NONE;
   }
 }
@@ -643,6 +672,11 @@ const HttpResponseInfo* HttpCache::Transaction::GetResponseInfo() const {
 }
 
 LoadState HttpCache::Transaction::GetLoadState() const {
+  // While we read a shared entry faster than it is written, we wait on the
+  // network just like the writer.
+  if (waiting_for_writer_ && entry_->writer)
+    return entry_->writer->GetWriterLoadState();
+
   LoadState state = GetWriterLoadState();
   if (state != LOAD_STATE_WAITING_FOR_CACHE)
     return state;
@@ -1563,8 +1597,11 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   DCHECK(new_entry_);
   cache_pending_ = false;
 
-  if (result == OK)
+  if (result == OK) {
     entry_ = new_entry_;
+    // We may have joined an entry whose writer shares it.
+    tailing_writer_ = entry_->writer && entry_->writer != this;
+  }
 
   // If there is a failure, the cache should have taken care of new_entry_.
   new_entry_ = NULL;
@@ -1829,6 +1866,15 @@ int HttpCache::Transaction::DoTruncateCachedMetadataComplete(int result) {
     }
   }
 
+  // A full response that is stored as it is can be read by other transactions
+  // while we write its body.
+  if (entry_ && mode_ == WRITE && cache_->use_shared_writing() &&
+      !partial_.get() && !handling_206_ && request_->method == "GET" &&
+      response_.headers->response_code() == 200 &&
+      !response_.unused_since_prefetch) {
+    cache_->StartSharedWriting(entry_);
+  }
+
   next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
   return OK;
 }
@@ -2116,6 +2162,16 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
 
   if (result > 0) {
     read_offset_ += result;
+  } else if (result == 0 && tailing_writer_) {
+    // We read all of the body written so far. The writer may have appended to
+    // it since the read started; otherwise, it tells us when it does.
+    next_state_ = STATE_CACHE_READ_DATA;
+    if (entry_->disk_entry->GetDataSize(kResponseContentIndex) > read_offset_)
+      return OK;
+    waiting_for_writer_ = true;
+    return ERR_IO_PENDING;
+  } else if (result == 0 && shared_writer_failed_) {
+    return ERR_CACHE_READ_FAILURE;
   } else if (result == 0) {  // End of file.
     RecordHistograms();
     cache_->DoneReadingFromEntry(entry_, this);
@@ -2172,6 +2228,13 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
       done_reading_ = true;
   }
 
+  if (entry_ && entry_->shared_writing) {
+    if (done_reading_)
+      cache_->StopSharedWriting(entry_, true);
+    else if (result > 0)
+      cache_->OnSharedWriterData(entry_);
+  }
+
   if (partial_.get()) {
     // This may be the last request.
     if (!(result == 0 && !truncated_ &&
@@ -2464,6 +2527,18 @@ int HttpCache::Transaction::BeginCacheValidation() {
 int HttpCache::Transaction::BeginPartialCacheValidation() {
   DCHECK(mode_ == READ_WRITE);
 
+  if (entry_->writer != this) {
+    // We joined the entry while its writer shares it, so we can only use the
+    // response as it is.
+    if (response_.headers->response_code() != 200 || truncated_ ||
+        RequiresValidation() != VALIDATION_NONE) {
+      return LeaveSharedEntry();
+    }
+    UpdateTransactionPattern(PATTERN_ENTRY_USED);
+    RecordOfflineStatus(effective_load_flags_, OFFLINE_STATUS_FRESH_CACHE);
+    return SetupEntryForRead();
+  }
+
   if (response_.headers->response_code() != 206 && !partial_.get() &&
       !truncated_) {
     return BeginCacheValidation();
@@ -2909,7 +2984,9 @@ int HttpCache::Transaction::SetupEntryForRead() {
       partial_.reset();
     }
   }
-  cache_->ConvertWriterToReader(entry_);
+  // Readers of a shared entry already are readers.
+  if (entry_->writer == this)
+    cache_->ConvertWriterToReader(entry_);
   mode_ = READ;
 
   if (request_->method == "HEAD")
@@ -2921,6 +2998,15 @@ int HttpCache::Transaction::SetupEntryForRead() {
 }
 
 
+int HttpCache::Transaction::LeaveSharedEntry() {
+  tailing_writer_ = false;
+  shared_entry_rejected_ = true;
+  cache_->DoneReadingFromEntry(entry_, this);
+  entry_ = NULL;
+  next_state_ = STATE_INIT_ENTRY;
+  return OK;
+}
+
 int HttpCache::Transaction::ReadFromNetwork(IOBuffer* data, int data_len) {
   read_buf_ = data;
   io_buf_len_ = data_len;
@@ -100,6 +100,18 @@ class HttpCache::Transaction : public HttpTransaction {
   // to the cache entry.
   LoadState GetWriterLoadState() const;
 
+  // Returns true if this transaction can join an entry that its writer shares,
+  // reading the body as it is written. See HttpCache::StartSharedWriting().
+  bool CanReadSharedEntry() const;
+
+  // Called when the writer of the shared entry that this transaction reads has
+  // appended to the body.
+  void OnSharedWriterData();
+
+  // Called when the writer of the shared entry that this transaction reads has
+  // stopped writing it. |complete| is false if the body is not all there.
+  void OnSharedWriterDone(bool complete);
+
   const CompletionCallback& io_callback() { return io_callback_; }
 
   const BoundNetLog& net_log() const;
@@ -348,6 +360,10 @@ class HttpCache::Transaction : public HttpTransaction {
   // Setups the transaction for reading from the cache entry.
   int SetupEntryForRead();
 
+  // Leaves the shared entry that this transaction cannot use as it is, to wait
+  // for its writer like any other transaction. Returns a network error code.
+  int LeaveSharedEntry();
+
   // Reads data from the network.
   int ReadFromNetwork(IOBuffer* data, int data_len);
 
@@ -448,6 +464,10 @@ class HttpCache::Transaction : public HttpTransaction {
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
   bool fail_conditionalization_for_test_;  // Fail ConditionalizeRequest.
+  bool tailing_writer_;  // The writer of the entry may append to the body.
+  bool waiting_for_writer_;  // We read all of the body written so far.
+  bool shared_writer_failed_;  // The writer didn't write the whole body.
+  bool shared_entry_rejected_;  // We can't use the entry while it is written.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
@@ -14,6 +14,7 @@
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/test/simple_test_clock.h"
+#include "base/timer/elapsed_timer.h"
 #include "net/base/cache_type.h"
 #include "net/base/elements_upload_data_stream.h"
 #include "net/base/host_port_pair.h"
@@ -1761,6 +1762,197 @@ TEST(HttpCache, SimpleGET_WriterTimeout) {
   ReadAndVerifyTransaction(c1.trans.get(), kSimpleGET_Transaction);
 }
 
+// Tests that the transactions that would wait for the writer of an entry read
+// the body as it is written instead, when the cache shares writing.
+TEST(HttpCache, SimpleGET_SharedWriting) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_shared_writing_for_testing(true);
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  ScopedVector<Context> context_list;
+  const int kNumTransactions = 5;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.CreateTransaction(&c->trans);
+    ASSERT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  // Allow all requests to move from the Create queue to the active entry.
+  base::MessageLoop::current()->RunUntilIdle();
+
+  // The first request is the writer, and the others joined it as readers as
+  // soon as it wrote the headers.
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    ASSERT_TRUE(c->callback.have_result());
+    EXPECT_EQ(net::OK, c->callback.WaitForResult());
+  }
+
+  // The readers wait for the writer to read some of the body.
+  const std::string expected(kSimpleGET_Transaction.data);
+  const int kFirstChunkSize = 10;
+  std::vector<scoped_refptr<net::IOBuffer> > buffers;
+  for (int i = 1; i < kNumTransactions; ++i) {
+    buffers.push_back(new net::IOBuffer(256));
+    Context* c = context_list[i];
+    c->result = c->trans->Read(buffers.back().get(), 256,
+                               c->callback.callback());
+    EXPECT_EQ(net::ERR_IO_PENDING, c->result);
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+  for (int i = 1; i < kNumTransactions; ++i)
+    EXPECT_FALSE(context_list[i]->callback.have_result());
+
+  Context* writer = context_list[0];
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kFirstChunkSize));
+  writer->result = writer->trans->Read(buf.get(), kFirstChunkSize,
+                                       writer->callback.callback());
+  EXPECT_EQ(kFirstChunkSize, writer->callback.GetResult(writer->result));
+  std::string writer_content(buf->data(), kFirstChunkSize);
+
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    EXPECT_EQ(kFirstChunkSize, c->callback.WaitForResult());
+    EXPECT_EQ(expected.substr(0, kFirstChunkSize),
+              std::string(buffers[i - 1]->data(), kFirstChunkSize));
+  }
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer->trans.get(), &content));
+  EXPECT_EQ(expected, writer_content + content);
+  for (int i = 1; i < kNumTransactions; ++i) {
+    EXPECT_EQ(net::OK,
+              ReadTransaction(context_list[i]->trans.get(), &content));
+    EXPECT_EQ(expected.substr(kFirstChunkSize), content);
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that the readers of a shared entry fail once they read what the writer
+// wrote if the writer goes away before it writes the whole body.
+TEST(HttpCache, SimpleGET_SharedWriting_CancelWriter) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_shared_writing_for_testing(true);
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+  Context writer, reader;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&reader.trans));
+  reader.result = reader.trans->Start(&request, reader.callback.callback(),
+                                      net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+  EXPECT_EQ(net::OK, reader.callback.GetResult(reader.result));
+
+  const int kChunkSize = 10;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kChunkSize));
+  writer.result =
+      writer.trans->Read(buf.get(), kChunkSize, writer.callback.callback());
+  EXPECT_EQ(kChunkSize, writer.callback.GetResult(writer.result));
+  writer.trans.reset();
+
+  scoped_refptr<net::IOBuffer> reader_buf(new net::IOBuffer(256));
+  reader.result =
+      reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(kChunkSize, reader.callback.GetResult(reader.result));
+  reader.result =
+      reader.trans->Read(reader_buf.get(), 256, reader.callback.callback());
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE,
+            reader.callback.GetResult(reader.result));
+  reader.trans.reset();
+
+  // The entry was not kept.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Tests that a transaction that cannot use the response being written as it
+// is waits for the writer to finish, as if the entry was not shared.
+TEST(HttpCache, SimpleGET_SharedWriting_VaryMismatch) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_shared_writing_for_testing(true);
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.request_headers = "Foo: bar\r\n";
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Vary: Foo\n";
+  MockHttpRequest request(transaction);
+  transaction.request_headers = "Foo: none\r\n";
+  MockHttpRequest mismatch_request(transaction);
+
+  Context writer, waiter;
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&writer.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  ASSERT_EQ(net::OK, cache.CreateTransaction(&waiter.trans));
+  waiter.result = waiter.trans->Start(
+      &mismatch_request, waiter.callback.callback(), net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_FALSE(waiter.callback.have_result());
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  ReadAndVerifyTransaction(writer.trans.get(), transaction);
+  EXPECT_EQ(net::OK, waiter.callback.GetResult(waiter.result));
+  ReadAndVerifyTransaction(waiter.trans.get(), transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Measures how long concurrent requests for a large resource take, with and
+// without shared writing, and records it in the test results. All of them
+// cost a single network request either way.
+TEST(HttpCache, SimpleGET_SharedWriting_Benchmark) {
+  const int kNumTransactions = 10;
+  const std::string body(256 * 1024, 'a');
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.data = body.c_str();
+  MockHttpRequest request(transaction);
+
+  for (int shared = 0; shared < 2; ++shared) {
+    MockHttpCache cache;
+    cache.http_cache()->set_use_shared_writing_for_testing(shared != 0);
+
+    ScopedVector<TestTransactionConsumer> consumers;
+    base::ElapsedTimer timer;
+    for (int i = 0; i < kNumTransactions; ++i) {
+      consumers.push_back(new TestTransactionConsumer(net::DEFAULT_PRIORITY,
+                                                      cache.http_cache()));
+      consumers.back()->Start(&request, net::BoundNetLog());
+    }
+    base::MessageLoop::current()->Run();
+    testing::Test::RecordProperty(
+        shared ? "SharedWritingMicroseconds" : "ExclusiveWritingMicroseconds",
+        static_cast<int>(timer.Elapsed().InMicroseconds()));
+
+    for (int i = 0; i < kNumTransactions; ++i) {
+      EXPECT_TRUE(consumers[i]->is_done());
+      EXPECT_EQ(net::OK, consumers[i]->error());
+      EXPECT_EQ(body, consumers[i]->content());
+    }
+    EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  }
+}
+
 TEST(HttpCache, SimpleGET_AbandonedCacheRead) {
   MockHttpCache cache;
 
@@ -67,6 +67,7 @@ HttpNetworkSession::Params::Params()
       host_mapping_rules(NULL),
       ignore_certificate_errors(false),
       use_stale_while_revalidate(false),
+      use_http_cache_shared_writing(false),
       testing_fixed_http_port(0),
       testing_fixed_https_port(0),
       enable_tcp_fast_open_for_ssl(false),
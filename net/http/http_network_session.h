@@ -80,6 +80,7 @@ class NET_EXPORT HttpNetworkSession
     HostMappingRules* host_mapping_rules;
     bool ignore_certificate_errors;
     bool use_stale_while_revalidate;
+    bool use_http_cache_shared_writing;
     uint16 testing_fixed_http_port;
     uint16 testing_fixed_https_port;
     bool enable_tcp_fast_open_for_ssl;
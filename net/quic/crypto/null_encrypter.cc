@@ -29,8 +29,9 @@ bool NullEncrypter::Encrypt(
   string buffer = associated_data.as_string();
   plaintext.AppendToString(&buffer);
   uint128 hash = QuicUtils::FNV1a_128_Hash(buffer.data(), buffer.length());
+  // |output| may hold |plaintext|, so move it before writing the hash.
+  memmove(output + GetHashLength(), plaintext.data(), plaintext.size());
   QuicUtils::SerializeUint128Short(hash, output);
-  memcpy(output + GetHashLength(), plaintext.data(), plaintext.size());
   return true;
 }
 
@@ -53,6 +53,7 @@ class NET_EXPORT_PRIVATE QuicEncrypter {
   // |plaintext| as well as a MAC over both |plaintext| and |associated_data|,
   // or nullptr if there is an error. |sequence_number| is appended to the
   // |nonce_prefix| value provided in SetNoncePrefix() to form the nonce.
+  // |output| may point to |plaintext|, to encrypt it in place.
   virtual bool EncryptPacket(QuicPacketSequenceNumber sequence_number,
                              base::StringPiece associated_data,
                              base::StringPiece plaintext,
@@ -71,6 +71,17 @@ bool Near(QuicPacketSequenceNumber a, QuicPacketSequenceNumber b) {
   return delta <= kMaxPacketGap;
 }
 
+// Returns the number of bytes of stream data in |frames|.
+QuicByteCount StreamBytesInFrames(const RetransmittableFrames& frames) {
+  QuicByteCount bytes = 0;
+  for (const QuicFrame& frame : frames.frames()) {
+    if (frame.type == STREAM_FRAME) {
+      bytes += frame.stream_frame->data.TotalBufferSize();
+    }
+  }
+  return bytes;
+}
+
 // An alarm that is scheduled to send an ack if a timeout occurs.
 class AckAlarm : public QuicAlarm::Delegate {
  public:
@@ -1106,6 +1117,7 @@ void QuicConnection::SendVersionNegotiationPacket() {
 QuicConsumedData QuicConnection::SendStreamData(
     QuicStreamId id,
     const IOVector& data,
+    base::RefCountedMemory* data_buffer,
     QuicStreamOffset offset,
     bool fin,
     FecProtection fec_protection,
@@ -1129,8 +1141,18 @@ QuicConsumedData QuicConnection::SendStreamData(
   // also if there is possibility of revival. Only bundle an ack if there's no
   // processing left that may cause received_info_ to change.
   ScopedPacketBundler ack_bundler(this, BUNDLE_PENDING_ACK);
-  return packet_generator_.ConsumeData(id, data, offset, fin, fec_protection,
-                                       delegate);
+  QuicConsumedData consumed = packet_generator_.ConsumeData(
+      id, data, data_buffer, offset, fin, fec_protection, delegate);
+  stats_.stream_bytes_sent += consumed.bytes_consumed;
+  if (data_buffer == nullptr) {
+    // The retransmittable frames made a copy of the data.
+    stats_.stream_bytes_copied += consumed.bytes_consumed;
+  }
+  return consumed;
+}
+
+void QuicConnection::OnStreamDataCopied(QuicByteCount bytes) {
+  stats_.stream_bytes_copied += bytes;
 }
 
 void QuicConnection::SendRstStream(QuicStreamId id,
@@ -1383,6 +1405,8 @@ void QuicConnection::WritePendingRetransmissions() {
 
     DVLOG(1) << ENDPOINT << "Retransmitting " << pending.sequence_number
              << " as " << serialized_packet.sequence_number;
+    stats_.stream_bytes_copied +=
+        StreamBytesInFrames(pending.retransmittable_frames);
     SendOrQueuePacket(
         QueuedPacket(serialized_packet,
                      pending.retransmittable_frames.encryption_level(),
@@ -1631,6 +1655,8 @@ void QuicConnection::OnSerializedPacket(
     return;
   }
   if (serialized_packet.retransmittable_frames) {
+    stats_.stream_bytes_copied +=
+        StreamBytesInFrames(*serialized_packet.retransmittable_frames);
     sent_packet_manager_.OnSerializedPacket(serialized_packet);
   }
   if (serialized_packet.is_fec_packet && fec_alarm_->IsSet()) {
@@ -285,16 +285,22 @@ class NET_EXPORT_PRIVATE QuicConnection
   // data is to be FEC protected. Note that data that is sent immediately
   // following MUST_FEC_PROTECT data may get protected by falling within the
   // same FEC group.
+  // If |data_buffer| is provided, it holds |data|, and the packets share it
+  // until they are acked instead of copying |data|.
   // If |delegate| is provided, then it will be informed once ACKs have been
   // received for all the packets written in this call.
   // The |delegate| is not owned by the QuicConnection and must outlive it.
   QuicConsumedData SendStreamData(QuicStreamId id,
                                   const IOVector& data,
+                                  base::RefCountedMemory* data_buffer,
                                   QuicStreamOffset offset,
                                   bool fin,
                                   FecProtection fec_protection,
                                   QuicAckNotifier::DelegateInterface* delegate);
 
+  // Called when a stream copies |bytes| of stream data into a send buffer.
+  void OnStreamDataCopied(QuicByteCount bytes);
+
   // Send a RST_STREAM frame to the peer.
   virtual void SendRstStream(QuicStreamId id,
                              QuicRstStreamErrorCode error,
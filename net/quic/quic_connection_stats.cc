@@ -12,6 +12,7 @@ QuicConnectionStats::QuicConnectionStats()
     : bytes_sent(0),
       packets_sent(0),
       stream_bytes_sent(0),
+      stream_bytes_copied(0),
       packets_discarded(0),
       bytes_received(0),
       packets_received(0),
@@ -26,6 +26,10 @@ struct NET_EXPORT_PRIVATE QuicConnectionStats {
   QuicPacketCount packets_sent;
   // Non-retransmitted bytes sent in a stream frame.
   QuicByteCount stream_bytes_sent;
+  // Bytes of stream data copied on their way to the socket: into send
+  // buffers, and into packets, including retransmissions. Data that the
+  // stream frames share with the application is only copied into packets.
+  QuicByteCount stream_bytes_copied;
   // Packets serialized and discarded before sending.
   QuicPacketCount packets_discarded;
 
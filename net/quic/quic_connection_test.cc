@@ -82,7 +82,7 @@ class TaggingEncrypter : public QuicEncrypter {
                StringPiece associated_data,
                StringPiece plaintext,
                unsigned char* output) override {
-    memcpy(output, plaintext.data(), plaintext.size());
+    memmove(output, plaintext.data(), plaintext.size());
     output += plaintext.size();
     memset(output, tag_, kTagSize);
     return true;
@@ -470,10 +470,23 @@ class TestConnection : public QuicConnection {
     if (!data.empty()) {
       data_iov.Append(const_cast<char*>(data.data()), data.size());
     }
-    return QuicConnection::SendStreamData(id, data_iov, offset, fin,
+    return QuicConnection::SendStreamData(id, data_iov, nullptr, offset, fin,
                                           fec_protection, delegate);
   }
 
+  // Sends all of |buffer|, which the stream frames share instead of copying.
+  QuicConsumedData SendStreamDataWithBuffer(QuicStreamId id,
+                                            base::RefCountedMemory* buffer,
+                                            QuicStreamOffset offset,
+                                            bool fin) {
+    IOVector data_iov;
+    data_iov.Append(reinterpret_cast<char*>(const_cast<unsigned char*>(
+                        buffer->front())),
+                    buffer->size());
+    return QuicConnection::SendStreamData(id, data_iov, buffer, offset, fin,
+                                          MAY_FEC_PROTECT, nullptr);
+  }
+
   QuicConsumedData SendStreamData3() {
     return SendStreamDataWithString(kClientDataStreamId1, "food", 0, !kFin,
                                     nullptr);
@@ -2098,7 +2111,8 @@ TEST_P(QuicConnectionTest, FramePackingSendv) {
   IOVector data_iov;
   data_iov.AppendNoCoalesce(data, 2);
   data_iov.AppendNoCoalesce(data + 2, 2);
-  connection_.SendStreamData(1, data_iov, 0, !kFin, MAY_FEC_PROTECT, nullptr);
+  connection_.SendStreamData(1, data_iov, nullptr, 0, !kFin, MAY_FEC_PROTECT,
+                             nullptr);
 
   EXPECT_EQ(0u, connection_.NumQueuedPackets());
   EXPECT_FALSE(connection_.HasQueuedData());
@@ -2123,7 +2137,8 @@ TEST_P(QuicConnectionTest, FramePackingSendvQueued) {
   IOVector data_iov;
   data_iov.AppendNoCoalesce(data, 2);
   data_iov.AppendNoCoalesce(data + 2, 2);
-  connection_.SendStreamData(1, data_iov, 0, !kFin, MAY_FEC_PROTECT, nullptr);
+  connection_.SendStreamData(1, data_iov, nullptr, 0, !kFin, MAY_FEC_PROTECT,
+                             nullptr);
 
   EXPECT_EQ(1u, connection_.NumQueuedPackets());
   EXPECT_TRUE(connection_.HasQueuedData());
@@ -2143,7 +2158,8 @@ TEST_P(QuicConnectionTest, SendingZeroBytes) {
   // Send a zero byte write with a fin using writev.
   EXPECT_CALL(*send_algorithm_, OnPacketSent(_, _, _, _, _));
   IOVector empty_iov;
-  connection_.SendStreamData(1, empty_iov, 0, kFin, MAY_FEC_PROTECT, nullptr);
+  connection_.SendStreamData(1, empty_iov, nullptr, 0, kFin, MAY_FEC_PROTECT,
+                             nullptr);
 
   EXPECT_EQ(0u, connection_.NumQueuedPackets());
   EXPECT_FALSE(connection_.HasQueuedData());
@@ -3954,6 +3970,32 @@ TEST_P(QuicConnectionTest, CheckSendStats) {
   EXPECT_EQ(kDefaultMaxPacketSize, stats.max_packet_size);
 }
 
+TEST_P(QuicConnectionTest, CheckStreamBytesCopied) {
+  const QuicConnectionStats& stats = connection_.GetStats();
+
+  // Data in a shared buffer is only copied into the packet.
+  scoped_refptr<base::RefCountedString> buffer(new base::RefCountedString);
+  buffer->data() = "foo";
+  EXPECT_CALL(*send_algorithm_, OnPacketSent(_, _, 1u, _, _));
+  connection_.SendStreamDataWithBuffer(3, buffer.get(), 0, !kFin);
+  EXPECT_EQ(3u, stats.stream_bytes_sent);
+  EXPECT_EQ(3u, stats.stream_bytes_copied);
+  EXPECT_FALSE(buffer->HasOneRef());
+
+  // A retransmission copies it into a new packet.
+  clock_.AdvanceTime(DefaultRetransmissionTime());
+  EXPECT_CALL(*send_algorithm_, OnPacketSent(_, _, 2u, _, _));
+  connection_.GetRetransmissionAlarm()->Fire();
+  EXPECT_EQ(3u, stats.stream_bytes_sent);
+  EXPECT_EQ(6u, stats.stream_bytes_copied);
+
+  // Other data is also copied for retransmission.
+  EXPECT_CALL(*send_algorithm_, OnPacketSent(_, _, 3u, _, _));
+  connection_.SendStreamDataWithString(3, "bar", 3, !kFin, nullptr);
+  EXPECT_EQ(6u, stats.stream_bytes_sent);
+  EXPECT_EQ(12u, stats.stream_bytes_copied);
+}
+
 TEST_P(QuicConnectionTest, CheckReceiveStats) {
   EXPECT_CALL(visitor_, OnSuccessfulVersionNegotiation(_));
 
@@ -1642,6 +1642,27 @@ QuicEncryptedPacket* QuicFramer::EncryptPacket(
                                  true);
 }
 
+size_t QuicFramer::EncryptInPlace(EncryptionLevel level,
+                                  QuicPacketSequenceNumber sequence_number,
+                                  const QuicPacket& packet,
+                                  char* buffer,
+                                  size_t buffer_len) {
+  DCHECK(encrypter_[level].get() != nullptr);
+  DCHECK_EQ(buffer, packet.data());
+
+  // The header stays where it is, and the plaintext after it is replaced by
+  // the ciphertext.
+  const size_t header_len = packet.BeforePlaintext().length();
+  size_t output_length = 0;
+  if (!encrypter_[level]->EncryptPacket(
+          sequence_number, packet.AssociatedData(), packet.Plaintext(),
+          buffer + header_len, &output_length, buffer_len - header_len)) {
+    RaiseError(QUIC_ENCRYPTION_FAILURE);
+    return 0;
+  }
+  return header_len + output_length;
+}
+
 size_t QuicFramer::GetMaxPlaintextSize(size_t ciphertext_size) {
   // In order to keep the code simple, we don't have the current encryption
   // level to hand. Both the NullEncrypter and AES-GCM have a tag length of 12.
@@ -353,6 +353,15 @@ class NET_EXPORT_PRIVATE QuicFramer {
                                      QuicPacketSequenceNumber sequence_number,
                                      const QuicPacket& packet);
 
+  // Encrypts |packet|, which was built at the start of |buffer|, in place.
+  // |buffer| must be |buffer_len| bytes long. Returns the length of the
+  // encrypted packet, or 0 if there is an error.
+  size_t EncryptInPlace(EncryptionLevel level,
+                        QuicPacketSequenceNumber sequence_number,
+                        const QuicPacket& packet,
+                        char* buffer,
+                        size_t buffer_len);
+
   // Returns the maximum length of plaintext that can be encrypted
   // to ciphertext no larger than |ciphertext_size|.
   size_t GetMaxPlaintextSize(size_t ciphertext_size);
@@ -122,7 +122,7 @@ class TestEncrypter : public QuicEncrypter {
     sequence_number_ = sequence_number;
     associated_data_ = associated_data.as_string();
     plaintext_ = plaintext.as_string();
-    memcpy(output, plaintext.data(), plaintext.length());
+    memmove(output, plaintext.data(), plaintext.length());
     *output_length = plaintext.length();
     return true;
   }
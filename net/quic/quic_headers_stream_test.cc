@@ -153,7 +153,8 @@ class QuicHeadersStreamTest : public ::testing::TestWithParam<TestParams> {
                                 QuicPriority priority,
                                 SpdyFrameType type) {
     // Write the headers and capture the outgoing data
-    EXPECT_CALL(session_, WritevData(kHeadersStreamId, _, _, false, _, nullptr))
+    EXPECT_CALL(session_,
+                WritevData(kHeadersStreamId, _, _, _, false, _, nullptr))
         .WillOnce(WithArgs<1>(Invoke(this, &QuicHeadersStreamTest::SaveIov)));
     headers_stream_->WriteHeaders(stream_id, headers_, fin, priority, nullptr);
 
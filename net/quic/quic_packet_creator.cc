@@ -382,19 +382,14 @@ SerializedPacket QuicPacketCreator::SerializePacket() {
   bool possibly_truncated_by_length = packet_size_ == max_plaintext_size_ &&
       queued_frames_.size() == 1 &&
       queued_frames_.back().type == ACK_FRAME;
-  char buffer[kMaxPacketSize];
-  scoped_ptr<QuicPacket> packet;
+  // The packet is built and then encrypted in place in a buffer large enough
+  // for the ciphertext, which the encrypted packet takes over.
+  const size_t buffer_len = static_cast<size_t>(max_packet_length_);
+  scoped_ptr<char[]> buffer(new char[buffer_len]);
   // Use the packet_size_ instead of the buffer size to ensure smaller
   // packet sizes are properly used.
-  scoped_ptr<char[]> large_buffer;
-  if (packet_size_ <= kMaxPacketSize) {
-    packet.reset(
-        framer_->BuildDataPacket(header, queued_frames_, buffer, packet_size_));
-  } else {
-    large_buffer.reset(new char[packet_size_]);
-    packet.reset(framer_->BuildDataPacket(header, queued_frames_,
-                                          large_buffer.get(), packet_size_));
-  }
+  scoped_ptr<QuicPacket> packet(framer_->BuildDataPacket(
+      header, queued_frames_, buffer.get(), packet_size_));
   LOG_IF(DFATAL, packet == nullptr) << "Failed to serialize "
                                     << queued_frames_.size() << " frames.";
   // Because of possible truncation, we can't be confident that our
@@ -404,12 +399,14 @@ SerializedPacket QuicPacketCreator::SerializePacket() {
   }
   // Immediately encrypt the packet, to ensure we don't encrypt the same packet
   // sequence number multiple times.
-  QuicEncryptedPacket* encrypted =
-      framer_->EncryptPacket(encryption_level_, sequence_number_, *packet);
-  if (encrypted == nullptr) {
+  const size_t encrypted_length = framer_->EncryptInPlace(
+      encryption_level_, sequence_number_, *packet, buffer.get(), buffer_len);
+  if (encrypted_length == 0) {
     LOG(DFATAL) << "Failed to encrypt packet number " << sequence_number_;
     return NoPacket();
   }
+  QuicEncryptedPacket* encrypted =
+      new QuicEncryptedPacket(buffer.release(), encrypted_length, true);
 
   packet_size_ = 0;
   queued_frames_.clear();
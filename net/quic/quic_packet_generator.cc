@@ -126,6 +126,7 @@ void QuicPacketGenerator::AddControlFrame(const QuicFrame& frame) {
 QuicConsumedData QuicPacketGenerator::ConsumeData(
     QuicStreamId id,
     const IOVector& data_to_write,
+    base::RefCountedMemory* data_buffer,
     QuicStreamOffset offset,
     bool fin,
     FecProtection fec_protection,
@@ -169,6 +170,7 @@ QuicConsumedData QuicPacketGenerator::ConsumeData(
     QuicFrame frame;
     size_t bytes_consumed = packet_creator_.CreateStreamFrame(
         id, data, offset + total_bytes_consumed, fin, &frame);
+    frame.stream_frame->data_buffer = data_buffer;
     ++frames_created;
 
     // We want to track which packet this stream frame ends up in.
@@ -119,10 +119,13 @@ class NET_EXPORT_PRIVATE QuicPacketGenerator {
   // Given some data, may consume part or all of it and pass it to the
   // packet creator to be serialized into packets. If not in batch
   // mode, these packets will also be sent during this call.
+  // If |data_buffer| is not nullptr, it holds |data|, and the stream frames
+  // share it until they are acked. Otherwise they copy |data|.
   // |delegate| (if not nullptr) will be informed once all packets sent as a
   // result of this call are ACKed by the peer.
   QuicConsumedData ConsumeData(QuicStreamId id,
                                const IOVector& data,
+                               base::RefCountedMemory* data_buffer,
                                QuicStreamOffset offset,
                                bool fin,
                                FecProtection fec_protection,
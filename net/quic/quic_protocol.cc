@@ -108,7 +108,8 @@ QuicStreamFrame::QuicStreamFrame(const QuicStreamFrame& frame)
     : stream_id(frame.stream_id),
       fin(frame.fin),
       offset(frame.offset),
-      data(frame.data) {
+      data(frame.data),
+      data_buffer(frame.data_buffer) {
 }
 
 QuicStreamFrame::QuicStreamFrame(QuicStreamId stream_id,
@@ -604,12 +605,14 @@ RetransmittableFrames::~RetransmittableFrames() {
 
 const QuicFrame& RetransmittableFrames::AddStreamFrame(
     QuicStreamFrame* stream_frame) {
-  // Make an owned copy of the stream frame's data.
-  stream_data_.push_back(stream_frame->GetDataAsString());
-  // Ensure the stream frame's IOVector points to the owned copy of the data.
-  stream_frame->data.Clear();
-  stream_frame->data.Append(const_cast<char*>(stream_data_.back()->data()),
-                            stream_data_.back()->size());
+  if (stream_frame->data_buffer.get() == nullptr) {
+    // Make an owned copy of the stream frame's data.
+    stream_data_.push_back(stream_frame->GetDataAsString());
+    // Ensure the stream frame's IOVector points to the owned copy of the data.
+    stream_frame->data.Clear();
+    stream_frame->data.Append(const_cast<char*>(stream_data_.back()->data()),
+                              stream_data_.back()->size());
+  }
   frames_.push_back(QuicFrame(stream_frame));
   if (stream_frame->stream_id == kCryptoStreamId) {
     has_crypto_handshake_ = IS_HANDSHAKE;
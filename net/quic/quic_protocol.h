@@ -18,6 +18,8 @@
 #include "base/basictypes.h"
 #include "base/containers/hash_tables.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string_piece.h"
 #include "net/base/int128.h"
 #include "net/base/ip_endpoint.h"
@@ -675,6 +677,9 @@ struct NET_EXPORT_PRIVATE QuicStreamFrame {
   bool fin;
   QuicStreamOffset offset;  // Location of this data in the stream.
   IOVector data;
+  // If not null, the buffer that holds |data|. The frame keeps it alive
+  // instead of making a copy of |data| for retransmissions.
+  scoped_refptr<base::RefCountedMemory> data_buffer;
 };
 
 // TODO(ianswett): Re-evaluate the trade-offs of hash_set vs set when framing
@@ -978,8 +983,8 @@ class NET_EXPORT_PRIVATE RetransmittableFrames {
   explicit RetransmittableFrames(EncryptionLevel level);
   ~RetransmittableFrames();
 
-  // Allocates a local copy of the referenced StringPiece has QuicStreamFrame
-  // use it.
+  // Unless |stream_frame| holds a reference to the buffer of its data,
+  // allocates a local copy of the data and has |stream_frame| use it.
   // Takes ownership of |stream_frame|.
   const QuicFrame& AddStreamFrame(QuicStreamFrame* stream_frame);
   // Takes ownership of the frame inside |frame|.
@@ -165,6 +165,39 @@ TEST(QuicProtocolTest, QuicVersionToString) {
   }
 }
 
+TEST(QuicProtocolTest, RetransmittableFramesCopyStreamData) {
+  std::string data("foo");
+  IOVector iov;
+  iov.Append(const_cast<char*>(data.data()), data.size());
+  RetransmittableFrames frames(ENCRYPTION_NONE);
+  QuicStreamFrame* frame = new QuicStreamFrame(1, false, 0, iov);
+  frames.AddStreamFrame(frame);
+
+  // The frame points to a copy of the data, which the frames own.
+  ASSERT_EQ(1u, frame->data.Size());
+  EXPECT_NE(data.data(), frame->data.iovec()[0].iov_base);
+  EXPECT_EQ(0, memcmp("foo", frame->data.iovec()[0].iov_base, 3));
+}
+
+TEST(QuicProtocolTest, RetransmittableFramesShareStreamDataBuffer) {
+  scoped_refptr<base::RefCountedString> buffer(new base::RefCountedString);
+  buffer->data() = "foo";
+  IOVector iov;
+  iov.Append(const_cast<char*>(buffer->data().data()), buffer->size());
+  {
+    RetransmittableFrames frames(ENCRYPTION_NONE);
+    QuicStreamFrame* frame = new QuicStreamFrame(1, false, 0, iov);
+    frame->data_buffer = buffer;
+    frames.AddStreamFrame(frame);
+
+    // The frame still points into the buffer, and keeps it alive.
+    ASSERT_EQ(1u, frame->data.Size());
+    EXPECT_EQ(buffer->front(), frame->data.iovec()[0].iov_base);
+    EXPECT_FALSE(buffer->HasOneRef());
+  }
+  EXPECT_TRUE(buffer->HasOneRef());
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace net
@@ -353,12 +353,13 @@ bool QuicSession::HasOpenDataStreams() const {
 QuicConsumedData QuicSession::WritevData(
     QuicStreamId id,
     const IOVector& data,
+    base::RefCountedMemory* data_buffer,
     QuicStreamOffset offset,
     bool fin,
     FecProtection fec_protection,
     QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
-  return connection_->SendStreamData(id, data, offset, fin, fec_protection,
-                                     ack_notifier_delegate);
+  return connection_->SendStreamData(id, data, data_buffer, offset, fin,
+                                     fec_protection, ack_notifier_delegate);
 }
 
 size_t QuicSession::WriteHeaders(
@@ -97,11 +97,14 @@ class NET_EXPORT_PRIVATE QuicSession : public QuicConnectionVisitorInterface {
   // data is to be FEC protected. Note that data that is sent immediately
   // following MUST_FEC_PROTECT data may get protected by falling within the
   // same FEC group.
+  // If provided, |data_buffer| holds |data|, and is shared by the packets
+  // until they are acked instead of a copy of |data|.
   // If provided, |ack_notifier_delegate| will be registered to be notified when
   // we have seen ACKs for all packets resulting from this call.
   virtual QuicConsumedData WritevData(
       QuicStreamId id,
       const IOVector& data,
+      base::RefCountedMemory* data_buffer,
       QuicStreamOffset offset,
       bool fin,
       FecProtection fec_protection,
@@ -151,6 +151,7 @@ class TestSession : public QuicSession {
   QuicConsumedData WritevData(
       QuicStreamId id,
       const IOVector& data,
+      base::RefCountedMemory* data_buffer,
       QuicStreamOffset offset,
       bool fin,
       FecProtection fec_protection,
@@ -159,8 +160,8 @@ class TestSession : public QuicSession {
     if (writev_consumes_all_data_) {
       return QuicConsumedData(data.TotalBufferSize(), fin);
     } else {
-      return QuicSession::WritevData(id, data, offset, fin, fec_protection,
-                                     ack_notifier_delegate);
+      return QuicSession::WritevData(id, data, data_buffer, offset, fin,
+                                     fec_protection, ack_notifier_delegate);
     }
   }
 
@@ -169,8 +170,8 @@ class TestSession : public QuicSession {
   }
 
   QuicConsumedData SendStreamData(QuicStreamId id) {
-    return WritevData(id, MakeIOVector("not empty"), 0, true, MAY_FEC_PROTECT,
-                      nullptr);
+    return WritevData(id, MakeIOVector("not empty"), nullptr, 0, true,
+                      MAY_FEC_PROTECT, nullptr);
   }
 
   using QuicSession::PostProcessAfterData;
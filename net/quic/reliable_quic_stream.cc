@@ -21,9 +21,11 @@ namespace net {
 
 namespace {
 
-struct iovec MakeIovec(StringPiece data) {
-  struct iovec iov = {const_cast<char*>(data.data()),
-                      static_cast<size_t>(data.size())};
+// Returns an iovec for the bytes of |data| from |offset| on.
+struct iovec MakeIovec(base::RefCountedMemory* data, size_t offset) {
+  DCHECK_LE(offset, data->size());
+  struct iovec iov = {const_cast<unsigned char*>(data->front() + offset),
+                      data->size() - offset};
   return iov;
 }
 
@@ -103,8 +105,10 @@ class ReliableQuicStream::ProxyAckNotifierDelegate
 };
 
 ReliableQuicStream::PendingData::PendingData(
-    string data_in, scoped_refptr<ProxyAckNotifierDelegate> delegate_in)
-    : data(data_in), delegate(delegate_in) {
+    base::RefCountedMemory* data_in,
+    size_t offset_in,
+    scoped_refptr<ProxyAckNotifierDelegate> delegate_in)
+    : data(data_in), offset(offset_in), delegate(delegate_in) {
 }
 
 ReliableQuicStream::PendingData::~PendingData() {
@@ -237,7 +241,21 @@ void ReliableQuicStream::WriteOrBufferData(
     StringPiece data,
     bool fin,
     QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
-  if (data.empty() && !fin) {
+  // Copy the data once, into a buffer that the stream frames share until
+  // they are acked.
+  string data_copy;
+  data.CopyToString(&data_copy);
+  scoped_refptr<base::RefCountedString> buffer(
+      base::RefCountedString::TakeString(&data_copy));
+  session()->connection()->OnStreamDataCopied(buffer->size());
+  WriteOrBufferSharedData(buffer.get(), fin, ack_notifier_delegate);
+}
+
+void ReliableQuicStream::WriteOrBufferSharedData(
+    base::RefCountedMemory* data,
+    bool fin,
+    QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
+  if (data->size() == 0 && !fin) {
     LOG(DFATAL) << "data.empty() && !fin";
     return;
   }
@@ -256,17 +274,18 @@ void ReliableQuicStream::WriteOrBufferData(
   fin_buffered_ = fin;
 
   if (queued_data_.empty()) {
-    struct iovec iov(MakeIovec(data));
-    consumed_data = WritevData(&iov, 1, fin, proxy_delegate.get());
-    DCHECK_LE(consumed_data.bytes_consumed, data.length());
+    struct iovec iov(MakeIovec(data, 0));
+    consumed_data =
+        WritevDataInternal(&iov, 1, data, fin, proxy_delegate.get());
+    DCHECK_LE(consumed_data.bytes_consumed, data->size());
   }
 
   bool write_completed;
   // If there's unconsumed data or an unconsumed fin, queue it.
-  if (consumed_data.bytes_consumed < data.length() ||
+  if (consumed_data.bytes_consumed < data->size() ||
       (fin && !consumed_data.fin_consumed)) {
-    StringPiece remainder(data.substr(consumed_data.bytes_consumed));
-    queued_data_.push_back(PendingData(remainder.as_string(), proxy_delegate));
+    queued_data_.push_back(
+        PendingData(data, consumed_data.bytes_consumed, proxy_delegate));
     write_completed = false;
   } else {
     write_completed = true;
@@ -286,9 +305,10 @@ void ReliableQuicStream::OnCanWrite() {
     if (queued_data_.size() == 1 && fin_buffered_) {
       fin = true;
     }
-    struct iovec iov(MakeIovec(pending_data->data));
-    QuicConsumedData consumed_data = WritevData(&iov, 1, fin, delegate);
-    if (consumed_data.bytes_consumed == pending_data->data.size() &&
+    struct iovec iov(MakeIovec(pending_data->data.get(), pending_data->offset));
+    QuicConsumedData consumed_data = WritevDataInternal(
+        &iov, 1, pending_data->data.get(), fin, delegate);
+    if (consumed_data.bytes_consumed == iov.iov_len &&
         fin == consumed_data.fin_consumed) {
       queued_data_.pop_front();
       if (delegate != nullptr) {
@@ -296,7 +316,7 @@ void ReliableQuicStream::OnCanWrite() {
       }
     } else {
       if (consumed_data.bytes_consumed > 0) {
-        pending_data->data.erase(0, consumed_data.bytes_consumed);
+        pending_data->offset += consumed_data.bytes_consumed;
         if (delegate != nullptr) {
           delegate->WroteData(false);
         }
@@ -326,6 +346,16 @@ QuicConsumedData ReliableQuicStream::WritevData(
     int iov_count,
     bool fin,
     QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
+  return WritevDataInternal(iov, iov_count, nullptr, fin,
+                            ack_notifier_delegate);
+}
+
+QuicConsumedData ReliableQuicStream::WritevDataInternal(
+    const struct iovec* iov,
+    int iov_count,
+    base::RefCountedMemory* data_buffer,
+    bool fin,
+    QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
   if (write_side_closed_) {
     DLOG(ERROR) << ENDPOINT << "Attempt to write when the write side is closed";
     return QuicConsumedData(0, false);
@@ -363,7 +393,7 @@ QuicConsumedData ReliableQuicStream::WritevData(
   data.AppendIovecAtMostBytes(iov, iov_count, write_length);
 
   QuicConsumedData consumed_data = session()->WritevData(
-      id(), data, stream_bytes_written_, fin, GetFecProtection(),
+      id(), data, data_buffer, stream_bytes_written_, fin, GetFecProtection(),
       ack_notifier_delegate);
   stream_bytes_written_ += consumed_data.bytes_consumed;
 
@@ -14,6 +14,7 @@
 
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/strings/string_piece.h"
 #include "net/base/iovec.h"
 #include "net/base/net_export.h"
@@ -134,6 +135,14 @@ class NET_EXPORT_PRIVATE ReliableQuicStream {
       bool fin,
       QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
 
+  // Like WriteOrBufferData(), but does not copy |data|: the queued data and
+  // the stream frames that carry it keep a reference to |data| until they
+  // are acked.
+  void WriteOrBufferSharedData(
+      base::RefCountedMemory* data,
+      bool fin,
+      QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
+
   // Sends as many bytes in the first |count| buffers of |iov| to the connection
   // as the connection will consume.
   // If |ack_notifier_delegate| is provided, then it will be notified once all
@@ -172,16 +181,28 @@ class NET_EXPORT_PRIVATE ReliableQuicStream {
   class ProxyAckNotifierDelegate;
 
   struct PendingData {
-    PendingData(std::string data_in,
+    PendingData(base::RefCountedMemory* data_in,
+                size_t offset_in,
                 scoped_refptr<ProxyAckNotifierDelegate> delegate_in);
     ~PendingData();
 
-    std::string data;
+    scoped_refptr<base::RefCountedMemory> data;
+    // The number of bytes of |data| that were already sent.
+    size_t offset;
     // Delegate that should be notified when the pending data is acked.
     // Can be nullptr.
     scoped_refptr<ProxyAckNotifierDelegate> delegate;
   };
 
+  // Implements WritevData(). If |data_buffer| is not nullptr, it holds the
+  // data of |iov|, which the stream frames then share instead of copying it.
+  QuicConsumedData WritevDataInternal(
+      const struct iovec* iov,
+      int iov_count,
+      base::RefCountedMemory* data_buffer,
+      bool fin,
+      QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
+
   // Calls MaybeSendBlocked on our flow controller, and connection level flow
   // controller. If we are flow control blocked, marks this stream as write
   // blocked.
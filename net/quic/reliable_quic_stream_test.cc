@@ -23,6 +23,7 @@ using base::StringPiece;
 using std::min;
 using std::string;
 using testing::CreateFunctor;
+using testing::DoAll;
 using testing::InSequence;
 using testing::Invoke;
 using testing::Return;
@@ -60,6 +61,7 @@ class TestStream : public ReliableQuicStream {
   }
 
   using ReliableQuicStream::WriteOrBufferData;
+  using ReliableQuicStream::WriteOrBufferSharedData;
   using ReliableQuicStream::CloseReadSide;
   using ReliableQuicStream::CloseWriteSide;
   using ReliableQuicStream::OnClose;
@@ -151,8 +153,8 @@ TEST_F(ReliableQuicStreamTest, WriteAllData) {
       PACKET_6BYTE_SEQUENCE_NUMBER, 0u, NOT_IN_FEC_GROUP);
   QuicConnectionPeer::GetPacketCreator(connection_)->SetMaxPacketLength(length);
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _)).WillOnce(
-      Return(QuicConsumedData(kDataLen, true)));
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(Return(QuicConsumedData(kDataLen, true)));
   stream_->WriteOrBufferData(kData1, false, nullptr);
   EXPECT_FALSE(HasWriteBlockedStreams());
 }
@@ -171,7 +173,7 @@ TEST_F(ReliableQuicStreamTest, BlockIfOnlySomeDataConsumed) {
 
   // Write some data and no fin.  If we consume some but not all of the data,
   // we should be write blocked a not all the data was consumed.
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(1, false)));
   stream_->WriteOrBufferData(StringPiece(kData1, 2), false, nullptr);
   ASSERT_EQ(1u, write_blocked_list_->NumBlockedStreams());
@@ -184,7 +186,7 @@ TEST_F(ReliableQuicStreamTest, BlockIfFinNotConsumedWithData) {
   // we should be write blocked because the fin was not consumed.
   // (This should never actually happen as the fin should be sent out with the
   // last data)
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(2, false)));
   stream_->WriteOrBufferData(StringPiece(kData1, 2), true, nullptr);
   ASSERT_EQ(1u, write_blocked_list_->NumBlockedStreams());
@@ -195,7 +197,7 @@ TEST_F(ReliableQuicStreamTest, BlockIfSoloFinNotConsumed) {
 
   // Write no data and a fin.  If we consume nothing we should be write blocked,
   // as the fin was not consumed.
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(0, false)));
   stream_->WriteOrBufferData(StringPiece(), true, nullptr);
   ASSERT_EQ(1u, write_blocked_list_->NumBlockedStreams());
@@ -210,7 +212,7 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferData) {
       PACKET_6BYTE_SEQUENCE_NUMBER, 0u, NOT_IN_FEC_GROUP);
   QuicConnectionPeer::GetPacketCreator(connection_)->SetMaxPacketLength(length);
 
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _)).WillOnce(
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _, _)).WillOnce(
       Return(QuicConsumedData(kDataLen - 1, false)));
   stream_->WriteOrBufferData(kData1, false, nullptr);
   EXPECT_TRUE(HasWriteBlockedStreams());
@@ -220,18 +222,54 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferData) {
 
   // Make sure we get the tail of the first write followed by the bytes_consumed
   InSequence s;
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _, _)).
       WillOnce(Return(QuicConsumedData(1, false)));
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _, _)).
       WillOnce(Return(QuicConsumedData(kDataLen - 2, false)));
   stream_->OnCanWrite();
 
   // And finally the end of the bytes_consumed.
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, _, _)).
       WillOnce(Return(QuicConsumedData(2, true)));
   stream_->OnCanWrite();
 }
 
+TEST_F(ReliableQuicStreamTest, WriteOrBufferDataCopiesDataOnce) {
+  Initialize(kShouldProcessData);
+
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(Return(QuicConsumedData(kDataLen, false)));
+  stream_->WriteOrBufferData(kData1, false, nullptr);
+  EXPECT_EQ(kDataLen, connection_->GetStats().stream_bytes_copied);
+}
+
+TEST_F(ReliableQuicStreamTest, WriteOrBufferSharedData) {
+  Initialize(kShouldProcessData);
+
+  scoped_refptr<base::RefCountedString> data(new base::RefCountedString);
+  data->data() = kData1;
+
+  // The buffer goes down with the data, so that the frames can share it.
+  EXPECT_CALL(*session_,
+              WritevData(kHeadersStreamId, _, data.get(), 0, false, _, _))
+      .WillOnce(Return(QuicConsumedData(kDataLen - 1, false)));
+  stream_->WriteOrBufferSharedData(data.get(), false, nullptr);
+  EXPECT_TRUE(HasWriteBlockedStreams());
+  EXPECT_EQ(1u, ReliableQuicStreamPeer::SizeOfQueuedData(stream_.get()));
+
+  // The rest is written from the same buffer, not from a copy.
+  IOVector iov;
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, data.get(),
+                                    kDataLen - 1, false, _, _))
+      .WillOnce(DoAll(SaveArg<1>(&iov), Return(QuicConsumedData(1, false))));
+  stream_->OnCanWrite();
+  ASSERT_EQ(1u, iov.Size());
+  EXPECT_EQ(data->front() + kDataLen - 1, iov.iovec()[0].iov_base);
+  EXPECT_EQ(1u, iov.iovec()[0].iov_len);
+  EXPECT_EQ(0u, ReliableQuicStreamPeer::SizeOfQueuedData(stream_.get()));
+  EXPECT_EQ(0u, connection_->GetStats().stream_bytes_copied);
+}
+
 TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithFecProtectAlways) {
   Initialize(kShouldProcessData);
 
@@ -245,8 +283,8 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithFecProtectAlways) {
   QuicConnectionPeer::GetPacketCreator(connection_)->SetMaxPacketLength(length);
 
   // Write first data onto stream, which will cause one session write.
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MUST_FEC_PROTECT, _)).WillOnce(
-      Return(QuicConsumedData(kDataLen - 1, false)));
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MUST_FEC_PROTECT, _))
+      .WillOnce(Return(QuicConsumedData(kDataLen - 1, false)));
   stream_->WriteOrBufferData(kData1, false, nullptr);
   EXPECT_TRUE(HasWriteBlockedStreams());
 
@@ -255,14 +293,14 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithFecProtectAlways) {
 
   // Make sure we get the tail of the first write followed by the bytes_consumed
   InSequence s;
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MUST_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MUST_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(1, false)));
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MUST_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MUST_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(kDataLen - 2, false)));
   stream_->OnCanWrite();
 
   // And finally the end of the bytes_consumed.
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MUST_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MUST_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(2, true)));
   stream_->OnCanWrite();
 }
@@ -281,8 +319,8 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithFecProtectOptional) {
       length);
 
   // Write first data onto stream, which will cause one session write.
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MAY_FEC_PROTECT, _)).WillOnce(
-      Return(QuicConsumedData(kDataLen - 1, false)));
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MAY_FEC_PROTECT, _))
+      .WillOnce(Return(QuicConsumedData(kDataLen - 1, false)));
   stream_->WriteOrBufferData(kData1, false, nullptr);
   EXPECT_TRUE(HasWriteBlockedStreams());
 
@@ -291,14 +329,14 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithFecProtectOptional) {
 
   // Make sure we get the tail of the first write followed by the bytes_consumed
   InSequence s;
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MAY_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MAY_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(1, false)));
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MAY_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MAY_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(kDataLen - 2, false)));
   stream_->OnCanWrite();
 
   // And finally the end of the bytes_consumed.
-  EXPECT_CALL(*session_, WritevData(_, _, _, _, MAY_FEC_PROTECT, _)).
+  EXPECT_CALL(*session_, WritevData(_, _, _, _, _, MAY_FEC_PROTECT, _)).
       WillOnce(Return(QuicConsumedData(2, true)));
   stream_->OnCanWrite();
 }
@@ -325,7 +363,7 @@ TEST_F(ReliableQuicStreamTest, RstAlwaysSentIfNoFinSent) {
   EXPECT_FALSE(rst_sent());
 
   // Write some data, with no FIN.
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(1, false)));
   stream_->WriteOrBufferData(StringPiece(kData1, 1), false, nullptr);
   EXPECT_FALSE(fin_sent());
@@ -348,7 +386,7 @@ TEST_F(ReliableQuicStreamTest, RstNotSentIfFinSent) {
   EXPECT_FALSE(rst_sent());
 
   // Write some data, with FIN.
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(1, true)));
   stream_->WriteOrBufferData(StringPiece(kData1, 1), true, nullptr);
   EXPECT_TRUE(fin_sent());
@@ -442,26 +480,26 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataWithQuicAckNotifier) {
 
   scoped_refptr<QuicAckNotifier::DelegateInterface> proxy_delegate;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(kFirstWriteSize, false))));
   stream_->WriteOrBufferData(kData, false, delegate.get());
   EXPECT_TRUE(HasWriteBlockedStreams());
 
   EXPECT_CALL(*session_,
-              WritevData(kHeadersStreamId, _, _, _, _, proxy_delegate.get()))
+              WritevData(kHeadersStreamId, _, _, _, _, _, proxy_delegate.get()))
       .WillOnce(Return(QuicConsumedData(kSecondWriteSize, false)));
   stream_->OnCanWrite();
 
   // No ack expected for an empty write.
   EXPECT_CALL(*session_,
-              WritevData(kHeadersStreamId, _, _, _, _, proxy_delegate.get()))
+              WritevData(kHeadersStreamId, _, _, _, _, _, proxy_delegate.get()))
       .WillOnce(Return(QuicConsumedData(0, false)));
   stream_->OnCanWrite();
 
   EXPECT_CALL(*session_,
-              WritevData(kHeadersStreamId, _, _, _, _, proxy_delegate.get()))
+              WritevData(kHeadersStreamId, _, _, _, _, _, proxy_delegate.get()))
       .WillOnce(Return(QuicConsumedData(kLastWriteSize, false)));
   stream_->OnCanWrite();
 
@@ -495,8 +533,8 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataAckNotificationBeforeFlush) {
 
   scoped_refptr<QuicAckNotifier::DelegateInterface> proxy_delegate;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(kInitialWriteSize, false))));
   stream_->WriteOrBufferData(kData, false, delegate.get());
@@ -506,10 +544,11 @@ TEST_F(ReliableQuicStreamTest, WriteOrBufferDataAckNotificationBeforeFlush) {
   proxy_delegate->OnAckNotification(3, 4, zero_);
   proxy_delegate = nullptr;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _)).WillOnce(
-      DoAll(WithArgs<5>(Invoke(CreateFunctor(
-                &SaveProxyAckNotifierDelegate, &proxy_delegate))),
-            Return(QuicConsumedData(kDataSize - kInitialWriteSize, false))));
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
+                          &SaveProxyAckNotifierDelegate, &proxy_delegate))),
+                      Return(QuicConsumedData(kDataSize - kInitialWriteSize,
+                                              false))));
   stream_->OnCanWrite();
 
   // Handle the ack for the second write.
@@ -526,8 +565,8 @@ TEST_F(ReliableQuicStreamTest, WriteAndBufferDataWithAckNotiferNoBuffer) {
 
   scoped_refptr<QuicAckNotifier::DelegateInterface> proxy_delegate;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(kDataLen, true))));
   stream_->WriteOrBufferData(kData1, true, delegate.get());
@@ -547,13 +586,13 @@ TEST_F(ReliableQuicStreamTest, BufferOnWriteAndBufferDataWithAckNotifer) {
 
   scoped_refptr<QuicAckNotifier::DelegateInterface> proxy_delegate;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
       .WillOnce(Return(QuicConsumedData(0, false)));
   stream_->WriteOrBufferData(kData1, true, delegate.get());
   EXPECT_TRUE(HasWriteBlockedStreams());
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(kDataLen, true))));
   stream_->OnCanWrite();
@@ -573,15 +612,15 @@ TEST_F(ReliableQuicStreamTest, WriteAndBufferDataWithAckNotiferOnlyFinRemains) {
 
   scoped_refptr<QuicAckNotifier::DelegateInterface> proxy_delegate;
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(kDataLen, false))));
   stream_->WriteOrBufferData(kData1, true, delegate.get());
   EXPECT_TRUE(HasWriteBlockedStreams());
 
-  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _))
-      .WillOnce(DoAll(WithArgs<5>(Invoke(CreateFunctor(
+  EXPECT_CALL(*session_, WritevData(kHeadersStreamId, _, _, _, _, _, _))
+      .WillOnce(DoAll(WithArgs<6>(Invoke(CreateFunctor(
                           &SaveProxyAckNotifierDelegate, &proxy_delegate))),
                       Return(QuicConsumedData(0, true))));
   stream_->OnCanWrite();
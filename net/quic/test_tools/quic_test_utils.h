@@ -382,9 +382,10 @@ class MockSession : public QuicSession {
   MOCK_METHOD1(CreateIncomingDataStream, QuicDataStream*(QuicStreamId id));
   MOCK_METHOD0(GetCryptoStream, QuicCryptoStream*());
   MOCK_METHOD0(CreateOutgoingDataStream, QuicDataStream*());
-  MOCK_METHOD6(WritevData,
+  MOCK_METHOD7(WritevData,
                QuicConsumedData(QuicStreamId id,
                                 const IOVector& data,
+                                base::RefCountedMemory* data_buffer,
                                 QuicStreamOffset offset,
                                 bool fin,
                                 FecProtection fec_protection,
@@ -45,7 +45,7 @@ uint32 ReliableQuicStreamPeer::SizeOfQueuedData(ReliableQuicStream* stream) {
   std::list<ReliableQuicStream::PendingData>::iterator it =
       stream->queued_data_.begin();
   while (it != stream->queued_data_.end()) {
-    total += it->data.size();
+    total += it->data->size() - it->offset;
     ++it;
   }
   return total;
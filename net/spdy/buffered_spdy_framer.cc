@@ -391,6 +391,16 @@ SpdyFrame* BufferedSpdyFramer::CreateDataFrame(SpdyStreamId stream_id,
   return spdy_framer_.SerializeData(data_ir);
 }
 
+SpdyFrame* BufferedSpdyFramer::CreateDataFrameHeader(SpdyStreamId stream_id,
+                                                     const char* data,
+                                                     uint32 len,
+                                                     SpdyDataFlags flags) {
+  SpdyDataIR data_ir(stream_id,
+                     base::StringPiece(data, len));
+  data_ir.set_fin((flags & DATA_FLAG_FIN) != 0);
+  return spdy_framer_.SerializeDataFrameHeaderWithPaddingLengthField(data_ir);
+}
+
 // TODO(jgraettinger): Eliminate uses of this method (prefer SpdyPushPromiseIR).
 SpdyFrame* BufferedSpdyFramer::CreatePushPromise(
     SpdyStreamId stream_id,
@@ -215,6 +215,12 @@ class NET_EXPORT_PRIVATE BufferedSpdyFramer
                              const char* data,
                              uint32 len,
                              SpdyDataFlags flags);
+  // Serializes only the header of the DATA frame which CreateDataFrame()
+  // would create, leaving the caller to send the payload in place.
+  SpdyFrame* CreateDataFrameHeader(SpdyStreamId stream_id,
+                                   const char* data,
+                                   uint32 len,
+                                   SpdyDataFlags flags);
   SpdyFrame* CreatePushPromise(SpdyStreamId stream_id,
                                SpdyStreamId promised_stream_id,
                                const SpdyHeaderBlock* headers);
@@ -181,7 +181,7 @@ bool HpackDecoder::DecodeNextName(
     *next_name = entry->name();
   } else {
     // |entry| could be evicted as part of this insertion. Preemptively copy.
-    key_buffer_.assign(entry->name());
+    entry->name().CopyToString(&key_buffer_);
     *next_name = key_buffer_;
   }
   return true;
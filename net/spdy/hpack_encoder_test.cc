@@ -171,7 +171,7 @@ TEST_F(HpackEncoderTest, SingleDynamicIndex) {
   ExpectIndex(IndexOf(key_2_));
 
   map<string, string> headers;
-  headers[key_2_->name()] = key_2_->value();
+  headers[key_2_->name().as_string()] = key_2_->value().as_string();
   CompareWithExpectedEncoding(headers);
 }
 
@@ -179,7 +179,7 @@ TEST_F(HpackEncoderTest, SingleStaticIndex) {
   ExpectIndex(IndexOf(static_));
 
   map<string, string> headers;
-  headers[static_->name()] = static_->value();
+  headers[static_->name().as_string()] = static_->value().as_string();
   CompareWithExpectedEncoding(headers);
 }
 
@@ -188,7 +188,7 @@ TEST_F(HpackEncoderTest, SingleStaticIndexTooLarge) {
   ExpectIndex(IndexOf(static_));
 
   map<string, string> headers;
-  headers[static_->name()] = static_->value();
+  headers[static_->name().as_string()] = static_->value().as_string();
   CompareWithExpectedEncoding(headers);
 
   EXPECT_EQ(0u, peer_.table_peer().dynamic_entries()->size());
@@ -198,7 +198,7 @@ TEST_F(HpackEncoderTest, SingleLiteralWithIndexName) {
   ExpectIndexedLiteral(key_2_, "value3");
 
   map<string, string> headers;
-  headers[key_2_->name()] = "value3";
+  headers[key_2_->name().as_string()] = "value3";
   CompareWithExpectedEncoding(headers);
 
   // A new entry was inserted and added to the reference set.
@@ -240,7 +240,7 @@ TEST_F(HpackEncoderTest, EmitThanEvict) {
   ExpectIndexedLiteral("key3", "value3");
 
   map<string, string> headers;
-  headers[key_1_->name()] = key_1_->value();
+  headers[key_1_->name().as_string()] = key_1_->value().as_string();
   headers["key3"] = "value3";
   CompareWithExpectedEncoding(headers);
 }
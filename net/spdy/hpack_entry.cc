@@ -20,24 +20,78 @@ HpackEntry::HpackEntry(StringPiece name,
                        size_t insertion_index)
     : name_(name.data(), name.size()),
       value_(value.data(), value.size()),
+      name_ref_(name_),
+      value_ref_(value_),
+      owns_strings_(true),
       insertion_index_(insertion_index),
       type_(is_static ? STATIC : DYNAMIC) {
 }
 
 HpackEntry::HpackEntry(StringPiece name, StringPiece value)
-    : name_(name.data(), name.size()),
-      value_(value.data(), value.size()),
+    : name_ref_(name),
+      value_ref_(value),
+      owns_strings_(false),
       insertion_index_(0),
       type_(LOOKUP) {
 }
 
 HpackEntry::HpackEntry()
-    : insertion_index_(0),
+    : owns_strings_(false),
+      insertion_index_(0),
       type_(LOOKUP) {
 }
 
+HpackEntry::HpackEntry(const HpackEntry& other)
+    : name_(other.name_),
+      value_(other.value_),
+      name_ref_(other.name_ref_),
+      value_ref_(other.value_ref_),
+      owns_strings_(other.owns_strings_),
+      insertion_index_(other.insertion_index_),
+      type_(other.type_) {
+  if (owns_strings_) {
+    name_ref_ = name_;
+    value_ref_ = value_;
+  }
+}
+
+HpackEntry& HpackEntry::operator=(const HpackEntry& other) {
+  if (this == &other)
+    return *this;
+  name_ = other.name_;
+  value_ = other.value_;
+  name_ref_ = other.name_ref_;
+  value_ref_ = other.value_ref_;
+  owns_strings_ = other.owns_strings_;
+  insertion_index_ = other.insertion_index_;
+  type_ = other.type_;
+  if (owns_strings_) {
+    name_ref_ = name_;
+    value_ref_ = value_;
+  }
+  return *this;
+}
+
 HpackEntry::~HpackEntry() {}
 
+// static
+HpackEntry HpackEntry::CreateUnowned(StringPiece name,
+                                     StringPiece value,
+                                     size_t insertion_index) {
+  HpackEntry entry(name, value);
+  entry.insertion_index_ = insertion_index;
+  entry.type_ = DYNAMIC;
+  return entry;
+}
+
+void HpackEntry::SetStorage(StringPiece name, StringPiece value) {
+  DCHECK(!owns_strings_);
+  DCHECK_EQ(name_ref_, name);
+  DCHECK_EQ(value_ref_, value);
+  name_ref_ = name;
+  value_ref_ = value;
+}
+
 // static
 size_t HpackEntry::Size(StringPiece name, StringPiece value) {
   return name.size() + value.size() + kSizeOverhead;
@@ -47,8 +101,8 @@ size_t HpackEntry::Size() const {
 }
 
 std::string HpackEntry::GetDebugString() const {
-  return "{ name: \"" + name_ +
-      "\", value: \"" + value_ +
+  return "{ name: \"" + name_ref_.as_string() +
+      "\", value: \"" + value_ref_.as_string() +
       "\", " + (IsStatic() ? "static" : "dynamic") + " }";
 }
 
@@ -35,6 +35,7 @@ class NET_EXPORT_PRIVATE HpackEntry {
   //
   // The combination of |is_static| and |insertion_index| allows an
   // HpackEntryTable to determine the index of an HpackEntry in O(1) time.
+  // The entry keeps its own copy of |name| and |value|.
   HpackEntry(base::StringPiece name,
              base::StringPiece value,
              bool is_static,
@@ -42,16 +43,33 @@ class NET_EXPORT_PRIVATE HpackEntry {
 
   // Create a 'lookup' entry (only) suitable for querying a HpackEntrySet. The
   // instance InsertionIndex() always returns 0 and IsLookup() returns true.
+  // |name| and |value| are referenced rather than copied, and must outlive
+  // the entry.
   HpackEntry(base::StringPiece name, base::StringPiece value);
 
   // Creates an entry with empty name and value. Only defined so that
   // entries can be stored in STL containers.
   HpackEntry();
 
+  // Copies of an entry owning its name and value make their own copy;
+  // copies of a referencing entry reference the same bytes.
+  HpackEntry(const HpackEntry& other);
+  HpackEntry& operator=(const HpackEntry& other);
+
   ~HpackEntry();
 
-  const std::string& name() const { return name_; }
-  const std::string& value() const { return value_; }
+  // Creates a dynamic entry which references, rather than copies, |name| and
+  // |value|. Used by HpackHeaderTable for entries whose bytes live in its
+  // entry store, which must outlive the entry (or call SetStorage()).
+  static HpackEntry CreateUnowned(base::StringPiece name,
+                                  base::StringPiece value,
+                                  size_t insertion_index);
+
+  base::StringPiece name() const { return name_ref_; }
+  base::StringPiece value() const { return value_ref_; }
+
+  // Re-points a referencing entry at a relocated copy of its name and value.
+  void SetStorage(base::StringPiece name, base::StringPiece value);
 
   // Returns whether this entry is a member of the static (as opposed to
   // dynamic) table.
@@ -76,9 +94,13 @@ class NET_EXPORT_PRIVATE HpackEntry {
     STATIC,
   };
 
-  // TODO(jgraettinger): Reduce copies, possibly via SpdyPinnableBufferPiece.
+  // Backing storage of |name_ref_| and |value_ref_|, if |owns_strings_|.
+  // Otherwise, these are unused and the referenced bytes are owned elsewhere.
   std::string name_;
   std::string value_;
+  base::StringPiece name_ref_;
+  base::StringPiece value_ref_;
+  bool owns_strings_;
 
   // The entry's index in the total set of entries ever inserted into the header
   // table.
@@ -6,6 +6,7 @@
 
 #include <string>
 
+#include "base/memory/scoped_ptr.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -84,6 +85,29 @@ TEST_F(HpackEntryTest, LookupConstructor) {
   EXPECT_EQ(Size(), entry.Size());
 }
 
+TEST_F(HpackEntryTest, CopiesOwnOrReferenceStorage) {
+  scoped_ptr<HpackEntry> original(new HpackEntry(DynamicEntry()));
+  HpackEntry owned_copy(*original);
+  EXPECT_NE(original->name().data(), owned_copy.name().data());
+  original.reset();
+  EXPECT_EQ(name_, owned_copy.name());
+  EXPECT_EQ(value_, owned_copy.value());
+
+  // Lookup and unowned entries reference the caller's bytes.
+  HpackEntry lookup(name_, value_);
+  HpackEntry lookup_copy(lookup);
+  EXPECT_EQ(name_.data(), lookup_copy.name().data());
+  EXPECT_EQ(value_.data(), lookup_copy.value().data());
+
+  HpackEntry unowned = HpackEntry::CreateUnowned(name_, value_, 1);
+  EXPECT_FALSE(unowned.IsStatic());
+  EXPECT_FALSE(unowned.IsLookup());
+  EXPECT_EQ(1u, unowned.InsertionIndex());
+  EXPECT_EQ(name_.data(), unowned.name().data());
+  owned_copy = unowned;
+  EXPECT_EQ(name_.data(), owned_copy.name().data());
+}
+
 TEST_F(HpackEntryTest, DefaultConstructor) {
   HpackEntry entry;
 
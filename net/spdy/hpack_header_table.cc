@@ -5,6 +5,7 @@
 #include "net/spdy/hpack_header_table.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "base/logging.h"
 #include "net/spdy/hpack_constants.h"
@@ -35,6 +36,9 @@ bool HpackHeaderTable::EntryComparator::operator() (
 HpackHeaderTable::HpackHeaderTable()
     : static_entries_(ObtainHpackStaticTable().GetStaticEntries()),
       static_index_(ObtainHpackStaticTable().GetStaticIndex()),
+      entry_store_size_(0),
+      entry_store_begin_(0),
+      entry_store_end_(0),
       settings_size_bound_(kDefaultHeaderTableSizeSetting),
       size_(0),
       max_size_(kDefaultHeaderTableSizeSetting),
@@ -162,6 +166,58 @@ void HpackHeaderTable::Evict(size_t count) {
     CHECK_EQ(1u, dynamic_index_.erase(entry));
     dynamic_entries_.pop_back();
   }
+  if (count == 0) {
+    return;
+  }
+  if (dynamic_entries_.empty()) {
+    entry_store_begin_ = 0;
+    entry_store_end_ = 0;
+  } else {
+    entry_store_begin_ =
+        dynamic_entries_.back().name().data() - entry_store_.get();
+  }
+}
+
+char* HpackHeaderTable::AllocateEntryStorage(size_t size,
+                                             scoped_ptr<char[]>* old_store) {
+  // Bytes referenced by live entries. The store has wrapped if the newest
+  // entry's bytes precede the oldest's; with no live bytes, it hasn't.
+  size_t used = size_ - dynamic_entries_.size() * HpackEntry::kSizeOverhead;
+  bool wrapped = entry_store_end_ < entry_store_begin_ ||
+      (entry_store_end_ == entry_store_begin_ && used != 0);
+
+  size_t offset;
+  if (!wrapped && entry_store_size_ - entry_store_end_ >= size) {
+    offset = entry_store_end_;
+  } else if (!wrapped && entry_store_begin_ >= size) {
+    offset = 0;
+  } else if (wrapped && entry_store_begin_ - entry_store_end_ >= size) {
+    offset = entry_store_end_;
+  } else {
+    // The store is too small for max_size(), which was either raised or
+    // never allocated. Reallocate, compacting entries oldest first.
+    DCHECK_LE(used + size, max_size_);
+    size_t new_size = std::max(2 * max_size_, entry_store_size_);
+    scoped_ptr<char[]> new_store(new char[new_size]);
+
+    offset = 0;
+    for (EntryTable::reverse_iterator it = dynamic_entries_.rbegin();
+         it != dynamic_entries_.rend(); ++it) {
+      char* name = new_store.get() + offset;
+      char* value = name + it->name().size();
+      memcpy(name, it->name().data(), it->name().size());
+      memcpy(value, it->value().data(), it->value().size());
+      it->SetStorage(StringPiece(name, it->name().size()),
+                     StringPiece(value, it->value().size()));
+      offset += it->name().size() + it->value().size();
+    }
+    *old_store = entry_store_.Pass();
+    entry_store_ = new_store.Pass();
+    entry_store_size_ = new_size;
+    entry_store_begin_ = 0;
+  }
+  entry_store_end_ = offset + size;
+  return entry_store_.get() + offset;
 }
 
 const HpackEntry* HpackHeaderTable::TryAddEntry(StringPiece name,
@@ -175,10 +231,18 @@ const HpackEntry* HpackHeaderTable::TryAddEntry(StringPiece name,
     DCHECK_EQ(0u, size_);
     return NULL;
   }
-  dynamic_entries_.push_front(HpackEntry(name,
-                                         value,
-                                         false,  // is_static
-                                         total_insertions_));
+  // |name| and |value| may reference the entry store, so keep a replaced
+  // store alive until they've been copied.
+  scoped_ptr<char[]> old_store;
+  char* storage = AllocateEntryStorage(name.size() + value.size(),
+                                       &old_store);
+  memcpy(storage, name.data(), name.size());
+  memcpy(storage + name.size(), value.data(), value.size());
+
+  dynamic_entries_.push_front(HpackEntry::CreateUnowned(
+      StringPiece(storage, name.size()),
+      StringPiece(storage + name.size(), value.size()),
+      total_insertions_));
   CHECK(dynamic_index_.insert(&dynamic_entries_.front()).second);
 
   size_ += entry_size;
@@ -11,6 +11,7 @@
 
 #include "base/basictypes.h"
 #include "base/macros.h"
+#include "base/memory/scoped_ptr.h"
 #include "net/base/net_export.h"
 #include "net/spdy/hpack_entry.h"
 
@@ -105,6 +106,11 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   // Evicts |count| oldest entries from the table.
   void Evict(size_t count);
 
+  // Returns |size| contiguous bytes of |entry_store_| following those of the
+  // newest entry. If the store must be reallocated, the previous store is
+  // returned via |old_store| so that the caller may still copy from it.
+  char* AllocateEntryStorage(size_t size, scoped_ptr<char[]>* old_store);
+
   // |static_entries_| and |static_index_| are owned by HpackStaticTable
   // singleton.
   const EntryTable& static_entries_;
@@ -113,6 +119,17 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   const OrderedEntrySet& static_index_;
   OrderedEntrySet dynamic_index_;
 
+  // Ring buffer holding the name and value bytes of |dynamic_entries_|, which
+  // reference rather than own them. Each entry's name and value are stored
+  // contiguously, in insertion order beginning at |entry_store_begin_| and
+  // ending at |entry_store_end_|. An entry which doesn't fit before the end
+  // of the buffer wraps to its start. Sized at twice max_size(), the store
+  // can always place an entry admitted by the table's size accounting.
+  scoped_ptr<char[]> entry_store_;
+  size_t entry_store_size_;
+  size_t entry_store_begin_;
+  size_t entry_store_end_;
+
   // Last acknowledged value for SETTINGS_HEADER_TABLE_SIZE.
   size_t settings_size_bound_;
 
@@ -5,12 +5,15 @@
 #include "net/spdy/hpack_header_table.h"
 
 #include <algorithm>
+#include <deque>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
 #include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
 #include "net/spdy/hpack_constants.h"
 #include "net/spdy/hpack_entry.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -86,7 +89,9 @@ class HpackHeaderTableTest : public ::testing::Test {
     EXPECT_GE(size, HpackEntry::kSizeOverhead);
     string name((size - HpackEntry::kSizeOverhead) / 2, 'n');
     string value(size - HpackEntry::kSizeOverhead - name.size(), 'v');
-    HpackEntry entry(name, value);
+    // Lookup entries don't own their name and value, so build an entry which
+    // does.
+    HpackEntry entry(name, value, false, 0);
     EXPECT_EQ(size, entry.Size());
     return entry;
   }
@@ -408,6 +413,54 @@ TEST_F(HpackHeaderTableTest, TryAddTooLargeEntry) {
   EXPECT_EQ(0u, peer_.dynamic_entries().size());
 }
 
+// Cycles entries of varying sizes through the table, such that their bytes
+// wrap around the entry store, and checks that live entries are intact.
+TEST_F(HpackHeaderTableTest, EntryStoreWraps) {
+  std::deque<std::pair<string, string> > expected;
+  for (size_t i = 0; i != 200; ++i) {
+    string name = "name-" + base::SizeTToString(i);
+    string value((i * 37) % 300, static_cast<char>('a' + i % 26));
+    ASSERT_NE(static_cast<HpackEntry*>(NULL),
+              table_.TryAddEntry(name, value));
+    expected.push_front(std::make_pair(name, value));
+    expected.resize(peer_.dynamic_entries_count());
+
+    for (size_t j = 0; j != expected.size(); ++j) {
+      const HpackEntry* entry = table_.GetByIndex(62 + j);
+      ASSERT_NE(static_cast<HpackEntry*>(NULL), entry);
+      EXPECT_EQ(expected[j].first, entry->name());
+      EXPECT_EQ(expected[j].second, entry->value());
+      EXPECT_EQ(entry, table_.GetByNameAndValue(expected[j].first,
+                                                expected[j].second));
+    }
+  }
+}
+
+// Raising the maximum size reallocates the entry store, which relocates the
+// bytes of live entries.
+TEST_F(HpackHeaderTableTest, EntryStoreGrows) {
+  const HpackEntry* first = table_.TryAddEntry("key1", "value1");
+  const HpackEntry* second = table_.TryAddEntry("key2", "value2");
+
+  table_.SetSettingsHeaderTableSize(4 * kDefaultHeaderTableSizeSetting);
+  table_.SetMaxSize(4 * kDefaultHeaderTableSizeSetting);
+
+  // Fill beyond the previous capacity of the store.
+  string value(3 * kDefaultHeaderTableSizeSetting, 'v');
+  const HpackEntry* third = table_.TryAddEntry("key3", value);
+  ASSERT_NE(static_cast<HpackEntry*>(NULL), third);
+  EXPECT_EQ(3u, peer_.dynamic_entries_count());
+
+  EXPECT_EQ("key1", first->name());
+  EXPECT_EQ("value1", first->value());
+  EXPECT_EQ("key2", second->name());
+  EXPECT_EQ("value2", second->value());
+  EXPECT_EQ("key3", third->name());
+  EXPECT_EQ(value, third->value());
+  EXPECT_EQ(first, table_.GetByNameAndValue("key1", "value1"));
+  EXPECT_EQ(second, table_.GetByName("key2"));
+}
+
 TEST_F(HpackHeaderTableTest, ComparatorNameOrdering) {
   HpackEntry entry1("header", "value");
   HpackEntry entry2("HEADER", "value");
@@ -5,7 +5,6 @@
 #include "net/spdy/hpack_huffman_table.h"
 
 #include <algorithm>
-#include <cmath>
 
 #include "base/logging.h"
 #include "base/numerics/safe_conversions.h"
@@ -23,6 +22,13 @@ namespace {
 const uint8 kDecodeTableRootBits = 9;
 // Maximum number of bits to index in successive decode tables.
 const uint8 kDecodeTableBranchBits = 6;
+// Number of decode iterations required for a 32-bit code.
+const int kDecodeIterations =
+    (32 - kDecodeTableRootBits + kDecodeTableBranchBits - 1) /
+    kDecodeTableBranchBits;
+// How many leading bits of input index the multi-symbol decode table. HPACK's
+// shortest codes are five bits, so common runs decode two symbols at a time.
+const uint8 kMultiDecodeBits = 12;
 
 bool SymbolLengthAndIdCompare(const HpackHuffmanSymbol& a,
                               const HpackHuffmanSymbol& b) {
@@ -49,6 +55,9 @@ HpackHuffmanTable::DecodeEntry::DecodeEntry(uint8 next_table_index,
 size_t HpackHuffmanTable::DecodeTable::size() const {
   return size_t(1) << indexed_length;
 }
+HpackHuffmanTable::MultiDecodeEntry::MultiDecodeEntry()
+  : length(0), symbol_count(0) {
+}
 
 HpackHuffmanTable::HpackHuffmanTable() {}
 
@@ -98,6 +107,7 @@ bool HpackHuffmanTable::Initialize(const HpackHuffmanSymbol* input_symbols,
   pad_bits_ = static_cast<uint8>(symbols.back().code >> 24);
 
   BuildDecodeTables(symbols);
+  BuildMultiDecodeTable();
   // Order on symbol ID ascending.
   std::sort(symbols.begin(), symbols.end(), SymbolIdCompare);
   BuildEncodeTable(symbols);
@@ -184,6 +194,29 @@ void HpackHuffmanTable::BuildDecodeTables(const std::vector<Symbol>& symbols) {
   }
 }
 
+void HpackHuffmanTable::BuildMultiDecodeTable() {
+  multi_decode_entries_.resize(size_t(1) << kMultiDecodeBits);
+  for (size_t i = 0; i != multi_decode_entries_.size(); i++) {
+    MultiDecodeEntry& multi_entry = multi_decode_entries_[i];
+    uint32 bits = static_cast<uint32>(i) << (32 - kMultiDecodeBits);
+
+    while (multi_entry.symbol_count != MultiDecodeEntry::kMaxSymbols) {
+      // Trailing zero bits beyond the index may select a code longer than
+      // the bits remaining, which is caught by the length check.
+      const DecodeEntry& entry = LookupEntry(bits);
+      if (entry.length == 0 ||
+          multi_entry.length + entry.length > kMultiDecodeBits ||
+          entry.symbol_id >= 256) {
+        break;
+      }
+      multi_entry.symbols[multi_entry.symbol_count++] =
+          static_cast<char>(entry.symbol_id);
+      multi_entry.length += entry.length;
+      bits = bits << entry.length;
+    }
+  }
+}
+
 uint8 HpackHuffmanTable::AddDecodeTable(uint8 prefix, uint8 indexed) {
   CHECK_LT(decode_tables_.size(), 255u);
   {
@@ -213,13 +246,38 @@ void HpackHuffmanTable::SetEntry(const DecodeTable& table,
   decode_entries_[table.entries_offset + index] = entry;
 }
 
+const HpackHuffmanTable::DecodeEntry& HpackHuffmanTable::LookupEntry(
+    uint32 bits) const {
+  uint8 table_index = 0;
+  uint32 index = bits >> (32 - kDecodeTableRootBits);
+
+  for (int i = 0; i != kDecodeIterations; i++) {
+    const DecodeEntry& entry = Entry(decode_tables_[table_index], index);
+    if (entry.next_table_index == table_index) {
+      // Terminal entries are self-referential.
+      break;
+    }
+    DCHECK_LT(entry.next_table_index, decode_tables_.size());
+    table_index = entry.next_table_index;
+
+    const DecodeTable& table = decode_tables_[table_index];
+    // Mask and shift the portion of the code being indexed into low bits.
+    index = (bits << table.prefix_length) >> (32 - table.indexed_length);
+  }
+  return Entry(decode_tables_[table_index], index);
+}
+
 bool HpackHuffmanTable::IsInitialized() const {
   return !code_by_id_.empty();
 }
 
 void HpackHuffmanTable::EncodeString(StringPiece in,
                                      HpackOutputStream* out) const {
-  size_t bit_remnant = 0;
+  // Pending output, stored in the low |bit_count| bits of |bits|. Codes are
+  // at most 32 bits long, and whole bytes are flushed after every symbol, so
+  // at most 39 bits are ever pending.
+  uint64 bits = 0;
+  size_t bit_count = 0;
   for (size_t i = 0; i != in.size(); i++) {
     uint16 symbol_id = static_cast<uint8>(in[i]);
     CHECK_GT(code_by_id_.size(), symbol_id);
@@ -228,25 +286,17 @@ void HpackHuffmanTable::EncodeString(StringPiece in,
     unsigned length = length_by_id_[symbol_id];
     uint32 code = code_by_id_[symbol_id] >> (32 - length);
 
-    bit_remnant = (bit_remnant + length) % 8;
-
-    if (length > 24) {
-      out->AppendBits(static_cast<uint8>(code >> 24), length - 24);
-      length = 24;
+    bits = (bits << length) | code;
+    bit_count += length;
+    while (bit_count >= 8) {
+      bit_count -= 8;
+      out->AppendBits(static_cast<uint8>(bits >> bit_count), 8);
     }
-    if (length > 16) {
-      out->AppendBits(static_cast<uint8>(code >> 16), length - 16);
-      length = 16;
-    }
-    if (length > 8) {
-      out->AppendBits(static_cast<uint8>(code >> 8), length - 8);
-      length = 8;
-    }
-    out->AppendBits(static_cast<uint8>(code), length);
   }
-  if (bit_remnant != 0) {
+  if (bit_count != 0) {
     // Pad current byte as required.
-    out->AppendBits(pad_bits_ >> bit_remnant, 8 - bit_remnant);
+    uint8 remnant = static_cast<uint8>(bits << (8 - bit_count));
+    out->AppendBits(remnant | (pad_bits_ >> bit_count), 8);
   }
 }
 
@@ -267,56 +317,59 @@ size_t HpackHuffmanTable::EncodedSize(StringPiece in) const {
 bool HpackHuffmanTable::DecodeString(HpackInputStream* in,
                                      size_t out_capacity,
                                      string* out) const {
-  // Number of decode iterations required for a 32-bit code.
-  const int kDecodeIterations = static_cast<int>(
-      std::ceil((32.f - kDecodeTableRootBits) / kDecodeTableBranchBits));
-
   out->clear();
 
   // Current input, stored in the high |bits_available| bits of |bits|.
   uint32 bits = 0;
   size_t bits_available = 0;
-  bool peeked_success = in->PeekBits(&bits_available, &bits);
 
   while (true) {
-    const DecodeTable* table = &decode_tables_[0];
-    uint32 index = bits >> (32 - kDecodeTableRootBits);
-
-    for (int i = 0; i != kDecodeIterations; i++) {
-      DCHECK_LT(index, table->size());
-      DCHECK_LT(Entry(*table, index).next_table_index, decode_tables_.size());
+    // Refill |bits|. PeekBits() returns at most a byte per call, and fails
+    // only once |in| is exhausted.
+    bool peeked_success = true;
+    while (bits_available < 32 && peeked_success) {
+      peeked_success = in->PeekBits(&bits_available, &bits);
+    }
 
-      table = &decode_tables_[Entry(*table, index).next_table_index];
-      // Mask and shift the portion of the code being indexed into low bits.
-      index = (bits << table->prefix_length) >> (32 - table->indexed_length);
+    // Fast path: emit a run of short codes with a single lookup.
+    const MultiDecodeEntry& multi_entry =
+        multi_decode_entries_[bits >> (32 - kMultiDecodeBits)];
+    if (multi_entry.symbol_count != 0 &&
+        multi_entry.length <= bits_available &&
+        out->size() + multi_entry.symbol_count <= out_capacity) {
+      out->append(multi_entry.symbols, multi_entry.symbol_count);
+
+      in->ConsumeBits(multi_entry.length);
+      bits = bits << multi_entry.length;
+      bits_available -= multi_entry.length;
+      continue;
     }
-    const DecodeEntry& entry = Entry(*table, index);
+
+    const DecodeEntry& entry = LookupEntry(bits);
 
     if (entry.length > bits_available) {
-      if (!peeked_success) {
-        // Unable to read enough input for a match. If only a portion of
-        // the last byte remains, this is a successful EOF condition.
-        in->ConsumeByteRemainder();
-        return !in->HasMoreData();
-      }
+      // Unable to read enough input for a match (|bits| is only short of 32
+      // bits once |in| is exhausted). If only a portion of the last byte
+      // remains, this is a successful EOF condition.
+      DCHECK(!peeked_success);
+      in->ConsumeByteRemainder();
+      return !in->HasMoreData();
     } else if (entry.length == 0) {
       // The input is an invalid prefix, larger than any prefix in the table.
       return false;
-    } else {
-      if (out->size() == out_capacity) {
-        // This code would cause us to overflow |out_capacity|.
-        return false;
-      }
-      if (entry.symbol_id < 256) {
-        // Assume symbols >= 256 are used for padding.
-        out->push_back(static_cast<char>(entry.symbol_id));
-      }
-
-      in->ConsumeBits(entry.length);
-      bits = bits << entry.length;
-      bits_available -= entry.length;
     }
-    peeked_success = in->PeekBits(&bits_available, &bits);
+    if (out->size() == out_capacity) {
+      // This code would cause us to overflow |out_capacity|.
+      return false;
+    }
+    if (entry.symbol_id < 256) {
+      // Assume symbols >= 256 are used for padding.
+      out->push_back(static_cast<char>(entry.symbol_id));
+    }
+
+    in->ConsumeBits(entry.length);
+    bits = bits << entry.length;
+    bits_available -= entry.length;
   }
   NOTREACHED();
   return false;
@@ -60,6 +60,24 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
     // Returns |1 << indexed_length|.
     size_t size() const;
   };
+  // MultiDecodeEntry caches the result of greedily decoding a run of short
+  // codes from a fixed-width prefix of the input, so that common symbols may
+  // be emitted several at a time from a single lookup. The shortest codes of
+  // the HPACK code are 5 bits, so with it a lookup yields at most two symbols;
+  // |kMaxSymbols| only matters for codes with shorter ones.
+  struct NET_EXPORT_PRIVATE MultiDecodeEntry {
+    static const size_t kMaxSymbols = 4;
+
+    MultiDecodeEntry();
+
+    // Combined bit-length of the decoded codes.
+    uint8 length;
+    // Number of decoded symbols. Zero if the first code isn't fully captured
+    // by the prefix (or isn't a valid code), in which case DecodeString()
+    // falls back to the DecodeTable hierarchy.
+    uint8 symbol_count;
+    char symbols[kMaxSymbols];
+  };
 
   HpackHuffmanTable();
   ~HpackHuffmanTable();
@@ -94,6 +112,9 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
   // Expects symbols ordered on length & ID ascending.
   void BuildDecodeTables(const std::vector<Symbol>& symbols);
 
+  // Expects BuildDecodeTables() to have been called.
+  void BuildMultiDecodeTable();
+
   // Expects symbols ordered on ID ascending.
   void BuildEncodeTable(const std::vector<Symbol>& symbols);
 
@@ -106,9 +127,15 @@ class NET_EXPORT_PRIVATE HpackHuffmanTable {
   void SetEntry(const DecodeTable& table, uint32 index,
                 const DecodeEntry& entry);
 
+  // Walks the DecodeTable hierarchy for the code in the high bits of |bits|.
+  const DecodeEntry& LookupEntry(uint32 bits) const;
+
   std::vector<DecodeTable> decode_tables_;
   std::vector<DecodeEntry> decode_entries_;
 
+  // Indexed on the leading input bits. See MultiDecodeEntry.
+  std::vector<MultiDecodeEntry> multi_decode_entries_;
+
   // Symbol code and code length, in ascending symbol ID order.
   // Codes are stored in the most-significant bits of the word.
   std::vector<uint32> code_by_id_;
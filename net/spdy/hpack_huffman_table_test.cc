@@ -27,6 +27,7 @@ namespace test {
 
 typedef HpackHuffmanTable::DecodeEntry DecodeEntry;
 typedef HpackHuffmanTable::DecodeTable DecodeTable;
+typedef HpackHuffmanTable::MultiDecodeEntry MultiDecodeEntry;
 
 class HpackHuffmanTablePeer {
  public:
@@ -54,6 +55,9 @@ class HpackHuffmanTablePeer {
         table_.decode_entries_.begin() + decode_table.entries_offset;
     return std::vector<DecodeEntry>(begin, begin + decode_table.size());
   }
+  const std::vector<MultiDecodeEntry>& multi_decode_entries() const {
+    return table_.multi_decode_entries_;
+  }
 
  private:
   const HpackHuffmanTable& table_;
@@ -254,6 +258,51 @@ TEST_F(HpackHuffmanTableTest, ValidateInternalsWithSmallCode) {
   EXPECT_EQ(buffer_out, input);
 }
 
+TEST_F(HpackHuffmanTableTest, ValidateMultiDecodeTableWithSmallCode) {
+  HpackHuffmanSymbol code[] = {
+    {bits32("01100000000000000000000000000000"), 4, 0},
+    {bits32("01110000000000000000000000000000"), 4, 1},
+    {bits32("00000000000000000000000000000000"), 2, 2},
+    {bits32("01000000000000000000000000000000"), 3, 3},
+    {bits32("10000000000000000000000000000000"), 5, 4},
+    {bits32("10001000000000000000000000000000"), 5, 5},
+    {bits32("10011000000000000000000000000000"), 8, 6},
+    {bits32("10010000000000000000000000000000"), 5, 7}};
+  EXPECT_TRUE(table_.Initialize(code, arraysize(code)));
+
+  const std::vector<MultiDecodeEntry>& entries = peer_.multi_decode_entries();
+  ASSERT_EQ(4096u, entries.size());
+  {
+    // (2) 00 (2) 00 (2) 00 (2) 00 is capped at |kMaxSymbols|.
+    const MultiDecodeEntry& entry = entries[bits32("000000000000")];
+    EXPECT_EQ(8, entry.length);
+    EXPECT_EQ(string("\x02\x02\x02\x02"),
+              string(entry.symbols, entry.symbol_count));
+  }
+  {
+    // (3) 010 (2) 00 (7) 10010, followed by the invalid prefix 11.
+    const MultiDecodeEntry& entry = entries[bits32("010001001011")];
+    EXPECT_EQ(10, entry.length);
+    EXPECT_EQ(string("\x03\x02\x07"),
+              string(entry.symbols, entry.symbol_count));
+  }
+  {
+    // (6) 10011000 (2) 00 (2) 00.
+    const MultiDecodeEntry& entry = entries[bits32("100110000000")];
+    EXPECT_EQ(12, entry.length);
+    EXPECT_EQ(string("\x06\x02\x02"),
+              string(entry.symbols, entry.symbol_count));
+  }
+  {
+    // (4) 10000, followed by (6) truncated to 1001100.
+    const MultiDecodeEntry& entry = entries[bits32("100001001100")];
+    EXPECT_EQ(5, entry.length);
+    EXPECT_EQ(string("\x04"), string(entry.symbols, entry.symbol_count));
+  }
+  // An invalid prefix defers to the DecodeTables.
+  EXPECT_EQ(0, entries[bits32("111111111111")].symbol_count);
+}
+
 TEST_F(HpackHuffmanTableTest, ValidateMultiLevelDecodeTables) {
   HpackHuffmanSymbol code[] = {
     {bits32("00000000000000000000000000000000"), 6, 0},
@@ -454,6 +503,26 @@ TEST_F(HpackHuffmanTableTest, RoundTripSymbolSequence) {
   EXPECT_EQ(input, buffer_out);
 }
 
+TEST_F(HpackHuffmanTableTest, DecodeStopsAtCapacity) {
+  std::vector<HpackHuffmanSymbol> code = HpackHuffmanCode();
+  EXPECT_TRUE(table_.Initialize(&code[0], code.size()));
+
+  // Short codes which decode several at a time. Every output capacity stops
+  // decoding exactly, whether it falls within a multi-symbol run or not.
+  string input = "0123456789aceiost";
+  string buffer_in = EncodeString(input);
+  for (size_t capacity = 0; capacity != input.size(); ++capacity) {
+    string buffer_out;
+    HpackInputStream input_stream(kuint32max, buffer_in);
+    EXPECT_FALSE(table_.DecodeString(&input_stream, capacity, &buffer_out));
+    EXPECT_EQ(input.substr(0, capacity), buffer_out);
+  }
+  string buffer_out;
+  HpackInputStream input_stream(kuint32max, buffer_in);
+  EXPECT_TRUE(table_.DecodeString(&input_stream, input.size(), &buffer_out));
+  EXPECT_EQ(input, buffer_out);
+}
+
 TEST_F(HpackHuffmanTableTest, EncodedSizeAgreesWithEncodeString) {
   std::vector<HpackHuffmanSymbol> code = HpackHuffmanCode();
   EXPECT_TRUE(table_.Initialize(&code[0], code.size()));
@@ -0,0 +1,287 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/test/perf_time_logger.h"
+#include "net/spdy/hpack_constants.h"
+#include "net/spdy/hpack_decoder.h"
+#include "net/spdy/hpack_encoder.h"
+#include "net/spdy/hpack_huffman_table.h"
+#include "net/spdy/hpack_input_stream.h"
+#include "net/spdy/hpack_output_stream.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+using std::map;
+using std::string;
+using std::vector;
+
+const int kIterations = 2000;
+
+struct CorpusHeader {
+  // Index of the header block within its corpus.
+  int block;
+  const char* name;
+  const char* value;
+};
+
+// Synthetic request headers, written by hand to resemble the loading of a
+// news front page and its subresources. They are not a capture: the hosts are
+// example.com and the cookies are made up.
+const CorpusHeader kRequestCorpus[] = {
+  {0, ":method", "GET"},
+  {0, ":scheme", "https"},
+  {0, ":authority", "www.example.com"},
+  {0, ":path", "/"},
+  {0, "accept", "text/html,application/xhtml+xml,application/xml;q=0.9,"
+                "image/webp,*/*;q=0.8"},
+  {0, "accept-encoding", "gzip, deflate, sdch"},
+  {0, "accept-language", "en-US,en;q=0.8"},
+  {0, "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/40.0.2214.93 Safari/537.36"},
+  {0, "cookie", "NID=67=Uq0sdHk3zQJkYb1dFv8nL3xQp2cWt7eRa9yZ0mKj4hGs6; "
+                "PREF=ID=1d4d3b1bcb7a3c4e:U=2f1e5a7a1f2e6d8b:FF=0:LD=en:"
+                "TM=1419280011:LM=1421950012:S=Yf2z7Tq8x1Rk0bNw"},
+  {1, ":method", "GET"},
+  {1, ":scheme", "https"},
+  {1, ":authority", "www.example.com"},
+  {1, ":path", "/static/css/front-page.3f6d2a1b.css"},
+  {1, "accept", "text/css,*/*;q=0.1"},
+  {1, "accept-encoding", "gzip, deflate, sdch"},
+  {1, "accept-language", "en-US,en;q=0.8"},
+  {1, "referer", "https://www.example.com/"},
+  {1, "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/40.0.2214.93 Safari/537.36"},
+  {1, "cookie", "PREF=ID=1d4d3b1bcb7a3c4e:U=2f1e5a7a1f2e6d8b:FF=0:LD=en:"
+                "TM=1419280011:LM=1421950012:S=Yf2z7Tq8x1Rk0bNw"},
+  {2, ":method", "GET"},
+  {2, ":scheme", "https"},
+  {2, ":authority", "www.example.com"},
+  {2, ":path", "/static/js/front-page.a91c7e04.js"},
+  {2, "accept", "*/*"},
+  {2, "accept-encoding", "gzip, deflate, sdch"},
+  {2, "accept-language", "en-US,en;q=0.8"},
+  {2, "referer", "https://www.example.com/"},
+  {2, "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/40.0.2214.93 Safari/537.36"},
+  {2, "cookie", "PREF=ID=1d4d3b1bcb7a3c4e:U=2f1e5a7a1f2e6d8b:FF=0:LD=en:"
+                "TM=1419280011:LM=1421950012:S=Yf2z7Tq8x1Rk0bNw"},
+  {3, ":method", "GET"},
+  {3, ":scheme", "https"},
+  {3, ":authority", "images.example.com"},
+  {3, ":path", "/thumbs/2015/01/22/world/22markets-thumb-wide.jpg"},
+  {3, "accept", "image/webp,*/*;q=0.8"},
+  {3, "accept-encoding", "gzip, deflate, sdch"},
+  {3, "accept-language", "en-US,en;q=0.8"},
+  {3, "referer", "https://www.example.com/"},
+  {3, "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/40.0.2214.93 Safari/537.36"},
+  {4, ":method", "POST"},
+  {4, ":scheme", "https"},
+  {4, ":authority", "www.example.com"},
+  {4, ":path", "/api/v2/log?event=page_view&"
+               "id=8f14e45fceea167a5a36dedd4bea2543"},
+  {4, "accept", "application/json"},
+  {4, "accept-encoding", "gzip, deflate"},
+  {4, "accept-language", "en-US,en;q=0.8"},
+  {4, "content-length", "412"},
+  {4, "content-type", "application/x-www-form-urlencoded; charset=UTF-8"},
+  {4, "origin", "https://www.example.com"},
+  {4, "referer", "https://www.example.com/"},
+  {4, "user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/40.0.2214.93 Safari/537.36"},
+  {4, "cookie", "NID=67=Uq0sdHk3zQJkYb1dFv8nL3xQp2cWt7eRa9yZ0mKj4hGs6; "
+                "PREF=ID=1d4d3b1bcb7a3c4e:U=2f1e5a7a1f2e6d8b:FF=0:LD=en:"
+                "TM=1419280011:LM=1421950012:S=Yf2z7Tq8x1Rk0bNw"},
+};
+
+// Synthetic response headers for the requests of |kRequestCorpus|.
+const CorpusHeader kResponseCorpus[] = {
+  {0, ":status", "200"},
+  {0, "cache-control", "private, max-age=0"},
+  {0, "content-encoding", "gzip"},
+  {0, "content-type", "text/html; charset=UTF-8"},
+  {0, "date", "Thu, 22 Jan 2015 18:21:04 GMT"},
+  {0, "expires", "-1"},
+  {0, "server", "gws"},
+  {0, "set-cookie", "NID=67=Uq0sdHk3zQJkYb1dFv8nL3xQp2cWt7eRa9yZ0mKj4hGs6; "
+                    "expires=Fri, 24-Jul-2015 18:21:04 GMT; path=/; "
+                    "domain=.example.com; HttpOnly"},
+  {0, "x-frame-options", "SAMEORIGIN"},
+  {0, "x-xss-protection", "1; mode=block"},
+  {1, ":status", "200"},
+  {1, "accept-ranges", "bytes"},
+  {1, "cache-control", "public, max-age=31536000"},
+  {1, "content-encoding", "gzip"},
+  {1, "content-length", "23817"},
+  {1, "content-type", "text/css"},
+  {1, "date", "Thu, 22 Jan 2015 18:21:04 GMT"},
+  {1, "etag", "\"3f6d2a1b-5d09\""},
+  {1, "last-modified", "Tue, 20 Jan 2015 02:11:39 GMT"},
+  {1, "server", "sffe"},
+  {2, ":status", "200"},
+  {2, "accept-ranges", "bytes"},
+  {2, "cache-control", "public, max-age=31536000"},
+  {2, "content-encoding", "gzip"},
+  {2, "content-length", "104882"},
+  {2, "content-type", "application/javascript"},
+  {2, "date", "Thu, 22 Jan 2015 18:21:04 GMT"},
+  {2, "etag", "\"a91c7e04-199b2\""},
+  {2, "last-modified", "Tue, 20 Jan 2015 02:11:41 GMT"},
+  {2, "server", "sffe"},
+  {3, ":status", "200"},
+  {3, "accept-ranges", "bytes"},
+  {3, "age", "31577"},
+  {3, "cache-control", "public, max-age=86400"},
+  {3, "content-length", "9311"},
+  {3, "content-type", "image/jpeg"},
+  {3, "date", "Thu, 22 Jan 2015 09:34:47 GMT"},
+  {3, "last-modified", "Thu, 22 Jan 2015 04:02:13 GMT"},
+  {3, "server", "ECS (iad/182A)"},
+  {3, "via", "1.1 varnish"},
+  {4, ":status", "204"},
+  {4, "cache-control", "no-cache, no-store, must-revalidate"},
+  {4, "date", "Thu, 22 Jan 2015 18:21:05 GMT"},
+  {4, "pragma", "no-cache"},
+  {4, "server", "gws"},
+};
+
+// Groups the headers of a corpus into header blocks. Cookie crumbs are
+// listed in the (sorted) order in which HpackDecoder reassembles them.
+vector<map<string, string> > BuildHeaderBlocks(const CorpusHeader* corpus,
+                                               size_t corpus_size) {
+  vector<map<string, string> > blocks;
+  for (size_t i = 0; i != corpus_size; ++i) {
+    const CorpusHeader& header = corpus[i];
+    if (static_cast<size_t>(header.block) == blocks.size())
+      blocks.push_back(map<string, string>());
+    blocks.back()[header.name] = header.value;
+  }
+  return blocks;
+}
+
+class HpackPerfTest : public ::testing::Test {
+ protected:
+  HpackPerfTest()
+      : request_blocks_(
+            BuildHeaderBlocks(kRequestCorpus, arraysize(kRequestCorpus))),
+        response_blocks_(
+            BuildHeaderBlocks(kResponseCorpus, arraysize(kResponseCorpus))) {}
+
+  // Encodes |blocks| in order, as a fresh connection would.
+  static vector<string> EncodeBlocks(
+      const vector<map<string, string> >& blocks) {
+    HpackEncoder encoder(ObtainHpackHuffmanTable());
+    vector<string> encoded(blocks.size());
+    for (size_t i = 0; i != blocks.size(); ++i)
+      EXPECT_TRUE(encoder.EncodeHeaderSet(blocks[i], &encoded[i]));
+    return encoded;
+  }
+
+  void BenchmarkEncode(const char* name,
+                       const vector<map<string, string> >& blocks) {
+    string encoded;
+    base::PerfTimeLogger timer(name);
+    for (int x = 0; x < kIterations; ++x) {
+      HpackEncoder encoder(ObtainHpackHuffmanTable());
+      for (size_t i = 0; i != blocks.size(); ++i)
+        encoder.EncodeHeaderSet(blocks[i], &encoded);
+    }
+    timer.Done();
+  }
+
+  void BenchmarkDecode(const char* name,
+                       const vector<map<string, string> >& blocks) {
+    const vector<string> encoded = EncodeBlocks(blocks);
+    base::PerfTimeLogger timer(name);
+    for (int x = 0; x < kIterations; ++x) {
+      HpackDecoder decoder(ObtainHpackHuffmanTable());
+      for (size_t i = 0; i != encoded.size(); ++i) {
+        decoder.HandleControlFrameHeadersData(
+            1, encoded[i].data(), encoded[i].size());
+        decoder.HandleControlFrameHeadersComplete(1);
+      }
+    }
+    timer.Done();
+
+    // Check the decoder reproduces the corpus.
+    HpackDecoder decoder(ObtainHpackHuffmanTable());
+    for (size_t i = 0; i != encoded.size(); ++i) {
+      EXPECT_TRUE(decoder.HandleControlFrameHeadersData(
+          1, encoded[i].data(), encoded[i].size()));
+      EXPECT_TRUE(decoder.HandleControlFrameHeadersComplete(1));
+      EXPECT_EQ(blocks[i], decoder.decoded_block());
+    }
+  }
+
+  const vector<map<string, string> > request_blocks_;
+  const vector<map<string, string> > response_blocks_;
+};
+
+TEST_F(HpackPerfTest, EncodeRequests) {
+  BenchmarkEncode("Hpack_encode_requests", request_blocks_);
+}
+
+TEST_F(HpackPerfTest, EncodeResponses) {
+  BenchmarkEncode("Hpack_encode_responses", response_blocks_);
+}
+
+TEST_F(HpackPerfTest, DecodeRequests) {
+  BenchmarkDecode("Hpack_decode_requests", request_blocks_);
+}
+
+TEST_F(HpackPerfTest, DecodeResponses) {
+  BenchmarkDecode("Hpack_decode_responses", response_blocks_);
+}
+
+// Isolates Huffman coding of the corpus' header values.
+TEST_F(HpackPerfTest, HuffmanRoundTrip) {
+  const HpackHuffmanTable& table = ObtainHpackHuffmanTable();
+  vector<string> values;
+  for (size_t i = 0; i != arraysize(kRequestCorpus); ++i)
+    values.push_back(kRequestCorpus[i].value);
+  for (size_t i = 0; i != arraysize(kResponseCorpus); ++i)
+    values.push_back(kResponseCorpus[i].value);
+
+  vector<string> encoded(values.size());
+  {
+    base::PerfTimeLogger timer("Hpack_huffman_encode");
+    HpackOutputStream output_stream;
+    for (int x = 0; x < kIterations; ++x) {
+      for (size_t i = 0; i != values.size(); ++i) {
+        table.EncodeString(values[i], &output_stream);
+        output_stream.TakeString(&encoded[i]);
+      }
+    }
+    timer.Done();
+  }
+  {
+    base::PerfTimeLogger timer("Hpack_huffman_decode");
+    string decoded;
+    for (int x = 0; x < kIterations; ++x) {
+      for (size_t i = 0; i != encoded.size(); ++i) {
+        HpackInputStream input_stream(kuint32max, encoded[i]);
+        table.DecodeString(&input_stream, values[i].size(), &decoded);
+      }
+    }
+    timer.Done();
+  }
+  for (size_t i = 0; i != encoded.size(); ++i) {
+    string decoded;
+    HpackInputStream input_stream(kuint32max, encoded[i]);
+    EXPECT_TRUE(table.DecodeString(&input_stream, values[i].size(), &decoded));
+    EXPECT_EQ(values[i], decoded);
+  }
+}
+
+}  // namespace
+
+}  // namespace net
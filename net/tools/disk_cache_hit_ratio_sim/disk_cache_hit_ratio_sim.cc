@@ -0,0 +1,199 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a trace of cache accesses against the eviction policies of the
+// Simple Cache, and prints the hit ratio that each of them achieves.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_eviction_policy.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_util.h"
+
+namespace disk_cache {
+namespace {
+
+const char kLRUPolicy[] = "lru";
+const char kTinyLFUPolicy[] = "tinylfu";
+
+// Like in SimpleIndex.
+const uint64 kEvictionMarginDivisor = 20;
+
+struct Access {
+  uint64 entry_hash;
+  uint64 entry_size;
+};
+
+struct SimulationResult {
+  SimulationResult()
+      : hits(0), misses(0), hit_bytes(0), miss_bytes(0), evictions(0) {}
+
+  uint64 hits;
+  uint64 misses;
+  uint64 hit_bytes;
+  uint64 miss_bytes;
+  uint64 evictions;
+};
+
+// Reads a trace with an access per line: the key of the entry, then its size
+// in bytes, separated by whitespace. Lines starting with '#' are comments.
+bool ReadTrace(const std::string& path, std::vector<Access>* out_accesses) {
+  std::ifstream trace_file(path.c_str());
+  if (!trace_file.good()) {
+    LOG(ERROR) << "Could not open trace file " << path;
+    return false;
+  }
+  std::string line;
+  std::vector<std::string> tokens;
+  int line_number = 0;
+  while (std::getline(trace_file, line)) {
+    ++line_number;
+    if (line.empty() || line[0] == '#')
+      continue;
+    tokens.clear();
+    base::SplitStringAlongWhitespace(line, &tokens);
+    Access access;
+    if (tokens.size() != 2 ||
+        !base::StringToUint64(tokens[1], &access.entry_size)) {
+      LOG(ERROR) << "Malformed trace line " << line_number << ": " << line;
+      return false;
+    }
+    access.entry_hash = simple_util::GetEntryHashKey(tokens[0]);
+    out_accesses->push_back(access);
+  }
+  return true;
+}
+
+// Runs |accesses| through a cache of |max_size| bytes that evicts like the
+// SimpleIndex does, with |policy|. Every access is a second after the one
+// before it, so that the one second resolution of the last used times of
+// the entries does not blur their order.
+SimulationResult Simulate(const std::vector<Access>& accesses,
+                          uint64 max_size,
+                          SimpleEvictionPolicy* policy) {
+  const uint64 high_watermark = max_size - max_size / kEvictionMarginDivisor;
+  const uint64 low_watermark =
+      max_size - 2 * (max_size / kEvictionMarginDivisor);
+
+  SimulationResult result;
+  SimpleIndex::EntrySet entries;
+  uint64 cache_size = 0;
+  base::Time now = base::Time::UnixEpoch();
+  std::vector<uint64> entry_hashes;
+  for (size_t i = 0; i < accesses.size(); ++i) {
+    const Access& access = accesses[i];
+    now += base::TimeDelta::FromSeconds(1);
+    policy->OnUse(access.entry_hash);
+    SimpleIndex::EntrySet::iterator it = entries.find(access.entry_hash);
+    if (it != entries.end()) {
+      ++result.hits;
+      result.hit_bytes += access.entry_size;
+      cache_size -= it->second.GetEntrySize();
+      it->second.SetLastUsedTime(now);
+      it->second.SetEntrySize(access.entry_size);
+    } else {
+      ++result.misses;
+      result.miss_bytes += access.entry_size;
+      SimpleIndex::InsertInEntrySet(
+          access.entry_hash, EntryMetadata(now, access.entry_size), &entries);
+    }
+    cache_size += access.entry_size;
+
+    if (cache_size <= high_watermark)
+      continue;
+    entry_hashes.clear();
+    policy->SelectEntriesToEvict(entries, cache_size - low_watermark,
+                                 &entry_hashes);
+    for (size_t j = 0; j < entry_hashes.size(); ++j) {
+      SimpleIndex::EntrySet::iterator evicted = entries.find(entry_hashes[j]);
+      DCHECK(evicted != entries.end());
+      cache_size -= evicted->second.GetEntrySize();
+      entries.erase(evicted);
+    }
+    result.evictions += entry_hashes.size();
+  }
+  return result;
+}
+
+double GetRatio(uint64 part, uint64 rest) {
+  return part + rest ? 100.0 * part / (part + rest) : 0.0;
+}
+
+void PrintResult(const std::string& policy_name,
+                 const SimulationResult& result) {
+  std::cout << base::StringPrintf(
+                   "%-8s hit ratio %6.2f%%, byte hit ratio %6.2f%%, "
+                   "%llu evictions",
+                   policy_name.c_str(), GetRatio(result.hits, result.misses),
+                   GetRatio(result.hit_bytes, result.miss_bytes),
+                   static_cast<unsigned long long>(result.evictions))
+            << std::endl;
+}
+
+void PrintUsage(std::ostream* stream) {
+  *stream << "Usage: disk_cache_hit_ratio_sim --trace=<path> "
+          << "--max-size=<bytes> [--policy=<policy>]" << std::endl
+          << "  with <path>=file with a '<key> <size>' line per access"
+          << std::endl
+          << "       <policy>='" << kLRUPolicy << "'|'" << kTinyLFUPolicy
+          << "', all of them by default" << std::endl;
+}
+
+bool Main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+  if (command_line.HasSwitch("help")) {
+    PrintUsage(&std::cout);
+    return true;
+  }
+  uint64 max_size = 0;
+  if (!command_line.HasSwitch("trace") ||
+      !base::StringToUint64(command_line.GetSwitchValueASCII("max-size"),
+                            &max_size) ||
+      max_size == 0) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+  const std::string policy = command_line.GetSwitchValueASCII("policy");
+  if (!policy.empty() && policy != kLRUPolicy && policy != kTinyLFUPolicy) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+
+  std::vector<Access> accesses;
+  if (!ReadTrace(command_line.GetSwitchValueASCII("trace"), &accesses))
+    return false;
+  std::cout << accesses.size() << " accesses" << std::endl;
+
+  if (policy.empty() || policy == kLRUPolicy) {
+    scoped_ptr<SimpleEvictionPolicy> lru = SimpleEvictionPolicy::CreateLRU();
+    PrintResult(kLRUPolicy, Simulate(accesses, max_size, lru.get()));
+  }
+  if (policy.empty() || policy == kTinyLFUPolicy) {
+    scoped_ptr<SimpleEvictionPolicy> tiny_lfu =
+        SimpleEvictionPolicy::CreateTinyLFU();
+    PrintResult(kTinyLFUPolicy, Simulate(accesses, max_size, tiny_lfu.get()));
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace disk_cache
+
+int main(int argc, char** argv) {
+  return !disk_cache::Main(argc, argv);
+}
@@ -0,0 +1,376 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a cache trace, as recorded by disk_cache::TracingCacheBackend,
+// against the cache backends, and prints how fast each of them serves it.
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "net/base/cache_type.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/tracing/cache_trace.h"
+
+namespace disk_cache {
+namespace {
+
+const char kBlockfileBackend[] = "blockfile";
+const char kSimpleBackend[] = "simple";
+const char kMemoryBackend[] = "memory";
+
+const char* const kOpNames[] = {
+    "open", "create", "doom", "doom all", "doom entry",
+    "close", "read", "write", "read sparse", "write sparse",
+};
+static_assert(arraysize(kOpNames) == CACHE_TRACE_OP_MAX,
+              "an op has no name");
+
+struct ReplayResult {
+  ReplayResult()
+      : opens(0),
+        open_hits(0),
+        skipped(0),
+        bytes_read(0),
+        bytes_written(0),
+        file_bytes_written(-1),
+        disk_size(0) {}
+
+  std::vector<int64> latencies_us[CACHE_TRACE_OP_MAX];
+  base::TimeDelta duration;
+  int64 opens;
+  int64 open_hits;
+  // The ops on entries that did not open when replayed.
+  int64 skipped;
+  int64 bytes_read;
+  int64 bytes_written;
+  int64 file_bytes_written;
+  int64 disk_size;
+};
+
+// Returns a key of the recorded length that is the same for every record of
+// the same key.
+std::string GetKey(const CacheTraceRecord& record) {
+  std::string key = base::StringPrintf(
+      "%016llx", static_cast<unsigned long long>(record.key_hash));
+  if (record.key_length > key.size())
+    key.resize(record.key_length, '-');
+  return key;
+}
+
+// Returns how many bytes the process handed to write calls so far, or -1 if
+// that is not known. Writes to mapped files, which the blockfile backend does
+// for its index and block file headers, do not count.
+int64 GetProcessBytesWritten() {
+#if defined(OS_LINUX)
+  std::string io;
+  base::StringPairs pairs;
+  if (!base::ReadFileToString(base::FilePath("/proc/self/io"), &io) ||
+      !base::SplitStringIntoKeyValuePairs(io, ':', '\n', &pairs)) {
+    return -1;
+  }
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    std::string value;
+    int64 bytes = 0;
+    base::TrimWhitespaceASCII(pairs[i].second, base::TRIM_ALL, &value);
+    if (pairs[i].first == "wchar" && base::StringToInt64(value, &bytes))
+      return bytes;
+  }
+#endif
+  return -1;
+}
+
+// Runs the ops of |records| one after the other against a cache of |type| and
+// |backend_type| in |path|, each once the one before it is done.
+bool Replay(const std::vector<CacheTraceRecord>& records,
+            net::CacheType type,
+            net::BackendType backend_type,
+            const base::FilePath& path,
+            int max_size,
+            ReplayResult* result) {
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(base::MessageLoop::TYPE_IO, 0))) {
+    return false;
+  }
+  scoped_ptr<Backend> backend;
+  net::TestCompletionCallback cb;
+  int rv = CreateCacheBackend(type, backend_type, path, max_size, true,
+                              cache_thread.task_runner(), NULL, &backend,
+                              cb.callback());
+  if (cb.GetResult(rv) != net::OK) {
+    LOG(ERROR) << "Could not create the cache in " << path.value();
+    return false;
+  }
+
+  int buffer_size = 1;
+  for (size_t i = 0; i < records.size(); ++i)
+    buffer_size = std::max(buffer_size, records[i].size);
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(buffer_size));
+  for (int i = 0; i < buffer_size; ++i)
+    buffer->data()[i] = static_cast<char>(i * 7919);
+
+  std::map<uint32, Entry*> entries;
+  const int64 start_bytes_written = GetProcessBytesWritten();
+  const base::TimeTicks start_time = base::TimeTicks::Now();
+  for (size_t i = 0; i < records.size(); ++i) {
+    const CacheTraceRecord& record = records[i];
+    const CacheTraceOp op = static_cast<CacheTraceOp>(record.op);
+    Entry* entry = NULL;
+    if (op != CACHE_TRACE_OPEN && op != CACHE_TRACE_CREATE &&
+        op != CACHE_TRACE_DOOM && op != CACHE_TRACE_DOOM_ALL) {
+      std::map<uint32, Entry*>::iterator it = entries.find(record.entry_id);
+      if (it == entries.end()) {
+        ++result->skipped;
+        continue;
+      }
+      entry = it->second;
+      if (op == CACHE_TRACE_CLOSE)
+        entries.erase(it);
+    }
+    const int size = std::max(0, record.size);
+
+    const base::TimeTicks op_start_time = base::TimeTicks::Now();
+    switch (op) {
+      case CACHE_TRACE_OPEN:
+      case CACHE_TRACE_CREATE:
+        rv = op == CACHE_TRACE_OPEN
+                 ? backend->OpenEntry(GetKey(record), &entry, cb.callback())
+                 : backend->CreateEntry(GetKey(record), &entry, cb.callback());
+        rv = cb.GetResult(rv);
+        if (rv == net::OK) {
+          std::map<uint32, Entry*>::iterator it =
+              entries.find(record.entry_id);
+          if (it != entries.end())
+            it->second->Close();
+          entries[record.entry_id] = entry;
+        }
+        if (op == CACHE_TRACE_OPEN) {
+          ++result->opens;
+          result->open_hits += rv == net::OK;
+        }
+        break;
+      case CACHE_TRACE_DOOM:
+        cb.GetResult(backend->DoomEntry(GetKey(record), cb.callback()));
+        break;
+      case CACHE_TRACE_DOOM_ALL:
+        cb.GetResult(backend->DoomAllEntries(cb.callback()));
+        break;
+      case CACHE_TRACE_DOOM_ENTRY:
+        entry->Doom();
+        break;
+      case CACHE_TRACE_CLOSE:
+        entry->Close();
+        break;
+      case CACHE_TRACE_READ:
+        rv = cb.GetResult(entry->ReadData(record.stream_index,
+                                          static_cast<int>(record.offset),
+                                          buffer.get(), size, cb.callback()));
+        result->bytes_read += std::max(0, rv);
+        break;
+      case CACHE_TRACE_WRITE:
+        rv = cb.GetResult(entry->WriteData(
+            record.stream_index, static_cast<int>(record.offset), buffer.get(),
+            size, cb.callback(), record.truncate != 0));
+        result->bytes_written += std::max(0, rv);
+        break;
+      case CACHE_TRACE_READ_SPARSE:
+        rv = cb.GetResult(entry->ReadSparseData(record.offset, buffer.get(),
+                                                size, cb.callback()));
+        result->bytes_read += std::max(0, rv);
+        break;
+      case CACHE_TRACE_WRITE_SPARSE:
+        rv = cb.GetResult(entry->WriteSparseData(record.offset, buffer.get(),
+                                                 size, cb.callback()));
+        result->bytes_written += std::max(0, rv);
+        break;
+      case CACHE_TRACE_OP_MAX:
+        NOTREACHED();
+        break;
+    }
+    result->latencies_us[op].push_back(
+        (base::TimeTicks::Now() - op_start_time).InMicroseconds());
+  }
+  result->duration = base::TimeTicks::Now() - start_time;
+
+  for (std::map<uint32, Entry*>::iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    it->second->Close();
+  }
+  backend.reset();
+  base::RunLoop().RunUntilIdle();
+  SimpleBackendImpl::FlushWorkerPoolForTesting();
+  cache_thread.Stop();
+  const int64 end_bytes_written = GetProcessBytesWritten();
+  if (start_bytes_written >= 0 && end_bytes_written >= 0)
+    result->file_bytes_written = end_bytes_written - start_bytes_written;
+  if (type != net::MEMORY_CACHE)
+    result->disk_size = base::ComputeDirectorySize(path);
+  return true;
+}
+
+int64 GetPercentile(const std::vector<int64>& sorted_values, int percentile) {
+  return sorted_values[(sorted_values.size() - 1) * percentile / 100];
+}
+
+void PrintResult(const std::string& backend_name,
+                 const ReplayResult& result,
+                 bool on_disk) {
+  const double seconds = std::max(result.duration.InSecondsF(), 1e-6);
+  int64 ops = 0;
+  for (int op = 0; op < CACHE_TRACE_OP_MAX; ++op)
+    ops += result.latencies_us[op].size();
+  std::cout << backend_name << std::endl;
+  std::cout << base::StringPrintf(
+                   "  %lld ops in %.3f s, %.0f ops/s, %.2f MB/s read, "
+                   "%.2f MB/s written",
+                   static_cast<long long>(ops), seconds, ops / seconds,
+                   result.bytes_read / seconds / (1 << 20),
+                   result.bytes_written / seconds / (1 << 20))
+            << std::endl;
+  std::cout << base::StringPrintf(
+                   "  hit ratio %6.2f%% of %lld opens, %lld ops skipped",
+                   result.opens ? 100.0 * result.open_hits / result.opens
+                                : 0.0,
+                   static_cast<long long>(result.opens),
+                   static_cast<long long>(result.skipped))
+            << std::endl;
+  if (on_disk) {
+    std::cout << "  " << result.bytes_written << " bytes of data written, ";
+    if (result.file_bytes_written >= 0)
+      std::cout << result.file_bytes_written << " bytes written to files, ";
+    std::cout << result.disk_size << " bytes on disk at the end"
+              << std::endl;
+  }
+  std::cout << "  latency in us          count      p50      p90      p99"
+            << "      max" << std::endl;
+  for (int op = 0; op < CACHE_TRACE_OP_MAX; ++op) {
+    std::vector<int64> latencies_us = result.latencies_us[op];
+    if (latencies_us.empty())
+      continue;
+    std::sort(latencies_us.begin(), latencies_us.end());
+    std::cout << base::StringPrintf(
+                     "  %-18s %9llu %8lld %8lld %8lld %8lld", kOpNames[op],
+                     static_cast<unsigned long long>(latencies_us.size()),
+                     static_cast<long long>(GetPercentile(latencies_us, 50)),
+                     static_cast<long long>(GetPercentile(latencies_us, 90)),
+                     static_cast<long long>(GetPercentile(latencies_us, 99)),
+                     static_cast<long long>(latencies_us.back()))
+              << std::endl;
+  }
+}
+
+void PrintUsage(std::ostream* stream) {
+  *stream << "Usage: disk_cache_trace_replay --trace=<path> "
+          << "[--backend=<backend>] [--max-size=<bytes>] "
+          << "[--cache-dir=<path>]" << std::endl
+          << "  with <backend>='" << kBlockfileBackend << "'|'"
+          << kSimpleBackend << "'|'" << kMemoryBackend
+          << "', all of them by default" << std::endl
+          << "  The caches start empty, in a temporary directory unless "
+          << "--cache-dir is given." << std::endl;
+}
+
+bool Main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  base::MessageLoopForIO message_loop;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+  if (command_line.HasSwitch("help")) {
+    PrintUsage(&std::cout);
+    return true;
+  }
+  int max_size = 0;
+  if (!command_line.HasSwitch("trace") ||
+      (command_line.HasSwitch("max-size") &&
+       !base::StringToInt(command_line.GetSwitchValueASCII("max-size"),
+                          &max_size))) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+  const std::string backend = command_line.GetSwitchValueASCII("backend");
+  if (!backend.empty() && backend != kBlockfileBackend &&
+      backend != kSimpleBackend && backend != kMemoryBackend) {
+    PrintUsage(&std::cerr);
+    return false;
+  }
+
+  std::vector<CacheTraceRecord> records;
+  if (!ReadCacheTrace(command_line.GetSwitchValuePath("trace"), &records)) {
+    LOG(ERROR) << "Could not read the trace";
+    return false;
+  }
+  std::cout << records.size() << " records";
+  if (!records.empty()) {
+    std::cout << " over "
+              << base::TimeDelta::FromMicroseconds(records.back().time_us)
+                     .InSecondsF()
+              << " s";
+  }
+  std::cout << std::endl;
+
+  base::ScopedTempDir temp_dir;
+  base::FilePath cache_dir = command_line.GetSwitchValuePath("cache-dir");
+  if (cache_dir.empty()) {
+    if (!temp_dir.CreateUniqueTempDir())
+      return false;
+    cache_dir = temp_dir.path();
+  }
+
+  struct {
+    const char* name;
+    net::CacheType type;
+    net::BackendType backend_type;
+  } const kBackends[] = {
+      {kBlockfileBackend, net::DISK_CACHE, net::CACHE_BACKEND_BLOCKFILE},
+      {kSimpleBackend, net::DISK_CACHE, net::CACHE_BACKEND_SIMPLE},
+      {kMemoryBackend, net::MEMORY_CACHE, net::CACHE_BACKEND_DEFAULT},
+  };
+  for (size_t i = 0; i < arraysize(kBackends); ++i) {
+    if (!backend.empty() && backend != kBackends[i].name)
+      continue;
+    const base::FilePath path = cache_dir.AppendASCII(kBackends[i].name);
+    if (!base::DeleteFile(path, true)) {
+      LOG(ERROR) << "Could not empty " << path.value();
+      return false;
+    }
+    ReplayResult result;
+    if (!Replay(records, kBackends[i].type, kBackends[i].backend_type, path,
+                max_size, &result)) {
+      return false;
+    }
+    PrintResult(kBackends[i].name, result,
+                kBackends[i].type != net::MEMORY_CACHE);
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace disk_cache
+
+int main(int argc, char** argv) {
+  return !disk_cache::Main(argc, argv);
+}
@@ -0,0 +1,92 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/flip_server/acceptor_thread.h"
+
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "net/tools/flip_server/flip_config.h"
+#include "net/tools/flip_server/mem_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+class FlipAcceptorThreadTest : public ::testing::Test {
+ public:
+  FlipAcceptorThreadTest()
+      : acceptor_(FLIP_HANDLER_HTTP_SERVER,
+                  "127.0.0.1",
+                  "8944",
+                  "",
+                  "",
+                  "127.0.0.1",
+                  "8945",
+                  "127.0.0.1",
+                  "8946",
+                  1,
+                  0,
+                  false,
+                  1,
+                  false,
+                  true,
+                  NULL) {
+    acceptor_.idle_socket_timeout_s_ = 1;
+  }
+
+  void TearDown() override {
+    if (acceptor_.listen_fd_ >= 0) {
+      close(acceptor_.listen_fd_);
+      acceptor_.listen_fd_ = -1;
+    }
+  }
+
+  // Hands one end of a new socket pair to |thread| as an accepted connection
+  // and returns the other end.
+  int AddConnection(SMAcceptorThread* thread) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      return -1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    thread->HandleConnection(fds[0], &address);
+    return fds[1];
+  }
+
+  // Returns true once the connection at the other end of |fd| is closed.
+  static bool PeerClosed(int fd) {
+    char c;
+    return recv(fd, &c, 1, MSG_DONTWAIT) == 0;
+  }
+
+ protected:
+  FlipAcceptor acceptor_;
+  MemoryCache memory_cache_;
+};
+
+TEST_F(FlipAcceptorThreadTest, IdleTimeoutClockIsPerThread) {
+  SMAcceptorThread busy(&acceptor_, &memory_cache_);
+  SMAcceptorThread idle(&acceptor_, &memory_cache_);
+  int peer = AddConnection(&busy);
+  ASSERT_NE(-1, peer);
+
+  base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(2));
+  // A thread without connections must not move the clock of another thread
+  // forward past that thread's idle connection.
+  idle.HandleConnectionIdleTimeout();
+  busy.HandleConnectionIdleTimeout();
+  EXPECT_TRUE(PeerClosed(peer));
+  close(peer);
+}
+
+}  // namespace
+
+}  // namespace net
@@ -13,8 +13,10 @@
 
 #include "base/command_line.h"
 #include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_split.h"
 #include "base/synchronization/lock.h"
+#include "base/sys_info.h"
 #include "net/tools/balsa/split.h"
 #include "net/tools/flip_server/acceptor_thread.h"
 #include "net/tools/flip_server/constants.h"
@@ -43,6 +45,11 @@ int32 FLAGS_accept_backlog_size = 1024;
 //  SO_REUSEPORT);
 bool FLAGS_reuseport = false;
 
+// The number of acceptor threads, each with its own SO_REUSEPORT listening
+//  socket and epoll server, to run for every listener. Zero runs one per
+//  core. Values above one imply reuseport);
+int32 FLAGS_acceptor_threads = 1;
+
 // Flag to force spdy, even if NPN is not negotiated.
 bool FLAGS_force_spdy = false;
 
@@ -182,6 +189,10 @@ int main(int argc, char** argv) {
         "\t--ssl-session-expiry=<seconds> (default is 300)\n"
         "\t--ssl-disable-compression\n"
         "\t--idle-timeout=<seconds> (default is 300)\n"
+        "\t--acceptor-threads=<n> (default is 1)\n"
+        "\t  * Runs n accept threads per listen ip:port, each with its own"
+        " socket\n"
+        "\t    using SO_REUSEPORT. 0 runs one per core.\n"
         "\t--pidfile=<filepath> (default /var/run/flip-server.pid)\n"
         "\t--help\n");
     exit(0);
@@ -247,6 +258,19 @@ int main(int argc, char** argv) {
   if (cl.HasSwitch("force_spdy"))
     net::SMConnection::set_force_spdy(true);
 
+  if (cl.HasSwitch("acceptor-threads")) {
+    if (!base::StringToInt(cl.GetSwitchValueASCII("acceptor-threads"),
+                           &FLAGS_acceptor_threads) ||
+        FLAGS_acceptor_threads < 0) {
+      LOG(FATAL) << "Invalid acceptor thread count: "
+                 << cl.GetSwitchValueASCII("acceptor-threads");
+    }
+  }
+  if (FLAGS_acceptor_threads == 0)
+    FLAGS_acceptor_threads = base::SysInfo::NumberOfProcessors();
+  if (FLAGS_acceptor_threads > 1)
+    FLAGS_reuseport = true;
+
   logging::LoggingSettings settings;
   settings.logging_dest = g_proxy_config.log_destination_;
   settings.log_file = g_proxy_config.log_filename_.c_str();
@@ -268,6 +292,7 @@ int main(int argc, char** argv) {
                                                                     : "false");
   LOG(INFO) << "Reuseport               : " << (FLAGS_reuseport ? "true"
                                                                 : "false");
+  LOG(INFO) << "Acceptor threads        : " << FLAGS_acceptor_threads;
   LOG(INFO) << "Force SPDY              : " << (FLAGS_force_spdy ? "true"
                                                                  : "false");
   LOG(INFO) << "SSL session expiry      : "
@@ -292,22 +317,24 @@ int main(int argc, char** argv) {
     int spdy_only = atoi(valueArgs[8].c_str());
     // If wait_for_iface is enabled, then this call will block
     // indefinitely until the interface is raised.
-    g_proxy_config.AddAcceptor(net::FLIP_HANDLER_PROXY,
-                               valueArgs[0],
-                               valueArgs[1],
-                               valueArgs[2],
-                               valueArgs[3],
-                               valueArgs[4],
-                               valueArgs[5],
-                               valueArgs[6],
-                               valueArgs[7],
-                               spdy_only,
-                               FLAGS_accept_backlog_size,
-                               FLAGS_disable_nagle,
-                               FLAGS_accepts_per_wake,
-                               FLAGS_reuseport,
-                               wait_for_iface,
-                               NULL);
+    for (int t = 0; t < FLAGS_acceptor_threads; ++t) {
+      g_proxy_config.AddAcceptor(net::FLIP_HANDLER_PROXY,
+                                 valueArgs[0],
+                                 valueArgs[1],
+                                 valueArgs[2],
+                                 valueArgs[3],
+                                 valueArgs[4],
+                                 valueArgs[5],
+                                 valueArgs[6],
+                                 valueArgs[7],
+                                 spdy_only,
+                                 FLAGS_accept_backlog_size,
+                                 FLAGS_disable_nagle,
+                                 FLAGS_accepts_per_wake,
+                                 FLAGS_reuseport,
+                                 wait_for_iface,
+                                 NULL);
+    }
   }
 
   // Spdy Server Acceptor
@@ -319,22 +346,24 @@ int main(int argc, char** argv) {
     base::SplitString(value, ',', &valueArgs);
     while (valueArgs.size() < 4)
       valueArgs.push_back(std::string());
-    g_proxy_config.AddAcceptor(net::FLIP_HANDLER_SPDY_SERVER,
-                               valueArgs[0],
-                               valueArgs[1],
-                               valueArgs[2],
-                               valueArgs[3],
-                               std::string(),
-                               std::string(),
-                               std::string(),
-                               std::string(),
-                               0,
-                               FLAGS_accept_backlog_size,
-                               FLAGS_disable_nagle,
-                               FLAGS_accepts_per_wake,
-                               FLAGS_reuseport,
-                               wait_for_iface,
-                               &spdy_memory_cache);
+    for (int t = 0; t < FLAGS_acceptor_threads; ++t) {
+      g_proxy_config.AddAcceptor(net::FLIP_HANDLER_SPDY_SERVER,
+                                 valueArgs[0],
+                                 valueArgs[1],
+                                 valueArgs[2],
+                                 valueArgs[3],
+                                 std::string(),
+                                 std::string(),
+                                 std::string(),
+                                 std::string(),
+                                 0,
+                                 FLAGS_accept_backlog_size,
+                                 FLAGS_disable_nagle,
+                                 FLAGS_accepts_per_wake,
+                                 FLAGS_reuseport,
+                                 wait_for_iface,
+                                 &spdy_memory_cache);
+    }
   }
 
   // Spdy Server Acceptor
@@ -346,22 +375,24 @@ int main(int argc, char** argv) {
     base::SplitString(value, ',', &valueArgs);
     while (valueArgs.size() < 4)
       valueArgs.push_back(std::string());
-    g_proxy_config.AddAcceptor(net::FLIP_HANDLER_HTTP_SERVER,
-                               valueArgs[0],
-                               valueArgs[1],
-                               valueArgs[2],
-                               valueArgs[3],
-                               std::string(),
-                               std::string(),
-                               std::string(),
-                               std::string(),
-                               0,
-                               FLAGS_accept_backlog_size,
-                               FLAGS_disable_nagle,
-                               FLAGS_accepts_per_wake,
-                               FLAGS_reuseport,
-                               wait_for_iface,
-                               &http_memory_cache);
+    for (int t = 0; t < FLAGS_acceptor_threads; ++t) {
+      g_proxy_config.AddAcceptor(net::FLIP_HANDLER_HTTP_SERVER,
+                                 valueArgs[0],
+                                 valueArgs[1],
+                                 valueArgs[2],
+                                 valueArgs[3],
+                                 std::string(),
+                                 std::string(),
+                                 std::string(),
+                                 std::string(),
+                                 0,
+                                 FLAGS_accept_backlog_size,
+                                 FLAGS_disable_nagle,
+                                 FLAGS_accepts_per_wake,
+                                 FLAGS_reuseport,
+                                 wait_for_iface,
+                                 &http_memory_cache);
+    }
   }
 
   std::vector<net::SMAcceptorThread*> sm_worker_threads_;
@@ -371,13 +402,8 @@ int main(int argc, char** argv) {
 
     sm_worker_threads_.push_back(new net::SMAcceptorThread(
         acceptor, (net::MemoryCache*)acceptor->memory_cache_));
-    // Note that spdy_memory_cache is not threadsafe, it is merely
-    // thread compatible. Thus, if ever we are to spawn multiple threads,
-    // we either must make the MemoryCache threadsafe, or use
-    // a separate MemoryCache for each thread.
-    //
-    // The latter is what is currently being done as we spawn
-    // a separate thread for each http and spdy server acceptor.
+    // The acceptors of a listener share its MemoryCache, whose lookups are
+    // threadsafe. Each thread owns its EpollServer and connections.
 
     sm_worker_threads_.back()->InitWorker();
     sm_worker_threads_.back()->Start();
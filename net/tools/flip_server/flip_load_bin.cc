@@ -0,0 +1,458 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A load generator for flip_in_mem_edsm_server. It runs --clients client
+// threads, each on its own keep-alive connection to --server:--port, which
+// fetch --path over and over for --duration seconds. It then reports the
+// responses and body bytes received per second. With --spdy the clients speak
+// SPDY/3 rather than HTTP/1.1 and keep --streams requests in flight on their
+// connection; start the server with --force_spdy to accept SPDY without SSL.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/tools/balsa/balsa_frame.h"
+#include "net/tools/balsa/balsa_headers.h"
+#include "net/tools/balsa/noop_balsa_visitor.h"
+
+using std::cout;
+using std::endl;
+
+// The numeric address of the server.
+std::string FLAGS_server = "127.0.0.1";
+// The port of the server.
+int32 FLAGS_port = 0;
+// The host to request from. Defaults to --server.
+std::string FLAGS_host;
+// The path to request.
+std::string FLAGS_path = "/";
+// The number of client threads, and so of connections.
+int32 FLAGS_clients = 8;
+// How long to generate load for, in seconds.
+int32 FLAGS_duration = 10;
+// If true, the clients speak SPDY/3 rather than HTTP/1.1.
+bool FLAGS_spdy = false;
+// The number of requests each SPDY client keeps in flight.
+int32 FLAGS_streams = 8;
+
+namespace {
+
+const size_t kReadBufferSize = 64 * 1024;
+
+// Returns a connected, blocking socket, or -1.
+int ConnectToServer() {
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(FLAGS_port);
+  if (inet_pton(AF_INET, FLAGS_server.c_str(), &address.sin_addr) != 1)
+    return -1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return fd;
+}
+
+bool WriteAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t rv = write(fd, data, len);
+    if (rv < 0 && errno == EINTR)
+      continue;
+    if (rv <= 0)
+      return false;
+    data += rv;
+    len -= rv;
+  }
+  return true;
+}
+
+// Fetches from the server over one connection at a time, reconnecting when
+// the server closes it. Counters are read only after the thread is joined.
+class LoadClient : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit LoadClient(const base::CancellationFlag* stop)
+      : stop_(stop),
+        responses_(0),
+        errors_(0),
+        body_bytes_(0),
+        failures_(0) {}
+  ~LoadClient() override {}
+
+  void Run() override {
+    while (!stop_->IsSet()) {
+      int fd = ConnectToServer();
+      if (fd < 0) {
+        ++failures_;
+        base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(10));
+        continue;
+      }
+      if (!RunConnection(fd))
+        ++failures_;
+      close(fd);
+    }
+  }
+
+  int64 responses() const { return responses_; }
+  int64 errors() const { return errors_; }
+  int64 body_bytes() const { return body_bytes_; }
+  int64 failures() const { return failures_; }
+
+ protected:
+  // Sends requests on |fd| until |stop_| is set. Returns false if the
+  // connection failed.
+  virtual bool RunConnection(int fd) = 0;
+
+  const base::CancellationFlag* stop_;
+  // Complete responses, and those of them which weren't successful.
+  int64 responses_;
+  int64 errors_;
+  int64 body_bytes_;
+  // Connections which failed or were closed by the server.
+  int64 failures_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LoadClient);
+};
+
+class HttpResponseVisitor : public net::NoOpBalsaVisitor {
+ public:
+  HttpResponseVisitor() : done_(false), error_(false), body_bytes_(0) {}
+  ~HttpResponseVisitor() override {}
+
+  void Reset() {
+    done_ = false;
+    error_ = false;
+    body_bytes_ = 0;
+  }
+
+  // net::NoOpBalsaVisitor:
+  void ProcessBodyData(const char* input, size_t size) override {
+    body_bytes_ += size;
+  }
+  void MessageDone() override { done_ = true; }
+  void HandleHeaderError(net::BalsaFrame* framer) override { error_ = true; }
+  void HandleChunkingError(net::BalsaFrame* framer) override { error_ = true; }
+  void HandleBodyError(net::BalsaFrame* framer) override { error_ = true; }
+
+  bool done() const { return done_; }
+  bool error() const { return error_; }
+  size_t body_bytes() const { return body_bytes_; }
+
+ private:
+  bool done_;
+  bool error_;
+  size_t body_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpResponseVisitor);
+};
+
+// Issues one HTTP/1.1 GET at a time on a keep-alive connection.
+class HttpLoadClient : public LoadClient {
+ public:
+  explicit HttpLoadClient(const base::CancellationFlag* stop)
+      : LoadClient(stop) {
+    request_ = "GET " + FLAGS_path + " HTTP/1.1\r\n" +
+               "Host: " + FLAGS_host + "\r\n" +
+               "Connection: keep-alive\r\n\r\n";
+  }
+  ~HttpLoadClient() override {}
+
+ protected:
+  bool RunConnection(int fd) override {
+    net::BalsaHeaders headers;
+    HttpResponseVisitor visitor;
+    net::BalsaFrame framer;
+    framer.set_is_request(false);
+    framer.set_balsa_headers(&headers);
+    framer.set_balsa_visitor(&visitor);
+    scoped_ptr<char[]> buffer(new char[kReadBufferSize]);
+    while (!stop_->IsSet()) {
+      framer.Reset();
+      visitor.Reset();
+      if (!WriteAll(fd, request_.data(), request_.size()))
+        return false;
+      while (!visitor.done()) {
+        ssize_t rv = read(fd, buffer.get(), kReadBufferSize);
+        if (rv < 0 && errno == EINTR)
+          continue;
+        if (rv <= 0)
+          return false;
+        framer.ProcessInput(buffer.get(), rv);
+        if (framer.Error() || visitor.error())
+          return false;
+      }
+      ++responses_;
+      if (headers.parsed_response_code() != 200)
+        ++errors_;
+      body_bytes_ += visitor.body_bytes();
+    }
+    return true;
+  }
+
+ private:
+  std::string request_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpLoadClient);
+};
+
+// Keeps --streams SPDY/3 GETs in flight on a connection.
+class SpdyLoadClient : public LoadClient,
+                       public net::BufferedSpdyFramerVisitorInterface {
+ public:
+  explicit SpdyLoadClient(const base::CancellationFlag* stop)
+      : LoadClient(stop), in_flight_(0), error_(false) {
+    headers_[":method"] = "GET";
+    headers_[":path"] = FLAGS_path;
+    headers_[":version"] = "HTTP/1.1";
+    headers_[":host"] = FLAGS_host;
+    headers_[":scheme"] = "http";
+  }
+  ~SpdyLoadClient() override {}
+
+  // net::BufferedSpdyFramerVisitorInterface:
+  void OnError(net::SpdyFramer::SpdyError error_code) override {
+    error_ = true;
+  }
+  void OnStreamError(net::SpdyStreamId stream_id,
+                     const std::string& description) override {
+    error_ = true;
+  }
+  void OnSynStream(net::SpdyStreamId stream_id,
+                   net::SpdyStreamId associated_stream_id,
+                   net::SpdyPriority priority,
+                   bool fin,
+                   bool unidirectional,
+                   const net::SpdyHeaderBlock& headers) override {}
+  void OnSynReply(net::SpdyStreamId stream_id,
+                  bool fin,
+                  const net::SpdyHeaderBlock& headers) override {
+    net::SpdyHeaderBlock::const_iterator status = headers.find(":status");
+    if (status == headers.end() || status->second.compare(0, 3, "200") != 0)
+      ++errors_;
+    if (fin)
+      OnStreamDone();
+  }
+  void OnHeaders(net::SpdyStreamId stream_id,
+                 bool has_priority,
+                 net::SpdyPriority priority,
+                 bool fin,
+                 const net::SpdyHeaderBlock& headers) override {}
+  void OnDataFrameHeader(net::SpdyStreamId stream_id,
+                         size_t length,
+                         bool fin) override {}
+  void OnStreamFrameData(net::SpdyStreamId stream_id,
+                         const char* data,
+                         size_t len,
+                         bool fin) override {
+    body_bytes_ += len;
+    if (fin)
+      OnStreamDone();
+  }
+  void OnStreamPadding(net::SpdyStreamId stream_id, size_t len) override {}
+  void OnSettings(bool clear_persisted) override {}
+  void OnSetting(net::SpdySettingsIds id, uint8 flags, uint32 value) override {
+  }
+  void OnPing(net::SpdyPingId unique_id, bool is_ack) override {}
+  void OnRstStream(net::SpdyStreamId stream_id,
+                   net::SpdyRstStreamStatus status) override {
+    ++errors_;
+    OnStreamDone();
+  }
+  void OnGoAway(net::SpdyStreamId last_accepted_stream_id,
+                net::SpdyGoAwayStatus status) override {
+    error_ = true;
+  }
+  void OnWindowUpdate(net::SpdyStreamId stream_id,
+                      uint32 delta_window_size) override {}
+  void OnPushPromise(net::SpdyStreamId stream_id,
+                     net::SpdyStreamId promised_stream_id,
+                     const net::SpdyHeaderBlock& headers) override {}
+  bool OnUnknownFrame(net::SpdyStreamId stream_id, int frame_type) override {
+    return false;
+  }
+
+ protected:
+  bool RunConnection(int fd) override {
+    net::BufferedSpdyFramer framer(net::SPDY3, true);
+    framer.set_visitor(this);
+    in_flight_ = 0;
+    error_ = false;
+    net::SpdyStreamId stream_id = 1;
+    scoped_ptr<char[]> buffer(new char[kReadBufferSize]);
+    while (!stop_->IsSet()) {
+      while (in_flight_ < FLAGS_streams) {
+        scoped_ptr<net::SpdyFrame> frame(framer.CreateSynStream(
+            stream_id, 0, 0, net::CONTROL_FLAG_FIN, &headers_));
+        if (!WriteAll(fd, frame->data(), frame->size()))
+          return false;
+        stream_id += 2;
+        ++in_flight_;
+      }
+      ssize_t rv = read(fd, buffer.get(), kReadBufferSize);
+      if (rv < 0 && errno == EINTR)
+        continue;
+      if (rv <= 0)
+        return false;
+      framer.ProcessInput(buffer.get(), rv);
+      if (error_)
+        return false;
+    }
+    return true;
+  }
+
+ private:
+  void OnStreamDone() {
+    ++responses_;
+    --in_flight_;
+  }
+
+  net::SpdyHeaderBlock headers_;
+  int in_flight_;
+  bool error_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyLoadClient);
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help") ||
+      !line->HasSwitch("port")) {
+    const char* help_str =
+        "Usage: flip_load --port=<port> [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help                  show this help message and exit\n"
+        "--server=<ip>               numeric address of the server, "
+        "127.0.0.1 if not set\n"
+        "--port=<port>               port of the server\n"
+        "--host=<host>               host to request from, the server "
+        "address if not set\n"
+        "--path=<path>               path to request\n"
+        "--clients=<clients>         number of client threads and "
+        "connections\n"
+        "--duration=<seconds>        how long to generate load for\n"
+        "--spdy                      speak SPDY/3 rather than HTTP/1.1\n"
+        "--streams=<streams>         requests in flight per SPDY "
+        "connection\n";
+    cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("server"))
+    FLAGS_server = line->GetSwitchValueASCII("server");
+  if (!base::StringToInt(line->GetSwitchValueASCII("port"), &FLAGS_port)) {
+    LOG(ERROR) << "--port must be an integer\n";
+    return 1;
+  }
+  FLAGS_host = FLAGS_server;
+  if (line->HasSwitch("host"))
+    FLAGS_host = line->GetSwitchValueASCII("host");
+  if (line->HasSwitch("path"))
+    FLAGS_path = line->GetSwitchValueASCII("path");
+  if (line->HasSwitch("clients")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("clients"),
+                           &FLAGS_clients)) {
+      LOG(ERROR) << "--clients must be an integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("duration")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("duration"),
+                           &FLAGS_duration)) {
+      LOG(ERROR) << "--duration must be an integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("spdy"))
+    FLAGS_spdy = true;
+  if (line->HasSwitch("streams")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("streams"),
+                           &FLAGS_streams)) {
+      LOG(ERROR) << "--streams must be an integer\n";
+      return 1;
+    }
+  }
+
+  base::CancellationFlag stop;
+  ScopedVector<LoadClient> clients;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    if (FLAGS_spdy) {
+      clients.push_back(new SpdyLoadClient(&stop));
+    } else {
+      clients.push_back(new HttpLoadClient(&stop));
+    }
+    threads.push_back(new base::DelegateSimpleThread(
+        clients.back(), "flip_load_client_" + base::IntToString(i)));
+    threads.back()->Start();
+  }
+
+  base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(FLAGS_duration));
+  stop.Set();
+  // Clients blocked in read() finish with their next response.
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+  const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+
+  int64 responses = 0;
+  int64 errors = 0;
+  int64 body_bytes = 0;
+  int64 failures = 0;
+  for (size_t i = 0; i < clients.size(); ++i) {
+    responses += clients[i]->responses();
+    errors += clients[i]->errors();
+    body_bytes += clients[i]->body_bytes();
+    failures += clients[i]->failures();
+  }
+
+  cout << "protocol: " << (FLAGS_spdy ? "spdy/3" : "http/1.1")
+       << " clients: " << FLAGS_clients << " seconds: " << seconds;
+  if (FLAGS_spdy)
+    cout << " streams: " << FLAGS_streams;
+  cout << endl;
+  cout << "responses: " << responses << " not ok: " << errors
+       << " body bytes: " << body_bytes << " failed connections: " << failures
+       << endl;
+  cout << "responses/s: " << responses / seconds
+       << " body MB/s: " << body_bytes / seconds / (1024 * 1024) << endl;
+  return 0;
+}
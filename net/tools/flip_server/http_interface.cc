@@ -156,7 +156,9 @@ void HttpSM::ResetForNewConnection() {
   }
   // Message has not been fully read, either it is incomplete or the
   // server is closing the connection to signal message end.
-  if (!MessageFullyRead()) {
+  // There is no spdy side to notify when serving HTTP, where an unread
+  // message is just the client closing a keep-alive connection.
+  if (!MessageFullyRead() && sm_spdy_interface_) {
     VLOG(2) << "HTTP response closed before end of file detected. "
             << "Sending EOF to spdy.";
     sm_spdy_interface_->SendEOF(stream_id_);
@@ -293,6 +295,31 @@ void HttpSM::SendDataFrameImpl(uint32 stream_id,
   EnqueueDataFrame(df);
 }
 
+void HttpSM::SendCachedDataFrameImpl(const char* data, size_t len) {
+  char chunk_buf[128];
+  int chunk_len = snprintf(
+      chunk_buf, sizeof(chunk_buf), "%x\r\n", (unsigned int)len);
+  DataFrame* df = new DataFrame;
+  df->size = chunk_len;
+  char* buffer = new char[df->size];
+  df->data = buffer;
+  df->delete_when_done = true;
+  memcpy(buffer, chunk_buf, chunk_len);
+  EnqueueDataFrame(df);
+
+  df = new DataFrame;
+  df->data = data;
+  df->size = len;
+  df->delete_when_done = false;
+  EnqueueDataFrame(df);
+
+  df = new DataFrame;
+  df->data = "\r\n";
+  df->size = 2;
+  df->delete_when_done = false;
+  EnqueueDataFrame(df);
+}
+
 void HttpSM::EnqueueDataFrame(DataFrame* df) {
   VLOG(2) << ACCEPTOR_CLIENT_IDENT << "HttpSM: Enqueue data frame: stream "
           << stream_id_;
@@ -326,11 +353,9 @@ void HttpSM::GetOutput() {
   if (num_to_write > mci->max_segment_size)
     num_to_write = mci->max_segment_size;
 
-  SendDataFrame(mci->stream_id,
-                mci->file_data->body().data() + mci->body_bytes_consumed,
-                num_to_write,
-                0,
-                true);
+  // The body is owned by |memory_cache_|, which outlives this connection.
+  SendCachedDataFrameImpl(
+      mci->file_data->body().data() + mci->body_bytes_consumed, num_to_write);
   VLOG(2) << ACCEPTOR_CLIENT_IDENT << "HttpSM: GetOutput SendDataFrame["
           << mci->stream_id << "]: " << num_to_write;
   mci->body_bytes_consumed += num_to_write;
@@ -117,6 +117,9 @@ class HttpSM : public BalsaVisitorInterface, public SMInterface {
                          int64 len,
                          uint32 flags,
                          bool compress);
+  // Like SendDataFrameImpl(), but frames |data| in place rather than copying
+  // it. |data| must outlive the connection, as cached bodies do.
+  void SendCachedDataFrameImpl(const char* data, size_t len);
   void EnqueueDataFrame(DataFrame* df);
   void GetOutput() override;
 
@@ -317,6 +317,38 @@ TEST_F(FlipHttpSMTest, SendErrorNotFound) {
   ASSERT_FALSE(HasStream(stream_id));
 }
 
+TEST_F(FlipHttpSMTest, GetOutputSendsCachedBodyInPlace) {
+  uint32 stream_id = 13;
+  MemCacheIter mci;
+  mci.stream_id = stream_id;
+  mci.transformed_header = true;
+
+  {
+    BalsaHeaders headers;
+    std::string filename = "foobar";
+    memory_cache_->InsertFile(&headers, filename, "hello");
+    mci.file_data = memory_cache_->GetFileData(filename);
+  }
+  interface_->AddToOutputOrder(mci);
+  // Let the zero think time alarm mark the stream ready to send.
+  epoll_server_->set_timeout_in_us(0);
+  epoll_server_->WaitForEventsAndExecuteCallbacks();
+  SMInterface* sm_interface = interface_.get();
+  sm_interface->GetOutput();
+
+  // The chunk framing surrounds the cached body itself.
+  ASSERT_EQ(3u, connection_->output_list()->size());
+  std::list<DataFrame*>::const_iterator i = connection_->output_list()->begin();
+  DataFrame* df = *i++;
+  ASSERT_EQ("5\r\n", StringPiece(df->data, df->size));
+  df = *i++;
+  ASSERT_EQ(mci.file_data->body().data(), df->data);
+  ASSERT_EQ("hello", StringPiece(df->data, df->size));
+  ASSERT_FALSE(df->delete_when_done);
+  df = *i++;
+  ASSERT_EQ("\r\n", StringPiece(df->data, df->size));
+}
+
 TEST_F(FlipHttpSMTest, SendSynStream) {
   std::string expected =
       "GET / HTTP/1.0\r\n"
@@ -448,6 +480,17 @@ TEST_F(FlipHttpSMHttpTest, SendEOF) {
   ASSERT_EQ("0\r\n\r\n", StringPiece(df->data, df->size));
 }
 
+TEST_F(FlipHttpSMHttpTest, ResetForNewConnectionWithoutSpdyInterface) {
+  // An HTTP server connection has no spdy side; see
+  // SMConnection::SetupProtocolInterfaces().
+  HttpSM http_sm(connection_.get(), NULL, memory_cache_.get(), acceptor_.get());
+  // The client closes a keep-alive connection part way through a request.
+  std::string data = "GET /index.html HTTP/1.1\r\nHost: exa";
+  http_sm.ProcessReadInput(data.data(), data.size());
+  ASSERT_FALSE(http_sm.MessageFullyRead());
+  http_sm.ResetForNewConnection();
+}
+
 // --
 // FlipHttpSMSpdyTest
 
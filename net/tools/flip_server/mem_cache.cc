@@ -13,7 +13,6 @@
 #include <unistd.h>
 
 #include <deque>
-#include <map>
 #include <string>
 
 #include "base/strings/string_util.h"
@@ -64,18 +63,36 @@ FileData::FileData() {}
 
 FileData::~FileData() {}
 
-MemoryCache::MemoryCache() : cwd_(FLAGS_cache_base_dir) {}
+MemoryCache::MemoryCache() : files_(0), cwd_(FLAGS_cache_base_dir) {
+  snapshots_.push_back(new Files);
+  base::subtle::Release_Store(
+      &files_, reinterpret_cast<base::subtle::AtomicWord>(snapshots_.back()));
+}
 
-MemoryCache::~MemoryCache() { ClearFiles(); }
+MemoryCache::~MemoryCache() {}
 
 void MemoryCache::CloneFrom(const MemoryCache& mc) {
   DCHECK_NE(this, &mc);
-  ClearFiles();
-  files_ = mc.files_;
+  base::AutoLock lock(lock_);
   cwd_ = mc.cwd_;
+  Files* files = new Files;
+  snapshots_.push_back(files);
+  const Files* source_files = mc.files();
+  for (Files::const_iterator i = source_files->begin();
+       i != source_files->end();
+       ++i) {
+    FileData* source = i->second;
+    FileData* data =
+        new FileData(source->headers(), source->filename(), source->body());
+    file_data_.push_back(data);
+    (*files)[data->filename()] = data;
+  }
+  base::subtle::Release_Store(
+      &files_, reinterpret_cast<base::subtle::AtomicWord>(files));
 }
 
 void MemoryCache::AddFiles() {
+  ScopedVector<FileData> file_data;
   std::deque<std::string> paths;
   paths.push_back(cwd_ + "/GET_");
   DIR* current_dir = NULL;
@@ -100,7 +117,9 @@ void MemoryCache::AddFiles() {
               current_dir_name + "/" + dir_data->d_name;
           if (dir_data->d_type == DT_REG) {
             VLOG(1) << "Found file: " << current_entry_name;
-            ReadAndStoreFileContents(current_entry_name.c_str());
+            FileData* data = ReadFileData(current_entry_name.c_str());
+            if (data)
+              file_data.push_back(data);
           } else if (dir_data->d_type == DT_DIR) {
             VLOG(1) << "Found subdir: " << current_entry_name;
             if (std::string(dir_data->d_name) != "." &&
@@ -116,6 +135,7 @@ void MemoryCache::AddFiles() {
       }
     }
   }
+  InsertFiles(&file_data);
 }
 
 void MemoryCache::ReadToString(const char* filename, std::string* output) {
@@ -135,6 +155,15 @@ void MemoryCache::ReadToString(const char* filename, std::string* output) {
 }
 
 void MemoryCache::ReadAndStoreFileContents(const char* filename) {
+  FileData* data = ReadFileData(filename);
+  if (!data)
+    return;
+  ScopedVector<FileData> file_data;
+  file_data.push_back(data);
+  InsertFiles(&file_data);
+}
+
+FileData* MemoryCache::ReadFileData(const char* filename) {
   StoreBodyAndHeadersVisitor visitor;
   BalsaFrame framer;
   framer.set_balsa_visitor(&visitor);
@@ -157,9 +186,9 @@ void MemoryCache::ReadAndStoreFileContents(const char* filename) {
                     " framing file: " << filename;
       if (framer.Error()) {
         LOG(INFO) << "********************************************ERROR!";
-        return;
+        return NULL;
       }
-      return;
+      return NULL;
     }
     if (framer.MessageFullyRead()) {
       // If no Content-Length or Transfer-Encoding was captured in the
@@ -194,23 +223,21 @@ void MemoryCache::ReadAndStoreFileContents(const char* filename) {
   std::string filename_stripped = std::string(filename).substr(cwd_.size() + 1);
   LOG(INFO) << "Adding file (" << visitor.body.length()
             << " bytes): " << filename_stripped;
-  size_t slash_pos = filename_stripped.find('/');
-  if (slash_pos == std::string::npos) {
-    slash_pos = filename_stripped.size();
-  }
-  InsertFile(
-      &visitor.headers, filename_stripped.substr(0, slash_pos), visitor.body);
+  // Requests are looked up by their path beneath the cache directory, e.g.
+  // "GET_/index.html"; see EncodeURL().
+  return new FileData(&visitor.headers, filename_stripped, visitor.body);
 }
 
 FileData* MemoryCache::GetFileData(const std::string& filename) {
-  Files::iterator fi = files_.end();
+  const Files* files = this->files();
+  Files::const_iterator fi = files->end();
   if (EndsWith(filename, ".html", true)) {
-    fi = files_.find(filename.substr(0, filename.size() - 5) + ".http");
+    fi = files->find(filename.substr(0, filename.size() - 5) + ".http");
   }
-  if (fi == files_.end())
-    fi = files_.find(filename);
+  if (fi == files->end())
+    fi = files->find(filename);
 
-  if (fi == files_.end()) {
+  if (fi == files->end()) {
     return NULL;
   }
   return fi->second;
@@ -229,24 +256,31 @@ bool MemoryCache::AssignFileData(const std::string& filename,
 void MemoryCache::InsertFile(const BalsaHeaders* headers,
                              const std::string& filename,
                              const std::string& body) {
-  InsertFile(new FileData(headers, filename, body));
+  ScopedVector<FileData> file_data;
+  file_data.push_back(new FileData(headers, filename, body));
+  InsertFiles(&file_data);
 }
 
-void MemoryCache::InsertFile(FileData* file_data) {
-  Files::iterator it = files_.find(file_data->filename());
-  if (it != files_.end()) {
-    delete it->second;
-    it->second = file_data;
-  } else {
-    files_.insert(std::make_pair(file_data->filename(), file_data));
+void MemoryCache::InsertFiles(ScopedVector<FileData>* file_data) {
+  if (file_data->empty())
+    return;
+  base::AutoLock lock(lock_);
+  Files* files = new Files(*snapshots_.back());
+  snapshots_.push_back(files);
+  for (size_t i = 0; i < file_data->size(); ++i) {
+    FileData* data = (*file_data)[i];
+    (*files)[data->filename()] = data;
+    file_data_.push_back(data);
   }
+  file_data->weak_clear();
+  // Readers pick up the new snapshot on their next lookup; the one they may
+  // still be reading stays in |snapshots_|.
+  base::subtle::Release_Store(
+      &files_, reinterpret_cast<base::subtle::AtomicWord>(files));
 }
 
-void MemoryCache::ClearFiles() {
-  for (Files::const_iterator i = files_.begin(); i != files_.end(); ++i) {
-    delete i->second;
-  }
-  files_.clear();
+const MemoryCache::Files* MemoryCache::files() const {
+  return reinterpret_cast<const Files*>(base::subtle::Acquire_Load(&files_));
 }
 
 }  // namespace net
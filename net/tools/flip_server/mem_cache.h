@@ -5,11 +5,14 @@
 #ifndef NET_TOOLS_FLIP_SERVER_MEM_CACHE_H_
 #define NET_TOOLS_FLIP_SERVER_MEM_CACHE_H_
 
-#include <map>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/compiler_specific.h"
+#include "base/containers/hash_tables.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
 #include "net/tools/balsa/balsa_headers.h"
 #include "net/tools/balsa/balsa_visitor_interface.h"
 #include "net/tools/flip_server/constants.h"
@@ -108,16 +111,25 @@ class MemCacheIter {
   size_t bytes_sent;
 };
 
+// MemoryCache maps request paths to the responses loaded from disk. It may
+// be shared by the acceptor threads of a multi-threaded server: lookups are
+// lock-free, reading an immutable snapshot of the index which writers
+// replace wholesale. Writers are serialized with each other but never block
+// readers. Neither snapshots nor FileData are freed before the cache itself,
+// so pointers handed out by GetFileData() stay valid even if the entry they
+// came from is later replaced.
 class MemoryCache {
  public:
-  typedef std::map<std::string, FileData*> Files;
+  typedef base::hash_map<std::string, FileData*> Files;
 
  public:
   MemoryCache();
   virtual ~MemoryCache();
 
+  // Replaces the contents of this cache with a deep copy of |mc|.
   void CloneFrom(const MemoryCache& mc);
 
+  // Loads every file beneath |cwd_|/GET_, publishing them as one snapshot.
   void AddFiles();
 
   // virtual for unittests
@@ -125,8 +137,10 @@ class MemoryCache {
 
   void ReadAndStoreFileContents(const char* filename);
 
+  // Safe to call from any thread.
   FileData* GetFileData(const std::string& filename);
 
+  // Safe to call from any thread.
   bool AssignFileData(const std::string& filename, MemCacheIter* mci);
 
   // For unittests
@@ -135,10 +149,25 @@ class MemoryCache {
                   const std::string& body);
 
  private:
-  void InsertFile(FileData* file_data);
-  void ClearFiles();
-
-  Files files_;
+  // Parses |filename| into a new FileData, or returns NULL if it can't be
+  // framed as an HTTP response.
+  FileData* ReadFileData(const char* filename);
+
+  // Publishes a snapshot holding the current files plus |file_data|, taking
+  // ownership of its elements. Later elements win over earlier ones with the
+  // same filename.
+  void InsertFiles(ScopedVector<FileData>* file_data);
+
+  // Returns the current snapshot.
+  const Files* files() const;
+
+  // Guards |file_data_|, |snapshots_| and publication of |files_|.
+  base::Lock lock_;
+  // Every FileData and snapshot ever published, owned until destruction.
+  ScopedVector<FileData> file_data_;
+  ScopedVector<Files> snapshots_;
+  // The current snapshot, a const Files*. Read without |lock_|.
+  base::subtle::AtomicWord files_;
   std::string cwd_;
 };
 
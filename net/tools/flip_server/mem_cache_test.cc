@@ -4,7 +4,11 @@
 
 #include "net/tools/flip_server/mem_cache.h"
 
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/simple_thread.h"
 #include "net/tools/balsa/balsa_headers.h"
+#include "net/tools/flip_server/spdy_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -95,6 +99,107 @@ TEST_F(FlipMemoryCacheTest, GetFileDataForHtmlFile) {
   ASSERT_EQ(hello_html, mem_cache_->GetFileData("hello.http"));
 }
 
+TEST_F(FlipMemoryCacheTest, FileInSubdirectoryKeepsPath) {
+  mem_cache_->data_map_["./GET_/index.html"] =
+      "HTTP/1.1 200 OK\r\n"
+      "key1: value1\r\n\r\n"
+      "body\r\n";
+  mem_cache_->data_map_["./GET_/images/logo.png"] =
+      "HTTP/1.1 200 OK\r\n"
+      "key1: value1\r\n\r\n"
+      "logo\r\n";
+
+  mem_cache_->ReadAndStoreFileContents("./GET_/index.html");
+  mem_cache_->ReadAndStoreFileContents("./GET_/images/logo.png");
+
+  // Both files are found under the names the HTTP and SPDY interfaces look
+  // up, instead of both being stored as "GET_".
+  FileData* index =
+      mem_cache_->GetFileData(EncodeURL("/index.html", "", "GET"));
+  ASSERT_FALSE(NULL == index);
+  ASSERT_EQ("GET_/index.html", index->filename());
+  FileData* logo =
+      mem_cache_->GetFileData(EncodeURL("/images/logo.png", "", "GET"));
+  ASSERT_FALSE(NULL == logo);
+  ASSERT_EQ("GET_/images/logo.png", logo->filename());
+  ASSERT_NE(index, logo);
+  ASSERT_EQ(NULL, mem_cache_->GetFileData("GET_"));
+}
+
+TEST_F(FlipMemoryCacheTest, ReplacedFileDataStaysValid) {
+  mem_cache_->InsertFile(NULL, "hello", "first");
+  FileData* first = mem_cache_->GetFileData("hello");
+  ASSERT_FALSE(NULL == first);
+
+  mem_cache_->InsertFile(NULL, "hello", "second");
+  FileData* second = mem_cache_->GetFileData("hello");
+  ASSERT_FALSE(NULL == second);
+  EXPECT_NE(first, second);
+  EXPECT_EQ("second", second->body());
+  // Readers which looked up the old entry may still be sending it.
+  EXPECT_EQ("first", first->body());
+}
+
+TEST_F(FlipMemoryCacheTest, CloneFromCopiesFiles) {
+  mem_cache_->InsertFile(NULL, "hello", "body");
+  FileData* original = mem_cache_->GetFileData("hello");
+
+  MemoryCache clone;
+  clone.CloneFrom(*mem_cache_);
+  FileData* copy = clone.GetFileData("hello");
+  ASSERT_FALSE(NULL == copy);
+  EXPECT_NE(original, copy);
+  EXPECT_EQ("body", copy->body());
+
+  // The clone is independent of its source.
+  mem_cache_.reset();
+  EXPECT_EQ("body", copy->body());
+  EXPECT_EQ(NULL, clone.GetFileData("goodbye"));
+}
+
+class LookupThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  LookupThread(MemoryCache* cache, int iterations)
+      : cache_(cache), iterations_(iterations), misses_(0) {}
+
+  void Run() override {
+    for (int i = 0; i < iterations_; ++i) {
+      FileData* data = cache_->GetFileData("hello");
+      if (data == NULL || data->body().empty())
+        ++misses_;
+    }
+  }
+
+  int misses() const { return misses_; }
+
+ private:
+  MemoryCache* cache_;
+  const int iterations_;
+  int misses_;
+};
+
+TEST_F(FlipMemoryCacheTest, ConcurrentLookupsDuringInsert) {
+  const int kThreads = 4;
+  const int kIterations = 10000;
+  mem_cache_->InsertFile(NULL, "hello", "0");
+
+  ScopedVector<LookupThread> lookups;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    lookups.push_back(new LookupThread(mem_cache_.get(), kIterations));
+    threads.push_back(
+        new base::DelegateSimpleThread(lookups.back(), "FlipCacheLookup"));
+    threads.back()->Start();
+  }
+  for (int i = 1; i < 100; ++i)
+    mem_cache_->InsertFile(NULL, "hello", base::IntToString(i));
+  for (int i = 0; i < kThreads; ++i) {
+    threads[i]->Join();
+    EXPECT_EQ(0, lookups[i]->misses());
+  }
+  EXPECT_EQ("99", mem_cache_->GetFileData("hello")->body());
+}
+
 }  // namespace
 
 }  // namespace net
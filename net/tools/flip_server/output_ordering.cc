@@ -58,7 +58,9 @@ OutputOrdering::BeginOutputtingAlarm::~BeginOutputtingAlarm() {
 }
 
 int64 OutputOrdering::BeginOutputtingAlarm::OnAlarm() {
-  OnUnregistration();
+  // The epoll server has already dropped this alarm, so the destructor must
+  // not unregister it.
+  pmp_->alarm_enabled = false;
   output_ordering_->MoveToActive(pmp_, mci_);
   VLOG(2) << "ON ALARM! Should now start to output...";
   delete this;
@@ -0,0 +1,86 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/flip_server/output_ordering.h"
+
+#include "base/memory/scoped_ptr.h"
+#include "net/tools/balsa/balsa_headers.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/flip_server/mem_cache.h"
+#include "net/tools/flip_server/sm_interface.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+class MockSMConnectionInterface : public SMConnectionInterface {
+ public:
+  explicit MockSMConnectionInterface(EpollServer* epoll_server)
+      : epoll_server_(epoll_server) {}
+
+  MOCK_METHOD0(ReadyToSend, void());
+  EpollServer* epoll_server() override { return epoll_server_; }
+
+ private:
+  EpollServer* epoll_server_;
+};
+
+class FlipOutputOrderingTest : public ::testing::Test {
+ public:
+  FlipOutputOrderingTest()
+      : connection_(&epoll_server_), output_ordering_(&connection_) {
+    BalsaHeaders headers;
+    file_data_.reset(new FileData(&headers, "hello", "body"));
+  }
+
+ protected:
+  EpollServer epoll_server_;
+  MockSMConnectionInterface connection_;
+  OutputOrdering output_ordering_;
+  scoped_ptr<FileData> file_data_;
+};
+
+TEST_F(FlipOutputOrderingTest, AlarmMovesStreamToActive) {
+  MemCacheIter mci(file_data_.get());
+  mci.stream_id = 5;
+  EXPECT_CALL(connection_, ReadyToSend());
+
+  output_ordering_.AddToOutputOrder(mci);
+  ASSERT_TRUE(output_ordering_.ExistsInPriorityMaps(5));
+  ASSERT_TRUE(output_ordering_.stream_ids_[5].alarm_enabled);
+
+  // The zero think time alarm fires on the next pass and deletes itself
+  // exactly once.
+  epoll_server_.set_timeout_in_us(0);
+  epoll_server_.WaitForEventsAndExecuteCallbacks();
+  ASSERT_FALSE(output_ordering_.stream_ids_[5].alarm_enabled);
+
+  MemCacheIter* active = output_ordering_.GetIter();
+  ASSERT_FALSE(NULL == active);
+  EXPECT_EQ(5u, active->stream_id);
+
+  output_ordering_.RemoveStreamId(5);
+  EXPECT_FALSE(output_ordering_.ExistsInPriorityMaps(5));
+  EXPECT_EQ(NULL, output_ordering_.GetIter());
+}
+
+TEST_F(FlipOutputOrderingTest, RemoveStreamBeforeAlarm) {
+  MemCacheIter mci(file_data_.get());
+  mci.stream_id = 7;
+  EXPECT_CALL(connection_, ReadyToSend()).Times(0);
+
+  output_ordering_.AddToOutputOrder(mci);
+  output_ordering_.RemoveStreamId(7);
+  EXPECT_FALSE(output_ordering_.ExistsInPriorityMaps(7));
+
+  epoll_server_.set_timeout_in_us(0);
+  epoll_server_.WaitForEventsAndExecuteCallbacks();
+  EXPECT_EQ(NULL, output_ordering_.GetIter());
+}
+
+}  // namespace
+
+}  // namespace net
@@ -6,7 +6,9 @@
 
 #include <errno.h>
 #include <netinet/tcp.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -568,15 +570,21 @@ bool SMConnection::DoWrite() {
     }
 
     flags = MSG_NOSIGNAL | MSG_DONTWAIT;
-    // Look for a queue size > 1 because |this| frame is remains on the list
-    // until it has finished sending.
-    if (output_list_.size() > 1) {
-      VLOG(2) << log_prefix_ << "Outlist size: " << output_list_.size()
-              << ": Adding MSG_MORE flag";
-      flags |= MSG_MORE;
+    ssize_t bytes_written;
+    if (ssl_) {
+      // Look for a queue size > 1 because |this| frame is remains on the list
+      // until it has finished sending.
+      if (output_list_.size() > 1) {
+        VLOG(2) << log_prefix_ << "Outlist size: " << output_list_.size()
+                << ": Adding MSG_MORE flag";
+        flags |= MSG_MORE;
+      }
+      VLOG(2) << log_prefix_ << "Attempting to send " << size << " bytes.";
+      bytes_written = Send(bytes, size, flags);
+    } else {
+      bytes_written =
+          SendOutputList(flags, max_bytes_sent_per_dowrite_ - bytes_sent);
     }
-    VLOG(2) << log_prefix_ << "Attempting to send " << size << " bytes.";
-    ssize_t bytes_written = Send(bytes, size, flags);
     int stored_errno = errno;
     if (bytes_written == -1) {
       switch (stored_errno) {
@@ -598,7 +606,7 @@ bool SMConnection::DoWrite() {
     } else if (bytes_written > 0) {
       VLOG(2) << log_prefix_ << ACCEPTOR_CLIENT_IDENT
               << "Wrote: " << bytes_written << " bytes";
-      data_frame->index += bytes_written;
+      ConsumeOutput(bytes_written);
       bytes_sent += bytes_written;
       continue;
     } else if (bytes_written == -2) {
@@ -623,6 +631,54 @@ bool SMConnection::DoWrite() {
   return false;
 }
 
+ssize_t SMConnection::SendOutputList(int flags, size_t max_bytes) {
+  const size_t kMaxIovecs = 64;
+  struct iovec iov[kMaxIovecs];
+  size_t iov_count = 0;
+  size_t bytes = 0;
+  OutputList::const_iterator it = output_list_.begin();
+  for (; it != output_list_.end() && iov_count < kMaxIovecs &&
+             (iov_count == 0 || bytes < max_bytes);
+       ++it) {
+    DataFrame* data_frame = *it;
+    if (data_frame->index >= data_frame->size)
+      continue;
+    iov[iov_count].iov_base =
+        const_cast<char*>(data_frame->data + data_frame->index);
+    iov[iov_count].iov_len = data_frame->size - data_frame->index;
+    bytes += iov[iov_count].iov_len;
+    ++iov_count;
+  }
+  // Frames left behind will follow shortly.
+  if (it != output_list_.end()) {
+    VLOG(2) << log_prefix_ << "Outlist size: " << output_list_.size()
+            << ": Adding MSG_MORE flag";
+    flags |= MSG_MORE;
+  }
+  VLOG(2) << log_prefix_ << "Attempting to send " << bytes << " bytes in "
+          << iov_count << " frames.";
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iov_count;
+  return sendmsg(fd_, &msg, flags);
+}
+
+void SMConnection::ConsumeOutput(size_t bytes) {
+  while (!output_list_.empty()) {
+    DataFrame* data_frame = output_list_.front();
+    size_t remaining = data_frame->size - data_frame->index;
+    if (bytes < remaining) {
+      data_frame->index += bytes;
+      return;
+    }
+    bytes -= remaining;
+    output_list_.pop_front();
+    delete data_frame;
+  }
+  DCHECK_EQ(0u, bytes);
+}
+
 void SMConnection::Reset() {
   VLOG(2) << log_prefix_ << ACCEPTOR_CLIENT_IDENT << "Resetting";
   if (ssl_) {
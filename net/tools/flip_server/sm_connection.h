@@ -107,6 +107,14 @@ class SMConnection : public SMConnectionInterface,
 
   bool DoRead();
   bool DoWrite();
+  // Sends the front of |output_list_| in a single sendmsg() call, gathering
+  // successive frames until about |max_bytes| are queued. The frames' bytes
+  // are sent in place, without first being copied into a contiguous buffer.
+  // Returns the result of sendmsg().
+  ssize_t SendOutputList(int flags, size_t max_bytes);
+  // Advances |output_list_| past |bytes| sent bytes, deleting the frames
+  // which have been completely sent.
+  void ConsumeOutput(size_t bytes);
   bool DoConsumeReadData();
   void Reset();
 
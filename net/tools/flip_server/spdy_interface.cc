@@ -560,6 +560,32 @@ void SpdySM::SendDataFrameImpl(uint32 stream_id,
   }
 }
 
+void SpdySM::SendCachedDataFrameImpl(uint32 stream_id,
+                                     const char* data,
+                                     int64 len) {
+  DCHECK(buffered_spdy_framer_);
+  // Chop data frames into chunks so that one stream can't monopolize the
+  // output channel.
+  while (len > 0) {
+    int64 size = std::min(len, static_cast<int64>(kSpdySegmentSize));
+    SpdyFrame* fdf = buffered_spdy_framer_->CreateDataFrameHeader(
+        stream_id, data, size, DATA_FLAG_NONE);
+    EnqueueDataFrame(new SpdyFrameDataFrame(fdf));
+
+    DataFrame* df = new DataFrame;
+    df->data = data;
+    df->size = size;
+    df->delete_when_done = false;
+    EnqueueDataFrame(df);
+
+    VLOG(2) << ACCEPTOR_CLIENT_IDENT << "SpdySM: Sending cached data frame "
+            << stream_id << " [" << size << "]";
+
+    data += size;
+    len -= size;
+  }
+}
+
 void SpdySM::EnqueueDataFrame(DataFrame* df) {
   connection_->EnqueueDataFrame(df);
 }
@@ -604,21 +630,11 @@ void SpdySM::GetOutput() {
     if (num_to_write > mci->max_segment_size)
       num_to_write = mci->max_segment_size;
 
-    bool should_compress = false;
-    if (!mci->file_data->headers()->HasHeader("content-encoding")) {
-      if (mci->file_data->headers()->HasHeader("content-type")) {
-        std::string content_type =
-            mci->file_data->headers()->GetHeader("content-type").as_string();
-        if (content_type.find("image") == content_type.npos)
-          should_compress = true;
-      }
-    }
-
-    SendDataFrame(mci->stream_id,
-                  mci->file_data->body().data() + mci->body_bytes_consumed,
-                  num_to_write,
-                  0,
-                  should_compress);
+    // The body is owned by |memory_cache_|, which outlives this connection.
+    SendCachedDataFrameImpl(
+        mci->stream_id,
+        mci->file_data->body().data() + mci->body_bytes_consumed,
+        num_to_write);
     VLOG(2) << ACCEPTOR_CLIENT_IDENT << "SpdySM: GetOutput SendDataFrame["
             << mci->stream_id << "]: " << num_to_write;
     mci->body_bytes_consumed += num_to_write;
@@ -194,6 +194,10 @@ class SpdySM : public BufferedSpdyFramerVisitorInterface, public SMInterface {
                          int64 len,
                          SpdyDataFlags flags,
                          bool compress);
+  // Like SendDataFrameImpl(), but sends |data| in place behind separately
+  // serialized frame headers rather than copying it into each frame. |data|
+  // must outlive the connection, as cached bodies do.
+  void SendCachedDataFrameImpl(uint32 stream_id, const char* data, int64 len);
   void EnqueueDataFrame(DataFrame* df);
   void GetOutput() override;
 
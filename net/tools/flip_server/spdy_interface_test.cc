@@ -526,6 +526,49 @@ TEST_P(SpdySMProxyTest, SendLongDataFrame) {
   ASSERT_EQ("c", StringPiece(actual_data, actual_size));
 }
 
+TEST_P(SpdySMProxyTest, GetOutputSendsCachedBodyInPlace) {
+  uint32 stream_id = 133;
+  const char* actual_data;
+  size_t actual_size;
+  MemCacheIter mci;
+  mci.stream_id = stream_id;
+  mci.transformed_header = true;
+
+  {
+    BalsaHeaders headers;
+    std::string filename = "foobar";
+    memory_cache_->InsertFile(&headers, filename, "hello");
+    mci.file_data = memory_cache_->GetFileData(filename);
+  }
+  interface_->AddToOutputOrder(mci);
+  // Let the zero think time alarm mark the stream ready to send.
+  epoll_server_->set_timeout_in_us(0);
+  epoll_server_->WaitForEventsAndExecuteCallbacks();
+  SMInterface* sm_interface = interface_.get();
+  sm_interface->GetOutput();
+
+  {
+    InSequence s;
+    EXPECT_CALL(*spdy_framer_visitor_,
+                OnDataFrameHeader(stream_id, _, false));
+    EXPECT_CALL(*spdy_framer_visitor_,
+                OnStreamFrameData(stream_id, _, _, false))
+        .WillOnce(DoAll(SaveArg<1>(&actual_data), SaveArg<2>(&actual_size)));
+  }
+
+  // The frame header is followed by the cached body itself.
+  ASSERT_EQ(2u, connection_->output_list()->size());
+  std::list<DataFrame*>::const_iterator i = connection_->output_list()->begin();
+  DataFrame* df = *i++;
+  spdy_framer_->ProcessInput(df->data, df->size);
+  df = *i++;
+  ASSERT_EQ(mci.file_data->body().data(), df->data);
+  ASSERT_FALSE(df->delete_when_done);
+  spdy_framer_->ProcessInput(df->data, df->size);
+  ASSERT_EQ(1, spdy_framer_->frames_received());
+  ASSERT_EQ("hello", StringPiece(actual_data, actual_size));
+}
+
 TEST_P(SpdySMServerTest, OnSynStream) {
   BufferedSpdyFramerVisitorInterface* visitor = interface_.get();
   uint32 stream_id = 82;
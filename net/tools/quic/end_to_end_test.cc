@@ -1079,6 +1079,29 @@ TEST_P(EndToEndTest, MaxStreamsUberTest) {
   }
 }
 
+TEST_P(EndToEndTest, LargeResponseSharesCachedBody) {
+  ASSERT_TRUE(Initialize());
+  string large_body;
+  GenerateBody(&large_body, 256 * 1024);
+  AddToCache("/large_response", 200, "OK", large_body);
+
+  client_->client()->WaitForCryptoHandshakeConfirmed();
+  EXPECT_EQ(large_body, client_->SendSynchronousRequest("/large_response"));
+
+  // The server sends the body out of the cache, so each byte of it is only
+  // copied into its packets, and not into a send buffer first.
+  server_thread_->Pause();
+  QuicDispatcher* dispatcher =
+      QuicServerPeer::GetDispatcher(server_thread_->server());
+  ASSERT_EQ(1u, dispatcher->session_map().size());
+  QuicSession* session = dispatcher->session_map().begin()->second;
+  QuicConnectionStats server_stats = session->connection()->GetStats();
+  EXPECT_LE(large_body.size(), server_stats.stream_bytes_sent);
+  EXPECT_LT(server_stats.stream_bytes_copied,
+            server_stats.stream_bytes_sent * 3 / 2);
+  server_thread_->Resume();
+}
+
 TEST_P(EndToEndTest, StreamCancelErrorTest) {
   ASSERT_TRUE(Initialize());
   string small_body;
@@ -0,0 +1,211 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_batch_packet_writer.h"
+
+#include <errno.h>
+#include <netinet/udp.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "net/tools/quic/quic_socket_utils.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// The kernel splits a message into at most this many packets.
+const int kMaxSegments = 64;
+
+// The ancillary data of a message: the self address, and the segment size.
+const size_t kSpaceForIp =
+    CMSG_SPACE(sizeof(in_pktinfo)) > CMSG_SPACE(sizeof(in6_pktinfo))
+        ? CMSG_SPACE(sizeof(in_pktinfo))
+        : CMSG_SPACE(sizeof(in6_pktinfo));
+const size_t kControlSpace = kSpaceForIp + CMSG_SPACE(sizeof(uint16));
+
+}  // namespace
+
+QuicBatchPacketWriter::QueuedPacket::QueuedPacket() : length(0) {
+}
+
+QuicBatchPacketWriter::QueuedPacket::~QueuedPacket() {
+}
+
+QuicBatchPacketWriter::QuicBatchPacketWriter(int fd)
+    : QuicDefaultPacketWriter(fd),
+      buffer_(new char[kMaxBatchPackets * kMaxPacketSize]),
+      first_packet_(0),
+      num_packets_(0),
+      use_segmentation_offload_(SupportsSegmentationOffload(fd)),
+      control_(new char[kMaxBatchPackets * kControlSpace]),
+      packets_written_(0),
+      write_calls_(0) {
+  static_assert(kMaxBatchPackets * kMaxPacketSize < 65507 &&
+                    kMaxBatchPackets <= kMaxSegments,
+                "a batch must fit in a single segmented message");
+  memset(messages_, 0, sizeof(messages_));
+}
+
+QuicBatchPacketWriter::~QuicBatchPacketWriter() {
+}
+
+void QuicBatchPacketWriter::Flush() {
+  if (IsWriteBlocked() || num_queued_packets() == 0)
+    return;
+  WriteQueuedPackets();
+}
+
+WriteResult QuicBatchPacketWriter::WritePacket(
+    const char* buffer,
+    size_t buf_len,
+    const IPAddressNumber& self_address,
+    const IPEndPoint& peer_address) {
+  DCHECK(!IsWriteBlocked());
+  CHECK_LE(buf_len, kMaxPacketSize);
+  DCHECK_LT(num_packets_, kMaxBatchPackets);
+
+  memcpy(buffer_.get() + num_packets_ * kMaxPacketSize, buffer, buf_len);
+  QueuedPacket* packet = &packets_[num_packets_];
+  packet->length = buf_len;
+  packet->self_address = self_address;
+  packet->peer_address = peer_address;
+  ++num_packets_;
+
+  if (num_packets_ == kMaxBatchPackets && !WriteQueuedPackets()) {
+    // The packet stays queued, so it is not lost.
+    return WriteResult(WRITE_STATUS_BLOCKED, EAGAIN);
+  }
+  return WriteResult(WRITE_STATUS_OK, buf_len);
+}
+
+bool QuicBatchPacketWriter::IsWriteBlockedDataBuffered() const {
+  return true;
+}
+
+void QuicBatchPacketWriter::SetWritable() {
+  QuicDefaultPacketWriter::SetWritable();
+  Flush();
+}
+
+// static
+bool QuicBatchPacketWriter::SupportsSegmentationOffload(int fd) {
+  int segment_size = 0;
+  socklen_t length = sizeof(segment_size);
+  return getsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment_size, &length) == 0;
+}
+
+bool QuicBatchPacketWriter::WriteQueuedPackets() {
+  while (first_packet_ < num_packets_) {
+    int num_messages = BuildMessages();
+    int rc = sendmmsg(fd(), messages_, num_messages, 0);
+    ++write_calls_;
+    if (rc < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        set_write_blocked(true);
+        return false;
+      }
+      if ((errno == EIO || errno == EINVAL) && message_packets_[0] > 1) {
+        // The kernel or the device cannot segment the message after all.
+        DLOG(WARNING) << "UDP segmentation offload failed: "
+                      << strerror(errno);
+        use_segmentation_offload_ = false;
+        continue;
+      }
+      // Drop the packets of the first message, as the network could have:
+      // they are retransmitted like lost packets. Failing the write would
+      // close a connection that may not even own them.
+      LOG(WARNING) << "Dropping " << message_packets_[0] << " packets: "
+                   << strerror(errno);
+      first_packet_ += message_packets_[0];
+      continue;
+    }
+    for (int i = 0; i < rc; ++i) {
+      first_packet_ += message_packets_[i];
+      packets_written_ += message_packets_[i];
+    }
+  }
+  first_packet_ = 0;
+  num_packets_ = 0;
+  return true;
+}
+
+int QuicBatchPacketWriter::BuildMessages() {
+  int num_messages = 0;
+  int packet = first_packet_;
+  while (packet < num_packets_) {
+    const int first = packet;
+    for (++packet; packet < num_packets_ && CanSegment(first, packet);
+         ++packet) {
+    }
+    const int count = packet - first;
+    for (int i = first; i < packet; ++i) {
+      iovecs_[i].iov_base = buffer_.get() + i * kMaxPacketSize;
+      iovecs_[i].iov_len = packets_[i].length;
+    }
+
+    mmsghdr* message = &messages_[num_messages];
+    message->msg_len = 0;
+    msghdr* hdr = &message->msg_hdr;
+    socklen_t address_len = sizeof(addresses_[num_messages]);
+    CHECK(packets_[first].peer_address.ToSockAddr(
+        reinterpret_cast<sockaddr*>(&addresses_[num_messages]),
+        &address_len));
+    hdr->msg_name = &addresses_[num_messages];
+    hdr->msg_namelen = address_len;
+    hdr->msg_iov = &iovecs_[first];
+    hdr->msg_iovlen = count;
+    hdr->msg_flags = 0;
+
+    hdr->msg_control = control_.get() + num_messages * kControlSpace;
+    hdr->msg_controllen = kControlSpace;
+    size_t control_len = 0;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+    if (!packets_[first].self_address.empty()) {
+      control_len += CMSG_SPACE(
+          QuicSocketUtils::SetIpInfoInCmsg(packets_[first].self_address, cmsg));
+      cmsg = CMSG_NXTHDR(hdr, cmsg);
+    }
+    if (count > 1) {
+      // Every packet but the last has the size of the first one.
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16));
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      *reinterpret_cast<uint16*>(CMSG_DATA(cmsg)) =
+          static_cast<uint16>(packets_[first].length);
+      control_len += CMSG_SPACE(sizeof(uint16));
+    }
+    hdr->msg_controllen = control_len;
+    if (control_len == 0)
+      hdr->msg_control = nullptr;
+
+    message_packets_[num_messages] = count;
+    ++num_messages;
+  }
+  return num_messages;
+}
+
+bool QuicBatchPacketWriter::CanSegment(int first, int packet) const {
+  if (!use_segmentation_offload_ || packet - first >= kMaxSegments)
+    return false;
+  // The kernel splits a message into packets of the size of the first one,
+  // so only the last packet can be shorter.
+  const QueuedPacket& head = packets_[first];
+  return packets_[packet - 1].length == head.length &&
+         packets_[packet].length <= head.length &&
+         packets_[packet].peer_address == head.peer_address &&
+         packets_[packet].self_address == head.self_address;
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,121 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
+#define NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/quic_protocol.h"
+#include "net/tools/quic/quic_default_packet_writer.h"
+
+namespace net {
+
+struct WriteResult;
+
+namespace tools {
+
+// A packet writer that queues the packets that it is given, and writes each
+// batch of them to the socket with a single sendmmsg call. Where the kernel
+// supports UDP segmentation offload, a run of packets of the same size to the
+// same peer goes out as a single message, which the kernel or the NIC splits
+// into packets again.
+//
+// The queued packets are written when the batch is full, and when Flush() is
+// called, which the owner of the writer must do at the end of every iteration
+// of its event loop. A packet is reported as written once it is queued. If
+// the socket becomes write blocked, the packets that could not be written
+// stay queued, and the writer is write blocked until SetWritable() manages to
+// write them. Since the packets are buffered, QuicConnection does not send
+// them again.
+class QuicBatchPacketWriter : public QuicDefaultPacketWriter {
+ public:
+  // The number of packets that are queued before they are written.
+  static const int kMaxBatchPackets = 32;
+
+  explicit QuicBatchPacketWriter(int fd);
+  ~QuicBatchPacketWriter() override;
+
+  // Writes the queued packets, unless the writer is write blocked.
+  void Flush();
+
+  // QuicPacketWriter
+  WriteResult WritePacket(const char* buffer,
+                          size_t buf_len,
+                          const IPAddressNumber& self_address,
+                          const IPEndPoint& peer_address) override;
+  bool IsWriteBlockedDataBuffered() const override;
+  void SetWritable() override;
+
+  // UDP segmentation offload is used if the socket supports it, unless it is
+  // turned off with this.
+  void set_use_segmentation_offload(bool use_segmentation_offload) {
+    use_segmentation_offload_ = use_segmentation_offload;
+  }
+  bool use_segmentation_offload() const { return use_segmentation_offload_; }
+
+  int num_queued_packets() const { return num_packets_ - first_packet_; }
+
+  // The number of packets that were written to the socket, and the number of
+  // system calls that it took.
+  uint64 packets_written() const { return packets_written_; }
+  uint64 write_calls() const { return write_calls_; }
+
+ private:
+  struct QueuedPacket {
+    QueuedPacket();
+    ~QueuedPacket();
+
+    size_t length;
+    IPAddressNumber self_address;
+    IPEndPoint peer_address;
+  };
+
+  // Returns true if the kernel can send the packets of the socket with UDP
+  // segmentation offload.
+  static bool SupportsSegmentationOffload(int fd);
+
+  // Writes the queued packets until they are all written, in which case it
+  // returns true, or until the socket is write blocked.
+  bool WriteQueuedPackets();
+
+  // Fills |messages_| with the messages that write the queued packets, and
+  // returns their number.
+  int BuildMessages();
+
+  // Returns true if |packet| can be sent in the same message as the packets
+  // from |first| to |packet| - 1.
+  bool CanSegment(int first, int packet) const;
+
+  // The payloads of the packets, kMaxPacketSize bytes per packet.
+  scoped_ptr<char[]> buffer_;
+  QueuedPacket packets_[kMaxBatchPackets];
+  // The packets from |first_packet_| to |num_packets_| - 1 are queued.
+  int first_packet_;
+  int num_packets_;
+
+  bool use_segmentation_offload_;
+
+  // The arguments of sendmmsg, with a message per packet at most.
+  mmsghdr messages_[kMaxBatchPackets];
+  // The number of packets in each message.
+  int message_packets_[kMaxBatchPackets];
+  iovec iovecs_[kMaxBatchPackets];
+  sockaddr_storage addresses_[kMaxBatchPackets];
+  scoped_ptr<char[]> control_;
+
+  uint64 packets_written_;
+  uint64 write_calls_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicBatchPacketWriter);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
@@ -0,0 +1,118 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_batch_packet_writer.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/test/perf_time_logger.h"
+#include "base/time/time.h"
+#include "net/base/net_util.h"
+#include "net/tools/quic/quic_default_packet_writer.h"
+#include "net/tools/quic/quic_socket_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace net {
+namespace tools {
+namespace test {
+namespace {
+
+const int kNumPackets = 200000;
+// The packets that a server sends in an iteration of its event loop, e.g. a
+// congestion window's worth of a bulk transfer.
+const int kPacketsPerFlush = 16;
+const size_t kPacketSize = 1350;
+
+class QuicPacketWriterPerfTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CHECK(ParseIPLiteralToNumber("127.0.0.1", &self_address_));
+    bool overflow_supported = false;
+    IPEndPoint any_address(self_address_, 0);
+    send_fd_ = QuicSocketUtils::CreateUDPSocket(any_address, false,
+                                                &overflow_supported);
+    receive_fd_ = QuicSocketUtils::CreateUDPSocket(any_address, false,
+                                                   &overflow_supported);
+    ASSERT_LE(0, send_fd_);
+    ASSERT_LE(0, receive_fd_);
+    SockaddrStorage storage;
+    ASSERT_TRUE(any_address.ToSockAddr(storage.addr, &storage.addr_len));
+    ASSERT_EQ(0, bind(receive_fd_, storage.addr, storage.addr_len));
+    ASSERT_EQ(0, getsockname(receive_fd_, storage.addr, &storage.addr_len));
+    ASSERT_TRUE(peer_address_.FromSockAddr(storage.addr, storage.addr_len));
+  }
+
+  void TearDown() override {
+    close(send_fd_);
+    close(receive_fd_);
+  }
+
+  // Writes kNumPackets packets with |writer|, and calls |flush| after every
+  // kPacketsPerFlush of them. The receiver does not read them, so most are
+  // dropped once they reach it, which costs the same for every writer.
+  template <typename Writer, typename Flush>
+  void Benchmark(const std::string& name, Writer* writer, Flush flush) {
+    const std::string packet(kPacketSize, 'x');
+    base::PerfTimeLogger timer(("QUIC_writer_" + name).c_str());
+    const base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumPackets; ++i) {
+      if (writer->IsWriteBlocked())
+        writer->SetWritable();
+      writer->WritePacket(packet.data(), packet.size(), self_address_,
+                          peer_address_);
+      if ((i + 1) % kPacketsPerFlush == 0)
+        flush();
+    }
+    flush();
+    const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+    timer.Done();
+    perf_test::PrintResult("QUIC_writer_throughput", "", name,
+                           kNumPackets / seconds, "packets/s", true);
+  }
+
+  IPAddressNumber self_address_;
+  IPEndPoint peer_address_;
+  int send_fd_;
+  int receive_fd_;
+};
+
+void DoNothing() {
+}
+
+TEST_F(QuicPacketWriterPerfTest, DefaultWriter) {
+  QuicDefaultPacketWriter writer(send_fd_);
+  Benchmark("default", &writer, &DoNothing);
+}
+
+TEST_F(QuicPacketWriterPerfTest, BatchWriter) {
+  QuicBatchPacketWriter writer(send_fd_);
+  writer.set_use_segmentation_offload(false);
+  Benchmark("sendmmsg", &writer, [&writer]() { writer.Flush(); });
+  perf_test::PrintResult(
+      "QUIC_writer_packets_per_call", "", "sendmmsg",
+      static_cast<double>(writer.packets_written()) / writer.write_calls(),
+      "packets", true);
+}
+
+TEST_F(QuicPacketWriterPerfTest, BatchWriterWithSegmentationOffload) {
+  QuicBatchPacketWriter writer(send_fd_);
+  if (!writer.use_segmentation_offload()) {
+    LOG(WARNING) << "UDP segmentation offload is not supported";
+    return;
+  }
+  Benchmark("gso", &writer, [&writer]() { writer.Flush(); });
+  perf_test::PrintResult(
+      "QUIC_writer_packets_per_call", "", "gso",
+      static_cast<double>(writer.packets_written()) / writer.write_calls(),
+      "packets", true);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace tools
+}  // namespace net
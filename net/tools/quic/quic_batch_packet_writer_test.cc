@@ -0,0 +1,146 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_batch_packet_writer.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "net/base/net_util.h"
+#include "net/tools/quic/quic_socket_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace tools {
+namespace test {
+namespace {
+
+class QuicBatchPacketWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CHECK(ParseIPLiteralToNumber("127.0.0.1", &self_address_));
+    bool overflow_supported = false;
+    IPEndPoint any_address(self_address_, 0);
+    send_fd_ = QuicSocketUtils::CreateUDPSocket(any_address, false,
+                                                &overflow_supported);
+    receive_fd_ = QuicSocketUtils::CreateUDPSocket(any_address, false,
+                                                   &overflow_supported);
+    ASSERT_LE(0, send_fd_);
+    ASSERT_LE(0, receive_fd_);
+    SockaddrStorage storage;
+    ASSERT_TRUE(any_address.ToSockAddr(storage.addr, &storage.addr_len));
+    ASSERT_EQ(0, bind(receive_fd_, storage.addr, storage.addr_len));
+    ASSERT_EQ(0, getsockname(receive_fd_, storage.addr, &storage.addr_len));
+    ASSERT_TRUE(peer_address_.FromSockAddr(storage.addr, storage.addr_len));
+    writer_.reset(new QuicBatchPacketWriter(send_fd_));
+  }
+
+  void TearDown() override {
+    writer_.reset();
+    close(send_fd_);
+    close(receive_fd_);
+  }
+
+  WriteResult WritePacket(const std::string& packet) {
+    return writer_->WritePacket(packet.data(), packet.size(), self_address_,
+                                peer_address_);
+  }
+
+  // Returns the next packet that arrived, or an empty string if there is
+  // none.
+  std::string ReceivePacket() {
+    char buffer[kMaxPacketSize];
+    ssize_t rc = recv(receive_fd_, buffer, sizeof(buffer), 0);
+    if (rc < 0) {
+      EXPECT_EQ(EAGAIN, errno);
+      return std::string();
+    }
+    return std::string(buffer, rc);
+  }
+
+  IPAddressNumber self_address_;
+  IPEndPoint peer_address_;
+  int send_fd_;
+  int receive_fd_;
+  scoped_ptr<QuicBatchPacketWriter> writer_;
+};
+
+TEST_F(QuicBatchPacketWriterTest, QueuesUntilFlush) {
+  EXPECT_TRUE(writer_->IsWriteBlockedDataBuffered());
+  for (int i = 0; i < 3; ++i) {
+    WriteResult result =
+        WritePacket(std::string(100, static_cast<char>('a' + i)));
+    EXPECT_EQ(WRITE_STATUS_OK, result.status);
+    EXPECT_EQ(100, result.bytes_written);
+  }
+  EXPECT_EQ(3, writer_->num_queued_packets());
+  EXPECT_EQ("", ReceivePacket());
+
+  writer_->Flush();
+  EXPECT_EQ(0, writer_->num_queued_packets());
+  EXPECT_EQ(3u, writer_->packets_written());
+  EXPECT_EQ(1u, writer_->write_calls());
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(std::string(100, static_cast<char>('a' + i)), ReceivePacket());
+  EXPECT_EQ("", ReceivePacket());
+}
+
+TEST_F(QuicBatchPacketWriterTest, WritesFullBatch) {
+  writer_->set_use_segmentation_offload(false);
+  for (int i = 0; i < QuicBatchPacketWriter::kMaxBatchPackets; ++i)
+    EXPECT_EQ(WRITE_STATUS_OK, WritePacket(std::string(10 + i, 'x')).status);
+  EXPECT_EQ(0, writer_->num_queued_packets());
+  EXPECT_EQ(1u, writer_->write_calls());
+  for (int i = 0; i < QuicBatchPacketWriter::kMaxBatchPackets; ++i)
+    EXPECT_EQ(std::string(10 + i, 'x'), ReceivePacket());
+}
+
+TEST_F(QuicBatchPacketWriterTest, SegmentationOffload) {
+  if (!writer_->use_segmentation_offload())
+    return;
+
+  // Equal packets, and a shorter one to end the run, go out as one message.
+  for (int i = 0; i < 10; ++i)
+    WritePacket(std::string(1000, static_cast<char>('a' + i)));
+  WritePacket(std::string(500, 'z'));
+  writer_->Flush();
+  EXPECT_EQ(1u, writer_->write_calls());
+  EXPECT_EQ(11u, writer_->packets_written());
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(std::string(1000, static_cast<char>('a' + i)), ReceivePacket());
+  EXPECT_EQ(std::string(500, 'z'), ReceivePacket());
+  EXPECT_EQ("", ReceivePacket());
+
+  // A longer packet starts a new message, within the same system call.
+  WritePacket(std::string(500, 'a'));
+  WritePacket(std::string(1000, 'b'));
+  WritePacket(std::string(1000, 'c'));
+  writer_->Flush();
+  EXPECT_EQ(2u, writer_->write_calls());
+  EXPECT_EQ(std::string(500, 'a'), ReceivePacket());
+  EXPECT_EQ(std::string(1000, 'b'), ReceivePacket());
+  EXPECT_EQ(std::string(1000, 'c'), ReceivePacket());
+}
+
+TEST_F(QuicBatchPacketWriterTest, DropsPacketsThatFail) {
+  // The kernel refuses to send to port zero.
+  IPEndPoint bad_address(self_address_, 0);
+  std::string bad_packet(100, 'b');
+  writer_->WritePacket(bad_packet.data(), bad_packet.size(), self_address_,
+                       bad_address);
+  WritePacket(std::string(100, 'g'));
+  writer_->Flush();
+  EXPECT_EQ(0, writer_->num_queued_packets());
+  EXPECT_EQ(1u, writer_->packets_written());
+  EXPECT_FALSE(writer_->IsWriteBlocked());
+  EXPECT_EQ(std::string(100, 'g'), ReceivePacket());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace tools
+}  // namespace net
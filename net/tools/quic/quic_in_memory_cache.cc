@@ -21,7 +21,8 @@ using std::string;
 namespace net {
 namespace tools {
 
-QuicInMemoryCache::Response::Response() : response_type_(REGULAR_RESPONSE) {}
+QuicInMemoryCache::Response::Response()
+    : response_type_(REGULAR_RESPONSE), body_(new base::RefCountedString) {}
 
 QuicInMemoryCache::Response::~Response() {}
 
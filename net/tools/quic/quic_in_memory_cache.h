@@ -8,6 +8,8 @@
 #include <string>
 
 #include "base/containers/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/singleton.h"
 #include "base/strings/string_piece.h"
 #include "net/spdy/spdy_framer.h"
@@ -42,7 +44,9 @@ class QuicInMemoryCache {
 
     SpecialResponseType response_type() const { return response_type_; }
     const SpdyHeaderBlock& headers() const { return headers_; }
-    const StringPiece body() const { return StringPiece(body_); }
+    const StringPiece body() const { return StringPiece(body_->data()); }
+    // The body, which the streams that send it share instead of copying it.
+    base::RefCountedString* body_buffer() const { return body_.get(); }
 
    private:
     friend class QuicInMemoryCache;
@@ -54,12 +58,12 @@ class QuicInMemoryCache {
       headers_ = headers;
     }
     void set_body(base::StringPiece body) {
-      body.CopyToString(&body_);
+      body.CopyToString(&body_->data());
     }
 
     SpecialResponseType response_type_;
     SpdyHeaderBlock headers_;
-    std::string body_;
+    scoped_refptr<base::RefCountedString> body_;
 
     DISALLOW_COPY_AND_ASSIGN(Response);
   };
@@ -110,6 +110,11 @@ bool QuicPacketReader::ReadAndDispatchPackets(
 #endif
 }
 
+/* static */
+bool QuicPacketReader::CanReadPacketsInBatches() {
+  return MMSG_MORE != 0;
+}
+
 /* static */
 bool QuicPacketReader::ReadAndDispatchSinglePacket(
     int fd,
@@ -46,6 +46,10 @@ class QuicPacketReader {
                               ProcessPacketInterface* processor,
                               QuicPacketCount* packets_dropped);
 
+  // Returns true if ReadAndDispatchPackets() can be used, which reads the
+  // packets in batches with recvmmsg.
+  static bool CanReadPacketsInBatches();
+
   // Same as ReadAndDispatchPackets, only does one packet at a time.
   static bool ReadAndDispatchSinglePacket(int fd,
                                           int port,
@@ -68,6 +68,10 @@ class QuicServer : public EpollCallbackInterface {
 
   void OnShutdown(EpollServer* eps, int fd) override {}
 
+  // Sets the flow control windows of |config| that were not explicitly set to
+  // values that suit a server.
+  static void SetDefaultFlowControlWindows(QuicConfig* config);
+
   void SetStrikeRegisterNoStartupPeriod() {
     crypto_config_.set_strike_register_no_startup_period();
   }
@@ -0,0 +1,206 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A load generator for QuicShardedServer. It runs a server with --workers
+// worker threads on a loopback port, and --clients client threads that
+// handshake with it over and over for --duration seconds. It then reports
+// the handshakes and the packets that the server handled per second, in total
+// and per worker, i.e. per core that the server can keep busy. With
+// --batch_writes the server writes its packets with QuicBatchPacketWriter.
+
+#include <iostream>
+
+#include "base/at_exit.h"
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/sys_info.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_util.h"
+#include "net/base/privacy_mode.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_server_id.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/quic/quic_client.h"
+#include "net/tools/quic/quic_sharded_server.h"
+
+using std::cout;
+using std::endl;
+
+// The number of worker threads of the server. Zero uses one per core.
+int32 FLAGS_workers = 0;
+// The number of client threads.
+int32 FLAGS_clients = 8;
+// How long to generate load for, in seconds.
+int32 FLAGS_duration = 10;
+// If true, the server batches the packets that it writes.
+bool FLAGS_batch_writes = false;
+
+namespace {
+
+// Connects to the server over and over, each time with a new client, so that
+// every connection goes through a full handshake.
+class LoadClient : public base::DelegateSimpleThread::Delegate {
+ public:
+  LoadClient(const net::IPEndPoint& server_address,
+             const base::CancellationFlag* stop)
+      : server_address_(server_address),
+        stop_(stop),
+        handshakes_(0),
+        failures_(0) {}
+
+  void Run() override {
+    net::EpollServer epoll_server;
+    net::QuicServerId server_id("quic.load.test", server_address_.port(),
+                                false, net::PRIVACY_MODE_DISABLED);
+    while (!stop_->IsSet()) {
+      net::tools::QuicClient client(server_address_, server_id,
+                                    net::QuicSupportedVersions(),
+                                    &epoll_server);
+      if (!client.Initialize()) {
+        base::subtle::NoBarrier_AtomicIncrement(&failures_, 1);
+        continue;
+      }
+      if (client.Connect()) {
+        base::subtle::NoBarrier_AtomicIncrement(&handshakes_, 1);
+      } else {
+        base::subtle::NoBarrier_AtomicIncrement(&failures_, 1);
+      }
+      client.Disconnect();
+    }
+  }
+
+  int handshakes() const { return base::subtle::NoBarrier_Load(&handshakes_); }
+  int failures() const { return base::subtle::NoBarrier_Load(&failures_); }
+
+ private:
+  const net::IPEndPoint server_address_;
+  const base::CancellationFlag* stop_;
+  base::subtle::Atomic32 handshakes_;
+  base::subtle::Atomic32 failures_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadClient);
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help")) {
+    const char* help_str =
+        "Usage: quic_server_load [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help                  show this help message and exit\n"
+        "--workers=<workers>         number of server threads, one per core "
+        "if not set\n"
+        "--clients=<clients>         number of client threads\n"
+        "--duration=<seconds>        how long to generate load for\n"
+        "--batch_writes              batch the packets that the server "
+        "writes\n";
+    cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("workers")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("workers"),
+                           &FLAGS_workers)) {
+      LOG(ERROR) << "--workers must be an integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("clients")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("clients"),
+                           &FLAGS_clients)) {
+      LOG(ERROR) << "--clients must be an integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("duration")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("duration"),
+                           &FLAGS_duration)) {
+      LOG(ERROR) << "--duration must be an integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("batch_writes"))
+    FLAGS_batch_writes = true;
+  if (FLAGS_workers <= 0)
+    FLAGS_workers = base::SysInfo::NumberOfProcessors();
+
+  net::IPAddressNumber ip;
+  CHECK(net::ParseIPLiteralToNumber("127.0.0.1", &ip));
+
+  net::QuicConfig config;
+  net::tools::QuicShardedServer server(config, net::QuicSupportedVersions(),
+                                       FLAGS_workers);
+  server.set_batch_writes(FLAGS_batch_writes);
+  if (!server.Listen(net::IPEndPoint(ip, 0))) {
+    return 1;
+  }
+  server.Start();
+
+  const net::IPEndPoint server_address(ip, server.port());
+  base::CancellationFlag stop;
+  ScopedVector<LoadClient> clients;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    clients.push_back(new LoadClient(server_address, &stop));
+    threads.push_back(new base::DelegateSimpleThread(
+        clients.back(), "quic_load_client_" + base::IntToString(i)));
+    threads.back()->Start();
+  }
+
+  base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(FLAGS_duration));
+  stop.Set();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+  const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  server.Shutdown();
+
+  int handshakes = 0;
+  int failures = 0;
+  for (size_t i = 0; i < clients.size(); ++i) {
+    handshakes += clients[i]->handshakes();
+    failures += clients[i]->failures();
+  }
+  int packets = 0;
+  int forwarded = 0;
+  for (int i = 0; i < server.num_workers(); ++i) {
+    packets += server.worker(i)->packets_processed();
+    forwarded += server.worker(i)->packets_forwarded();
+  }
+
+  cout << "workers: " << server.num_workers() << " clients: " << FLAGS_clients
+       << " seconds: " << seconds << " steering: "
+       << (server.kernel_steering() ? "kernel" : "workers")
+       << " batch writes: " << (FLAGS_batch_writes ? "yes" : "no") << endl;
+  cout << "handshakes: " << handshakes << " failed: " << failures
+       << " packets: " << packets << " forwarded: " << forwarded << endl;
+  cout << "handshakes/s: " << handshakes / seconds << " per core: "
+       << handshakes / seconds / server.num_workers() << endl;
+  cout << "packets/s: " << packets / seconds << " per core: "
+       << packets / seconds / server.num_workers() << endl;
+  for (int i = 0; i < server.num_workers(); ++i) {
+    cout << "worker " << i << " packets/s: "
+         << server.worker(i)->packets_processed() / seconds << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,285 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_sharded_server.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/net_util.h"
+#include "net/quic/crypto/crypto_handshake.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_clock.h"
+#include "net/tools/quic/quic_batch_packet_writer.h"
+#include "net/tools/quic/quic_default_packet_writer.h"
+#include "net/tools/quic/quic_epoll_connection_helper.h"
+#include "net/tools/quic/quic_packet_reader.h"
+#include "net/tools/quic/quic_server.h"
+#include "net/tools/quic/quic_socket_utils.h"
+
+namespace net {
+namespace tools {
+namespace {
+
+const int kEpollFlags = EPOLLIN | EPOLLOUT | EPOLLET;
+const char kSourceAddressTokenSecret[] = "secret";
+
+// Every worker serves a share of many clients, so its socket gets larger
+// buffers than the ones of QuicServer.
+const size_t kSocketBufferSize = 4 * 1024 * 1024;
+
+}  // namespace
+
+QuicShardedServer::Worker::QueuedPacket::QueuedPacket(
+    const IPEndPoint& server_address,
+    const IPEndPoint& client_address,
+    const QuicEncryptedPacket& packet)
+    : server_address(server_address),
+      client_address(client_address),
+      data(packet.data(), packet.length()) {
+}
+
+QuicShardedServer::Worker::QueuedPacket::~QueuedPacket() {
+}
+
+QuicShardedServer::Worker::Worker(QuicShardedServer* server, int index)
+    : server_(server),
+      index_(index),
+      packet_reader_(new QuicPacketReader()),
+      batch_writer_(nullptr),
+      fd_(-1),
+      port_(0),
+      overflow_supported_(false),
+      packets_dropped_(0),
+      use_recvmmsg_(QuicPacketReader::CanReadPacketsInBatches()),
+      packets_processed_(0),
+      packets_forwarded_(0) {
+  epoll_server_.set_timeout_in_us(50 * 1000);
+}
+
+QuicShardedServer::Worker::~Worker() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool QuicShardedServer::Worker::Listen(const IPEndPoint& address) {
+  fd_ = QuicSocketUtils::CreateUDPSocket(address, true, &overflow_supported_);
+  if (fd_ < 0)
+    return false;
+
+  if (!QuicSocketUtils::SetReceiveBufferSize(fd_, kSocketBufferSize) ||
+      !QuicSocketUtils::SetSendBufferSize(fd_, kSocketBufferSize)) {
+    return false;
+  }
+
+  sockaddr_storage raw_addr;
+  socklen_t raw_addr_len = sizeof(raw_addr);
+  CHECK(address.ToSockAddr(reinterpret_cast<sockaddr*>(&raw_addr),
+                           &raw_addr_len));
+  if (bind(fd_, reinterpret_cast<const sockaddr*>(&raw_addr),
+           raw_addr_len) < 0) {
+    LOG(ERROR) << "Bind failed: " << strerror(errno);
+    return false;
+  }
+
+  SockaddrStorage storage;
+  IPEndPoint server_address;
+  if (getsockname(fd_, storage.addr, &storage.addr_len) != 0 ||
+      !server_address.FromSockAddr(storage.addr, storage.addr_len)) {
+    LOG(ERROR) << "Unable to get self address.  Error: " << strerror(errno);
+    return false;
+  }
+  port_ = server_address.port();
+  DVLOG(1) << "Worker " << index_ << " listening on "
+           << server_address.ToString();
+
+  epoll_server_.RegisterFD(fd_, this, kEpollFlags);
+  dispatcher_.reset(new QuicDispatcher(
+      server_->config_, &server_->crypto_config_, server_->supported_versions_,
+      new QuicDispatcher::DefaultPacketWriterFactory(),
+      new QuicEpollConnectionHelper(&epoll_server_)));
+  if (server_->batch_writes_) {
+    batch_writer_ = new QuicBatchPacketWriter(fd_);
+    dispatcher_->InitializeWithWriter(batch_writer_);
+  } else {
+    dispatcher_->InitializeWithWriter(new QuicDefaultPacketWriter(fd_));
+  }
+  return true;
+}
+
+void QuicShardedServer::Worker::Quit() {
+  quit_.Set();
+  epoll_server_.Wake();
+}
+
+void QuicShardedServer::Worker::EnqueuePacket(
+    const IPEndPoint& server_address,
+    const IPEndPoint& client_address,
+    const QuicEncryptedPacket& packet) {
+  bool was_empty;
+  {
+    base::AutoLock lock(queued_packets_lock_);
+    was_empty = queued_packets_.empty();
+    queued_packets_.push_back(
+        QueuedPacket(server_address, client_address, packet));
+  }
+  // The worker drains the whole queue once it is awake, so only the first
+  // packet needs to wake it.
+  if (was_empty)
+    epoll_server_.Wake();
+}
+
+void QuicShardedServer::Worker::Run() {
+  while (!quit_.IsSet()) {
+    epoll_server_.WaitForEventsAndExecuteCallbacks();
+    ProcessQueuedPackets();
+    if (batch_writer_)
+      batch_writer_->Flush();
+  }
+
+  // Before the epoll server goes away, give all active sessions a chance to
+  // notify clients that they're closing.
+  dispatcher_->Shutdown();
+  if (batch_writer_)
+    batch_writer_->Flush();
+}
+
+void QuicShardedServer::Worker::OnEvent(int fd, EpollEvent* event) {
+  DCHECK_EQ(fd, fd_);
+  event->out_ready_mask = 0;
+
+  if (event->in_events & EPOLLIN) {
+    DVLOG(1) << "EPOLLIN";
+    QuicPacketCount* packets_dropped =
+        overflow_supported_ ? &packets_dropped_ : nullptr;
+    bool read = true;
+    while (read) {
+      if (use_recvmmsg_) {
+        read = packet_reader_->ReadAndDispatchPackets(fd_, port_, this,
+                                                      packets_dropped);
+      } else {
+        read = QuicPacketReader::ReadAndDispatchSinglePacket(
+            fd_, port_, this, packets_dropped);
+      }
+    }
+  }
+  if (event->in_events & EPOLLOUT) {
+    dispatcher_->OnCanWrite();
+    if (dispatcher_->HasPendingWrites()) {
+      event->out_ready_mask |= EPOLLOUT;
+    }
+  }
+}
+
+void QuicShardedServer::Worker::ProcessPacket(
+    const IPEndPoint& server_address,
+    const IPEndPoint& client_address,
+    const QuicEncryptedPacket& packet) {
+  int owner = server_->GetWorkerForPacket(packet);
+  if (owner >= 0 && owner != index_) {
+    server_->worker(owner)->EnqueuePacket(server_address, client_address,
+                                          packet);
+    base::subtle::NoBarrier_AtomicIncrement(&packets_forwarded_, 1);
+    return;
+  }
+  dispatcher_->ProcessPacket(server_address, client_address, packet);
+  base::subtle::NoBarrier_AtomicIncrement(&packets_processed_, 1);
+}
+
+void QuicShardedServer::Worker::ProcessQueuedPackets() {
+  std::vector<QueuedPacket> packets;
+  {
+    base::AutoLock lock(queued_packets_lock_);
+    packets.swap(queued_packets_);
+  }
+  for (size_t i = 0; i < packets.size(); ++i) {
+    QuicEncryptedPacket packet(packets[i].data.data(), packets[i].data.size());
+    dispatcher_->ProcessPacket(packets[i].server_address,
+                               packets[i].client_address, packet);
+  }
+  base::subtle::NoBarrier_AtomicIncrement(&packets_processed_,
+                                          static_cast<int>(packets.size()));
+}
+
+QuicShardedServer::QuicShardedServer(
+    const QuicConfig& config,
+    const QuicVersionVector& supported_versions,
+    int num_workers)
+    : config_(config),
+      crypto_config_(kSourceAddressTokenSecret, QuicRandom::GetInstance()),
+      supported_versions_(supported_versions),
+      port_(0),
+      kernel_steering_(false),
+      batch_writes_(false) {
+  DCHECK_GT(num_workers, 0);
+  QuicServer::SetDefaultFlowControlWindows(&config_);
+
+  QuicClock clock;
+  scoped_ptr<CryptoHandshakeMessage> scfg(
+      crypto_config_.AddDefaultConfig(
+          QuicRandom::GetInstance(), &clock,
+          QuicCryptoServerConfig::ConfigOptions()));
+
+  for (int i = 0; i < num_workers; ++i)
+    workers_.push_back(new Worker(this, i));
+}
+
+QuicShardedServer::~QuicShardedServer() {
+  Shutdown();
+}
+
+bool QuicShardedServer::Listen(const IPEndPoint& address) {
+  // The workers are bound in order, which is the order of their sockets in
+  // the SO_REUSEPORT group.
+  IPEndPoint worker_address = address;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (!workers_[i]->Listen(worker_address))
+      return false;
+    worker_address = IPEndPoint(address.address(), workers_[0]->port());
+  }
+  port_ = workers_[0]->port();
+
+  if (workers_.size() > 1) {
+    kernel_steering_ = QuicSocketUtils::SetConnectionIdSteering(
+        workers_[0]->fd(), num_workers());
+  }
+  DVLOG(1) << "Listening on " << worker_address.ToString() << " with "
+           << workers_.size() << " workers, "
+           << (kernel_steering_ ? "steered by the kernel"
+                                : "steered by the workers");
+  return true;
+}
+
+void QuicShardedServer::Start() {
+  DCHECK(threads_.empty());
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    threads_.push_back(new base::DelegateSimpleThread(
+        workers_[i], "quic_worker_" + base::IntToString(static_cast<int>(i))));
+    threads_.back()->Start();
+  }
+}
+
+void QuicShardedServer::Shutdown() {
+  for (size_t i = 0; i < threads_.size(); ++i)
+    workers_[i]->Quit();
+  for (size_t i = 0; i < threads_.size(); ++i)
+    threads_[i]->Join();
+  threads_.clear();
+}
+
+int QuicShardedServer::GetWorkerForPacket(
+    const QuicEncryptedPacket& packet) const {
+  if (workers_.size() == 1)
+    return 0;
+  return QuicSocketUtils::GetSocketIndexForPacket(
+      packet.data(), packet.length(), num_workers());
+}
+
+}  // namespace tools
+}  // namespace net
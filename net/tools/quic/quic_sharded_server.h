@@ -0,0 +1,215 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A QUIC server that spreads its connections over several worker threads.
+
+#ifndef NET_TOOLS_QUIC_QUIC_SHARDED_SERVER_H_
+#define NET_TOOLS_QUIC_QUIC_SHARDED_SERVER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/simple_thread.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/quic_crypto_server_config.h"
+#include "net/quic/quic_config.h"
+#include "net/quic/quic_protocol.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/quic/quic_dispatcher.h"
+
+namespace net {
+namespace tools {
+
+class QuicBatchPacketWriter;
+class QuicPacketReader;
+
+// Runs a QUIC server on |num_workers| threads. Every worker has its own UDP
+// socket, bound to the same address with SO_REUSEPORT, and its own
+// EpollServer, QuicDispatcher and QuicPacketReader, so that the workers share
+// nothing but the crypto config.
+//
+// Every connection belongs to the worker that its connection ID picks, see
+// QuicSocketUtils::GetSocketIndexForPacket(). Where the kernel supports it, a
+// program attached to the SO_REUSEPORT group delivers every packet to the
+// socket of its owner. Packets that still reach another worker, because the
+// kernel cannot steer them, are handed over to their owner, so that the
+// packets of a client that moved to a new address reach its connection too.
+class QuicShardedServer {
+ public:
+  class Worker : public base::DelegateSimpleThread::Delegate,
+                 public EpollCallbackInterface,
+                 public ProcessPacketInterface {
+   public:
+    Worker(QuicShardedServer* server, int index);
+    ~Worker() override;
+
+    // Binds the socket of the worker to |address|. Called before the worker
+    // runs.
+    bool Listen(const IPEndPoint& address);
+
+    // Makes the worker leave its event loop after the current iteration.
+    // Called on the thread that created the worker.
+    void Quit();
+
+    // Queues |packet| to be processed on the thread of this worker, and wakes
+    // the worker up. Can be called on any thread.
+    void EnqueuePacket(const IPEndPoint& server_address,
+                       const IPEndPoint& client_address,
+                       const QuicEncryptedPacket& packet);
+
+    // base::DelegateSimpleThread::Delegate implementation. Runs the event
+    // loop until Quit() is called, then shuts the dispatcher down.
+    void Run() override;
+
+    // EpollCallbackInterface implementation.
+    void OnRegistration(EpollServer* eps, int fd, int event_mask) override {}
+    void OnModification(int fd, int event_mask) override {}
+    void OnEvent(int fd, EpollEvent* event) override;
+    void OnUnregistration(int fd, bool replaced) override {}
+    void OnShutdown(EpollServer* eps, int fd) override {}
+
+    // ProcessPacketInterface implementation. Hands |packet| to the dispatcher
+    // if this worker owns its connection, and to the owner otherwise.
+    void ProcessPacket(const IPEndPoint& server_address,
+                       const IPEndPoint& client_address,
+                       const QuicEncryptedPacket& packet) override;
+
+    int index() const { return index_; }
+    int fd() const { return fd_; }
+    int port() const { return port_; }
+
+    // The number of packets that the dispatcher of this worker processed, and
+    // the number that this worker read but handed over to another worker.
+    // Can be read on any thread.
+    int packets_processed() const {
+      return base::subtle::NoBarrier_Load(&packets_processed_);
+    }
+    int packets_forwarded() const {
+      return base::subtle::NoBarrier_Load(&packets_forwarded_);
+    }
+
+    QuicDispatcher* dispatcher() { return dispatcher_.get(); }
+    EpollServer* epoll_server() { return &epoll_server_; }
+
+   private:
+    // A packet that another worker read for a connection of this one.
+    struct QueuedPacket {
+      QueuedPacket(const IPEndPoint& server_address,
+                   const IPEndPoint& client_address,
+                   const QuicEncryptedPacket& packet);
+      ~QueuedPacket();
+
+      IPEndPoint server_address;
+      IPEndPoint client_address;
+      std::string data;
+    };
+
+    // Hands the packets that other workers queued to the dispatcher.
+    void ProcessQueuedPackets();
+
+    QuicShardedServer* server_;
+    const int index_;
+
+    EpollServer epoll_server_;
+    scoped_ptr<QuicDispatcher> dispatcher_;
+    scoped_ptr<QuicPacketReader> packet_reader_;
+    // The writer of the dispatcher if it batches writes, which the worker
+    // flushes after every iteration of its event loop. Owned by the
+    // dispatcher.
+    QuicBatchPacketWriter* batch_writer_;
+
+    // The socket of the worker, and the port that it is bound to.
+    int fd_;
+    int port_;
+
+    // True if the kernel supports SO_RXQ_OVFL, in which case
+    // |packets_dropped_| is the number of packets that the socket dropped.
+    bool overflow_supported_;
+    QuicPacketCount packets_dropped_;
+
+    // If true, use recvmmsg for reading.
+    const bool use_recvmmsg_;
+
+    base::CancellationFlag quit_;
+
+    // Packets queued by other workers. Guarded by |queued_packets_lock_|.
+    base::Lock queued_packets_lock_;
+    std::vector<QueuedPacket> queued_packets_;
+
+    base::subtle::Atomic32 packets_processed_;
+    base::subtle::Atomic32 packets_forwarded_;
+
+    DISALLOW_COPY_AND_ASSIGN(Worker);
+  };
+
+  QuicShardedServer(const QuicConfig& config,
+                    const QuicVersionVector& supported_versions,
+                    int num_workers);
+  ~QuicShardedServer();
+
+  // Creates and binds the sockets of all the workers. If the port of
+  // |address| is zero, the kernel picks one for all of them.
+  bool Listen(const IPEndPoint& address);
+
+  // If true, the workers queue the packets that they write and send them
+  // with a system call per iteration of their event loop, see
+  // QuicBatchPacketWriter. Must be set before Listen().
+  void set_batch_writes(bool batch_writes) { batch_writes_ = batch_writes; }
+
+  // Starts the threads of the workers. Listen() must have succeeded.
+  void Start();
+
+  // Stops the workers, which close all their connections, and waits for
+  // their threads to finish.
+  void Shutdown();
+
+  // Returns the worker that owns the connection of |packet|, or -1 if the
+  // packet does not carry a connection ID that can tell.
+  int GetWorkerForPacket(const QuicEncryptedPacket& packet) const;
+
+  void SetStrikeRegisterNoStartupPeriod() {
+    crypto_config_.set_strike_register_no_startup_period();
+  }
+
+  // SetProofSource sets the ProofSource that will be used to verify the
+  // server's certificate, and takes ownership of |source|.
+  void SetProofSource(ProofSource* source) {
+    crypto_config_.SetProofSource(source);
+  }
+
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+  Worker* worker(int index) { return workers_[index]; }
+
+  int port() const { return port_; }
+
+  // True if the kernel delivers the packets to the socket of their owner.
+  bool kernel_steering() const { return kernel_steering_; }
+
+ private:
+  QuicConfig config_;
+  // Shared by all the workers, so that a client can use the config of any of
+  // them, and the strike register sees the handshakes of all of them.
+  QuicCryptoServerConfig crypto_config_;
+  const QuicVersionVector supported_versions_;
+
+  ScopedVector<Worker> workers_;
+  ScopedVector<base::DelegateSimpleThread> threads_;
+
+  int port_;
+  bool kernel_steering_;
+  bool batch_writes_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicShardedServer);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_SHARDED_SERVER_H_
@@ -0,0 +1,155 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_sharded_server.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "net/base/net_util.h"
+#include "net/quic/quic_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace tools {
+namespace test {
+
+namespace {
+
+const int kNumWorkers = 4;
+
+// Returns a packet whose connection ID is owned by |worker| out of
+// kNumWorkers.
+std::string MakePacket(int worker, uint8 public_flags) {
+  unsigned char packet[] = {
+    // public flags
+    public_flags,
+    // connection_id
+    0x10, 0x32, 0x54, 0x00,
+    0x98, 0xBA, 0xDC, 0xFE,
+    // packet sequence number
+    0xBC, 0x9A, 0x78, 0x56,
+    0x34, 0x12,
+    // private flags
+    0x00 };
+  // The workers are picked by the first four bytes of the connection ID in
+  // network byte order, so the last of them decides.
+  packet[4] = static_cast<unsigned char>(worker);
+  return std::string(QuicUtils::AsChars(packet), arraysize(packet));
+}
+
+int TotalPacketsProcessed(QuicShardedServer* server) {
+  int processed = 0;
+  for (int i = 0; i < server->num_workers(); ++i)
+    processed += server->worker(i)->packets_processed();
+  return processed;
+}
+
+// Waits for the workers of |server| to process |num_packets| packets.
+bool WaitForPacketsProcessed(QuicShardedServer* server, int num_packets) {
+  for (int i = 0; i < 500; ++i) {
+    if (TotalPacketsProcessed(server) >= num_packets)
+      return true;
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+class QuicShardedServerTest : public ::testing::Test {
+ protected:
+  QuicShardedServerTest()
+      : server_(config_, QuicSupportedVersions(), kNumWorkers) {
+    IPAddressNumber ip;
+    CHECK(ParseIPLiteralToNumber("127.0.0.1", &ip));
+    address_ = IPEndPoint(ip, 0);
+  }
+
+  QuicConfig config_;
+  QuicShardedServer server_;
+  IPEndPoint address_;
+};
+
+TEST_F(QuicShardedServerTest, GetWorkerForPacket) {
+  for (int i = 0; i < kNumWorkers; ++i) {
+    std::string data = MakePacket(i, 0x3C);
+    EXPECT_EQ(i, server_.GetWorkerForPacket(
+                     QuicEncryptedPacket(data.data(), data.size())));
+  }
+
+  // Packets without a whole connection ID stay with the worker that read
+  // them.
+  std::string data = MakePacket(1, 0x30);
+  EXPECT_EQ(-1, server_.GetWorkerForPacket(
+                    QuicEncryptedPacket(data.data(), data.size())));
+  data = MakePacket(1, 0x3C);
+  EXPECT_EQ(-1, server_.GetWorkerForPacket(
+                    QuicEncryptedPacket(data.data(), 4)));
+}
+
+TEST_F(QuicShardedServerTest, ForwardsPacketsToOwner) {
+  ASSERT_TRUE(server_.Listen(address_));
+  for (int i = 1; i < kNumWorkers; ++i)
+    EXPECT_EQ(server_.port(), server_.worker(i)->port());
+
+  // Worker 0 reads a packet of every worker, and keeps only its own.
+  IPEndPoint client_address(address_.address(), 1234);
+  for (int i = 0; i < kNumWorkers; ++i) {
+    std::string data = MakePacket(i, 0x3C);
+    server_.worker(0)->ProcessPacket(
+        IPEndPoint(address_.address(), server_.port()), client_address,
+        QuicEncryptedPacket(data.data(), data.size()));
+  }
+  EXPECT_EQ(1, server_.worker(0)->packets_processed());
+  EXPECT_EQ(kNumWorkers - 1, server_.worker(0)->packets_forwarded());
+
+  server_.Start();
+  EXPECT_TRUE(WaitForPacketsProcessed(&server_, kNumWorkers));
+  server_.Shutdown();
+  for (int i = 0; i < kNumWorkers; ++i)
+    EXPECT_EQ(1, server_.worker(i)->packets_processed());
+}
+
+TEST_F(QuicShardedServerTest, PacketsFromSocketReachOwner) {
+  ASSERT_TRUE(server_.Listen(address_));
+  server_.Start();
+
+  int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  ASSERT_LE(0, fd);
+  SockaddrStorage storage;
+  ASSERT_TRUE(IPEndPoint(address_.address(), server_.port())
+                  .ToSockAddr(storage.addr, &storage.addr_len));
+
+  // Every packet ends up with its owner, whether the kernel or the workers
+  // steer it.
+  const int kPacketsPerWorker = 5;
+  for (int i = 0; i < kPacketsPerWorker; ++i) {
+    for (int j = 0; j < kNumWorkers; ++j) {
+      std::string data = MakePacket(j, 0x3C);
+      ASSERT_EQ(static_cast<ssize_t>(data.size()),
+                sendto(fd, data.data(), data.size(), 0, storage.addr,
+                       storage.addr_len));
+    }
+  }
+  close(fd);
+
+  EXPECT_TRUE(
+      WaitForPacketsProcessed(&server_, kPacketsPerWorker * kNumWorkers));
+  server_.Shutdown();
+  int forwarded = 0;
+  for (int i = 0; i < kNumWorkers; ++i) {
+    EXPECT_EQ(kPacketsPerWorker, server_.worker(i)->packets_processed());
+    forwarded += server_.worker(i)->packets_forwarded();
+  }
+  if (server_.kernel_steering())
+    EXPECT_EQ(0, forwarded);
+}
+
+}  // namespace test
+}  // namespace tools
+}  // namespace net
@@ -5,9 +5,12 @@
 #include "net/tools/quic/quic_socket_utils.h"
 
 #include <errno.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <unistd.h>
 #include <string>
 
 #include "base/basictypes.h"
@@ -18,6 +21,14 @@
 #define SO_RXQ_OVFL 40
 #endif
 
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
 namespace net {
 namespace tools {
 
@@ -94,6 +105,105 @@ bool QuicSocketUtils::SetReceiveBufferSize(int fd, size_t size) {
   return true;
 }
 
+// static
+bool QuicSocketUtils::SetReusePort(int fd) {
+  int reuse_port = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port,
+                 sizeof(reuse_port)) != 0) {
+    LOG(ERROR) << "Failed to set SO_REUSEPORT: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+// static
+bool QuicSocketUtils::SetConnectionIdSteering(int fd, int num_sockets) {
+  DCHECK_GT(num_sockets, 0);
+  // The program runs with the UDP payload at offset 0. It has to pick the
+  // same socket as GetSocketIndexForPacket().
+  sock_filter code[] = {
+    // A = public flags.
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+    BPF_STMT(BPF_ALU | BPF_AND | BPF_K,
+             PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID,
+             0, 3),
+    // A = the first four bytes of the connection ID, in network byte order.
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 1),
+    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32>(num_sockets)),
+    BPF_STMT(BPF_RET | BPF_A, 0),
+    // An index that is out of range makes the kernel fall back to the hash.
+    BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+  };
+  sock_fprog program;
+  program.len = arraysize(code);
+  program.filter = code;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                 sizeof(program)) != 0) {
+    DLOG(WARNING) << "Connection ID steering not supported: "
+                  << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+// static
+int QuicSocketUtils::GetSocketIndexForPacket(const char* buffer,
+                                             size_t buf_len,
+                                             int num_sockets) {
+  DCHECK_GT(num_sockets, 0);
+  if (buf_len < 1 + sizeof(uint32) ||
+      (buffer[0] & PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID) !=
+          PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID) {
+    return -1;
+  }
+  const uint8* connection_id = reinterpret_cast<const uint8*>(buffer + 1);
+  uint32 value = (connection_id[0] << 24) | (connection_id[1] << 16) |
+                 (connection_id[2] << 8) | connection_id[3];
+  return static_cast<int>(value % static_cast<uint32>(num_sockets));
+}
+
+// static
+int QuicSocketUtils::CreateUDPSocket(const IPEndPoint& address,
+                                     bool reuse_port,
+                                     bool* overflow_supported) {
+  int address_family = address.GetSockAddrFamily();
+  int fd = socket(address_family, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+  if (fd < 0) {
+    LOG(ERROR) << "CreateSocket() failed: " << strerror(errno);
+    return -1;
+  }
+
+  // Enable the socket option that allows the local address to be
+  // returned if the socket is bound to more than one address.
+  int rc = SetGetAddressInfo(fd, address_family);
+  if (rc < 0) {
+    LOG(ERROR) << "IP detection not supported" << strerror(errno);
+    close(fd);
+    return -1;
+  }
+
+  int get_overflow = 1;
+  rc = setsockopt(
+      fd, SOL_SOCKET, SO_RXQ_OVFL, &get_overflow, sizeof(get_overflow));
+  if (rc < 0) {
+    DLOG(WARNING) << "Socket overflow detection not supported";
+  } else {
+    *overflow_supported = true;
+  }
+
+  // These send and receive buffer sizes are sized for a single connection,
+  // because the default usage of QuicServer is as a test server with one or
+  // two clients.  Servers for many clients adjust them higher.
+  if (!SetReceiveBufferSize(fd, kDefaultSocketReceiveBuffer) ||
+      !SetSendBufferSize(fd, kDefaultSocketReceiveBuffer) ||
+      (reuse_port && !SetReusePort(fd))) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
 // static
 int QuicSocketUtils::ReadPacket(int fd, char* buffer, size_t buf_len,
                                 QuicPacketCount* dropped_packets,
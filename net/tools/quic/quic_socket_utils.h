@@ -41,6 +41,35 @@ class QuicSocketUtils {
   // Sets the receive buffer size to |size| and returns false if it fails.
   static bool SetReceiveBufferSize(int fd, size_t size);
 
+  // Sets SO_REUSEPORT on the socket, so that several sockets can be bound to
+  // the same address, and returns false if it fails.
+  static bool SetReusePort(int fd);
+
+  // Attaches a program to the SO_REUSEPORT group of the socket, that makes
+  // the kernel deliver every packet with an 8 byte connection ID to the
+  // socket at index GetSocketIndexForPacket() in the group, in the order that
+  // the |num_sockets| sockets of the group were bound. Other packets are
+  // spread by the usual hash of their addresses. Returns false if the kernel
+  // does not support it.
+  static bool SetConnectionIdSteering(int fd, int num_sockets);
+
+  // Returns the index of the socket, out of |num_sockets|, that owns the
+  // connection of the QUIC packet in |buffer|, as the program attached by
+  // SetConnectionIdSteering() picks it. Returns -1 if the packet does not
+  // carry an 8 byte connection ID.
+  static int GetSocketIndexForPacket(const char* buffer,
+                                     size_t buf_len,
+                                     int num_sockets);
+
+  // Creates a non-blocking UDP socket for a server that listens on
+  // |address|, with the options that the server needs, but does not bind it.
+  // SO_REUSEPORT is set if |reuse_port| is true. Sets |overflow_supported|
+  // if the kernel reports the number of packets that the socket dropped.
+  // Returns the socket, or -1 on failure.
+  static int CreateUDPSocket(const IPEndPoint& address,
+                             bool reuse_port,
+                             bool* overflow_supported);
+
   // Reads buf_len from the socket.  If reading is successful, returns bytes
   // read and sets peer_address to the peer address.  Otherwise returns -1.
   //
@@ -123,7 +123,7 @@ void QuicSpdyServerStream::SendResponse() {
   }
 
   DVLOG(1) << "Sending response for stream " << id();
-  SendHeadersAndBody(response->headers(), response->body());
+  SendHeadersAndBody(response->headers(), response->body_buffer());
 }
 
 void QuicSpdyServerStream::SendErrorResponse() {
@@ -132,21 +132,23 @@ void QuicSpdyServerStream::SendErrorResponse() {
   headers[":version"] = "HTTP/1.1";
   headers[":status"] = "500 Server Error";
   headers["content-length"] = "3";
-  SendHeadersAndBody(headers, "bad");
+  scoped_refptr<base::RefCountedMemory> body(
+      new base::RefCountedStaticMemory("bad", 3));
+  SendHeadersAndBody(headers, body.get());
 }
 
 void QuicSpdyServerStream::SendHeadersAndBody(
     const SpdyHeaderBlock& response_headers,
-    StringPiece body) {
+    base::RefCountedMemory* body) {
   // We only support SPDY and HTTP, and neither handles bidirectional streaming.
   if (!read_side_closed()) {
     CloseReadSide();
   }
 
-  WriteHeaders(response_headers, body.empty(), nullptr);
+  WriteHeaders(response_headers, body->size() == 0, nullptr);
 
-  if (!body.empty()) {
-    WriteOrBufferData(body, true, nullptr);
+  if (body->size() != 0) {
+    WriteOrBufferSharedData(body, true, nullptr);
   }
 }
 
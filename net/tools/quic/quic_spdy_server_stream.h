@@ -49,8 +49,10 @@ class QuicSpdyServerStream : public QuicDataStream {
   // for the body
   void SendErrorResponse();
 
+  // Sends |body| without copying it: the stream frames share it until they
+  // are acked.
   void SendHeadersAndBody(const SpdyHeaderBlock& response_headers,
-                          base::StringPiece body);
+                          base::RefCountedMemory* body);
 
   // The parsed headers received from the client.
   SpdyHeaderBlock request_headers_;
@@ -127,6 +127,7 @@ class QuicSpdyServerStreamTest : public ::testing::TestWithParam<QuicVersion> {
 QuicConsumedData ConsumeAllData(
     QuicStreamId id,
     const IOVector& data,
+    base::RefCountedMemory* /*data_buffer*/,
     QuicStreamOffset offset,
     bool fin,
     FecProtection /*fec_protection_*/,
@@ -138,7 +139,7 @@ INSTANTIATE_TEST_CASE_P(Tests, QuicSpdyServerStreamTest,
                         ::testing::ValuesIn(QuicSupportedVersions()));
 
 TEST_P(QuicSpdyServerStreamTest, TestFraming) {
-  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _)).Times(AnyNumber()).
+  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _, _)).Times(AnyNumber()).
       WillRepeatedly(Invoke(ConsumeAllData));
   stream_->OnStreamHeaders(headers_string_);
   stream_->OnStreamHeadersComplete(false, headers_string_.size());
@@ -150,7 +151,7 @@ TEST_P(QuicSpdyServerStreamTest, TestFraming) {
 }
 
 TEST_P(QuicSpdyServerStreamTest, TestFramingOnePacket) {
-  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _)).Times(AnyNumber()).
+  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _, _)).Times(AnyNumber()).
       WillRepeatedly(Invoke(ConsumeAllData));
 
   stream_->OnStreamHeaders(headers_string_);
@@ -166,7 +167,7 @@ TEST_P(QuicSpdyServerStreamTest, TestFramingExtraData) {
   string large_body = "hello world!!!!!!";
 
   // We'll automatically write out an error (headers + body)
-  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _)).Times(AnyNumber()).
+  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _, _)).Times(AnyNumber()).
       WillRepeatedly(Invoke(ConsumeAllData));
 
   stream_->OnStreamHeaders(headers_string_);
@@ -192,8 +193,9 @@ TEST_P(QuicSpdyServerStreamTest, TestSendResponse) {
   response_headers_["content-length"] = "3";
 
   InSequence s;
-  EXPECT_CALL(session_, WritevData(kHeadersStreamId, _, 0, false, _, nullptr));
-  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _)).Times(1).
+  EXPECT_CALL(session_,
+              WritevData(kHeadersStreamId, _, _, 0, false, _, nullptr));
+  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _, _)).Times(1).
       WillOnce(Return(QuicConsumedData(3, true)));
 
   QuicSpdyServerStreamPeer::SendResponse(stream_.get());
@@ -207,8 +209,9 @@ TEST_P(QuicSpdyServerStreamTest, TestSendErrorResponse) {
   response_headers_["content-length"] = "3";
 
   InSequence s;
-  EXPECT_CALL(session_, WritevData(kHeadersStreamId, _, 0, false, _, nullptr));
-  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _)).Times(1).
+  EXPECT_CALL(session_,
+              WritevData(kHeadersStreamId, _, _, 0, false, _, nullptr));
+  EXPECT_CALL(session_, WritevData(_, _, _, _, _, _, _)).Times(1).
       WillOnce(Return(QuicConsumedData(3, true)));
 
   QuicSpdyServerStreamPeer::SendErrorResponse(stream_.get());